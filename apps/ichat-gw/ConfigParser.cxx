@@ -43,6 +43,7 @@ ConfigParser::ConfigParser(int argc, char** argv) :
    mSkipFirstIChatAddress(false),
    mMediaRelayPortRangeMin(8000),
    mMediaRelayPortRangeMax(9999),
+   mMediaRelayThreads(1),
    mJabberComponentPort(5275),
    mJabberServerPingDuration(60)  // 1 min
 {
@@ -315,6 +316,10 @@ ConfigParser::processOption(const Data& name, const Data& value)
    {
       mMediaRelayPortRangeMax = (unsigned short)value.convertUnsignedLong();
    }
+   else if(name == "mediarelaythreads")
+   {
+      mMediaRelayThreads = value.convertUnsignedLong();
+   }
    else if(name == "translationpattern")
    {
       mAddressTranslations.push_back(std::make_pair(value, Data::Empty));
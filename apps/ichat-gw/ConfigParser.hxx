@@ -43,6 +43,7 @@ public:
    CodecIdList mCodecIdFilterList;
    unsigned short mMediaRelayPortRangeMin;
    unsigned short mMediaRelayPortRangeMax;
+   unsigned int mMediaRelayThreads;
    typedef std::list<std::pair<resip::Data,resip::Data> > TranslationList;
    TranslationList mAddressTranslations;
 
@@ -22,12 +22,6 @@ using namespace std;
 
 #define RESIPROCATE_SUBSYSTEM AppSubsystem::GATEWAY
 
-#ifdef WIN32
-   #define sleepMs(t) Sleep(t)
-#else
-   #define sleepMs(t) usleep(t*1000)
-#endif
-
 typedef struct 
 {
    unsigned short versionExtPayloadTypeAndMarker;
@@ -36,583 +30,733 @@ typedef struct
    unsigned int ssrc;
 } RtpHeader;
 
+#define UDP_BUFFER_SIZE 1000
+#define KEEPALIVETIMEOUTMS 1000 
+#define KEEPALIVEMS 20  
+#define KEEPALIVECHECKMS 10  // how often each thread runs checkKeepalives over its ports
+#define STALEENDPOINTTIMEOUTMS 2000
+#define MAXREADSPEREVENT 16  // datagrams read from one socket before other sockets get a turn
+
+MediaRelayThread::RelaySocket::RelaySocket(MediaRelayThread& thread, Relay& relay, resip::Socket fd, const resip::Tuple& localTuple) :
+   mThread(thread),
+   mRelay(relay),
+   mFd(fd),
+   mLocalTuple(localTuple),
+   mHandle(0),
+   mMask(0)
+{
+}
 
-MediaRelay::MediaRelay(bool isV6Avail, unsigned short portRangeMin, unsigned short portRangeMax) : 
-   mIsV6Avail(isV6Avail)
-{   
-   if(portRangeMax < portRangeMin) portRangeMax = portRangeMin;  // saftey check
-   for(unsigned int i = portRangeMin; i <= portRangeMax; i++)
-   {
-      mFreeRelayPortList.push_back(i);
-   }
+void 
+MediaRelayThread::RelaySocket::processPollEvent(FdPollEventMask mask)
+{
+   mThread.processSocket(mRelay, *this, mask);
 }
 
-MediaRelay::~MediaRelay()
+MediaRelayThread::Relay::Relay(MediaRelayThread& thread, MediaRelayPort* relayPort) :
+   mRelayPort(relayPort),
+   mV4(thread, *this, relayPort->mV4Fd, relayPort->mLocalV4Tuple),
+   mV6(relayPort->mV6Fd != INVALID_SOCKET ? new RelaySocket(thread, *this, relayPort->mV6Fd, relayPort->mLocalV6Tuple) : 0)
 {
-   Lock lock(mRelaysMutex);
-   RelayPortList::iterator it = mRelays.begin();
+}
+
+MediaRelayThread::Relay::~Relay()
+{
+   delete mV6;
+   delete mRelayPort;
+}
+
+MediaRelayThread::MediaRelayThread(MediaRelay& mediaRelay, bool isV6Avail, const char* pollImpl) :
+   mMediaRelay(mediaRelay),
+   mIsV6Avail(isV6Avail),
+   mPollGrp(FdPollGrp::create(pollImpl)),
+   mInterruptorHandle(0),
+   mCommands(&mInterruptor),
+   mNextKeepaliveCheck(0),
+   mBuffer(UDP_BUFFER_SIZE+1),
+   mPacketsRelayed(0)
+{
+   mInterruptorHandle = mPollGrp->addPollItem(mInterruptor.getReadSocket(), FPEM_Read, &mInterruptor);
+}
+
+MediaRelayThread::~MediaRelayThread()
+{
+   while(mCommands.messageAvailable())
+   {
+      std::auto_ptr<Command> command(mCommands.getNext());
+      if(command->mType == Command::Add)
+      {
+         delete command->mRelayPort;
+      }
+   }
+   RelayList::iterator it = mRelays.begin();
    for(;it != mRelays.end(); it++)
    {
+      unregisterSocket(it->second->mV4);
+      if(it->second->mV6) unregisterSocket(*it->second->mV6);
       delete it->second;
    }
+   mPollGrp->delPollItem(mInterruptorHandle);
 }
 
-#define NUM_CREATE_TRIES 10  // Number of times to try to allocate a port, since port may be in use by another application
-bool 
-MediaRelay::createRelay(unsigned short& port)
+void 
+MediaRelayThread::addRelay(unsigned short port, MediaRelayPort* relayPort)
 {
-   for(unsigned int i = 0; i < NUM_CREATE_TRIES; i++)
-   {
-      if(createRelayImpl(port)) return true;
-   }
-   return false;
+   Command* command = new Command(Command::Add, port);
+   command->mRelayPort = relayPort;
+   mCommands.add(command);
 }
 
-bool 
-MediaRelay::createRelayImpl(unsigned short& port)
+void 
+MediaRelayThread::removeRelay(unsigned short port)
 {
-   Lock lock(mRelaysMutex);
-
-   if(mFreeRelayPortList.empty()) return false;
+   mCommands.add(new Command(Command::Remove, port));
+}
 
-   unsigned short trialPort = mFreeRelayPortList.front();
-   mFreeRelayPortList.pop_front();
+void 
+MediaRelayThread::primeNextEndpoint(unsigned short port, const resip::Tuple& destinationIPPort)
+{
+   Command* command = new Command(Command::Prime, port);
+   command->mTuple = destinationIPPort;
+   mCommands.add(command);
+}
 
-   Tuple v4tuple(Data::Empty,trialPort,V4,UDP,Data::Empty);
-   resip::Socket v4fd = createRelaySocket(v4tuple);
+void 
+MediaRelayThread::shutdown()
+{
+   ThreadIf::shutdown();
+   mInterruptor.interrupt();
+}
 
-   if(v4fd == INVALID_SOCKET)
+void 
+MediaRelayThread::thread()
+{
+   InfoLog (<< "MediaRelayThread::thread - started, using " << mPollGrp->getImplName());
+   while (!isShutdown())
    {
-      mFreeRelayPortList.push_back(trialPort);
-      return false;
+      try
+      {
+         UInt64 now = Timer::getTimeMs();
+         processTimers(now);
+         mPollGrp->waitAndProcess((int)resipMax((UInt64)1, mNextKeepaliveCheck - now));
+      }
+      catch (BaseException& e)
+      {
+         ErrLog (<< "MediaRelayThread::thread - Unhandled exception: " << e);
+      }
    }
+   WarningLog (<< "MediaRelayThread::thread - shutdown");
+}
 
-   if(mIsV6Avail)
+void 
+MediaRelayThread::processTimers(UInt64 now)
+{
+   processCommands();
+   if(now >= mNextKeepaliveCheck)
    {
-      Tuple v6tuple(Data::Empty,trialPort,V6,UDP,Data::Empty);
-      resip::Socket v6fd = createRelaySocket(v6tuple);
-
-      if(v6fd != INVALID_SOCKET)
+      RelayList::iterator it = mRelays.begin();
+      for(;it != mRelays.end(); it++)
       {
-         port = trialPort;
-
-         mRelays[port] = new MediaRelayPort(v4fd, v4tuple, v6fd, v6tuple);
-         InfoLog(<< "MediaRelay::createRelayImpl - Media relay started for port " << port);
-   
-         return true;
+         checkKeepalives(*it->second, now);
       }
-
-#if defined(WIN32)
-      closesocket(v4fd);
-#else
-      close(v4fd); 
-#endif
-
-      mFreeRelayPortList.push_back(trialPort);
-      return false;
+      mNextKeepaliveCheck = now + KEEPALIVECHECKMS;
    }
-   else
-   {
-      // Only V4 is available
-      port = trialPort;
+}
 
-      mRelays[port] = new MediaRelayPort(v4fd, v4tuple);
-      InfoLog(<< "MediaRelay::createRelayImpl - Media relay started for port " << port);
-   
-      return true;
+void 
+MediaRelayThread::processCommands()
+{
+   while(mCommands.messageAvailable())
+   {
+      std::auto_ptr<Command> command(mCommands.getNext());
+      switch(command->mType)
+      {
+      case Command::Add:
+         addRelayImpl(command->mPort, command->mRelayPort);
+         break;
+      case Command::Remove:
+         removeRelayImpl(command->mPort);
+         break;
+      case Command::Prime:
+         {
+            RelayList::iterator it = mRelays.find(command->mPort);
+            if(it != mRelays.end())
+            {
+               MediaRelayPort* relayPort = it->second->mRelayPort;
+               MediaEndpoint* endpoint;
+               if(relayPort->mFirstEndpoint.mTuple.getPort() == 0)
+               {
+                  InfoLog(<< "MediaRelay::primeNextEndpoint - sender=first, port=" << command->mPort << ", addr=" << command->mTuple);
+                  endpoint = &relayPort->mFirstEndpoint;
+               }
+               else
+               {
+                  InfoLog(<< "MediaRelay::primeNextEndpoint - sender=second, port=" << command->mPort << ", addr=" << command->mTuple);
+                  endpoint = &relayPort->mSecondEndpoint;
+               }
+               // start the stale endpoint timer now, otherwise the primed endpoint is 
+               // reset by the next keepalive check before it has had a chance to send
+               endpoint->mTuple = command->mTuple;
+               endpoint->mSendTimeMs = endpoint->mRecvTimeMs = Timer::getTimeMs();
+            }
+         }
+         break;
+      }
    }
 }
 
 void 
-MediaRelay::destroyRelay(unsigned short port)
+MediaRelayThread::addRelayImpl(unsigned short port, MediaRelayPort* relayPort)
 {
-   Lock lock(mRelaysMutex);
-   RelayPortList::iterator it = mRelays.find(port);
+   // ports are not returned to the free list until the owning thread has removed them,
+   // so a port can never be added twice
+   resip_assert(mRelays.find(port) == mRelays.end());
+   Relay* relay = new Relay(*this, relayPort);
+   registerSocket(relay->mV4);
+   if(relay->mV6) registerSocket(*relay->mV6);
+   mRelays[port] = relay;
+}
+
+void 
+MediaRelayThread::removeRelayImpl(unsigned short port)
+{
+   RelayList::iterator it = mRelays.find(port);
    if(it != mRelays.end())
    {
-      InfoLog(<< "MediaRelay::destroyRelay - port=" << port);
+      unregisterSocket(it->second->mV4);
+      if(it->second->mV6) unregisterSocket(*it->second->mV6);
       delete it->second;
       mRelays.erase(it);
-      mFreeRelayPortList.push_back(port);
+      mMediaRelay.onRelayDestroyed(port);
    }
 }
 
 void 
-MediaRelay::primeNextEndpoint(unsigned short& port, resip::Tuple& destinationIPPort)
+MediaRelayThread::registerSocket(RelaySocket& socket)
 {
-   Lock lock(mRelaysMutex);
-   RelayPortList::iterator it = mRelays.find(port);
-   if(it != mRelays.end())
+   socket.mMask = FPEM_Read | FPEM_Error;
+   socket.mHandle = mPollGrp->addPollItem(socket.mFd, socket.mMask, &socket);
+}
+
+void 
+MediaRelayThread::unregisterSocket(RelaySocket& socket)
+{
+   if(socket.mHandle)
+   {
+      mPollGrp->delPollItem(socket.mHandle);
+      socket.mHandle = 0;
+   }
+}
+
+void 
+MediaRelayThread::updateEvents(Relay& relay)
+{
+   // While a datagram is waiting for a socket to become writable, stop reading
+   // from the port since each endpoint only buffers a single datagram
+   MediaEndpoint& first = relay.mRelayPort->mFirstEndpoint;
+   MediaEndpoint& second = relay.mRelayPort->mSecondEndpoint;
+   bool pending = first.mRelayDatagram.get() != 0 || second.mRelayDatagram.get() != 0;
+
+   RelaySocket* sockets[2] = { &relay.mV4, relay.mV6 };
+   for(int i = 0; i < 2; i++)
    {
-      if(it->second->mFirstEndpoint.mTuple.getPort() == 0)
+      RelaySocket* socket = sockets[i];
+      if(socket == 0) continue;
+
+      FdPollEventMask mask = FPEM_Error;
+      if(!pending)
       {
-         InfoLog(<< "MediaRelay::primeNextEndpoint - sender=first, port=" << port << ", addr=" << destinationIPPort);
-         it->second->mFirstEndpoint.mTuple = destinationIPPort;
+         mask |= FPEM_Read;
       }
-      else
+      IpVersion version = socket->mLocalTuple.ipVersion();
+      if((first.mRelayDatagram.get() != 0 && first.mTuple.ipVersion() == version) ||
+         (second.mRelayDatagram.get() != 0 && second.mTuple.ipVersion() == version))
+      {
+         mask |= FPEM_Write;
+      }
+      if(mask != socket->mMask)
       {
-         InfoLog(<< "MediaRelay::primeNextEndpoint - sender=second, port=" << port << ", addr=" << destinationIPPort);
-         it->second->mSecondEndpoint.mTuple = destinationIPPort;
+         mPollGrp->modPollItem(socket->mHandle, mask);
+         socket->mMask = mask;
       }
    }
 }
 
-resip::Socket 
-MediaRelay::createRelaySocket(resip::Tuple& tuple)
+void 
+MediaRelayThread::processSocket(Relay& relay, RelaySocket& socket, FdPollEventMask mask)
 {
-   resip::Socket fd;
+   bool writesComplete = true;
+   if(mask & FPEM_Write)
+   {
+      writesComplete = processWrites(relay);
+   }
+   if(writesComplete && (mask & (FPEM_Read | FPEM_Error)))
+   {
+      for(int i = 0; i < MAXREADSPEREVENT && processReads(relay, socket); i++);
+   }
+   updateEvents(relay);
 
-#ifdef USE_IPV6
-   fd = ::socket(tuple.ipVersion() == V4 ? PF_INET : PF_INET6, SOCK_DGRAM, 0);
-#else
-   fd = ::socket(PF_INET, SOCK_DGRAM, 0);
-#endif
-   
-   if ( fd == INVALID_SOCKET )
+   // epoll keeps dispatching for as long as it fills its event cache, so under
+   // heavy load waitAndProcess may not return to thread() for a long time - make
+   // sure commands and keepalives are still serviced.  Note:  this can remove
+   // relay, so it must not be used after this point.
+   UInt64 now = Timer::getTimeMs();
+   if(now >= mNextKeepaliveCheck)
    {
-      int e = getErrno();
-      ErrLog (<< "MediaRelay::createRelaySocket - Failed to create socket: " << strerror(e));
-      return INVALID_SOCKET;
+      processTimers(now);
    }
+}
 
-   DebugLog (<< "MediaRelay::createRelaySocket - Creating fd=" << (int)fd 
-             << (tuple.ipVersion() == V4 ? " V4" : " V6") 
-             << ", Binding to " << Tuple::inet_ntop(tuple));
-   
-   if ( ::bind( fd, &tuple.getSockaddr(), tuple.length()) == SOCKET_ERROR )
+bool 
+MediaRelayThread::send(Relay& relay, MediaEndpoint& endpoint, const char* buffer, int len, UInt64 now)
+{
+   RelaySocket* socket = endpoint.mTuple.ipVersion() == V4 ? &relay.mV4 : relay.mV6;
+   if(socket == 0)
    {
-      int e = getErrno();
-      if ( e == EADDRINUSE )
-      {
-         ErrLog (<< "MediaRelay::createRelaySocket - " << tuple << " already in use ");
-      }
-      else
-      {
-         ErrLog (<< "MediaRelay::createRelaySocket - Could not bind to " << tuple << ", error=" << e);
-      }
-      return INVALID_SOCKET;
+      InfoLog (<< "MediaRelay::send: port=" << relay.mRelayPort->mLocalV4Tuple.getPort() << ", no V6 socket for sending to " << endpoint.mTuple);
+      return true;
    }
-   
-   if(tuple.getPort() == 0)
+
+   int count = sendto(socket->mFd, 
+                      buffer, 
+                      len,  
+                      0, // flags
+                      &endpoint.mTuple.getSockaddr(), endpoint.mTuple.length());
+   if ( count == SOCKET_ERROR )
    {
-      // If we used port 0, then query what port the OS allocated for us
-      socklen_t len = tuple.length();
-      if(::getsockname(fd, &tuple.getMutableSockaddr(), &len) == SOCKET_ERROR)
+      int e = getErrno();
+      if(e == EWOULDBLOCK || e == EAGAIN)
       {
-         int e = getErrno();
-         ErrLog (<<"MediaRelay::createRelaySocket - getsockname failed, error=" << e);
-         return INVALID_SOCKET;
+         return false;
       }
+      InfoLog (<< "MediaRelay::processWrites: port=" << relay.mRelayPort->mLocalV4Tuple.getPort() << ", Failed (" << e << ") sending to " << endpoint.mTuple);
    }
-
-   bool ok = makeSocketNonBlocking(fd);
-   if ( !ok )
+   else
    {
-      ErrLog (<< "MediaRelay::createRelaySocket - Could not make socket non-blocking");
-      return INVALID_SOCKET;
-   }  
-   return fd;
+      endpoint.mSendTimeMs = now;
+   }
+   return true;
 }
 
-void 
-MediaRelay::thread()
+bool
+MediaRelayThread::processWrites(Relay& relay)
 {
-   while (!isShutdown())
+   UInt64 now = Timer::getTimeMs();
+   MediaEndpoint* endpoints[2] = { &relay.mRelayPort->mFirstEndpoint, &relay.mRelayPort->mSecondEndpoint };
+   bool complete = true;
+   for(int i = 0; i < 2; i++)
    {
-      try
+      MediaEndpoint& endpoint = *endpoints[i];
+      if(endpoint.mRelayDatagram.get() != 0)
       {
-         if(mRelays.size() == 0)
+         if(send(relay, endpoint, endpoint.mRelayDatagram.get(), endpoint.mRelayDatagramLen, now))
          {
-            // No relays yet - just wait
-            sleepMs(50);
+            endpoint.mRelayDatagram.reset();
+            endpoint.mRelayDatagramLen = 0;
          }
          else
          {
-            resip::FdSet fdset;
-            buildFdSet(fdset);            
-            int ret = fdset.selectMilliSeconds(50);
-            if (ret > 0)
-            {
-               process(fdset);
-            }
+            complete = false;
          }
       }
-      catch (BaseException& e)
+   }
+   return complete;
+}
+
+bool
+MediaRelayThread::processReads(Relay& relay, RelaySocket& socket)
+{
+   MediaRelayPort* relayPort = relay.mRelayPort;
+   Tuple tuple(socket.mLocalTuple);
+   char* buffer = &mBuffer[0];
+
+   socklen_t slen = tuple.length();
+   int len = recvfrom( socket.mFd,
+                       buffer,
+                       UDP_BUFFER_SIZE,
+                       0 /*flags */,
+                       &tuple.getMutableSockaddr(), 
+                       &slen);
+   if ( len == SOCKET_ERROR )
+   {
+      int err = getErrno();
+      if ( err != EWOULDBLOCK && err != EAGAIN )
       {
-         ErrLog (<< "MediaRelay::thread - Unhandled exception: " << e);
+         ErrLog (<< "MediaRelay::processReads: port=" << relayPort->mLocalV4Tuple.getPort() << ", Error calling recvfrom: " << err);
       }
+      return false;
    }
-   WarningLog (<< "MediaRelay::thread - shutdown");
-}
 
-void 
-MediaRelay::buildFdSet(FdSet& fdset)
-{ 
-   Lock lock(mRelaysMutex);
+   if (len == 0)
+   {
+      ErrLog (<< "MediaRelay::processReads: port=" << relayPort->mLocalV4Tuple.getPort() << ", No data calling recvfrom: len=" << len);
+      return true;
+   }
 
-   RelayPortList::iterator it = mRelays.begin();
-   for(;it != mRelays.end(); it++)
+   if (len+1 >= UDP_BUFFER_SIZE)
    {
-      // Add read fd's
-      fdset.setRead(it->second->mV4Fd);
-      if(mIsV6Avail) fdset.setRead(it->second->mV6Fd);
-      fdset.setExcept(it->second->mV4Fd);
-      if(mIsV6Avail) fdset.setExcept(it->second->mV6Fd);
+      InfoLog(<<"MediaRelay::processReads: port=" << relayPort->mLocalV4Tuple.getPort() << ", Datagram exceeded max length "<<UDP_BUFFER_SIZE);
+      return true;
+   }
 
-      checkKeepalives(it->second);
+   UInt64 now = Timer::getTimeMs();
+   RtpHeader* rtpHeader = (RtpHeader*)buffer;
+   //InfoLog(<< "Received a datagram of size=" << len << " from=" << tuple);
+   MediaEndpoint* pReceivingEndpoint = 0;
+   MediaEndpoint* pSendingEndpoint = 0;
 
-      // Add write fd's if there is data to write
-      if((it->second->mFirstEndpoint.mRelayDatagram.get() != 0 && it->second->mFirstEndpoint.mTuple.ipVersion() == V4) ||
-         (it->second->mSecondEndpoint.mRelayDatagram.get() != 0 && it->second->mSecondEndpoint.mTuple.ipVersion() == V4))
+   // First check if packet is from first endpoint
+   if(tuple == relayPort->mFirstEndpoint.mTuple)
+   {
+      pReceivingEndpoint = &relayPort->mFirstEndpoint;
+      pSendingEndpoint = &relayPort->mSecondEndpoint;
+   }
+   // Next check if packet is from second endpoint
+   else if(tuple == relayPort->mSecondEndpoint.mTuple)
+   {
+      pReceivingEndpoint = &relayPort->mSecondEndpoint;
+      pSendingEndpoint = &relayPort->mFirstEndpoint;
+   }
+   else
+   {
+      // See if we can store this new sender in First Endpoint
+      if(relayPort->mFirstEndpoint.mTuple.getPort() == 0)
+      {
+         InfoLog(<< "MediaRelay::processReads: port=" << relayPort->mLocalV4Tuple.getPort() << ", First packet received from First Endpoint " << tuple);
+         pReceivingEndpoint = &relayPort->mFirstEndpoint;
+         pSendingEndpoint = &relayPort->mSecondEndpoint;
+      }
+      else if(relayPort->mSecondEndpoint.mTuple.getPort() == 0)
       {
-         fdset.setWrite(it->second->mV4Fd);
+         InfoLog(<< "MediaRelay::processReads: port=" << relayPort->mLocalV4Tuple.getPort() << ", First packet received from Second Endpoint " << tuple);
+         pReceivingEndpoint = &relayPort->mSecondEndpoint;
+         pSendingEndpoint = &relayPort->mFirstEndpoint;
       }
-      if(mIsV6Avail &&
-         ((it->second->mFirstEndpoint.mRelayDatagram.get() != 0 && it->second->mFirstEndpoint.mTuple.ipVersion() == V6) ||
-          (it->second->mSecondEndpoint.mRelayDatagram.get() != 0 && it->second->mSecondEndpoint.mTuple.ipVersion() == V6)))
+      else  // We already have 2 endpoints - this would be a third
       {
-         fdset.setWrite(it->second->mV6Fd);
+         // We have a third sender - for now drop, if one of the other senders stops sending data for 2 seconds then we will start picking up this sender
+         WarningLog(<< "MediaRelay::processReads: port=" << relayPort->mLocalV4Tuple.getPort() << ", MediaRelay on " << relayPort->mLocalV4Tuple.getPort() << " has seen a third sender " << tuple << " - not implemented yet - ignoring packet");
+      }
+      if(pReceivingEndpoint)
+      {
+         pReceivingEndpoint->mTuple = tuple;
+         pReceivingEndpoint->mSendTimeMs = now;
+         pReceivingEndpoint->mRecvTimeMs = now;
       }
    }
-}
-
-#define KEEPALIVETIMEOUTMS 1000 
-#define KEEPALIVEMS 20  
-#define STALEENDPOINTTIMEOUTMS 2000
-void 
-MediaRelay::checkKeepalives(MediaRelayPort* relayPort)
-{
-   UInt64 now = Timer::getTimeMs();
 
-   // See if First Endpoint is stale (ie. hasn't received data in STALEENDPOINTTIMEOUTMS ms)
-   if(relayPort->mFirstEndpoint.mTuple.getPort() != 0 &&
-      (now - relayPort->mFirstEndpoint.mRecvTimeMs) > STALEENDPOINTTIMEOUTMS)
+   if(pReceivingEndpoint)
    {
-      relayPort->mFirstEndpoint.reset();
-      InfoLog(<< "MediaRelay::checkKeepalives: port=" << relayPort->mLocalV4Tuple.getPort() << ", haven't recevied data from first endpoint in " << STALEENDPOINTTIMEOUTMS << "ms - reseting endpoint.");
-   }
+      pReceivingEndpoint->mRecvTimeMs = now;
+      if(pSendingEndpoint && pSendingEndpoint->mTuple.getPort() != 0)
+      {
+         if(ntohs(rtpHeader->versionExtPayloadTypeAndMarker) & 0x8000)  // RTP Version 2
+         {
+            // Adjust ssrc
+            rtpHeader->ssrc = pSendingEndpoint->mSsrc;
 
-   // See if Second Endpoint is stale (ie. hasn't received data in STALEENDPOINTTIMEOUTMS ms)
-   if(relayPort->mSecondEndpoint.mTuple.getPort() != 0 &&
-      (now - relayPort->mSecondEndpoint.mRecvTimeMs) > STALEENDPOINTTIMEOUTMS)
-   {
-      relayPort->mSecondEndpoint.reset();
-      InfoLog(<< "MediaRelay::checkKeepalives: port=" << relayPort->mLocalV4Tuple.getPort() << ", haven't recevied data from second endpoint in " << STALEENDPOINTTIMEOUTMS << "ms - reseting endpoint.");
+            if(pSendingEndpoint->mKeepaliveMode)
+            {
+               InfoLog(<< "MediaRelay::processReads: port=" << relayPort->mLocalV4Tuple.getPort() << ", received packet to forward, turning off keepalive mode for " << pSendingEndpoint->mTuple);
+               pSendingEndpoint->mKeepaliveMode = false;
+            }
+
+            // relay packet to the other sender, if the socket is full keep
+            // a copy until it becomes writable
+            //InfoLog(<< "Relaying packet from=" << tuple << " to " << pSendingEndpoint->mTuple);
+            mPacketsRelayed++;
+            if(!send(relay, *pSendingEndpoint, buffer, len, now))
+            {
+               resip_assert(pSendingEndpoint->mRelayDatagram.get() == 0);
+               std::auto_ptr<char> copy(new char[len]);
+               memcpy(copy.get(), buffer, len);
+               pSendingEndpoint->mRelayDatagram = copy;
+               pSendingEndpoint->mRelayDatagramLen = len;
+               return false;
+            }
+         }
+         //else
+         //{
+         //   InfoLog(<< "MediaRelay::processReads: port=" << relayPort->mLocalV4Tuple.getPort() << ", discarding received packet with unknown RTP version from " << tuple);
+         //}
+      }
    }
+   return true;
+}
 
-   //if(relayPort->mFirstEndpoint.mTuple.getPort() != 0)
-   //{
-   //InfoLog(<< "MediaRelay::checkKeepalives - port=" << relayPort->mFirstEndpoint.mTuple.getPort() << ", dataToSend=" << 
-   //   (relayPort->mFirstEndpoint.mRelayDatagram.get() == 0 ? "no" : "yes") << ", time since last send=" <<
-   //    (now - relayPort->mFirstEndpoint.mSendTimeMs));
-   //}
+void 
+MediaRelayThread::checkKeepalives(Relay& relay, UInt64 now)
+{
+   MediaRelayPort* relayPort = relay.mRelayPort;
+   MediaEndpoint* endpoints[2] = { &relayPort->mFirstEndpoint, &relayPort->mSecondEndpoint };
+   const char* names[2] = { "first", "second" };
 
-   // See if keepalive needs to be sent to First Endpoint
-   if(relayPort->mFirstEndpoint.mTuple.getPort() != 0 &&
-      relayPort->mFirstEndpoint.mRelayDatagram.get() == 0 &&
-      ((!relayPort->mFirstEndpoint.mKeepaliveMode && (now - relayPort->mFirstEndpoint.mSendTimeMs) > KEEPALIVETIMEOUTMS) ||
-       (relayPort->mFirstEndpoint.mKeepaliveMode && (now - relayPort->mFirstEndpoint.mSendTimeMs) > KEEPALIVEMS)))
+   for(int i = 0; i < 2; i++)
    {
-      RtpHeader keepalive;  // Create an empty G711 packet to keep iChat happy
-      keepalive.versionExtPayloadTypeAndMarker = htons(0x8000);
-      keepalive.sequenceNumber = 0;
-      keepalive.timestamp = 0;
-      keepalive.ssrc = relayPort->mFirstEndpoint.mSsrc;
+      MediaEndpoint& endpoint = *endpoints[i];
 
-      if(!relayPort->mFirstEndpoint.mKeepaliveMode)
+      // See if Endpoint is stale (ie. hasn't received data in STALEENDPOINTTIMEOUTMS ms)
+      if(endpoint.mTuple.getPort() != 0 &&
+         (now - endpoint.mRecvTimeMs) > STALEENDPOINTTIMEOUTMS)
       {
-         InfoLog(<< "MediaRelay::checkKeepalives: port=" << relayPort->mLocalV4Tuple.getPort() << ", dispatching initial RTP keepalive to first sender!"); 
-         relayPort->mFirstEndpoint.mKeepaliveMode = true;
+         endpoint.reset();
+         InfoLog(<< "MediaRelay::checkKeepalives: port=" << relayPort->mLocalV4Tuple.getPort() << ", haven't recevied data from " << names[i] << " endpoint in " << STALEENDPOINTTIMEOUTMS << "ms - reseting endpoint.");
       }
-      //else
-      //{
-      //   InfoLog(<< "MediaRelay::checkKeepalives: port=" << relayPort->mLocalV4Tuple.getPort() << ", dispatching subsequent RTP keepalive to first sender!"); 
-      //}
-
-      // Add message to buffer
-      std::auto_ptr<char> buffer(new char[sizeof(RtpHeader)]); 
-      memcpy(buffer.get(), &keepalive, sizeof(RtpHeader));
+
+      // See if keepalive needs to be sent to Endpoint
+      if(endpoint.mTuple.getPort() != 0 &&
+         endpoint.mRelayDatagram.get() == 0 &&
+         ((!endpoint.mKeepaliveMode && (now - endpoint.mSendTimeMs) > KEEPALIVETIMEOUTMS) ||
+          (endpoint.mKeepaliveMode && (now - endpoint.mSendTimeMs) > KEEPALIVEMS)))
+      {
+         RtpHeader keepalive;  // Create an empty G711 packet to keep iChat happy
+         keepalive.versionExtPayloadTypeAndMarker = htons(0x8000);
+         keepalive.sequenceNumber = 0;
+         keepalive.timestamp = 0;
+         keepalive.ssrc = endpoint.mSsrc;
+
+         if(!endpoint.mKeepaliveMode)
+         {
+            InfoLog(<< "MediaRelay::checkKeepalives: port=" << relayPort->mLocalV4Tuple.getPort() << ", dispatching initial RTP keepalive to " << names[i] << " sender!"); 
+            endpoint.mKeepaliveMode = true;
+         }
+
+         if(!send(relay, endpoint, (const char*)&keepalive, sizeof(RtpHeader), now))
+         {
+            // Add message to buffer
+            std::auto_ptr<char> buffer(new char[sizeof(RtpHeader)]); 
+            memcpy(buffer.get(), &keepalive, sizeof(RtpHeader));
       
-      relayPort->mFirstEndpoint.mRelayDatagram = buffer;
-      relayPort->mFirstEndpoint.mRelayDatagramLen = sizeof(RtpHeader);
+            endpoint.mRelayDatagram = buffer;
+            endpoint.mRelayDatagramLen = sizeof(RtpHeader);
+         }
+      }
    }
+   updateEvents(relay);
+}
 
-   // See if keepalive needs to be sent to Second Endpoint
-   if(relayPort->mSecondEndpoint.mTuple.getPort() != 0 &&
-      relayPort->mSecondEndpoint.mRelayDatagram.get() == 0 &&
-      ((!relayPort->mSecondEndpoint.mKeepaliveMode && (now - relayPort->mSecondEndpoint.mSendTimeMs) > KEEPALIVETIMEOUTMS) ||
-       (relayPort->mSecondEndpoint.mKeepaliveMode && (now - relayPort->mSecondEndpoint.mSendTimeMs) > KEEPALIVEMS)))
+MediaRelay::MediaRelay(bool isV6Avail, unsigned short portRangeMin, unsigned short portRangeMax, unsigned int numThreads, const char* pollImpl) : 
+   mIsV6Avail(isV6Avail)
+{   
+   if(portRangeMax < portRangeMin) portRangeMax = portRangeMin;  // saftey check
+   for(unsigned int i = portRangeMin; i <= portRangeMax; i++)
    {
-      RtpHeader keepalive;  // Create an empty G711 packet to keep iChat happy
-      keepalive.versionExtPayloadTypeAndMarker = htons(0x8000);
-      keepalive.sequenceNumber = 0;
-      keepalive.timestamp = 0;
-      keepalive.ssrc = relayPort->mSecondEndpoint.mSsrc;
+      mFreeRelayPortList.push_back(i);
+   }
+   if(numThreads == 0) numThreads = 1;
+   for(unsigned int i = 0; i < numThreads; i++)
+   {
+      mThreads.push_back(new MediaRelayThread(*this, isV6Avail, pollImpl));
+   }
+   mThreadLoad.resize(numThreads, 0);
+}
 
-      if(!relayPort->mSecondEndpoint.mKeepaliveMode)
-      {
-         InfoLog(<< "MediaRelay::checkKeepalives: port=" << relayPort->mLocalV4Tuple.getPort() << ", dispatching initial RTP keepalive to second sender!"); 
-         relayPort->mSecondEndpoint.mKeepaliveMode = true;
-      }
-      //else
-      //{
-      //   InfoLog(<< "MediaRelay::checkKeepalives: port=" << relayPort->mLocalV4Tuple.getPort() << ", dispatching subsequent RTP keepalive to second sender!"); 
-      //}
-
-      // Add message to buffer
-      std::auto_ptr<char> buffer(new char[sizeof(RtpHeader)]); 
-      memcpy(buffer.get(), &keepalive, sizeof(RtpHeader));
-      
-      relayPort->mSecondEndpoint.mRelayDatagram = buffer;
-      relayPort->mSecondEndpoint.mRelayDatagramLen = sizeof(RtpHeader);
+MediaRelay::~MediaRelay()
+{
+   shutdown();
+   join();
+   for(unsigned int i = 0; i < mThreads.size(); i++)
+   {
+      delete mThreads[i];
    }
 }
 
 void 
-MediaRelay::process(FdSet& fdset)
+MediaRelay::run()
 {
-   Lock lock(mRelaysMutex);
+   for(unsigned int i = 0; i < mThreads.size(); i++)
+   {
+      mThreads[i]->run();
+   }
+}
 
-   RelayPortList::iterator it = mRelays.begin();
-   for(;it != mRelays.end(); it++)
+void 
+MediaRelay::shutdown()
+{
+   for(unsigned int i = 0; i < mThreads.size(); i++)
    {
-      if(processWrites(fdset, it->second))
-      {
-         // If all writes have been processed, process reads
-         processReads(fdset, it->second);
-      }
+      mThreads[i]->shutdown();
    }
 }
 
-bool
-MediaRelay::processWrites(FdSet& fdset, MediaRelayPort* relayPort)
+void 
+MediaRelay::join()
 {
-   resip::Socket fd = INVALID_SOCKET;
-   Tuple tuple;
-   std::auto_ptr<char> buffer;
-   int len;
+   for(unsigned int i = 0; i < mThreads.size(); i++)
+   {
+      mThreads[i]->join();
+   }
+}
 
-   // If we have data to write to first sender then check if readyToWrite
-   if(relayPort->mFirstEndpoint.mRelayDatagram.get() != 0)
+UInt64 
+MediaRelay::getPacketsRelayed() const
+{
+   UInt64 total = 0;
+   for(unsigned int i = 0; i < mThreads.size(); i++)
    {
-      if(relayPort->mFirstEndpoint.mTuple.ipVersion() == V4 &&
-         fdset.readyToWrite(relayPort->mV4Fd))
-      {
-         fd = relayPort->mV4Fd;
-         tuple = relayPort->mFirstEndpoint.mTuple;
-         buffer = relayPort->mFirstEndpoint.mRelayDatagram;
-         len = relayPort->mFirstEndpoint.mRelayDatagramLen;               
-      }
-      else if(mIsV6Avail &&
-              relayPort->mFirstEndpoint.mTuple.ipVersion() == V6 &&
-              fdset.readyToWrite(relayPort->mV6Fd))
-      {
-         fd = relayPort->mV6Fd;
-         tuple = relayPort->mFirstEndpoint.mTuple;
-         buffer = relayPort->mFirstEndpoint.mRelayDatagram;
-         len = relayPort->mFirstEndpoint.mRelayDatagramLen;               
-      }
+      total += mThreads[i]->getPacketsRelayed();
    }
+   return total;
+}
 
-   // If anything to send to first sender then do it
-   if (fd != INVALID_SOCKET)
+#define NUM_CREATE_TRIES 10  // Number of times to try to allocate a port, since port may be in use by another application
+bool 
+MediaRelay::createRelay(unsigned short& port)
+{
+   for(unsigned int i = 0; i < NUM_CREATE_TRIES; i++)
    {
-      int count;
-      count = sendto(fd, 
-                     buffer.get(), 
-                     len,  
-                     0, // flags
-                     &tuple.getMutableSockaddr(), tuple.length());
-      if ( count == SOCKET_ERROR )
-      {
-         int e = getErrno();
-         InfoLog (<< "MediaRelay::processWrites: port=" << relayPort->mLocalV4Tuple.getPort() << ", Failed (" << e << ") sending to " << tuple);
-      }
-      else
-      {
-         // InfoLog(<< len << " bytes of data sent to " << tuple);
-         relayPort->mFirstEndpoint.mSendTimeMs = Timer::getTimeMs();
-      }
+      if(createRelayImpl(port)) return true;
    }
+   return false;
+}
 
-   // check if we have data to write to second sender then check if readyToWrite
-   fd = INVALID_SOCKET; // reset
-   if(relayPort->mSecondEndpoint.mRelayDatagram.get() != 0)
+bool 
+MediaRelay::createRelayImpl(unsigned short& port)
+{
+   Lock lock(mRelaysMutex);
+
+   if(mFreeRelayPortList.empty()) return false;
+
+   unsigned short trialPort = mFreeRelayPortList.front();
+   mFreeRelayPortList.pop_front();
+
+   Tuple v4tuple(Data::Empty,trialPort,V4,UDP,Data::Empty);
+   resip::Socket v4fd = createRelaySocket(v4tuple);
+
+   if(v4fd == INVALID_SOCKET)
    {
-      if(relayPort->mSecondEndpoint.mTuple.ipVersion() == V4 &&
-         fdset.readyToWrite(relayPort->mV4Fd))
-      {
-         fd = relayPort->mV4Fd;
-         tuple = relayPort->mSecondEndpoint.mTuple;
-         buffer = relayPort->mSecondEndpoint.mRelayDatagram;
-         len = relayPort->mSecondEndpoint.mRelayDatagramLen;               
-      }
-      else if(mIsV6Avail && 
-              relayPort->mSecondEndpoint.mTuple.ipVersion() == V6 &&
-              fdset.readyToWrite(relayPort->mV6Fd))
-      {
-         fd = relayPort->mV6Fd;
-         tuple = relayPort->mSecondEndpoint.mTuple;
-         buffer = relayPort->mSecondEndpoint.mRelayDatagram;
-         len = relayPort->mSecondEndpoint.mRelayDatagramLen;               
-      }
+      mFreeRelayPortList.push_back(trialPort);
+      return false;
    }
 
-   // If anything to send to sender sender then do it
-   if (fd != INVALID_SOCKET)
+   MediaRelayPort* relayPort = 0;
+   if(mIsV6Avail)
    {
-      int count;
-      count = sendto(fd, 
-                     buffer.get(), 
-                     len,  
-                     0, // flags
-                     &tuple.getMutableSockaddr(), tuple.length());
-      if ( count == SOCKET_ERROR )
-      {
-         int e = getErrno();
-         InfoLog (<< "MediaRelay::processWrites: port=" << relayPort->mLocalV4Tuple.getPort() << ", Failed (" << e << ") sending to " << tuple);
-      }
-      else
+      Tuple v6tuple(Data::Empty,trialPort,V6,UDP,Data::Empty);
+      resip::Socket v6fd = createRelaySocket(v6tuple);
+
+      if(v6fd == INVALID_SOCKET)
       {
-         //InfoLog(<< len << " bytes of data sent to " << tuple);
-         relayPort->mSecondEndpoint.mSendTimeMs = Timer::getTimeMs();
+#if defined(WIN32)
+         closesocket(v4fd);
+#else
+         close(v4fd); 
+#endif
+
+         mFreeRelayPortList.push_back(trialPort);
+         return false;
       }
+      relayPort = new MediaRelayPort(v4fd, v4tuple, v6fd, v6tuple);
+   }
+   else
+   {
+      // Only V4 is available
+      relayPort = new MediaRelayPort(v4fd, v4tuple);
+   }
+
+   // Hand the port to the least loaded thread, it stays there until destroyed
+   unsigned int owner = 0;
+   for(unsigned int i = 1; i < mThreadLoad.size(); i++)
+   {
+      if(mThreadLoad[i] < mThreadLoad[owner]) owner = i;
    }
+   port = trialPort;
+   mRelays[port] = owner;
+   mThreadLoad[owner]++;
+   mThreads[owner]->addRelay(port, relayPort);
+   InfoLog(<< "MediaRelay::createRelayImpl - Media relay started for port " << port << " on thread " << owner);
 
-   return relayPort->mFirstEndpoint.mRelayDatagram.get() == 0 &&
-          relayPort->mSecondEndpoint.mRelayDatagram.get() == 0;
+   return true;
 }
 
-#define UDP_BUFFER_SIZE 1000
 void 
-MediaRelay::processReads(FdSet& fdset, MediaRelayPort* relayPort)
+MediaRelay::destroyRelay(unsigned short port)
 {
-   resip::Socket fd = INVALID_SOCKET;
-   Tuple tuple;
-
-   if(fdset.readyToRead(relayPort->mV4Fd))
+   Lock lock(mRelaysMutex);
+   RelayPortList::iterator it = mRelays.find(port);
+   if(it != mRelays.end())
    {
-      //InfoLog(<<"V4 socket is ready to read.");
-      fd = relayPort->mV4Fd;
-      tuple = relayPort->mLocalV4Tuple;
+      InfoLog(<< "MediaRelay::destroyRelay - port=" << port);
+      // the port goes back on the free list once the owning thread has closed it
+      mThreadLoad[it->second]--;
+      mThreads[it->second]->removeRelay(port);
+      mRelays.erase(it);
    }
-   else if(mIsV6Avail && fdset.readyToRead(relayPort->mV6Fd))
+}
+
+void 
+MediaRelay::onRelayDestroyed(unsigned short port)
+{
+   Lock lock(mRelaysMutex);
+   mFreeRelayPortList.push_back(port);
+}
+
+void 
+MediaRelay::primeNextEndpoint(unsigned short& port, resip::Tuple& destinationIPPort)
+{
+   Lock lock(mRelaysMutex);
+   RelayPortList::iterator it = mRelays.find(port);
+   if(it != mRelays.end())
    {
-      //InfoLog(<<"V6 socket is ready to read.");
-      fd = relayPort->mV6Fd;
-      tuple = relayPort->mLocalV6Tuple;
+      mThreads[it->second]->primeNextEndpoint(port, destinationIPPort);
    }
-   if (fd != INVALID_SOCKET)
-   {
-      std::auto_ptr<char> buffer(new char[UDP_BUFFER_SIZE+1]); 
+}
 
-      socklen_t slen = tuple.length();
-      int len = recvfrom( fd,
-                          buffer.get(),
-                          UDP_BUFFER_SIZE,
-                          0 /*flags */,
-                          &tuple.getMutableSockaddr(), 
-                          &slen);
-      if ( len == SOCKET_ERROR )
-      {
-         int err = getErrno();
-         if ( err != EWOULDBLOCK  )
-         {
-            ErrLog (<< "MediaRelay::processReads: port=" << relayPort->mLocalV4Tuple.getPort() << ", Error calling recvfrom: " << err);
-         }
-         buffer.reset();
-      }
+resip::Socket 
+MediaRelay::createRelaySocket(resip::Tuple& tuple)
+{
+   resip::Socket fd;
 
-      if (len == 0)
+#ifdef USE_IPV6
+   fd = ::socket(tuple.ipVersion() == V4 ? PF_INET : PF_INET6, SOCK_DGRAM, 0);
+#else
+   fd = ::socket(PF_INET, SOCK_DGRAM, 0);
+#endif
+   
+   if ( fd == INVALID_SOCKET )
+   {
+      int e = getErrno();
+      ErrLog (<< "MediaRelay::createRelaySocket - Failed to create socket: " << strerror(e));
+      return INVALID_SOCKET;
+   }
+
+   DebugLog (<< "MediaRelay::createRelaySocket - Creating fd=" << (int)fd 
+             << (tuple.ipVersion() == V4 ? " V4" : " V6") 
+             << ", Binding to " << Tuple::inet_ntop(tuple));
+   
+   if ( ::bind( fd, &tuple.getSockaddr(), tuple.length()) == SOCKET_ERROR )
+   {
+      int e = getErrno();
+      if ( e == EADDRINUSE )
       {
-         ErrLog (<< "MediaRelay::processReads: port=" << relayPort->mLocalV4Tuple.getPort() << ", No data calling recvfrom: len=" << len);
-         buffer.reset();
+         ErrLog (<< "MediaRelay::createRelaySocket - " << tuple << " already in use ");
       }
-
-      if (len+1 >= UDP_BUFFER_SIZE)
+      else
       {
-         InfoLog(<<"MediaRelay::processReads: port=" << relayPort->mLocalV4Tuple.getPort() << ", Datagram exceeded max length "<<UDP_BUFFER_SIZE);
-         buffer.reset();
+         ErrLog (<< "MediaRelay::createRelaySocket - Could not bind to " << tuple << ", error=" << e);
       }
-
-      if(buffer.get() != 0)
+      return INVALID_SOCKET;
+   }
+   
+   if(tuple.getPort() == 0)
+   {
+      // If we used port 0, then query what port the OS allocated for us
+      socklen_t len = tuple.length();
+      if(::getsockname(fd, &tuple.getMutableSockaddr(), &len) == SOCKET_ERROR)
       {
-         UInt64 now = Timer::getTimeMs();
-         RtpHeader* rtpHeader = (RtpHeader*)buffer.get();
-         //InfoLog(<< "Received a datagram of size=" << len << " from=" << tuple);
-         MediaEndpoint* pReceivingEndpoint = 0;
-         MediaEndpoint* pSendingEndpoint = 0;
-
-         // First check if packet is from first endpoint
-         if(tuple == relayPort->mFirstEndpoint.mTuple)
-         {
-            pReceivingEndpoint = &relayPort->mFirstEndpoint;
-            pSendingEndpoint = &relayPort->mSecondEndpoint;
-         }
-         // Next check if packet is from second endpoint
-         else if(tuple == relayPort->mSecondEndpoint.mTuple)
-         {
-            pReceivingEndpoint = &relayPort->mSecondEndpoint;
-            pSendingEndpoint = &relayPort->mFirstEndpoint;
-         }
-         else
-         {
-            // See if we can store this new sender in First Endpoint
-            if(relayPort->mFirstEndpoint.mTuple.getPort() == 0)
-            {
-               InfoLog(<< "MediaRelay::processReads: port=" << relayPort->mLocalV4Tuple.getPort() << ", First packet received from First Endpoint " << tuple);
-               pReceivingEndpoint = &relayPort->mFirstEndpoint;
-               pSendingEndpoint = &relayPort->mSecondEndpoint;
-            }
-            else if(relayPort->mSecondEndpoint.mTuple.getPort() == 0)
-            {
-               InfoLog(<< "MediaRelay::processReads: port=" << relayPort->mLocalV4Tuple.getPort() << ", First packet received from Second Endpoint " << tuple);
-               pReceivingEndpoint = &relayPort->mSecondEndpoint;
-               pSendingEndpoint = &relayPort->mFirstEndpoint;
-            }
-            else  // We already have 2 endpoints - this would be a third
-            {
-               // We have a third sender - for now drop, if one of the other senders stops sending data for 2 seconds then we will start picking up this sender
-               WarningLog(<< "MediaRelay::processReads: port=" << relayPort->mLocalV4Tuple.getPort() << ", MediaRelay on " << relayPort->mLocalV4Tuple.getPort() << " has seen a third sender " << tuple << " - not implemented yet - ignoring packet");
-            }
-            if(pReceivingEndpoint)
-            {
-               pReceivingEndpoint->mTuple = tuple;
-               pReceivingEndpoint->mSendTimeMs = now;
-               pReceivingEndpoint->mRecvTimeMs = now;
-            }
-         }
-
-         if(pReceivingEndpoint)
-         {
-            pReceivingEndpoint->mRecvTimeMs = now;
-            if(pSendingEndpoint && pSendingEndpoint->mTuple.getPort() != 0)
-            {
-               if(ntohs(rtpHeader->versionExtPayloadTypeAndMarker) & 0x8000)  // RTP Version 2
-               {
-                  // Adjust ssrc
-                  rtpHeader->ssrc = pSendingEndpoint->mSsrc;
-
-                  // relay packet to second sender
-                  resip_assert(pSendingEndpoint->mRelayDatagram.get() == 0);
-                  pSendingEndpoint->mRelayDatagram = buffer;
-                  pSendingEndpoint->mRelayDatagramLen = len;
-                  if(pSendingEndpoint->mKeepaliveMode)
-                  {
-                     InfoLog(<< "MediaRelay::processReads: port=" << relayPort->mLocalV4Tuple.getPort() << ", received packet to forward, turning off keepalive mode for " << pSendingEndpoint->mTuple);
-                     pSendingEndpoint->mKeepaliveMode = false;
-                  }
-
-                  //InfoLog(<< "Relaying packet from=" << tuple << " to " << pSendingEndpoint->mTuple);
-               }
-               //else
-               //{
-               //   InfoLog(<< "MediaRelay::processReads: port=" << relayPort->mLocalV4Tuple.getPort() << ", discarding received packet with unknown RTP version from " << tuple);
-               //}
-            }
-         }
+         int e = getErrno();
+         ErrLog (<<"MediaRelay::createRelaySocket - getsockname failed, error=" << e);
+         return INVALID_SOCKET;
       }
    }
+
+   bool ok = makeSocketNonBlocking(fd);
+   if ( !ok )
+   {
+      ErrLog (<< "MediaRelay::createRelaySocket - Could not make socket non-blocking");
+      return INVALID_SOCKET;
+   }  
+   return fd;
 }
 
 /* ====================================================================
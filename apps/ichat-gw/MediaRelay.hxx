@@ -3,7 +3,12 @@
 
 #include <map>
 #include <deque>
+#include <vector>
 #include <rutil/Data.hxx>
+#include <rutil/FdPoll.hxx>
+#include <rutil/Fifo.hxx>
+#include <rutil/Mutex.hxx>
+#include <rutil/SelectInterruptor.hxx>
 #include <rutil/Socket.hxx>
 #include <rutil/ThreadIf.hxx>
 #include <rutil/TransportType.hxx>
@@ -14,36 +19,138 @@
 namespace gateway
 {
 
-class MediaRelay : public resip::ThreadIf
+class MediaRelay;
+
+// Relays RTP for the set of ports it owns.  Each thread has its own FdPollGrp,
+// and only the relay thread touches its ports and poll registrations - other
+// threads hand it work through a command fifo that wakes the poll loop.
+class MediaRelayThread : public resip::ThreadIf
+{
+public:
+   MediaRelayThread(MediaRelay& mediaRelay, bool isV6Avail, const char* pollImpl);
+   virtual ~MediaRelayThread();
+
+   // May be called from any thread
+   void addRelay(unsigned short port, MediaRelayPort* relayPort);
+   void removeRelay(unsigned short port);
+   void primeNextEndpoint(unsigned short port, const resip::Tuple& destinationIPPort);
+
+   virtual void shutdown();
+
+   UInt64 getPacketsRelayed() const { return mPacketsRelayed; }
+
+private:
+   class Command
+   {
+   public:
+      typedef enum
+      {
+         Add,
+         Remove,
+         Prime
+      } Type;
+
+      Command(Type type, unsigned short port) : mType(type), mPort(port), mRelayPort(0) {}
+
+      Type mType;
+      unsigned short mPort;
+      MediaRelayPort* mRelayPort;
+      resip::Tuple mTuple;
+   };
+
+   class Relay;
+
+   class RelaySocket : public resip::FdPollItemIf
+   {
+   public:
+      RelaySocket(MediaRelayThread& thread, Relay& relay, resip::Socket fd, const resip::Tuple& localTuple);
+      virtual void processPollEvent(resip::FdPollEventMask mask);
+
+      MediaRelayThread& mThread;
+      Relay& mRelay;
+      resip::Socket mFd;
+      const resip::Tuple& mLocalTuple;
+      resip::FdPollItemHandle mHandle;
+      resip::FdPollEventMask mMask;
+   };
+
+   class Relay
+   {
+   public:
+      Relay(MediaRelayThread& thread, MediaRelayPort* relayPort);
+      ~Relay();
+
+      MediaRelayPort* mRelayPort;
+      RelaySocket mV4;
+      RelaySocket* mV6;
+   };
+
+   virtual void thread();
+
+   void processTimers(UInt64 now);
+   void processCommands();
+   void addRelayImpl(unsigned short port, MediaRelayPort* relayPort);
+   void removeRelayImpl(unsigned short port);
+   void registerSocket(RelaySocket& socket);
+   void unregisterSocket(RelaySocket& socket);
+   void updateEvents(Relay& relay);
+
+   void processSocket(Relay& relay, RelaySocket& socket, resip::FdPollEventMask mask);
+   bool processReads(Relay& relay, RelaySocket& socket);  // returns false when no more data can be read
+   bool processWrites(Relay& relay);  // return true if all writes are complete
+   bool send(Relay& relay, MediaEndpoint& endpoint, const char* buffer, int len, UInt64 now);
+   void checkKeepalives(Relay& relay, UInt64 now);
+
+   MediaRelay& mMediaRelay;
+   bool mIsV6Avail;
+   std::auto_ptr<resip::FdPollGrp> mPollGrp;
+   resip::SelectInterruptor mInterruptor;
+   resip::FdPollItemHandle mInterruptorHandle;
+   resip::Fifo<Command> mCommands;
+
+   typedef std::map<unsigned short, Relay*> RelayList;
+   RelayList mRelays;   // only used on the relay thread
+   UInt64 mNextKeepaliveCheck;
+   std::vector<char> mBuffer;
+   volatile UInt64 mPacketsRelayed;
+};
+
+// Allocates relay ports and spreads them over a pool of MediaRelayThreads.
+// A port stays with the thread it was assigned to for its whole lifetime.
+class MediaRelay
 {      
 public:
-   MediaRelay(bool isV6Avail, unsigned short portRangeMin, unsigned short portRangeMax);
+   MediaRelay(bool isV6Avail, unsigned short portRangeMin, unsigned short portRangeMax, unsigned int numThreads = 1, const char* pollImpl = 0);
    virtual ~MediaRelay();
 
+   void run();
+   void shutdown();
+   void join();
+
    bool createRelay(unsigned short& port);
    void destroyRelay(unsigned short port);
 
    void primeNextEndpoint(unsigned short& port, resip::Tuple& destinationIPPort);
 
+   UInt64 getPacketsRelayed() const;
+
 protected:
 
 private:
-   virtual void thread();
-
-   void buildFdSet(resip::FdSet& fdset);
-   void checkKeepalives(MediaRelayPort* relayPort);  
-   void process(resip::FdSet& fdset);
-   bool processWrites(resip::FdSet& fdset, MediaRelayPort* relayPort);  // return true if all writes are complete
-   void processReads(resip::FdSet& fdset, MediaRelayPort* relayPort);  
+   friend class MediaRelayThread;
+   void onRelayDestroyed(unsigned short port);
 
    bool createRelayImpl(unsigned short& port);
    resip::Socket createRelaySocket(resip::Tuple& tuple);
 
-   typedef std::map<unsigned short, MediaRelayPort*> RelayPortList;
+   typedef std::map<unsigned short, unsigned int> RelayPortList;  // port -> index of owning thread
    RelayPortList mRelays;
    resip::Mutex mRelaysMutex;
    bool mIsV6Avail;
 
+   std::vector<MediaRelayThread*> mThreads;
+   std::vector<unsigned int> mThreadLoad;  // relays per thread
+
    std::deque<unsigned int> mFreeRelayPortList;
 };
 
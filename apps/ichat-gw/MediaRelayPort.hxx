@@ -28,7 +28,7 @@ public:
    void reset() 
    { 
       mTuple = resip::Tuple();
-      mRelayDatagram.release();
+      mRelayDatagram.reset();
       mRelayDatagramLen = 0; 
       mKeepaliveMode = false;
    }
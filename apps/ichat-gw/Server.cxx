@@ -215,6 +215,7 @@ Server::Server(int argc, char** argv) :
    }
    InfoLog( << "  CodecIdFilterList = " << codecIdFilterListString);
    InfoLog( << "  MediaRelayPortRange = " << mMediaRelayPortRangeMin << "-" << mMediaRelayPortRangeMax);
+   InfoLog( << "  MediaRelayThreads = " << mMediaRelayThreads);
    InfoLog( << "  JabberServer = " << mJabberServer);
    InfoLog( << "  JabberComponentName = " << mJabberComponentName);
    //InfoLog( << "  JabberComponentPassword = " << mJabberComponentPassword);  Don't output password
@@ -335,7 +336,7 @@ Server::Server(int argc, char** argv) :
 #endif
 
    // Start Media Relay
-   mMediaRelay = new MediaRelay(mIsV6Avail, mMediaRelayPortRangeMin, mMediaRelayPortRangeMax);
+   mMediaRelay = new MediaRelay(mIsV6Avail, mMediaRelayPortRangeMin, mMediaRelayPortRangeMax, mMediaRelayThreads);
    
    SecurityTypes::TlsClientVerificationMode cvm = SecurityTypes::None;
    SecurityTypes::SSLType sslType = SecurityTypes::SSLv23;
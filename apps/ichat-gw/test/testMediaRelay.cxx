@@ -0,0 +1,266 @@
+// Loopback benchmark for the MediaRelay.  For each relay port two UDP clients are
+// created on 127.0.0.1 and primed as the relay endpoints.  Each pair keeps a
+// window of RTP packets bouncing through the relay; every packet a client
+// receives is sent straight back, so the number of packets relayed per second
+// is bounded only by the relay (and the single client thread).
+//
+// usage: testMediaRelay [numPorts] [numThreads] [seconds] [pollImpl]
+
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+
+#include "rutil/Log.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Socket.hxx"
+#include "rutil/Timer.hxx"
+#include "rutil/FdPoll.hxx"
+#include "resip/stack/Tuple.hxx"
+
+#include "../AppSubsystem.hxx"
+#include "../MediaRelay.hxx"
+
+using namespace gateway;
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM AppSubsystem::GATEWAY
+
+#define BASE_PORT 21000
+#define PACKET_SIZE 172  // 20ms of G711 plus an RTP header
+#define WINDOW 4         // packets kept in flight per client pair
+#define KEEPALIVE_SIZE 12
+
+// Clients stop echoing once the run is over.  epoll keeps dispatching while
+// its event cache is full, so waitAndProcess may not return until then.
+static UInt64 endTime = 0;
+
+class Client : public FdPollItemIf
+{
+   public:
+      Client(const Tuple& relayTuple) :
+         mRelayTuple(relayTuple),
+         mFd(INVALID_SOCKET),
+         mHandle(0),
+         mReceived(0),
+         mLastReceived(0)
+      {
+         mFd = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+         resip_assert(mFd != INVALID_SOCKET);
+         Tuple local("127.0.0.1", 0, V4, UDP);
+         if(::bind(mFd, &local.getSockaddr(), local.length()) != 0)
+         {
+            cerr << "bind failed: " << getErrno() << endl;
+            exit(-1);
+         }
+         mTuple = local;
+         socklen_t len = mTuple.length();
+         ::getsockname(mFd, &mTuple.getMutableSockaddr(), &len);
+         makeSocketNonBlocking(mFd);
+         memset(mPacket, 0, sizeof(mPacket));
+         mPacket[0] = (char)0x80;  // RTP version 2
+      }
+      virtual ~Client()
+      {
+         closeSocket(mFd);
+      }
+
+      void send()
+      {
+         ::sendto(mFd, mPacket, PACKET_SIZE, 0, &mRelayTuple.getSockaddr(), mRelayTuple.length());
+      }
+
+      virtual void processPollEvent(FdPollEventMask mask)
+      {
+         char buffer[2048];
+         for(int i = 0; i < WINDOW*2; i++)
+         {
+            int len = ::recv(mFd, buffer, sizeof(buffer), 0);
+            if(len <= 0)
+            {
+               break;
+            }
+            if(len == KEEPALIVE_SIZE)
+            {
+               continue;  // relay keepalive, not one of ours
+            }
+            mReceived++;
+            if(Timer::getTimeMs() < endTime)
+            {
+               send();
+            }
+         }
+      }
+
+      Tuple mRelayTuple;
+      Tuple mTuple;
+      Socket mFd;
+      FdPollItemHandle mHandle;
+      UInt64 mReceived;
+      UInt64 mLastReceived;
+      char mPacket[PACKET_SIZE];
+};
+
+int
+main(int argc, char* argv[])
+{
+   unsigned int numPorts = argc > 1 ? atoi(argv[1]) : 100;
+   unsigned int numThreads = argc > 2 ? atoi(argv[2]) : 1;
+   unsigned int seconds = argc > 3 ? atoi(argv[3]) : 5;
+   const char* pollImpl = argc > 4 ? argv[4] : 0;
+
+   Log::initialize(Log::Cout, Log::Warning, argv[0]);
+   increaseLimitFds(numPorts*3 + 100);
+
+   MediaRelay relay(false /* isV6Avail */, BASE_PORT, BASE_PORT + numPorts - 1, numThreads, pollImpl);
+   relay.run();
+
+   std::auto_ptr<FdPollGrp> pollGrp(FdPollGrp::create(pollImpl));
+   vector<Client*> clients;
+   vector<unsigned short> ports;
+   for(unsigned int i = 0; i < numPorts; i++)
+   {
+      unsigned short port;
+      if(!relay.createRelay(port))
+      {
+         cerr << "Failed to create relay " << i << endl;
+         return -1;
+      }
+      ports.push_back(port);
+      Tuple relayTuple("127.0.0.1", port, V4, UDP);
+      for(int j = 0; j < 2; j++)
+      {
+         Client* client = new Client(relayTuple);
+         client->mHandle = pollGrp->addPollItem(client->mFd, FPEM_Read, client);
+         relay.primeNextEndpoint(port, client->mTuple);
+         clients.push_back(client);
+      }
+   }
+
+   // Give the relay threads a chance to pick up the new ports
+   UInt64 start = Timer::getTimeMs();
+   while(Timer::getTimeMs() - start < 200)
+   {
+      pollGrp->waitAndProcess(10);
+   }
+
+   cerr << "Relaying through " << numPorts << " ports using " << numThreads << " thread(s), "
+        << pollGrp->getImplName() << " for " << seconds << "s" << endl;
+
+   start = Timer::getTimeMs();
+   endTime = start + seconds*1000;
+   UInt64 startRelayed = relay.getPacketsRelayed();
+   UInt64 nextCheck = start + 500;
+   UInt64 refills = 0;
+   for(unsigned int i = 0; i < clients.size(); i += 2)
+   {
+      for(int w = 0; w < WINDOW; w++)
+      {
+         clients[i]->send();
+      }
+   }
+   for(;;)
+   {
+      UInt64 now = Timer::getTimeMs();
+      if(now >= endTime)
+      {
+         break;
+      }
+      if(now >= nextCheck)
+      {
+         // UDP is lossy - restart any pair whose window has drained
+         for(unsigned int i = 0; i < clients.size(); i += 2)
+         {
+            UInt64 received = clients[i]->mReceived + clients[i+1]->mReceived;
+            if(received == clients[i]->mLastReceived)
+            {
+               refills++;
+               for(int w = 0; w < WINDOW; w++)
+               {
+                  clients[i]->send();
+               }
+            }
+            clients[i]->mLastReceived = received;
+         }
+         nextCheck = now + 500;
+      }
+      pollGrp->waitAndProcess(10);
+   }
+   UInt64 elapsed = Timer::getTimeMs() - start;
+   UInt64 relayed = relay.getPacketsRelayed() - startRelayed;
+
+   UInt64 received = 0;
+   for(unsigned int i = 0; i < clients.size(); i++)
+   {
+      received += clients[i]->mReceived;
+   }
+
+   cerr << "Relayed " << relayed << " packets in " << elapsed << "ms = " 
+        << (relayed * 1000 / (elapsed ? elapsed : 1)) << " packets/s (" 
+        << received << " received by clients, " << refills << " window refills)" << endl;
+
+   for(unsigned int i = 0; i < clients.size(); i++)
+   {
+      pollGrp->delPollItem(clients[i]->mHandle);
+      delete clients[i];
+   }
+   for(unsigned int i = 0; i < ports.size(); i++)
+   {
+      relay.destroyRelay(ports[i]);
+   }
+   relay.shutdown();
+   relay.join();
+
+   return received > 0 ? 0 : -1;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -7,9 +7,13 @@
 #include <iostream>
 #include <fstream>
 #include <ctime>
+#include <stdio.h>
 
+#include <rutil/Lock.hxx>
 #include <rutil/Log.hxx>
 #include <rutil/Logger.hxx>
+#include <rutil/Socket.hxx>
+#include <rutil/Timer.hxx>
 #include <AppSubsystem.hxx>
 
 #define RESIPROCATE_SUBSYSTEM AppSubsystem::RECONSERVER
@@ -18,59 +22,451 @@ using namespace resip;
 using namespace recon;
 using namespace reconserver;
 
-CDRFile::CDRFile(const resip::Data& filename)
-    : mSep(',')
+// a batch is written early once this much output has accumulated
+static const Data::size_type MaxBatchBytes = 64 * 1024;
+static const unsigned int MaxBatchRecords = 1024;
+// upper bound on how long the writer waits between shutdown checks
+static const unsigned int MaxWaitMs = 250;
+
+CDRFile::Statistics::Statistics() :
+   mQueueDepth(0),
+   mMaxQueueDepth(0),
+   mWritten(0),
+   mDropped(0),
+   mBatches(0),
+   mBytes(0),
+   mRotations(0)
 {
-   mFile.open(filename.c_str(), std::ios::app);
+}
+
+CDRFile::CDRFile(const resip::Data& filename,
+                 Format format,
+                 unsigned int maxQueueSize,
+                 unsigned int flushIntervalMs,
+                 UInt64 rotateSize,
+                 unsigned int rotateIntervalSecs)
+    : mFilename(filename),
+      mFormat(format),
+      mMaxQueueSize(maxQueueSize),
+      mFlushIntervalMs(flushIntervalMs),
+      mRotateSize(rotateSize),
+      mRotateIntervalSecs(rotateIntervalSecs),
+      mSep(','),
+      mFileSize(0),
+      mFileOpened(0),
+      mBufferedRecords(0),
+      mMaxQueueDepth(0),
+      mWritten(0),
+      mDropped(0),
+      mBatches(0),
+      mBytes(0),
+      mRotations(0)
+{
+   openFile();
 }
 
 CDRFile::~CDRFile()
 {
+   shutdown();
+   join();
+
+   // write anything queued after the writer thread stopped
+   Fifo<Record>::Messages remaining;
+   if(mFifo.getMultiple(-1, remaining, mFifo.size() + 1))
+   {
+      formatBatch(remaining);
+   }
+   writeBatch();
+   logStatistics();
    mFile.close();
 }
 
+bool
+CDRFile::parseFormat(const Data& name, Format& format)
+{
+   if(isEqualNoCase(name, "csv"))
+   {
+      format = CSV;
+   }
+   else if(isEqualNoCase(name, "json"))
+   {
+      format = JSON;
+   }
+   else if(isEqualNoCase(name, "binary"))
+   {
+      format = Binary;
+   }
+   else
+   {
+      return false;
+   }
+   return true;
+}
+
 void
 CDRFile::log(SharedPtr <B2BCall> call)
 {
-   logString(call->getB2BCallID());
-   logString(call->getCaller());
-   logString(call->getCallee());
-   logString(call->getOriginZone());
-   logString(call->getDestinationZone());
-   logTimestamp(call->getStart());
-   Data disposition;
-   if(call->answered())
+   if(mFifo.size() >= mMaxQueueSize)
    {
-      logTimestamp(call->getConnect());
-      disposition = "ANSWERED";
+      Lock lock(mStatsMutex);
+      mDropped++;
+      if(mDropped == 1 || mDropped % 1000 == 0)
+      {
+         WarningLog(<<"CDR queue is full (" << mMaxQueueSize << " records), "
+                    << mDropped << " records dropped so far");
+      }
+      return;
+   }
+
+   Record* r = new Record;
+   r->mCallID = call->getB2BCallID();
+   r->mCaller = call->getCaller();
+   r->mCallee = call->getCallee();
+   r->mOriginZone = call->getOriginZone();
+   r->mDestinationZone = call->getDestinationZone();
+   r->mStart = call->getStart();
+   r->mConnect = call->getConnect();
+   r->mFinish = call->getFinish();
+   r->mResponseCode = call->getResponseCode();
+   r->mAnswered = call->answered();
+   if(r->mAnswered)
+   {
+      r->mDisposition = "ANSWERED";
    }
    else
    {
-      logString(Data::Empty);
-      switch(call->getResponseCode())
+      switch(r->mResponseCode)
       {
       case 486:
-         disposition = "BUSY";
+         r->mDisposition = "BUSY";
          break;
       case 487:
-         disposition = "NO ANSWER";
+         r->mDisposition = "NO ANSWER";
          break;
       default:
-         disposition = "FAILED";
+         r->mDisposition = "FAILED";
+      }
+   }
+
+   size_t depth = mFifo.add(r);
+   Lock lock(mStatsMutex);
+   if(depth > mMaxQueueDepth)
+   {
+      mMaxQueueDepth = depth;
+   }
+}
+
+void
+CDRFile::thread()
+{
+   UInt64 nextFlush = Timer::getTimeMs() + mFlushIntervalMs;
+   while(!isShutdown())
+   {
+      UInt64 now = Timer::getTimeMs();
+      int waitMs = (int)resipMin((UInt64)MaxWaitMs, nextFlush > now ? nextFlush - now : 1);
+      Fifo<Record>::Messages batch;
+      if(mFifo.getMultiple(resipMax(waitMs, 1), batch, MaxBatchRecords))
+      {
+         formatBatch(batch);
+      }
+
+      now = Timer::getTimeMs();
+      if(now >= nextFlush)
+      {
+         writeBatch();
+         nextFlush = now + mFlushIntervalMs;
       }
    }
-   logTimestamp(call->getFinish());
-   logTimediff(call->getFinish() - call->getStart());
-   if(call->answered())
+}
+
+void
+CDRFile::getStatistics(Statistics& stats) const
+{
+   stats.mQueueDepth = mFifo.size();
+   Lock lock(mStatsMutex);
+   stats.mMaxQueueDepth = mMaxQueueDepth;
+   stats.mWritten = mWritten;
+   stats.mDropped = mDropped;
+   stats.mBatches = mBatches;
+   stats.mBytes = mBytes;
+   stats.mRotations = mRotations;
+}
+
+void
+CDRFile::logStatistics() const
+{
+   Statistics stats;
+   getStatistics(stats);
+   InfoLog(<<"CDR writer: queue depth = " << stats.mQueueDepth
+           << " (max " << stats.mMaxQueueDepth << " of " << mMaxQueueSize << ")"
+           << " written = " << stats.mWritten
+           << " dropped = " << stats.mDropped
+           << " batches = " << stats.mBatches
+           << " bytes = " << stats.mBytes
+           << " rotations = " << stats.mRotations);
+}
+
+void
+CDRFile::openFile()
+{
+   std::ios::openmode mode = std::ios::app;
+   if(mFormat == Binary)
+   {
+      mode |= std::ios::binary;
+   }
+   mFile.open(mFilename.c_str(), mode);
+   if(!mFile.is_open())
+   {
+      ErrLog(<<"failed to open CDR file " << mFilename);
+   }
+   mFile.seekp(0, std::ios::end);
+   std::streamoff size = mFile.tellp();
+   mFileSize = size > 0 ? (UInt64)size : 0;
+   mFileOpened = time(0);
+}
+
+void
+CDRFile::rotate()
+{
+   mFile.close();
+
+   char datebuf[32];
+   const time_t now = time(0);
+   struct tm localTimeResult;
+   strftime(datebuf, sizeof(datebuf), "%Y%m%d-%H%M%S",
+#ifdef WIN32
+            localtime(&now));
+#else
+            localtime_r(&now, &localTimeResult));
+#endif
+   Data target = mFilename + "." + datebuf;
+   // more than one rotation in the same second
+   for(int i = 1; std::ifstream(target.c_str()).good(); i++)
+   {
+      target = mFilename + "." + datebuf + "." + Data(i);
+   }
+   if(::rename(mFilename.c_str(), target.c_str()) != 0)
    {
-      logTimediff(call->getFinish() - call->getConnect());
+      ErrLog(<<"failed to rename CDR file " << mFilename << " to " << target);
+   }
+   else
+   {
+      InfoLog(<<"rotated CDR file to " << target);
+      Lock lock(mStatsMutex);
+      mRotations++;
+   }
+   openFile();
+}
+
+void
+CDRFile::writeBatch()
+{
+   if(mFileSize > 0 &&
+      ((mRotateSize > 0 && mFileSize + mBuffer.size() > mRotateSize) ||
+       (mRotateIntervalSecs > 0 && (UInt64)time(0) >= mFileOpened + mRotateIntervalSecs)))
+   {
+      rotate();
+   }
+   if(mBuffer.empty())
+   {
+      return;
+   }
+
+   mFile.write(mBuffer.data(), mBuffer.size());
+   mFile.flush();
+   if(!mFile.good())
+   {
+      ErrLog(<<"failed to write " << mBufferedRecords << " records to CDR file " << mFilename);
+      mFile.clear();
+   }
+   mFileSize += mBuffer.size();
+
+   {
+      Lock lock(mStatsMutex);
+      mWritten += mBufferedRecords;
+      mBatches++;
+      mBytes += mBuffer.size();
+   }
+   StackLog(<<"wrote " << mBufferedRecords << " CDRs, " << mBuffer.size() << " bytes");
+   mBuffer.clear();
+   mBufferedRecords = 0;
+}
+
+void
+CDRFile::formatBatch(Fifo<Record>::Messages& batch)
+{
+   for(Fifo<Record>::Messages::iterator it = batch.begin(); it != batch.end(); ++it)
+   {
+      format(**it);
+      delete *it;
+      if(mBuffer.size() >= MaxBatchBytes)
+      {
+         writeBatch();
+      }
+   }
+}
+
+void
+CDRFile::format(const Record& r)
+{
+   switch(mFormat)
+   {
+   case JSON:
+      formatJSON(r);
+      break;
+   case Binary:
+      formatBinary(r);
+      break;
+   default:
+      formatCSV(r);
+   }
+   mBufferedRecords++;
+}
+
+void
+CDRFile::formatCSV(const Record& r)
+{
+   logString(r.mCallID);
+   logString(r.mCaller);
+   logString(r.mCallee);
+   logString(r.mOriginZone);
+   logString(r.mDestinationZone);
+   logTimestamp(r.mStart);
+   if(r.mAnswered)
+   {
+      logTimestamp(r.mConnect);
+   }
+   else
+   {
+      logString(Data::Empty);
+   }
+   logTimestamp(r.mFinish);
+   logTimediff(r.mFinish - r.mStart);
+   if(r.mAnswered)
+   {
+      logTimediff(r.mFinish - r.mConnect);
    }
    else
    {
       logTimediff(0);
    }
-   logString(disposition);
-   logNumeric(call->getResponseCode(), true);
+   logString(r.mDisposition);
+   logNumeric(r.mResponseCode, true);
+}
+
+static void
+appendJSONString(Data& buf, const char* name, const Data& value, bool last = false)
+{
+   buf += '"';
+   buf += name;
+   buf += "\":\"";
+   for(Data::size_type i = 0; i < value.size(); i++)
+   {
+      const unsigned char c = (unsigned char)value[i];
+      switch(c)
+      {
+      case '"':
+         buf += "\\\"";
+         break;
+      case '\\':
+         buf += "\\\\";
+         break;
+      case '\n':
+         buf += "\\n";
+         break;
+      case '\r':
+         buf += "\\r";
+         break;
+      case '\t':
+         buf += "\\t";
+         break;
+      default:
+         if(c < 0x20)
+         {
+            char esc[8];
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            buf += esc;
+         }
+         else
+         {
+            buf += (char)c;
+         }
+      }
+   }
+   buf += last ? "\"}\n" : "\",";
+}
+
+static void
+appendJSONNumber(Data& buf, const char* name, UInt64 value, bool last = false)
+{
+   buf += '"';
+   buf += name;
+   buf += "\":";
+   buf += Data(value);
+   buf += last ? "}\n" : ",";
+}
+
+void
+CDRFile::formatJSON(const Record& r)
+{
+   mBuffer += '{';
+   appendJSONString(mBuffer, "id", r.mCallID);
+   appendJSONString(mBuffer, "caller", r.mCaller);
+   appendJSONString(mBuffer, "callee", r.mCallee);
+   appendJSONString(mBuffer, "originZone", r.mOriginZone);
+   appendJSONString(mBuffer, "destinationZone", r.mDestinationZone);
+   appendJSONString(mBuffer, "start", formatTimestamp(r.mStart));
+   appendJSONString(mBuffer, "connect", r.mAnswered ? formatTimestamp(r.mConnect) : Data::Empty);
+   appendJSONString(mBuffer, "finish", formatTimestamp(r.mFinish));
+   appendJSONNumber(mBuffer, "duration", (r.mFinish - r.mStart) / 1000);
+   appendJSONNumber(mBuffer, "billsec", r.mAnswered ? (r.mFinish - r.mConnect) / 1000 : 0);
+   appendJSONString(mBuffer, "disposition", r.mDisposition);
+   appendJSONNumber(mBuffer, "responseCode", (UInt64)r.mResponseCode, true);
+}
+
+static void
+appendUInt32(Data& buf, UInt32 v)
+{
+   v = htonl(v);
+   buf.append((const char*)&v, sizeof(v));
+}
+
+static void
+appendUInt64(Data& buf, UInt64 v)
+{
+   appendUInt32(buf, (UInt32)(v >> 32));
+   appendUInt32(buf, (UInt32)(v & 0xffffffff));
+}
+
+static void
+appendString(Data& buf, const Data& s)
+{
+   UInt16 len = (UInt16)resipMin(s.size(), (Data::size_type)0xffff);
+   UInt16 nlen = htons(len);
+   buf.append((const char*)&nlen, sizeof(nlen));
+   buf.append(s.data(), len);
+}
+
+void
+CDRFile::formatBinary(const Record& r)
+{
+   // the length is filled in once the record is complete
+   const Data::size_type start = mBuffer.size();
+   appendUInt32(mBuffer, 0);
+   appendUInt64(mBuffer, r.mStart);
+   appendUInt64(mBuffer, r.mAnswered ? r.mConnect : 0);
+   appendUInt64(mBuffer, r.mFinish);
+   appendUInt32(mBuffer, (UInt32)r.mResponseCode);
+   mBuffer += (char)(r.mAnswered ? 1 : 0);
+   appendString(mBuffer, r.mCallID);
+   appendString(mBuffer, r.mCaller);
+   appendString(mBuffer, r.mCallee);
+   appendString(mBuffer, r.mOriginZone);
+   appendString(mBuffer, r.mDestinationZone);
+   appendString(mBuffer, r.mDisposition);
+
+   UInt32 len = htonl((UInt32)(mBuffer.size() - start - sizeof(UInt32)));
+   memcpy(const_cast<char*>(mBuffer.data()) + start, &len, sizeof(len));
 }
 
 void
@@ -78,24 +474,26 @@ CDRFile::logString(const resip::Data& s, bool last, bool quote)
 {
    if(quote)
    {
-      mFile << '"' << s << '"';
+      mBuffer += '"';
+      mBuffer += s;
+      mBuffer += '"';
    }
    else
    {
-      mFile << s;
+      mBuffer += s;
    }
    if(last)
    {
-      mFile << std::endl;
+      mBuffer += '\n';
    }
    else
    {
-      mFile << mSep;
+      mBuffer += mSep;
    }
 }
 
-void
-CDRFile::logTimestamp(const uint64_t& t, bool last)
+Data
+CDRFile::formatTimestamp(const uint64_t& t)
 {
    const time_t timeInSeconds = (time_t)(t / 1000);
    const int millis = t % 1000;
@@ -130,7 +528,13 @@ CDRFile::logTimestamp(const uint64_t& t, bool last)
                                        thereby leaving its last character at
                                        the end, instead of a null terminator */
 
-   logString(Data(datebuf), last, false);
+   return Data(datebuf);
+}
+
+void
+CDRFile::logTimestamp(const uint64_t& t, bool last)
+{
+   logString(formatTimestamp(t), last, false);
 }
 
 void
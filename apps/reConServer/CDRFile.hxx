@@ -11,25 +11,135 @@
 #include <fstream>
 
 #include "rutil/Data.hxx"
+#include "rutil/Fifo.hxx"
+#include "rutil/Mutex.hxx"
+#include "rutil/ThreadIf.hxx"
 
 namespace reconserver
 {
 
-class CDRFile : public B2BCallLogger
+/**
+  Writes a record for each finished B2BCall.
+
+  log() is called on the conversation manager thread and only copies the
+  call details onto a bounded queue; formatting and file I/O happen on the
+  CDRFile's own thread, which writes the queued records in batches once per
+  flush interval (or sooner if a batch grows large).  If the queue is full
+  the record is dropped and counted rather than blocking call handling.
+
+  The file can be rotated by size and/or age: the current file is renamed
+  with a timestamp suffix and a new one is started.
+
+  Formats:
+    CSV    - one comma separated line per call (the historical format)
+    JSON   - one JSON object per line
+    Binary - per record, a 32 bit length followed by the start, connect
+             and finish times (64 bit, ms since the epoch), the response
+             code (32 bit), an answered flag (8 bit) and the call ID,
+             caller, callee, origin zone, destination zone and disposition
+             as 16 bit length prefixed strings.  Integers are in network
+             byte order.
+*/
+class CDRFile : public B2BCallLogger, public resip::ThreadIf
 {
 public:
-   CDRFile(const resip::Data& filename);
+   typedef enum
+   {
+      CSV,
+      JSON,
+      Binary
+   } Format;
+
+   class Statistics
+   {
+   public:
+      Statistics();
+
+      size_t mQueueDepth;
+      size_t mMaxQueueDepth;
+      UInt64 mWritten;
+      UInt64 mDropped;
+      UInt64 mBatches;
+      UInt64 mBytes;
+      UInt64 mRotations;
+   };
+
+   CDRFile(const resip::Data& filename,
+           Format format = CSV,
+           unsigned int maxQueueSize = 10000,
+           unsigned int flushIntervalMs = 1000,
+           UInt64 rotateSize = 0,
+           unsigned int rotateIntervalSecs = 0);
    virtual ~CDRFile();
+
+   // returns false if name is not one of csv, json or binary
+   static bool parseFormat(const resip::Data& name, Format& format);
+
    virtual void log(resip::SharedPtr<B2BCall> call);
 
+   virtual void thread();
+
+   void getStatistics(Statistics& stats) const;
+   void logStatistics() const;
+
 private:
+   class Record
+   {
+   public:
+      resip::Data mCallID;
+      resip::Data mCaller;
+      resip::Data mCallee;
+      resip::Data mOriginZone;
+      resip::Data mDestinationZone;
+      resip::Data mDisposition;
+      uint64_t mStart;
+      uint64_t mConnect;
+      uint64_t mFinish;
+      int mResponseCode;
+      bool mAnswered;
+   };
+
+   void openFile();
+   void rotate();
+   void writeBatch();
+   void formatBatch(resip::Fifo<Record>::Messages& batch);
+   void format(const Record& r);
+   void formatCSV(const Record& r);
+   void formatJSON(const Record& r);
+   void formatBinary(const Record& r);
+
    void logString(const resip::Data& s, bool last = false, bool quote = true);
    void logTimestamp(const uint64_t& t, bool last = false);
    void logTimediff(const uint64_t& d, bool last = false);
    void logNumeric(int s, bool last = false);
 
+   static resip::Data formatTimestamp(const uint64_t& t);
+
+   const resip::Data mFilename;
+   const Format mFormat;
+   const unsigned int mMaxQueueSize;
+   const unsigned int mFlushIntervalMs;
+   const UInt64 mRotateSize;
+   const unsigned int mRotateIntervalSecs;
+
    char mSep;
    std::ofstream mFile;
+   UInt64 mFileSize;
+   UInt64 mFileOpened;   // seconds
+
+   resip::Fifo<Record> mFifo;
+
+   // only used on the writer thread
+   resip::Data mBuffer;
+   unsigned int mBufferedRecords;
+
+   mutable resip::Mutex mStatsMutex;
+   size_t mMaxQueueDepth;
+   UInt64 mWritten;
+   UInt64 mDropped;
+   UInt64 mBatches;
+   UInt64 mBytes;
+   UInt64 mRotations;
 };
 
 }
@@ -645,6 +645,18 @@ void ReConServerProcess::processCommandLine(Data& commandline, MyConversationMan
       myConversationManager.displayInfo();
       return;
    }
+   if(isEqualNoCase(command, "cdrstats") || isEqualNoCase(command, "cdr"))
+   {
+      if(mCDRFile.get())
+      {
+         mCDRFile->logStatistics();
+      }
+      else
+      {
+         InfoLog( << "CDR logging is not enabled.");
+      }
+      return;
+   }
    if(isEqualNoCase(command, "dns") || isEqualNoCase(command, "ld"))
    {
       InfoLog( << "DNS cache (at WARNING log level):");
@@ -706,6 +718,7 @@ void ReConServerProcess::processCommandLine(Data& commandline, MyConversationMan
          << "  setNATPassword           <'natpwd'|'np'> <password>" << endl
          << "  startApplicationTimer:   <'starttimer'|'st'> <timerId> <durationMs> <seqNo>" << endl
          << "  displayInfo:             <'info'|'i'>" << endl
+         << "  logCDRStatistics:        <'cdrstats'|'cdr'>" << endl
          << "  logDnsCache:             <'dns'|'ld'>" << endl
          << "  clearDnsCache:           <'cleardns'|'cd'>" << endl
          << "  exitProgram:             <'exit'|'quit'|'q'>");
@@ -827,6 +840,11 @@ ReConServerProcess::main (int argc, char** argv)
    Data loggingFilename = reConServerConfig.getConfigData("LogFilename", "reConServer.log", true);
    unsigned int loggingFileMaxLineCount = reConServerConfig.getConfigUnsignedLong("LogFileMaxLines", 50000);
    Data cdrLogFilename = reConServerConfig.getConfigData("CDRLogFile", "", true);
+   Data cdrLogFormatName = reConServerConfig.getConfigData("CDRLogFormat", "csv", true);
+   unsigned int cdrLogQueueSize = reConServerConfig.getConfigUnsignedLong("CDRLogQueueSize", 10000);
+   unsigned int cdrLogFlushInterval = reConServerConfig.getConfigUnsignedLong("CDRLogFlushInterval", 1000);
+   unsigned long cdrLogRotateSize = reConServerConfig.getConfigUnsignedLong("CDRLogRotateSize", 0);
+   unsigned int cdrLogRotateInterval = reConServerConfig.getConfigUnsignedLong("CDRLogRotateInterval", 0);
    Data captureHost = reConServerConfig.getConfigData("CaptureHost", "");
    int capturePort = reConServerConfig.getConfigInt("CapturePort", 9060);
    int captureAgentID = reConServerConfig.getConfigInt("CaptureAgentID", 2002);
@@ -1310,7 +1328,15 @@ ReConServerProcess::main (int argc, char** argv)
                SharedPtr<B2BCallLogger> b2bCallLogger;
                if(!cdrLogFilename.empty())
                {
-                  b2bCallLogger.reset(new CDRFile(cdrLogFilename));
+                  CDRFile::Format cdrLogFormat = CDRFile::CSV;
+                  if(!CDRFile::parseFormat(cdrLogFormatName, cdrLogFormat))
+                  {
+                     ErrLog(<<"Unknown CDRLogFormat " << cdrLogFormatName << ", using csv");
+                  }
+                  mCDRFile.reset(new CDRFile(cdrLogFilename, cdrLogFormat, cdrLogQueueSize,
+                     cdrLogFlushInterval, cdrLogRotateSize, cdrLogRotateInterval));
+                  mCDRFile->run();
+                  b2bCallLogger = mCDRFile;
                }
                b2BCallManager = new B2BCallManager(mediaInterfaceMode, defaultSampleRate, maximumSampleRate, reConServerConfig, b2bCallLogger);
                mConversationManager.reset(b2BCallManager);
@@ -15,6 +15,8 @@
 namespace reconserver
 {
 
+class CDRFile;
+
 class ReConServerProcess : public resip::ServerProcess
 {
 public:
@@ -34,6 +36,7 @@ private:
    bool mKeyboardInput;
    resip::SharedPtr<MyUserAgent> mUserAgent;
    std::auto_ptr<MyConversationManager> mConversationManager;
+   resip::SharedPtr<CDRFile> mCDRFile;
 };
 
 }
@@ -163,6 +163,14 @@ CommandThread::processQueue(UserRegistrationClient& userRegistrationClient)
          Data aor(_aor);
          userRegistrationClient.unSetContact(Uri(aor));
       }
+      else if(command == "log_status")
+      {
+         userRegistrationClient.logStatus();
+      }
+      else
+      {
+         WarningLog(<<"unknown command " << command);
+      }
    }
 }
 
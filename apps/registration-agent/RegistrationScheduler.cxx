@@ -0,0 +1,285 @@
+#include "rutil/Logger.hxx"
+#include "rutil/Random.hxx"
+#include "rutil/Timer.hxx"
+#include "resip/stack/Helper.hxx"
+
+#include "AppSubsystem.hxx"
+#include "RegistrationScheduler.hxx"
+#include "UserRegistrationClient.hxx"
+
+#define RESIPROCATE_SUBSYSTEM AppSubsystem::REGISTRATIONAGENT
+
+using namespace registrationagent;
+using namespace resip;
+using namespace std;
+
+RegistrationScheduler::Statistics::Statistics() :
+   mPendingRegistrations(0),
+   mScheduledRefreshes(0),
+   mReady(0),
+   mInFlight(0),
+   mRegistered(0),
+   mFailed(0),
+   mSent(0),
+   mSucceeded(0),
+   mFailures(0),
+   mRetries(0),
+   mUnscheduledRefreshes(0)
+{
+}
+
+RegistrationScheduler::RegistrationScheduler(unsigned int rate, unsigned int maxInFlight, unsigned int jitterPercent) :
+   mRate(rate),
+   mMaxInFlight(maxInFlight),
+   mJitterPercent(resipMin(jitterPercent, 100U)),
+   mSeq(0),
+   mTokens(0),
+   mLastRefillMs(Timer::getTimeMs()),
+   mSent(0),
+   mSucceeded(0),
+   mFailures(0),
+   mRetries(0),
+   mUnscheduledRefreshes(0)
+{
+   InfoLog(<<"RegistrationScheduler rate = " << mRate << "/s maxInFlight = " << mMaxInFlight
+           << " jitter = " << mJitterPercent << "%");
+}
+
+RegistrationScheduler::~RegistrationScheduler()
+{
+}
+
+void
+RegistrationScheduler::scheduleRegistration(const Uri& aor)
+{
+   Pending& p = mPending[aor];
+   p.mKind = Registration;
+   p.mSeq = ++mSeq;
+   mReady.push_back(Ticket(aor, p.mSeq));
+   StackLog(<<"queued initial registration for " << aor << ", " << mReady.size() << " ready");
+}
+
+void
+RegistrationScheduler::scheduleRefresh(const Uri& aor, UInt32 expiry)
+{
+   // DUM refreshes by itself after aBitSmallerThan(expiry), so the window
+   // ends just before that
+   int latest = (int)Helper::aBitSmallerThan(expiry) - 1;
+   int delay = latest > 0 ? jitter(latest) : 0;
+   UInt64 due = Timer::getTimeSecs() + delay;
+
+   Pending& p = mPending[aor];
+   p.mKind = Refresh;
+   p.mSeq = ++mSeq;
+   mBuckets[due].push_back(Ticket(aor, p.mSeq));
+   StackLog(<<"refresh for " << aor << " scheduled in " << delay << "s (expiry " << expiry << "s)");
+}
+
+void
+RegistrationScheduler::cancel(const Uri& aor)
+{
+   // tickets left in the buckets and ready queue are discarded when they
+   // come due because their sequence no longer matches
+   mPending.erase(aor);
+   mInFlight.erase(aor);
+   mRegistered.erase(aor);
+   mFailed.erase(aor);
+}
+
+bool
+RegistrationScheduler::onRequestSent(const Uri& aor, bool scheduled)
+{
+   mSent++;
+   if(!scheduled)
+   {
+      // DUM's own refresh timer fired first: DUM won't report the outcome
+      // so it isn't counted against the in-flight limit
+      mUnscheduledRefreshes++;
+      return true;
+   }
+   return mInFlight.insert(aor).second;
+}
+
+void
+RegistrationScheduler::onSuccess(const Uri& aor)
+{
+   mSucceeded++;
+   mInFlight.erase(aor);
+   mFailed.erase(aor);
+   mRegistered.insert(aor);
+}
+
+void
+RegistrationScheduler::onFailure(const Uri& aor)
+{
+   mFailures++;
+   mInFlight.erase(aor);
+   mRegistered.erase(aor);
+   mFailed.insert(aor);
+}
+
+void
+RegistrationScheduler::onRemoved(const Uri& aor)
+{
+   mInFlight.erase(aor);
+   mRegistered.erase(aor);
+}
+
+int
+RegistrationScheduler::onRetry(const Uri& aor, int retrySeconds)
+{
+   mRetries++;
+   mInFlight.erase(aor);
+   // spread retries out after the registrar recovers from an outage
+   int spread = retrySeconds * (int)mJitterPercent / 100;
+   return retrySeconds + (spread > 0 ? Random::getRandom() % (spread + 1) : 0);
+}
+
+void
+RegistrationScheduler::process(UserRegistrationClient& client)
+{
+   UInt64 nowMs = Timer::getTimeMs();
+   UInt64 nowSecs = nowMs / 1000;
+
+   while(!mBuckets.empty() && mBuckets.begin()->first <= nowSecs)
+   {
+      TicketQueue& bucket = mBuckets.begin()->second;
+      mReady.insert(mReady.end(), bucket.begin(), bucket.end());
+      mBuckets.erase(mBuckets.begin());
+   }
+
+   refillTokens(nowMs);
+
+   while(!mReady.empty())
+   {
+      if(mMaxInFlight > 0 && mInFlight.size() >= mMaxInFlight)
+      {
+         break;
+      }
+      if(mRate > 0 && mTokens < 1000)
+      {
+         break;
+      }
+
+      Ticket ticket = mReady.front();
+      mReady.pop_front();
+      PendingMap::iterator it = mPending.find(ticket.first);
+      if(it == mPending.end() || it->second.mSeq != ticket.second)
+      {
+         continue;
+      }
+      Kind kind = it->second.mKind;
+      mPending.erase(it);
+
+      bool sent = kind == Registration ?
+         client.startRegistration(ticket.first) :
+         client.refreshRegistration(ticket.first);
+      if(sent && mRate > 0)
+      {
+         mTokens -= 1000;
+      }
+   }
+}
+
+void
+RegistrationScheduler::getStatistics(Statistics& stats) const
+{
+   stats.mPendingRegistrations = 0;
+   stats.mScheduledRefreshes = 0;
+   for(PendingMap::const_iterator it = mPending.begin(); it != mPending.end(); ++it)
+   {
+      if(it->second.mKind == Registration)
+      {
+         stats.mPendingRegistrations++;
+      }
+      else
+      {
+         stats.mScheduledRefreshes++;
+      }
+   }
+   stats.mReady = mReady.size();
+   stats.mInFlight = mInFlight.size();
+   stats.mRegistered = mRegistered.size();
+   stats.mFailed = mFailed.size();
+   stats.mSent = mSent;
+   stats.mSucceeded = mSucceeded;
+   stats.mFailures = mFailures;
+   stats.mRetries = mRetries;
+   stats.mUnscheduledRefreshes = mUnscheduledRefreshes;
+}
+
+void
+RegistrationScheduler::refillTokens(UInt64 nowMs)
+{
+   if(mRate == 0)
+   {
+      return;
+   }
+   if(nowMs > mLastRefillMs)
+   {
+      // allow at most one second worth of requests in a burst
+      mTokens = resipMin(mTokens + (nowMs - mLastRefillMs) * mRate, (UInt64)mRate * 1000);
+   }
+   mLastRefillMs = nowMs;
+}
+
+int
+RegistrationScheduler::jitter(int base) const
+{
+   int spread = base * (int)mJitterPercent / 100;
+   if(spread <= 0)
+   {
+      return base;
+   }
+   return base - Random::getRandom() % (spread + 1);
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
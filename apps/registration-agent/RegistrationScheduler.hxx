@@ -0,0 +1,177 @@
+#ifndef REGISTRATIONSCHEDULER_HXX
+#define REGISTRATIONSCHEDULER_HXX
+
+#include <deque>
+#include <map>
+#include <set>
+
+#include "rutil/compat.hxx"
+#include "rutil/Data.hxx"
+#include "resip/stack/Uri.hxx"
+
+namespace registrationagent {
+
+class UserRegistrationClient;
+
+/**
+  Paces the REGISTER requests sent by the agent so that a large account
+  list does not turn into a REGISTER storm at startup and refreshes do not
+  cluster together afterwards.
+
+  Initial registrations are queued and released at a configurable rate.
+  After each successful registration the refresh is placed in a one second
+  bucket chosen at random from a window that ends where DUM's own refresh
+  timer would fire, so refreshes spread out instead of repeating the
+  startup burst every expiry interval.  DUM's timer remains as a backstop
+  if the scheduler falls behind.  Releases from the ready queue are also
+  limited by the number of REGISTERs still awaiting a final response.
+
+  All methods are called from the DUM thread.
+*/
+class RegistrationScheduler
+{
+public:
+   class Statistics
+   {
+   public:
+      Statistics();
+
+      size_t mPendingRegistrations;   // initial REGISTERs waiting to be released
+      size_t mScheduledRefreshes;     // refreshes not yet released
+      size_t mReady;                  // due, waiting for the rate or in-flight limit
+      size_t mInFlight;               // REGISTERs awaiting a final response
+      size_t mRegistered;
+      size_t mFailed;
+      UInt64 mSent;
+      UInt64 mSucceeded;
+      UInt64 mFailures;
+      UInt64 mRetries;
+      UInt64 mUnscheduledRefreshes;   // refreshes DUM sent because we were late
+   };
+
+   /**
+     @param rate              REGISTERs released per second, 0 for no limit
+     @param maxInFlight       REGISTERs awaiting a response, 0 for no limit
+     @param jitterPercent     width of the refresh window as a percentage of
+                              the refresh interval
+   */
+   RegistrationScheduler(unsigned int rate, unsigned int maxInFlight, unsigned int jitterPercent);
+   ~RegistrationScheduler();
+
+   void scheduleRegistration(const resip::Uri& aor);
+   void scheduleRefresh(const resip::Uri& aor, UInt32 expiry);
+   void cancel(const resip::Uri& aor);
+
+   // Called whenever a REGISTER for aor goes on the wire, including those
+   // DUM sends by itself.  Returns false if aor was already in flight.
+   bool onRequestSent(const resip::Uri& aor, bool scheduled);
+   void onSuccess(const resip::Uri& aor);
+   void onFailure(const resip::Uri& aor);
+   void onRemoved(const resip::Uri& aor);
+   // returns the jittered delay to hand back to DUM from onRequestRetry
+   int onRetry(const resip::Uri& aor, int retrySeconds);
+
+   /** Moves due buckets to the ready queue and releases as many requests as
+       the rate and in-flight limits allow. */
+   void process(UserRegistrationClient& client);
+
+   void getStatistics(Statistics& stats) const;
+
+private:
+   typedef enum
+   {
+      Registration,
+      Refresh
+   } Kind;
+
+   class Pending
+   {
+   public:
+      Kind mKind;
+      unsigned int mSeq;
+   };
+
+   typedef std::pair<resip::Uri, unsigned int> Ticket;
+   typedef std::deque<Ticket> TicketQueue;
+   typedef std::map<UInt64, TicketQueue> BucketMap;
+   typedef std::map<resip::Uri, Pending> PendingMap;
+   typedef std::set<resip::Uri> UriSet;
+
+   void refillTokens(UInt64 nowMs);
+   int jitter(int base) const;
+
+   unsigned int mRate;
+   unsigned int mMaxInFlight;
+   unsigned int mJitterPercent;
+
+   PendingMap mPending;
+   BucketMap mBuckets;
+   TicketQueue mReady;
+   UriSet mInFlight;
+   UriSet mRegistered;
+   UriSet mFailed;
+
+   unsigned int mSeq;
+   UInt64 mTokens;         // thousandths of a request
+   UInt64 mLastRefillMs;
+
+   UInt64 mSent;
+   UInt64 mSucceeded;
+   UInt64 mFailures;
+   UInt64 mRetries;
+   UInt64 mUnscheduledRefreshes;
+};
+
+} // namespace
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -40,7 +40,8 @@ UserAccount::UserAccount(SharedPtr<KeyedFile> keyedFile, const Uri& aor, const v
    mAor(aor),
    mContactOverride(false),
    mExpires(0),
-   mState(UserAccount::Inactive)
+   mState(UserAccount::Inactive),
+   mSchedulerRefresh(false)
 {
    readColumns();
 }
@@ -105,7 +106,7 @@ UserAccount::activate()
          return;
       }
       mState = Active;
-      doRegistration();
+      mUserRegistrationClient->getScheduler().scheduleRegistration(mAor.uri());
    }
 }
 
@@ -115,10 +116,44 @@ UserAccount::deactivate()
    if(mState == Active)
    {
       mState = Inactive;
+      mUserRegistrationClient->getScheduler().cancel(mAor.uri());
       removeAllActive();
    }
 }
 
+bool
+UserAccount::startRegistration()
+{
+   if(mState != Active)
+   {
+      return false;
+   }
+   doRegistration();
+   return true;
+}
+
+bool
+UserAccount::refreshRegistration()
+{
+   if(mState != Active)
+   {
+      return false;
+   }
+   bool sent = false;
+   for(vector<ClientRegistrationHandle>::iterator it = mHandles.begin();
+          it != mHandles.end(); it++)
+   {
+      if(it->isValid() && !(*it)->isRequestPending())
+      {
+         mSchedulerRefresh = true;
+         (*it)->requestRefresh();
+         mSchedulerRefresh = false;
+         sent = true;
+      }
+   }
+   return sent;
+}
+
 void
 UserAccount::setContact(const Data& newContact, const time_t expires, const std::vector<resip::Data>& route)
 {
@@ -168,6 +203,7 @@ UserAccount::doRegistration()
    regMessage->header(h_Routes) = mRoute;
 
    mDum.sendCommand(regMessage);
+   mUserRegistrationClient->getScheduler().onRequestSent(mAor.uri(), true);
 }
 
 void
@@ -178,6 +214,12 @@ UserAccount::onSuccess(ClientRegistrationHandle h, const SipMessage& response)
    {
       mHandles.insert(mHandles.begin(), h);
    }
+   RegistrationScheduler& scheduler = mUserRegistrationClient->getScheduler();
+   scheduler.onSuccess(mAor.uri());
+   if(mState == Active)
+   {
+      scheduler.scheduleRefresh(mAor.uri(), h->whenExpires());
+   }
 }
 
 void
@@ -189,6 +231,7 @@ UserAccount::onRemoved(ClientRegistrationHandle h, const SipMessage& response)
    {
       mHandles.erase(it);
    }
+   mUserRegistrationClient->getScheduler().onRemoved(mAor.uri());
    if(mState == Ending && mHandles.size() == 0)
    {
       doCleanup();
@@ -209,6 +252,7 @@ void
 UserAccount::onFailure(ClientRegistrationHandle h, const SipMessage& response)
 {
    InfoLog ( << "ClientHandler::onFailure - check the configuration.  Peer response: " << response );
+   mUserRegistrationClient->getScheduler().onFailure(mAor.uri());
 }
 
 /// From resip/dum/RegistrationHandler.hxx
@@ -218,26 +262,35 @@ int
 UserAccount::onRequestRetry(ClientRegistrationHandle h, int retrySeconds, const SipMessage& response)
 {
    WarningLog ( << "ClientHandler:onRequestRetry, want to retry");
-   return 30;
+   return mUserRegistrationClient->getScheduler().onRetry(mAor.uri(), 30);
 }
 
 bool
 UserAccount::onRefreshRequired(resip::ClientRegistrationHandle h, const resip::SipMessage& lastRequest)
 {
    StackLog(<<"UserAccount::onRefreshRequired mExpires == " << mExpires);
-   if(mExpires == 0)
-   {
-      return true;
-   }
-   UInt64 now = Timer::getTimeSecs();
-   if(now > mExpires)
+   if(mExpires != 0)
    {
-      DebugLog(<<"now = " << now << " and contact expired at " << mExpires);
-      if(mState == Active)
+      UInt64 now = Timer::getTimeSecs();
+      if(now > mExpires)
       {
-         mState = Inactive;
+         DebugLog(<<"now = " << now << " and contact expired at " << mExpires);
+         if(mState == Active)
+         {
+            mState = Inactive;
+         }
+         return false;
       }
-      return false;
+   }
+   RegistrationScheduler& scheduler = mUserRegistrationClient->getScheduler();
+   scheduler.onRequestSent(mAor.uri(), mSchedulerRefresh);
+   if(!mSchedulerRefresh && mState == Active)
+   {
+      // DUM will not call onSuccess for its own refresh, so take the
+      // refresh back into the schedule from here
+      UInt32 expiry = lastRequest.exists(h_Expires) ?
+         lastRequest.header(h_Expires).value() : mProfile->getDefaultRegistrationTime();
+      scheduler.scheduleRefresh(mAor.uri(), expiry);
    }
    return true;
 }
@@ -38,6 +38,11 @@ public:
    void activate();
    void deactivate();
 
+   // Called by the RegistrationScheduler when this account's REGISTER is
+   // due, return true if a request was sent
+   bool startRegistration();
+   bool refreshRegistration();
+
    void setContact(const resip::Data& newContact, const time_t expires = 0, const std::vector<resip::Data>& route = std::vector<resip::Data>());
    void unSetContact();
 
@@ -84,6 +89,7 @@ private:
    resip::NameAddrs mRoute;
 
    std::vector<resip::ClientRegistrationHandle> mHandles;
+   bool mSchedulerRefresh;  // set while the scheduler is requesting a refresh
 };
 
 } // namespace
@@ -9,8 +9,9 @@ using namespace registrationagent;
 using namespace resip;
 using namespace std;
 
-UserRegistrationClient::UserRegistrationClient(resip::SharedPtr<KeyedFile> keyedFile) :
-   mKeyedFile(keyedFile)
+UserRegistrationClient::UserRegistrationClient(resip::SharedPtr<KeyedFile> keyedFile, resip::SharedPtr<RegistrationScheduler> scheduler) :
+   mKeyedFile(keyedFile),
+   mScheduler(scheduler)
 {
 }
 
@@ -28,9 +29,57 @@ void
 UserRegistrationClient::removeUserAccount(const Uri& aor)
 {
    StackLog(<<"Removing UserAccount " << aor);
+   mScheduler->cancel(aor);
    mAccounts.erase(aor);
 }
 
+void
+UserRegistrationClient::process()
+{
+   mScheduler->process(*this);
+}
+
+bool
+UserRegistrationClient::startRegistration(const Uri& aor)
+{
+   SharedPtr<UserAccount> userAccount = userAccountForAoR(aor);
+   if(userAccount.get())
+   {
+      return userAccount->startRegistration();
+   }
+   return false;
+}
+
+bool
+UserRegistrationClient::refreshRegistration(const Uri& aor)
+{
+   SharedPtr<UserAccount> userAccount = userAccountForAoR(aor);
+   if(userAccount.get())
+   {
+      return userAccount->refreshRegistration();
+   }
+   return false;
+}
+
+void
+UserRegistrationClient::logStatus()
+{
+   RegistrationScheduler::Statistics stats;
+   mScheduler->getStatistics(stats);
+   WarningLog(<<"registration status: accounts = " << mAccounts.size()
+              << " registered = " << stats.mRegistered
+              << " failed = " << stats.mFailed
+              << " in flight = " << stats.mInFlight
+              << " pending registrations = " << stats.mPendingRegistrations
+              << " scheduled refreshes = " << stats.mScheduledRefreshes
+              << " ready = " << stats.mReady
+              << " sent = " << stats.mSent
+              << " succeeded = " << stats.mSucceeded
+              << " failures = " << stats.mFailures
+              << " retries = " << stats.mRetries
+              << " unscheduled refreshes = " << stats.mUnscheduledRefreshes);
+}
+
 void
 UserRegistrationClient::setContact(const Uri& aor, const Data& newContact, const time_t expires, const vector<Data>& route)
 {
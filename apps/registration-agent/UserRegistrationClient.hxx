@@ -8,6 +8,7 @@
 #include "resip/dum/UserProfile.hxx"
 
 #include "KeyedFile.hxx"
+#include "RegistrationScheduler.hxx"
 #include "UserAccount.hxx"
 
 namespace registrationagent {
@@ -16,9 +17,17 @@ class UserRegistrationClient : public resip::ClientRegistrationHandler
 {
 
 public:
-   UserRegistrationClient(resip::SharedPtr<KeyedFile> keyedFile);
+   UserRegistrationClient(resip::SharedPtr<KeyedFile> keyedFile, resip::SharedPtr<RegistrationScheduler> scheduler);
    virtual ~UserRegistrationClient();
 
+   RegistrationScheduler& getScheduler() { return *mScheduler; }
+   // Called from the main loop to release REGISTERs that are due
+   void process();
+   // Called by the scheduler, return true if a REGISTER was sent
+   bool startRegistration(const resip::Uri& aor);
+   bool refreshRegistration(const resip::Uri& aor);
+   void logStatus();
+
    void addUserAccount(const resip::Uri& aor, resip::SharedPtr<UserAccount> userAccount);
    void removeUserAccount(const resip::Uri& aor);
 
@@ -37,6 +46,7 @@ protected:
 
 private:
    resip::SharedPtr<KeyedFile> mKeyedFile;
+   resip::SharedPtr<RegistrationScheduler> mScheduler;
    std::map<resip::Uri, resip::SharedPtr<UserAccount> > mAccounts;
 };
 
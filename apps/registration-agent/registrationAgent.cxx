@@ -33,6 +33,7 @@
 #include "AppSubsystem.hxx"
 #include "CommandThread.hxx"
 #include "RegConfig.hxx"
+#include "RegistrationScheduler.hxx"
 #include "UserRegistrationClient.hxx"
 #include "KeyedFile.hxx"
 
@@ -168,7 +169,11 @@ class MyClientRegistrationAgent : public ServerProcess
          SharedPtr<UserAccountFileRowHandler> rowHandler(new UserAccountFileRowHandler(*mClientDum));
          mKeyedFile.reset(new KeyedFile(cfg.getConfigData("UserAccountFile", "users.txt", false), SharedPtr<KeyedFileRowHandler>(rowHandler, dynamic_cast_tag())));
          mKeyedFile->setSharedPtr(mKeyedFile);
-         mClientHandler.reset(new UserRegistrationClient(mKeyedFile));
+         SharedPtr<RegistrationScheduler> scheduler(new RegistrationScheduler(
+            cfg.getConfigUnsignedLong("RegistrationRate", 100),
+            cfg.getConfigUnsignedLong("MaxRegistrationsInFlight", 200),
+            cfg.getConfigUnsignedLong("RegistrationRefreshJitter", 20)));
+         mClientHandler.reset(new UserRegistrationClient(mKeyedFile, scheduler));
          mClientDum->setClientRegistrationHandler(mClientHandler.get());
          rowHandler->setUserRegistrationClient(mClientHandler);
          mKeyedFile->doReload();
@@ -197,6 +202,7 @@ class MyClientRegistrationAgent : public ServerProcess
       void onLoop()
       {
          while(mClientDum->process());
+         mClientHandler->process();
          if(mCmd.get())
          {
             mCmd->processQueue(*mClientHandler);
@@ -1,5 +1,6 @@
 #include "AsyncSocketBase.hxx"
 #include "AsyncSocketBaseHandler.hxx"
+#include <boost/make_shared.hpp>
 #include <rutil/WinLeakCheck.hxx>
 #include <rutil/Logger.hxx>
 #include "ReTurnSubsystem.hxx"
@@ -47,6 +48,16 @@ void
 AsyncSocketBase::doSend(const StunTuple& destination, unsigned short channel, boost::shared_ptr<DataBuffer>& data, unsigned int bufferStartPos)
 {
    bool writeInProgress = !mSendDataQueue.empty();
+   queueSendData(destination, channel, data, bufferStartPos);
+   if (!writeInProgress)
+   {
+      sendFirstQueuedData();
+   }
+}
+
+void
+AsyncSocketBase::queueSendData(const StunTuple& destination, unsigned short channel, boost::shared_ptr<DataBuffer>& data, unsigned int bufferStartPos)
+{
    if(channel == NO_CHANNEL)
    {
       boost::shared_ptr<DataBuffer> empty;
@@ -63,10 +74,6 @@ AsyncSocketBase::doSend(const StunTuple& destination, unsigned short channel, bo
 
       mSendDataQueue.push_back(SendData(destination, frame, data, bufferStartPos));
    }
-   if (!writeInProgress)
-   {
-      sendFirstQueuedData();
-   }
 }
 
 void 
@@ -164,7 +171,12 @@ AsyncSocketBase::close()
 boost::shared_ptr<DataBuffer>  
 AsyncSocketBase::allocateBuffer(unsigned int size)
 {
-   return boost::shared_ptr<DataBuffer>(new DataBuffer(size));
+   // The storage, the DataBuffer object and the shared_ptr reference count are all carved 
+   // from the calling thread's DataBufferPool, so steady state relaying never touches the heap.
+   // Note:  unlike DataBuffer(size) the returned storage is not zeroed
+   return boost::allocate_shared<DataBuffer>(DataBufferPoolAllocator<DataBuffer>(), 
+                                             DataBuffer::TakeOwnership, DataBufferPool::allocate(size), size, 
+                                             &DataBufferPool::deallocate);
 }
 
 } // namespace
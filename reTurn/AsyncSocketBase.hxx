@@ -101,16 +101,6 @@ protected:
    /// just before the socket is closed
    boost::function<void(unsigned int)> mOnBeforeSocketCloseFp;
 
-private:
-   virtual void transportSend(const StunTuple& destination, std::vector<asio::const_buffer>& buffers) = 0;
-   virtual void transportReceive() = 0;
-   virtual void transportFramedReceive() = 0;
-   virtual void transportClose() = 0;
-
-   virtual const asio::ip::address getSenderEndpointAddress() = 0;
-   virtual unsigned short getSenderEndpointPort() = 0;
-
-   virtual void sendFirstQueuedData();
    class SendData
    {
    public:
@@ -124,6 +114,20 @@ private:
    /// Queue of data to send
    typedef std::deque<SendData> SendDataQueue;
    SendDataQueue mSendDataQueue;
+
+   /// Adds data (with Turn framing if channel is set) to the back of mSendDataQueue without starting a send
+   void queueSendData(const StunTuple& destination, unsigned short channel, boost::shared_ptr<DataBuffer>& data, unsigned int bufferStartPos);
+
+private:
+   virtual void transportSend(const StunTuple& destination, std::vector<asio::const_buffer>& buffers) = 0;
+   virtual void transportReceive() = 0;
+   virtual void transportFramedReceive() = 0;
+   virtual void transportClose() = 0;
+
+   virtual const asio::ip::address getSenderEndpointAddress() = 0;
+   virtual unsigned short getSenderEndpointPort() = 0;
+
+   virtual void sendFirstQueuedData();
 };
 
 typedef boost::shared_ptr<AsyncSocketBase> ConnectionPtr;
@@ -14,7 +14,14 @@ namespace reTurn {
 AsyncUdpSocketBase::AsyncUdpSocketBase(asio::io_service& ioService) 
    : AsyncSocketBase(ioService),
      mSocket(ioService),
-     mResolver(ioService)
+     mResolver(ioService),
+     mBatchSize(0)
+#ifdef RETURN_HAVE_MMSG
+     , mDispatchingReceiveBatch(false),
+     mReceiveRequestedDuringBatch(false),
+     mSendFlushPending(false),
+     mWaitingForWritable(false)
+#endif
 {
 }
 
@@ -110,13 +117,209 @@ AsyncUdpSocketBase::transportSend(const StunTuple& destination, std::vector<asio
                          boost::bind(&AsyncUdpSocketBase::handleSend, shared_from_this(), asio::placeholders::error));
 }
 
+void 
+AsyncUdpSocketBase::setBatchSize(unsigned int batchSize)
+{
+#ifdef RETURN_HAVE_MMSG
+   mBatchSize = batchSize;
+   mBatchReceiveBuffers.resize(batchSize);
+   mBatchReceiveMsgs.resize(batchSize);
+   mBatchReceiveIovecs.resize(batchSize);
+   mBatchReceiveAddresses.resize(batchSize);
+   mBatchSendMsgs.resize(batchSize);
+   mBatchSendIovecs.resize(batchSize * 2);
+   mBatchSendAddresses.resize(batchSize);
+#else
+   if(batchSize > 1)
+   {
+      WarningLog(<< "Batched UDP I/O is not supported on this platform, ignoring batch size " << batchSize);
+   }
+#endif
+}
+
+void
+AsyncUdpSocketBase::doSend(const StunTuple& destination, unsigned short channel, boost::shared_ptr<DataBuffer>& data, unsigned int bufferStartPos)
+{
+#ifdef RETURN_HAVE_MMSG
+   if(mBatchSize > 1)
+   {
+      queueSendData(destination, channel, data, bufferStartPos);
+      if(!mSendFlushPending && !mWaitingForWritable)
+      {
+         // Let any other sends generated while dispatching the current receive batch queue up 
+         // behind this one, then write them all with a single sendmmsg
+         mSendFlushPending = true;
+         mIOService.post(boost::bind(&AsyncUdpSocketBase::flushSendQueue, boost::static_pointer_cast<AsyncUdpSocketBase>(shared_from_this())));
+      }
+      return;
+   }
+#endif
+   AsyncSocketBase::doSend(destination, channel, data, bufferStartPos);
+}
+
 void 
 AsyncUdpSocketBase::transportReceive()
 {
+#ifdef RETURN_HAVE_MMSG
+   if(mBatchSize > 1)
+   {
+      if(mDispatchingReceiveBatch)
+      {
+         // Readiness wait is re-armed once the rest of the current batch has been dispatched
+         mReceiveRequestedDuringBatch = true;
+      }
+      else
+      {
+         mSocket.async_receive(asio::null_buffers(), 
+                  boost::bind(&AsyncUdpSocketBase::handleReadable, boost::static_pointer_cast<AsyncUdpSocketBase>(shared_from_this()), asio::placeholders::error));
+      }
+      return;
+   }
+#endif
    mSocket.async_receive_from(asio::buffer((void*)mReceiveBuffer->data(), RECEIVE_BUFFER_SIZE), mSenderEndpoint,
                boost::bind(&AsyncUdpSocketBase::handleReceive, shared_from_this(), asio::placeholders::error, asio::placeholders::bytes_transferred));
 }
 
+#ifdef RETURN_HAVE_MMSG
+void 
+AsyncUdpSocketBase::handleReadable(const asio::error_code& e)
+{
+   if(e)
+   {
+      handleReceive(e, 0);
+      return;
+   }
+
+   for(unsigned int i = 0; i < mBatchSize; i++)
+   {
+      if(!mBatchReceiveBuffers[i])
+      {
+         mBatchReceiveBuffers[i] = allocateBuffer(RECEIVE_BUFFER_SIZE);
+      }
+      mBatchReceiveIovecs[i].iov_base = mBatchReceiveBuffers[i]->mutableData();
+      mBatchReceiveIovecs[i].iov_len = RECEIVE_BUFFER_SIZE;
+      memset(&mBatchReceiveMsgs[i], 0, sizeof(struct mmsghdr));
+      mBatchReceiveMsgs[i].msg_hdr.msg_iov = &mBatchReceiveIovecs[i];
+      mBatchReceiveMsgs[i].msg_hdr.msg_iovlen = 1;
+      mBatchReceiveMsgs[i].msg_hdr.msg_name = &mBatchReceiveAddresses[i];
+      mBatchReceiveMsgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+   }
+
+   int received = recvmmsg(mSocket.native_handle(), &mBatchReceiveMsgs[0], mBatchSize, MSG_DONTWAIT, 0);
+   if(received < 0)
+   {
+      if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+      {
+         // Nothing to read after all - wait for the next readiness event
+         mSocket.async_receive(asio::null_buffers(), 
+                  boost::bind(&AsyncUdpSocketBase::handleReadable, boost::static_pointer_cast<AsyncUdpSocketBase>(shared_from_this()), asio::placeholders::error));
+      }
+      else
+      {
+         handleReceive(asio::error_code(errno, asio::error::get_system_category()), 0);
+      }
+      return;
+   }
+   mBatchStats.mReceiveBatches++;
+   mBatchStats.mReceivedDatagrams += received;
+
+   // Hand each datagram to the application exactly as an individual receive would, the 
+   // application's call to doReceive from onReceiveSuccess just flags that it wants more
+   mDispatchingReceiveBatch = true;
+   mReceiveRequestedDuringBatch = true;
+   for(int i = 0; i < received && mReceiveRequestedDuringBatch; i++)
+   {
+      mReceiveRequestedDuringBatch = false;
+      mReceiving = true;
+      mReceiveBuffer = mBatchReceiveBuffers[i];
+      mBatchReceiveBuffers[i].reset();  // ownership passes to the application
+      mSenderEndpoint.resize(mBatchReceiveMsgs[i].msg_hdr.msg_namelen);
+      memcpy(mSenderEndpoint.data(), &mBatchReceiveAddresses[i], mBatchReceiveMsgs[i].msg_hdr.msg_namelen);
+      handleReceive(asio::error_code(), mBatchReceiveMsgs[i].msg_len);
+   }
+   mDispatchingReceiveBatch = false;
+
+   if(mReceiveRequestedDuringBatch)
+   {
+      mSocket.async_receive(asio::null_buffers(), 
+               boost::bind(&AsyncUdpSocketBase::handleReadable, boost::static_pointer_cast<AsyncUdpSocketBase>(shared_from_this()), asio::placeholders::error));
+   }
+}
+
+void
+AsyncUdpSocketBase::flushSendQueue()
+{
+   mSendFlushPending = false;
+   while(!mSendDataQueue.empty() && !mWaitingForWritable && mSocket.is_open())
+   {
+      unsigned int count = (unsigned int)std::min(mSendDataQueue.size(), (size_t)mBatchSize);
+      for(unsigned int i = 0; i < count; i++)
+      {
+         SendData& sendData = mSendDataQueue[i];
+         struct iovec* iov = &mBatchSendIovecs[i*2];
+         unsigned int iovCount = 0;
+         if(sendData.mFrameData)
+         {
+            iov[iovCount].iov_base = sendData.mFrameData->mutableData();
+            iov[iovCount].iov_len = sendData.mFrameData->size();
+            iovCount++;
+         }
+         iov[iovCount].iov_base = sendData.mData->mutableData() + sendData.mBufferStartPos;
+         iov[iovCount].iov_len = sendData.mData->size() - sendData.mBufferStartPos;
+         iovCount++;
+
+         asio::ip::udp::endpoint destination(sendData.mDestination.getAddress(), sendData.mDestination.getPort());
+         memcpy(&mBatchSendAddresses[i], destination.data(), destination.size());
+
+         memset(&mBatchSendMsgs[i], 0, sizeof(struct mmsghdr));
+         mBatchSendMsgs[i].msg_hdr.msg_name = &mBatchSendAddresses[i];
+         mBatchSendMsgs[i].msg_hdr.msg_namelen = (socklen_t)destination.size();
+         mBatchSendMsgs[i].msg_hdr.msg_iov = iov;
+         mBatchSendMsgs[i].msg_hdr.msg_iovlen = iovCount;
+      }
+
+      int sent = sendmmsg(mSocket.native_handle(), &mBatchSendMsgs[0], count, MSG_DONTWAIT);
+      if(sent < 0)
+      {
+         if(errno == EAGAIN || errno == EWOULDBLOCK)
+         {
+            mWaitingForWritable = true;
+            mSocket.async_send(asio::null_buffers(), 
+                     boost::bind(&AsyncUdpSocketBase::handleWritable, boost::static_pointer_cast<AsyncUdpSocketBase>(shared_from_this()), asio::placeholders::error));
+         }
+         else if(errno != EINTR)
+         {
+            // Only the first datagram failed - report and drop it as an individual send would, then carry on
+            asio::error_code ec(errno, asio::error::get_system_category());
+            DebugLog(<< "flushSendQueue with error: " << ec);
+            onSendFailure(ec);
+            mSendDataQueue.pop_front();
+         }
+         continue;
+      }
+
+      mBatchStats.mSendBatches++;
+      mBatchStats.mSentDatagrams += sent;
+      for(int i = 0; i < sent; i++)
+      {
+         onSendSuccess();
+         mSendDataQueue.pop_front();
+      }
+   }
+}
+
+void
+AsyncUdpSocketBase::handleWritable(const asio::error_code& e)
+{
+   mWaitingForWritable = false;
+   if(e == asio::error::operation_aborted)
+   {
+      return;  // socket closed
+   }
+   flushSendQueue();
+}
+#endif
+
 void 
 AsyncUdpSocketBase::transportFramedReceive()
 {
@@ -9,6 +9,13 @@
 
 #include "AsyncSocketBase.hxx"
 
+// recvmmsg/sendmmsg are Linux specific
+#if defined(__linux__)
+#define RETURN_HAVE_MMSG
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
 namespace reTurn {
 
 class AsyncUdpSocketBase : public AsyncSocketBase
@@ -19,6 +26,27 @@ public:
 
    virtual unsigned int getSocketDescriptor();
 
+   /// Enables batched I/O where supported (RETURN_HAVE_MMSG): each time the socket becomes readable
+   /// up to batchSize datagrams are drained with one recvmmsg call, and sends queued while they
+   /// are processed are written with one sendmmsg call.  0 or 1 (default) disables batching.
+   /// Set before the first receive.
+   void setBatchSize(unsigned int batchSize);
+   unsigned int getBatchSize() const { return mBatchSize; }
+
+   class BatchStats
+   {
+   public:
+      BatchStats() : mReceiveBatches(0), mReceivedDatagrams(0), mSendBatches(0), mSentDatagrams(0) {}
+      unsigned long mReceiveBatches;
+      unsigned long mReceivedDatagrams;
+      unsigned long mSendBatches;
+      unsigned long mSentDatagrams;
+   };
+   const BatchStats& getBatchStats() const { return mBatchStats; }
+
+   using AsyncSocketBase::doSend;
+   virtual void doSend(const StunTuple& destination, unsigned short channel, boost::shared_ptr<DataBuffer>& data, unsigned int bufferStartPos=0);
+
    virtual asio::error_code bind(const asio::ip::address& address, unsigned short port);
    virtual void connect(const std::string& address, unsigned short port);  
 
@@ -41,7 +69,25 @@ protected:
                                  asio::ip::udp::resolver::iterator endpoint_iterator);
 
 private:
-
+   unsigned int mBatchSize;
+   BatchStats mBatchStats;
+#ifdef RETURN_HAVE_MMSG
+   std::vector<boost::shared_ptr<DataBuffer> > mBatchReceiveBuffers;
+   std::vector<struct mmsghdr> mBatchReceiveMsgs;
+   std::vector<struct iovec> mBatchReceiveIovecs;
+   std::vector<struct sockaddr_storage> mBatchReceiveAddresses;
+   std::vector<struct mmsghdr> mBatchSendMsgs;
+   std::vector<struct iovec> mBatchSendIovecs;  // 2 per datagram - Turn framing and data
+   std::vector<struct sockaddr_storage> mBatchSendAddresses;
+   bool mDispatchingReceiveBatch;
+   bool mReceiveRequestedDuringBatch;
+   bool mSendFlushPending;
+   bool mWaitingForWritable;
+
+   void handleReadable(const asio::error_code& e);
+   void handleWritable(const asio::error_code& e);
+   void flushSendQueue();
+#endif
 };
 
 }
@@ -1,6 +1,7 @@
 #include "DataBuffer.hxx"
 #include <memory.h>
 #include "rutil/ResipAssert.h"
+#include "rutil/ThreadIf.hxx"
 #include <rutil/WinLeakCheck.hxx>
 
 namespace reTurn {
@@ -10,6 +11,143 @@ void ArrayDeallocator(char* data)
    delete [] data;
 }
 
+namespace
+{
+// Each slab is prefixed with its size class - 16 bytes keeps the payload suitably
+// aligned for the objects placed there by DataBufferPoolAllocator
+const unsigned int SlabHeaderSize = 16;
+const unsigned int NotPooled = DataBufferPool::NumSlabClasses;
+const unsigned int SlabSizes[DataBufferPool::NumSlabClasses] = { DataBufferPool::SmallSlabSize, 
+                                                                 DataBufferPool::MtuSlabSize, 
+                                                                 DataBufferPool::ReceiveSlabSize };
+unsigned int sMaxFreeSlabsPerThread = 1024;
+
+struct FreeSlab
+{
+   FreeSlab* mNext;
+};
+
+struct ThreadSlabPool
+{
+   ThreadSlabPool()
+   {
+      for(unsigned int i = 0; i < DataBufferPool::NumSlabClasses; i++)
+      {
+         mFreeList[i] = 0;
+         mFreeCount[i] = 0;
+      }
+   }
+   ~ThreadSlabPool()
+   {
+      for(unsigned int i = 0; i < DataBufferPool::NumSlabClasses; i++)
+      {
+         while(mFreeList[i])
+         {
+            FreeSlab* slab = mFreeList[i];
+            mFreeList[i] = slab->mNext;
+            delete [] (reinterpret_cast<char*>(slab) - SlabHeaderSize);
+         }
+      }
+   }
+   FreeSlab* mFreeList[DataBufferPool::NumSlabClasses];
+   unsigned int mFreeCount[DataBufferPool::NumSlabClasses];
+   DataBufferPool::Stats mStats;
+};
+
+void destroyThreadSlabPool(void* pool)
+{
+   delete reinterpret_cast<ThreadSlabPool*>(pool);
+}
+
+class ThreadSlabPoolKey
+{
+public:
+   ThreadSlabPoolKey() { resip::ThreadIf::tlsKeyCreate(mKey, destroyThreadSlabPool); }
+   ThreadSlabPool* get()
+   {
+      ThreadSlabPool* pool = reinterpret_cast<ThreadSlabPool*>(resip::ThreadIf::tlsGetValue(mKey));
+      if(!pool)
+      {
+         pool = new ThreadSlabPool;
+         resip::ThreadIf::tlsSetValue(mKey, pool);
+      }
+      return pool;
+   }
+private:
+   resip::ThreadIf::TlsKey mKey;
+};
+ThreadSlabPoolKey sThreadSlabPoolKey;
+}
+
+char* 
+DataBufferPool::allocate(unsigned int size)
+{
+   ThreadSlabPool* pool = sThreadSlabPoolKey.get();
+   unsigned int slabClass = 0;
+   while(slabClass < NumSlabClasses && size > SlabSizes[slabClass])
+   {
+      slabClass++;
+   }
+
+   char* block;
+   if(slabClass == NotPooled)
+   {
+      pool->mStats.mHeapAllocations++;
+      block = new char[SlabHeaderSize + size];
+   }
+   else if(pool->mFreeList[slabClass])
+   {
+      pool->mStats.mPoolHits++;
+      FreeSlab* slab = pool->mFreeList[slabClass];
+      pool->mFreeList[slabClass] = slab->mNext;
+      pool->mFreeCount[slabClass]--;
+      return reinterpret_cast<char*>(slab);  // header is still intact from the first allocation
+   }
+   else
+   {
+      pool->mStats.mPoolMisses++;
+      block = new char[SlabHeaderSize + SlabSizes[slabClass]];
+   }
+   *reinterpret_cast<unsigned int*>(block) = slabClass;
+   return block + SlabHeaderSize;
+}
+
+void 
+DataBufferPool::deallocate(char* data)
+{
+   if(!data)
+   {
+      return;
+   }
+   char* block = data - SlabHeaderSize;
+   unsigned int slabClass = *reinterpret_cast<unsigned int*>(block);
+   if(slabClass != NotPooled)
+   {
+      ThreadSlabPool* pool = sThreadSlabPoolKey.get();
+      if(pool->mFreeCount[slabClass] < sMaxFreeSlabsPerThread)
+      {
+         FreeSlab* slab = reinterpret_cast<FreeSlab*>(data);
+         slab->mNext = pool->mFreeList[slabClass];
+         pool->mFreeList[slabClass] = slab;
+         pool->mFreeCount[slabClass]++;
+         return;
+      }
+   }
+   delete [] block;
+}
+
+void 
+DataBufferPool::setMaxFreeSlabsPerThread(unsigned int maxFreeSlabs)
+{
+   sMaxFreeSlabsPerThread = maxFreeSlabs;
+}
+
+DataBufferPool::Stats 
+DataBufferPool::getThreadStats()
+{
+   return sThreadSlabPoolKey.get()->mStats;
+}
+
 DataBuffer::DataBuffer(const char* data, unsigned int size, deallocator dealloc)
    : mDealloc(dealloc)
 {
@@ -37,6 +175,14 @@ DataBuffer::DataBuffer(unsigned int size, deallocator dealloc)
    mStart  = mBuffer;
 }
 
+DataBuffer::DataBuffer(TakeOwnershipEnum, char* data, unsigned int size, deallocator dealloc)
+   : mBuffer(data),
+     mSize(size),
+     mStart(data),
+     mDealloc(dealloc)
+{
+}
+
 DataBuffer::~DataBuffer() 
 { 
    mDealloc(mBuffer);
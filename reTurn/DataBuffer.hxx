@@ -1,17 +1,92 @@
 #ifndef DATA_BUFFER_HXX
 #define DATA_BUFFER_HXX
 
+#include <cstddef>
+#include <new>
+
 namespace reTurn {
 
 void ArrayDeallocator(char* data);
 
+/**
+  Per-thread free lists of fixed size slabs used to back packet buffers on the
+  receive and relay paths.  Slabs are handed out by size class (small frames,
+  one MTU, one receive buffer) and are returned to the free list of whichever
+  thread releases them, so buffers may safely be freed on a thread other than
+  the one that allocated them.  Requests larger than the largest class fall
+  through to the heap.
+*/
+class DataBufferPool
+{
+public:
+   enum 
+   { 
+      SmallSlabSize = 128, 
+      MtuSlabSize = 1500, 
+      ReceiveSlabSize = 4096,  // must be >= RECEIVE_BUFFER_SIZE
+      NumSlabClasses = 3
+   };
+
+   /// Returns uninitialized storage of at least size bytes - release with deallocate
+   static char* allocate(unsigned int size);
+   /// Matches DataBuffer::deallocator, so pooled storage can be owned by a DataBuffer
+   static void deallocate(char* data);
+
+   /// Caps the number of idle slabs of each class kept by each thread (default 1024)
+   static void setMaxFreeSlabsPerThread(unsigned int maxFreeSlabs);
+
+   class Stats
+   {
+   public:
+      Stats() : mPoolHits(0), mPoolMisses(0), mHeapAllocations(0) {}
+      unsigned long mPoolHits;         // allocations served from a free list
+      unsigned long mPoolMisses;       // allocations of a pooled size class that hit the heap
+      unsigned long mHeapAllocations;  // allocations too large for any size class
+   };
+   /// Statistics for the calling thread only
+   static Stats getThreadStats();
+};
+
+/** STL style allocator over DataBufferPool, used so that the shared_ptr control 
+    block and DataBuffer object of a packet are carved from a pooled slab as well */
+template<typename T>
+class DataBufferPoolAllocator
+{
+public:
+   typedef T value_type;
+   typedef T* pointer;
+   typedef const T* const_pointer;
+   typedef T& reference;
+   typedef const T& const_reference;
+   typedef std::size_t size_type;
+   typedef std::ptrdiff_t difference_type;
+   template<typename U> struct rebind { typedef DataBufferPoolAllocator<U> other; };
+
+   DataBufferPoolAllocator() {}
+   template<typename U> DataBufferPoolAllocator(const DataBufferPoolAllocator<U>&) {}
+
+   pointer address(reference r) const { return &r; }
+   const_pointer address(const_reference r) const { return &r; }
+   pointer allocate(size_type n, const void* = 0) { return reinterpret_cast<pointer>(DataBufferPool::allocate((unsigned int)(n * sizeof(T)))); }
+   void deallocate(pointer p, size_type) { DataBufferPool::deallocate(reinterpret_cast<char*>(p)); }
+   size_type max_size() const { return DataBufferPool::ReceiveSlabSize / sizeof(T); }
+   void construct(pointer p, const T& val) { new(p) T(val); }
+   void destroy(pointer p) { p->~T(); }
+
+   template<typename U> bool operator==(const DataBufferPoolAllocator<U>&) const { return true; }
+   template<typename U> bool operator!=(const DataBufferPoolAllocator<U>&) const { return false; }
+};
+
 class DataBuffer
 {
 public:
    typedef void(*deallocator)(char*);
+   enum TakeOwnershipEnum { TakeOwnership };
 
    DataBuffer(const char* data, unsigned int size, deallocator dealloc=ArrayDeallocator);  
    DataBuffer(unsigned int size, deallocator dealloc=ArrayDeallocator);  
+   /// Adopts data (no copy) - it is released with dealloc on destruction
+   DataBuffer(TakeOwnershipEnum, char* data, unsigned int size, deallocator dealloc);  
    ~DataBuffer();
 
    static DataBuffer* own(char* data, unsigned int size, deallocator dealloc=ArrayDeallocator);
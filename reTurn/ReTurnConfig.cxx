@@ -47,6 +47,7 @@ ReTurnConfig::ReTurnConfig() :
    mDefaultAllocationLifetime(600), // 10 minutes
    mMaxAllocationLifetime(3600),    // 1 hour
    mMaxAllocationsPerUser(0),       // 0 - no max
+   mUdpBatchSize(0),                // 0 - no batching
    mTlsServerCertificateFilename("server.pem"),
    mTlsServerPrivateKeyFilename(""),
    mTlsTempDhFilename("dh2048.pem"),
@@ -61,7 +62,8 @@ ReTurnConfig::ReTurnConfig() :
    mDaemonize(false),
    mPidFile(""),
    mRunAsUser(""),
-   mRunAsGroup("")
+   mRunAsGroup(""),
+   mUserDatabaseGeneration(0)
 {
 }
 
@@ -85,6 +87,7 @@ void ReTurnConfig::parseConfig(int argc, char** argv, const resip::Data& default
    mDefaultAllocationLifetime = getConfigUnsignedLong("DefaultAllocationLifetime", mDefaultAllocationLifetime);
    mMaxAllocationLifetime = getConfigUnsignedLong("MaxAllocationLifetime", mMaxAllocationLifetime);
    mMaxAllocationsPerUser = getConfigUnsignedLong("MaxAllocationsPerUser", mMaxAllocationsPerUser);
+   mUdpBatchSize = getConfigUnsignedLong("UdpBatchSize", mUdpBatchSize);
    mTlsServerCertificateFilename = getConfigData("TlsServerCertificateFilename", mTlsServerCertificateFilename);
    mTlsServerPrivateKeyFilename = getConfigData("TlsServerPrivateKeyFilename", mTlsServerPrivateKeyFilename);
    mTlsTempDhFilename = getConfigData("TlsTempDhFilename", mTlsTempDhFilename);
@@ -148,7 +151,7 @@ ReTurnConfig::addUser(const resip::Data& username, const resip::Data& password,
          UserAuthData::createFromHex(username, realm, password)
        : UserAuthData::createFromPassword(username, realm, password)
       );
-   mRealmUsersAuthenticaionCredentials[std::make_pair(username, realm)] = newUser.getHa1();
+   mRealmUsersAuthenticaionCredentials[std::make_pair(username, realm)] = StunHmacKeyPtr(new StunHmacKey(newUser.getHa1()));
    RealmUsers& realmUsers(mUsers[realm]);
    realmUsers.insert(pair<resip::Data,UserAuthData>(username, newUser));
 }
@@ -166,6 +169,7 @@ ReTurnConfig::authParse(const resip::Data& accountDatabaseFilename)
 
    mUsers.clear();
    mRealmUsersAuthenticaionCredentials.clear();
+   mUserDatabaseGeneration++;
 
    while(std::getline(accountDatabaseFile, sline))
    {
@@ -318,11 +322,10 @@ ReTurnConfig::isUserNameValid(const resip::Data& username, const resip::Data& re
 Data
 ReTurnConfig::getHa1ForUsername(const Data& username, const resip::Data& realm) const
 {
-   ReadLock lock(mUserDataMutex);
-   std::map<RealmUserPair, resip::Data>::const_iterator it = mRealmUsersAuthenticaionCredentials.find(std::make_pair(username, realm));
-   if(it != mRealmUsersAuthenticaionCredentials.end())
+   StunHmacKeyPtr hmacKey = getHmacKeyForUsername(username, realm);
+   if(hmacKey)
    {
-      return it->second;
+      return hmacKey->getKey();
    }
    else
    {
@@ -330,6 +333,25 @@ ReTurnConfig::getHa1ForUsername(const Data& username, const resip::Data& realm)
    }
 }
 
+StunHmacKeyPtr
+ReTurnConfig::getHmacKeyForUsername(const Data& username, const resip::Data& realm) const
+{
+   ReadLock lock(mUserDataMutex);
+   std::map<RealmUserPair, StunHmacKeyPtr>::const_iterator it = mRealmUsersAuthenticaionCredentials.find(std::make_pair(username, realm));
+   if(it != mRealmUsersAuthenticaionCredentials.end())
+   {
+      return it->second;
+   }
+   return StunHmacKeyPtr();
+}
+
+unsigned long
+ReTurnConfig::getUserDatabaseGeneration() const
+{
+   ReadLock lock(mUserDataMutex);
+   return mUserDatabaseGeneration;
+}
+
 std::auto_ptr<UserAuthData>
 ReTurnConfig::getUser(const resip::Data& userName, const resip::Data& realm) const
 {
@@ -339,7 +361,7 @@ ReTurnConfig::getUser(const resip::Data& userName, const resip::Data& realm) con
    if(it == mUsers.end())
       return ret;
 
-   RealmUsers realmUsers = it->second;
+   const RealmUsers& realmUsers = it->second;
    RealmUsers::const_iterator it2 = realmUsers.find(userName);
    if(it2 == realmUsers.end())
       return ret;
@@ -14,6 +14,7 @@
 #include <rutil/Lock.hxx>
 
 #include <reTurn/UserAuthData.hxx>
+#include <reTurn/StunMessage.hxx>
 
 namespace reTurn {
 
@@ -69,6 +70,7 @@ public:
    unsigned long mDefaultAllocationLifetime;
    unsigned long mMaxAllocationLifetime;
    unsigned long mMaxAllocationsPerUser;  // TODO - enforcement needs to be implemented
+   unsigned int mUdpBatchSize;
 
    resip::Data mTlsServerCertificateFilename;
    resip::Data mTlsServerPrivateKeyFilename;
@@ -90,13 +92,19 @@ public:
 
    bool isUserNameValid(const resip::Data& username,  const resip::Data& realm) const;
    resip::Data getHa1ForUsername(const resip::Data& username, const resip::Data& realm) const;
+   /// Returns the prepared MESSAGE-INTEGRITY key for the user, or an empty pointer if the user is unknown
+   StunHmacKeyPtr getHmacKeyForUsername(const resip::Data& username, const resip::Data& realm) const;
+   /// Incremented each time the user database is (re)loaded - keys cached outside of the config are
+   /// only valid for the generation they were obtained in
+   unsigned long getUserDatabaseGeneration() const;
    std::auto_ptr<UserAuthData> getUser(const resip::Data& userName, const resip::Data& realm) const;
    void addUser(const resip::Data& username, const resip::Data& password, const resip::Data& realm);
    void authParse(const resip::Data& accountDatabaseFilename);
 
 private:
    std::map<resip::Data,RealmUsers> mUsers;
-   std::map<RealmUserPair, resip::Data> mRealmUsersAuthenticaionCredentials;
+   std::map<RealmUserPair, StunHmacKeyPtr> mRealmUsersAuthenticaionCredentials;  // HA1 keyed by user and realm, with HMAC key schedule precomputed
+   unsigned long mUserDatabaseGeneration;
 
    friend class ReTurnUserFileScanner;
 };
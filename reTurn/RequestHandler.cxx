@@ -50,7 +50,7 @@ RequestHandler::processStunMessage(AsyncSocketBase* turnSocket, TurnAllocationMa
 
    response.mRemoteTuple = request.mRemoteTuple; // Default to send response back to sender
 
-   if(handleAuthentication(request, response))  
+   if(handleAuthentication(turnAllocationManager, request, response))  
    {
       // Check if there were unknown require attributes
       if(request.mUnknownRequiredAttributes.numAttributes > 0)
@@ -230,7 +230,7 @@ RequestHandler::checkNonce(const Data& nonce)
 }
 
 bool 
-RequestHandler::handleAuthentication(StunMessage& request, StunMessage& response)
+RequestHandler::handleAuthentication(TurnAllocationManager& turnAllocationManager, StunMessage& request, StunMessage& response)
 {
    // Don't authenticate shared secret requests, Binding Requests or Indications (if LongTermCredentials are used)
    if((request.mClass == StunMessage::StunClassRequest && request.mMethod == StunMessage::SharedSecretMethod) ||
@@ -287,25 +287,36 @@ RequestHandler::handleAuthentication(StunMessage& request, StunMessage& response
 
       StackLog(<< "Validating username: " << *request.mUsername);  // Note: we ensure username is present above
 
-      // !slg! need to determine whether the USERNAME contains a known entity, and is known 
-      //       within the realm of the REALM attribute of the request
-      if (!getConfig().isUserNameValid(*request.mUsername, *request.mRealm))
+      // Need to calculate HMAC across entire message - for LongTermAuthentication we use 
+      // MD5(username:realm:password) as the key, which is derived once when the user database
+      // is loaded.  Requests on an existing allocation reuse the key it was created with, 
+      // provided the user database has not been reloaded since.
+      StunHmacKeyPtr hmacKey;
+      TurnAllocation* allocation = turnAllocationManager.findTurnAllocation(TurnAllocationKey(request.mLocalTuple, request.mRemoteTuple));
+      if(allocation && 
+         allocation->getClientAuth().getClientHmacKey() &&
+         allocation->getClientAuth().getUserDatabaseGeneration() == getConfig().getUserDatabaseGeneration() &&
+         allocation->getClientAuth().getClientUsername() == *request.mUsername &&
+         allocation->getClientAuth().getClientRealm() == *request.mRealm)
+      {
+         hmacKey = allocation->getClientAuth().getClientHmacKey();
+      }
+      else
       {
-         WarningLog(<< "Invalid username '" << *request.mUsername << "' or realm '" << *request.mRealm << "' (username unknown or potential AuthorizationRealm mismatch). Sending 401. Sender=" << request.mRemoteTuple);
-         buildErrorResponse(response, 401, "Unauthorized", getConfig().mAuthenticationRealm.c_str());
-         return false;
+         // !slg! need to determine whether the USERNAME contains a known entity, and is known 
+         //       within the realm of the REALM attribute of the request
+         hmacKey = getConfig().getHmacKeyForUsername(*request.mUsername, *request.mRealm);
+         if(!hmacKey)
+         {
+            WarningLog(<< "Invalid username '" << *request.mUsername << "' or realm '" << *request.mRealm << "' (username unknown or potential AuthorizationRealm mismatch). Sending 401. Sender=" << request.mRemoteTuple);
+            buildErrorResponse(response, 401, "Unauthorized", getConfig().mAuthenticationRealm.c_str());
+            return false;
+         }
       }
 
       StackLog(<< "Validating MessageIntegrity");
 
-      // Need to calculate HMAC across entire message - for LongTermAuthentication we use 
-      // username:realm:password string as the key
-      Data hmacKey;
-      resip_assert(request.mHasUsername);  // Note:  This is checked above
-
-      request.calculateHmacKeyForHa1(hmacKey, getConfig().getHa1ForUsername(*request.mUsername, *request.mRealm));
-
-      if(!request.checkMessageIntegrity(hmacKey))
+      if(!request.checkMessageIntegrity(*hmacKey))
       {
          WarningLog(<< "MessageIntegrity is bad. Sending 401. Sender=" << request.mRemoteTuple);
          buildErrorResponse(response, 401, "Unauthorized", getConfig().mAuthenticationRealm.c_str());
@@ -314,7 +325,8 @@ RequestHandler::handleAuthentication(StunMessage& request, StunMessage& response
 
       // need to compute this later after message is filled in
       response.mHasMessageIntegrity = true;
-      response.mHmacKey = hmacKey;  // Used to later calculate Message Integrity during encoding
+      response.mHmacKey = hmacKey->getKey();
+      response.mPreparedHmacKey = hmacKey;  // Used to later calculate Message Integrity during encoding
    }
 
    return true;
@@ -585,7 +597,7 @@ RequestHandler::processTurnAllocateRequest(AsyncSocketBase* turnSocket, TurnAllo
                                       turnSocket, 
                                       request.mLocalTuple, 
                                       request.mRemoteTuple, 
-                                      StunAuth(*request.mUsername, response.mHmacKey), // The HMAC is already calculated and added to the response in handleAuthentication
+                                      StunAuth(*request.mUsername, *request.mRealm, response.mPreparedHmacKey, getConfig().getUserDatabaseGeneration()), // The HMAC key is already prepared and added to the response in handleAuthentication
                                       allocationTuple, 
                                       lifetime);
       if(!allocation->startRelay())
@@ -876,8 +888,20 @@ RequestHandler::processTurnSendIndication(TurnAllocationManager& turnAllocationM
    // Shouldn't have more than one xor-peer-address attribute in this request
    StunMessage::setTupleFromStunAtrAddress(remoteAddress, request.mTurnXorPeerAddress[0]);
 
-   boost::shared_ptr<DataBuffer> data(new DataBuffer(request.mTurnData->data(), request.mTurnData->size()));
-   allocation->sendDataToPeer(remoteAddress, data, false /* isFramed? */);
+   if(request.mReceiveBuffer)
+   {
+      // TurnData overlays the receive buffer - relay it from there without copying
+      boost::shared_ptr<DataBuffer> data = request.mReceiveBuffer;
+      unsigned int dataOffset = (unsigned int)(request.mTurnData->data() - data->data());
+      data->truncate(dataOffset + (unsigned int)request.mTurnData->size());
+      allocation->sendDataToPeer(remoteAddress, data, dataOffset);
+   }
+   else
+   {
+      boost::shared_ptr<DataBuffer> data = AsyncSocketBase::allocateBuffer((unsigned int)request.mTurnData->size());
+      memcpy(data->mutableData(), request.mTurnData->data(), request.mTurnData->size());
+      allocation->sendDataToPeer(remoteAddress, data, 0);
+   }
 }
 
 void 
@@ -891,7 +915,7 @@ RequestHandler::processTurnData(TurnAllocationManager& turnAllocationManager, un
       return;
    }
 
-   allocation->sendDataToPeer(channelNumber, data, true /* isFramed? */);
+   allocation->sendDataToPeer(channelNumber, data, 4 /* skip ChannelData framing */);
 }
 
 } // namespace
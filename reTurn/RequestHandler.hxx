@@ -52,7 +52,7 @@ private:
    resip::Data mPrivateNonceKey;
 
    // Authentication handler
-   bool handleAuthentication(StunMessage& request, StunMessage& response);
+   bool handleAuthentication(TurnAllocationManager& turnAllocationManager, StunMessage& request, StunMessage& response);
 
    // Specific request processors
    ProcessResult processStunBindingRequest(StunMessage& request, StunMessage& response, bool isRFC3489BackwardsCompatServer);
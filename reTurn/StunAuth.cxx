@@ -8,7 +8,20 @@ namespace reTurn {
 StunAuth::StunAuth(const Data& clientUsername,
                    const Data& clientSharedSecret) :
    mClientUsername(clientUsername),
-   mClientSharedSecret(clientSharedSecret)
+   mClientSharedSecret(clientSharedSecret),
+   mUserDatabaseGeneration(0)
+{
+}
+
+StunAuth::StunAuth(const Data& clientUsername,
+                   const Data& clientRealm,
+                   const StunHmacKeyPtr& clientHmacKey,
+                   unsigned long userDatabaseGeneration) :
+   mClientUsername(clientUsername),
+   mClientRealm(clientRealm),
+   mClientSharedSecret(clientHmacKey->getKey()),
+   mClientHmacKey(clientHmacKey),
+   mUserDatabaseGeneration(userDatabaseGeneration)
 {
 }
 
@@ -2,6 +2,7 @@
 #define STUNAUTH_HXX
 
 #include <rutil/Data.hxx>
+#include "StunMessage.hxx"
 
 namespace reTurn {
 
@@ -10,13 +11,25 @@ class StunAuth
 public:
    explicit StunAuth(const resip::Data& clientUsername,
                      const resip::Data& clientSharedSecret);
+   /// Keeps the prepared HMAC key so subsequent requests on the allocation skip
+   /// the user database lookup while userDatabaseGeneration is still current
+   explicit StunAuth(const resip::Data& clientUsername,
+                     const resip::Data& clientRealm,
+                     const StunHmacKeyPtr& clientHmacKey,
+                     unsigned long userDatabaseGeneration);
 
    const resip::Data& getClientUsername() const { return mClientUsername; }
+   const resip::Data& getClientRealm() const { return mClientRealm; }
    const resip::Data& getClientSharedSecret() const { return mClientSharedSecret; }
+   const StunHmacKeyPtr& getClientHmacKey() const { return mClientHmacKey; }
+   unsigned long getUserDatabaseGeneration() const { return mUserDatabaseGeneration; }
 
 private:
    resip::Data mClientUsername;
+   resip::Data mClientRealm;
    resip::Data mClientSharedSecret;
+   StunHmacKeyPtr mClientHmacKey;
+   unsigned long mUserDatabaseGeneration;
 };
 
 } 
@@ -83,6 +83,23 @@ StunMessage::StunMessage(const StunTuple& localTuple,
    }
 }
 
+StunMessage::StunMessage(const StunTuple& localTuple,
+                         const StunTuple& remoteTuple,
+                         boost::shared_ptr<DataBuffer>& receiveBuffer) :
+   mLocalTuple(localTuple),
+   mRemoteTuple(remoteTuple),
+   mBuffer(resip::Data::Share, receiveBuffer->data(), receiveBuffer->size()),
+   mReceiveBuffer(receiveBuffer)
+{
+   init();
+   mIsValid = stunParseMessage(receiveBuffer->mutableData(), receiveBuffer->size());
+  
+   if(mIsValid)
+   {
+      DebugLog(<< "Successfully parsed StunMessage: " << mHeader);
+   }
+}
+
 StunMessage::StunMessage() :
    mIsValid(true)
 {
@@ -1403,6 +1420,7 @@ StunMessage::encodeAtrUnknown(char* ptr, const StunAtrUnknown& atr)
    {
       ptr = encode16(ptr, atr.attrType[i]);
    }
+   memset(ptr, 0, padsize);  // buffers are not zeroed, so never send whatever was there before
    return ptr+padsize;
 }
 
@@ -1641,9 +1659,17 @@ StunMessage::stunEncodeMessage(char* buf, unsigned int bufLen)
    if (mHasMessageIntegrity)
    {
       int len = ptr - buf;
-      StackLog(<< "Adding message integrity: buffer size=" << len << ", hmacKey=" << mHmacKey.hex());
       StunAtrIntegrity integrity;
-      computeHmac(integrity.hash, buf, len, mHmacKey.c_str(), (int)mHmacKey.size());
+      if(mPreparedHmacKey)
+      {
+         StackLog(<< "Adding message integrity: buffer size=" << len << ", hmacKey=" << mPreparedHmacKey->getKey().hex());
+         mPreparedHmacKey->computeHmac(integrity.hash, buf, len);
+      }
+      else
+      {
+         StackLog(<< "Adding message integrity: buffer size=" << len << ", hmacKey=" << mHmacKey.hex());
+         computeHmac(integrity.hash, buf, len, mHmacKey.c_str(), (int)mHmacKey.size());
+      }
 	   ptr = encodeAtrIntegrity(ptr, integrity);
    }
 
@@ -1678,6 +1704,17 @@ StunMessage::stunEncodeFramedMessage(char* buf, unsigned int bufLen)
 }
 
 #ifndef USE_SSL
+StunHmacKey::StunHmacKey(const Data& key) :
+   mKey(key)
+{
+}
+
+void
+StunHmacKey::computeHmac(char* hmac, const char* input, int length) const
+{
+   strncpy(hmac,"hmac-not-implemented",20);
+}
+
 void
 StunMessage::computeHmac(char* hmac, const char* input, int length, const char* key, int sizeKey)
 {
@@ -1685,6 +1722,50 @@ StunMessage::computeHmac(char* hmac, const char* input, int length, const char*
    strncpy(hmac,"hmac-not-implemented",20);
 }
 #else
+StunHmacKey::StunHmacKey(const Data& key) :
+   mKey(key)
+{
+   // RFC2104 - keys longer than the block size are hashed first, shorter keys are zero padded
+   unsigned char block[SHA_CBLOCK];
+   memset(block, 0, sizeof(block));
+   if(mKey.size() > SHA_CBLOCK)
+   {
+      SHA1(reinterpret_cast<const unsigned char*>(mKey.data()), mKey.size(), block);
+   }
+   else
+   {
+      memcpy(block, mKey.data(), mKey.size());
+   }
+
+   unsigned char pad[SHA_CBLOCK];
+   for(unsigned int i = 0; i < SHA_CBLOCK; i++)
+   {
+      pad[i] = block[i] ^ 0x36;
+   }
+   SHA1_Init(&mInnerContext);
+   SHA1_Update(&mInnerContext, pad, SHA_CBLOCK);
+
+   for(unsigned int i = 0; i < SHA_CBLOCK; i++)
+   {
+      pad[i] = block[i] ^ 0x5c;
+   }
+   SHA1_Init(&mOuterContext);
+   SHA1_Update(&mOuterContext, pad, SHA_CBLOCK);
+}
+
+void
+StunHmacKey::computeHmac(char* hmac, const char* input, int length) const
+{
+   unsigned char innerHash[SHA_DIGEST_LENGTH];
+   SHA_CTX context = mInnerContext;
+   SHA1_Update(&context, input, length);
+   SHA1_Final(innerHash, &context);
+
+   context = mOuterContext;
+   SHA1_Update(&context, innerHash, SHA_DIGEST_LENGTH);
+   SHA1_Final(reinterpret_cast<unsigned char*>(hmac), &context);
+}
+
 void
 StunMessage::computeHmac(char* hmac, const char* input, int length, const char* key, int sizeKey)
 {
@@ -1837,6 +1918,12 @@ StunMessage::calculateHmacKey(Data& hmacKey, const Data& username, const Data& r
 
 bool 
 StunMessage::checkMessageIntegrity(const Data& hmacKey)
+{
+   return checkMessageIntegrity(StunHmacKey(hmacKey));
+}
+
+bool 
+StunMessage::checkMessageIntegrity(const StunHmacKey& hmacKey)
 {
    if(mHasMessageIntegrity)
    {
@@ -1853,8 +1940,8 @@ StunMessage::checkMessageIntegrity(const Data& hmacKey)
 
       // Calculate HMAC
       int iHMACBufferSize = mMessageIntegrityMsgLength - 24 /* MessageIntegrity size */ + sizeof(StunMsgHdr); // The entire message proceeding the message integrity attribute
-      StackLog(<< "Checking message integrity: length=" << mMessageIntegrityMsgLength << ", size=" << iHMACBufferSize << ", hmacKey=" << hmacKey.hex());
-      computeHmac((char*)hmac, mBuffer.data(), iHMACBufferSize, hmacKey.c_str(), hmacKey.size());
+      StackLog(<< "Checking message integrity: length=" << mMessageIntegrityMsgLength << ", size=" << iHMACBufferSize << ", hmacKey=" << hmacKey.getKey().hex());
+      hmacKey.computeHmac((char*)hmac, mBuffer.data(), iHMACBufferSize);
 
       // Restore original stun message length in mBuffer
       memcpy(lengthposition, &originalLength, 2);
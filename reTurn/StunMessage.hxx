@@ -7,9 +7,13 @@
 #include <asio.hpp>
 #ifdef USE_SSL
 #include <asio/ssl.hpp>
+#include <openssl/sha.h>
 #endif
 
+#include <boost/shared_ptr.hpp>
+
 #include "StunTuple.hxx"
+#include "DataBuffer.hxx"
 
 #define STUN_MAX_UNKNOWN_ATTRIBUTES 8
 #define TURN_MAX_XOR_PEER_ADDR      8
@@ -25,6 +29,29 @@ bool operator<(const UInt128&, const UInt128&);
 bool operator==(const UInt128&, const UInt128&);
 #endif
 
+/**
+  A MESSAGE-INTEGRITY key with its HMAC-SHA1 inner and outer pad state 
+  precomputed.  Messages authenticated with the same key (ie. every request
+  on an allocation) can then be checked and signed without re-running the
+  HMAC key schedule.
+*/
+class StunHmacKey
+{
+public:
+   explicit StunHmacKey(const resip::Data& key);
+
+   const resip::Data& getKey() const { return mKey; }
+   void computeHmac(char* hmac, const char* input, int length) const;
+
+private:
+   resip::Data mKey;
+#ifdef USE_SSL
+   SHA_CTX mInnerContext;
+   SHA_CTX mOuterContext;
+#endif
+};
+typedef boost::shared_ptr<StunHmacKey> StunHmacKeyPtr;
+
 class StunMessage
 {
 public:
@@ -32,6 +59,12 @@ public:
                         const StunTuple& remoteTuple,
                         char* buf, unsigned int bufLen);
 
+   /// Parses in place - the message shares (and keeps alive) the receive buffer instead 
+   /// of copying it, so TurnData can be relayed straight out of it
+   explicit StunMessage(const StunTuple& localTuple,
+                        const StunTuple& remoteTuple,
+                        boost::shared_ptr<DataBuffer>& receiveBuffer);
+
    explicit StunMessage();
 
    StunMessage(const StunMessage& message);
@@ -66,6 +99,7 @@ public:
    void calculateHmacKeyForHa1(resip::Data& hmacKey, const resip::Data& ha1);
    void calculateHmacKey(resip::Data& hmacKey, const resip::Data& username, const resip::Data& realm, const resip::Data& longtermAuthenticationPassword);
    bool checkMessageIntegrity(const resip::Data& hmacKey);
+   bool checkMessageIntegrity(const StunHmacKey& hmacKey);
    bool checkFingerprint();
 
    /// define stun address families
@@ -238,7 +272,9 @@ public:
    StunTuple mLocalTuple;  // Local address and port that received the stun message
    StunTuple mRemoteTuple; // Remote address and port that sent the stun message
    resip::Data mBuffer;
+   boost::shared_ptr<DataBuffer> mReceiveBuffer;  // Only set if parsed in place, backs mBuffer and mTurnData
    resip::Data mHmacKey;
+   StunHmacKeyPtr mPreparedHmacKey;  // If set, used in place of mHmacKey when encoding MessageIntegrity
 
    UInt16 mMessageIntegrityMsgLength;
 
@@ -107,7 +107,7 @@ TlsConnection::onReceiveSuccess(const asio::ip::address& address, unsigned short
          // Try to parse stun message
          StunMessage request(StunTuple(StunTuple::TLS, mLocalAddress, mLocalPort),
                              StunTuple(StunTuple::TLS, address, port),
-                             (char*)&(*data)[0], data->size());
+                             data);
          if(request.isValid())
          {
             StunMessage response;
@@ -79,6 +79,7 @@ TurnAllocation::startRelay()
    if(mRequestedTuple.getTransportType() == StunTuple::UDP)
    {
       mUdpRelayServer.reset(new UdpRelayServer(mTurnManager.getIOService(), *this));
+      mUdpRelayServer->setBatchSize(mTurnManager.getConfig().mUdpBatchSize);
       if(!mUdpRelayServer->startReceiving())
       {
          stopRelay();  // Ensure allocation timer is stopped
@@ -169,13 +170,13 @@ TurnAllocation::onSocketDestroyed()
 }
 
 void 
-TurnAllocation::sendDataToPeer(unsigned short channelNumber, boost::shared_ptr<DataBuffer>& data, bool isFramed)
+TurnAllocation::sendDataToPeer(unsigned short channelNumber, boost::shared_ptr<DataBuffer>& data, unsigned int dataOffset)
 {
    RemotePeer* remotePeer = mChannelManager.findRemotePeerByChannel(channelNumber);
    if(remotePeer)
    {
       // channel found - send Data
-      sendDataToPeer(remotePeer->getPeerTuple(), data, isFramed);
+      sendDataToPeer(remotePeer->getPeerTuple(), data, dataOffset);
    }
    else
    {
@@ -195,7 +196,7 @@ TurnAllocation::sendDataToPeer(unsigned short channelNumber, boost::shared_ptr<D
 }
 
 void 
-TurnAllocation::sendDataToPeer(const StunTuple& peerAddress, boost::shared_ptr<DataBuffer>& data, bool isFramed)
+TurnAllocation::sendDataToPeer(const StunTuple& peerAddress, boost::shared_ptr<DataBuffer>& data, unsigned int dataOffset)
 {
    DebugLog(<< "TurnAllocation sendDataToPeer: clientLocal=" << mKey.getClientLocalTuple() << " clientRemote=" << 
            mKey.getClientRemoteTuple() << " allocation=" << mRequestedTuple << " peerAddress=" << peerAddress);
@@ -218,11 +219,11 @@ TurnAllocation::sendDataToPeer(const StunTuple& peerAddress, boost::shared_ptr<D
    if(mRequestedTuple.getTransportType() == StunTuple::UDP)
    {
       resip_assert(mUdpRelayServer);
-      mUdpRelayServer->doSend(peerAddress, data, isFramed ? 4 /* bufferStartPos is 4 so that framing is skipped */ : 0);
+      mUdpRelayServer->doSend(peerAddress, data, dataOffset /* bufferStartPos skips any framing or STUN headers */);
    }
    else
    {
-      if(data->size() <=4)
+      if(data->size() <= dataOffset)
       {
          WarningLog(<< "Turn send indication with no data for non-UDP transport.  Dropping.");
          return;
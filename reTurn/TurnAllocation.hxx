@@ -56,9 +56,9 @@ public:
    void onSocketDestroyed();
 
    // Used when framed data is received from client, to forward data to peer
-   void sendDataToPeer(unsigned short channelNumber, boost::shared_ptr<DataBuffer>& data, bool isFramed);
+   void sendDataToPeer(unsigned short channelNumber, boost::shared_ptr<DataBuffer>& data, unsigned int dataOffset);
    // Used when Send Indication is received from client, to forward data to peer
-   void sendDataToPeer(const StunTuple& peerAddress, boost::shared_ptr<DataBuffer>& data, bool isFramed);  
+   void sendDataToPeer(const StunTuple& peerAddress, boost::shared_ptr<DataBuffer>& data, unsigned int dataOffset);  
    // Used when Data is received from peer, to forward data to client
    void sendDataToClient(const StunTuple& peerAddress, boost::shared_ptr<DataBuffer>& data); 
 
@@ -93,7 +93,7 @@ UdpServer::onReceiveSuccess(const asio::ip::address& address, unsigned short por
          // Try to parse stun message
          StunMessage request(StunTuple(StunTuple::UDP, mLocalAddress, mLocalPort),
                              StunTuple(StunTuple::UDP, address, port),
-                             (char*)&(*data)[0], data->size());
+                             data);
          if(request.isValid())
          {
             StunMessage* response;
@@ -162,6 +162,8 @@ UdpServer::onReceiveSuccess(const asio::ip::address& address, unsigned short por
          }
          else
          {
+            // Relay straight out of the receive buffer - drop any trailing padding so only the application data goes to the peer
+            data->truncate(dataLen + 4);
             mRequestHandler.processTurnData(mTurnAllocationManager,
                                             channelNumber,
                                             StunTuple(StunTuple::UDP, mLocalAddress, mLocalPort),
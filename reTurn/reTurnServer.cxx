@@ -129,6 +129,7 @@ reTurn::ReTurnServerProcess::main(int argc, char* argv[])
          reTurnConfig.mAltStunPort != 0 ? &reTurnConfig.mAltStunPort : 0); 
 
       udpTurnServer.reset(new reTurn::UdpServer(ioService, requestHandler, reTurnConfig.mTurnAddress, reTurnConfig.mTurnPort));
+      udpTurnServer->setBatchSize(reTurnConfig.mUdpBatchSize);
       tcpTurnServer.reset(new reTurn::TcpServer(ioService, requestHandler, reTurnConfig.mTurnAddress, reTurnConfig.mTurnPort));
 #ifdef USE_SSL
       if(reTurnConfig.mTlsTurnPort != 0)
@@ -139,6 +140,7 @@ reTurn::ReTurnServerProcess::main(int argc, char* argv[])
 
 #ifdef USE_IPV6
       udpV6TurnServer.reset(new reTurn::UdpServer(ioService, requestHandler, reTurnConfig.mTurnV6Address, reTurnConfig.mTurnPort));
+      udpV6TurnServer->setBatchSize(reTurnConfig.mUdpBatchSize);
       tcpV6TurnServer.reset(new reTurn::TcpServer(ioService, requestHandler, reTurnConfig.mTurnV6Address, reTurnConfig.mTurnPort));
       if(reTurnConfig.mTlsTurnPort != 0)
       {
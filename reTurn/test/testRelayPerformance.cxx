@@ -0,0 +1,145 @@
+// Measures the per-packet cost of the server side Send indication relay path:
+// receive buffer allocation, STUN parse and hand-off of the TurnData payload
+// to the relay socket.  Compares the original heap allocated/copying path
+// with the pooled, zero-copy path.
+
+#include <iostream>
+#include <asio.hpp>
+
+#include "../AsyncSocketBase.hxx"
+#include "../DataBuffer.hxx"
+#include "../StunTuple.hxx"
+#include "../StunMessage.hxx"
+#include <rutil/Logger.hxx>
+#include <rutil/Timer.hxx>
+
+using namespace reTurn;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM resip::Subsystem::TEST
+
+static const unsigned int NumPackets = 1000000;
+static const unsigned int PayloadSize = 172;  // 20ms of G.711 plus RTP header
+
+static unsigned int
+legacyRelay(const StunTuple& local, const StunTuple& remote, const char* packet, unsigned int packetSize)
+{
+   unsigned int relayed = 0;
+   for(unsigned int i = 0; i < NumPackets; i++)
+   {
+      boost::shared_ptr<DataBuffer> receiveBuffer(new DataBuffer(RECEIVE_BUFFER_SIZE));
+      memcpy(receiveBuffer->mutableData(), packet, packetSize);
+      receiveBuffer->truncate(packetSize);
+
+      StunMessage request(local, remote, receiveBuffer->mutableData(), receiveBuffer->size());
+      boost::shared_ptr<DataBuffer> data(new DataBuffer(request.mTurnData->data(), request.mTurnData->size()));
+      relayed += data->size();
+   }
+   return relayed;
+}
+
+static unsigned int
+pooledRelay(const StunTuple& local, const StunTuple& remote, const char* packet, unsigned int packetSize)
+{
+   unsigned int relayed = 0;
+   for(unsigned int i = 0; i < NumPackets; i++)
+   {
+      boost::shared_ptr<DataBuffer> receiveBuffer = AsyncSocketBase::allocateBuffer(RECEIVE_BUFFER_SIZE);
+      memcpy(receiveBuffer->mutableData(), packet, packetSize);
+      receiveBuffer->truncate(packetSize);
+
+      StunMessage request(local, remote, receiveBuffer);
+      boost::shared_ptr<DataBuffer> data = request.mReceiveBuffer;
+      unsigned int dataOffset = (unsigned int)(request.mTurnData->data() - data->data());
+      data->truncate(dataOffset + (unsigned int)request.mTurnData->size());
+      relayed += data->size() - dataOffset;
+   }
+   return relayed;
+}
+
+int main(int argc, char* argv[])
+{
+   resip::Log::initialize(resip::Log::Cout, resip::Log::Warning, "");
+
+   StunTuple local(StunTuple::UDP, asio::ip::address::from_string("10.0.0.1"), 3478);
+   StunTuple remote(StunTuple::UDP, asio::ip::address::from_string("10.0.0.2"), 5000);
+   StunTuple peer(StunTuple::UDP, asio::ip::address::from_string("10.0.0.3"), 6000);
+
+   // Build a Send indication to relay
+   char payload[PayloadSize];
+   memset(payload, 0x55, PayloadSize);
+   StunMessage sendInd;
+   sendInd.createHeader(StunMessage::StunClassIndication, StunMessage::TurnSendMethod);
+   sendInd.mCntTurnXorPeerAddress = 1;
+   StunMessage::setStunAtrAddressFromTuple(sendInd.mTurnXorPeerAddress[0], peer);
+   sendInd.setTurnData(payload, PayloadSize);
+   char packet[RECEIVE_BUFFER_SIZE];
+   unsigned int packetSize = sendInd.stunEncodeMessage(packet, RECEIVE_BUFFER_SIZE);
+
+   // Sanity check the zero-copy path relays exactly the payload
+   {
+      boost::shared_ptr<DataBuffer> receiveBuffer = AsyncSocketBase::allocateBuffer(RECEIVE_BUFFER_SIZE);
+      memcpy(receiveBuffer->mutableData(), packet, packetSize);
+      receiveBuffer->truncate(packetSize);
+      StunMessage request(local, remote, receiveBuffer);
+      assert(request.isValid());
+      assert(request.mHasTurnData);
+      assert(request.mTurnData->size() == PayloadSize);
+      assert(memcmp(request.mTurnData->data(), payload, PayloadSize) == 0);
+      assert(request.mTurnData->data() >= receiveBuffer->data() &&
+             request.mTurnData->data() + PayloadSize <= receiveBuffer->data() + receiveBuffer->size());
+   }
+
+   UInt64 start = resip::Timer::getTimeMs();
+   unsigned int legacyBytes = legacyRelay(local, remote, packet, packetSize);
+   UInt64 legacyMs = resip::Timer::getTimeMs() - start;
+
+   start = resip::Timer::getTimeMs();
+   unsigned int pooledBytes = pooledRelay(local, remote, packet, packetSize);
+   UInt64 pooledMs = resip::Timer::getTimeMs() - start;
+
+   assert(legacyBytes == pooledBytes);
+
+   DataBufferPool::Stats stats = DataBufferPool::getThreadStats();
+   cout << "Relayed " << NumPackets << " Send indications of " << PayloadSize << " bytes" << endl;
+   cout << "  heap/copy:       " << legacyMs << " ms (" << (legacyMs ? NumPackets * 1000 / legacyMs : 0) << " packets/sec)" << endl;
+   cout << "  pooled/no copy:  " << pooledMs << " ms (" << (pooledMs ? NumPackets * 1000 / pooledMs : 0) << " packets/sec)" << endl;
+   cout << "  pool hits=" << stats.mPoolHits << " misses=" << stats.mPoolMisses << " heap=" << stats.mHeapAllocations << endl;
+
+   return 0;
+}
+
+
+/* ====================================================================
+
+ Copyright (c) 2007-2008, Plantronics, Inc.
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+ 3. Neither the name of Plantronics nor the names of its contributors
+    may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==================================================================== */
@@ -0,0 +1,216 @@
+// Checks that MESSAGE-INTEGRITY computed with a prepared StunHmacKey (as the
+// server does for every user in the user database, and for every request on
+// an allocation) is the same as with the plain HMAC key.
+
+#include <iostream>
+#include <string.h>
+#include <asio.hpp>
+
+#ifdef USE_SSL
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#endif
+
+#include "../StunTuple.hxx"
+#include "../StunMessage.hxx"
+#include <rutil/Logger.hxx>
+#include <rutil/MD5Stream.hxx>
+
+using namespace reTurn;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM resip::Subsystem::TEST
+
+static const unsigned int BufferSize = 1024;
+
+#ifdef USE_SSL
+// Keys shorter than, equal to and longer than the SHA-1 block size, which
+// are padded, used as is and hashed first respectively
+static void
+testKeySchedule()
+{
+   const unsigned int keySizes[] = { 0, 1, 16, 63, 64, 65, 100 };
+   const unsigned int inputSizes[] = { 0, 1, 20, 55, 56, 64, 100, 548 };
+   char input[548];
+   for(unsigned int i = 0; i < sizeof(input); i++)
+   {
+      input[i] = (char)(i * 7 + 3);
+   }
+
+   for(unsigned int k = 0; k < sizeof(keySizes) / sizeof(keySizes[0]); k++)
+   {
+      resip::Data key;
+      for(unsigned int i = 0; i < keySizes[k]; i++)
+      {
+         key += (char)(0xff - i);
+      }
+      // One prepared key is used for many messages
+      StunHmacKey prepared(key);
+      for(unsigned int n = 0; n < sizeof(inputSizes) / sizeof(inputSizes[0]); n++)
+      {
+         unsigned char expected[20];
+         unsigned int expectedSize = sizeof(expected);
+         HMAC(EVP_sha1(), key.data(), (int)key.size(),
+              reinterpret_cast<const unsigned char*>(input), inputSizes[n],
+              expected, &expectedSize);
+         assert(expectedSize == 20);
+
+         char hmac[20];
+         prepared.computeHmac(hmac, input, inputSizes[n]);
+         assert(memcmp(hmac, expected, 20) == 0);
+      }
+   }
+}
+#endif
+
+static void
+buildRequest(StunMessage& request)
+{
+   request.createHeader(StunMessage::StunClassRequest, StunMessage::TurnAllocateMethod);
+   request.setUsername("alice");
+   request.setRealm("example.org");
+   request.setNonce("f//499k954d6OL34oL9FSTvy64sA");
+   request.mHasTurnRequestedTransport = true;
+   request.mTurnRequestedTransport = StunMessage::RequestedTransportUdp;
+   request.setSoftware("testStunHmacKey");
+   request.mHasMessageIntegrity = true;
+   request.mHasFingerprint = true;
+}
+
+// A long term credential request encoded with the HMAC key, and with the same
+// key prepared, must be identical - and each must check with both
+static void
+testEncodeAndCheck()
+{
+   StunTuple local(StunTuple::UDP, asio::ip::address::from_string("10.0.0.1"), 3478);
+   StunTuple remote(StunTuple::UDP, asio::ip::address::from_string("10.0.0.2"), 5001);
+
+   // Previous path - the key schedule is run when the message is encoded
+   StunMessage plain;
+   buildRequest(plain);
+   resip::Data hmacKey;
+   plain.calculateHmacKey(hmacKey, "secret");
+   plain.mHmacKey = hmacKey;
+   char plainBuf[BufferSize];
+   unsigned int plainSize = plain.stunEncodeMessage(plainBuf, BufferSize);
+
+   // Path used by the server - as RequestHandler sets up a response
+   StunMessage prepared;
+   buildRequest(prepared);
+   prepared.mHeader.magicCookieAndTid = plain.mHeader.magicCookieAndTid;
+   prepared.mHmacKey = hmacKey;
+   prepared.mPreparedHmacKey = StunHmacKeyPtr(new StunHmacKey(hmacKey));
+   char preparedBuf[BufferSize];
+   unsigned int preparedSize = prepared.stunEncodeMessage(preparedBuf, BufferSize);
+
+   assert(plainSize == preparedSize);
+   assert(memcmp(plainBuf, preparedBuf, plainSize) == 0);
+
+   StunMessage received(local, remote, preparedBuf, preparedSize);
+   assert(received.isValid());
+   assert(received.mHasMessageIntegrity);
+   assert(received.checkFingerprint());
+
+   resip::Data receivedKey;
+   received.calculateHmacKey(receivedKey, "secret");
+   assert(receivedKey == hmacKey);
+   assert(received.checkMessageIntegrity(receivedKey));
+   assert(received.checkMessageIntegrity(StunHmacKey(receivedKey)));
+   // A key prepared once checks any number of requests
+   StunHmacKey reused(receivedKey);
+   assert(received.checkMessageIntegrity(reused));
+   assert(received.checkMessageIntegrity(reused));
+
+   resip::Data wrongKey;
+   received.calculateHmacKey(wrongKey, "Secret");
+   assert(!received.checkMessageIntegrity(wrongKey));
+   assert(!received.checkMessageIntegrity(StunHmacKey(wrongKey)));
+
+   // The HA1 the user database is loaded with is the same key
+   resip::MD5Stream r;
+   r << "alice:example.org:secret";
+   assert(r.getBin() == hmacKey);
+   assert(received.checkMessageIntegrity(StunHmacKey(r.getBin())));
+}
+
+// RFC5769 2.4 - Sample Request with Long-Term Authentication
+static void
+testVector()
+{
+   StunTuple local(StunTuple::UDP, asio::ip::address::from_string("10.0.0.1"), 5000);
+   StunTuple remote(StunTuple::UDP, asio::ip::address::from_string("10.0.0.2"), 5001);
+
+   const unsigned char reqltc[] =
+     "\x00\x01\x00\x60"
+     "\x21\x12\xa4\x42"
+     "\x78\xad\x34\x33\xc6\xad\x72\xc0\x29\xda\x41\x2e"
+     "\x00\x06\x00\x12"
+       "\xe3\x83\x9e\xe3\x83\x88\xe3\x83\xaa\xe3\x83\x83"
+       "\xe3\x82\xaf\xe3\x82\xb9\x00\x00"
+     "\x00\x15\x00\x1c"
+       "\x66\x2f\x2f\x34\x39\x39\x6b\x39\x35\x34\x64\x36"
+       "\x4f\x4c\x33\x34\x6f\x4c\x39\x46\x53\x54\x76\x79"
+       "\x36\x34\x73\x41"
+     "\x00\x14\x00\x0b"
+       "\x65\x78\x61\x6d\x70\x6c\x65\x2e\x6f\x72\x67\x00"
+     "\x00\x08\x00\x14"
+       "\xf6\x70\x24\x65\x6d\xd6\x4a\x3e\x02\xb8\xe0\x71"
+       "\x2e\x85\xc9\xa2\x8c\xa8\x96\x66";
+
+   StunMessage reqltcMessage(local, remote, (char*)reqltc, sizeof(reqltc)-1);
+   assert(reqltcMessage.isValid());
+   assert(reqltcMessage.mHasMessageIntegrity);
+
+   resip::Data hmacKey;
+   reqltcMessage.calculateHmacKey(hmacKey, "TheMatrIX");
+   assert(reqltcMessage.checkMessageIntegrity(StunHmacKey(hmacKey)));
+   assert(!reqltcMessage.checkMessageIntegrity(StunHmacKey("TheMatrIX")));
+}
+
+int main(int argc, char* argv[])
+{
+   resip::Log::initialize(resip::Log::Cout, resip::Log::Info, "");
+
+#ifdef USE_SSL
+   testKeySchedule();
+#endif
+   testEncodeAndCheck();
+   testVector();
+
+   InfoLog(<< "All tests passed!");
+   return 0;
+}
+
+/* ====================================================================
+
+ Copyright (c) 2007-2008, SIP Spectrum, Inc.
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are 
+ met:
+
+ 1. Redistributions of source code must retain the above copyright 
+    notice, this list of conditions and the following disclaimer. 
+
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution. 
+
+ 3. Neither the name of SIP Spectrum nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission. 
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==================================================================== */
@@ -0,0 +1,143 @@
+// Checks that every padded attribute is encoded with zero padding.  Packet
+// buffers come from DataBufferPool and are not zeroed, so any pad byte the
+// encoder skipped would leak whatever an earlier packet left in the slab.
+
+#include <iostream>
+#include <string.h>
+#include <asio.hpp>
+
+#include "../StunTuple.hxx"
+#include "../StunMessage.hxx"
+#include <rutil/Logger.hxx>
+
+using namespace reTurn;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM resip::Subsystem::TEST
+
+static const unsigned int BufferSize = 1024;
+
+static unsigned int
+readUInt16(const char* data)
+{
+   return ((unsigned int)(unsigned char)data[0] << 8) | (unsigned int)(unsigned char)data[1];
+}
+
+// Walks the attributes of an encoded message, asserting that the bytes
+// between the end of each value and the next 4 byte boundary are zero.
+// Returns the number of attributes that needed padding.
+static unsigned int
+checkPadding(const char* buf, unsigned int size)
+{
+   unsigned int padded = 0;
+   unsigned int pos = 20;  // STUN header
+   while(pos < size)
+   {
+      assert(pos + 4 <= size);
+      unsigned int attrLen = readUInt16(buf + pos + 2);
+      unsigned int attrEnd = pos + 4 + attrLen;
+      unsigned int next = (attrEnd + 3) & ~3U;
+      assert(next <= size);
+      for(unsigned int i = attrEnd; i < next; i++)
+      {
+         assert(buf[i] == 0);
+      }
+      if(next != attrEnd)
+      {
+         padded++;
+      }
+      pos = next;
+   }
+   assert(pos == size);
+   return padded;
+}
+
+static unsigned int
+encodeOverStaleData(StunMessage& msg, char* buf)
+{
+   memset(buf, 0xFF, BufferSize);
+   unsigned int size = msg.stunEncodeMessage(buf, BufferSize);
+   assert(size > 20 && size < BufferSize);
+   assert(size % 4 == 0);
+   return size;
+}
+
+int main(int argc, char* argv[])
+{
+   resip::Log::initialize(resip::Log::Cout, resip::Log::Info, "");
+   char buf[BufferSize];
+
+   // 420 (Unknown Attribute) response listing an odd number of attributes
+   {
+      StunMessage response;
+      response.createHeader(StunMessage::StunClassErrorResponse, StunMessage::BindMethod);
+      response.setErrorCode(420, "Unknown Attribute");
+      response.mHasUnknownAttributes = true;
+      response.mUnknownAttributes.numAttributes = 3;
+      response.mUnknownAttributes.attrType[0] = 0x0031;
+      response.mUnknownAttributes.attrType[1] = 0x0032;
+      response.mUnknownAttributes.attrType[2] = 0x0033;
+      unsigned int size = encodeOverStaleData(response, buf);
+      // ERROR-CODE (reason is 17 bytes) and UNKNOWN-ATTRIBUTES are both padded
+      assert(checkPadding(buf, size) == 2);
+
+      StunTuple local(StunTuple::UDP, asio::ip::address::from_string("10.0.0.1"), 3478);
+      StunTuple remote(StunTuple::UDP, asio::ip::address::from_string("10.0.0.2"), 5000);
+      StunMessage decoded(local, remote, buf, size);
+      assert(decoded.isValid());
+      assert(decoded.mHasUnknownAttributes);
+      assert(decoded.mUnknownAttributes.numAttributes == 3);
+      assert(decoded.mUnknownAttributes.attrType[2] == 0x0033);
+   }
+
+   // String and data attributes with lengths that are not a multiple of 4
+   {
+      StunMessage indication;
+      indication.createHeader(StunMessage::StunClassIndication, StunMessage::TurnSendMethod);
+      indication.setUsername("alice");
+      indication.setRealm("example.org");
+      indication.setNonce("abcdef");
+      indication.setSoftware("pad");
+      indication.setTurnData("12345", 5);
+      unsigned int size = encodeOverStaleData(indication, buf);
+      assert(checkPadding(buf, size) == 5);
+   }
+
+   InfoLog(<< "All tests passed!");
+   return 0;
+}
+
+
+/* ====================================================================
+
+ Copyright (c) 2007-2008, SIP Spectrum, Inc.
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are 
+ met:
+
+ 1. Redistributions of source code must retain the above copyright 
+    notice, this list of conditions and the following disclaimer. 
+
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution. 
+
+ 3. Neither the name of SIP Spectrum nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission. 
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==================================================================== */
@@ -0,0 +1,245 @@
+// Loopback benchmark for batched UDP relaying (AsyncUdpSocketBase::setBatchSize).
+// A sender emulates 1000 concurrent 50 packets/second RTP streams towards a
+// relay socket that forwards every datagram to a sink, exactly as a TURN relay
+// does.  The CPU time consumed by the relay thread is measured so results are
+// reported as relayed packets/second per core, with and without batching.
+
+#include <iostream>
+#include <asio.hpp>
+
+#include "../AsyncUdpSocketBase.hxx"
+#include "../StunTuple.hxx"
+#include <rutil/Logger.hxx>
+#include <rutil/ThreadIf.hxx>
+#include <rutil/Timer.hxx>
+
+#ifdef RETURN_HAVE_MMSG
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+
+using namespace reTurn;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM resip::Subsystem::TEST
+
+#ifdef RETURN_HAVE_MMSG
+
+static const unsigned int NumStreams = 1000;
+static const unsigned int PacketsPerSecond = 50;
+static const unsigned int TestSeconds = 5;
+static const unsigned int PacketSize = 172;  // 20ms of G.711 plus RTP header
+
+static const unsigned short RelayPort = 32100;
+static const unsigned short SinkPort = 32102;
+
+class ForwardingSocket : public AsyncUdpSocketBase
+{
+public:
+   ForwardingSocket(asio::io_service& ioService, const StunTuple& sink) :
+      AsyncUdpSocketBase(ioService), mSink(sink), mForwarded(0) {}
+
+   unsigned long getForwarded() const { return mForwarded; }
+
+private:
+   virtual void onReceiveSuccess(const asio::ip::address& address, unsigned short port, boost::shared_ptr<DataBuffer>& data)
+   {
+      boost::shared_ptr<DataBuffer> packet = data;
+      doSend(mSink, packet);
+      mForwarded++;
+      doReceive();
+   }
+   virtual void onReceiveFailure(const asio::error_code& e)
+   {
+      if(e != asio::error::operation_aborted)
+      {
+         doReceive();
+      }
+   }
+   virtual void onSendSuccess() {}
+   virtual void onSendFailure(const asio::error_code& e) {}
+
+   StunTuple mSink;
+   unsigned long mForwarded;
+};
+
+class RelayThread : public resip::ThreadIf
+{
+public:
+   RelayThread(asio::io_service& ioService) : mIOService(ioService), mCpuSeconds(0) {}
+   virtual void thread()
+   {
+      struct timespec start, end;
+      clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+      mIOService.run();
+      clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+      mCpuSeconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+   }
+   double getCpuSeconds() const { return mCpuSeconds; }
+private:
+   asio::io_service& mIOService;
+   double mCpuSeconds;
+};
+
+class SinkThread : public resip::ThreadIf
+{
+public:
+   SinkThread(int fd) : mFd(fd), mReceived(0) {}
+   virtual void thread()
+   {
+      char buffer[RECEIVE_BUFFER_SIZE];
+      while(!isShutdown())
+      {
+         if(recv(mFd, buffer, sizeof(buffer), 0) > 0)
+         {
+            mReceived++;
+         }
+      }
+   }
+   unsigned long getReceived() const { return mReceived; }
+private:
+   int mFd;
+   volatile unsigned long mReceived;
+};
+
+static int
+openLoopbackSocket(unsigned short port)
+{
+   int fd = socket(AF_INET, SOCK_DGRAM, 0);
+   struct sockaddr_in addr;
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   addr.sin_port = htons(port);
+   bind(fd, (struct sockaddr*)&addr, sizeof(addr));
+   struct timeval timeout = { 0, 100000 };
+   setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+   int bufferSize = 4 * 1024 * 1024;
+   setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+   return fd;
+}
+
+static void
+runTest(unsigned int batchSize)
+{
+   asio::io_service ioService;
+   StunTuple sink(StunTuple::UDP, asio::ip::address::from_string("127.0.0.1"), SinkPort);
+   boost::shared_ptr<ForwardingSocket> relay(new ForwardingSocket(ioService, sink));
+   asio::error_code ec = relay->bind(asio::ip::address::from_string("127.0.0.1"), RelayPort);
+   assert(!ec);
+   relay->setBatchSize(batchSize);
+   relay->receive();
+
+   int sinkFd = openLoopbackSocket(SinkPort);
+   SinkThread sinkThread(sinkFd);
+   sinkThread.run();
+   RelayThread relayThread(ioService);
+   relayThread.run();
+
+   // Each millisecond send the packets due from all streams in that slot
+   int senderFd = openLoopbackSocket(0);
+   struct sockaddr_in relayAddr;
+   memset(&relayAddr, 0, sizeof(relayAddr));
+   relayAddr.sin_family = AF_INET;
+   relayAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   relayAddr.sin_port = htons(RelayPort);
+   char packet[PacketSize];
+   memset(packet, 0x80, PacketSize);
+
+   unsigned long sent = 0;
+   const unsigned long packetsPerMs = NumStreams * PacketsPerSecond / 1000;
+   UInt64 start = resip::Timer::getTimeMs();
+   for(UInt64 ms = 0; ms < TestSeconds * 1000; ms++)
+   {
+      for(unsigned long i = 0; i < packetsPerMs; i++)
+      {
+         unsigned short stream = (unsigned short)((sent + i) % NumStreams);
+         memcpy(packet + 8, &stream, sizeof(stream));  // RTP SSRC
+         sendto(senderFd, packet, PacketSize, 0, (struct sockaddr*)&relayAddr, sizeof(relayAddr));
+      }
+      sent += packetsPerMs;
+      while(resip::Timer::getTimeMs() < start + ms + 1)
+      {
+         usleep(100);
+      }
+   }
+
+   // Let the relay drain, then stop everything
+   usleep(500000);
+   relay->close();
+   ioService.stop();
+   relayThread.join();
+   sinkThread.shutdown();
+   sinkThread.join();
+   close(senderFd);
+   close(sinkFd);
+
+   double cpuSeconds = relayThread.getCpuSeconds();
+   const AsyncUdpSocketBase::BatchStats& stats = relay->getBatchStats();
+   cout << "batch size " << batchSize << ": sent=" << sent << " relayed=" << relay->getForwarded()
+        << " received=" << sinkThread.getReceived() << " relay cpu=" << cpuSeconds << "s"
+        << " => " << (unsigned long)(cpuSeconds > 0 ? relay->getForwarded() / cpuSeconds : 0) << " packets/second per core";
+   if(batchSize > 1)
+   {
+      cout << " (" << (stats.mReceiveBatches ? (double)stats.mReceivedDatagrams / stats.mReceiveBatches : 0) << " datagrams/recvmmsg, "
+           << (stats.mSendBatches ? (double)stats.mSentDatagrams / stats.mSendBatches : 0) << " datagrams/sendmmsg)";
+   }
+   cout << endl;
+}
+
+int main(int argc, char* argv[])
+{
+   resip::Log::initialize(resip::Log::Cout, resip::Log::Warning, "");
+
+   cout << "Relaying " << NumStreams << " streams at " << PacketsPerSecond << " packets/second for " << TestSeconds << " seconds" << endl;
+   runTest(0);
+   runTest(32);
+   return 0;
+}
+
+#else
+
+int main(int argc, char* argv[])
+{
+   cout << "Batched UDP I/O is not supported on this platform" << endl;
+   return 0;
+}
+
+#endif
+
+
+/* ====================================================================
+
+ Copyright (c) 2007-2008, Plantronics, Inc.
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+ 3. Neither the name of Plantronics nor the names of its contributors
+    may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==================================================================== */
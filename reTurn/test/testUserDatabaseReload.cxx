@@ -0,0 +1,161 @@
+// Checks that the prepared HMAC keys held by ReTurnConfig, and the keys kept
+// with an allocation, follow the user database when the file is reloaded.
+
+#include <iostream>
+#include <fstream>
+#include <signal.h>
+#include <unistd.h>
+#include <asio.hpp>
+
+#include "../ReTurnConfig.hxx"
+#include "../StunAuth.hxx"
+#include "../StunMessage.hxx"
+#include <rutil/Logger.hxx>
+
+using namespace reTurn;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM resip::Subsystem::TEST
+
+static const char* UsersFile = "testUserDatabaseReload.users";
+
+static void
+writeUsers(const char* contents)
+{
+   ofstream file(UsersFile, ios::out | ios::trunc);
+   file << contents;
+   file.close();
+   assert(file.good());
+}
+
+static resip::Data
+expectedKey(const resip::Data& username, const resip::Data& realm, const resip::Data& password)
+{
+   StunMessage message;
+   message.setUsername(username.c_str());
+   message.setRealm(realm.c_str());
+   resip::Data hmacKey;
+   message.calculateHmacKey(hmacKey, password);
+   return hmacKey;
+}
+
+// The same test RequestHandler applies before reusing the key an allocation
+// was created with instead of looking the user up again
+static bool
+allocationKeyUsable(const StunAuth& auth, const ReTurnConfig& config)
+{
+   return auth.getClientHmacKey() &&
+          auth.getUserDatabaseGeneration() == config.getUserDatabaseGeneration();
+}
+
+int main(int argc, char* argv[])
+{
+   resip::Log::initialize(resip::Log::Cout, resip::Log::Info, "");
+
+   const resip::Data realm("example.org");
+
+   writeUsers("alice:secret:example.org:authorized\n"
+              "bob:builder:example.org:authorized\n"
+              "dave:refused:example.org:refused\n");
+
+   ReTurnConfig config;
+   config.mAuthenticationRealm = realm;
+   config.mUsersDatabaseFilename = UsersFile;
+   config.mUserDatabaseCheckInterval = 0;  // reload only on HUP
+   config.authParse(config.mUsersDatabaseFilename);
+
+   unsigned long generation = config.getUserDatabaseGeneration();
+
+   StunHmacKeyPtr aliceKey = config.getHmacKeyForUsername("alice", realm);
+   assert(aliceKey);
+   assert(aliceKey->getKey() == expectedKey("alice", realm, "secret"));
+   assert(config.getHa1ForUsername("alice", realm) == aliceKey->getKey());
+   assert(config.getHmacKeyForUsername("bob", realm));
+   assert(config.getHmacKeyForUsername("bob", realm)->getKey() == expectedKey("bob", realm, "builder"));
+   assert(!config.getHmacKeyForUsername("alice", "example.net"));
+   assert(!config.getHmacKeyForUsername("carol", realm));
+   assert(!config.getHmacKeyForUsername("dave", realm));
+   // Lookups hand out the cached key, they don't prepare a new one
+   assert(config.getHmacKeyForUsername("alice", realm) == aliceKey);
+
+   StunAuth aliceAuth("alice", realm, aliceKey, generation);
+   assert(allocationKeyUsable(aliceAuth, config));
+
+   // Change alice's password, remove bob and add carol, then reload the same
+   // way the server does on SIGHUP
+   writeUsers("alice:changed:example.org:authorized\n"
+              "carol:singer:example.org:authorized\n");
+
+   asio::io_service ioService;
+   ReTurnUserFileScanner scanner(ioService, config);
+   scanner.start();
+   raise(SIGHUP);
+   assert(ioService.run_one() == 1);
+
+   assert(config.getUserDatabaseGeneration() > generation);
+
+   StunHmacKeyPtr reloadedAliceKey = config.getHmacKeyForUsername("alice", realm);
+   assert(reloadedAliceKey);
+   assert(reloadedAliceKey != aliceKey);
+   assert(reloadedAliceKey->getKey() == expectedKey("alice", realm, "changed"));
+   assert(reloadedAliceKey->getKey() != expectedKey("alice", realm, "secret"));
+   assert(config.getHa1ForUsername("alice", realm) == reloadedAliceKey->getKey());
+   assert(!config.getHmacKeyForUsername("bob", realm));
+   assert(config.getHa1ForUsername("bob", realm).empty());
+   assert(!config.isUserNameValid("bob", realm));
+   assert(config.getHmacKeyForUsername("carol", realm));
+   assert(config.getHmacKeyForUsername("carol", realm)->getKey() == expectedKey("carol", realm, "singer"));
+
+   // The allocation still holds the old key, but must no longer use it
+   assert(aliceAuth.getClientHmacKey() == aliceKey);
+   assert(aliceKey->getKey() == expectedKey("alice", realm, "secret"));
+   assert(!allocationKeyUsable(aliceAuth, config));
+
+   // A reload of an unchanged file still starts a new generation
+   generation = config.getUserDatabaseGeneration();
+   StunAuth reloadedAuth("alice", realm, reloadedAliceKey, generation);
+   assert(allocationKeyUsable(reloadedAuth, config));
+   config.authParse(config.mUsersDatabaseFilename);
+   assert(config.getUserDatabaseGeneration() == generation + 1);
+   assert(!allocationKeyUsable(reloadedAuth, config));
+   assert(config.getHmacKeyForUsername("alice", realm)->getKey() == reloadedAliceKey->getKey());
+
+   unlink(UsersFile);
+
+   InfoLog(<< "All tests passed!");
+   return 0;
+}
+
+/* ====================================================================
+
+ Copyright (c) 2007-2008, SIP Spectrum, Inc.
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are 
+ met:
+
+ 1. Redistributions of source code must retain the above copyright 
+    notice, this list of conditions and the following disclaimer. 
+
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution. 
+
+ 3. Neither the name of SIP Spectrum nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission. 
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==================================================================== */
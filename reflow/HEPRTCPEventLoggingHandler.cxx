@@ -140,9 +140,9 @@ HEPRTCPEventLoggingHandler::sendToHOMER(resip::SharedPtr<FlowContext> context, c
       correlationId = context->getSipCallId();
    }
 
-   mHepAgent->sendToHOMER<Data>(resip::UDP,
+   mHepAgent->sendToHOMER(resip::UDP,
       _source, _destination,
-      HepAgent::RTCP_JSON, json,
+      HepAgent::RTCP_JSON, json.data(), json.size(),
       correlationId);
 }
 
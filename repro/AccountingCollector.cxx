@@ -4,12 +4,8 @@
 
 #include <iostream>
 
-// JSON library includes
-#include "cajun/json/reader.h"
-#include "cajun/json/writer.h"
-#include "cajun/json/elements.h"
-
 #include "repro/AccountingCollector.hxx"
+#include "repro/JsonEventEncoder.hxx"
 #include "repro/RequestContext.hxx"
 #include "repro/ProxyConfig.hxx"
 #include "repro/PersistentMessageQueue.hxx"
@@ -17,6 +13,8 @@
 #include "resip/stack/Helper.hxx"
 #include "resip/stack/SipMessage.hxx"
 #include "rutil/Logger.hxx"
+#include "rutil/Lock.hxx"
+#include "rutil/Timer.hxx"
 
 #include "rutil/WinLeakCheck.hxx"
 
@@ -24,7 +22,6 @@
 
 using namespace resip;
 using namespace repro;
-using namespace json;
 using namespace std;
 
 const static Data sessionEventQueueName = "sessioneventqueue";
@@ -39,8 +36,15 @@ AccountingCollector::AccountingCollector(ProxyConfig& config) :
    mRegistrationAccountingAddRoutingHeaders(config.getConfigBool("RegistrationAccountingAddRoutingHeaders", false)),
    mRegistrationAccountingAddViaHeaders(config.getConfigBool("RegistrationAccountingAddViaHeaders", false)),
    mRegistrationAccountingLogRefreshes(config.getConfigBool("RegistrationAccountingLogRefreshes", false)),
-   mFifo(0, 0)  // not limited by time or size
+   mBatchSize(config.getConfigUnsignedLong("AccountingBatchSize", 100)),
+   mBatchLatencyMs(config.getConfigUnsignedLong("AccountingBatchLatencyMs", 50)),
+   mFifo(0, config.getConfigUnsignedLong("AccountingMaxQueueSize", 100000))  // not limited by time
 {
+   if(mBatchSize == 0)
+   {
+      mBatchSize = 1;
+   }
+
    if(config.getConfigBool("SessionAccountingEnabled", false))
    {
       if(!initializeEventQueue(SessionEventType))
@@ -87,127 +91,84 @@ AccountingCollector::doRegistrationAccounting(AccountingCollector::RegistrationE
       ErrLog(<< "AccountingCollector::doRegistrationAccounting: missing proper callId header: " << msg);
       return;
    }
-   Object regEvent;
-   regEvent["EventId"] = Number(regevent);
+   FifoEvent* eventData = new FifoEvent(RegistrationEventType);
+   JsonEventEncoder regEvent(eventData->mData);
+   regEvent.add("EventId", regevent);
    switch(regevent)
    {
    case RegistrationAdded:
-      regEvent["EventName"] = String("Registration Added");
+      regEvent.add("EventName", "Registration Added");
       break;
    case RegistrationRefreshed:
-      regEvent["EventName"] = String("Registration Refreshed");
+      regEvent.add("EventName", "Registration Refreshed");
       break;
    case RegistrationRemoved:
-      regEvent["EventName"] = String("Registration Removed");
+      regEvent.add("EventName", "Registration Removed");
       break;
    case RegistrationRemovedAll:
-      regEvent["EventName"] = String("Registration Removed All");
+      regEvent.add("EventName", "Registration Removed All");
       break;
    }
-   regEvent["Datetime"] = String(Data::from(datetime).c_str());
-   regEvent["CallId"] = String(msg.header(h_CallId).value().c_str());
+   regEvent.addEncoded("Datetime", datetime);
+   regEvent.add("CallId", msg.header(h_CallId).value());
    if(msg.exists(h_To) && msg.header(h_To).isWellFormed())
    {
+      regEvent.startObject("User");
       if(!msg.header(h_To).displayName().empty())
       {
-         regEvent["User"]["DisplayName"] = String(msg.header(h_To).displayName().c_str());
+         regEvent.add("DisplayName", msg.header(h_To).displayName());
       }
-      regEvent["User"]["Aor"] = String(Data::from(msg.header(h_To).uri().getAorAsUri(msg.getSource().getType())).c_str());
+      regEvent.addEncoded("Aor", msg.header(h_To).uri().getAorAsUri(msg.getSource().getType()));
+      regEvent.endObject();
    }
    if(msg.exists(h_From) && msg.header(h_From).isWellFormed())
    {
       if(msg.header(h_From).uri() != msg.header(h_To).uri()) // Only log from is different from To
       {
+         regEvent.startObject("From");
          if(!msg.header(h_From).displayName().empty())
          {
-            regEvent["From"]["DisplayName"] = String(msg.header(h_From).displayName().c_str());
+            regEvent.add("DisplayName", msg.header(h_From).displayName());
          }
-         regEvent["From"]["Uri"] = String(Data::from(msg.header(h_From).uri()).c_str());
+         regEvent.addEncoded("Uri", msg.header(h_From).uri());
+         regEvent.endObject();
       }
    }
-   if(msg.exists(h_Contacts) && !msg.header(h_Contacts).empty())
+   if(msg.exists(h_Contacts))
    {
-      Array arrayContacts;
-      NameAddrs::const_iterator contactIt = msg.header(h_Contacts).begin();
-      for(; contactIt != msg.header(h_Contacts).end(); contactIt++)
-      {
-         if(contactIt->isWellFormed())
-         {
-            arrayContacts.Insert(String(Data::from(*contactIt).c_str()));
-         }
-      }
-      if(!arrayContacts.Empty())
-      {
-         regEvent["Contacts"] = arrayContacts;
-      }
+      regEvent.addEncodedArray("Contacts", msg.header(h_Contacts));
    }
    if(msg.exists(h_Expires) && msg.header(h_Expires).isWellFormed())
    {
-      regEvent["Expires"] = Number(msg.header(h_Expires).value());
+      regEvent.add("Expires", msg.header(h_Expires).value());
    }
-   if(mRegistrationAccountingAddViaHeaders &&
-      msg.exists(h_Vias) && !msg.header(h_Vias).empty())
+   if(mRegistrationAccountingAddViaHeaders && msg.exists(h_Vias))
    {
-      Array arrayVias;
-      Vias::const_iterator viaIt = msg.header(h_Vias).begin();
-      for(; viaIt != msg.header(h_Vias).end(); viaIt++)
-      {
-         if(viaIt->isWellFormed())
-         {
-            arrayVias.Insert(String(Data::from(*viaIt).c_str()));
-         }
-      }
-      if(!arrayVias.Empty())
-      {
-         regEvent["Vias"] = arrayVias;
-      }
+      regEvent.addEncodedArray("Vias", msg.header(h_Vias));
    }
    Tuple publicAddress = Helper::getClientPublicAddress(msg);
    if(publicAddress.getType() != UNKNOWN_TRANSPORT)
    {
-      regEvent["ClientPublicAddress"]["Transport"] = String(Tuple::toData(publicAddress.getType()).c_str());
-      regEvent["ClientPublicAddress"]["IP"] = String(Tuple::inet_ntop(publicAddress).c_str());
-      regEvent["ClientPublicAddress"]["Port"] = Number(publicAddress.getPort());
+      regEvent.startObject("ClientPublicAddress");
+      regEvent.add("Transport", Tuple::toData(publicAddress.getType()));
+      regEvent.add("IP", Tuple::inet_ntop(publicAddress));
+      regEvent.add("Port", publicAddress.getPort());
+      regEvent.endObject();
    }
-   if(mRegistrationAccountingAddRoutingHeaders &&
-      msg.exists(h_Routes) && !msg.header(h_Routes).empty())
+   if(mRegistrationAccountingAddRoutingHeaders && msg.exists(h_Routes))
    {
-      Array arrayRoutes;
-      NameAddrs::const_iterator routeIt = msg.header(h_Routes).begin();
-      for(; routeIt != msg.header(h_Routes).end(); routeIt++)
-      {
-         if(routeIt->isWellFormed())
-         {
-            arrayRoutes.Insert(String(Data::from(*routeIt).c_str()));
-         }
-      }
-      if(!arrayRoutes.Empty())
-      {
-         regEvent["Routes"] = arrayRoutes;
-      }
+      regEvent.addEncodedArray("Routes", msg.header(h_Routes));
    }
-   if(mRegistrationAccountingAddRoutingHeaders &&
-      msg.exists(h_Paths) && !msg.header(h_Paths).empty())
+   if(mRegistrationAccountingAddRoutingHeaders && msg.exists(h_Paths))
    {
-      Array arrayPaths;
-      NameAddrs::const_iterator pathIt = msg.header(h_Paths).begin();
-      for(; pathIt != msg.header(h_Paths).end(); pathIt++)
-      {
-         if(pathIt->isWellFormed())
-         {
-            arrayPaths.Insert(String(Data::from(*pathIt).c_str()));
-         }
-      }
-      if(!arrayPaths.Empty())
-      {
-         regEvent["Paths"] = arrayPaths;
-      }
+      regEvent.addEncodedArray("Paths", msg.header(h_Paths));
    }
    if(msg.exists(h_UserAgent) && msg.header(h_UserAgent).isWellFormed())
    {
-      regEvent["UserAgent"] = String(msg.header(h_UserAgent).value().c_str());
+      regEvent.add("UserAgent", msg.header(h_UserAgent).value());
    }
-   pushEventObjectToQueue(regEvent, RegistrationEventType);
+   regEvent.finish();
+   pushEventToQueue(eventData);
 }
 
 void
@@ -228,96 +189,65 @@ AccountingCollector::doSessionAccounting(const resip::SipMessage& msg, bool rece
                ErrLog(<< "AccountingCollector::doSessionAccounting: missing proper callId header: " << msg);
                return;
             }
-            Object sessionEvent;
-            sessionEvent["EventId"] = Number(SessionCreated);
-            sessionEvent["EventName"] = String("Session Created");
-            sessionEvent["Datetime"] = String(Data::from(datetime).c_str());
-            sessionEvent["CallId"] = String(msg.header(h_CallId).value().c_str());
-            sessionEvent["RequestUri"] = String(Data::from(msg.header(h_RequestLine).uri()).c_str());
+            FifoEvent* eventData = new FifoEvent(SessionEventType);
+            JsonEventEncoder sessionEvent(eventData->mData);
+            sessionEvent.add("EventId", SessionCreated);
+            sessionEvent.add("EventName", "Session Created");
+            sessionEvent.addEncoded("Datetime", datetime);
+            sessionEvent.add("CallId", msg.header(h_CallId).value());
+            sessionEvent.addEncoded("RequestUri", msg.header(h_RequestLine).uri());
             if(msg.exists(h_To) && msg.header(h_To).isWellFormed())
             {
+               sessionEvent.startObject("To");
                if(!msg.header(h_To).displayName().empty())
                {
-                  sessionEvent["To"]["DisplayName"] = String(msg.header(h_To).displayName().c_str());
+                  sessionEvent.add("DisplayName", msg.header(h_To).displayName());
                }
-               sessionEvent["To"]["Uri"] = String(Data::from(msg.header(h_To).uri()).c_str());
+               sessionEvent.addEncoded("Uri", msg.header(h_To).uri());
+               sessionEvent.endObject();
             }
             if(msg.exists(h_From) && msg.header(h_From).isWellFormed())
             {
+               sessionEvent.startObject("From");
                if(!msg.header(h_From).displayName().empty())
                {
-                  sessionEvent["From"]["DisplayName"] = String(msg.header(h_From).displayName().c_str());
+                  sessionEvent.add("DisplayName", msg.header(h_From).displayName());
                }
-               sessionEvent["From"]["Uri"] = String(Data::from(msg.header(h_From).uri()).c_str());
+               sessionEvent.addEncoded("Uri", msg.header(h_From).uri());
+               sessionEvent.endObject();
             }
             if(msg.exists(h_Contacts) && !msg.header(h_Contacts).empty() && msg.header(h_Contacts).front().isWellFormed())
             {
-               sessionEvent["Contact"] = String(Data::from(msg.header(h_Contacts).front()).c_str());
+               sessionEvent.addEncoded("Contact", msg.header(h_Contacts).front());
             }
-            if(mSessionAccountingAddViaHeaders &&
-               msg.exists(h_Vias) && !msg.header(h_Vias).empty())
+            if(mSessionAccountingAddViaHeaders && msg.exists(h_Vias))
             {
-               Array arrayVias;
-               Vias::const_iterator viaIt = msg.header(h_Vias).begin();
-               for(; viaIt != msg.header(h_Vias).end(); viaIt++)
-               {
-                  if(viaIt->isWellFormed())
-                  {
-                     arrayVias.Insert(String(Data::from(*viaIt).c_str()));
-                  }
-               }
-               if(!arrayVias.Empty())
-               {
-                  sessionEvent["Vias"] = arrayVias;
-               }
+               sessionEvent.addEncodedArray("Vias", msg.header(h_Vias));
             }
             Tuple publicAddress = Helper::getClientPublicAddress(msg);
             if(publicAddress.getType() != UNKNOWN_TRANSPORT)
             {
-               sessionEvent["ClientPublicAddress"]["Transport"] = String(Tuple::toData(publicAddress.getType()).c_str());
-               sessionEvent["ClientPublicAddress"]["IP"] = String(Tuple::inet_ntop(publicAddress).c_str());
-               sessionEvent["ClientPublicAddress"]["Port"] = Number(publicAddress.getPort());
+               sessionEvent.startObject("ClientPublicAddress");
+               sessionEvent.add("Transport", Tuple::toData(publicAddress.getType()));
+               sessionEvent.add("IP", Tuple::inet_ntop(publicAddress));
+               sessionEvent.add("Port", publicAddress.getPort());
+               sessionEvent.endObject();
             }
-            if(mSessionAccountingAddRoutingHeaders &&
-               msg.exists(h_Routes) && !msg.header(h_Routes).empty())
+            if(mSessionAccountingAddRoutingHeaders && msg.exists(h_Routes))
             {
-               Array arrayRoutes;
-               NameAddrs::const_iterator routeIt = msg.header(h_Routes).begin();
-               for(; routeIt != msg.header(h_Routes).end(); routeIt++)
-               {
-                  if(routeIt->isWellFormed())
-                  {
-                     arrayRoutes.Insert(String(Data::from(*routeIt).c_str()));
-                  }
-               }
-               if(!arrayRoutes.Empty())
-               {
-                  sessionEvent["Routes"] = arrayRoutes;
-               }
+               sessionEvent.addEncodedArray("Routes", msg.header(h_Routes));
             }
-            if(mSessionAccountingAddRoutingHeaders &&
-               msg.exists(h_RecordRoutes) && !msg.header(h_RecordRoutes).empty())
+            if(mSessionAccountingAddRoutingHeaders && msg.exists(h_RecordRoutes))
             {
-               Array arrayRecordRoutes;
-               NameAddrs::const_iterator recordRouteIt = msg.header(h_RecordRoutes).begin();
-               for(; recordRouteIt != msg.header(h_RecordRoutes).end(); recordRouteIt++)
-               {
-                  if(recordRouteIt->isWellFormed())
-                  {
-                     arrayRecordRoutes.Insert(String(Data::from(*recordRouteIt).c_str()));
-                  }
-               }
-               if(!arrayRecordRoutes.Empty())
-               {
-                  sessionEvent["RecordRoutes"] = arrayRecordRoutes;
-               }
+               sessionEvent.addEncodedArray("RecordRoutes", msg.header(h_RecordRoutes));
             }
             if(msg.exists(h_UserAgent) && msg.header(h_UserAgent).isWellFormed())
             {
-               sessionEvent["UserAgent"] = String(msg.header(h_UserAgent).value().c_str());
+               sessionEvent.add("UserAgent", msg.header(h_UserAgent).value());
             }
+            sessionEvent.finish();
             context.setSessionCreatedEventSent();
-            pushEventObjectToQueue(sessionEvent, SessionEventType);
+            pushEventToQueue(eventData);
          }
          else
          {
@@ -328,30 +258,19 @@ AccountingCollector::doSessionAccounting(const resip::SipMessage& msg, bool rece
                ErrLog(<< "AccountingCollector::doSessionAccounting: missing proper callId header: " << msg);
                return;
             }
-            Object sessionEvent;
-            sessionEvent["EventId"] = Number(SessionRouted);
-            sessionEvent["EventName"] = String("Session Routed");
-            sessionEvent["Datetime"] = String(Data::from(datetime).c_str());
-            sessionEvent["CallId"] = String(msg.header(h_CallId).value().c_str());
-            sessionEvent["TargetUri"] = String(Data::from(msg.header(h_RequestLine).uri()).c_str());
-            if(mSessionAccountingAddRoutingHeaders &&
-               msg.exists(h_Routes) && !msg.header(h_Routes).empty())
-            {
-               Array arrayRoutes;
-               NameAddrs::const_iterator routeIt = msg.header(h_Routes).begin();
-               for(; routeIt != msg.header(h_Routes).end(); routeIt++)
-               {
-                  if(routeIt->isWellFormed())
-                  {
-                     arrayRoutes.Insert(String(Data::from(*routeIt).c_str()));
-                  }
-               }
-               if(!arrayRoutes.Empty())
-               {
-                  sessionEvent["Routes"] = arrayRoutes;
-               }
+            FifoEvent* eventData = new FifoEvent(SessionEventType);
+            JsonEventEncoder sessionEvent(eventData->mData);
+            sessionEvent.add("EventId", SessionRouted);
+            sessionEvent.add("EventName", "Session Routed");
+            sessionEvent.addEncoded("Datetime", datetime);
+            sessionEvent.add("CallId", msg.header(h_CallId).value());
+            sessionEvent.addEncoded("TargetUri", msg.header(h_RequestLine).uri());
+            if(mSessionAccountingAddRoutingHeaders && msg.exists(h_Routes))
+            {
+               sessionEvent.addEncodedArray("Routes", msg.header(h_Routes));
             }
-            pushEventObjectToQueue(sessionEvent, SessionEventType);
+            sessionEvent.finish();
+            pushEventToQueue(eventData);
          }
       }
       else if(msg.method() == BYE && received)
@@ -363,33 +282,39 @@ AccountingCollector::doSessionAccounting(const resip::SipMessage& msg, bool rece
             ErrLog(<< "AccountingCollector::doSessionAccounting: missing proper callId header: " << msg);
             return;
          }
-         Object sessionEvent;
-         sessionEvent["EventId"] = Number(SessionEnded);
-         sessionEvent["EventName"] = String("Session Ended");
-         sessionEvent["Datetime"] = String(Data::from(datetime).c_str());
-         sessionEvent["CallId"] = String(msg.header(h_CallId).value().c_str());
+         FifoEvent* eventData = new FifoEvent(SessionEventType);
+         JsonEventEncoder sessionEvent(eventData->mData);
+         sessionEvent.add("EventId", SessionEnded);
+         sessionEvent.add("EventName", "Session Ended");
+         sessionEvent.addEncoded("Datetime", datetime);
+         sessionEvent.add("CallId", msg.header(h_CallId).value());
          if(msg.exists(h_From) && msg.header(h_From).isWellFormed())
          {
+            sessionEvent.startObject("From");
             if(!msg.header(h_From).displayName().empty())
             {
-               sessionEvent["From"]["DisplayName"] = String(msg.header(h_From).displayName().c_str());
+               sessionEvent.add("DisplayName", msg.header(h_From).displayName());
             }
-            sessionEvent["From"]["Uri"] = String(Data::from(msg.header(h_From).uri()).c_str());
+            sessionEvent.addEncoded("Uri", msg.header(h_From).uri());
+            sessionEvent.endObject();
          }
          if(msg.exists(h_Reasons) && !msg.header(h_Reasons).empty() && msg.header(h_Reasons).front().isWellFormed())
          {
             // Just look at first occurance
-            sessionEvent["Reason"]["Value"] = String(msg.header(h_Reasons).front().value().c_str());
+            sessionEvent.startObject("Reason");
+            sessionEvent.add("Value", msg.header(h_Reasons).front().value());
             if(msg.header(h_Reasons).front().exists(p_cause))
             {
-               sessionEvent["Reason"]["Cause"] = Number(msg.header(h_Reasons).front().param(p_cause));
+               sessionEvent.add("Cause", msg.header(h_Reasons).front().param(p_cause));
             }
             if(msg.header(h_Reasons).front().exists(p_text) && !msg.header(h_Reasons).front().param(p_text).empty())
             {
-               sessionEvent["Reason"]["Text"] = String(msg.header(h_Reasons).front().param(p_text).c_str());
+               sessionEvent.add("Text", msg.header(h_Reasons).front().param(p_text));
             }
+            sessionEvent.endObject();
          }
-         pushEventObjectToQueue(sessionEvent, SessionEventType);
+         sessionEvent.finish();
+         pushEventToQueue(eventData);
       }
       else if(msg.method() == CANCEL && received)
       {
@@ -400,25 +325,29 @@ AccountingCollector::doSessionAccounting(const resip::SipMessage& msg, bool rece
             ErrLog(<< "AccountingCollector::doSessionAccounting: missing proper callId header: " << msg);
             return;
          }
-         Object sessionEvent;
-         sessionEvent["EventId"] = Number(SessionCancelled);
-         sessionEvent["EventName"] = String("Session Cancelled");
-         sessionEvent["Datetime"] = String(Data::from(datetime).c_str());
-         sessionEvent["CallId"] = String(msg.header(h_CallId).value().c_str());
+         FifoEvent* eventData = new FifoEvent(SessionEventType);
+         JsonEventEncoder sessionEvent(eventData->mData);
+         sessionEvent.add("EventId", SessionCancelled);
+         sessionEvent.add("EventName", "Session Cancelled");
+         sessionEvent.addEncoded("Datetime", datetime);
+         sessionEvent.add("CallId", msg.header(h_CallId).value());
          if(msg.exists(h_Reasons) && !msg.header(h_Reasons).empty() && msg.header(h_Reasons).front().isWellFormed())
          {
             // Just look at first occurance
-            sessionEvent["Reason"]["Value"] = String(msg.header(h_Reasons).front().value().c_str());
+            sessionEvent.startObject("Reason");
+            sessionEvent.add("Value", msg.header(h_Reasons).front().value());
             if(msg.header(h_Reasons).front().exists(p_cause))
             {
-               sessionEvent["Reason"]["Cause"] = Number(msg.header(h_Reasons).front().param(p_cause));
+               sessionEvent.add("Cause", msg.header(h_Reasons).front().param(p_cause));
             }
             if(msg.header(h_Reasons).front().exists(p_text) && !msg.header(h_Reasons).front().param(p_text).empty())
             {
-               sessionEvent["Reason"]["Text"] = String(msg.header(h_Reasons).front().param(p_text).c_str());
+               sessionEvent.add("Text", msg.header(h_Reasons).front().param(p_text));
             }
+            sessionEvent.endObject();
          }
-         pushEventObjectToQueue(sessionEvent, SessionEventType);
+         sessionEvent.finish();
+         pushEventToQueue(eventData);
       }
       else if(msg.method() == REFER && received && msg.header(h_To).exists(p_tag))
       {
@@ -430,28 +359,32 @@ AccountingCollector::doSessionAccounting(const resip::SipMessage& msg, bool rece
             ErrLog(<< "AccountingCollector::doSessionAccounting: missing proper callId header: " << msg);
             return;
          }
-         Object sessionEvent;
-         sessionEvent["EventId"] = Number(SessionRedirected);
-         sessionEvent["EventName"] = String("Session Redirected");
-         sessionEvent["Datetime"] = String(Data::from(datetime).c_str());
-         sessionEvent["CallId"] = String(msg.header(h_CallId).value().c_str());
+         FifoEvent* eventData = new FifoEvent(SessionEventType);
+         JsonEventEncoder sessionEvent(eventData->mData);
+         sessionEvent.add("EventId", SessionRedirected);
+         sessionEvent.add("EventName", "Session Redirected");
+         sessionEvent.addEncoded("Datetime", datetime);
+         sessionEvent.add("CallId", msg.header(h_CallId).value());
          if(msg.exists(h_From) && msg.header(h_From).isWellFormed())
          {
+            sessionEvent.startObject("ReferredBy");
             if(!msg.header(h_From).displayName().empty())
             {
-               sessionEvent["ReferredBy"]["DisplayName"] = String(msg.header(h_From).displayName().c_str());
+               sessionEvent.add("DisplayName", msg.header(h_From).displayName());
             }
-            sessionEvent["ReferredBy"]["Uri"] = String(Data::from(msg.header(h_From).uri()).c_str());
+            sessionEvent.addEncoded("Uri", msg.header(h_From).uri());
+            sessionEvent.endObject();
          }
          if(msg.exists(h_ReferTo) && msg.header(h_ReferTo).isWellFormed())
          {
-            sessionEvent["TargetUri"] = String(Data::from(msg.header(h_ReferTo).uri()).c_str());
+            sessionEvent.addEncoded("TargetUri", msg.header(h_ReferTo).uri());
          }
-         pushEventObjectToQueue(sessionEvent, SessionEventType);
+         sessionEvent.finish();
+         pushEventToQueue(eventData);
       }
    }
    // Response
-   else 
+   else
    {
       if(!received && msg.method() == INVITE)
       {
@@ -465,132 +398,117 @@ AccountingCollector::doSessionAccounting(const resip::SipMessage& msg, bool rece
                ErrLog(<< "AccountingCollector::doSessionAccounting: missing proper callId header: " << msg);
                return;
             }
-            Object sessionEvent;
-            sessionEvent["EventId"] = Number(SessionEstablished);
-            sessionEvent["EventName"] = String("Session Established");
-            sessionEvent["Datetime"] = String(Data::from(datetime).c_str());
-            sessionEvent["CallId"] = String(msg.header(h_CallId).value().c_str());
+            FifoEvent* eventData = new FifoEvent(SessionEventType);
+            JsonEventEncoder sessionEvent(eventData->mData);
+            sessionEvent.add("EventId", SessionEstablished);
+            sessionEvent.add("EventName", "Session Established");
+            sessionEvent.addEncoded("Datetime", datetime);
+            sessionEvent.add("CallId", msg.header(h_CallId).value());
             if(msg.exists(h_Contacts) && !msg.header(h_Contacts).empty() && msg.header(h_Contacts).front().isWellFormed())
             {
-               sessionEvent["Contact"] = String(Data::from(msg.header(h_Contacts).front()).c_str());
+               sessionEvent.addEncoded("Contact", msg.header(h_Contacts).front());
             }
-            if(mSessionAccountingAddRoutingHeaders &&
-               msg.exists(h_RecordRoutes) && !msg.header(h_RecordRoutes).empty())
+            if(mSessionAccountingAddRoutingHeaders && msg.exists(h_RecordRoutes))
             {
-               Array arrayRecordRoutes;
-               NameAddrs::const_iterator recordRouteIt = msg.header(h_RecordRoutes).begin();
-               for(; recordRouteIt != msg.header(h_RecordRoutes).end(); recordRouteIt++)
-               {
-                  if(recordRouteIt->isWellFormed())
-                  {
-                     arrayRecordRoutes.Insert(String(Data::from(*recordRouteIt).c_str()));
-                  }
-               }
-               if(!arrayRecordRoutes.Empty())
-               {
-                  sessionEvent["RecordRoutes"] = arrayRecordRoutes;
-               }
+               sessionEvent.addEncodedArray("RecordRoutes", msg.header(h_RecordRoutes));
             }
             if(msg.exists(h_UserAgent) && msg.header(h_UserAgent).isWellFormed())
             {
-               sessionEvent["UserAgent"] = String(msg.header(h_UserAgent).value().c_str());
+               sessionEvent.add("UserAgent", msg.header(h_UserAgent).value());
             }
+            sessionEvent.finish();
             context.setSessionEstablishedEventSent();
-            pushEventObjectToQueue(sessionEvent, SessionEventType);
+            pushEventToQueue(eventData);
          }
          else if(msg.header(h_StatusLine).statusCode() >= 300 &&
                  msg.header(h_StatusLine).statusCode() < 400)
          {
             // Session Redirected
-            // Session Answered
             DateCategory datetime;
             if(!msg.exists(h_CallId) || !msg.header(h_CallId).isWellFormed())
             {
                ErrLog(<< "AccountingCollector::doSessionAccounting: missing proper callId header: " << msg);
                return;
             }
-            Object sessionEvent;
-            sessionEvent["EventId"] = Number(SessionRedirected);
-            sessionEvent["EventName"] = String("Session Redirected");
-            sessionEvent["Datetime"] = String(Data::from(datetime).c_str());
-            sessionEvent["CallId"] = String(msg.header(h_CallId).value().c_str());
-            if(msg.exists(h_Contacts) && !msg.header(h_Contacts).empty())
+            FifoEvent* eventData = new FifoEvent(SessionEventType);
+            JsonEventEncoder sessionEvent(eventData->mData);
+            sessionEvent.add("EventId", SessionRedirected);
+            sessionEvent.add("EventName", "Session Redirected");
+            sessionEvent.addEncoded("Datetime", datetime);
+            sessionEvent.add("CallId", msg.header(h_CallId).value());
+            if(msg.exists(h_Contacts))
             {
-               Array arrayContacts;
-               NameAddrs::const_iterator contactIt = msg.header(h_Contacts).begin();
-               for(; contactIt != msg.header(h_Contacts).end(); contactIt++)
-               {
-                  if(contactIt->isWellFormed())
-                  {
-                     arrayContacts.Insert(String(Data::from(*contactIt).c_str()));
-                  }
-               }
-               if(!arrayContacts.Empty())
-               {
-                  sessionEvent["TargetUris"] = arrayContacts;
-               }
+               sessionEvent.addEncodedArray("TargetUris", msg.header(h_Contacts));
             }
             if(msg.exists(h_UserAgent) && msg.header(h_UserAgent).isWellFormed())
             {
-               sessionEvent["UserAgent"] = String(msg.header(h_UserAgent).value().c_str());
+               sessionEvent.add("UserAgent", msg.header(h_UserAgent).value());
             }
-            pushEventObjectToQueue(sessionEvent, SessionEventType);
+            sessionEvent.finish();
+            pushEventToQueue(eventData);
          }
          else if(msg.header(h_StatusLine).statusCode() >= 400 &&
                  msg.header(h_StatusLine).statusCode() < 700)
          {
             // Session Error
-            Object sessionEvent;
-            // Session Answered
             DateCategory datetime;
             if(!msg.exists(h_CallId) || !msg.header(h_CallId).isWellFormed())
             {
                ErrLog(<< "AccountingCollector::doSessionAccounting: missing proper callId header: " << msg);
                return;
             }
-            sessionEvent["EventId"] = Number(SessionError);
-            sessionEvent["EventName"] = String("Session Error");
-            sessionEvent["Datetime"] = String(Data::from(datetime).c_str());
-            sessionEvent["CallId"] = String(msg.header(h_CallId).value().c_str());
-            sessionEvent["Status"]["Code"] = Number(msg.header(h_StatusLine).statusCode());
+            FifoEvent* eventData = new FifoEvent(SessionEventType);
+            JsonEventEncoder sessionEvent(eventData->mData);
+            sessionEvent.add("EventId", SessionError);
+            sessionEvent.add("EventName", "Session Error");
+            sessionEvent.addEncoded("Datetime", datetime);
+            sessionEvent.add("CallId", msg.header(h_CallId).value());
+            sessionEvent.startObject("Status");
+            sessionEvent.add("Code", msg.header(h_StatusLine).statusCode());
             if(!msg.header(h_StatusLine).reason().empty())
             {
-               sessionEvent["Status"]["Text"] = String(msg.header(h_StatusLine).reason().c_str());
+               sessionEvent.add("Text", msg.header(h_StatusLine).reason());
             }
+            sessionEvent.endObject();
             if(msg.exists(h_Warnings) && !msg.header(h_Warnings).empty() && msg.header(h_Warnings).front().isWellFormed())
             {
                // Just look at first occurance
-               sessionEvent["Warning"]["Code"] = Number(msg.header(h_Warnings).front().code());
+               sessionEvent.startObject("Warning");
+               sessionEvent.add("Code", msg.header(h_Warnings).front().code());
                if(!msg.header(h_Warnings).front().text().empty())
                {
-                  sessionEvent["Warning"]["Text"] = String(msg.header(h_Warnings).front().text().c_str());
+                  sessionEvent.add("Text", msg.header(h_Warnings).front().text());
                }
+               sessionEvent.endObject();
             }
             // Note: a reason header is not usually present on a response - but we will use one if it is
             if(msg.exists(h_Reasons) && !msg.header(h_Reasons).empty() && msg.header(h_Reasons).front().isWellFormed())
             {
                // Just look at first occurance
-               sessionEvent["Reason"]["Value"] = String(msg.header(h_Reasons).front().value().c_str());
+               sessionEvent.startObject("Reason");
+               sessionEvent.add("Value", msg.header(h_Reasons).front().value());
                if(msg.header(h_Reasons).front().exists(p_cause))
                {
-                  sessionEvent["Reason"]["Cause"] = Number(msg.header(h_Reasons).front().param(p_cause));
+                  sessionEvent.add("Cause", msg.header(h_Reasons).front().param(p_cause));
                }
                if(msg.header(h_Reasons).front().exists(p_text) && !msg.header(h_Reasons).front().param(p_text).empty())
                {
-                  sessionEvent["Reason"]["Text"] = String(msg.header(h_Reasons).front().param(p_text).c_str());
+                  sessionEvent.add("Text", msg.header(h_Reasons).front().param(p_text));
                }
+               sessionEvent.endObject();
             }
             if(msg.exists(h_UserAgent) && msg.header(h_UserAgent).isWellFormed())
             {
-               sessionEvent["UserAgent"] = String(msg.header(h_UserAgent).value().c_str());
+               sessionEvent.add("UserAgent", msg.header(h_UserAgent).value());
             }
-            pushEventObjectToQueue(sessionEvent, SessionEventType);
+            sessionEvent.finish();
+            pushEventToQueue(eventData);
          }
       }
    }
 }
 
-PersistentMessageEnqueue* 
+PersistentMessageEnqueue*
 AccountingCollector::initializeEventQueue(FifoEventType type, bool destroyFirst)
 {
    switch(type)
@@ -634,79 +552,196 @@ AccountingCollector::initializeEventQueue(FifoEventType type, bool destroyFirst)
    return 0;
 }
 
-void 
-AccountingCollector::pushEventObjectToQueue(Object& eventObject, AccountingCollector::FifoEventType type)
+void
+AccountingCollector::pushEventToQueue(FifoEvent* eventData)
 {
-   FifoEvent* eventData = new FifoEvent;
-   eventData->mType = type;
+   // Note:  BerkeleyDb calls can block (ie. deaklock after consumer crash), so we use a
+   //        Fifo and thread to ensure we don't block the core proxy processing.  The Fifo
+   //        is bounded so that a stalled database cannot consume unlimited memory.
+   if(mFifo.add(eventData, TimeLimitFifo<FifoEvent>::InternalElement))
    {
-      DataStream ds(eventData->mData);
-      Writer::Write(eventObject, ds);
+      size_t queueSize = mFifo.size();
+      Lock lock(mStatsMutex);
+      mStats.mEventsQueued++;
+      if(queueSize > mStats.mQueueHighWaterMark)
+      {
+         mStats.mQueueHighWaterMark = queueSize;
+      }
+   }
+   else
+   {
+      delete eventData;
+      UInt64 dropped;
+      {
+         Lock lock(mStatsMutex);
+         dropped = ++mStats.mEventsDropped;
+      }
+      // Log the first drop and then every 1000th so that we don't flood the log under overload
+      if(dropped % 1000 == 1)
+      {
+         ErrLog(<< "AccountingCollector: event queue is full - dropping event! (dropped so far=" << dropped << ")");
+      }
    }
-
-   // Note:  BerkeleyDb calls can block (ie. deaklock after consumer crash), so we use a 
-   //        Fifo and thread to ensure we don't block the core proxy processing
-   mFifo.add(eventData, TimeLimitFifo<FifoEvent>::InternalElement);
 }
 
-void 
-AccountingCollector::internalProcess(std::auto_ptr<FifoEvent> eventData)
+void
+AccountingCollector::commitBatch(FifoEventType type, std::vector<Data>& records)
 {
-   InfoLog(<< "AccountingCollector::internalProcess: JSON=" << endl << eventData->mData);
+   if(records.empty())
+   {
+      return;
+   }
 
-   PersistentMessageEnqueue* queue = initializeEventQueue(eventData->mType);
+   if(Log::isLogging(Log::Info, Subsystem::REPRO))
+   {
+      for(std::vector<Data>::const_iterator it = records.begin(); it != records.end(); it++)
+      {
+         InfoLog(<< "AccountingCollector::commitBatch: JSON=" << endl << *it);
+      }
+   }
 
-   if(!queue)
+   UInt64 startTime = Timer::getTimeMs();
+   bool success = writeBatch(type, records);
+
+   Lock lock(mStatsMutex);
+   if(success)
    {
-      ErrLog(<< "AccountingCollector: cannot initialize PersistentMessageQueue - dropping event!");
-      return;
+      mStats.mEventsCommitted += records.size();
+      mStats.mBatchesCommitted++;
+      mStats.mCommitTimeMs += Timer::getTimeMs() - startTime;
+      if(records.size() > mStats.mLargestBatch)
+      {
+         mStats.mLargestBatch = records.size();
+      }
+   }
+   else
+   {
+      mStats.mEventsFailed += records.size();
    }
+   records.clear();
+}
 
-   if(!queue->push(eventData->mData))
+bool
+AccountingCollector::writeBatch(FifoEventType type, const std::vector<Data>& records)
+{
+   bool success = false;
+   PersistentMessageEnqueue* queue = initializeEventQueue(type);
+   if(!queue)
    {
-      // Error pushing - see if db recovery is needed
-      if(queue->isRecoveryNeeded())
+      ErrLog(<< "AccountingCollector: cannot initialize PersistentMessageQueue - dropping " << records.size() << " event(s)!");
+   }
+   else if(queue->push(records))
+   {
+      success = true;
+   }
+   // Error pushing - see if db recovery is needed.  The failed transaction was aborted, so the whole
+   // batch can be retried.
+   else if(queue->isRecoveryNeeded())
+   {
+      if((queue = initializeEventQueue(type, true /* destoryFirst */)) == 0)
       {
-         if((queue = initializeEventQueue(eventData->mType, true /* destoryFirst */)) == 0)
-         {
-            ErrLog(<< "AccountingCollector: cannot initialize PersistentMessageQueue - dropping event!");
-            return;
-         }
-         else
-         {
-            if(!queue->push(eventData->mData))
-            {
-               ErrLog(<< "AccountingCollector: error pushing event to queue - dropping event!");
-            }
-         }
+         ErrLog(<< "AccountingCollector: cannot initialize PersistentMessageQueue - dropping " << records.size() << " event(s)!");
+      }
+      else if(queue->push(records))
+      {
+         success = true;
       }
       else
       {
-         ErrLog(<< "AccountingCollector: error pushing event to queue - dropping event!");
+         ErrLog(<< "AccountingCollector: error pushing events to queue - dropping " << records.size() << " event(s)!");
       }
    }
+   else
+   {
+      ErrLog(<< "AccountingCollector: error pushing events to queue - dropping " << records.size() << " event(s)!");
+   }
+   return success;
 }
 
-void 
+void
 AccountingCollector::thread()
 {
+   std::vector<Data> sessionRecords;
+   std::vector<Data> registrationRecords;
+   sessionRecords.reserve(mBatchSize);
+   registrationRecords.reserve(mBatchSize);
+
    while (!isShutdown() || !mFifo.empty())  // Ensure we drain the queue before shutting down
    {
       try
       {
          std::auto_ptr<FifoEvent> eventData(mFifo.getNext(1000));  // Only need to wake up to see if we are shutdown
-         if (eventData.get())
+         if (!eventData.get())
          {
-            internalProcess(eventData);
+            continue;
+         }
+
+         // Gather events until the batch is full or the batch latency has expired, so that
+         // many events are written to the database in a single transaction
+         UInt64 batchDeadline = Timer::getTimeMs() + mBatchLatencyMs;
+         unsigned int batchCount = 0;
+         while(eventData.get())
+         {
+            std::vector<Data>& records = eventData->mType == SessionEventType ? sessionRecords : registrationRecords;
+            records.push_back(Data::Empty);
+            records.back().takeBuf(eventData->mData);
+            if(++batchCount >= mBatchSize)
+            {
+               break;
+            }
+
+            UInt64 now = Timer::getTimeMs();
+            if(now < batchDeadline && !isShutdown())
+            {
+               eventData.reset(mFifo.getNext((int)(batchDeadline - now)));
+            }
+            else
+            {
+               eventData.reset(mFifo.getNext(-1));  // only take what is already queued
+            }
          }
+
+         commitBatch(SessionEventType, sessionRecords);
+         commitBatch(RegistrationEventType, registrationRecords);
       }
       catch (BaseException& e)
       {
          WarningLog (<< "Unhandled exception: " << e);
+         sessionRecords.clear();
+         registrationRecords.clear();
       }
    }
 }
 
+AccountingCollector::Stats
+AccountingCollector::getStats() const
+{
+   Stats stats;
+   {
+      Lock lock(mStatsMutex);
+      stats = mStats;
+   }
+   stats.mQueueSize = mFifo.size();
+   return stats;
+}
+
+void
+AccountingCollector::encodeStats(EncodeStream& strm) const
+{
+   Stats stats = getStats();
+   strm << "QueueSize=" << stats.mQueueSize
+        << " QueueHighWaterMark=" << stats.mQueueHighWaterMark
+        << " MaxQueueSize=" << mFifo.getCountDepthTolerance() << endl;
+   strm << "EventsQueued=" << stats.mEventsQueued
+        << " EventsDropped=" << stats.mEventsDropped
+        << " EventsCommitted=" << stats.mEventsCommitted
+        << " EventsFailed=" << stats.mEventsFailed << endl;
+   strm << "BatchesCommitted=" << stats.mBatchesCommitted
+        << " AverageBatchSize=" << (stats.mBatchesCommitted ? stats.mEventsCommitted / stats.mBatchesCommitted : 0)
+        << " LargestBatch=" << stats.mLargestBatch
+        << " AverageCommitTimeMs=" << (stats.mBatchesCommitted ? stats.mCommitTimeMs / stats.mBatchesCommitted : 0) << endl;
+}
+
 
 /* ====================================================================
  * The Vovida Software License, Version 1.0 
@@ -2,15 +2,12 @@
 #define RESIP_ACCOUNTINGCOLLECTOR_HXX 
 
 #include <memory>
+#include <vector>
 #include "rutil/ThreadIf.hxx"
+#include "rutil/Mutex.hxx"
 #include "rutil/TimeLimitFifo.hxx"
 #include "resip/stack/SipMessage.hxx"
 
-namespace json
-{
-   class Object;
-}
-
 namespace repro
 {
 class RequestContext;
@@ -45,6 +42,36 @@ public:
    virtual void doSessionAccounting(const resip::SipMessage& sip, bool received, RequestContext& context);
    virtual void doRegistrationAccounting(RegistrationEvent regevent, const resip::SipMessage& sip);
 
+   // Counters describing how well the writer thread is keeping up with event producers
+   class Stats
+   {
+   public:
+      Stats() : mEventsQueued(0), mEventsDropped(0), mEventsCommitted(0), mEventsFailed(0),
+                mBatchesCommitted(0), mCommitTimeMs(0), mLargestBatch(0), mQueueHighWaterMark(0), mQueueSize(0) {}
+      UInt64 mEventsQueued;
+      UInt64 mEventsDropped;     // rejected because the fifo was full
+      UInt64 mEventsCommitted;
+      UInt64 mEventsFailed;      // lost due to database errors
+      UInt64 mBatchesCommitted;
+      UInt64 mCommitTimeMs;      // total time spent in database transactions
+      size_t mLargestBatch;
+      size_t mQueueHighWaterMark;
+      size_t mQueueSize;
+   };
+   Stats getStats() const;
+   void encodeStats(EncodeStream& strm) const;
+
+protected:
+   enum FifoEventType
+   {
+      SessionEventType,
+      RegistrationEventType
+   };
+
+   // Writes a batch of encoded events to the persistent queue for type in a
+   // single transaction, returns false if they could not be written
+   virtual bool writeBatch(FifoEventType type, const std::vector<resip::Data>& records);
+
 private:
    resip::Data mDbBaseDir;
    PersistentMessageEnqueue* mSessionEventQueue;
@@ -54,24 +81,25 @@ private:
    bool mRegistrationAccountingAddRoutingHeaders;
    bool mRegistrationAccountingAddViaHeaders;
    bool mRegistrationAccountingLogRefreshes;
+   unsigned int mBatchSize;
+   unsigned int mBatchLatencyMs;
 
    virtual void thread();
 
-   enum FifoEventType
-   {
-      SessionEventType,
-      RegistrationEventType
-   };
    class FifoEvent
    {
    public:
+      FifoEvent(FifoEventType type) : mType(type), mData(1024, resip::Data::Preallocate) {}
       FifoEventType mType;
       resip::Data mData;
    };
    resip::TimeLimitFifo<FifoEvent> mFifo;
    PersistentMessageEnqueue* initializeEventQueue(FifoEventType type, bool destroyFirst=false);
-   void pushEventObjectToQueue(json::Object& object, FifoEventType type);
-   void internalProcess(std::auto_ptr<FifoEvent> eventData);
+   void pushEventToQueue(FifoEvent* eventData);
+   void commitBatch(FifoEventType type, std::vector<resip::Data>& records);
+
+   mutable resip::Mutex mStatsMutex;
+   Stats mStats;
 };
 
 }
@@ -17,6 +17,10 @@
 #include "repro/XmlRpcServerBase.hxx"
 #include "repro/XmlRpcConnection.hxx"
 #include "repro/ReproRunner.hxx"
+#include "repro/RegSyncClient.hxx"
+#include "repro/RegSyncServer.hxx"
+#include "repro/SqlDb.hxx"
+#include "repro/UserStore.hxx"
 #include "repro/CommandServer.hxx"
 
 using namespace repro;
@@ -105,6 +109,26 @@ CommandServer::handleRequest(unsigned int connectionId, unsigned int requestId,
       {
          handleSetCongestionToleranceRequest(connectionId, requestId, xml);
       }
+      else if(isEqualNoCase(xml.getTag(), "GetAccountingStats"))
+      {
+         handleGetAccountingStatsRequest(connectionId, requestId, xml);
+      }
+      else if(isEqualNoCase(xml.getTag(), "GetRegSyncStats"))
+      {
+         handleGetRegSyncStatsRequest(connectionId, requestId, xml);
+      }
+      else if(isEqualNoCase(xml.getTag(), "GetDatabaseStats"))
+      {
+         handleGetDatabaseStatsRequest(connectionId, requestId, xml);
+      }
+      else if(isEqualNoCase(xml.getTag(), "GetUserAuthCacheStats"))
+      {
+         handleGetUserAuthCacheStatsRequest(connectionId, requestId, xml);
+      }
+      else if(isEqualNoCase(xml.getTag(), "ClearUserAuthCache"))
+      {
+         handleClearUserAuthCacheRequest(connectionId, requestId, xml);
+      }
       else if(isEqualNoCase(xml.getTag(), "Shutdown"))
       {
          handleShutdownRequest(connectionId, requestId, xml);
@@ -351,6 +375,171 @@ CommandServer::handleSetCongestionToleranceRequest(unsigned int connectionId, un
    }
 }
 
+void 
+CommandServer::handleGetAccountingStatsRequest(unsigned int connectionId, unsigned int requestId, XMLCursor& xml)
+{
+   InfoLog(<< "CommandServer::handleGetAccountingStatsRequest");
+
+   AccountingCollector* accountingCollector = mReproRunner.getProxy()->getAccountingCollector();
+   if(accountingCollector != 0)
+   {
+      Data buffer;
+      {
+         DataStream strm(buffer);
+         accountingCollector->encodeStats(strm);
+      }
+
+      sendResponse(connectionId, requestId, buffer, 200, "Accounting stats retrieved.");
+   }
+   else
+   {
+      sendResponse(connectionId, requestId, Data::Empty, 400, "Accounting is not enabled.");
+   }
+}
+
+void 
+CommandServer::handleGetRegSyncStatsRequest(unsigned int connectionId, unsigned int requestId, XMLCursor& xml)
+{
+   InfoLog(<< "CommandServer::handleGetRegSyncStatsRequest");
+
+   RegSyncServer* servers[] = { mReproRunner.getRegSyncServerV4(), mReproRunner.getRegSyncServerV6() };
+   RegSyncClient* client = mReproRunner.getRegSyncClient();
+   if(servers[0] == 0 && servers[1] == 0 && client == 0)
+   {
+      sendResponse(connectionId, requestId, Data::Empty, 400, "RegSync is not enabled.");
+      return;
+   }
+
+   Data buffer;
+   {
+      DataStream strm(buffer);
+      for(unsigned int i = 0; i < 2; i++)
+      {
+         if(servers[i])
+         {
+            strm << (i == 0 ? "Server V4: " : "Server V6: ");
+            servers[i]->encodeStats(strm);
+         }
+      }
+      if(client)
+      {
+         strm << "Client: ";
+         client->encodeStats(strm);
+      }
+   }
+
+   sendResponse(connectionId, requestId, buffer, 200, "RegSync stats retrieved.");
+}
+
+void 
+CommandServer::handleGetDatabaseStatsRequest(unsigned int connectionId, unsigned int requestId, XMLCursor& xml)
+{
+   InfoLog(<< "CommandServer::handleGetDatabaseStatsRequest");
+
+   SqlDb* dbs[] = { dynamic_cast<SqlDb*>(mReproRunner.getAbstractDb()), 
+                    dynamic_cast<SqlDb*>(mReproRunner.getRuntimeAbstractDb()) };
+   if(dbs[1] == dbs[0])
+   {
+      dbs[1] = 0;
+   }
+   if(dbs[0] == 0 && dbs[1] == 0)
+   {
+      sendResponse(connectionId, requestId, Data::Empty, 400, "No SQL database is in use.");
+      return;
+   }
+
+   Data buffer;
+   {
+      DataStream strm(buffer);
+      for(unsigned int i = 0; i < 2; i++)
+      {
+         if(dbs[i])
+         {
+            strm << (i == 0 ? "Database: " : "Runtime database: ") << std::endl;
+            dbs[i]->encodeStats(strm);
+         }
+      }
+   }
+
+   sendResponse(connectionId, requestId, buffer, 200, "Database stats retrieved.");
+}
+
+void 
+CommandServer::handleGetUserAuthCacheStatsRequest(unsigned int connectionId, unsigned int requestId, XMLCursor& xml)
+{
+   InfoLog(<< "CommandServer::handleGetUserAuthCacheStatsRequest");
+
+   Data buffer;
+   {
+      DataStream strm(buffer);
+      mReproRunner.getProxy()->getUserStore().encodeAuthCacheStats(strm);
+   }
+
+   sendResponse(connectionId, requestId, buffer, 200, "User auth cache stats retrieved.");
+}
+
+void 
+CommandServer::handleClearUserAuthCacheRequest(unsigned int connectionId, unsigned int requestId, XMLCursor& xml)
+{
+   InfoLog(<< "CommandServer::handleClearUserAuthCacheRequest");
+
+   Data user;
+   Data realm;
+
+   // Check for Parameters
+   if(xml.firstChild())
+   {
+      if(isEqualNoCase(xml.getTag(), "request"))
+      {
+         if(xml.firstChild())
+         {
+            while(true)
+            {
+               if(isEqualNoCase(xml.getTag(), "user"))
+               {
+                  if(xml.firstChild())
+                  {
+                     user = xml.getValue();
+                     xml.parent();
+                  }
+               }
+               else if(isEqualNoCase(xml.getTag(), "realm"))
+               {
+                  if(xml.firstChild())
+                  {
+                     realm = xml.getValue();
+                     xml.parent();
+                  }
+               }
+               if(!xml.nextSibling())
+               {
+                  // break on no more sibilings
+                  break;
+               }
+            }
+            xml.parent();
+         }
+      }
+      xml.parent();
+   }
+
+   UserStore& userStore = mReproRunner.getProxy()->getUserStore();
+   if(user.empty() && realm.empty())
+   {
+      userStore.clearAuthCache();
+      sendResponse(connectionId, requestId, Data::Empty, 200, "User auth cache cleared.");
+   }
+   else if(user.empty() || realm.empty())
+   {
+      sendResponse(connectionId, requestId, Data::Empty, 400, "Both user and realm must be specified to clear a single user.");
+   }
+   else
+   {
+      userStore.invalidateAuthCache(user, realm);
+      sendResponse(connectionId, requestId, Data::Empty, 200, "User auth cache entry cleared.");
+   }
+}
+
 void 
 CommandServer::handleShutdownRequest(unsigned int connectionId, unsigned int requestId, XMLCursor& xml)
 {
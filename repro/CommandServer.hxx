@@ -55,6 +55,11 @@ private:
    void handleGetDnsCacheRequest(unsigned int connectionId, unsigned int requestId, resip::XMLCursor& xml);
    void handleGetCongestionStatsRequest(unsigned int connectionId, unsigned int requestId, resip::XMLCursor& xml);
    void handleSetCongestionToleranceRequest(unsigned int connectionId, unsigned int requestId, resip::XMLCursor& xml);
+   void handleGetAccountingStatsRequest(unsigned int connectionId, unsigned int requestId, resip::XMLCursor& xml);
+   void handleGetRegSyncStatsRequest(unsigned int connectionId, unsigned int requestId, resip::XMLCursor& xml);
+   void handleGetDatabaseStatsRequest(unsigned int connectionId, unsigned int requestId, resip::XMLCursor& xml);
+   void handleGetUserAuthCacheStatsRequest(unsigned int connectionId, unsigned int requestId, resip::XMLCursor& xml);
+   void handleClearUserAuthCacheRequest(unsigned int connectionId, unsigned int requestId, resip::XMLCursor& xml);
    void handleShutdownRequest(unsigned int connectionId, unsigned int requestId, resip::XMLCursor& xml);
    void handleGetProxyConfigRequest(unsigned int connectionId, unsigned int requestId, resip::XMLCursor& xml);
    void handleRestartRequest(unsigned int connectionId, unsigned int requestId, resip::XMLCursor& xml);
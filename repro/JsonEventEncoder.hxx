@@ -0,0 +1,218 @@
+#if !defined(REPRO_JSONEVENTENCODER_HXX)
+#define REPRO_JSONEVENTENCODER_HXX
+
+#include <cstring>
+
+#include "rutil/Data.hxx"
+#include "rutil/DataStream.hxx"
+#include "resip/stack/ParserCategory.hxx"
+#include "resip/stack/ParserContainer.hxx"
+
+namespace repro
+{
+
+// Streams a JSON object straight into the event buffer, without building a
+// json::Object tree first.  The output layout (tabs, newlines, " : " separators
+// and \u escaping of UTF-8 sequences) matches json::Writer, so consumers of
+// the accounting queues see exactly the same records as before.
+// Note: empty containers are never opened, callers only start an object or
+//       array once they know at least one member will be added.
+class JsonEventEncoder
+{
+public:
+   JsonEventEncoder(resip::Data& buffer) : mBuffer(buffer), mDepth(0), mFirst(true)
+   {
+      open('{');
+   }
+
+   void finish() { close('}'); }
+
+   void startObject(const char* name) { member(name); open('{'); }
+   void endObject() { close('}'); }
+   void startArray(const char* name) { member(name); open('['); }
+   void endArray() { close(']'); }
+
+   void add(const char* name, const resip::Data& value) { member(name); writeString(value); }
+   void add(const char* name, int value) { member(name); mBuffer += resip::Data(value); }
+   void add(const char* name, UInt32 value) { member(name); mBuffer += resip::Data(value); }
+   void addElement(const resip::Data& value) { element(); writeString(value); }
+
+   // Adds the encoded form of a header or uri as a JSON string
+   template<class T> void addEncoded(const char* name, const T& value)
+   {
+      member(name);
+      writeString(encode(value));
+   }
+
+   // Adds an array of the well formed headers in the list, if there are any
+   template<class T> void addEncodedArray(const char* name, const resip::ParserContainer<T>& headers)
+   {
+      bool opened = false;
+      for(typename resip::ParserContainer<T>::const_iterator it = headers.begin(); it != headers.end(); it++)
+      {
+         if(it->isWellFormed())
+         {
+            if(!opened)
+            {
+               startArray(name);
+               opened = true;
+            }
+            element();
+            writeString(encode(*it));
+         }
+      }
+      if(opened)
+      {
+         endArray();
+      }
+   }
+
+private:
+   template<class T> const resip::Data& encode(const T& value)
+   {
+      mScratch.clear();
+      {
+         resip::DataStream ds(mScratch);
+         ds << value;
+      }
+      return mScratch;
+   }
+
+   void open(char c)
+   {
+      mBuffer += c;
+      mDepth++;
+      mFirst = true;
+   }
+   void close(char c)
+   {
+      mDepth--;
+      if(!mFirst)
+      {
+         mBuffer += '\n';
+         indent();
+      }
+      mBuffer += c;
+      mFirst = false;
+   }
+   void element()
+   {
+      mBuffer.append(mFirst ? "\n" : ",\n", mFirst ? 1 : 2);
+      mFirst = false;
+      indent();
+   }
+   void member(const char* name)
+   {
+      element();
+      writeString(resip::Data(resip::Data::Share, name, (resip::Data::size_type)strlen(name)));
+      mBuffer.append(" : ", 3);
+   }
+   void indent()
+   {
+      for(unsigned int i = 0; i < mDepth; i++)
+      {
+         mBuffer += '\t';
+      }
+   }
+   void writeUnicode(int x)
+   {
+      static const char hex[] = "0123456789abcdef";
+      char escaped[6] = { '\\', 'u', hex[(x >> 12) & 0xf], hex[(x >> 8) & 0xf], hex[(x >> 4) & 0xf], hex[x & 0xf] };
+      mBuffer.append(escaped, sizeof(escaped));
+   }
+   void writeString(const resip::Data& value)
+   {
+      mBuffer += '"';
+      const unsigned char* it = (const unsigned char*)value.data();
+      const unsigned char* end = it + value.size();
+      for(; it != end; ++it)
+      {
+         if((*it & 0xe0) == 0xc0 && it + 1 != end && (it[1] & 0xc0) == 0x80)
+         {
+            // two byte UTF-8 sequence
+            writeUnicode(((it[0] & 0x1f) << 6) | (it[1] & 0x3f));
+            it++;
+            continue;
+         }
+         if((*it & 0xf0) == 0xe0 && it + 1 != end && (it[1] & 0xc0) == 0x80 &&
+            it + 2 != end && (it[2] & 0xc0) == 0x80)
+         {
+            // three byte UTF-8 sequence
+            writeUnicode(((it[0] & 0x0f) << 12) | ((it[1] & 0x3f) << 6) | (it[2] & 0x3f));
+            it += 2;
+            continue;
+         }
+         switch(*it)
+         {
+         case '"':  mBuffer.append("\\\"", 2); break;
+         case '\\': mBuffer.append("\\\\", 2); break;
+         case '\b': mBuffer.append("\\b", 2); break;
+         case '\f': mBuffer.append("\\f", 2); break;
+         case '\n': mBuffer.append("\\n", 2); break;
+         case '\r': mBuffer.append("\\r", 2); break;
+         case '\t': mBuffer.append("\\t", 2); break;
+         default:   mBuffer += (char)*it; break;
+         }
+      }
+      mBuffer += '"';
+   }
+
+   resip::Data& mBuffer;
+   resip::Data mScratch;
+   unsigned int mDepth;
+   bool mFirst;
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
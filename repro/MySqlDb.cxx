@@ -81,9 +81,10 @@ MySqlDb::MySqlDb(const resip::ConfigParse& config,
    mDBName(databaseName),
    mDBPort(port),
    mCustomUserAuthQuery(customUserAuthQuery),
-   mConn(0)
+   mConns(getPoolSize(), (MYSQL*)0),
+   mPreparedStatements(getPoolSize())
 { 
-   InfoLog( << "Using MySQL DB with server=" << server << ", user=" << user << ", dbName=" << databaseName << ", port=" << port);
+   InfoLog( << "Using MySQL DB with server=" << server << ", user=" << user << ", dbName=" << databaseName << ", port=" << port << ", connectionPoolSize=" << getPoolSize());
 
    for (int i=0;i<MaxTable;i++)
    {
@@ -97,7 +98,9 @@ MySqlDb::MySqlDb(const resip::ConfigParse& config,
    }
    else
    {
-      connectToDatabase();
+      // Open the first connection now so that isSane() reflects whether the
+      // database is reachable - the others are opened as load requires
+      connectToDatabase(0);
    }
 }
 
@@ -120,41 +123,58 @@ MySqlDb::initialize() const
 void
 MySqlDb::disconnectFromDatabase() const
 {
-   if(mConn)
+   for (int i=0;i<MaxTable;i++)
+   {
+      if (mResult[i])
+      {  
+         mysql_free_result(mResult[i]); 
+         mResult[i]=0;
+      }
+   }
+
+   for (unsigned int i = 0; i < mConns.size(); i++)
+   {
+      disconnectFromDatabase(i);
+   }
+   setConnected(false);
+}
+
+void
+MySqlDb::disconnectFromDatabase(unsigned int index) const
+{
+   // Note: results retrieved with mysql_store_result are independent of the
+   // connection, so mResult iterations survive a reconnect
+   if(mConns[index])
    {
-      for (int i=0;i<MaxTable;i++)
+      PreparedStatementMap& statements = mPreparedStatements[index];
+      for(PreparedStatementMap::iterator it = statements.begin(); it != statements.end(); it++)
       {
-         if (mResult[i])
-         {  
-            mysql_free_result(mResult[i]); 
-            mResult[i]=0;
-         }
+         mysql_stmt_close(it->second);
       }
-   
-      mysql_close(mConn);
-      mConn = 0;
-      setConnected(false);
+      statements.clear();
+
+      mysql_close(mConns[index]);
+      mConns[index] = 0;
    }
 }
 
 int 
-MySqlDb::connectToDatabase() const
+MySqlDb::connectToDatabase(unsigned int index) const
 {
    // Disconnect from database first (if required)
-   disconnectFromDatabase();
+   disconnectFromDatabase(index);
 
    // Now try to connect
-   resip_assert(mConn == 0);
-   resip_assert(isConnected() == false);
+   resip_assert(mConns[index] == 0);
 
-   mConn = mysql_init(0);
-   if(mConn == 0)
+   MYSQL* conn = mysql_init(0);
+   if(conn == 0)
    {
       ErrLog( << "MySQL init failed: insufficient memory.");
       return CR_OUT_OF_MEMORY;
    }
 
-   MYSQL* ret = mysql_real_connect(mConn,
+   MYSQL* ret = mysql_real_connect(conn,
                                    mDBServer.c_str(),   // hostname
                                    mDBUser.c_str(),     // user
                                    mDBPassword.c_str(), // password
@@ -165,15 +185,15 @@ MySqlDb::connectToDatabase() const
 
    if (ret == 0)
    { 
-      int rc = mysql_errno(mConn);
-      ErrLog( << "MySQL connect failed: error=" << rc << ": " << mysql_error(mConn));
-      mysql_close(mConn); 
-      mConn = 0;
+      int rc = mysql_errno(conn);
+      ErrLog( << "MySQL connect failed (connection " << index << "): error=" << rc << ": " << mysql_error(conn));
+      mysql_close(conn); 
       setConnected(false);
       return rc;
    }
    else
    {
+      mConns[index] = conn;
       setConnected(true);
       return 0;
    }
@@ -186,39 +206,41 @@ MySqlDb::query(const Data& queryCommand, MYSQL_RES** result) const
 
    initialize();
 
-   DebugLog( << "MySqlDb::query: executing query: " << queryCommand);
+   PooledConnection pooled(*this);
+   const unsigned int index = pooled.index();
 
-   Lock lock(mMutex);
-   if(mConn == 0 || !isConnected())
+   DebugLog( << "MySqlDb::query: executing query on connection " << index << ": " << queryCommand);
+
+   if(mConns[index] == 0)
    {
-      rc = connectToDatabase();
+      rc = connectToDatabase(index);
    }
    if(rc == 0)
    {
-      resip_assert(mConn!=0);
-      resip_assert(isConnected());
-      rc = mysql_query(mConn,queryCommand.c_str());
+      resip_assert(mConns[index]!=0);
+      rc = mysql_query(mConns[index],queryCommand.c_str());
       if(rc != 0)
       {
-         rc = mysql_errno(mConn);
+         rc = mysql_errno(mConns[index]);
          if(rc == CR_SERVER_GONE_ERROR ||
             rc == CR_SERVER_LOST)
          {
             // First failure is a connection error - try to re-connect and then try again
-            rc = connectToDatabase();
+            rc = connectToDatabase(index);
             if(rc == 0)
             {
                // OK - we reconnected - try query again
-               rc = mysql_query(mConn,queryCommand.c_str());
+               rc = mysql_query(mConns[index],queryCommand.c_str());
                if( rc != 0)
                {
-                  ErrLog( << "MySQL query failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
+                  rc = mysql_errno(mConns[index]);
+                  ErrLog( << "MySQL query failed: error=" << rc << ": " << mysql_error(mConns[index]));
                }
             }
          }
          else
          {
-            ErrLog( << "MySQL query failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
+            ErrLog( << "MySQL query failed: error=" << rc << ": " << mysql_error(mConns[index]));
          }
       }
    }
@@ -226,13 +248,13 @@ MySqlDb::query(const Data& queryCommand, MYSQL_RES** result) const
    // Now store result - if pointer to result pointer was supplied and no errors
    if(rc == 0 && result)
    {
-      *result = mysql_store_result(mConn);
+      *result = mysql_store_result(mConns[index]);
       if(*result == 0)
       {
-         rc = mysql_errno(mConn);
+         rc = mysql_errno(mConns[index]);
          if(rc != 0)
          {
-            ErrLog( << "MySQL store result failed: error=" << rc << ": " << mysql_error(mConn));
+            ErrLog( << "MySQL store result failed: error=" << rc << ": " << mysql_error(mConns[index]));
          }
       }
    }
@@ -250,6 +272,143 @@ MySqlDb::query(const Data& queryCommand) const
    return query(queryCommand, 0);
 }
 
+int
+MySqlDb::executeStatement(unsigned int index, const Data& statement, const std::vector<Data>& params, std::vector<Data>* rows) const
+{
+   MYSQL_STMT* stmt = 0;
+   PreparedStatementMap& statements = mPreparedStatements[index];
+   PreparedStatementMap::iterator it = statements.find(statement);
+   if(it == statements.end())
+   {
+      stmt = mysql_stmt_init(mConns[index]);
+      if(stmt == 0)
+      {
+         ErrLog( << "MySQL statement init failed: insufficient memory.");
+         return CR_OUT_OF_MEMORY;
+      }
+      if(mysql_stmt_prepare(stmt, statement.data(), statement.size()) != 0)
+      {
+         int rc = mysql_stmt_errno(stmt);
+         ErrLog( << "MySQL prepare failed: error=" << rc << ": " << mysql_stmt_error(stmt));
+         mysql_stmt_close(stmt);
+         return rc;
+      }
+      statements[statement] = stmt;
+   }
+   else
+   {
+      stmt = it->second;
+   }
+
+   std::vector<MYSQL_BIND> bind(params.size());
+   std::vector<unsigned long> lengths(params.size());
+   for(size_t i = 0; i < params.size(); i++)
+   {
+      memset(&bind[i], 0, sizeof(MYSQL_BIND));
+      lengths[i] = params[i].size();
+      bind[i].buffer_type = MYSQL_TYPE_STRING;
+      bind[i].buffer = (void*)params[i].data();
+      bind[i].buffer_length = lengths[i];
+      bind[i].length = &lengths[i];
+   }
+   if((!bind.empty() && mysql_stmt_bind_param(stmt, &bind[0]) != 0) ||
+      mysql_stmt_execute(stmt) != 0)
+   {
+      int rc = mysql_stmt_errno(stmt);
+      ErrLog( << "MySQL statement failed: error=" << rc << ": " << mysql_stmt_error(stmt));
+      return rc;
+   }
+
+   if(rows)
+   {
+      // The length of a value is only known once its row is fetched, so
+      // fetch into an empty buffer then read the column at its real size
+      unsigned long length = 0;
+      MYSQL_BIND result;
+      memset(&result, 0, sizeof(MYSQL_BIND));
+      result.buffer_type = MYSQL_TYPE_STRING;
+      result.length = &length;
+      if(mysql_stmt_bind_result(stmt, &result) != 0)
+      {
+         int rc = mysql_stmt_errno(stmt);
+         ErrLog( << "MySQL bind result failed: error=" << rc << ": " << mysql_stmt_error(stmt));
+         mysql_stmt_free_result(stmt);
+         return rc;
+      }
+      int status;
+      while((status = mysql_stmt_fetch(stmt)) == 0 || status == MYSQL_DATA_TRUNCATED)
+      {
+         Data value;
+         if(length > 0)
+         {
+            result.buffer = value.getBuf(length);
+            result.buffer_length = length;
+            if(mysql_stmt_fetch_column(stmt, &result, 0, 0) != 0)
+            {
+               int rc = mysql_stmt_errno(stmt);
+               ErrLog( << "MySQL fetch column failed: error=" << rc << ": " << mysql_stmt_error(stmt));
+               mysql_stmt_free_result(stmt);
+               return rc;
+            }
+            result.buffer = 0;
+            result.buffer_length = 0;
+         }
+         rows->push_back(value);
+      }
+      mysql_stmt_free_result(stmt);
+      if(status != MYSQL_NO_DATA)
+      {
+         int rc = mysql_stmt_errno(stmt);
+         ErrLog( << "MySQL fetch failed: error=" << rc << ": " << mysql_stmt_error(stmt));
+         return rc;
+      }
+   }
+   return 0;
+}
+
+int
+MySqlDb::preparedQuery(const Data& statement, const std::vector<Data>& params, std::vector<Data>* rows) const
+{
+   int rc = 0;
+
+   initialize();
+
+   PooledConnection pooled(*this);
+   const unsigned int index = pooled.index();
+
+   DebugLog( << "MySqlDb::preparedQuery: executing statement on connection " << index << ": " << statement);
+
+   if(mConns[index] == 0)
+   {
+      rc = connectToDatabase(index);
+   }
+   if(rc == 0)
+   {
+      rc = executeStatement(index, statement, params, rows);
+      if(rc == CR_SERVER_GONE_ERROR ||
+         rc == CR_SERVER_LOST)
+      {
+         // Connection error - re-connect (which discards the prepared
+         // statements) and then try again
+         rc = connectToDatabase(index);
+         if(rc == 0)
+         {
+            if(rows)
+            {
+               rows->clear();
+            }
+            rc = executeStatement(index, statement, params, rows);
+         }
+      }
+   }
+
+   if(rc != 0)
+   {
+      ErrLog( << " SQL Command was: " << statement) ;
+   }
+   return rc;
+}
+
 int
 MySqlDb::singleResultQuery(const Data& queryCommand, std::vector<Data>& fields) const
 {
@@ -274,15 +433,7 @@ MySqlDb::singleResultQuery(const Data& queryCommand, std::vector<Data>& fields)
       }
       else
       {
-         rc = mysql_errno(mConn);
-         if(rc != 0)
-         {
-            ErrLog( << "MySQL fetch row failed: error=" << rc << ": " << mysql_error(mConn));
-         }
-         else
-         {
-            DebugLog(<<"singleResultQuery: no rows returned by query");
-         }
+         DebugLog(<<"singleResultQuery: no rows returned by query");
       }
       mysql_free_result(result);
    }
@@ -292,7 +443,21 @@ MySqlDb::singleResultQuery(const Data& queryCommand, std::vector<Data>& fields)
 resip::Data& 
 MySqlDb::escapeString(const resip::Data& str, resip::Data& escapedStr) const
 {
-   escapedStr.truncate2(mysql_real_escape_string(mConn, (char*)escapedStr.getBuf(str.size()*2+1), str.c_str(), str.size()));
+   // Escaping depends on the connection's character set, so it is done on a
+   // pooled connection like a query
+   initialize();
+   PooledConnection pooled(*this, false /* isQuery */);
+   MYSQL* conn = mConns[pooled.index()];
+   if(conn == 0 && connectToDatabase(pooled.index()) == 0)
+   {
+      conn = mConns[pooled.index()];
+   }
+   if(conn == 0)
+   {
+      escapedStr.truncate2(mysql_escape_string((char*)escapedStr.getBuf(str.size()*2+1), str.c_str(), str.size()));
+      return escapedStr;
+   }
+   escapedStr.truncate2(mysql_real_escape_string(conn, (char*)escapedStr.getBuf(str.size()*2+1), str.c_str(), str.size()));
    return escapedStr;
 }
 
@@ -347,7 +512,7 @@ MySqlDb::getUser( const AbstractDb::Key& key ) const
    
    if (result==0)
    {
-      ErrLog( << "MySQL store result failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
+      ErrLog( << "MySQL store result failed: query returned no result set");
       return ret;
    }
 
@@ -374,35 +539,47 @@ MySqlDb::getUser( const AbstractDb::Key& key ) const
 resip::Data 
 MySqlDb::getUserAuthInfo(  const AbstractDb::Key& key ) const
 { 
-   std::vector<Data> ret;
+   Data user;
+   Data domain;
+   UserStore::getUserAndDomainFromKey(key, user, domain);
 
-   Data command;
+   // Note: domain is empty when querying for HTTP admin user - for this special user, 
+   // we will only check the repro db, by not adding the UNION statement below
+   if(!mCustomUserAuthQuery.empty() && !domain.empty())  
    {
-      DataStream ds(command);
-      Data user;
-      Data domain;
-      UserStore::getUserAndDomainFromKey(key, user, domain);
-      ds << "SELECT passwordHash FROM " << tableName(UserTable) << " WHERE user = '" << user << "' AND domain = '" << domain << "' ";
-   
-      // Note: domain is empty when querying for HTTP admin user - for this special user, 
-      // we will only check the repro db, by not adding the UNION statement below
-      if(!mCustomUserAuthQuery.empty() && !domain.empty())  
+      std::vector<Data> ret;
+      Data command;
       {
+         DataStream ds(command);
+         ds << "SELECT passwordHash FROM " << tableName(UserTable) << " WHERE user = '" << user << "' AND domain = '" << domain << "' ";
          ds << " UNION " << mCustomUserAuthQuery;
          ds.flush();
          command.replace("$user", user);
          command.replace("$domain", domain);
       }
+
+      if(singleResultQuery(command, ret) != 0 || ret.size() == 0)
+      {
+         return Data::Empty;
+      }
+      DebugLog( << "Auth password is " << ret.front());
+      return ret.front();
    }
 
-   if(singleResultQuery(command, ret) != 0 || ret.size() == 0)
+   // This is run for every digest challenge response, so it is prepared
+   Data statement("SELECT passwordHash FROM " + tableName(UserTable) + " WHERE user = ? AND domain = ?");
+   std::vector<Data> params;
+   params.push_back(user);
+   params.push_back(domain);
+   std::vector<Data> rows;
+   if(preparedQuery(statement, params, &rows) != 0 || rows.empty())
    {
       return Data::Empty;
    }
    
-   DebugLog( << "Auth password is " << ret.front());
+   DebugLog( << "Auth password is " << rows.front());
    
-   return ret.front();
+   return rows.front();
 }
 
 
@@ -429,7 +606,7 @@ MySqlDb::firstUserKey()
 
    if(mResult[UserTable] == 0)
    {
-      ErrLog( << "MySQL store result failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
+      ErrLog( << "MySQL store result failed: query returned no result set");
       return Data::Empty;
    }
    
@@ -498,7 +675,7 @@ MySqlDb::getTlsPeerIdentity( const AbstractDb::Key& key ) const
 
    if (result==0)
    {
-      ErrLog( << "MySQL store result failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
+      ErrLog( << "MySQL store result failed: query returned no result set");
       return ret;
    }
 
@@ -539,7 +716,7 @@ MySqlDb::firstTlsPeerIdentityKey()
 
    if(mResult[TlsPeerIdentityTable] == 0)
    {
-      ErrLog( << "MySQL store result failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
+      ErrLog( << "MySQL store result failed: query returned no result set");
       return Data::Empty;
    }
 
@@ -574,33 +751,25 @@ MySqlDb::dbWriteRecord(const Table table,
                        const resip::Data& pKey, 
                        const resip::Data& pData)
 {
-   Data command;
+   std::vector<Data> params;
+   params.push_back(pKey);
 
+   Data statement;
    // Check if there is a secondary key or not and get it's value
    char* secondaryKey;
    unsigned int secondaryKeyLen;
-   Data escapedKey;
    if(AbstractDb::getSecondaryKey(table, pKey, pData, (void**)&secondaryKey, &secondaryKeyLen) == 0)
    {
-      Data escapedSKey;
-      Data sKey(Data::Share, secondaryKey, secondaryKeyLen);
-      DataStream ds(command);
-      ds << "REPLACE INTO " << tableName(table)
-         << " SET attr='" << escapeString(pKey, escapedKey)
-         << "', attr2='" << escapeString(sKey, escapedSKey)
-         << "', value='"  << pData.base64encode()
-         << "'";
+      params.push_back(Data(secondaryKey, secondaryKeyLen));
+      statement = "REPLACE INTO " + tableName(table) + " SET attr=?, attr2=?, value=?";
    }
    else
    {
-      DataStream ds(command);
-      ds << "REPLACE INTO " << tableName(table) 
-         << " SET attr='" << escapeString(pKey, escapedKey)
-         << "', value='"  << pData.base64encode()
-         << "'";
+      statement = "REPLACE INTO " + tableName(table) + " SET attr=?, value=?";
    }
+   params.push_back(pData.base64encode());
 
-   return query(command, 0) == 0;
+   return preparedQuery(statement, params, 0) == 0;
 }
 
 bool 
@@ -608,38 +777,17 @@ MySqlDb::dbReadRecord(const Table table,
                       const resip::Data& pKey, 
                       resip::Data& pData) const
 { 
-   Data command;
-   Data escapedKey;
-   {
-      DataStream ds(command);
-      ds << "SELECT value FROM " << tableName(table) 
-         << " WHERE attr='" << escapeString(pKey, escapedKey)
-         << "'";
-   }
+   Data statement("SELECT value FROM " + tableName(table) + " WHERE attr=?");
+   std::vector<Data> params(1, pKey);
+   std::vector<Data> rows;
 
-   MYSQL_RES* result = 0;
-   if(query(command, &result) != 0)
+   if(preparedQuery(statement, params, &rows) != 0 || rows.empty())
    {
       return false;
    }
 
-   if (result == 0)
-   {
-      ErrLog( << "MySQL store result failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
-      return false;
-   }
-   else
-   {
-      bool success = false;
-      MYSQL_ROW row=mysql_fetch_row(result);
-      if(row)
-      {
-         pData = Data(Data::Share, row[0], (Data::size_type)strlen(row[0])).base64decode();
-         success = true;
-      }
-      mysql_free_result(result);
-      return success;
-   }
+   pData = rows.front().base64decode();
+   return true;
 }
 
 
@@ -668,7 +816,7 @@ MySqlDb::dbNextKey(const Table table, bool first)
 
       if (mResult[table] == 0)
       {
-         ErrLog( << "MySQL store result failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
+         ErrLog( << "MySQL store result failed: query returned no result set");
          return Data::Empty;
       }
    }
@@ -732,7 +880,7 @@ MySqlDb::dbNextRecord(const Table table,
 
       if (mResult[table] == 0)
       {
-         ErrLog( << "MySQL store result failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
+         ErrLog( << "MySQL store result failed: query returned no result set");
          return false;
       }
    }
@@ -758,12 +906,17 @@ MySqlDb::dbNextRecord(const Table table,
 bool 
 MySqlDb::dbBeginTransaction(const Table table)
 {
+   setInTransaction(true);
    Data command("SET SESSION TRANSACTION ISOLATION LEVEL REPEATABLE READ");
    if(query(command, 0) == 0)
    {
       command = "START TRANSACTION";
-      return query(command, 0) == 0;
+      if(query(command, 0) == 0)
+      {
+         return true;
+      }
    }
+   setInTransaction(false);
    return false;
 }
 
@@ -7,6 +7,9 @@
 #include <mysql/mysql.h>
 #endif
 
+#include <map>
+#include <vector>
+
 #include "rutil/Data.hxx"
 #include "repro/SqlDb.hxx"
 
@@ -64,9 +67,16 @@ class MySqlDb: public SqlDb
 
       void initialize() const;
       void disconnectFromDatabase() const;
-      int connectToDatabase() const;
+      void disconnectFromDatabase(unsigned int index) const;
+      int connectToDatabase(unsigned int index) const;
       int query(const resip::Data& queryCommand, MYSQL_RES** result) const;
       virtual int query(const resip::Data& queryCommand) const;
+      // Runs statement as a prepared statement with the supplied parameter
+      // values, returning the first column of each result row in rows (if
+      // supplied).  The statement is prepared the first time it is used on
+      // each pooled connection and reused after that.
+      int preparedQuery(const resip::Data& statement, const std::vector<resip::Data>& params, std::vector<resip::Data>* rows) const;
+      int executeStatement(unsigned int index, const resip::Data& statement, const std::vector<resip::Data>& params, std::vector<resip::Data>* rows) const;
       resip::Data& escapeString(const resip::Data& str, resip::Data& escapedStr) const;
 
       resip::Data mDBServer;
@@ -76,7 +86,11 @@ class MySqlDb: public SqlDb
       unsigned int mDBPort;
       resip::Data mCustomUserAuthQuery;
 
-      mutable MYSQL* mConn;
+      // One connection per pool slot, and the statements prepared on it
+      // keyed by statement text
+      typedef std::map<resip::Data, MYSQL_STMT*> PreparedStatementMap;
+      mutable std::vector<MYSQL*> mConns;
+      mutable std::vector<PreparedStatementMap> mPreparedStatements;
       mutable MYSQL_RES* mResult[MaxTable];
 
       void userWhereClauseToDataStream(const Key& key, resip::DataStream& ds) const;
@@ -280,6 +280,59 @@ PersistentMessageEnqueue::push(const resip::Data& data)
    return false;
 }
 
+bool 
+PersistentMessageEnqueue::push(const std::vector<resip::Data>& records)
+{
+#ifndef DISABLE_BERKELEYDB_USE
+   int res;
+
+   try 
+   {
+      Transaction transaction;
+      transaction.init(this);
+
+      std::vector<resip::Data>::const_iterator it = records.begin();
+      for(; it != records.end(); it++)
+      {
+         db_recno_t recno; 
+         recno = 0;
+         Dbt val((void*)it->data(), it->size());
+         Dbt key((void*)&recno, sizeof(recno));
+
+         key.set_ulen(sizeof(recno));
+         key.set_flags(DB_DBT_USERMEM);
+
+         res = mDb->put(transaction.mDbTxn, &key, &val, DB_APPEND);
+         if(res != 0)
+         {
+            // Transaction is aborted when it goes out of scope
+            WarningLog( << "PersistentMessageEnqueue::push - put failed: " << db_strerror(res));
+            return false;
+         }
+      }
+      transaction.commit();
+      return true;
+   } 
+   catch(DbException& e)
+   {
+      if(e.get_errno() == DB_RUNRECOVERY)
+      {
+         mRecoveryNeeded = true;
+      }
+      WarningLog( << "PersistentMessageEnqueue::push - DBException: " << e.what());
+   } 
+   catch(std::exception& e)
+   {
+      WarningLog( << "PersistentMessageEnqueue::push - std::exception: " << e.what());
+   } 
+   catch(...) 
+   {
+      WarningLog( << "PersistentMessageEnqueue::push - unknown exception");
+   }
+#endif
+   return false;
+}
+
 // returns true for success, false for failure - can return true and 0 records if none available
 // Note:  if autoCommit is used then it is safe to allow multiple consumers
 bool 
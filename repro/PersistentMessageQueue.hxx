@@ -151,6 +151,8 @@ public:
    // Note:  this has a potential to block if the a consumer crashes and leaves a lock open on the database (deadlock)
    // typically restarting the consumer will "recover" the "dead" lock and allow this call to unblock
    bool push(const resip::Data& data);
+   // Pushes all records within a single transaction - either all records are queued or none are
+   bool push(const std::vector<resip::Data>& records);
 };  
 
 class PersistentMessageDequeue : public PersistentMessageQueue 
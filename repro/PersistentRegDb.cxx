@@ -0,0 +1,560 @@
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <map>
+
+#include "repro/PersistentRegDb.hxx"
+#include "repro/RegSyncProtocol.hxx"
+#include "rutil/Lock.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/ResipAssert.h"
+#include "rutil/Timer.hxx"
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::REPRO
+
+using namespace repro;
+using namespace resip;
+using namespace std;
+
+namespace
+{
+// File header: magic, version (network order), reserved
+const char LogMagic[8] = { 'R', 'E', 'P', 'R', 'O', 'R', 'E', 'G' };
+const UInt32 LogVersion = 1;
+const size_t LogHeaderSize = 16;
+
+// Each record is a checksum (network order) followed by one RegSync frame
+const size_t RecordHeaderSize = 4;
+
+const size_t InitialLogCapacity = 1024*1024;
+const size_t MinCompactSize = 1024*1024;
+const Data::size_type MaxBatchSize = 64*1024;
+
+UInt32
+checksum(const char* data, size_t size)
+{
+   return (UInt32)Data::rawHash((const unsigned char*)data, size);
+}
+
+UInt32
+readUInt32(const char* data)
+{
+   const unsigned char* p = (const unsigned char*)data;
+   return ((UInt32)p[0] << 24) | ((UInt32)p[1] << 16) | ((UInt32)p[2] << 8) | (UInt32)p[3];
+}
+
+void
+writeUInt32(char* data, UInt32 value)
+{
+   data[0] = (char)(value >> 24);
+   data[1] = (char)(value >> 16);
+   data[2] = (char)(value >> 8);
+   data[3] = (char)value;
+}
+
+void
+appendHeader(Data& buffer)
+{
+   char header[LogHeaderSize];
+   memset(header, 0, sizeof(header));
+   memcpy(header, LogMagic, sizeof(LogMagic));
+   writeUInt32(header + sizeof(LogMagic), LogVersion);
+   buffer.append(header, sizeof(header));
+}
+
+// Appends one checksummed record holding the bindings of aor.  Returns false,
+// and appends nothing, if there are no bindings to store and emptyRecord is
+// not set.
+bool
+appendRecord(Data& buffer, const Uri& aor, const ContactList& contacts, UInt64 now, bool emptyRecord)
+{
+   Data::size_type recordStart = buffer.size();
+   buffer.append("\0\0\0\0", RecordHeaderSize);
+   Data::size_type frameStart = RegSyncProtocol::startFrame(buffer, now);
+   if(!RegSyncProtocol::encodeAor(buffer, 0, aor, contacts, now, emptyRecord))
+   {
+      buffer.truncate2(recordStart);
+      return false;
+   }
+   RegSyncProtocol::endFrame(buffer, frameStart);
+   writeUInt32(const_cast<char*>(buffer.data()) + recordStart,
+               checksum(buffer.data() + frameStart, buffer.size() - frameStart));
+   return true;
+}
+}
+
+MappedLog::MappedLog() :
+   mFd(-1),
+   mMap(0),
+   mSize(0),
+   mCapacity(0),
+   mSynced(0)
+{
+}
+
+MappedLog::~MappedLog()
+{
+   close();
+}
+
+bool
+MappedLog::open(const Data& path)
+{
+   close();
+   mFd = ::open(path.c_str(), O_RDWR | O_CREAT, 0600);
+   if(mFd < 0)
+   {
+      ErrLog(<< "Unable to open " << path << ": " << strerror(errno));
+      return false;
+   }
+   struct stat st;
+   if(fstat(mFd, &st) != 0)
+   {
+      ErrLog(<< "Unable to stat " << path << ": " << strerror(errno));
+      close();
+      return false;
+   }
+   mSize = (size_t)st.st_size;
+   mSynced = mSize;
+   mCapacity = mSize;
+   if(mCapacity < InitialLogCapacity && ftruncate(mFd, InitialLogCapacity) == 0)
+   {
+      mCapacity = InitialLogCapacity;
+   }
+   void* map = mmap(0, mCapacity, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+   if(map == MAP_FAILED)
+   {
+      ErrLog(<< "Unable to map " << path << ": " << strerror(errno));
+      close();
+      return false;
+   }
+   mMap = (char*)map;
+   return true;
+}
+
+void
+MappedLog::close()
+{
+   if(mMap)
+   {
+      munmap(mMap, mCapacity);
+      mMap = 0;
+   }
+   if(mFd >= 0)
+   {
+      ::close(mFd);
+      mFd = -1;
+   }
+   mSize = mCapacity = mSynced = 0;
+}
+
+void
+MappedLog::truncate(size_t size)
+{
+   resip_assert(size <= mSize);
+   mSize = size;
+   if(mSynced > size)
+   {
+      mSynced = size;
+   }
+}
+
+bool
+MappedLog::grow(size_t needed)
+{
+   size_t capacity = mCapacity ? mCapacity : InitialLogCapacity;
+   while(capacity < needed)
+   {
+      capacity *= 2;
+   }
+   // Flush before unmapping so nothing appended is lost if the remap fails
+   if(!sync())
+   {
+      return false;
+   }
+   if(ftruncate(mFd, capacity) != 0)
+   {
+      ErrLog(<< "Unable to extend log to " << capacity << " bytes: " << strerror(errno));
+      return false;
+   }
+   void* map = mmap(0, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+   if(map == MAP_FAILED)
+   {
+      ErrLog(<< "Unable to map " << capacity << " bytes of log: " << strerror(errno));
+      return false;
+   }
+   munmap(mMap, mCapacity);
+   mMap = (char*)map;
+   mCapacity = capacity;
+   // The new file size is metadata that msync does not cover
+   fsync(mFd);
+   return true;
+}
+
+bool
+MappedLog::append(const char* data, size_t len)
+{
+   if(!mMap || (mSize + len > mCapacity && !grow(mSize + len)))
+   {
+      return false;
+   }
+   memcpy(mMap + mSize, data, len);
+   mSize += len;
+   return true;
+}
+
+bool
+MappedLog::sync()
+{
+   if(mSynced == mSize)
+   {
+      return true;
+   }
+   static const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+   size_t start = mSynced - (mSynced % pageSize);
+   if(msync(mMap + start, mSize - start, MS_SYNC) != 0)
+   {
+      ErrLog(<< "Unable to sync log: " << strerror(errno));
+      return false;
+   }
+   mSynced = mSize;
+   return true;
+}
+
+void
+MappedLog::swap(MappedLog& other)
+{
+   std::swap(mFd, other.mFd);
+   std::swap(mMap, other.mMap);
+   std::swap(mSize, other.mSize);
+   std::swap(mCapacity, other.mCapacity);
+   std::swap(mSynced, other.mSynced);
+}
+
+PersistentRegDb::PersistentRegDb(const Data& path,
+                                 unsigned int removeLingerSecs,
+                                 unsigned int commitIntervalMs) :
+   InMemorySyncRegDb(removeLingerSecs),
+   InMemorySyncRegDbHandler(InMemorySyncRegDbHandler::AllChanges),
+   mPath(path),
+   mCommitIntervalMs(commitIntervalMs),
+   mCompactedSize(0),
+   mThread(*this)
+{
+   if(openLog())
+   {
+      // Register for changes only once the restored bindings are in place,
+      // so they are not written straight back to the log
+      addHandler(this);
+      mThread.run();
+   }
+}
+
+PersistentRegDb::~PersistentRegDb()
+{
+   if(mLog.isOpen())
+   {
+      mThread.shutdown();
+      mThread.join();
+      removeHandler(this);
+      commit();
+   }
+}
+
+bool
+PersistentRegDb::openLog()
+{
+   if(!mLog.open(mPath))
+   {
+      ErrLog(<< "Registrations will not be persisted");
+      return false;
+   }
+   if(mLog.size() == 0 || readUInt32(mLog.data()) == 0)
+   {
+      // New file
+      Data header;
+      appendHeader(header);
+      mLog.truncate(0);
+      mCompactedSize = LogHeaderSize;
+      return mLog.append(header.data(), header.size()) && mLog.sync();
+   }
+   if(mLog.size() < LogHeaderSize ||
+      memcmp(mLog.data(), LogMagic, sizeof(LogMagic)) != 0 ||
+      readUInt32(mLog.data() + sizeof(LogMagic)) != LogVersion)
+   {
+      ErrLog(<< mPath << " is not a registration log, registrations will not be persisted");
+      mLog.close();
+      return false;
+   }
+   if(!restore())
+   {
+      // The tail of the log is unreadable - rewrite it from what was restored
+      // so new records are not appended in front of the garbage
+      compact();
+   }
+   return true;
+}
+
+bool
+PersistentRegDb::restore()
+{
+   UInt64 startMs = Timer::getTimeMs();
+   typedef std::map<Uri, ContactList> AorMap;
+   AorMap aors;
+   unsigned int numRecords = 0;
+   const char* begin = mLog.data();
+   const char* end = begin + mLog.size();
+   const char* pos = begin + LogHeaderSize;
+   bool clean = false;
+   while(true)
+   {
+      size_t remaining = end - pos;
+      if(remaining < RecordHeaderSize + 1 || (unsigned char)pos[RecordHeaderSize] != RegSyncProtocol::FrameMarker)
+      {
+         // End of the records - anything other than the zeros past the end of
+         // the data means the last record was torn
+         clean = true;
+         for(size_t i = 0; i < remaining && i < RecordHeaderSize + RegSyncProtocol::FrameHeaderSize; i++)
+         {
+            clean = clean && pos[i] == 0;
+         }
+         break;
+      }
+      try
+      {
+         const char* frame = pos + RecordHeaderSize;
+         unsigned int frameSize = RegSyncProtocol::getFrameSize(frame, (unsigned int)resipMin(remaining - RecordHeaderSize, (size_t)RegSyncProtocol::MaxFrameSize + RegSyncProtocol::FrameHeaderSize));
+         if(frameSize == 0 || checksum(frame, frameSize) != readUInt32(pos))
+         {
+            break;
+         }
+         // Decode into a scratch map first, so a bad record leaves nothing behind
+         AorMap records;
+         RegSyncDecoder decoder(frame + RegSyncProtocol::FrameHeaderSize, frameSize - RegSyncProtocol::FrameHeaderSize);
+         decoder.useServerClock();
+         while(!decoder.eof())
+         {
+            if(decoder.getRecordType() != RegSyncProtocol::AorRecord)
+            {
+               throw RegSyncProtocol::Exception("Unexpected record type", __FILE__, __LINE__);
+            }
+            Uri aor;
+            ContactList contacts;
+            decoder.decodeAor(aor, contacts);
+            records[aor].swap(contacts);
+         }
+         for(AorMap::iterator it = records.begin(); it != records.end(); it++)
+         {
+            aors[it->first].swap(it->second);
+         }
+         numRecords++;
+         pos = frame + frameSize;
+      }
+      catch(BaseException& e)
+      {
+         WarningLog(<< "Invalid record at offset " << (pos - begin) << " of " << mPath << ": " << e);
+         break;
+      }
+   }
+   mLog.truncate(pos - begin);
+   if(!clean)
+   {
+      WarningLog(<< "Discarding the incomplete end of " << mPath << " after offset " << (pos - begin));
+   }
+
+   UInt64 now = Timer::getTimeSecs();
+   unsigned int numAors = 0;
+   unsigned int numContacts = 0;
+   for(AorMap::iterator it = aors.begin(); it != aors.end(); it++)
+   {
+      ContactList& contacts = it->second;
+      for(ContactList::iterator cit = contacts.begin(); cit != contacts.end();)
+      {
+         if(cit->mRegExpires <= now)
+         {
+            cit = contacts.erase(cit);
+         }
+         else
+         {
+            // These were ours before the restart, whichever way they were learned
+            cit->mSyncContact = false;
+            cit++;
+         }
+      }
+      if(!contacts.empty())
+      {
+         addAor(it->first, contacts);
+         numAors++;
+         numContacts += (unsigned int)contacts.size();
+      }
+   }
+   mCompactedSize = mLog.size();
+
+   InfoLog(<< "Restored " << numAors << " AORs with " << numContacts << " bindings from "
+           << numRecords << " records in " << mPath << " in " << (Timer::getTimeMs() - startMs) << "ms");
+   return clean;
+}
+
+void
+PersistentRegDb::onAorModified(const Uri& aor, const ContactList& contacts)
+{
+   // Called with the database locked, on the REGISTER path - just note the AOR
+   Lock lock(mDirtyMutex);
+   mDirty.insert(aor);
+}
+
+void
+PersistentRegDb::commit()
+{
+   Lock commitLock(mCommitMutex);
+   UriSet dirty;
+   {
+      Lock lock(mDirtyMutex);
+      dirty.swap(mDirty);
+   }
+   if(dirty.empty() || !mLog.isOpen())
+   {
+      return;
+   }
+
+   UInt64 now = Timer::getTimeSecs();
+   Data buffer;
+   ContactList contacts;
+   bool ok = true;
+   for(UriSet::iterator it = dirty.begin(); it != dirty.end() && ok; it++)
+   {
+      getContactsFull(*it, contacts);
+      appendRecord(buffer, *it, contacts, now, true /* emptyRecord */);
+      if(buffer.size() >= MaxBatchSize)
+      {
+         ok = mLog.append(buffer.data(), buffer.size());
+         buffer.clear();
+      }
+   }
+   ok = ok && mLog.append(buffer.data(), buffer.size()) && mLog.sync();
+   if(!ok)
+   {
+      ErrLog(<< "Unable to write " << dirty.size() << " changed registrations to " << mPath);
+      return;
+   }
+   DebugLog(<< "Wrote " << dirty.size() << " changed registrations to " << mPath);
+
+   if(mLog.size() > resipMax(MinCompactSize, 2 * mCompactedSize))
+   {
+      compact();
+   }
+}
+
+bool
+PersistentRegDb::compact()
+{
+   UInt64 startMs = Timer::getTimeMs();
+   Data tmpPath(mPath + ".compact");
+   unlink(tmpPath.c_str());
+   MappedLog log;
+   if(!log.open(tmpPath))
+   {
+      return false;
+   }
+   log.truncate(0);
+
+   UInt64 now = Timer::getTimeSecs();
+   Data buffer;
+   appendHeader(buffer);
+   UriList aors;
+   getAors(aors);
+   ContactList contacts;
+   bool ok = true;
+   for(UriList::iterator it = aors.begin(); it != aors.end() && ok; it++)
+   {
+      getContactsFull(*it, contacts);
+      appendRecord(buffer, *it, contacts, now, false /* emptyRecord */);
+      if(buffer.size() >= MaxBatchSize)
+      {
+         ok = log.append(buffer.data(), buffer.size());
+         buffer.clear();
+      }
+   }
+   ok = ok && log.append(buffer.data(), buffer.size()) && log.sync();
+   if(!ok || rename(tmpPath.c_str(), mPath.c_str()) != 0)
+   {
+      ErrLog(<< "Unable to compact " << mPath);
+      unlink(tmpPath.c_str());
+      return false;
+   }
+   size_t oldSize = mLog.size();
+   mLog.swap(log);
+   mCompactedSize = mLog.size();
+   InfoLog(<< "Compacted " << mPath << " from " << oldSize << " to " << mCompactedSize
+           << " bytes in " << (Timer::getTimeMs() - startMs) << "ms");
+   return true;
+}
+
+void
+PersistentRegDb::CommitThread::thread()
+{
+   while(!isShutdown())
+   {
+      waitForShutdown(mDb.mCommitIntervalMs);
+      mDb.commit();
+   }
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,167 @@
+#if !defined(RESIP_PERSISTENTREGDB_HXX)
+#define RESIP_PERSISTENTREGDB_HXX
+
+#include <set>
+
+#include "resip/dum/InMemorySyncRegDb.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Mutex.hxx"
+#include "rutil/ThreadIf.hxx"
+
+namespace repro
+{
+
+/**
+  An append-only file, written through a shared memory mapping.  The file
+  is extended in large steps, so the space past the last record reads as
+  zeros.  Not thread safe.
+*/
+class MappedLog
+{
+public:
+   MappedLog();
+   ~MappedLog();
+
+   /// Opens (creating if needed) and maps the file.  size() is the whole
+   /// file until the caller has found the end of the data and called
+   /// truncate().
+   bool open(const resip::Data& path);
+   void close();
+   bool isOpen() const { return mMap != 0; }
+
+   const char* data() const { return mMap; }
+   size_t size() const { return mSize; }
+   void truncate(size_t size);
+
+   bool append(const char* data, size_t len);
+   /// Writes everything appended since the last sync to disk
+   bool sync();
+
+   void swap(MappedLog& other);
+
+private:
+   MappedLog(const MappedLog&);
+   MappedLog& operator=(const MappedLog&);
+
+   bool grow(size_t needed);
+
+   int mFd;
+   char* mMap;
+   size_t mSize;
+   size_t mCapacity;
+   size_t mSynced;
+};
+
+/**
+  Registration database that survives a restart.  Bindings are kept in
+  memory exactly as InMemorySyncRegDb does (so registration sync and the
+  snapshot lookups keep working), and every change is also recorded in a
+  log file that is read back by the constructor.
+
+  Nothing is written on the REGISTER path: a change only marks the AOR as
+  dirty.  A background thread wakes up every commit interval, appends one
+  record per dirty AOR holding its current bindings, and syncs the file
+  once for the whole batch.  A crash can therefore lose at most the last
+  interval of changes, which clients recover from on their next refresh.
+
+  Records use the RegSync binary encoding (see RegSyncProtocol) preceded by
+  a checksum; a record torn by a crash ends the replay.  The last record
+  for an AOR wins, and an empty record removes it.  When the log has grown
+  to twice its size after the last compaction, it is rewritten with one
+  record per registered AOR and renamed over the old one.
+*/
+class PersistentRegDb : public resip::InMemorySyncRegDb,
+                        public resip::InMemorySyncRegDbHandler
+{
+public:
+   PersistentRegDb(const resip::Data& path,
+                   unsigned int removeLingerSecs = 0,
+                   unsigned int commitIntervalMs = 200);
+   virtual ~PersistentRegDb();
+
+   /// Writes and syncs all pending changes now
+   void commit();
+
+   // InMemorySyncRegDbHandler
+   virtual void onAorModified(const resip::Uri& aor, const resip::ContactList& contacts);
+
+private:
+   class CommitThread : public resip::ThreadIf
+   {
+   public:
+      CommitThread(PersistentRegDb& db) : mDb(db) {}
+      virtual void thread();
+   private:
+      PersistentRegDb& mDb;
+   };
+
+   bool openLog();
+   bool restore();
+   bool compact();
+
+   const resip::Data mPath;
+   const unsigned int mCommitIntervalMs;
+   MappedLog mLog;
+   size_t mCompactedSize;  // log size after the last compaction
+
+   typedef std::set<resip::Uri> UriSet;
+   UriSet mDirty;
+   resip::Mutex mDirtyMutex;
+   resip::Mutex mCommitMutex;
+
+   CommitThread mThread;
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -77,9 +77,10 @@ PostgreSqlDb::PostgreSqlDb(const resip::ConfigParse& config,
    mDBName(databaseName),
    mDBPort(port),
    mCustomUserAuthQuery(customUserAuthQuery),
-   mConn(0)
+   mConns(getPoolSize(), (PGconn*)0),
+   mPreparedStatements(getPoolSize())
 { 
-   InfoLog( << "Using PostgreSQL DB with server=" << server << ", user=" << user << ", dbName=" << databaseName << ", port=" << port);
+   InfoLog( << "Using PostgreSQL DB with server=" << server << ", user=" << user << ", dbName=" << databaseName << ", port=" << port << ", connectionPoolSize=" << getPoolSize());
 
    for (int i=0;i<MaxTable;i++)
    {
@@ -93,7 +94,9 @@ PostgreSqlDb::PostgreSqlDb(const resip::ConfigParse& config,
    }
    else
    {
-      connectToDatabase();
+      // Open the first connection now so that isSane() reflects whether the
+      // database is reachable - the others are opened as load requires
+      connectToDatabase(0);
    }
 }
 
@@ -116,33 +119,44 @@ PostgreSqlDb::initialize() const
 void
 PostgreSqlDb::disconnectFromDatabase() const
 {
-   if(mConn)
+   for (int i=0;i<MaxTable;i++)
    {
-      for (int i=0;i<MaxTable;i++)
-      {
-         if (mResult[i])
-         {  
-            PQclear(mResult[i]); 
-            mResult[i]=0;
-            mRow[i]=0;
-         }
+      if (mResult[i])
+      {  
+         PQclear(mResult[i]); 
+         mResult[i]=0;
+         mRow[i]=0;
       }
-   
-      PQfinish(mConn);
-      mConn = 0;
-      setConnected(false);
+   }
+
+   for (unsigned int i = 0; i < mConns.size(); i++)
+   {
+      disconnectFromDatabase(i);
+   }
+   setConnected(false);
+}
+
+void
+PostgreSqlDb::disconnectFromDatabase(unsigned int index) const
+{
+   // Note: results already retrieved with PQexec are independent of the
+   // connection, so mResult iterations survive a reconnect
+   if(mConns[index])
+   {
+      PQfinish(mConns[index]);
+      mConns[index] = 0;
+      mPreparedStatements[index].clear();
    }
 }
 
 int 
-PostgreSqlDb::connectToDatabase() const
+PostgreSqlDb::connectToDatabase(unsigned int index) const
 {
    // Disconnect from database first (if required)
-   disconnectFromDatabase();
+   disconnectFromDatabase(index);
 
    // Now try to connect
-   resip_assert(mConn == 0);
-   resip_assert(isConnected() == false);
+   resip_assert(mConns[index] == 0);
 
    Data connInfo(mDBConnInfo);
    if(!mDBServer.empty())
@@ -168,19 +182,20 @@ PostgreSqlDb::connectToDatabase() const
       connInfoLogString = connInfoLogString + " password=<hidden>";
    }
 
-   DebugLog(<<"Trying to connect to PostgreSQL server with conninfo string: " << connInfoLogString);
-   mConn = PQconnectdb(connInfo.c_str());
+   DebugLog(<<"Trying to connect to PostgreSQL server (connection " << index << ") with conninfo string: " << connInfoLogString);
+   PGconn* conn = PQconnectdb(connInfo.c_str());
 
-   int rc = PQstatus(mConn);
+   int rc = PQstatus(conn);
    if (rc != CONNECTION_OK)
    { 
-      ErrLog( << "PostgreSQL connect failed: " << PQerrorMessage(mConn));
-      mConn = 0;
+      ErrLog( << "PostgreSQL connect failed: " << PQerrorMessage(conn));
+      PQfinish(conn);
       setConnected(false);
       return -1;
    }
    else
    {
+      mConns[index] = conn;
       setConnected(true);
       return 0;
    }
@@ -192,48 +207,81 @@ inline int pqOK(const PGresult *result)
    return (t == PGRES_COMMAND_OK || t == PGRES_TUPLES_OK ? 0 : 1);
 }
 
+PGresult*
+PostgreSqlDb::executeOnce(unsigned int index, const Data& command, const std::vector<Data>* params) const
+{
+   PGconn* conn = mConns[index];
+   if(params == 0)
+   {
+      return PQexec(conn, command.c_str());
+   }
+
+   PreparedStatementMap& prepared = mPreparedStatements[index];
+   PreparedStatementMap::iterator it = prepared.find(command);
+   if(it == prepared.end())
+   {
+      Data name("repro_stmt_" + Data((UInt32)prepared.size()));
+      PGresult* result = PQprepare(conn, name.c_str(), command.c_str(), (int)params->size(), 0);
+      if(pqOK(result) != 0)
+      {
+         return result;
+      }
+      PQclear(result);
+      it = prepared.insert(PreparedStatementMap::value_type(command, name)).first;
+   }
+
+   std::vector<const char*> values(params->size());
+   for(size_t i = 0; i < params->size(); i++)
+   {
+      values[i] = (*params)[i].c_str();
+   }
+   return PQexecPrepared(conn, it->second.c_str(), (int)values.size(), 
+                         values.empty() ? 0 : &values[0], 0, 0, 0);
+}
+
 int
-PostgreSqlDb::query(const Data& queryCommand, PGresult** result) const
+PostgreSqlDb::execute(unsigned int index, const Data& command, const std::vector<Data>* params, PGresult** result) const
 {
    int rc = 0;
-   PGresult *_result;
+   PGresult *_result = 0;
 
    initialize();
 
-   DebugLog( << "PostgreSqlDb::query: executing query: " << queryCommand);
+   DebugLog( << "PostgreSqlDb::query: executing " << (params ? "prepared statement" : "query") << " on connection " << index << ": " << command);
 
-   Lock lock(mMutex);
-   if(mConn == 0 || !isConnected())
+   if(mConns[index] == 0)
    {
-      rc = connectToDatabase();
+      rc = connectToDatabase(index);
    }
    if(rc == 0)
    {
-      resip_assert(mConn!=0);
-      resip_assert(isConnected());
-      _result = PQexec(mConn, queryCommand.c_str());
+      resip_assert(mConns[index]!=0);
+      _result = executeOnce(index, command, params);
       rc = pqOK(_result);
       if(rc != 0)
       {
          PQclear(_result);
-         if(rc == PGRES_FATAL_ERROR)
+         _result = 0;
+         if(PQstatus(mConns[index]) == CONNECTION_BAD)
          {
-            // First failure may be a connection error - try to re-connect and then try again
-            rc = connectToDatabase();
+            // Failure was a connection error - try to re-connect and then try again
+            rc = connectToDatabase(index);
             if(rc == 0)
             {
                // OK - we reconnected - try query again
-               _result = PQexec(mConn,queryCommand.c_str());
+               _result = executeOnce(index, command, params);
                rc = pqOK(_result);
                if( rc != 0)
                {
-                  ErrLog( << "PostgreSQL query failed (twice): " << PQerrorMessage(mConn));
+                  ErrLog( << "PostgreSQL query failed (twice): " << PQerrorMessage(mConns[index]));
+                  PQclear(_result);
+                  _result = 0;
                }
             }
          }
          else
          {
-            ErrLog( << "PostgreSQL query failed: " << PQerrorMessage(mConn));
+            ErrLog( << "PostgreSQL query failed: " << PQerrorMessage(mConns[index]));
          }
       }
    }
@@ -243,20 +291,38 @@ PostgreSqlDb::query(const Data& queryCommand, PGresult** result) const
    {
       *result = _result;
    }
+   else if(_result)
+   {
+      PQclear(_result);
+   }
 
    if(rc != 0)
    {
-      ErrLog( << " SQL Command was: " << queryCommand) ;
+      ErrLog( << " SQL Command was: " << command) ;
    }
    return rc;
 }
 
+int
+PostgreSqlDb::query(const Data& queryCommand, PGresult** result) const
+{
+   PooledConnection conn(*this);
+   return execute(conn.index(), queryCommand, 0, result);
+}
+
 int
 PostgreSqlDb::query(const Data& queryCommand) const
 {
    return query(queryCommand, 0);
 }
 
+int
+PostgreSqlDb::preparedQuery(const Data& statement, const std::vector<Data>& params, PGresult** result) const
+{
+   PooledConnection conn(*this);
+   return execute(conn.index(), statement, &params, result);
+}
+
 int
 PostgreSqlDb::singleResultQuery(const Data& queryCommand, std::vector<Data>& fields) const
 {
@@ -291,11 +357,25 @@ PostgreSqlDb::singleResultQuery(const Data& queryCommand, std::vector<Data>& fie
 resip::Data& 
 PostgreSqlDb::escapeString(const resip::Data& str, resip::Data& escapedStr) const
 {
+   // Escaping depends on the connection's encoding settings, so it is done
+   // on a pooled connection like a query
+   PooledConnection conn(*this, false /* isQuery */);
+   PGconn* pgConn = mConns[conn.index()];
+   if(pgConn == 0 && connectToDatabase(conn.index()) == 0)
+   {
+      pgConn = mConns[conn.index()];
+   }
+   if(pgConn == 0)
+   {
+      escapedStr.truncate2(PQescapeString((char*)escapedStr.getBuf(str.size()*2+1), str.c_str(), str.size()));
+      return escapedStr;
+   }
+
    int rc = 0;
-   escapedStr.truncate2(PQescapeStringConn(mConn, (char*)escapedStr.getBuf(str.size()*2+1), str.c_str(), str.size(), &rc));
+   escapedStr.truncate2(PQescapeStringConn(pgConn, (char*)escapedStr.getBuf(str.size()*2+1), str.c_str(), str.size(), &rc));
    if(rc != 0)
    {
-      ErrLog(<< "PostgreSQL string escaping failed: " << PQerrorMessage(mConn));
+      ErrLog(<< "PostgreSQL string escaping failed: " << PQerrorMessage(pgConn));
       // FIXME - should probably throw here.  According to the docs, there is a value in
       // the output buffer even after failure so we'll try to use it and fail later.
    }
@@ -357,7 +437,7 @@ PostgreSqlDb::getUser( const AbstractDb::Key& key ) const
    
    if (result==0)
    {
-      ErrLog( << "PostgreSQL failed: " << PQerrorMessage(mConn));
+      ErrLog( << "PostgreSQL failed: query returned no result");
       return ret;
    }
 
@@ -383,35 +463,52 @@ PostgreSqlDb::getUser( const AbstractDb::Key& key ) const
 resip::Data 
 PostgreSqlDb::getUserAuthInfo(  const AbstractDb::Key& key ) const
 { 
-   std::vector<Data> ret;
+   Data user;
+   Data domain;
+   UserStore::getUserAndDomainFromKey(key, user, domain);
 
-   Data command;
+   // Note: domain is empty when querying for HTTP admin user - for this special user, 
+   // we will only check the repro db, by not adding the UNION statement below
+   if(!mCustomUserAuthQuery.empty() && !domain.empty())  
    {
-      DataStream ds(command);
-      Data user;
-      Data domain;
-      UserStore::getUserAndDomainFromKey(key, user, domain);
-      ds << "SELECT passwordHash FROM " << tableName(UserTable) << " WHERE username = '" << user << "' AND domain = '" << domain << "' ";
-   
-      // Note: domain is empty when querying for HTTP admin user - for this special user, 
-      // we will only check the repro db, by not adding the UNION statement below
-      if(!mCustomUserAuthQuery.empty() && !domain.empty())  
+      std::vector<Data> ret;
+      Data command;
       {
+         DataStream ds(command);
+         ds << "SELECT passwordHash FROM " << tableName(UserTable) << " WHERE username = '" << user << "' AND domain = '" << domain << "' ";
          ds << " UNION " << mCustomUserAuthQuery;
          ds.flush();
          command.replace("$user", user);
          command.replace("$domain", domain);
       }
+
+      if(singleResultQuery(command, ret) != 0 || ret.size() == 0)
+      {
+         return Data::Empty;
+      }
+      DebugLog( << "Auth password is " << ret.front());
+      return ret.front();
    }
 
-   if(singleResultQuery(command, ret) != 0 || ret.size() == 0)
+   // This is run for every digest challenge response, so it is prepared
+   Data statement("SELECT passwordHash FROM " + tableName(UserTable) + " WHERE username = $1 AND domain = $2");
+   std::vector<Data> params;
+   params.push_back(user);
+   params.push_back(domain);
+   PGresult* result = 0;
+   if(preparedQuery(statement, params, &result) != 0 || result == 0)
    {
       return Data::Empty;
    }
-   
-   DebugLog( << "Auth password is " << ret.front());
-   
-   return ret.front();
+
+   Data passwordHash;
+   if(PQntuples(result) > 0)
+   {
+      passwordHash = Data(PQgetvalue(result, 0, 0));
+      DebugLog( << "Auth password is " << passwordHash);
+   }
+   PQclear(result);
+   return passwordHash;
 }
 
 
@@ -439,7 +536,7 @@ PostgreSqlDb::firstUserKey()
 
    if(mResult[UserTable] == 0)
    {
-      ErrLog( << "PostgreSQL failed: " << PQerrorMessage(mConn));
+      ErrLog( << "PostgreSQL failed: query returned no result");
       return Data::Empty;
    }
    
@@ -514,7 +611,7 @@ PostgreSqlDb::getTlsPeerIdentity( const AbstractDb::Key& key ) const
  
    if (result==0)
    {
-      ErrLog( << "PostgreSQL failed: " << PQerrorMessage(mConn));
+      ErrLog( << "PostgreSQL failed: query returned no result");
       return ret;
    }
 
@@ -555,7 +652,7 @@ PostgreSqlDb::firstTlsPeerIdentityKey()
 
    if(mResult[TlsPeerIdentityTable] == 0)
    {
-      ErrLog( << "PostgreSQL failed: " << PQerrorMessage(mConn));
+      ErrLog( << "PostgreSQL failed: query returned no result");
       return Data::Empty;
    }
 
@@ -591,42 +688,35 @@ PostgreSqlDb::dbWriteRecord(const Table table,
                        const resip::Data& pKey, 
                        const resip::Data& pData)
 {
-   Data command;
+   // The DELETE and INSERT are run as a single prepared statement, using a
+   // data-modifying WITH clause (PostgreSQL 9.1 or later), to replace the record
+   std::vector<Data> params;
+   params.push_back(pKey);
 
+   Data statement;
    // Check if there is a secondary key or not and get it's value
    char* secondaryKey;
    unsigned int secondaryKeyLen;
-   Data escapedKey;
    if(AbstractDb::getSecondaryKey(table, pKey, pData, (void**)&secondaryKey, &secondaryKeyLen) == 0)
    {
-      Data escapedSKey;
-      Data sKey(Data::Share, secondaryKey, secondaryKeyLen);
-      DataStream ds(command);
-      ds << "DELETE FROM " << tableName(table)
-         << " WHERE attr='" << escapeString(pKey, escapedKey)
-         << "' AND attr2='" << escapeString(sKey, escapedSKey)
-         << "';"
+      params.push_back(Data(secondaryKey, secondaryKeyLen));
+      DataStream ds(statement);
+      ds << "WITH deleted AS (DELETE FROM " << tableName(table)
+         << " WHERE attr = $1 AND attr2 = $2)"
          << " INSERT INTO " << tableName(table)
-         << " (attr, attr2, value) VALUES ("
-         << "'" << escapeString(pKey, escapedKey)
-         << "', '" << escapeString(sKey, escapedSKey)
-         << "', '"  << pData.base64encode()
-         << "')";
+         << " (attr, attr2, value) VALUES ($1, $2, $3)";
    }
    else
    {
-      DataStream ds(command);
-      ds << "DELETE FROM " << tableName(table)
-         << " WHERE attr='" << escapeString(pKey, escapedKey)
-         << "';"
+      DataStream ds(statement);
+      ds << "WITH deleted AS (DELETE FROM " << tableName(table)
+         << " WHERE attr = $1)"
          << " INSERT INTO " << tableName(table)
-         << " (attr, value) VALUES ("
-         << "'" << escapeString(pKey, escapedKey)
-         << "', '"  << pData.base64encode()
-         << "')";
+         << " (attr, value) VALUES ($1, $2)";
    }
+   params.push_back(pData.base64encode());
 
-   return query(command, 0) == 0;
+   return preparedQuery(statement, params, 0) == 0;
 }
 
 bool 
@@ -634,24 +724,18 @@ PostgreSqlDb::dbReadRecord(const Table table,
                       const resip::Data& pKey, 
                       resip::Data& pData) const
 { 
-   Data command;
-   Data escapedKey;
-   {
-      DataStream ds(command);
-      ds << "SELECT value FROM " << tableName(table) 
-         << " WHERE attr='" << escapeString(pKey, escapedKey)
-         << "'";
-   }
+   Data statement("SELECT value FROM " + tableName(table) + " WHERE attr = $1");
+   std::vector<Data> params(1, pKey);
 
    PGresult* result = 0;
-   if(query(command, &result) != 0)
+   if(preparedQuery(statement, params, &result) != 0)
    {
       return false;
    }
 
    if (result == 0)
    {
-      ErrLog( << "PostgreSQL result failed: " << PQerrorMessage(mConn));
+      ErrLog( << "PostgreSQL result failed: query returned no result");
       return false;
    }
    else
@@ -696,7 +780,7 @@ PostgreSqlDb::dbNextKey(const Table table, bool first)
 
       if (mResult[table] == 0)
       {
-         ErrLog( << "PostgreSQL failed: " << PQerrorMessage(mConn));
+         ErrLog( << "PostgreSQL failed: query returned no result");
          return Data::Empty;
       }
    }
@@ -738,15 +822,16 @@ PostgreSqlDb::dbNextRecord(const Table table,
       }
       
       Data command;
+      std::vector<Data> params;
       {
          DataStream ds(command);
          ds << "SELECT value FROM " << tableName(table);
          if(!key.empty())
          {
-            Data escapedKey;
             // dbNextRecord is used to iterator through database tables that support duplication records
             // it is only appropriate for PostgreSQL tables that contain the attr2 non-unique index (secondary key)
-            ds << " WHERE attr2='" << escapeString(key, escapedKey) << "'";
+            ds << " WHERE attr2 = $1";
+            params.push_back(key);
          }
          if(forUpdate)
          {
@@ -754,14 +839,16 @@ PostgreSqlDb::dbNextRecord(const Table table,
          }
       }
 
-      if(query(command, &mResult[table]) != 0)
+      // Keyed reads (eg. message silo lookups) are prepared
+      int rc = params.empty() ? query(command, &mResult[table]) : preparedQuery(command, params, &mResult[table]);
+      if(rc != 0)
       {
          return false;
       }
 
       if (mResult[table] == 0)
       {
-         ErrLog( << "PostgreSQL failed: " << PQerrorMessage(mConn));
+         ErrLog( << "PostgreSQL failed: query returned no result");
          return false;
       }
    }
@@ -788,12 +875,17 @@ PostgreSqlDb::dbNextRecord(const Table table,
 bool 
 PostgreSqlDb::dbBeginTransaction(const Table table)
 {
+   setInTransaction(true);
    Data command("SET SESSION CHARACTERISTICS AS TRANSACTION ISOLATION LEVEL REPEATABLE READ");
-   if(query(command, 0))
+   if(query(command, 0) == 0)
    {
       command = "BEGIN";
-      return query(command, 0);
+      if(query(command, 0) == 0)
+      {
+         return true;
+      }
    }
+   setInTransaction(false);
    return false;
 }
 
@@ -3,6 +3,9 @@
 
 #include <libpq-fe.h>
 
+#include <map>
+#include <vector>
+
 #include "rutil/Data.hxx"
 #include "repro/SqlDb.hxx"
 
@@ -61,9 +64,16 @@ class PostgreSqlDb: public SqlDb
 
       void initialize() const;
       void disconnectFromDatabase() const;
-      int connectToDatabase() const;
+      void disconnectFromDatabase(unsigned int index) const;
+      int connectToDatabase(unsigned int index) const;
       int query(const resip::Data& queryCommand, PGresult** result) const;
       virtual int query(const resip::Data& queryCommand) const;
+      // Runs statement as a prepared statement with the supplied parameter
+      // values.  The statement is prepared the first time it is used on each
+      // pooled connection and reused after that.
+      int preparedQuery(const resip::Data& statement, const std::vector<resip::Data>& params, PGresult** result) const;
+      int execute(unsigned int index, const resip::Data& command, const std::vector<resip::Data>* params, PGresult** result) const;
+      PGresult* executeOnce(unsigned int index, const resip::Data& command, const std::vector<resip::Data>* params) const;
       resip::Data& escapeString(const resip::Data& str, resip::Data& escapedStr) const;
 
       resip::Data mDBConnInfo;
@@ -74,7 +84,11 @@ class PostgreSqlDb: public SqlDb
       unsigned int mDBPort;
       resip::Data mCustomUserAuthQuery;
 
-      mutable PGconn* mConn;
+      // One connection per pool slot, and the names of the statements
+      // prepared on it keyed by statement text
+      typedef std::map<resip::Data, resip::Data> PreparedStatementMap;
+      mutable std::vector<PGconn*> mConns;
+      mutable std::vector<PreparedStatementMap> mPreparedStatements;
       mutable PGresult* mResult[MaxTable];
       mutable int mRow[MaxTable];
 
@@ -5,6 +5,7 @@
 #include <iostream>
 
 #include "repro/ProcessorChain.hxx"
+#include "resip/stack/ParseStatistics.hxx"
 #include "resip/stack/SipMessage.hxx"
 #include "repro/ProcessorMessage.hxx"
 #include "repro/RequestContext.hxx"
@@ -94,7 +95,10 @@ repro::ProcessorChain::process(RequestContext &rc)
    {
       DebugLog(<< "Chain invoking " << mName << ": " << *(mChain[position]));
 
-      action = mChain[position]->process(rc);
+      {
+         ParseStatistics::Scope parseScope(mChain[position]->getName().c_str());
+         action = mChain[position]->process(rc);
+      }
 
       if (action == SkipAllChains)
       {
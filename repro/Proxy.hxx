@@ -106,6 +106,7 @@ class Proxy : public resip::TransactionUser, public resip::ThreadIf
 
       void doSessionAccounting(const resip::SipMessage& sip, bool received, RequestContext& context);
       void doRegistrationAccounting(repro::AccountingCollector::RegistrationEvent regEvent, const resip::SipMessage& sip);
+      AccountingCollector* getAccountingCollector() { return mAccountingCollector; }
 
       virtual void processUnknownMessage(resip::Message* msg);
 
@@ -6,6 +6,7 @@
 #include <resip/stack/GenericPidfContents.hxx>
 #include <rutil/Data.hxx>
 #include <rutil/DnsUtil.hxx>
+#include <rutil/Lock.hxx>
 #include <rutil/Logger.hxx>
 #include <rutil/ParseBuffer.hxx>
 #include <rutil/Socket.hxx>
@@ -14,6 +15,7 @@
 
 #include "repro/RegSyncClient.hxx"
 #include "repro/RegSyncServer.hxx"
+#include "repro/RegSyncProtocol.hxx"
 
 using namespace repro;
 using namespace resip;
@@ -24,12 +26,19 @@ using namespace std;
 RegSyncClient::RegSyncClient(InMemorySyncRegDb* regDb,
                              Data address,
                              unsigned short port,
-                             InMemorySyncPubDb* pubDb) :
+                             InMemorySyncPubDb* pubDb,
+                             bool useBinaryProtocol) :
    mRegDb(regDb),
    mPubDb(pubDb),
    mAddress(address),
    mPort(port),
-   mSocketDesc(0)
+   mSocketDesc(0),
+   mUseBinaryProtocol(useBinaryProtocol),
+   mSequence(0),
+   mSessionSequence(0),
+   mSyncing(false),
+   mSyncStartTime(0),
+   mSyncRecords(0)
 {
     resip_assert(mRegDb);
 }
@@ -124,9 +133,26 @@ RegSyncClient::thread()
       Data request(
          "<InitialSync>\r\n"
          "  <Request>\r\n"
-         "     <Version>" + Data(REGSYNC_VERSION) + "</Version>\r\n"   // For use in detecting if client/server are a compatible version
+         "     <Version>" + Data(REGSYNC_VERSION) + "</Version>\r\n");   // For use in detecting if client/server are a compatible version
+      if(mUseBinaryProtocol)
+      {
+         // Servers that don't know the binary encoding ignore these and answer in XML
+         request += "     <Encoding>binary</Encoding>\r\n";
+         if(!mServerId.empty())
+         {
+            // Ask to only be sent what changed since we were last connected
+            request += "     <ServerId>" + mServerId + "</ServerId>\r\n"
+                       "     <Sequence>" + Data(mSequence) + "</Sequence>\r\n";
+         }
+      }
+      request += 
          "  </Request>\r\n"
-         "</InitialSync>\r\n");   
+         "</InitialSync>\r\n";
+      mRxDataBuffer.clear();
+      mSyncing = true;
+      mSyncStartTime = Timer::getTimeMs();
+      mSyncRecords = 0;
+      mSessionSequence = 0;
       rc = ::send(mSocketDesc, request.c_str(), (int)request.size(), 0);
       if(rc < 0) 
       {
@@ -172,12 +198,23 @@ RegSyncClient::thread()
             if(rc > 0)
             {
                mRxDataBuffer += Data(Data::Borrow, (const char*)&mRxBuffer, rc);   
-               while(tryParse());
+               try
+               {
+                  while(tryParse());
+               }
+               catch(BaseException& e)
+               {
+                  // We can't find the start of the next message in the stream - reconnect
+                  ErrLog(<< "RegSyncClient: error decoding data from server: " << e);
+                  closeSocket(mSocketDesc);
+                  mSocketDesc = 0;
+                  break;
+               }
             }
          }
          else if(rc == 0) // timeout - send keepalive
          {
-            rc = ::send(mSocketDesc, Symbols::CRLFCRLF, (int)request.size(), 0);
+            rc = ::send(mSocketDesc, Symbols::CRLFCRLF, (int)strlen(Symbols::CRLFCRLF), 0);
             if(rc < 0) 
             {
                int e = getErrno();
@@ -204,6 +241,12 @@ RegSyncClient::thread()
              break;
          }
       }
+      if(mSocketDesc && !mShutdown)
+      {
+         // Connection closed by the server - reconnect (and resume if using the binary protocol)
+         closeSocket(mSocketDesc);
+         mSocketDesc = 0;
+      }
    } // end while
 
    if(mSocketDesc) closeSocket(mSocketDesc);
@@ -212,6 +255,31 @@ RegSyncClient::thread()
 bool 
 RegSyncClient::tryParse()
 {
+   // Binary frames are sent by servers that accepted the binary encoding, the response to the
+   // InitialSync request is always XML
+   Data::size_type pos = 0;
+   while(pos < mRxDataBuffer.size() && isspace((unsigned char)mRxDataBuffer[pos]))
+   {
+      pos++;
+   }
+   if(pos < mRxDataBuffer.size() && (unsigned char)mRxDataBuffer[pos] == RegSyncProtocol::FrameMarker)
+   {
+      unsigned int frameSize = RegSyncProtocol::getFrameSize(mRxDataBuffer.data() + pos, (unsigned int)(mRxDataBuffer.size() - pos));
+      if(frameSize == 0)
+      {
+         return false;  // need more data
+      }
+      handleBinaryFrame(mRxDataBuffer.data() + pos + RegSyncProtocol::FrameHeaderSize, frameSize - RegSyncProtocol::FrameHeaderSize);
+      pos += frameSize;
+      if(pos < mRxDataBuffer.size())
+      {
+         mRxDataBuffer = mRxDataBuffer.substr(pos);
+         return true;
+      }
+      mRxDataBuffer.clear();
+      return false;
+   }
+
    ParseBuffer pb(mRxDataBuffer);
    Data initialTag;
    const char* start = pb.position();
@@ -635,6 +703,12 @@ RegSyncClient::handlePubInfoEvent(resip::XMLCursor& xml)
    }
    xml.parent();
 
+   processDocument(document);
+}
+
+void
+RegSyncClient::processDocument(PublicationPersistenceManager::PubDocument& document)
+{
    if (mPubDb)
    {
       if (document.mExpirationTime != 0)
@@ -650,6 +724,108 @@ RegSyncClient::handlePubInfoEvent(resip::XMLCursor& xml)
    }
 }
 
+void
+RegSyncClient::handleBinaryFrame(const char* payload, unsigned int size)
+{
+   RegSyncDecoder decoder(payload, size);
+   UInt64 records = 0;
+   while(!decoder.eof())
+   {
+      switch(decoder.getRecordType())
+      {
+      case RegSyncProtocol::AorRecord:
+         {
+            Uri aor;
+            ContactList contacts;
+            decoder.decodeAor(aor, contacts);
+            if (mRegDb)
+            {
+               processModify(aor, contacts);
+            }
+            records++;
+         }
+         break;
+      case RegSyncProtocol::DocumentRecord:
+         {
+            PublicationPersistenceManager::PubDocument document;
+            decoder.decodeDocument(document);
+            processDocument(document);
+            records++;
+         }
+         break;
+      case RegSyncProtocol::SyncCompleteRecord:
+         {
+            Data serverId;
+            UInt64 sequence;
+            bool resumed;
+            decoder.decodeSyncComplete(serverId, sequence, resumed);
+            mSyncRecords += records;
+            mServerId = serverId;
+            // Changes made on the server while a full sync was in progress may already have been received
+            mSequence = sequence > mSessionSequence ? sequence : mSessionSequence;
+            mSyncing = false;
+
+            UInt64 elapsedMs = Timer::getTimeMs() - mSyncStartTime;
+            InfoLog(<< "RegSyncClient::handleBinaryFrame: " << (resumed ? "resumed" : "full") << " initial sync of " << mSyncRecords 
+                    << " records completed in " << elapsedMs << "ms (" << (elapsedMs ? mSyncRecords * 1000 / elapsedMs : mSyncRecords) << " records/s), sequence=" << mSequence);
+            Lock lock(mStatsMutex);
+            if(resumed)
+            {
+               mStats.mResumedSyncs++;
+            }
+            else
+            {
+               mStats.mFullSyncs++;
+            }
+            mStats.mLastSyncRecords = mSyncRecords;
+            mStats.mLastSyncMs = elapsedMs;
+         }
+         break;
+      }
+      if(decoder.getSequence() > mSessionSequence)
+      {
+         mSessionSequence = decoder.getSequence();
+      }
+      // Until the sync completes sequences may not be comparable with ones from a previous connection
+      if(!mSyncing && decoder.getSequence() > mSequence)
+      {
+         mSequence = decoder.getSequence();
+      }
+   }
+   if(mSyncing)
+   {
+      mSyncRecords += records;
+   }
+
+   Lock lock(mStatsMutex);
+   mStats.mRecordsReceived += records;
+   mStats.mFramesReceived++;
+   mStats.mBytesReceived += size + RegSyncProtocol::FrameHeaderSize;
+   mStats.mSequence = mSequence;
+}
+
+RegSyncClient::Stats
+RegSyncClient::getStats()
+{
+   Lock lock(mStatsMutex);
+   return mStats;
+}
+
+void
+RegSyncClient::encodeStats(EncodeStream& strm)
+{
+   Stats stats = getStats();
+   strm << "Peer=" << mAddress << ":" << mPort
+        << " Sequence=" << stats.mSequence << endl;
+   strm << "RecordsReceived=" << stats.mRecordsReceived
+        << " FramesReceived=" << stats.mFramesReceived
+        << " BytesReceived=" << stats.mBytesReceived << endl;
+   strm << "FullSyncs=" << stats.mFullSyncs
+        << " ResumedSyncs=" << stats.mResumedSyncs
+        << " LastSyncRecords=" << stats.mLastSyncRecords
+        << " LastSyncMs=" << stats.mLastSyncMs << endl;
+}
+
 /* ====================================================================
  * The Vovida Software License, Version 1.0 
  * 
@@ -2,6 +2,7 @@
 #define RegSyncClient_hxx 
 
 #include <rutil/Data.hxx>
+#include <rutil/Mutex.hxx>
 #include <rutil/XMLCursor.hxx>
 #include <resip/dum/InMemorySyncRegDb.hxx>
 #include <resip/dum/InMemorySyncPubDb.hxx>
@@ -16,11 +17,30 @@ public:
    RegSyncClient(resip::InMemorySyncRegDb* regDb,
                  resip::Data address,
                  unsigned short port,
-                 resip::InMemorySyncPubDb* pubDb = 0);
+                 resip::InMemorySyncPubDb* pubDb = 0,
+                 bool useBinaryProtocol = true);
 
    virtual void thread();
    virtual void shutdown();
 
+   class Stats
+   {
+   public:
+      Stats() : mRecordsReceived(0), mFramesReceived(0), mBytesReceived(0), mFullSyncs(0),
+                mResumedSyncs(0), mLastSyncRecords(0), mLastSyncMs(0), mSequence(0) {}
+      UInt64 mRecordsReceived;
+      UInt64 mFramesReceived;
+      UInt64 mBytesReceived;
+      UInt64 mFullSyncs;
+      UInt64 mResumedSyncs;
+      UInt64 mLastSyncRecords;
+      UInt64 mLastSyncMs;
+      UInt64 mSequence;
+   };
+   // thread safe
+   Stats getStats();
+   void encodeStats(EncodeStream& strm);
+
 private: 
    void delaySeconds(unsigned int seconds);
    bool tryParse();  // returns true if we processed something and there is more data in the buffer
@@ -28,6 +48,8 @@ private:
    void handleRegInfoEvent(resip::XMLCursor& xml);
    void handlePubInfoEvent(resip::XMLCursor& xml);
    void processModify(const resip::Uri& aor, resip::ContactList& syncContacts);
+   void handleBinaryFrame(const char* payload, unsigned int size);
+   void processDocument(resip::PublicationPersistenceManager::PubDocument& document);
 
    resip::InMemorySyncRegDb* mRegDb;
    resip::InMemorySyncPubDb* mPubDb;
@@ -36,6 +58,18 @@ private:
    char mRxBuffer[8000];
    resip::Data mRxDataBuffer;
    int mSocketDesc;
+
+   // Binary protocol - used to resume after a reconnect
+   bool mUseBinaryProtocol;
+   resip::Data mServerId;
+   UInt64 mSequence;
+   UInt64 mSessionSequence;  // highest sequence received on the current connection
+   bool mSyncing;
+   UInt64 mSyncStartTime;
+   UInt64 mSyncRecords;
+
+   resip::Mutex mStatsMutex;
+   Stats mStats;
 };
 
 }
@@ -0,0 +1,440 @@
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <resip/stack/Contents.hxx>
+#include <resip/stack/GenericPidfContents.hxx>
+#include <resip/stack/SecurityAttributes.hxx>
+#include <resip/stack/Tuple.hxx>
+#include <rutil/Timer.hxx>
+
+#include "repro/RegSyncProtocol.hxx"
+
+using namespace repro;
+using namespace resip;
+using namespace std;
+
+// Contact record flags
+static const unsigned char ContactHasReceivedFrom  = 0x01;
+static const unsigned char ContactHasPublicAddress = 0x02;
+static const unsigned char ContactHasSipPath       = 0x04;
+static const unsigned char ContactHasInstance      = 0x08;
+static const unsigned char ContactHasRegId         = 0x10;
+static const unsigned char ContactHasUserAgent     = 0x20;
+
+// Document record flags
+static const unsigned char DocumentHasContents           = 0x01;
+static const unsigned char DocumentHasSecurityAttributes = 0x02;
+
+static void
+appendVarint(Data& buffer, UInt64 value)
+{
+   char bytes[10];
+   int len = 0;
+   do
+   {
+      bytes[len] = (char)(value & 0x7f);
+      value >>= 7;
+      if(value)
+      {
+         bytes[len] |= 0x80;
+      }
+      len++;
+   } while(value);
+   buffer.append(bytes, len);
+}
+
+static void
+appendString(Data& buffer, const Data& value)
+{
+   appendVarint(buffer, value.size());
+   buffer.append(value.data(), value.size());
+}
+
+Data::size_type
+RegSyncProtocol::startFrame(Data& buffer, UInt64 now)
+{
+   Data::size_type frameStart = buffer.size();
+   const char header[FrameHeaderSize] = { (char)FrameMarker, 0, 0, 0, 0 };
+   buffer.append(header, FrameHeaderSize);
+   appendVarint(buffer, now);
+   return frameStart;
+}
+
+void
+RegSyncProtocol::endFrame(Data& buffer, Data::size_type frameStart)
+{
+   UInt32 payloadSize = (UInt32)(buffer.size() - frameStart - FrameHeaderSize);
+   buffer[frameStart + 1] = (char)(payloadSize >> 24);
+   buffer[frameStart + 2] = (char)(payloadSize >> 16);
+   buffer[frameStart + 3] = (char)(payloadSize >> 8);
+   buffer[frameStart + 4] = (char)payloadSize;
+}
+
+bool
+RegSyncProtocol::encodeAor(Data& buffer, UInt64 sequence, const Uri& aor, const ContactList& contacts, UInt64 now, bool emptyRecord)
+{
+   unsigned int numContacts = 0;
+   ContactList::const_iterator cit = contacts.begin();
+   for(; cit != contacts.end(); cit++)
+   {
+      if(!cit->mReceivedFrom.onlyUseExistingConnection &&
+         cit->mRegExpires != NeverExpire)  // Don't sync over static registrations
+      {
+         numContacts++;
+      }
+   }
+   if(numContacts == 0 && !emptyRecord)
+   {
+      return false;
+   }
+
+   buffer += (char)AorRecord;
+   appendVarint(buffer, sequence);
+   appendString(buffer, Data::from(aor));
+   appendVarint(buffer, numContacts);
+   for(cit = contacts.begin(); cit != contacts.end(); cit++)
+   {
+      const ContactInstanceRecord& rec = *cit;
+      if(rec.mReceivedFrom.onlyUseExistingConnection || rec.mRegExpires == NeverExpire)
+      {
+         continue;
+      }
+      appendString(buffer, Data::from(rec.mContact));
+      // If contact is expired or removed, then pass expires time as 0
+      appendVarint(buffer, rec.mRegExpires <= now ? 0 : rec.mRegExpires);
+      appendVarint(buffer, rec.mLastUpdated);
+
+      unsigned char flags = 0;
+      if(rec.mReceivedFrom.getPort() != 0) flags |= ContactHasReceivedFrom;
+      if(rec.mPublicAddress.getType() != UNKNOWN_TRANSPORT) flags |= ContactHasPublicAddress;
+      if(!rec.mSipPath.empty()) flags |= ContactHasSipPath;
+      if(!rec.mInstance.empty()) flags |= ContactHasInstance;
+      if(rec.mRegId != 0) flags |= ContactHasRegId;
+      if(!rec.mUserAgent.empty()) flags |= ContactHasUserAgent;
+      buffer += (char)flags;
+
+      if(flags & ContactHasReceivedFrom)
+      {
+         Data binaryFlowToken;
+         Tuple::writeBinaryToken(rec.mReceivedFrom, binaryFlowToken);
+         appendString(buffer, binaryFlowToken);
+      }
+      if(flags & ContactHasPublicAddress)
+      {
+         Data binaryFlowToken;
+         Tuple::writeBinaryToken(rec.mPublicAddress, binaryFlowToken);
+         appendString(buffer, binaryFlowToken);
+      }
+      if(flags & ContactHasSipPath)
+      {
+         appendVarint(buffer, rec.mSipPath.size());
+         NameAddrs::const_iterator naIt = rec.mSipPath.begin();
+         for(; naIt != rec.mSipPath.end(); naIt++)
+         {
+            appendString(buffer, Data::from(naIt->uri()));
+         }
+      }
+      if(flags & ContactHasInstance)
+      {
+         appendString(buffer, rec.mInstance);
+      }
+      if(flags & ContactHasRegId)
+      {
+         appendVarint(buffer, rec.mRegId);
+      }
+      if(flags & ContactHasUserAgent)
+      {
+         appendString(buffer, rec.mUserAgent);
+      }
+   }
+   return true;
+}
+
+void
+RegSyncProtocol::encodeDocument(Data& buffer, UInt64 sequence, const Data& eventType, const Data& documentKey, const Data& eTag,
+                                UInt64 expirationTime, UInt64 lastUpdated, const Contents* contents, const SecurityAttributes* securityAttributes, UInt64 now)
+{
+   buffer += (char)DocumentRecord;
+   appendVarint(buffer, sequence);
+   appendString(buffer, eventType);
+   appendString(buffer, documentKey);
+   appendString(buffer, eTag);
+   appendVarint(buffer, expirationTime <= now ? 0 : expirationTime);
+   appendVarint(buffer, lastUpdated);
+
+   // lingering records will have expirationTime as 0 - don't need to send contents - refreshes also have no body
+   unsigned char flags = 0;
+   if(expirationTime != 0 && contents != 0)
+   {
+      flags |= DocumentHasContents;
+      if(securityAttributes)
+      {
+         flags |= DocumentHasSecurityAttributes;
+      }
+   }
+   buffer += (char)flags;
+
+   if(flags & DocumentHasContents)
+   {
+      appendString(buffer, contents->getBodyData());
+   }
+   if(flags & DocumentHasSecurityAttributes)
+   {
+      // Note:  intentionally not syncing mLevel and mEncryptionPerformed from SecurityAttributes since they are for outbound messages only
+      buffer += (char)(securityAttributes->isEncrypted() ? 1 : 0);
+      buffer += (char)securityAttributes->getSignatureStatus();
+      appendString(buffer, securityAttributes->getSigner());
+      appendString(buffer, securityAttributes->getIdentity());
+      buffer += (char)securityAttributes->getIdentityStrength();
+   }
+}
+
+void
+RegSyncProtocol::encodeSyncComplete(Data& buffer, const Data& serverId, UInt64 sequence, bool resumed)
+{
+   buffer += (char)SyncCompleteRecord;
+   appendVarint(buffer, 0);
+   appendString(buffer, serverId);
+   appendVarint(buffer, sequence);
+   buffer += (char)(resumed ? 1 : 0);
+}
+
+unsigned int
+RegSyncProtocol::getFrameSize(const char* data, unsigned int size)
+{
+   if(size == 0)
+   {
+      return 0;
+   }
+   if((unsigned char)data[0] != FrameMarker)
+   {
+      throw Exception("Data does not start with a frame marker", __FILE__, __LINE__);
+   }
+   if(size < FrameHeaderSize)
+   {
+      return 0;
+   }
+   const unsigned char* header = (const unsigned char*)data;
+   UInt32 payloadSize = ((UInt32)header[1] << 24) | ((UInt32)header[2] << 16) | ((UInt32)header[3] << 8) | (UInt32)header[4];
+   if(payloadSize > MaxFrameSize)
+   {
+      throw Exception("Frame is too large", __FILE__, __LINE__);
+   }
+   if(size < FrameHeaderSize + payloadSize)
+   {
+      return 0;
+   }
+   return FrameHeaderSize + payloadSize;
+}
+
+RegSyncDecoder::RegSyncDecoder(const char* payload, unsigned int size) :
+   mPosition(payload),
+   mEnd(payload + size),
+   mServerTime(0),
+   mLocalTime(Timer::getTimeSecs()),
+   mSequence(0)
+{
+   mServerTime = getVarint();
+}
+
+RegSyncProtocol::RecordType
+RegSyncDecoder::getRecordType()
+{
+   unsigned char type = getByte();
+   if(type < RegSyncProtocol::AorRecord || type > RegSyncProtocol::SyncCompleteRecord)
+   {
+      throw RegSyncProtocol::Exception("Unknown record type " + Data((UInt32)type), __FILE__, __LINE__);
+   }
+   mSequence = getVarint();
+   return (RegSyncProtocol::RecordType)type;
+}
+
+void
+RegSyncDecoder::decodeAor(Uri& aor, ContactList& contacts)
+{
+   aor = Uri(getString());
+   UInt64 numContacts = getVarint();
+   for(UInt64 i = 0; i < numContacts; i++)
+   {
+      ContactInstanceRecord rec;
+      rec.mContact = NameAddr(getString());
+      UInt64 expires = getVarint();
+      rec.mRegExpires = (expires == 0 ? 0 : toLocalTime(expires));
+      rec.mLastUpdated = toLocalTime(getVarint());
+
+      unsigned char flags = getByte();
+      if(flags & ContactHasReceivedFrom)
+      {
+         rec.mReceivedFrom = Tuple::makeTupleFromBinaryToken(getString());
+      }
+      if(flags & ContactHasPublicAddress)
+      {
+         rec.mPublicAddress = Tuple::makeTupleFromBinaryToken(getString());
+      }
+      if(flags & ContactHasSipPath)
+      {
+         UInt64 numPaths = getVarint();
+         for(UInt64 j = 0; j < numPaths; j++)
+         {
+            rec.mSipPath.push_back(NameAddr(getString()));
+         }
+      }
+      if(flags & ContactHasInstance)
+      {
+         rec.mInstance = getString();
+      }
+      if(flags & ContactHasRegId)
+      {
+         rec.mRegId = (UInt32)getVarint();
+      }
+      if(flags & ContactHasUserAgent)
+      {
+         rec.mUserAgent = getString();
+      }
+      rec.mSyncContact = true;  // This ContactInstanceRecord came from registration sync process
+      contacts.push_back(rec);
+   }
+}
+
+void
+RegSyncDecoder::decodeDocument(PublicationPersistenceManager::PubDocument& document)
+{
+   document.mEventType = getString();
+   document.mDocumentKey = getString();
+   document.mETag = getString();
+   UInt64 expires = getVarint();
+   document.mExpirationTime = (expires == 0 ? 0 : toLocalTime(expires));
+   document.mLingerTime = document.mExpirationTime;
+   document.mLastUpdated = toLocalTime(getVarint());
+
+   unsigned char flags = getByte();
+   if(flags & DocumentHasContents)
+   {
+      Data contentsData = getString();
+      HeaderFieldValue hfv(contentsData.data(), contentsData.size());
+      GenericPidfContents pidf(hfv, GenericPidfContents::getStaticType());
+      document.mContents.reset((Contents*)new GenericPidfContents(pidf));  // ensure we copy other pidf - since it shares data with contentsData
+   }
+   if(flags & DocumentHasSecurityAttributes)
+   {
+      document.mSecurityAttributes.reset(new SecurityAttributes);
+      if(getByte())
+      {
+         document.mSecurityAttributes->setEncrypted();
+      }
+      document.mSecurityAttributes->setSignatureStatus((SignatureStatus)getByte());
+      document.mSecurityAttributes->setSigner(getString());
+      document.mSecurityAttributes->setIdentity(getString());
+      document.mSecurityAttributes->setIdentityStrength((SecurityAttributes::IdentityStrength)getByte());
+   }
+}
+
+void
+RegSyncDecoder::decodeSyncComplete(Data& serverId, UInt64& sequence, bool& resumed)
+{
+   serverId = getString();
+   sequence = getVarint();
+   resumed = getByte() != 0;
+}
+
+unsigned char
+RegSyncDecoder::getByte()
+{
+   if(mPosition >= mEnd)
+   {
+      throw RegSyncProtocol::Exception("Unexpected end of frame", __FILE__, __LINE__);
+   }
+   return (unsigned char)*mPosition++;
+}
+
+UInt64
+RegSyncDecoder::getVarint()
+{
+   UInt64 value = 0;
+   for(unsigned int shift = 0; shift < 64; shift += 7)
+   {
+      unsigned char b = getByte();
+      value |= (UInt64)(b & 0x7f) << shift;
+      if((b & 0x80) == 0)
+      {
+         return value;
+      }
+   }
+   throw RegSyncProtocol::Exception("Malformed varint", __FILE__, __LINE__);
+}
+
+Data
+RegSyncDecoder::getString()
+{
+   UInt64 len = getVarint();
+   if(len > (UInt64)(mEnd - mPosition))
+   {
+      throw RegSyncProtocol::Exception("String exceeds frame", __FILE__, __LINE__);
+   }
+   Data value(mPosition, (Data::size_type)len);
+   mPosition += len;
+   return value;
+}
+
+UInt64
+RegSyncDecoder::toLocalTime(UInt64 serverTime) const
+{
+   // Preserve the time relative to "now" on the server, as the XML encoding does
+   if(serverTime + mLocalTime < mServerTime)
+   {
+      return 0;
+   }
+   return serverTime + mLocalTime - mServerTime;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * Copyright (c) 2015 SIP Spectrum, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
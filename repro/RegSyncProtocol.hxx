@@ -0,0 +1,165 @@
+#if !defined(RegSyncProtocol_hxx)
+#define RegSyncProtocol_hxx
+
+#include <rutil/Data.hxx>
+#include <rutil/BaseException.hxx>
+#include <resip/dum/ContactInstanceRecord.hxx>
+#include <resip/dum/PublicationPersistenceManager.hxx>
+
+namespace resip
+{
+class Contents;
+class SecurityAttributes;
+}
+
+/// Binary (length prefixed) encoding for the RegSync replication stream.  A peer
+/// selects it by adding <Encoding>binary</Encoding> to its InitialSync request,
+/// the XML encoding remains the default for older peers.
+///
+/// Frame:   | 0xB5 | uint32 payload length (network order) | payload |
+/// Payload: | varint server time (secs) | record | record | ...
+///
+/// Each record starts with a type byte and a varint sequence number.  Sequence
+/// numbers are assigned by the server to every change it replicates, so that a
+/// reconnecting peer can ask to resume after the last sequence it processed.
+/// Records sent as part of a full initial sync carry sequence 0.  All times in
+/// records are absolute times on the server clock, the receiver converts them
+/// using the server time in the frame header.  Integers are encoded as LEB128
+/// varints, and strings as a varint length followed by the bytes.
+
+namespace repro
+{
+
+class RegSyncProtocol
+{
+public:
+   typedef enum
+   {
+      AorRecord = 1,
+      DocumentRecord = 2,
+      SyncCompleteRecord = 3
+   } RecordType;
+
+   static const unsigned char FrameMarker = 0xB5;
+   static const unsigned int FrameHeaderSize = 5;
+   static const unsigned int MaxFrameSize = 16*1024*1024;
+
+   class Exception : public resip::BaseException
+   {
+   public:
+      Exception(const resip::Data& msg, const resip::Data& file, const int line)
+         : resip::BaseException(msg, file, line) {}
+   protected:
+      virtual const char* name() const { return "RegSyncProtocol::Exception"; }
+   };
+
+   // Frames - records are appended between startFrame and endFrame
+   static resip::Data::size_type startFrame(resip::Data& buffer, UInt64 now);
+   static void endFrame(resip::Data& buffer, resip::Data::size_type frameStart);
+
+   // Appends a record to buffer.  encodeAor returns false, and appends nothing, if none of the
+   // contacts should be replicated (static registrations are never sync'd) - unless emptyRecord
+   // is set, in which case a record with no contacts is appended to mark the AOR as removed.
+   static bool encodeAor(resip::Data& buffer, UInt64 sequence, const resip::Uri& aor, const resip::ContactList& contacts, UInt64 now, bool emptyRecord = false);
+   static void encodeDocument(resip::Data& buffer, UInt64 sequence, const resip::Data& eventType, const resip::Data& documentKey, const resip::Data& eTag,
+                              UInt64 expirationTime, UInt64 lastUpdated, const resip::Contents* contents, const resip::SecurityAttributes* securityAttributes, UInt64 now);
+   static void encodeSyncComplete(resip::Data& buffer, const resip::Data& serverId, UInt64 sequence, bool resumed);
+
+   // Returns the size of the complete frame at the start of data, or 0 if more data is needed.
+   // Throws if data does not start with a frame.
+   static unsigned int getFrameSize(const char* data, unsigned int size);
+};
+
+// Decodes the records in one frame payload, for example:
+//    RegSyncDecoder decoder(payload, payloadSize);
+//    while(!decoder.eof())
+//    {
+//       switch(decoder.getRecordType()) { case RegSyncProtocol::AorRecord: decoder.decodeAor(aor, contacts); ... }
+//    }
+class RegSyncDecoder
+{
+public:
+   RegSyncDecoder(const char* payload, unsigned int size);
+
+   bool eof() const { return mPosition == mEnd; }
+   UInt64 getServerTime() const { return mServerTime; }
+
+   // Reads the header of the next record; the matching decode method must be called next
+   RegSyncProtocol::RecordType getRecordType();
+   UInt64 getSequence() const { return mSequence; }
+   // Keep times on the server clock instead of converting them, for records read back from a
+   // local log where the "server" is an earlier run of this process
+   void useServerClock() { mLocalTime = mServerTime; }
+
+   // Times are converted to the local clock, contacts are flagged as sync contacts
+   void decodeAor(resip::Uri& aor, resip::ContactList& contacts);
+   void decodeDocument(resip::PublicationPersistenceManager::PubDocument& document);
+   void decodeSyncComplete(resip::Data& serverId, UInt64& sequence, bool& resumed);
+
+private:
+   unsigned char getByte();
+   UInt64 getVarint();
+   resip::Data getString();
+   UInt64 toLocalTime(UInt64 serverTime) const;
+
+   const char* mPosition;
+   const char* mEnd;
+   UInt64 mServerTime;
+   UInt64 mLocalTime;
+   UInt64 mSequence;
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * Copyright (c) 2015 SIP Spectrum, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
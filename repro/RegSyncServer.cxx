@@ -9,8 +9,10 @@
 #include <rutil/ResipAssert.h>
 #include <rutil/Data.hxx>
 #include <rutil/DnsUtil.hxx>
+#include <rutil/Lock.hxx>
 #include <rutil/Logger.hxx>
 #include <rutil/ParseBuffer.hxx>
+#include <rutil/Random.hxx>
 #include <rutil/Socket.hxx>
 #include <rutil/TransportType.hxx>
 #include <rutil/Timer.hxx>
@@ -18,6 +20,7 @@
 #include "repro/XmlRpcServerBase.hxx"
 #include "repro/XmlRpcConnection.hxx"
 #include "repro/RegSyncServer.hxx"
+#include "repro/RegSyncProtocol.hxx"
 
 using namespace repro;
 using namespace resip;
@@ -32,16 +35,18 @@ RegSyncServer::RegSyncServer(resip::InMemorySyncRegDb* regDb,
                              resip::InMemorySyncPubDb* pubDb) :
    XmlRpcServerBase(port, version),
    mRegDb(regDb),
-   mPubDb(pubDb)
+   mPubDb(pubDb),
+   mServerId(Random::getCryptoRandomHex(8)),
+   mBacklogSize(50000),
+   mBatchSize(256),
+   mAlwaysSendXml(false),
+   mSequence(0),
+   mPendingRecords(0),
+   mSyncConnectionId(0),
+   mSyncBatchRecords(0),
+   mSyncRecords(0)
 {
-   if (mRegDb)
-   {
-      mRegDb->addHandler(this);
-   }
-   if (mPubDb)
-   {
-      mPubDb->addHandler(this);
-   }
+   init();
 }
 
 RegSyncServer::RegSyncServer(resip::InMemorySyncRegDb* regDb,
@@ -49,7 +54,22 @@ RegSyncServer::RegSyncServer(resip::InMemorySyncRegDb* regDb,
                              resip::InMemorySyncPubDb* pubDb) :
    XmlRpcServerBase(brokerQueue),
    mRegDb(regDb),
-   mPubDb(pubDb)
+   mPubDb(pubDb),
+   mServerId(Random::getCryptoRandomHex(8)),
+   mBacklogSize(50000),
+   mBatchSize(256),
+   mAlwaysSendXml(true),
+   mSequence(0),
+   mPendingRecords(0),
+   mSyncConnectionId(0),
+   mSyncBatchRecords(0),
+   mSyncRecords(0)
+{
+   init();
+}
+
+void
+RegSyncServer::init()
 {
    if (mRegDb)
    {
@@ -251,29 +271,67 @@ RegSyncServer::handleInitialSyncRequest(unsigned int connectionId, unsigned int
 {
    InfoLog(<< "RegSyncServer::handleInitialSyncRequest");
 
-   // Check for correct Version
+   // Check for correct Version, and see if the peer wants the binary encoding and can resume
    unsigned int version = 0;
+   Data encoding;
+   Data serverId;
+   UInt64 lastSequence = 0;
+   bool haveSequence = false;
    if(xml.firstChild())
    {
       if(isEqualNoCase(xml.getTag(), "request"))
       {
          if(xml.firstChild())
          {
-            if(isEqualNoCase(xml.getTag(), "version"))
+            do
             {
-               if(xml.firstChild())
+               if(isEqualNoCase(xml.getTag(), "version"))
                {
-                  version = xml.getValue().convertUnsignedLong();
-                  xml.parent();
+                  if(xml.firstChild())
+                  {
+                     version = xml.getValue().convertUnsignedLong();
+                     xml.parent();
+                  }
                }
-            }
+               else if(isEqualNoCase(xml.getTag(), "encoding"))
+               {
+                  if(xml.firstChild())
+                  {
+                     encoding = xml.getValue();
+                     xml.parent();
+                  }
+               }
+               else if(isEqualNoCase(xml.getTag(), "serverid"))
+               {
+                  if(xml.firstChild())
+                  {
+                     serverId = xml.getValue();
+                     xml.parent();
+                  }
+               }
+               else if(isEqualNoCase(xml.getTag(), "sequence"))
+               {
+                  if(xml.firstChild())
+                  {
+                     lastSequence = xml.getValue().convertUInt64();
+                     haveSequence = true;
+                     xml.parent();
+                  }
+               }
+            } while(xml.nextSibling());
             xml.parent();
          }
       }
       xml.parent();
    }
 
-   if(version == REGSYNC_VERSION)
+   if(version != REGSYNC_VERSION)
+   {
+      sendResponse(connectionId, requestId, Data::Empty, 505, "Version not supported.");
+      return;
+   }
+
+   if(!isEqualNoCase(encoding, "binary"))
    {
       if (mRegDb)
       {
@@ -284,10 +342,130 @@ RegSyncServer::handleInitialSyncRequest(unsigned int connectionId, unsigned int
          mPubDb->initialSync(connectionId);
       }
       sendResponse(connectionId, requestId, Data::Empty, 200, "Initial Sync Completed.");
+      return;
    }
-   else
+
+   UInt64 startTime = Timer::getTimeMs();
+   UInt64 startSequence;
    {
-      sendResponse(connectionId, requestId, Data::Empty, 505, "Version not supported.");
+      Lock lock(mReplicationMutex);
+      // Anything already batched goes out to the other binary peers before this one is switched over
+      flushPendingBatch();
+      mXmlConnections.erase(connectionId);
+      mBinaryConnections.insert(connectionId);
+      if(haveSequence && resumeSync(connectionId, serverId, lastSequence))
+      {
+         sendResponse(connectionId, requestId, Data::Empty, 200, "Initial Sync Resumed.");
+         return;
+      }
+      // Switch the connection to the binary format now, so that it also receives changes made while
+      // the databases are dumped below.  The peer resolves any overlap using the last updated times.
+      sendEvent(connectionId, Data::Empty, BinaryEventFormat);
+      startSequence = mSequence;
+   }
+
+   mSyncConnectionId = connectionId;
+   mSyncRecords = 0;
+   if (mRegDb)
+   {
+      mRegDb->initialSync(connectionId);
+   }
+   if (mPubDb)
+   {
+      mPubDb->initialSync(connectionId);
+   }
+   flushSyncBatch();
+   mSyncConnectionId = 0;
+
+   Data frame;
+   Data::size_type frameStart = RegSyncProtocol::startFrame(frame, Timer::getTimeSecs());
+   RegSyncProtocol::encodeSyncComplete(frame, mServerId, startSequence, false /* resumed */);
+   RegSyncProtocol::endFrame(frame, frameStart);
+   sendEvent(connectionId, frame, BinaryEventFormat);
+
+   UInt64 elapsedMs = Timer::getTimeMs() - startTime;
+   {
+      Lock lock(mReplicationMutex);
+      mStats.mFramesSent++;
+      mStats.mBytesSent += frame.size();
+      mStats.mFullSyncs++;
+      mStats.mLastSyncRecords = mSyncRecords;
+      mStats.mLastSyncMs = elapsedMs;
+   }
+   InfoLog(<< "RegSyncServer::handleInitialSyncRequest: binary initial sync of " << mSyncRecords << " records to connection=" << connectionId 
+           << " queued in " << elapsedMs << "ms (" << (elapsedMs ? mSyncRecords * 1000 / elapsedMs : mSyncRecords) << " records/s)");
+   sendResponse(connectionId, requestId, Data::Empty, 200, "Initial Sync Completed.");
+}
+
+bool
+RegSyncServer::resumeSync(unsigned int connectionId, const Data& serverId, UInt64 lastSequence)
+{
+   if(serverId != mServerId || lastSequence > mSequence)
+   {
+      InfoLog(<< "RegSyncServer::resumeSync: peer state is from a different server instance, full sync required");
+      return false;
+   }
+
+   // Sequence numbers in the backlog are contiguous
+   Backlog::const_iterator it = mBacklog.end();
+   if(lastSequence < mSequence)
+   {
+      if(mBacklog.empty() || mBacklog.front().first > lastSequence + 1)
+      {
+         InfoLog(<< "RegSyncServer::resumeSync: backlog no longer contains sequence " << lastSequence + 1 << ", full sync required");
+         return false;
+      }
+      it = mBacklog.begin() + (Backlog::difference_type)(lastSequence + 1 - mBacklog.front().first);
+   }
+
+   UInt64 records = mSequence - lastSequence;
+   sendFrames(connectionId, it);
+
+   Data frame;
+   Data::size_type frameStart = RegSyncProtocol::startFrame(frame, Timer::getTimeSecs());
+   RegSyncProtocol::encodeSyncComplete(frame, mServerId, mSequence, true /* resumed */);
+   RegSyncProtocol::endFrame(frame, frameStart);
+   sendEvent(connectionId, frame, BinaryEventFormat);
+   mStats.mFramesSent++;
+   mStats.mBytesSent += frame.size();
+   mStats.mResumedSyncs++;
+   mStats.mLastSyncRecords = records;
+   mStats.mLastSyncMs = 0;
+
+   InfoLog(<< "RegSyncServer::resumeSync: resuming connection=" << connectionId << " after sequence " << lastSequence << ", replaying " << records << " records");
+   return true;
+}
+
+void
+RegSyncServer::sendFrames(unsigned int connectionId, Backlog::const_iterator it)
+{
+   UInt64 now = Timer::getTimeSecs();
+   Data frame;
+   Data::size_type frameStart = 0;
+   unsigned int records = 0;
+   for(; it != mBacklog.end(); it++)
+   {
+      if(records == 0)
+      {
+         frameStart = RegSyncProtocol::startFrame(frame, now);
+      }
+      frame += it->second;
+      if(++records == mBatchSize)
+      {
+         RegSyncProtocol::endFrame(frame, frameStart);
+         mStats.mFramesSent++;
+         records = 0;
+      }
+   }
+   if(records > 0)
+   {
+      RegSyncProtocol::endFrame(frame, frameStart);
+      mStats.mFramesSent++;
+   }
+   if(!frame.empty())
+   {
+      mStats.mBytesSent += frame.size();
+      sendEvent(connectionId, frame, BinaryEventFormat);
    }
 }
 
@@ -336,33 +514,237 @@ RegSyncServer::streamContactInstanceRecord(std::stringstream& ss, const ContactI
 void 
 RegSyncServer::onAorModified(const resip::Uri& aor, const ContactList& contacts)
 {
-   sendRegistrationModifiedEvent(0, aor, contacts);
+   Lock lock(mReplicationMutex);
+   if(wantBinary())
+   {
+      Data record;
+      if(RegSyncProtocol::encodeAor(record, mSequence + 1, aor, contacts, Timer::getTimeSecs()))
+      {
+         addRecord(++mSequence, record);
+      }
+   }
+   if(wantXml())
+   {
+      mStats.mXmlEventsSent++;
+      sendRegistrationModifiedEvent(0, aor, contacts);
+   }
 }
 
 void 
 RegSyncServer::onInitialSyncAor(unsigned int connectionId, const resip::Uri& aor, const ContactList& contacts)
 {
-   sendRegistrationModifiedEvent(connectionId, aor, contacts);
+   if(connectionId == mSyncConnectionId)
+   {
+      UInt64 now = Timer::getTimeSecs();
+      if(mSyncBatch.empty())
+      {
+         RegSyncProtocol::startFrame(mSyncBatch, now);
+      }
+      if(RegSyncProtocol::encodeAor(mSyncBatch, 0, aor, contacts, now))
+      {
+         syncRecordAdded();
+      }
+   }
+   else
+   {
+      sendRegistrationModifiedEvent(connectionId, aor, contacts);
+   }
 }
 
 void 
 RegSyncServer::onDocumentModified(bool sync, const Data& eventType, const Data& documentKey, const Data& eTag, UInt64 expirationTime, UInt64 lastUpdated, const Contents* contents, const SecurityAttributes* securityAttributes)
 {
    resip_assert(!sync);  // We register so that we don't get callbacks for sync'd documents
-   sendDocumentModifiedEvent(0, eventType, documentKey, eTag, expirationTime, lastUpdated, contents, securityAttributes);
+   Lock lock(mReplicationMutex);
+   if(wantBinary())
+   {
+      Data record;
+      RegSyncProtocol::encodeDocument(record, mSequence + 1, eventType, documentKey, eTag, expirationTime, lastUpdated, contents, securityAttributes, Timer::getTimeSecs());
+      addRecord(++mSequence, record);
+   }
+   if(wantXml())
+   {
+      mStats.mXmlEventsSent++;
+      sendDocumentModifiedEvent(0, eventType, documentKey, eTag, expirationTime, lastUpdated, contents, securityAttributes);
+   }
 }
 
 void 
 RegSyncServer::onDocumentRemoved(bool sync, const Data& eventType, const Data& documentKey, const Data& eTag, UInt64 lastUpdated)
 {
    resip_assert(!sync);  // We register so that we don't get callbacks for sync'd documents
-   sendDocumentRemovedEvent(0, eventType, documentKey, eTag, lastUpdated);
+   Lock lock(mReplicationMutex);
+   if(wantBinary())
+   {
+      Data record;
+      RegSyncProtocol::encodeDocument(record, mSequence + 1, eventType, documentKey, eTag, 0 /* expirationTime */, lastUpdated, 0, 0, Timer::getTimeSecs());
+      addRecord(++mSequence, record);
+   }
+   if(wantXml())
+   {
+      mStats.mXmlEventsSent++;
+      sendDocumentRemovedEvent(0, eventType, documentKey, eTag, lastUpdated);
+   }
 }
 
 void 
 RegSyncServer::onInitialSyncDocument(unsigned int connectionId, const Data& eventType, const Data& documentKey, const Data& eTag, UInt64 expirationTime, UInt64 lastUpdated, const Contents* contents, const SecurityAttributes* securityAttributes)
 {
-   sendDocumentModifiedEvent(connectionId, eventType, documentKey, eTag, expirationTime, lastUpdated, contents, securityAttributes);
+   if(connectionId == mSyncConnectionId)
+   {
+      UInt64 now = Timer::getTimeSecs();
+      if(mSyncBatch.empty())
+      {
+         RegSyncProtocol::startFrame(mSyncBatch, now);
+      }
+      RegSyncProtocol::encodeDocument(mSyncBatch, 0, eventType, documentKey, eTag, expirationTime, lastUpdated, contents, securityAttributes, now);
+      syncRecordAdded();
+   }
+   else
+   {
+      sendDocumentModifiedEvent(connectionId, eventType, documentKey, eTag, expirationTime, lastUpdated, contents, securityAttributes);
+   }
+}
+
+void
+RegSyncServer::addRecord(UInt64 sequence, const Data& record)
+{
+   if(mBacklogSize > 0)
+   {
+      mBacklog.push_back(std::make_pair(sequence, record));
+      while(mBacklog.size() > mBacklogSize)
+      {
+         mBacklog.pop_front();
+      }
+   }
+   if(!mBinaryConnections.empty())
+   {
+      mPendingBatch += record;
+      mStats.mRecordsReplicated++;
+      if(++mPendingRecords >= mBatchSize)
+      {
+         flushPendingBatch();
+      }
+      else if(mPendingRecords == 1)
+      {
+         // Changes that arrive before the server thread gets to run are sent in the same frame
+         wakeup();
+      }
+   }
+}
+
+void
+RegSyncServer::flushPendingBatch()
+{
+   if(mPendingRecords == 0)
+   {
+      return;
+   }
+   Data frame(RegSyncProtocol::FrameHeaderSize + 10 + mPendingBatch.size(), Data::Preallocate);
+   Data::size_type frameStart = RegSyncProtocol::startFrame(frame, Timer::getTimeSecs());
+   frame += mPendingBatch;
+   RegSyncProtocol::endFrame(frame, frameStart);
+   sendEvent(0, frame, BinaryEventFormat);
+   mStats.mFramesSent++;
+   mStats.mBytesSent += frame.size();
+   mPendingBatch.clear();
+   mPendingRecords = 0;
+}
+
+void
+RegSyncServer::syncRecordAdded()
+{
+   mSyncRecords++;
+   if(++mSyncBatchRecords >= mBatchSize)
+   {
+      flushSyncBatch();
+   }
+}
+
+void
+RegSyncServer::flushSyncBatch()
+{
+   if(mSyncBatchRecords > 0)
+   {
+      RegSyncProtocol::endFrame(mSyncBatch, 0);
+      sendEvent(mSyncConnectionId, mSyncBatch, BinaryEventFormat);
+      Lock lock(mReplicationMutex);
+      mStats.mFramesSent++;
+      mStats.mBytesSent += mSyncBatch.size();
+   }
+   mSyncBatch.clear();
+   mSyncBatchRecords = 0;
+}
+
+void
+RegSyncServer::preProcess()
+{
+   Lock lock(mReplicationMutex);
+   flushPendingBatch();
+}
+
+void
+RegSyncServer::onConnectionOpened(unsigned int connectionId)
+{
+   Lock lock(mReplicationMutex);
+   mXmlConnections.insert(connectionId);
+}
+
+void
+RegSyncServer::onConnectionClosed(unsigned int connectionId)
+{
+   Lock lock(mReplicationMutex);
+   mXmlConnections.erase(connectionId);
+   mBinaryConnections.erase(connectionId);
+}
+
+void
+RegSyncServer::setBacklogSize(unsigned int backlogSize)
+{
+   Lock lock(mReplicationMutex);
+   mBacklogSize = backlogSize;
+   while(mBacklog.size() > mBacklogSize)
+   {
+      mBacklog.pop_front();
+   }
+}
+
+void
+RegSyncServer::setBatchSize(unsigned int batchSize)
+{
+   Lock lock(mReplicationMutex);
+   mBatchSize = batchSize > 0 ? batchSize : 1;
+}
+
+RegSyncServer::Stats
+RegSyncServer::getStats()
+{
+   Lock lock(mReplicationMutex);
+   Stats stats = mStats;
+   stats.mSequence = mSequence;
+   stats.mBacklogSize = mBacklog.size();
+   stats.mBinaryPeers = mBinaryConnections.size();
+   stats.mXmlPeers = mXmlConnections.size();
+   return stats;
+}
+
+void
+RegSyncServer::encodeStats(EncodeStream& strm)
+{
+   Stats stats = getStats();
+   strm << "ServerId=" << mServerId
+        << " Sequence=" << stats.mSequence
+        << " Backlog=" << stats.mBacklogSize
+        << " BinaryPeers=" << stats.mBinaryPeers
+        << " XmlPeers=" << stats.mXmlPeers << endl;
+   strm << "RecordsReplicated=" << stats.mRecordsReplicated
+        << " FramesSent=" << stats.mFramesSent
+        << " BytesSent=" << stats.mBytesSent
+        << " XmlEventsSent=" << stats.mXmlEventsSent << endl;
+   strm << "FullSyncs=" << stats.mFullSyncs
+        << " ResumedSyncs=" << stats.mResumedSyncs
+        << " LastSyncRecords=" << stats.mLastSyncRecords
+        << " LastSyncMs=" << stats.mLastSyncMs << endl;
 }
 
 
@@ -1,7 +1,10 @@
 #if !defined(RegSyncServer_hxx)
 #define RegSyncServer_hxx 
 
+#include <deque>
+#include <set>
 #include <rutil/Data.hxx>
+#include <rutil/Mutex.hxx>
 #include <rutil/TransportType.hxx>
 #include <rutil/XMLCursor.hxx>
 #include <resip/dum/InMemorySyncRegDb.hxx>
@@ -28,6 +31,39 @@ public:
                  resip::InMemorySyncPubDb* pubDb = 0);
    virtual ~RegSyncServer();
 
+   // Event formats used on XmlRpcServerBase connections
+   static const unsigned int XmlEventFormat = 0;
+   static const unsigned int BinaryEventFormat = 1;
+
+   // Number of replicated changes remembered so that a peer using the binary protocol can resume
+   // after a reconnect without a full initial sync (0 disables resuming)
+   void setBacklogSize(unsigned int backlogSize);
+   // Maximum number of records sent in one binary frame
+   void setBatchSize(unsigned int batchSize);
+
+   class Stats
+   {
+   public:
+      Stats() : mRecordsReplicated(0), mFramesSent(0), mBytesSent(0), mXmlEventsSent(0),
+                mFullSyncs(0), mResumedSyncs(0), mLastSyncRecords(0), mLastSyncMs(0),
+                mSequence(0), mBacklogSize(0), mBinaryPeers(0), mXmlPeers(0) {}
+      UInt64 mRecordsReplicated;  // changes replicated to binary peers (excludes initial syncs)
+      UInt64 mFramesSent;
+      UInt64 mBytesSent;
+      UInt64 mXmlEventsSent;
+      UInt64 mFullSyncs;
+      UInt64 mResumedSyncs;
+      UInt64 mLastSyncRecords;
+      UInt64 mLastSyncMs;
+      UInt64 mSequence;
+      size_t mBacklogSize;
+      size_t mBinaryPeers;
+      size_t mXmlPeers;
+   };
+   // thread safe
+   Stats getStats();
+   void encodeStats(EncodeStream& strm);
+
    // thread safe
    virtual void sendResponse(unsigned int connectionId, 
                              unsigned int requestId, 
@@ -44,6 +80,11 @@ public:
 protected:
    virtual void handleRequest(unsigned int connectionId, unsigned int requestId, const resip::Data& request); 
 
+   // XmlRpcServerBase methods
+   virtual void preProcess();
+   virtual void onConnectionOpened(unsigned int connectionId);
+   virtual void onConnectionClosed(unsigned int connectionId);
+
    // InMemorySyncRegDbHandler methods
    virtual void onAorModified(const resip::Uri& aor, const resip::ContactList& contacts);
    virtual void onInitialSyncAor(unsigned int connectionId, const resip::Uri& aor, const resip::ContactList& contacts);
@@ -56,9 +97,42 @@ protected:
 private: 
    void handleInitialSyncRequest(unsigned int connectionId, unsigned int requestId, resip::XMLCursor& xml);
    void streamContactInstanceRecord(std::stringstream& ss, const resip::ContactInstanceRecord& rec);
+   void init();
+
+   // Binary replication - all called with mReplicationMutex locked
+   bool wantXml() const { return mAlwaysSendXml || !mXmlConnections.empty(); }
+   bool wantBinary() const { return mBacklogSize > 0 || !mBinaryConnections.empty(); }
+   void addRecord(UInt64 sequence, const resip::Data& record);
+   void flushPendingBatch();
+   bool resumeSync(unsigned int connectionId, const resip::Data& serverId, UInt64 lastSequence);
+   void sendFrames(unsigned int connectionId, std::deque<std::pair<UInt64, resip::Data> >::const_iterator begin);
+
+   // Initial sync - only accessed from the thread calling process
+   void syncRecordAdded();
+   void flushSyncBatch();
 
    resip::InMemorySyncRegDb* mRegDb;
    resip::InMemorySyncPubDb* mPubDb;
+
+   resip::Data mServerId;  // changes on every restart, so that peers know sequence numbers are not comparable
+   unsigned int mBacklogSize;
+   unsigned int mBatchSize;
+   bool mAlwaysSendXml;  // AMQP - there are no connections
+
+   resip::Mutex mReplicationMutex;
+   UInt64 mSequence;
+   typedef std::deque<std::pair<UInt64, resip::Data> > Backlog;
+   Backlog mBacklog;
+   resip::Data mPendingBatch;
+   unsigned int mPendingRecords;
+   std::set<unsigned int> mBinaryConnections;
+   std::set<unsigned int> mXmlConnections;
+   Stats mStats;
+
+   unsigned int mSyncConnectionId;
+   resip::Data mSyncBatch;
+   unsigned int mSyncBatchRecords;
+   UInt64 mSyncRecords;
 };
 
 }
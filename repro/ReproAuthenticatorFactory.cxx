@@ -180,6 +180,7 @@ ReproAuthenticatorFactory::getServerAuthManager()
          mServerAuthManager.reset(new ReproServerAuthManager(*mDum,
                                   getDispatcher(),
                                   mProxyConfig.getDataStore()->mAclStore,
+                                  mProxyConfig.getDataStore()->mUserStore,
                                   !mProxyConfig.getConfigBool("DisableAuthInt", false) /*useAuthInt*/,
                                   mProxyConfig.getConfigBool("RejectBadNonces", false),
                                   mDigestChallengeThirdParties,
@@ -39,6 +39,7 @@
 #include "resip/stack/HEPSipMessageLoggingHandler.hxx"
 #include "resip/stack/InteropHelper.hxx"
 #include "resip/stack/ConnectionManager.hxx"
+#include "resip/stack/ParseStatistics.hxx"
 #include "resip/stack/TransactionState.hxx"
 #include "resip/stack/WsCookieContextFactory.hxx"
 
@@ -67,6 +68,9 @@
 #include "repro/RegSyncClient.hxx"
 #include "repro/RegSyncServer.hxx"
 #include "repro/RegSyncServerThread.hxx"
+#if !defined(WIN32)
+#include "repro/PersistentRegDb.hxx"
+#endif
 #include "repro/CommandServer.hxx"
 #include "repro/CommandServerThread.hxx"
 #include "repro/BasicWsConnectionValidator.hxx"
@@ -815,7 +819,8 @@ ReproRunner::createSipStack()
    {
       int capturePort = mProxyConfig->getConfigInt("CapturePort", 9060);
       int captureAgentID = mProxyConfig->getConfigInt("CaptureAgentID", 2001);
-      SharedPtr<HepAgent> agent(new HepAgent(captureHost, capturePort, captureAgentID));
+      unsigned int captureQueueSize = mProxyConfig->getConfigUnsignedLong("CaptureQueueSize", HepAgent::DefaultQueueSize);
+      SharedPtr<HepAgent> agent(new HepAgent(captureHost, capturePort, captureAgentID, captureQueueSize));
       mSipStack->setTransportSipMessageLoggingHandler(SharedPtr<HEPSipMessageLoggingHandler>(new HEPSipMessageLoggingHandler(agent)));
    }
    else if(mProxyConfig->getConfigBool("EnableSipMessageLogging", false))
@@ -874,6 +879,10 @@ ReproRunner::createSipStack()
    bool forceRecordRoute = mProxyConfig->getConfigBool("ForceRecordRouting", false);
    Uri recordRouteUri;
    mProxyConfig->getConfigValue("RecordRouteUri", recordRouteUri);
+   if(!recordRouteUri.host().empty())
+   {
+      Data::intern(recordRouteUri.host());
+   }
    if((InteropHelper::getOutboundSupported() 
          || InteropHelper::getRRTokenHackEnabled()
          || InteropHelper::getClientNATDetectionMode() != InteropHelper::ClientNATDetectionDisabled
@@ -903,6 +912,8 @@ ReproRunner::createSipStack()
    {
       mSipStack->statisticsManagerEnabled() = false;
    }
+   ParseStatistics::setEnabled(mProxyConfig->getConfigBool("ParseStatistics", false));
+   mSipStack->setPassThroughUntouchedHeaders(mProxyConfig->getConfigBool("PassThroughUntouchedHeaders", false));
 
    // Create Congestion Manager, if required
    resip_assert(!mCongestionManager);
@@ -1016,6 +1027,10 @@ ReproRunner::createDatastore()
       return false;
    }
    mProxyConfig->createDataStore(mAbstractDb, mRuntimeAbstractDb);
+   mProxyConfig->getDataStore()->mUserStore.setAuthCacheParameters(
+      mProxyConfig->getConfigUnsignedLong("UserAuthCacheSize", 10000),
+      mProxyConfig->getConfigUnsignedLong("UserAuthCacheTTL", 300),
+      mProxyConfig->getConfigUnsignedLong("UserAuthCacheNegativeTTL", 30));
 
    // Create ImMemory Registration Database
    mRegSyncPort = mProxyConfig->getConfigInt("RegSyncPort", 0);
@@ -1023,7 +1038,22 @@ ReproRunner::createDatastore()
    if(!mRestarting)  // If we are restarting then we left the InMemorySyncRegDb and InMemorySyncPubDb intact at restart - don't recreate
    {
       resip_assert(!mRegistrationPersistenceManager);
-      mRegistrationPersistenceManager = new InMemorySyncRegDb(mRegSyncPort ? 86400 /* 24 hours */ : 0 /* removeLingerSecs */);  // !slg! could make linger time a setting
+      unsigned int removeLingerSecs = mRegSyncPort ? 86400 /* 24 hours */ : 0;  // !slg! could make linger time a setting
+      Data registrationLogFile = mProxyConfig->getConfigData("RegistrationLogFile", "", true);
+      if(!registrationLogFile.empty())
+      {
+#if !defined(WIN32)
+         mRegistrationPersistenceManager = new PersistentRegDb(mProxyConfig->getConfigData("DatabasePath", "./", true) + registrationLogFile,
+                                                               removeLingerSecs,
+                                                               mProxyConfig->getConfigUnsignedLong("RegistrationLogCommitInterval", 200));
+#else
+         ErrLog(<< "RegistrationLogFile is not supported on this platform, registrations will be kept in memory only");
+#endif
+      }
+      if(!mRegistrationPersistenceManager)
+      {
+         mRegistrationPersistenceManager = new InMemorySyncRegDb(removeLingerSecs);
+      }
       resip_assert(!mPublicationPersistenceManager);
       mPublicationPersistenceManager = new InMemorySyncPubDb((mRegSyncPort && mProxyConfig->getConfigBool("EnablePublicationReplication", false)) ? true : false);
    }
@@ -1274,6 +1304,7 @@ ReproRunner::createProxy()
        it != mStartupTransportRecordRoutes.end(); it++)
    {
        mProxy->addTransportRecordRoute(it->first, it->second);
+       Data::intern(it->second.uri().host());
    }
 
    return true;
@@ -1424,12 +1455,16 @@ ReproRunner::createRegSync()
    bool enablePublicationReplication = mProxyConfig->getConfigBool("EnablePublicationReplication", false);
    if(mRegSyncPort != 0)
    {
+      unsigned long backlogSize = mProxyConfig->getConfigUnsignedLong("RegSyncBacklogSize", 50000);
+      unsigned long batchSize = mProxyConfig->getConfigUnsignedLong("RegSyncBatchSize", 256);
       std::list<RegSyncServer*> regSyncServerList;
       if(mUseV4) 
       {
          mRegSyncServerV4 = new RegSyncServer(dynamic_cast<InMemorySyncRegDb*>(mRegistrationPersistenceManager), 
                                               mRegSyncPort, V4, 
                                               enablePublicationReplication ? dynamic_cast<InMemorySyncPubDb*>(mPublicationPersistenceManager) : 0);
+         mRegSyncServerV4->setBacklogSize(backlogSize);
+         mRegSyncServerV4->setBatchSize(batchSize);
          regSyncServerList.push_back(mRegSyncServerV4);
       }
       if(mUseV6) 
@@ -1437,6 +1472,8 @@ ReproRunner::createRegSync()
          mRegSyncServerV6 = new RegSyncServer(dynamic_cast<InMemorySyncRegDb*>(mRegistrationPersistenceManager),
                                               mRegSyncPort, V6,
                                               enablePublicationReplication ? dynamic_cast<InMemorySyncPubDb*>(mPublicationPersistenceManager) : 0);
+         mRegSyncServerV6->setBacklogSize(backlogSize);
+         mRegSyncServerV6->setBatchSize(batchSize);
          regSyncServerList.push_back(mRegSyncServerV6);
       }
       if(!regSyncServerList.empty())
@@ -1453,7 +1490,8 @@ ReproRunner::createRegSync()
          }
          mRegSyncClient = new RegSyncClient(dynamic_cast<InMemorySyncRegDb*>(mRegistrationPersistenceManager),
                                             regSyncPeerAddress, remoteRegSyncPort,
-                                            enablePublicationReplication ? dynamic_cast<InMemorySyncPubDb*>(mPublicationPersistenceManager) : 0);
+                                            enablePublicationReplication ? dynamic_cast<InMemorySyncPubDb*>(mPublicationPersistenceManager) : 0,
+                                            mProxyConfig->getConfigBool("RegSyncBinaryProtocol", true));
       }
    }
    Data regSyncBrokerTopic = mProxyConfig->getConfigData("RegSyncBrokerTopic", Data::Empty);
@@ -59,6 +59,11 @@ public:
    virtual void onReload();
 
    virtual Proxy* getProxy() { return mProxy; }
+   virtual RegSyncClient* getRegSyncClient() { return mRegSyncClient; }
+   virtual RegSyncServer* getRegSyncServerV4() { return mRegSyncServerV4; }
+   virtual RegSyncServer* getRegSyncServerV6() { return mRegSyncServerV6; }
+   virtual AbstractDb* getAbstractDb() { return mAbstractDb; }
+   virtual AbstractDb* getRuntimeAbstractDb() { return mRuntimeAbstractDb; }
 
    // External Stats handler
    virtual bool operator()(resip::StatisticsMessage &statsMessage);
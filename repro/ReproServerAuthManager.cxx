@@ -17,6 +17,7 @@ using namespace repro;
 ReproServerAuthManager::ReproServerAuthManager(DialogUsageManager& dum,
                                                Dispatcher* authRequestDispatcher,
                                                AclStore& aclDb,
+                                               UserStore& userStore,
                                                bool useAuthInt,
                                                bool rejectBadNonces,
                                                bool challengeThirdParties,
@@ -25,6 +26,7 @@ ReproServerAuthManager::ReproServerAuthManager(DialogUsageManager& dum,
    mDum(dum),
    mAuthRequestDispatcher(authRequestDispatcher),
    mAclDb(aclDb),
+   mUserStore(userStore),
    mUseAuthInt(useAuthInt),
    mRejectBadNonces(rejectBadNonces)
 {
@@ -69,6 +71,20 @@ ReproServerAuthManager::requestCredential(const Data& user,
 {
    // Build a UserAuthInfo object and pass to UserAuthGrabber to have a1 password filled in
    UserAuthInfo* async = new UserAuthInfo(user,realm,transactionId,&mDum);
+
+   // Unless the UserStore has it cached, in which case it goes straight back to DUM
+   Data a1;
+   if(mUserStore.getCachedUserAuthInfo(user, realm, a1))
+   {
+      async->setA1(a1);
+      if(a1.empty())
+      {
+         async->setMode(UserAuthInfo::UserUnknown);
+      }
+      mDum.post(async);
+      return;
+   }
+
    std::auto_ptr<ApplicationMessage> app(async);
    mAuthRequestDispatcher->post(app);
 }
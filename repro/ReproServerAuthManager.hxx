@@ -19,6 +19,7 @@ class DialogUsageManager;
 namespace repro
 {
 class AclStore;
+class UserStore;
 
 class ReproServerAuthManager: public resip::ServerAuthManager
 {
@@ -26,6 +27,7 @@ class ReproServerAuthManager: public resip::ServerAuthManager
       ReproServerAuthManager(resip::DialogUsageManager& dum, 
                              resip::Dispatcher* authRequestDispatcher,
                              AclStore& aclDb,
+                             UserStore& userStore,
                              bool useAuthInt,
                              bool rejectBadNonces,
                              bool challengeThirdParties,
@@ -49,6 +51,7 @@ class ReproServerAuthManager: public resip::ServerAuthManager
       resip::DialogUsageManager& mDum;
       resip::Dispatcher* mAuthRequestDispatcher;
       AclStore&  mAclDb;
+      UserStore& mUserStore;
       bool mUseAuthInt;
       bool mRejectBadNonces;
 };
@@ -12,6 +12,7 @@
 #include "resip/stack/SipStack.hxx"
 #include "resip/stack/Helper.hxx"
 #include "resip/stack/InteropHelper.hxx"
+#include "resip/stack/ParseStatistics.hxx"
 #include "rutil/Inserter.hxx"
 #include "rutil/Logger.hxx"
 
@@ -88,6 +89,7 @@ RequestContext::process(resip::TransactionTerminated& msg)
 void
 RequestContext::process(std::auto_ptr<resip::SipMessage> sipMessage)
 {
+   ParseStatistics::Scope parseScope("RequestContext");
    bool original = false;
    InfoLog (<< "RequestContext::process(SipMessage) " << sipMessage->getTransactionId());
 
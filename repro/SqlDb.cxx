@@ -10,6 +10,7 @@
 #include "rutil/DataStream.hxx"
 #include "rutil/Logger.hxx"
 #include "rutil/ParseBuffer.hxx"
+#include "rutil/Timer.hxx"
 
 #include "repro/AbstractDb.hxx"
 #include "repro/SqlDb.hxx"
@@ -21,10 +22,166 @@ using namespace std;
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::REPRO
 
-SqlDb::SqlDb(const resip::ConfigParse& config) : mConnected(false)
+SqlDb::SqlDb(const resip::ConfigParse& config) : 
+   mConnected(false),
+   mConnectionsInUse(0),
+   mMaxConnectionsInUse(0),
+   mInTransaction(false),
+   mQueryCount(0),
+   mPoolWaitCount(0),
+   mTotalQueryTimeMicroSec(0),
+   mMaxQueryTimeMicroSec(0)
 {
    mTlsPeerAuthorizationQuery = config.getConfigData("CustomTlsAuthQuery", "");
    mTableNamePrefix = config.getConfigData("TableNamePrefix", "");
+   unsigned long poolSize = config.getConfigData("ConnectionPoolSize", "4", true).convertUnsignedLong();
+   if(poolSize == 0)
+   {
+      poolSize = 1;
+   }
+   mConnectionBusy.resize(poolSize, false);
+}
+
+SqlDb::PooledConnection::PooledConnection(const SqlDb& db, bool isQuery) :
+   mDb(db),
+   mIndex(db.acquireConnection()),
+   mIsQuery(isQuery),
+   mStartTime(Timer::getTimeMicroSec())
+{
+}
+
+SqlDb::PooledConnection::~PooledConnection()
+{
+   mDb.releaseConnection(mIndex, mIsQuery, Timer::getTimeMicroSec() - mStartTime);
+}
+
+unsigned int
+SqlDb::acquireConnection() const
+{
+   Lock lock(mPoolMutex);
+   bool waited = false;
+   for(;;)
+   {
+      if(mInTransaction)
+      {
+         if(!mConnectionBusy[0])
+         {
+            break;
+         }
+      }
+      else
+      {
+         // Lowest free slot first, so that connections beyond what the load
+         // actually needs are never opened
+         for(unsigned int i = 0; i < mConnectionBusy.size(); i++)
+         {
+            if(!mConnectionBusy[i])
+            {
+               mConnectionBusy[i] = true;
+               if(++mConnectionsInUse > mMaxConnectionsInUse)
+               {
+                  mMaxConnectionsInUse = mConnectionsInUse;
+               }
+               return i;
+            }
+         }
+      }
+      if(!waited)
+      {
+         waited = true;
+         mPoolWaitCount++;
+      }
+      mPoolCondition.wait(mPoolMutex);
+   }
+   mConnectionBusy[0] = true;
+   if(++mConnectionsInUse > mMaxConnectionsInUse)
+   {
+      mMaxConnectionsInUse = mConnectionsInUse;
+   }
+   return 0;
+}
+
+void
+SqlDb::releaseConnection(unsigned int index, bool isQuery, UInt64 heldMicroSec) const
+{
+   Lock lock(mPoolMutex);
+   resip_assert(index < mConnectionBusy.size() && mConnectionBusy[index]);
+   mConnectionBusy[index] = false;
+   mConnectionsInUse--;
+   if(isQuery)
+   {
+      mQueryCount++;
+      mTotalQueryTimeMicroSec += heldMicroSec;
+      if(heldMicroSec > mMaxQueryTimeMicroSec)
+      {
+         mMaxQueryTimeMicroSec = heldMicroSec;
+      }
+   }
+   // Waiters may be waiting for any slot or for slot 0 only
+   mPoolCondition.broadcast();
+}
+
+void
+SqlDb::setInTransaction(bool inTransaction) const
+{
+   Lock lock(mPoolMutex);
+   mInTransaction = inTransaction;
+   mPoolCondition.broadcast();
+}
+
+unsigned int
+SqlDb::getConnectionsInUse() const
+{
+   Lock lock(mPoolMutex);
+   return mConnectionsInUse;
+}
+
+unsigned int
+SqlDb::getMaxConnectionsInUse() const
+{
+   Lock lock(mPoolMutex);
+   return mMaxConnectionsInUse;
+}
+
+UInt64
+SqlDb::getQueryCount() const
+{
+   Lock lock(mPoolMutex);
+   return mQueryCount;
+}
+
+UInt64
+SqlDb::getPoolWaitCount() const
+{
+   Lock lock(mPoolMutex);
+   return mPoolWaitCount;
+}
+
+UInt64
+SqlDb::getTotalQueryTimeMicroSec() const
+{
+   Lock lock(mPoolMutex);
+   return mTotalQueryTimeMicroSec;
+}
+
+UInt64
+SqlDb::getMaxQueryTimeMicroSec() const
+{
+   Lock lock(mPoolMutex);
+   return mMaxQueryTimeMicroSec;
+}
+
+void
+SqlDb::encodeStats(EncodeStream& strm) const
+{
+   Lock lock(mPoolMutex);
+   strm << "Connection pool size: " << mConnectionBusy.size() << std::endl;
+   strm << "Connections in use: " << mConnectionsInUse << std::endl;
+   strm << "Max connections in use: " << mMaxConnectionsInUse << std::endl;
+   strm << "Pool waits: " << mPoolWaitCount << std::endl;
+   strm << "Queries: " << mQueryCount << std::endl;
+   strm << "Average query time (us): " << (mQueryCount ? mTotalQueryTimeMicroSec / mQueryCount : 0) << std::endl;
+   strm << "Max query time (us): " << mMaxQueryTimeMicroSec << std::endl;
 }
 
 void 
@@ -138,14 +295,18 @@ bool
 SqlDb::dbCommitTransaction(const Table table)
 {
    Data command("COMMIT");
-   return query(command) == 0;
+   bool success = query(command) == 0;
+   setInTransaction(false);
+   return success;
 }
 
 bool 
 SqlDb::dbRollbackTransaction(const Table table)
 {
    Data command("ROLLBACK");
-   return query(command) == 0;
+   bool success = query(command) == 0;
+   setInTransaction(false);
+   return success;
 }
 
 static const char userTable[] = "users";
@@ -1,8 +1,13 @@
 #if !defined(RESIP_SQLDB_HXX)
 #define RESIP_SQLDB_HXX 
 
+#include <vector>
+
 #include "rutil/ConfigParse.hxx"
+#include "rutil/Condition.hxx"
 #include "rutil/Data.hxx"
+#include "rutil/Mutex.hxx"
+#include "rutil/resipfaststreams.hxx"
 #include "repro/AbstractDb.hxx"
 
 namespace resip
@@ -28,19 +33,53 @@ class SqlDb: public AbstractDb
       // Perform a query that expects a single result/row - returns all column/field data in a vector
       virtual int singleResultQuery(const resip::Data& queryCommand, std::vector<resip::Data>& fields) const = 0;
 
+      // Connection pool and query statistics
+      unsigned int getPoolSize() const { return (unsigned int)mConnectionBusy.size(); }
+      unsigned int getConnectionsInUse() const;
+      unsigned int getMaxConnectionsInUse() const;
+      UInt64 getQueryCount() const;
+      UInt64 getPoolWaitCount() const;
+      UInt64 getTotalQueryTimeMicroSec() const;
+      UInt64 getMaxQueryTimeMicroSec() const;
+      void encodeStats(EncodeStream& strm) const;
+
    protected:
       virtual void setConnected(bool connected) const { mConnected = connected; }
       virtual bool isConnected() const { return mConnected; }
 
       void setToData(const std::set<resip::Data>& items, resip::Data& result, const resip::Data& sep = ",", const char quote = '\'') const;
 
-      // when multiple threads are in use with the same connection, you need to
-      // mutex calls to mysql_query and mysql_store_result:
-      // http://dev.mysql.com/doc/refman/5.1/en/threaded-clients.html
-      mutable resip::Mutex mMutex;
-
       resip::Data tableName( Table table ) const;
 
+      // The backends keep one connection (and its prepared statements) per
+      // pool slot.  A connection handle must only be used by the thread
+      // that holds its slot:
+      // http://dev.mysql.com/doc/refman/5.1/en/threaded-clients.html
+      // PooledConnection reserves a free slot for its lifetime, blocking
+      // while all slots are busy, and records the time it was held as the
+      // query latency.  While a transaction is open all queries are run on
+      // slot 0, so that they see the transaction as they did when there was
+      // a single shared connection.
+      class PooledConnection
+      {
+         public:
+            // isQuery is false for work such as string escaping that needs
+            // a connection but should not count as a query in the stats
+            PooledConnection(const SqlDb& db, bool isQuery = true);
+            ~PooledConnection();
+            unsigned int index() const { return mIndex; }
+
+         private:
+            const SqlDb& mDb;
+            unsigned int mIndex;
+            bool mIsQuery;
+            UInt64 mStartTime;
+      };
+      friend class PooledConnection;
+
+      // Backends call this around a transaction, see PooledConnection
+      void setInTransaction(bool inTransaction) const;
+
    private:
       // Db manipulation routines
       virtual void dbEraseRecord(const Table table, 
@@ -53,10 +92,24 @@ class SqlDb: public AbstractDb
       virtual int query(const resip::Data& queryCommand) const = 0;
       virtual resip::Data& escapeString(const resip::Data& str, resip::Data& escapedStr) const = 0;
 
+      unsigned int acquireConnection() const;
+      void releaseConnection(unsigned int index, bool isQuery, UInt64 heldMicroSec) const;
+
       mutable volatile bool mConnected;
       resip::Data mTlsPeerAuthorizationQuery;
       resip::Data mTableNamePrefix;
 
+      mutable resip::Mutex mPoolMutex;
+      mutable resip::Condition mPoolCondition;
+      mutable std::vector<bool> mConnectionBusy;
+      mutable unsigned int mConnectionsInUse;
+      mutable unsigned int mMaxConnectionsInUse;
+      mutable bool mInTransaction;
+      mutable UInt64 mQueryCount;
+      mutable UInt64 mPoolWaitCount;
+      mutable UInt64 mTotalQueryTimeMicroSec;
+      mutable UInt64 mMaxQueryTimeMicroSec;
+
       virtual void userWhereClauseToDataStream(const Key& key, resip::DataStream& ds) const = 0;
       virtual void tlsPeerIdentityWhereClauseToDataStream(const Key& key, resip::DataStream& ds) const = 0;
 };
@@ -7,6 +7,7 @@
 #include "rutil/DataStream.hxx"
 #include "resip/stack/Symbols.hxx"
 #include "rutil/Logger.hxx"
+#include "rutil/Timer.hxx"
 #include "resip/stack/TransactionUser.hxx"
 #include "resip/dum/UserAuthInfo.hxx"
 
@@ -23,7 +24,16 @@ using namespace std;
 
 const resip::Data UserStore::SEPARATOR("@");
 
-UserStore::UserStore(AbstractDb& db ) : mDb(db)
+UserStore::UserStore(AbstractDb& db ) : 
+   mDb(db),
+   mAuthCacheMaxEntries(0),
+   mAuthCacheTtlMs(0),
+   mAuthCacheNegativeTtlMs(0),
+   mAuthCacheGeneration(0),
+   mAuthCacheHits(0),
+   mAuthCacheNegativeHits(0),
+   mAuthCacheMisses(0),
+   mAuthCacheEvictions(0)
 { 
 }
 
@@ -41,8 +51,143 @@ Data
 UserStore::getUserAuthInfo(  const resip::Data& user, 
                              const resip::Data& realm ) const
 {
+   Data a1;
+   if(getCachedUserAuthInfo(user, realm, a1))
+   {
+      return a1;
+   }
+
+   UInt64 generation;
+   {
+      Lock lock(mAuthCacheMutex);
+      generation = mAuthCacheGeneration;
+      if(mAuthCacheMaxEntries != 0)
+      {
+         mAuthCacheMisses++;
+      }
+   }
    Key key =  buildKey(user, realm);
-   return mDb.getUserAuthInfo( key );
+   a1 = mDb.getUserAuthInfo( key );
+   cacheUserAuthInfo(key, a1, generation);
+   return a1;
+}
+
+void
+UserStore::setAuthCacheParameters(unsigned int maxEntries, unsigned int ttlSecs, unsigned int negativeTtlSecs)
+{
+   Lock lock(mAuthCacheMutex);
+   mAuthCacheMaxEntries = maxEntries;
+   mAuthCacheTtlMs = ttlSecs * 1000;
+   mAuthCacheNegativeTtlMs = negativeTtlSecs * 1000;
+   mAuthCache.clear();
+   mAuthCacheLru.clear();
+   mAuthCacheGeneration++;
+   InfoLog(<< "User auth cache: maxEntries=" << maxEntries << ", ttl=" << ttlSecs << "s, negativeTtl=" << negativeTtlSecs << "s");
+}
+
+bool
+UserStore::getCachedUserAuthInfo(const resip::Data& user,
+                                 const resip::Data& realm,
+                                 resip::Data& a1) const
+{
+   Lock lock(mAuthCacheMutex);
+   if(mAuthCacheMaxEntries == 0)
+   {
+      return false;
+   }
+
+   AuthCacheMap::iterator it = mAuthCache.find(buildKey(user, realm));
+   if(it == mAuthCache.end())
+   {
+      return false;
+   }
+   if(it->second.mExpires <= Timer::getTimeMs())
+   {
+      mAuthCacheLru.erase(it->second.mLruPos);
+      mAuthCache.erase(it);
+      return false;
+   }
+
+   mAuthCacheLru.splice(mAuthCacheLru.begin(), mAuthCacheLru, it->second.mLruPos);
+   a1 = it->second.mA1;
+   if(a1.empty())
+   {
+      mAuthCacheNegativeHits++;
+   }
+   else
+   {
+      mAuthCacheHits++;
+   }
+   return true;
+}
+
+void
+UserStore::cacheUserAuthInfo(const Key& key, const resip::Data& a1, UInt64 generation) const
+{
+   Lock lock(mAuthCacheMutex);
+   if(mAuthCacheMaxEntries == 0 || generation != mAuthCacheGeneration)
+   {
+      return;
+   }
+   unsigned int ttlMs = a1.empty() ? mAuthCacheNegativeTtlMs : mAuthCacheTtlMs;
+   if(ttlMs == 0)
+   {
+      return;
+   }
+
+   AuthCacheMap::iterator it = mAuthCache.find(key);
+   if(it != mAuthCache.end())
+   {
+      mAuthCacheLru.splice(mAuthCacheLru.begin(), mAuthCacheLru, it->second.mLruPos);
+   }
+   else
+   {
+      if(mAuthCache.size() >= mAuthCacheMaxEntries)
+      {
+         mAuthCache.erase(mAuthCacheLru.back());
+         mAuthCacheLru.pop_back();
+         mAuthCacheEvictions++;
+      }
+      mAuthCacheLru.push_front(key);
+      it = mAuthCache.insert(AuthCacheMap::value_type(key, AuthCacheEntry())).first;
+      it->second.mLruPos = mAuthCacheLru.begin();
+   }
+   it->second.mA1 = a1;
+   it->second.mExpires = Timer::getTimeMs() + ttlMs;
+}
+
+void
+UserStore::invalidateAuthCache(const resip::Data& user, const resip::Data& realm)
+{
+   Lock lock(mAuthCacheMutex);
+   mAuthCacheGeneration++;
+   AuthCacheMap::iterator it = mAuthCache.find(buildKey(user, realm));
+   if(it != mAuthCache.end())
+   {
+      mAuthCacheLru.erase(it->second.mLruPos);
+      mAuthCache.erase(it);
+   }
+}
+
+void
+UserStore::clearAuthCache()
+{
+   Lock lock(mAuthCacheMutex);
+   mAuthCacheGeneration++;
+   mAuthCache.clear();
+   mAuthCacheLru.clear();
+}
+
+void
+UserStore::encodeAuthCacheStats(EncodeStream& strm) const
+{
+   Lock lock(mAuthCacheMutex);
+   strm << "Max entries: " << mAuthCacheMaxEntries << std::endl;
+   strm << "Entries: " << mAuthCache.size() << std::endl;
+   strm << "Hits: " << mAuthCacheHits << std::endl;
+   strm << "Negative hits: " << mAuthCacheNegativeHits << std::endl;
+   strm << "Misses: " << mAuthCacheMisses << std::endl;
+   strm << "Evictions: " << mAuthCacheEvictions << std::endl;
 }
 
 bool 
@@ -91,13 +236,31 @@ UserStore::addUser( const Data& username,
    rec.email = emailAddress;
    rec.forwardAddress = Data::Empty;
 
-   return mDb.addUser( buildKey(username,domain), rec);
+   bool ret = mDb.addUser( buildKey(username,domain), rec);
+   invalidateAuthCache(username, realm);
+   if(realm != domain)
+   {
+      invalidateAuthCache(username, domain);
+   }
+   return ret;
 }
 
 void 
 UserStore::eraseUser( const Key& key )
 { 
+   // Authentication is looked up by user and realm - get the realm of the 
+   // user being erased so its cache entry can be dropped too
+   AbstractDb::UserRecord rec = mDb.getUser(key);
    mDb.eraseUser( key );
+
+   Data user;
+   Data domain;
+   getUserAndDomainFromKey(key, user, domain);
+   invalidateAuthCache(user, domain);
+   if(!rec.realm.empty() && rec.realm != domain)
+   {
+      invalidateAuthCache(user, rec.realm);
+   }
 }
 
 bool
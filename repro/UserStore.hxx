@@ -1,8 +1,13 @@
 #if !defined(REPRO_USERSTORE_HXX)
 #define REPRO_USERSTORE_HXX
 
+#include <list>
+
 #include "rutil/Data.hxx"
 #include "rutil/Fifo.hxx"
+#include "rutil/HashMap.hxx"
+#include "rutil/Mutex.hxx"
+#include "rutil/resipfaststreams.hxx"
 #include "resip/stack/Message.hxx"
 
 #include "repro/AbstractDb.hxx"
@@ -58,10 +63,53 @@ class UserStore
       static Key buildKey(const resip::Data& user, const resip::Data& domain);
       static void getUserAndDomainFromKey(const AbstractDb::Key& key, resip::Data& user, resip::Data& domain);
 
+      // getUserAuthInfo results (A1 hashes) are cached, so that digest
+      // authentication of users that re-register or call frequently does not
+      // need a database query each time.  Unknown users are cached too (with
+      // an empty A1) for negativeTtlSecs.  Entries for a user are dropped
+      // when it is added, updated or erased through this UserStore; changes
+      // made to the database by other means are seen once the entry expires
+      // or the cache is cleared.  When full, the least recently used entry
+      // is evicted.  A maxEntries of 0 disables the cache.
+      void setAuthCacheParameters(unsigned int maxEntries, unsigned int ttlSecs, unsigned int negativeTtlSecs);
+
+      // Returns true and sets a1 if a current entry for user/realm is cached -
+      // a1 is empty for a cached unknown user.  Never queries the database.
+      bool getCachedUserAuthInfo(const resip::Data& user,
+                                 const resip::Data& realm,
+                                 resip::Data& a1) const;
+      void invalidateAuthCache(const resip::Data& user, const resip::Data& realm);
+      void clearAuthCache();
+      void encodeAuthCacheStats(EncodeStream& strm) const;
+
    private:
+      void cacheUserAuthInfo(const Key& key, const resip::Data& a1, UInt64 generation) const;
 
       AbstractDb& mDb;
       static const resip::Data SEPARATOR;
+
+      class AuthCacheEntry
+      {
+         public:
+            resip::Data mA1;
+            UInt64 mExpires;  // ms
+            std::list<Key>::iterator mLruPos;
+      };
+      typedef HashMap<Key, AuthCacheEntry> AuthCacheMap;
+
+      mutable resip::Mutex mAuthCacheMutex;
+      mutable AuthCacheMap mAuthCache;
+      mutable std::list<Key> mAuthCacheLru;  // most recently used first
+      unsigned int mAuthCacheMaxEntries;
+      unsigned int mAuthCacheTtlMs;
+      unsigned int mAuthCacheNegativeTtlMs;
+      // Bumped by every invalidation, so that a database result that was read
+      // before an invalidation is not cached after it
+      UInt64 mAuthCacheGeneration;
+      mutable UInt64 mAuthCacheHits;
+      mutable UInt64 mAuthCacheNegativeHits;
+      mutable UInt64 mAuthCacheMisses;
+      mutable UInt64 mAuthCacheEvictions;
 };
 
  }
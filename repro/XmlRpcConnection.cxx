@@ -25,7 +25,9 @@ XmlRpcConnection::XmlRpcConnection(XmlRpcServerBase& server, resip::Socket sock)
    mXmlRcpServer(server),
    mConnectionId(NextConnectionId++),
    mNextRequestId(1),
-   mSock(sock)
+   mSock(sock),
+   mTxOffset(0),
+   mEventFormat(0)
 {
 	resip_assert(mSock > 0);
 }
@@ -177,10 +179,12 @@ XmlRpcConnection::processSomeWrites()
    
    //DebugLog (<< "XmlRpcConnection::processSomeWrites: Writing " << mTxBuffer );
 
+   const char* toWrite = mTxBuffer.data() + mTxOffset;
+   Data::size_type toWriteSize = mTxBuffer.size() - mTxOffset;
 #if defined(WIN32)
-   int bytesWritten = ::send(mSock, mTxBuffer.data(), (int)mTxBuffer.size(), 0);
+   int bytesWritten = ::send(mSock, toWrite, (int)toWriteSize, 0);
 #else
-   int bytesWritten = ::write(mSock, mTxBuffer.data(), mTxBuffer.size() );
+   int bytesWritten = ::write(mSock, toWrite, toWriteSize);
 #endif
 
    if (bytesWritten == INVALID_SOCKET)
@@ -192,19 +196,26 @@ XmlRpcConnection::processSomeWrites()
       return false;
    }
    
-   if (bytesWritten == (int)mTxBuffer.size())
+   if (bytesWritten == (int)toWriteSize)
    {
       DebugLog (<< "XmlRpcConnection::processSomeWrites - Wrote it all" );
-      mTxBuffer = Data::Empty;
+      mTxBuffer.clear();
+      mTxOffset = 0;
 
       //return false; // return false causes connection to close and clean up
       return true;  // keep connection up
    }
    else
    {
-      Data rest = mTxBuffer.substr(bytesWritten);
-      mTxBuffer = rest;
-      DebugLog( << "XmlRpcConnection::processSomeWrites - Wrote " << bytesWritten << " bytes - still need to do " << mTxBuffer );
+      // Don't copy the remainder down on every partial write - large event streams (ie. RegSync)
+      // would make this quadratic.  Compact once more than half of the buffer has been written.
+      mTxOffset += bytesWritten;
+      if (mTxOffset > mTxBuffer.size() / 2)
+      {
+         mTxBuffer = mTxBuffer.substr(mTxOffset);
+         mTxOffset = 0;
+      }
+      DebugLog( << "XmlRpcConnection::processSomeWrites - Wrote " << bytesWritten << " bytes - still need to do " << mTxBuffer.size() - mTxOffset << " bytes");
    }
    
    return true;
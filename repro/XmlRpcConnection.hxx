@@ -27,6 +27,9 @@ public:
    virtual bool sendResponse(unsigned int requestId, const resip::Data& responseData, bool isFinal);
    virtual void sendEvent(const resip::Data& eventData);
 
+   unsigned int getEventFormat() const { return mEventFormat; }
+   void setEventFormat(unsigned int eventFormat) { mEventFormat = eventFormat; }
+
 private:
    bool processSomeReads();
    bool processSomeWrites();
@@ -43,6 +46,8 @@ private:
    resip::Socket mSock;
    resip::Data mRxBuffer;
    resip::Data mTxBuffer;
+   resip::Data::size_type mTxOffset;  // bytes at the start of mTxBuffer that are already written
+   unsigned int mEventFormat;
 };
 
 }
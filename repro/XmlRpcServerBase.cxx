@@ -183,6 +183,8 @@ XmlRpcServerBase::process(FdSet& fdset)
    }
 #endif
 
+   preProcess();
+
    // Process Response fifo first
    while (mResponseFifo.messageAvailable())
    {
@@ -195,7 +197,10 @@ XmlRpcServerBase::process(FdSet& fdset)
             ConnectionMap::iterator it = mConnections.begin();
             for(; it != mConnections.end(); it++)
             {
-               it->second->sendEvent(responseInfo->getResponseData());
+               if(it->second->getEventFormat() == responseInfo->getEventFormat())
+               {
+                  it->second->sendEvent(responseInfo->getResponseData());
+               }
             }
          }
          else
@@ -203,7 +208,11 @@ XmlRpcServerBase::process(FdSet& fdset)
             ConnectionMap::iterator it = mConnections.find(responseInfo->getConnectionId());
             if(it != mConnections.end())
             {
-               it->second->sendEvent(responseInfo->getResponseData());
+               it->second->setEventFormat(responseInfo->getEventFormat());
+               if(!responseInfo->getResponseData().empty())
+               {
+                  it->second->sendEvent(responseInfo->getResponseData());
+               }
             }
          }
       }
@@ -254,6 +263,7 @@ XmlRpcServerBase::process(FdSet& fdset)
       mConnections[connection->getConnectionId()] = connection;
       
       DebugLog (<< "XmlRpcServerBase::process: Received TCP connection as connection=" << connection->getConnectionId() << " fd=" << (int)sock);
+      onConnectionOpened(connection->getConnectionId());
    }
 
    // Call process on each connection
@@ -263,8 +273,7 @@ XmlRpcServerBase::process(FdSet& fdset)
       bool ok = it->second->process(fdset);
       if (!ok)
       {
-         delete it->second;
-         mConnections.erase(it++);
+         closeConnection(it++);
       }
       else
       {
@@ -293,16 +302,26 @@ XmlRpcServerBase::sendResponse(unsigned int connectionId,
 
 void 
 XmlRpcServerBase::sendEvent(unsigned int connectionId,
-                            const Data& eventData)
+                            const Data& eventData,
+                            unsigned int eventFormat)
 {
 #ifdef BUILD_QPID_PROTON
    if(mQpidProtonThread.get())
    {
-      mQpidProtonThread->sendMessage(eventData);
+      if(eventFormat == 0)
+      {
+         mQpidProtonThread->sendMessage(eventData);
+      }
       return;
    }
 #endif
-   mResponseFifo.add(new ResponseInfo(connectionId, 0 /* requestId */, eventData, true /* isFinal */));
+   mResponseFifo.add(new ResponseInfo(connectionId, 0 /* requestId */, eventData, true /* isFinal */, eventFormat));
+   mSelectInterruptor.interrupt();
+}
+
+void
+XmlRpcServerBase::wakeup()
+{
    mSelectInterruptor.interrupt();
 }
 
@@ -324,7 +343,7 @@ XmlRpcServerBase::closeOldestConnection()
    if(mConnections.empty()) return;
 
    // Oldest Connection is the one with the lowest Id
-   ConnectionMap::iterator lowestConnectionIdIt = mConnections.end();
+   ConnectionMap::iterator lowestConnectionIdIt = mConnections.begin();
    ConnectionMap::iterator it = mConnections.begin();
    for(; it != mConnections.end(); it++)
    {
@@ -333,8 +352,16 @@ XmlRpcServerBase::closeOldestConnection()
          lowestConnectionIdIt = it;
       }
    }
-   delete lowestConnectionIdIt->second;
-   mConnections.erase(lowestConnectionIdIt);
+   closeConnection(lowestConnectionIdIt);
+}
+
+void
+XmlRpcServerBase::closeConnection(ConnectionMap::iterator it)
+{
+   unsigned int connectionId = it->first;
+   delete it->second;
+   mConnections.erase(it);
+   onConnectionClosed(connectionId);
 }
 
 void
@@ -29,11 +29,13 @@ public:
    ResponseInfo(unsigned int connectionId,
                 unsigned int requestId,
                 const resip::Data& responseData,
-                bool isFinal) :
+                bool isFinal,
+                unsigned int eventFormat = 0) :
       mConnectionId(connectionId),
       mRequestId(requestId),
       mResponseData(responseData),
-      mIsFinal(isFinal) {}
+      mIsFinal(isFinal),
+      mEventFormat(eventFormat) {}
 
    ~ResponseInfo() {}
 
@@ -41,12 +43,14 @@ public:
    unsigned int getRequestId() const { return mRequestId; }
    const resip::Data& getResponseData() const { return mResponseData; }
    bool getIsFinal() const { return mIsFinal; }
+   unsigned int getEventFormat() const { return mEventFormat; }
 
 private:
    unsigned int mConnectionId;
    unsigned int mRequestId;
    resip::Data mResponseData;
    bool mIsFinal;
+   unsigned int mEventFormat;
 };
 
 class XmlRpcServerBase
@@ -71,8 +75,13 @@ public:
                      bool isFinal=true);
 
    // thread safe - uses fifo (use connectionId == 0 to send to all connections)
+   // Connections start out receiving events of format 0.  An event sent to all connections is
+   // only delivered to connections using the same format, an event sent to a specific connection
+   // switches that connection to the event's format.  The format is opaque to this class, it lets
+   // a derived class offer more than one encoding of its events.
    void sendEvent(unsigned int connectionId,
-                  const resip::Data& eventData);
+                  const resip::Data& eventData,
+                  unsigned int eventFormat = 0);
 
    resip::SharedPtr<resip::ThreadIf> getThread();
 
@@ -80,6 +89,14 @@ protected:
    virtual void handleRequest(unsigned int connectionId, 
                               unsigned int requestId, 
                               const resip::Data& request) = 0; 
+
+   // Called from the thread calling process
+   virtual void preProcess() {}  // before any queued responses/events are dispatched
+   virtual void onConnectionOpened(unsigned int connectionId) {}
+   virtual void onConnectionClosed(unsigned int connectionId) {}
+
+   // thread safe - wakes the thread calling process, so that preProcess gets called
+   void wakeup();
       
 private:
    static const unsigned int MaxConnections = 60;   // Note:  use caution if making this any bigger, default fd_set size in windows is 64
@@ -97,6 +114,7 @@ private:
    typedef std::map<unsigned int, XmlRpcConnection*> ConnectionMap;
    ConnectionMap mConnections;
    void closeOldestConnection();
+   void closeConnection(ConnectionMap::iterator it);
 
    resip::Fifo<ResponseInfo> mResponseFifo;
    resip::SelectInterruptor mSelectInterruptor;
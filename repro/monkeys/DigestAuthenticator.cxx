@@ -412,6 +412,18 @@ Processor::processor_action_t
 DigestAuthenticator::requestUserAuthInfo(RequestContext &rc, const Auth& auth, UserInfoMessage *userInfo)
 {
    std::auto_ptr<ApplicationMessage> app(userInfo);
+
+   // Credentials that are in the UserStore's cache are posted straight back
+   // to the proxy - the auth worker threads only handle cache misses
+   Data a1;
+   if(rc.getProxy().getUserStore().getCachedUserAuthInfo(userInfo->user(), userInfo->realm(), a1))
+   {
+      userInfo->A1() = a1;
+      userInfo->setMode(UserAuthInfo::RetrievedA1);
+      rc.getProxy().getStack().post(app);
+      return WaitingForEvent;
+   }
+
    mAuthRequestDispatcher->post(app);
    return WaitingForEvent;
 }
@@ -54,20 +54,20 @@ LocationServer::process(RequestContext& context)
 
    resip::Uri inputUri = context.getOriginalRequest().header(h_RequestLine).uri().getAorAsUri(context.getOriginalRequest().getSource().getType());
 
-   //!RjS! This doesn't look exception safe - need guards
-   mStore.lockRecord(inputUri);
-
-   resip::ContactList contacts;
-   mStore.getContacts(inputUri,contacts);
+   // The snapshot is immutable and shared with other readers, so we
+   // neither copy the bindings nor lock the record to read them.
+   resip::RegistrationPersistenceManager::ContactListSnapshot contacts =
+      mStore.getContactsSnapshot(inputUri);
    
-   if(contacts.size() > 0)
+   if(!contacts->empty())
    {
       TargetPtrList batch;
       std::map<resip::Data,resip::ContactList> outboundBatch;
+      bool haveExpired = false;
       UInt64 now = Timer::getTimeSecs();
-      for(resip::ContactList::iterator i  = contacts.begin(); i != contacts.end(); ++i)
+      for(resip::ContactList::const_iterator i  = contacts->begin(); i != contacts->end(); ++i)
       {
-         resip::ContactInstanceRecord contact = *i;
+         const resip::ContactInstanceRecord& contact = *i;
          if (contact.mRegExpires > now)
          {
             InfoLog (<< *this << " adding target " << contact.mContact <<
@@ -84,12 +84,14 @@ LocationServer::process(RequestContext& context)
          }
          else
          {
-            // remove expired contact 
-            mStore.removeContact(inputUri, contact);
+            haveExpired = true;
          }
       }
 
-      mStore.unlockRecord(inputUri);
+      if (haveExpired)
+      {
+         removeExpiredContacts(inputUri, now);
+      }
 
       std::map<resip::Data,resip::ContactList>::iterator o;
       
@@ -117,8 +119,6 @@ LocationServer::process(RequestContext& context)
    }
    else
    {
-      mStore.unlockRecord(inputUri);
-
       // Note: if we already have targets added from the Route processor we will just skip this
       // as we don't want to return a 404
       if(mUserInfoDispatcher && !context.getResponseContext().hasTargets())
@@ -147,6 +147,25 @@ LocationServer::process(RequestContext& context)
    return Processor::Continue;
 }
 
+void
+LocationServer::removeExpiredContacts(const resip::Uri& aor, UInt64 now)
+{
+   // Only remove bindings that are still expired under the record lock;
+   // a REGISTER may have refreshed them since our snapshot was taken.
+   //!RjS! This doesn't look exception safe - need guards
+   mStore.lockRecord(aor);
+   resip::ContactList contacts;
+   mStore.getContacts(aor, contacts);
+   for(resip::ContactList::iterator i = contacts.begin(); i != contacts.end(); ++i)
+   {
+      if (i->mRegExpires <= now)
+      {
+         mStore.removeContact(aor, *i);
+      }
+   }
+   mStore.unlockRecord(aor);
+}
+
 
 /* ====================================================================
  * The Vovida Software License, Version 1.0 
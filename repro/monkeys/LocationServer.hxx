@@ -24,6 +24,8 @@ namespace repro
       virtual processor_action_t process(RequestContext &);
 
     protected:
+      void removeExpiredContacts(const resip::Uri& aor, UInt64 now);
+
       resip::RegistrationPersistenceManager& mStore;
       resip::Dispatcher* mUserInfoDispatcher;
   };
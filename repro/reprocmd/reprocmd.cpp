@@ -48,6 +48,12 @@ main (int argc, char** argv)
       cerr << "  /GetCongestionStats - retrieves the stacks congestion manager stats and state" << endl;
       cerr << "  /SetCongestionTolerance metric=<SIZE|WAIT_TIME|TIME_DEPTH> maxTolerance=<value>" << endl;
       cerr << "                          [fifoDescription=<desc>] - sets congestion tolerances" << endl;
+      cerr << "  /GetAccountingStats - retrieves the accounting event queue and batch writer stats" << endl;
+      cerr << "  /GetRegSyncStats - retrieves registration/publication sync replication stats" << endl;
+      cerr << "  /GetDatabaseStats - retrieves SQL connection pool and query latency stats" << endl;
+      cerr << "  /GetUserAuthCacheStats - retrieves digest credential cache stats" << endl;
+      cerr << "  /ClearUserAuthCache [user=<user> realm=<realm>] - empties the digest credential" << endl;
+      cerr << "                      cache, or removes a single user from it" << endl;
       cerr << "  /Shutdown - signal the proxy to shut down." << endl;
       cerr << "  /Restart - signal the proxy to restart - leaving active registrations in place." << endl;
       cerr << "  /GetProxyConfig - retrieves the all of configuration file settings currently" << endl;
@@ -357,33 +357,20 @@ private:
    UInt64 mRegMaxExpires;
 };
 
-// Used to fabricate a presence update to all applicable subscriptions
-class repro::PresenceServerSubscriptionRegFunctor
+// Used to shorten the subscription expiry of fabricated presence NOTIFYs
+class repro::PresenceServerNotifyExpiresFunctor : public ServerSubscriptionNotifyFunctor
 {
 public:
-   PresenceServerSubscriptionRegFunctor(PresenceSubscriptionHandler& handler, const resip::Uri& aor, bool online, UInt64 regMaxExpires) :
-      mHandler(handler), mAor(aor), mOnline(online), mRegMaxExpires(regMaxExpires) {}
-   virtual ~PresenceServerSubscriptionRegFunctor() { }
+   PresenceServerNotifyExpiresFunctor(PresenceSubscriptionHandler& handler, UInt64 regMaxExpires) :
+      mHandler(handler), mRegMaxExpires(regMaxExpires) {}
+   virtual ~PresenceServerNotifyExpiresFunctor() { }
 
-   virtual void operator()(ServerSubscriptionHandle h)
+   virtual void apply(ServerSubscriptionHandle h, SipMessage& notify)
    {
-      if (mOnline)
-      {
-         if (!mHandler.sendPublishedPresence(h, false /* sendAcceptReject */))
-         {
-            // Fabricate a simple presence update based on registration state
-            mHandler.fabricateSimplePresence(h, false /* sendAcceptReject */, mAor, true /* online? */, mRegMaxExpires);
-         }
-      }
-      else
-      {
-         mHandler.fabricateSimplePresence(h, false /* sendAcceptReject */, mAor, false /* online? */, mRegMaxExpires);
-      }
+      mHandler.adjustNotifyExpiresTime(notify, mRegMaxExpires);
    }
 private:
    PresenceSubscriptionHandler& mHandler;
-   Uri mAor;
-   bool mOnline;
    UInt64 mRegMaxExpires;
 };
 
@@ -410,9 +397,12 @@ PresenceSubscriptionHandler::checkRegistrationStateChanged(const resip::Uri& aor
    }
    if (stateChanged)
    {
-      PresenceServerSubscriptionRegFunctor functor(*this, aor, online, regMaxExpires);
       Data aorData = aor.user() + "@" + aor.host();
-      mDum.applyToServerSubscriptions<PresenceServerSubscriptionRegFunctor>(aorData, Symbols::Presence, functor);
+      if (!online || !notifyPublishedPresence(aorData))
+      {
+         // Fabricate a simple presence update based on registration state
+         notifySimplePresence(aorData, aor, online, regMaxExpires);
+      }
    }
    else
    {
@@ -507,10 +497,65 @@ private:
 void
 PresenceSubscriptionHandler::notifySubscriptions(const Data& documentKey)
 {
+   // In the common case the presentity has a publication and every watcher gets
+   // the same merged document - build and encode it once for all of them
+   bool online = true;
+   if (mPresenceUsesRegistrationState)
+   {
+      try
+      {
+         Uri aor("sip:" + documentKey);
+         online = mRegistrationDb->aorIsRegistered(aor);
+         if (online)
+         {
+            mOnlineAors.insert(aor);
+         }
+      }
+      catch (BaseException&)
+      {
+         online = false;  // notifyPresence will report the error
+      }
+   }
+   if (online && notifyPublishedPresence(documentKey))
+   {
+      return;
+   }
+
    PresenceServerSubscriptionFunctor functor(*this);
    mDum.applyToServerSubscriptions<PresenceServerSubscriptionFunctor>(documentKey, Symbols::Presence, functor);
 }
 
+bool
+PresenceSubscriptionHandler::notifyPublishedPresence(const Data& documentKey)
+{
+   GenericPidfContents pidf;
+   if (!mPublicationDb->getMergedETags(Symbols::Presence, documentKey, *this, &pidf))
+   {
+      return false;
+   }
+   mDum.notifyServerSubscriptions(documentKey, Symbols::Presence, pidf);
+   return true;
+}
+
+void
+PresenceSubscriptionHandler::notifySimplePresence(const Data& documentKey, const Uri& aor, bool online, UInt64 regMaxExpires)
+{
+   InfoLog(<< "PresenceSubscriptionHandler::notifySimplePresence: aor=" << aor << ", online=" << online << ", maxRegExpires=" << regMaxExpires);
+
+   GenericPidfContents pidf;
+   pidf.setEntity(aor);
+   pidf.setSimplePresenceTupleNode(documentKey, online, GenericPidfContents::generateNowTimestampData());
+   if (regMaxExpires && online)
+   {
+      PresenceServerNotifyExpiresFunctor functor(*this, regMaxExpires);
+      mDum.notifyServerSubscriptions(documentKey, Symbols::Presence, pidf, &functor);
+   }
+   else
+   {
+      mDum.notifyServerSubscriptions(documentKey, Symbols::Presence, pidf);
+   }
+}
+
 void PresenceSubscriptionHandler::checkExpired(const resip::Data& documentKey, const resip::Data& eTag, UInt64 lastUpdated)
 {
     //DebugLog(<< "PresenceSubscriptionHandler::checkExpired: docKey=" << documentKey << ", tag=" << eTag << ", lastUpdated=" << lastUpdated);
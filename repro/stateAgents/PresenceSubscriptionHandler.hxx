@@ -55,7 +55,7 @@ private:
    resip::Uri mAor;
 };
 
-class PresenceServerSubscriptionRegFunctor;
+class PresenceServerNotifyExpiresFunctor;
 class PresenceServerSubscriptionFunctor;
 class PresenceServerRegStateChangeCommand;
 class PresenceServerDocStateChangeCommand;
@@ -104,8 +104,10 @@ protected:
     void continueNotifyPresenceAfterUserExistsCheck(resip::ServerSubscriptionHandle h, bool sendAcceptReject, const resip::Uri& aor, bool userExists);
     bool checkRegistrationStateChanged(const resip::Uri& aor, bool registered, UInt64 regMaxExpires);
     void notifySubscriptions(const resip::Data& documentKey);
+    bool notifyPublishedPresence(const resip::Data& documentKey);
+    void notifySimplePresence(const resip::Data& documentKey, const resip::Uri& aor, bool online, UInt64 regMaxExpires);
     void checkExpired(const resip::Data& documentKey, const resip::Data& eTag, UInt64 lastUpdated);
-    friend class PresenceServerSubscriptionRegFunctor;
+    friend class PresenceServerNotifyExpiresFunctor;
     friend class PresenceServerSubscriptionFunctor;
     friend class PresenceServerRegStateChangeCommand;
     friend class PresenceServerDocStateChangeCommand;
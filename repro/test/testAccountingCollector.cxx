@@ -0,0 +1,1090 @@
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+// JSON library includes - the encoding AccountingCollector used before
+// JsonEventEncoder is compared against
+#include "cajun/json/writer.h"
+#include "cajun/json/elements.h"
+
+#include "repro/AbstractDb.hxx"
+#include "repro/AccountingCollector.hxx"
+#include "repro/JsonEventEncoder.hxx"
+#include "repro/ProcessorChain.hxx"
+#include "repro/Proxy.hxx"
+#include "repro/ProxyConfig.hxx"
+#include "repro/RequestContext.hxx"
+#include "resip/stack/Helper.hxx"
+#include "resip/stack/SipMessage.hxx"
+#include "resip/stack/SipStack.hxx"
+#include "rutil/Condition.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/DataStream.hxx"
+#include "rutil/Lock.hxx"
+#include "rutil/Log.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Mutex.hxx"
+#include "rutil/Timer.hxx"
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::REPRO
+
+using namespace repro;
+using namespace resip;
+using namespace json;
+using namespace std;
+
+static const unsigned int WaitTimeoutMs = 5000;
+
+// Backing store for the Proxy that the session events need a RequestContext of
+class EmptyDb : public AbstractDb
+{
+public:
+   virtual bool isSane() { return true; }
+private:
+   virtual bool dbWriteRecord(const Table table, const Data& key, const Data& data) { return true; }
+   virtual bool dbReadRecord(const Table table, const Data& key, Data& data) const { return false; }
+   virtual void dbEraseRecord(const Table table, const Data& key, bool isSecondaryKey=false) {}
+   virtual Data dbNextKey(const Table table, bool first=false) { return Data::Empty; }
+   virtual bool dbNextRecord(const Table table, const Data& key, Data& data, bool forUpdate, bool first=false) { return false; }
+   virtual bool dbBeginTransaction(const Table table) { return true; }
+   virtual bool dbCommitTransaction(const Table table) { return true; }
+   virtual bool dbRollbackTransaction(const Table table) { return true; }
+};
+
+// Records the batches the collector thread writes, in place of the
+// persistent message queues
+class StubQueueCollector : public AccountingCollector
+{
+public:
+   StubQueueCollector(ProxyConfig& config) : AccountingCollector(config) {}
+   virtual ~StubQueueCollector()
+   {
+      // Stop the thread while writeBatch is still ours
+      shutdown();
+      join();
+   }
+
+   class Batch
+   {
+   public:
+      bool mSession;
+      std::vector<Data> mRecords;
+      UInt64 mWrittenMs;
+   };
+
+   // Waits for count batches in total, returns false if they do not come
+   bool waitForBatches(size_t count, unsigned int timeoutMs = WaitTimeoutMs)
+   {
+      UInt64 end = Timer::getTimeMs() + timeoutMs;
+      Lock lock(mMutex);
+      while(mBatches.size() < count)
+      {
+         UInt64 now = Timer::getTimeMs();
+         if(now >= end)
+         {
+            return false;
+         }
+         mCondition.wait(mMutex, (unsigned int)(end - now));
+      }
+      return true;
+   }
+
+   std::vector<Batch> batches()
+   {
+      Lock lock(mMutex);
+      return mBatches;
+   }
+
+   // The only record of the last batch
+   Data lastRecord()
+   {
+      Lock lock(mMutex);
+      assert(!mBatches.empty());
+      assert(mBatches.back().mRecords.size() == 1);
+      return mBatches.back().mRecords.front();
+   }
+
+protected:
+   virtual bool writeBatch(FifoEventType type, const std::vector<Data>& records)
+   {
+      Lock lock(mMutex);
+      mBatches.push_back(Batch());
+      mBatches.back().mSession = type == SessionEventType;
+      mBatches.back().mRecords = records;
+      mBatches.back().mWrittenMs = Timer::getTimeMs();
+      mCondition.broadcast();
+      return true;
+   }
+
+private:
+   Mutex mMutex;
+   Condition mCondition;
+   std::vector<Batch> mBatches;
+};
+
+// AccountingCollector's event encoding from before JsonEventEncoder: each
+// event is built as a json::Object and written with json::Writer.  The
+// do*Accounting bodies are the previous ones unchanged, apart from the event
+// now being returned rather than queued.
+class CajunEventWriter
+{
+public:
+   CajunEventWriter(bool addRoutingHeaders, bool addViaHeaders) :
+      mSessionAccountingAddRoutingHeaders(addRoutingHeaders),
+      mSessionAccountingAddViaHeaders(addViaHeaders),
+      mRegistrationAccountingAddRoutingHeaders(addRoutingHeaders),
+      mRegistrationAccountingAddViaHeaders(addViaHeaders),
+      mRegistrationAccountingLogRefreshes(true)
+   {
+   }
+
+   // Returns the event for msg, or empty if there is none
+   Data doRegistrationAccounting(AccountingCollector::RegistrationEvent regevent, const resip::SipMessage& msg);
+   Data doSessionAccounting(const resip::SipMessage& msg, bool received, RequestContext& context);
+
+private:
+   Data write(Object& eventObject)
+   {
+      Data event;
+      {
+         DataStream ds(event);
+         Writer::Write(eventObject, ds);
+      }
+      return event;
+   }
+
+   bool mSessionAccountingAddRoutingHeaders;
+   bool mSessionAccountingAddViaHeaders;
+   bool mRegistrationAccountingAddRoutingHeaders;
+   bool mRegistrationAccountingAddViaHeaders;
+   bool mRegistrationAccountingLogRefreshes;
+};
+
+Data
+CajunEventWriter::doRegistrationAccounting(AccountingCollector::RegistrationEvent regevent, const resip::SipMessage& msg)
+{
+   resip_assert(msg.isRequest());
+   resip_assert(msg.method() == REGISTER);
+
+   if(regevent == AccountingCollector::RegistrationRefreshed && !mRegistrationAccountingLogRefreshes)
+   {
+      // if mRegistrationAccountingLogRefreshes is false then don't log refreshes
+      return Data::Empty;
+   }
+
+   DateCategory datetime;
+   if(!msg.exists(h_CallId) || !msg.header(h_CallId).isWellFormed())
+   {
+      ErrLog(<< "AccountingCollector::doRegistrationAccounting: missing proper callId header: " << msg);
+      return Data::Empty;
+   }
+   Object regEvent;
+   regEvent["EventId"] = Number(regevent);
+   switch(regevent)
+   {
+   case AccountingCollector::RegistrationAdded:
+      regEvent["EventName"] = String("Registration Added");
+      break;
+   case AccountingCollector::RegistrationRefreshed:
+      regEvent["EventName"] = String("Registration Refreshed");
+      break;
+   case AccountingCollector::RegistrationRemoved:
+      regEvent["EventName"] = String("Registration Removed");
+      break;
+   case AccountingCollector::RegistrationRemovedAll:
+      regEvent["EventName"] = String("Registration Removed All");
+      break;
+   }
+   regEvent["Datetime"] = String(Data::from(datetime).c_str());
+   regEvent["CallId"] = String(msg.header(h_CallId).value().c_str());
+   if(msg.exists(h_To) && msg.header(h_To).isWellFormed())
+   {
+      if(!msg.header(h_To).displayName().empty())
+      {
+         regEvent["User"]["DisplayName"] = String(msg.header(h_To).displayName().c_str());
+      }
+      regEvent["User"]["Aor"] = String(Data::from(msg.header(h_To).uri().getAorAsUri(msg.getSource().getType())).c_str());
+   }
+   if(msg.exists(h_From) && msg.header(h_From).isWellFormed())
+   {
+      if(msg.header(h_From).uri() != msg.header(h_To).uri()) // Only log from is different from To
+      {
+         if(!msg.header(h_From).displayName().empty())
+         {
+            regEvent["From"]["DisplayName"] = String(msg.header(h_From).displayName().c_str());
+         }
+         regEvent["From"]["Uri"] = String(Data::from(msg.header(h_From).uri()).c_str());
+      }
+   }
+   if(msg.exists(h_Contacts) && !msg.header(h_Contacts).empty())
+   {
+      Array arrayContacts;
+      NameAddrs::const_iterator contactIt = msg.header(h_Contacts).begin();
+      for(; contactIt != msg.header(h_Contacts).end(); contactIt++)
+      {
+         if(contactIt->isWellFormed())
+         {
+            arrayContacts.Insert(String(Data::from(*contactIt).c_str()));
+         }
+      }
+      if(!arrayContacts.Empty())
+      {
+         regEvent["Contacts"] = arrayContacts;
+      }
+   }
+   if(msg.exists(h_Expires) && msg.header(h_Expires).isWellFormed())
+   {
+      regEvent["Expires"] = Number(msg.header(h_Expires).value());
+   }
+   if(mRegistrationAccountingAddViaHeaders &&
+      msg.exists(h_Vias) && !msg.header(h_Vias).empty())
+   {
+      Array arrayVias;
+      Vias::const_iterator viaIt = msg.header(h_Vias).begin();
+      for(; viaIt != msg.header(h_Vias).end(); viaIt++)
+      {
+         if(viaIt->isWellFormed())
+         {
+            arrayVias.Insert(String(Data::from(*viaIt).c_str()));
+         }
+      }
+      if(!arrayVias.Empty())
+      {
+         regEvent["Vias"] = arrayVias;
+      }
+   }
+   Tuple publicAddress = Helper::getClientPublicAddress(msg);
+   if(publicAddress.getType() != UNKNOWN_TRANSPORT)
+   {
+      regEvent["ClientPublicAddress"]["Transport"] = String(Tuple::toData(publicAddress.getType()).c_str());
+      regEvent["ClientPublicAddress"]["IP"] = String(Tuple::inet_ntop(publicAddress).c_str());
+      regEvent["ClientPublicAddress"]["Port"] = Number(publicAddress.getPort());
+   }
+   if(mRegistrationAccountingAddRoutingHeaders &&
+      msg.exists(h_Routes) && !msg.header(h_Routes).empty())
+   {
+      Array arrayRoutes;
+      NameAddrs::const_iterator routeIt = msg.header(h_Routes).begin();
+      for(; routeIt != msg.header(h_Routes).end(); routeIt++)
+      {
+         if(routeIt->isWellFormed())
+         {
+            arrayRoutes.Insert(String(Data::from(*routeIt).c_str()));
+         }
+      }
+      if(!arrayRoutes.Empty())
+      {
+         regEvent["Routes"] = arrayRoutes;
+      }
+   }
+   if(mRegistrationAccountingAddRoutingHeaders &&
+      msg.exists(h_Paths) && !msg.header(h_Paths).empty())
+   {
+      Array arrayPaths;
+      NameAddrs::const_iterator pathIt = msg.header(h_Paths).begin();
+      for(; pathIt != msg.header(h_Paths).end(); pathIt++)
+      {
+         if(pathIt->isWellFormed())
+         {
+            arrayPaths.Insert(String(Data::from(*pathIt).c_str()));
+         }
+      }
+      if(!arrayPaths.Empty())
+      {
+         regEvent["Paths"] = arrayPaths;
+      }
+   }
+   if(msg.exists(h_UserAgent) && msg.header(h_UserAgent).isWellFormed())
+   {
+      regEvent["UserAgent"] = String(msg.header(h_UserAgent).value().c_str());
+   }
+   return write(regEvent);
+}
+
+Data
+CajunEventWriter::doSessionAccounting(const resip::SipMessage& msg, bool received, RequestContext& context)
+{
+   //DebugLog(<< "AccountingCollector::doSessionAccounting: " << msg.brief());
+   if(msg.isRequest())
+   {
+      if(msg.method() == INVITE && !msg.header(h_To).exists(p_tag))
+      {
+         // Dialog creating INVITE
+         if(received)
+         {
+            // This came from the wire - so it is new session
+            DateCategory datetime;
+            if(!msg.exists(h_CallId) || !msg.header(h_CallId).isWellFormed())
+            {
+               ErrLog(<< "AccountingCollector::doSessionAccounting: missing proper callId header: " << msg);
+               return Data::Empty;
+            }
+            Object sessionEvent;
+            sessionEvent["EventId"] = Number(AccountingCollector::SessionCreated);
+            sessionEvent["EventName"] = String("Session Created");
+            sessionEvent["Datetime"] = String(Data::from(datetime).c_str());
+            sessionEvent["CallId"] = String(msg.header(h_CallId).value().c_str());
+            sessionEvent["RequestUri"] = String(Data::from(msg.header(h_RequestLine).uri()).c_str());
+            if(msg.exists(h_To) && msg.header(h_To).isWellFormed())
+            {
+               if(!msg.header(h_To).displayName().empty())
+               {
+                  sessionEvent["To"]["DisplayName"] = String(msg.header(h_To).displayName().c_str());
+               }
+               sessionEvent["To"]["Uri"] = String(Data::from(msg.header(h_To).uri()).c_str());
+            }
+            if(msg.exists(h_From) && msg.header(h_From).isWellFormed())
+            {
+               if(!msg.header(h_From).displayName().empty())
+               {
+                  sessionEvent["From"]["DisplayName"] = String(msg.header(h_From).displayName().c_str());
+               }
+               sessionEvent["From"]["Uri"] = String(Data::from(msg.header(h_From).uri()).c_str());
+            }
+            if(msg.exists(h_Contacts) && !msg.header(h_Contacts).empty() && msg.header(h_Contacts).front().isWellFormed())
+            {
+               sessionEvent["Contact"] = String(Data::from(msg.header(h_Contacts).front()).c_str());
+            }
+            if(mSessionAccountingAddViaHeaders &&
+               msg.exists(h_Vias) && !msg.header(h_Vias).empty())
+            {
+               Array arrayVias;
+               Vias::const_iterator viaIt = msg.header(h_Vias).begin();
+               for(; viaIt != msg.header(h_Vias).end(); viaIt++)
+               {
+                  if(viaIt->isWellFormed())
+                  {
+                     arrayVias.Insert(String(Data::from(*viaIt).c_str()));
+                  }
+               }
+               if(!arrayVias.Empty())
+               {
+                  sessionEvent["Vias"] = arrayVias;
+               }
+            }
+            Tuple publicAddress = Helper::getClientPublicAddress(msg);
+            if(publicAddress.getType() != UNKNOWN_TRANSPORT)
+            {
+               sessionEvent["ClientPublicAddress"]["Transport"] = String(Tuple::toData(publicAddress.getType()).c_str());
+               sessionEvent["ClientPublicAddress"]["IP"] = String(Tuple::inet_ntop(publicAddress).c_str());
+               sessionEvent["ClientPublicAddress"]["Port"] = Number(publicAddress.getPort());
+            }
+            if(mSessionAccountingAddRoutingHeaders &&
+               msg.exists(h_Routes) && !msg.header(h_Routes).empty())
+            {
+               Array arrayRoutes;
+               NameAddrs::const_iterator routeIt = msg.header(h_Routes).begin();
+               for(; routeIt != msg.header(h_Routes).end(); routeIt++)
+               {
+                  if(routeIt->isWellFormed())
+                  {
+                     arrayRoutes.Insert(String(Data::from(*routeIt).c_str()));
+                  }
+               }
+               if(!arrayRoutes.Empty())
+               {
+                  sessionEvent["Routes"] = arrayRoutes;
+               }
+            }
+            if(mSessionAccountingAddRoutingHeaders &&
+               msg.exists(h_RecordRoutes) && !msg.header(h_RecordRoutes).empty())
+            {
+               Array arrayRecordRoutes;
+               NameAddrs::const_iterator recordRouteIt = msg.header(h_RecordRoutes).begin();
+               for(; recordRouteIt != msg.header(h_RecordRoutes).end(); recordRouteIt++)
+               {
+                  if(recordRouteIt->isWellFormed())
+                  {
+                     arrayRecordRoutes.Insert(String(Data::from(*recordRouteIt).c_str()));
+                  }
+               }
+               if(!arrayRecordRoutes.Empty())
+               {
+                  sessionEvent["RecordRoutes"] = arrayRecordRoutes;
+               }
+            }
+            if(msg.exists(h_UserAgent) && msg.header(h_UserAgent).isWellFormed())
+            {
+               sessionEvent["UserAgent"] = String(msg.header(h_UserAgent).value().c_str());
+            }
+            context.setSessionCreatedEventSent();
+            return write(sessionEvent);
+         }
+         else
+         {
+            // This is being forwarded to a target
+            DateCategory datetime;
+            if(!msg.exists(h_CallId) || !msg.header(h_CallId).isWellFormed())
+            {
+               ErrLog(<< "AccountingCollector::doSessionAccounting: missing proper callId header: " << msg);
+               return Data::Empty;
+            }
+            Object sessionEvent;
+            sessionEvent["EventId"] = Number(AccountingCollector::SessionRouted);
+            sessionEvent["EventName"] = String("Session Routed");
+            sessionEvent["Datetime"] = String(Data::from(datetime).c_str());
+            sessionEvent["CallId"] = String(msg.header(h_CallId).value().c_str());
+            sessionEvent["TargetUri"] = String(Data::from(msg.header(h_RequestLine).uri()).c_str());
+            if(mSessionAccountingAddRoutingHeaders &&
+               msg.exists(h_Routes) && !msg.header(h_Routes).empty())
+            {
+               Array arrayRoutes;
+               NameAddrs::const_iterator routeIt = msg.header(h_Routes).begin();
+               for(; routeIt != msg.header(h_Routes).end(); routeIt++)
+               {
+                  if(routeIt->isWellFormed())
+                  {
+                     arrayRoutes.Insert(String(Data::from(*routeIt).c_str()));
+                  }
+               }
+               if(!arrayRoutes.Empty())
+               {
+                  sessionEvent["Routes"] = arrayRoutes;
+               }
+            }
+            return write(sessionEvent);
+         }
+      }
+      else if(msg.method() == BYE && received)
+      {
+         // Session Ended
+         DateCategory datetime;
+         if(!msg.exists(h_CallId) || !msg.header(h_CallId).isWellFormed())
+         {
+            ErrLog(<< "AccountingCollector::doSessionAccounting: missing proper callId header: " << msg);
+            return Data::Empty;
+         }
+         Object sessionEvent;
+         sessionEvent["EventId"] = Number(AccountingCollector::SessionEnded);
+         sessionEvent["EventName"] = String("Session Ended");
+         sessionEvent["Datetime"] = String(Data::from(datetime).c_str());
+         sessionEvent["CallId"] = String(msg.header(h_CallId).value().c_str());
+         if(msg.exists(h_From) && msg.header(h_From).isWellFormed())
+         {
+            if(!msg.header(h_From).displayName().empty())
+            {
+               sessionEvent["From"]["DisplayName"] = String(msg.header(h_From).displayName().c_str());
+            }
+            sessionEvent["From"]["Uri"] = String(Data::from(msg.header(h_From).uri()).c_str());
+         }
+         if(msg.exists(h_Reasons) && !msg.header(h_Reasons).empty() && msg.header(h_Reasons).front().isWellFormed())
+         {
+            // Just look at first occurance
+            sessionEvent["Reason"]["Value"] = String(msg.header(h_Reasons).front().value().c_str());
+            if(msg.header(h_Reasons).front().exists(p_cause))
+            {
+               sessionEvent["Reason"]["Cause"] = Number(msg.header(h_Reasons).front().param(p_cause));
+            }
+            if(msg.header(h_Reasons).front().exists(p_text) && !msg.header(h_Reasons).front().param(p_text).empty())
+            {
+               sessionEvent["Reason"]["Text"] = String(msg.header(h_Reasons).front().param(p_text).c_str());
+            }
+         }
+         return write(sessionEvent);
+      }
+      else if(msg.method() == CANCEL && received)
+      {
+         // Session Cancelled
+         DateCategory datetime;
+         if(!msg.exists(h_CallId) || !msg.header(h_CallId).isWellFormed())
+         {
+            ErrLog(<< "AccountingCollector::doSessionAccounting: missing proper callId header: " << msg);
+            return Data::Empty;
+         }
+         Object sessionEvent;
+         sessionEvent["EventId"] = Number(AccountingCollector::SessionCancelled);
+         sessionEvent["EventName"] = String("Session Cancelled");
+         sessionEvent["Datetime"] = String(Data::from(datetime).c_str());
+         sessionEvent["CallId"] = String(msg.header(h_CallId).value().c_str());
+         if(msg.exists(h_Reasons) && !msg.header(h_Reasons).empty() && msg.header(h_Reasons).front().isWellFormed())
+         {
+            // Just look at first occurance
+            sessionEvent["Reason"]["Value"] = String(msg.header(h_Reasons).front().value().c_str());
+            if(msg.header(h_Reasons).front().exists(p_cause))
+            {
+               sessionEvent["Reason"]["Cause"] = Number(msg.header(h_Reasons).front().param(p_cause));
+            }
+            if(msg.header(h_Reasons).front().exists(p_text) && !msg.header(h_Reasons).front().param(p_text).empty())
+            {
+               sessionEvent["Reason"]["Text"] = String(msg.header(h_Reasons).front().param(p_text).c_str());
+            }
+         }
+         return write(sessionEvent);
+      }
+      else if(msg.method() == REFER && received && msg.header(h_To).exists(p_tag))
+      {
+         // Only handle mid-dialog REFERs for now
+         // Session Redirected
+         DateCategory datetime;
+         if(!msg.exists(h_CallId) || !msg.header(h_CallId).isWellFormed())
+         {
+            ErrLog(<< "AccountingCollector::doSessionAccounting: missing proper callId header: " << msg);
+            return Data::Empty;
+         }
+         Object sessionEvent;
+         sessionEvent["EventId"] = Number(AccountingCollector::SessionRedirected);
+         sessionEvent["EventName"] = String("Session Redirected");
+         sessionEvent["Datetime"] = String(Data::from(datetime).c_str());
+         sessionEvent["CallId"] = String(msg.header(h_CallId).value().c_str());
+         if(msg.exists(h_From) && msg.header(h_From).isWellFormed())
+         {
+            if(!msg.header(h_From).displayName().empty())
+            {
+               sessionEvent["ReferredBy"]["DisplayName"] = String(msg.header(h_From).displayName().c_str());
+            }
+            sessionEvent["ReferredBy"]["Uri"] = String(Data::from(msg.header(h_From).uri()).c_str());
+         }
+         if(msg.exists(h_ReferTo) && msg.header(h_ReferTo).isWellFormed())
+         {
+            sessionEvent["TargetUri"] = String(Data::from(msg.header(h_ReferTo).uri()).c_str());
+         }
+         return write(sessionEvent);
+      }
+   }
+   // Response
+   else 
+   {
+      if(!received && msg.method() == INVITE)
+      {
+         if(msg.header(h_StatusLine).statusCode() >= 200 &&
+            msg.header(h_StatusLine).statusCode() < 300)
+         {
+            // Session Answered
+            DateCategory datetime;
+            if(!msg.exists(h_CallId) || !msg.header(h_CallId).isWellFormed())
+            {
+               ErrLog(<< "AccountingCollector::doSessionAccounting: missing proper callId header: " << msg);
+               return Data::Empty;
+            }
+            Object sessionEvent;
+            sessionEvent["EventId"] = Number(AccountingCollector::SessionEstablished);
+            sessionEvent["EventName"] = String("Session Established");
+            sessionEvent["Datetime"] = String(Data::from(datetime).c_str());
+            sessionEvent["CallId"] = String(msg.header(h_CallId).value().c_str());
+            if(msg.exists(h_Contacts) && !msg.header(h_Contacts).empty() && msg.header(h_Contacts).front().isWellFormed())
+            {
+               sessionEvent["Contact"] = String(Data::from(msg.header(h_Contacts).front()).c_str());
+            }
+            if(mSessionAccountingAddRoutingHeaders &&
+               msg.exists(h_RecordRoutes) && !msg.header(h_RecordRoutes).empty())
+            {
+               Array arrayRecordRoutes;
+               NameAddrs::const_iterator recordRouteIt = msg.header(h_RecordRoutes).begin();
+               for(; recordRouteIt != msg.header(h_RecordRoutes).end(); recordRouteIt++)
+               {
+                  if(recordRouteIt->isWellFormed())
+                  {
+                     arrayRecordRoutes.Insert(String(Data::from(*recordRouteIt).c_str()));
+                  }
+               }
+               if(!arrayRecordRoutes.Empty())
+               {
+                  sessionEvent["RecordRoutes"] = arrayRecordRoutes;
+               }
+            }
+            if(msg.exists(h_UserAgent) && msg.header(h_UserAgent).isWellFormed())
+            {
+               sessionEvent["UserAgent"] = String(msg.header(h_UserAgent).value().c_str());
+            }
+            context.setSessionEstablishedEventSent();
+            return write(sessionEvent);
+         }
+         else if(msg.header(h_StatusLine).statusCode() >= 300 &&
+                 msg.header(h_StatusLine).statusCode() < 400)
+         {
+            // Session Redirected
+            // Session Answered
+            DateCategory datetime;
+            if(!msg.exists(h_CallId) || !msg.header(h_CallId).isWellFormed())
+            {
+               ErrLog(<< "AccountingCollector::doSessionAccounting: missing proper callId header: " << msg);
+               return Data::Empty;
+            }
+            Object sessionEvent;
+            sessionEvent["EventId"] = Number(AccountingCollector::SessionRedirected);
+            sessionEvent["EventName"] = String("Session Redirected");
+            sessionEvent["Datetime"] = String(Data::from(datetime).c_str());
+            sessionEvent["CallId"] = String(msg.header(h_CallId).value().c_str());
+            if(msg.exists(h_Contacts) && !msg.header(h_Contacts).empty())
+            {
+               Array arrayContacts;
+               NameAddrs::const_iterator contactIt = msg.header(h_Contacts).begin();
+               for(; contactIt != msg.header(h_Contacts).end(); contactIt++)
+               {
+                  if(contactIt->isWellFormed())
+                  {
+                     arrayContacts.Insert(String(Data::from(*contactIt).c_str()));
+                  }
+               }
+               if(!arrayContacts.Empty())
+               {
+                  sessionEvent["TargetUris"] = arrayContacts;
+               }
+            }
+            if(msg.exists(h_UserAgent) && msg.header(h_UserAgent).isWellFormed())
+            {
+               sessionEvent["UserAgent"] = String(msg.header(h_UserAgent).value().c_str());
+            }
+            return write(sessionEvent);
+         }
+         else if(msg.header(h_StatusLine).statusCode() >= 400 &&
+                 msg.header(h_StatusLine).statusCode() < 700)
+         {
+            // Session Error
+            Object sessionEvent;
+            // Session Answered
+            DateCategory datetime;
+            if(!msg.exists(h_CallId) || !msg.header(h_CallId).isWellFormed())
+            {
+               ErrLog(<< "AccountingCollector::doSessionAccounting: missing proper callId header: " << msg);
+               return Data::Empty;
+            }
+            sessionEvent["EventId"] = Number(AccountingCollector::SessionError);
+            sessionEvent["EventName"] = String("Session Error");
+            sessionEvent["Datetime"] = String(Data::from(datetime).c_str());
+            sessionEvent["CallId"] = String(msg.header(h_CallId).value().c_str());
+            sessionEvent["Status"]["Code"] = Number(msg.header(h_StatusLine).statusCode());
+            if(!msg.header(h_StatusLine).reason().empty())
+            {
+               sessionEvent["Status"]["Text"] = String(msg.header(h_StatusLine).reason().c_str());
+            }
+            if(msg.exists(h_Warnings) && !msg.header(h_Warnings).empty() && msg.header(h_Warnings).front().isWellFormed())
+            {
+               // Just look at first occurance
+               sessionEvent["Warning"]["Code"] = Number(msg.header(h_Warnings).front().code());
+               if(!msg.header(h_Warnings).front().text().empty())
+               {
+                  sessionEvent["Warning"]["Text"] = String(msg.header(h_Warnings).front().text().c_str());
+               }
+            }
+            // Note: a reason header is not usually present on a response - but we will use one if it is
+            if(msg.exists(h_Reasons) && !msg.header(h_Reasons).empty() && msg.header(h_Reasons).front().isWellFormed())
+            {
+               // Just look at first occurance
+               sessionEvent["Reason"]["Value"] = String(msg.header(h_Reasons).front().value().c_str());
+               if(msg.header(h_Reasons).front().exists(p_cause))
+               {
+                  sessionEvent["Reason"]["Cause"] = Number(msg.header(h_Reasons).front().param(p_cause));
+               }
+               if(msg.header(h_Reasons).front().exists(p_text) && !msg.header(h_Reasons).front().param(p_text).empty())
+               {
+                  sessionEvent["Reason"]["Text"] = String(msg.header(h_Reasons).front().param(p_text).c_str());
+               }
+            }
+            if(msg.exists(h_UserAgent) && msg.header(h_UserAgent).isWellFormed())
+            {
+               sessionEvent["UserAgent"] = String(msg.header(h_UserAgent).value().c_str());
+            }
+            return write(sessionEvent);
+         }
+      }
+   }
+   return Data::Empty;
+}
+
+// The two encodings are made at slightly different times
+static Data
+withoutDatetime(const Data& event)
+{
+   static const Data name("\"Datetime\" : \"");
+   Data::size_type start = event.find(name);
+   assert(start != Data::npos);
+   start += name.size();
+   Data::size_type end = event.find("\"", start);
+   assert(end != Data::npos);
+   return event.substr(0, start) + event.substr(end);
+}
+
+static SipMessage*
+makeMessage(const char* text)
+{
+   Data buffer(text);
+   buffer.replace("\n", "\r\n");
+   SipMessage* msg = SipMessage::make(buffer, true);
+   assert(msg);
+   return msg;
+}
+
+// Display names, Call-IDs, header values and parameters with characters
+// that are escaped - quotes, backslashes, tabs and UTF-8
+static const char* Register =
+   "REGISTER sip:example.com SIP/2.0\n"
+   "Via: SIP/2.0/UDP 192.0.2.10:5060;branch=z9hG4bK-reg1;received=198.51.100.7;rport=40000\n"
+   "Max-Forwards: 70\n"
+   "To: \"Jo\\\"e\\\\ Bl\xc3\xb6ggs\" <sip:joe@example.com>\n"
+   "From: \"Alice \xe2\x82\xac\" <sip:alice@example.com>;tag=f1\n"
+   "Call-ID: a\"b\\c@192.0.2.10\n"
+   "CSeq: 1 REGISTER\n"
+   "Contact: <sip:joe@192.0.2.10:5060;transport=udp>;expires=3600\n"
+   "Contact: \"Desk\t\\\"2\\\"\" <sip:joe@192.0.2.11>;+sip.instance=\"<urn:uuid:00000000-0000-1000-8000-000A95A0E128>\"\n"
+   "Route: <sip:proxy.example.com;lr>\n"
+   "Path: <sip:edge.example.com;lr>\n"
+   "Expires: 3600\n"
+   "User-Agent: Test\tPhone/1.0 (\xc3\xa9t\xc3\xa9 \"beta\")\n"
+   "Content-Length: 0\n"
+   "\n";
+
+static const char* Invite =
+   "INVITE sip:bob@example.com SIP/2.0\n"
+   "Via: SIP/2.0/TCP 198.51.100.20:5060;branch=z9hG4bK-inv1\n"
+   "Max-Forwards: 70\n"
+   "Route: <sip:proxy.example.com;lr>\n"
+   "Record-Route: <sip:edge.example.com;lr>\n"
+   "To: \"B\xc3\xb6\\\\b\" <sip:bob@example.com>\n"
+   "From: \"\\\"Al\\\"\" <sip:alice@example.com>;tag=f2\n"
+   "Call-ID: inv\"1\\x@198.51.100.20\n"
+   "CSeq: 1 INVITE\n"
+   "Contact: <sip:alice@198.51.100.20;transport=tcp>\n"
+   "User-Agent: Softphone \xe2\x82\xac\t2\n"
+   "Content-Length: 0\n"
+   "\n";
+
+static const char* Bye =
+   "BYE sip:bob@192.0.2.30 SIP/2.0\n"
+   "Via: SIP/2.0/UDP 192.0.2.20:5060;branch=z9hG4bK-bye1\n"
+   "Max-Forwards: 70\n"
+   "To: <sip:bob@example.com>;tag=t3\n"
+   "From: \"Al \\\"ice\\\"\" <sip:alice@example.com>;tag=f3\n"
+   "Call-ID: bye1@192.0.2.20\n"
+   "CSeq: 2 BYE\n"
+   "Reason: Q.850;cause=16;text=\"Normal \\\"call\\\" clearing \xc3\xa9\"\n"
+   "Content-Length: 0\n"
+   "\n";
+
+static const char* Cancel =
+   "CANCEL sip:bob@example.com SIP/2.0\n"
+   "Via: SIP/2.0/UDP 192.0.2.20:5060;branch=z9hG4bK-inv2\n"
+   "Max-Forwards: 70\n"
+   "To: <sip:bob@example.com>\n"
+   "From: <sip:alice@example.com>;tag=f4\n"
+   "Call-ID: cancel1@192.0.2.20\n"
+   "CSeq: 1 CANCEL\n"
+   "Reason: SIP;cause=200;text=\"Call completed elsewhere\"\n"
+   "Content-Length: 0\n"
+   "\n";
+
+static const char* Refer =
+   "REFER sip:bob@192.0.2.30 SIP/2.0\n"
+   "Via: SIP/2.0/UDP 192.0.2.20:5060;branch=z9hG4bK-ref1\n"
+   "Max-Forwards: 70\n"
+   "To: <sip:bob@example.com>;tag=t5\n"
+   "From: \"Carol\\\\\" <sip:carol@example.com>;tag=f5\n"
+   "Call-ID: refer1@192.0.2.20\n"
+   "CSeq: 3 REFER\n"
+   "Refer-To: <sip:dave@example.com?Replaces=abc%40host%3Bto-tag%3D1>\n"
+   "Content-Length: 0\n"
+   "\n";
+
+static const char* Ok =
+   "SIP/2.0 200 OK\n"
+   "Via: SIP/2.0/TCP 198.51.100.20:5060;branch=z9hG4bK-inv1\n"
+   "Record-Route: <sip:edge.example.com;lr>\n"
+   "To: <sip:bob@example.com>;tag=t6\n"
+   "From: <sip:alice@example.com>;tag=f2\n"
+   "Call-ID: inv\"1\\x@198.51.100.20\n"
+   "CSeq: 1 INVITE\n"
+   "Contact: \"B\xc3\xb6b\" <sip:bob@192.0.2.30>\n"
+   "User-Agent: Desk \"phone\"\n"
+   "Content-Length: 0\n"
+   "\n";
+
+static const char* Redirect =
+   "SIP/2.0 302 Moved Temporarily\n"
+   "Via: SIP/2.0/TCP 198.51.100.20:5060;branch=z9hG4bK-inv1\n"
+   "To: <sip:bob@example.com>;tag=t7\n"
+   "From: <sip:alice@example.com>;tag=f2\n"
+   "Call-ID: inv\"1\\x@198.51.100.20\n"
+   "CSeq: 1 INVITE\n"
+   "Contact: <sip:bob@192.0.2.31>;q=0.5\n"
+   "Contact: \"Voicemail \\\"vm\\\"\" <sip:vm@example.com>\n"
+   "Content-Length: 0\n"
+   "\n";
+
+static const char* Busy =
+   "SIP/2.0 486 Busy \"Here\" \xc3\xa9\n"
+   "Via: SIP/2.0/TCP 198.51.100.20:5060;branch=z9hG4bK-inv1\n"
+   "To: <sip:bob@example.com>;tag=t8\n"
+   "From: <sip:alice@example.com>;tag=f2\n"
+   "Call-ID: inv\"1\\x@198.51.100.20\n"
+   "CSeq: 1 INVITE\n"
+   "Warning: 399 host.example.com \"In a \\\"meeting\\\"\"\n"
+   "Reason: SIP;cause=486;text=\"User\tbusy\"\n"
+   "User-Agent: Desk\\phone\n"
+   "Content-Length: 0\n"
+   "\n";
+
+static void
+testStrings()
+{
+   // Every character class writeString handles, including byte sequences
+   // that are not valid UTF-8
+   static const char raw[] = "q\"b\\s/\b\f\n\r\t ctl\x01 2\xc3\xa9 3\xe2\x82\xac bad\xc3 lone\x80 cut\xe2\x82 end\xc3";
+   Data value(raw, sizeof(raw) - 1);
+
+   Data encoded;
+   JsonEventEncoder encoder(encoded);
+   encoder.add("Text", value);
+   encoder.add("Number", 42);
+   encoder.add("Unsigned", (UInt32)65535);
+   encoder.startObject("Nested");
+   encoder.add("Text", Data("x"));
+   encoder.startArray("List");
+   encoder.addElement(value);
+   encoder.addElement(Data::Empty);
+   encoder.endArray();
+   encoder.endObject();
+   encoder.finish();
+
+   Object object;
+   object["Text"] = String(value.c_str());
+   object["Number"] = Number(42);
+   object["Unsigned"] = Number((UInt32)65535);
+   object["Nested"]["Text"] = String("x");
+   Array list;
+   list.Insert(String(value.c_str()));
+   list.Insert(String(""));
+   object["Nested"]["List"] = list;
+   Data written;
+   {
+      DataStream ds(written);
+      Writer::Write(object, ds);
+   }
+   assert(encoded == written);
+}
+
+static void
+testRegistrationEvents()
+{
+   // With and without the optional Via, Route and Path arrays
+   for(int headers = 0; headers < 2; headers++)
+   {
+      ProxyConfig config;
+      config.insertConfigValue("AccountingBatchSize", "1");
+      config.insertConfigValue("RegistrationAccountingLogRefreshes", "true");
+      config.insertConfigValue("RegistrationAccountingAddRoutingHeaders", headers ? "true" : "false");
+      config.insertConfigValue("RegistrationAccountingAddViaHeaders", headers ? "true" : "false");
+      StubQueueCollector collector(config);
+      CajunEventWriter cajun(headers != 0, headers != 0);
+
+      std::auto_ptr<SipMessage> msg(makeMessage(Register));
+      AccountingCollector::RegistrationEvent events[] = { AccountingCollector::RegistrationAdded,
+                                                          AccountingCollector::RegistrationRefreshed,
+                                                          AccountingCollector::RegistrationRemoved,
+                                                          AccountingCollector::RegistrationRemovedAll };
+      for(size_t i = 0; i < sizeof(events) / sizeof(events[0]); i++)
+      {
+         collector.doRegistrationAccounting(events[i], *msg);
+         assert(collector.waitForBatches(i + 1));
+         Data record = collector.lastRecord();
+         assert(collector.batches().back().mSession == false);
+         assert(withoutDatetime(record) == withoutDatetime(cajun.doRegistrationAccounting(events[i], *msg)));
+      }
+      assert(collector.getStats().mEventsCommitted == 4);
+   }
+}
+
+static void
+testSessionEvents()
+{
+   EmptyDb db;
+   ProxyConfig proxyConfig;
+   proxyConfig.createDataStore(&db);
+   SipStack stack;
+   ProcessorChain requestChain(Processor::REQUEST_CHAIN);
+   ProcessorChain responseChain(Processor::RESPONSE_CHAIN);
+   ProcessorChain targetChain(Processor::TARGET_CHAIN);
+   Proxy proxy(stack, proxyConfig, requestChain, responseChain, targetChain);
+   RequestContext context(proxy, requestChain, responseChain, targetChain);
+
+   // Which messages give an event, and from which direction
+   struct
+   {
+      const char* text;
+      bool received;
+   } calls[] = {
+      { Invite, true },     // Session Created
+      { Invite, false },    // Session Routed
+      { Bye, true },        // Session Ended
+      { Cancel, true },     // Session Cancelled
+      { Refer, true },      // Session Redirected
+      { Ok, false },        // Session Established
+      { Redirect, false },  // Session Redirected
+      { Busy, false }       // Session Error
+   };
+
+   for(int headers = 0; headers < 2; headers++)
+   {
+      ProxyConfig config;
+      config.insertConfigValue("AccountingBatchSize", "1");
+      config.insertConfigValue("SessionAccountingAddRoutingHeaders", headers ? "true" : "false");
+      config.insertConfigValue("SessionAccountingAddViaHeaders", headers ? "true" : "false");
+      StubQueueCollector collector(config);
+      CajunEventWriter cajun(headers != 0, headers != 0);
+
+      for(size_t i = 0; i < sizeof(calls) / sizeof(calls[0]); i++)
+      {
+         std::auto_ptr<SipMessage> msg(makeMessage(calls[i].text));
+         collector.doSessionAccounting(*msg, calls[i].received, context);
+         assert(collector.waitForBatches(i + 1));
+         Data record = collector.lastRecord();
+         assert(collector.batches().back().mSession == true);
+         assert(withoutDatetime(record) == withoutDatetime(cajun.doSessionAccounting(*msg, calls[i].received, context)));
+      }
+
+      // Messages that are not accounted for give no event either way
+      std::auto_ptr<SipMessage> msg(makeMessage(Bye));
+      collector.doSessionAccounting(*msg, false, context);
+      assert(cajun.doSessionAccounting(*msg, false, context).empty());
+      assert(!collector.waitForBatches(sizeof(calls) / sizeof(calls[0]) + 1, 200));
+   }
+}
+
+static void
+testBatchSizeFlush()
+{
+   // The latency is long enough that only a full batch is written at once
+   ProxyConfig config;
+   config.insertConfigValue("AccountingBatchSize", "5");
+   config.insertConfigValue("AccountingBatchLatencyMs", "1000");
+   StubQueueCollector collector(config);
+   std::auto_ptr<SipMessage> msg(makeMessage(Register));
+
+   UInt64 start = Timer::getTimeMs();
+   for(int i = 0; i < 12; i++)
+   {
+      collector.doRegistrationAccounting(AccountingCollector::RegistrationAdded, *msg);
+   }
+   assert(collector.waitForBatches(2));
+   std::vector<StubQueueCollector::Batch> batches = collector.batches();
+   assert(batches.size() == 2);
+   assert(batches[0].mRecords.size() == 5);
+   assert(batches[1].mRecords.size() == 5);
+   assert(batches[1].mWrittenMs - start < 500);
+
+   // The rest follow once the latency is up
+   assert(collector.waitForBatches(3));
+   batches = collector.batches();
+   assert(batches[2].mRecords.size() == 2);
+   assert(batches[2].mWrittenMs - start >= 900);
+
+   AccountingCollector::Stats stats = collector.getStats();
+   assert(stats.mEventsQueued == 12);
+   assert(stats.mEventsCommitted == 12);
+   assert(stats.mBatchesCommitted == 3);
+   assert(stats.mLargestBatch == 5);
+   assert(stats.mQueueSize == 0);
+}
+
+static void
+testLatencyFlush()
+{
+   // Far fewer events than a batch - they are written together once the
+   // latency is up, not one at a time and not held back any longer
+   ProxyConfig config;
+   config.insertConfigValue("AccountingBatchSize", "100");
+   config.insertConfigValue("AccountingBatchLatencyMs", "200");
+   StubQueueCollector collector(config);
+   std::auto_ptr<SipMessage> msg(makeMessage(Register));
+
+   UInt64 start = Timer::getTimeMs();
+   for(int i = 0; i < 3; i++)
+   {
+      collector.doRegistrationAccounting(AccountingCollector::RegistrationAdded, *msg);
+   }
+   assert(collector.waitForBatches(1));
+   std::vector<StubQueueCollector::Batch> batches = collector.batches();
+   assert(batches[0].mRecords.size() == 3);
+   assert(batches[0].mWrittenMs - start >= 150);
+   assert(batches[0].mWrittenMs - start < 1000);
+   assert(!collector.waitForBatches(2, 300));
+
+   // Registration and session events arriving together are still written to
+   // their own queues
+   EmptyDb db;
+   ProxyConfig proxyConfig;
+   proxyConfig.createDataStore(&db);
+   SipStack stack;
+   ProcessorChain requestChain(Processor::REQUEST_CHAIN);
+   ProcessorChain responseChain(Processor::RESPONSE_CHAIN);
+   ProcessorChain targetChain(Processor::TARGET_CHAIN);
+   Proxy proxy(stack, proxyConfig, requestChain, responseChain, targetChain);
+   RequestContext context(proxy, requestChain, responseChain, targetChain);
+   std::auto_ptr<SipMessage> invite(makeMessage(Invite));
+   collector.doRegistrationAccounting(AccountingCollector::RegistrationRemoved, *msg);
+   collector.doSessionAccounting(*invite, true, context);
+   collector.doRegistrationAccounting(AccountingCollector::RegistrationAdded, *msg);
+   assert(collector.waitForBatches(3));
+   batches = collector.batches();
+   assert(batches.size() == 3);
+   assert(batches[1].mSession && batches[1].mRecords.size() == 1);
+   assert(!batches[2].mSession && batches[2].mRecords.size() == 2);
+
+   AccountingCollector::Stats stats = collector.getStats();
+   assert(stats.mEventsCommitted == 6);
+   assert(stats.mBatchesCommitted == 3);
+}
+
+int
+main(int argc, char** argv)
+{
+   Log::initialize(Log::Cout, Log::Warning, argv[0]);
+
+   testStrings();
+   testRegistrationEvents();
+   testSessionEvents();
+   testBatchSizeFlush();
+   testLatencyFlush();
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
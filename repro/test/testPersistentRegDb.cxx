@@ -0,0 +1,308 @@
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "rutil/Data.hxx"
+#include "rutil/Log.hxx"
+#include "rutil/Timer.hxx"
+#include "repro/PersistentRegDb.hxx"
+
+using namespace repro;
+using namespace resip;
+using namespace std;
+
+// Long enough that nothing is written in the background - the tests commit
+// explicitly, or rely on the destructor doing it
+static const unsigned int CommitIntervalMs = 60000;
+
+static const Data logPath("testPersistentRegDb.log");
+
+static Data
+readLog()
+{
+   ifstream in(logPath.c_str(), ios::binary);
+   assert(in);
+   Data contents;
+   char buf[8192];
+   while(in.read(buf, sizeof(buf)) || in.gcount() > 0)
+   {
+      contents.append(buf, (Data::size_type)in.gcount());
+   }
+   return contents;
+}
+
+static void
+writeLog(const char* data, size_t size)
+{
+   ofstream out(logPath.c_str(), ios::binary | ios::trunc);
+   out.write(data, size);
+   assert(out);
+}
+
+// The file is extended in large steps, so the records end at the last
+// non-zero byte (every record here ends with a user agent string)
+static size_t
+dataEnd()
+{
+   Data contents = readLog();
+   size_t end = contents.size();
+   while(end > 0 && contents[end - 1] == 0)
+   {
+      end--;
+   }
+   return end;
+}
+
+static ino_t
+logInode()
+{
+   struct stat st;
+   int rc = stat(logPath.c_str(), &st);
+   assert(rc == 0);
+   return st.st_ino;
+}
+
+static void
+removeLog()
+{
+   unlink(logPath.c_str());
+   unlink((logPath + ".compact").c_str());
+}
+
+static Uri
+makeAor(int i)
+{
+   return Uri("sip:user" + Data(i) + "@example.com");
+}
+
+static ContactInstanceRecord
+makeContact(int i, int instance, const Data& userAgent)
+{
+   ContactInstanceRecord rec;
+   rec.mContact = NameAddr("<sip:user" + Data(i) + "@10.0.0." + Data(instance) + ":5060>");
+   rec.mRegExpires = Timer::getTimeSecs() + 3600;
+   rec.mLastUpdated = Timer::getTimeSecs();
+   rec.mUserAgent = userAgent;
+   return rec;
+}
+
+// Adds aor i with one binding, or two for odd i
+static void
+addBindings(PersistentRegDb& db, int i, const Data& userAgent)
+{
+   db.updateContact(makeAor(i), makeContact(i, 1, userAgent));
+   if(i % 2)
+   {
+      db.updateContact(makeAor(i), makeContact(i, 2, userAgent));
+   }
+}
+
+static void
+checkBindings(PersistentRegDb& db, int i, const Data& userAgent)
+{
+   ContactList contacts;
+   db.getContacts(makeAor(i), contacts);
+   assert(contacts.size() == (i % 2 ? 2U : 1U));
+   int instance = 1;
+   for(ContactList::iterator it = contacts.begin(); it != contacts.end(); it++, instance++)
+   {
+      assert(it->mContact.uri() == makeContact(i, instance, userAgent).mContact.uri());
+      assert(it->mUserAgent == userAgent);
+      assert(it->mRegExpires > Timer::getTimeSecs());
+      assert(!it->mSyncContact);
+   }
+}
+
+static void
+testRestore()
+{
+   removeLog();
+   {
+      PersistentRegDb db(logPath, 0, CommitIntervalMs);
+      for(int i = 0; i < 10; i++)
+      {
+         addBindings(db, i, "first");
+      }
+      db.commit();
+      // Later records for an AOR win, and an emptied AOR stays removed
+      addBindings(db, 3, "second");
+      db.removeAor(makeAor(4));
+      // Not committed - the destructor writes it
+   }
+   {
+      PersistentRegDb db(logPath, 0, CommitIntervalMs);
+      RegistrationPersistenceManager::UriList aors;
+      db.getAors(aors);
+      assert(aors.size() == 9);
+      for(int i = 0; i < 10; i++)
+      {
+         if(i == 4)
+         {
+            assert(!db.aorIsRegistered(makeAor(i)));
+         }
+         else
+         {
+            checkBindings(db, i, i == 3 ? "second" : "first");
+         }
+      }
+   }
+}
+
+static void
+testTornRecord()
+{
+   removeLog();
+   size_t recordStart;
+   {
+      PersistentRegDb db(logPath, 0, CommitIntervalMs);
+      addBindings(db, 1, "first");
+      addBindings(db, 2, "first");
+      db.commit();
+      recordStart = dataEnd();
+      addBindings(db, 3, "first");
+   }
+   size_t recordEnd = dataEnd();
+   assert(recordEnd > recordStart);
+   Data complete = readLog().substr(0, recordEnd);
+
+   // Cut the last record just after its checksum, just after the frame marker,
+   // half way through, and one byte short
+   size_t cuts[] = { recordStart + 4, recordStart + 5, (recordStart + recordEnd) / 2, recordEnd - 1 };
+   for(unsigned int c = 0; c < sizeof(cuts) / sizeof(cuts[0]); c++)
+   {
+      removeLog();
+      writeLog(complete.data(), cuts[c]);
+      ino_t tornInode = logInode();
+      {
+         // Replay stops at the torn record, and the log is rewritten without it
+         PersistentRegDb db(logPath, 0, CommitIntervalMs);
+         checkBindings(db, 1, "first");
+         checkBindings(db, 2, "first");
+         assert(!db.aorIsRegistered(makeAor(3)));
+         assert(logInode() != tornInode);
+         assert(dataEnd() == recordStart);
+         addBindings(db, 5, "after");
+      }
+      ino_t rewrittenInode = logInode();
+      {
+         // New records went after the good ones - this replay is clean
+         PersistentRegDb db(logPath, 0, CommitIntervalMs);
+         checkBindings(db, 1, "first");
+         checkBindings(db, 2, "first");
+         checkBindings(db, 5, "after");
+         assert(!db.aorIsRegistered(makeAor(3)));
+         assert(logInode() == rewrittenInode);
+      }
+   }
+}
+
+static void
+testCompaction()
+{
+   const int numAors = 200;
+   removeLog();
+   Data userAgent;
+   {
+      PersistentRegDb db(logPath, 0, CommitIntervalMs);
+      ino_t inode = logInode();
+      size_t sizeBeforeCompaction = 0;
+      for(int round = 0; logInode() == inode; round++)
+      {
+         assert(round < 1000);
+         sizeBeforeCompaction = dataEnd();
+         userAgent = "round-" + Data(round);
+         for(int i = 0; i < numAors; i++)
+         {
+            addBindings(db, i, userAgent);
+         }
+         db.commit();
+      }
+      // Compaction happened once the log passed its threshold (the 1MB minimum,
+      // since it starts out empty), and left one record per AOR
+      assert(sizeBeforeCompaction > 1024*1024 / 2);
+      assert(dataEnd() < sizeBeforeCompaction / 4);
+      RegistrationPersistenceManager::UriList aors;
+      db.getAors(aors);
+      assert(aors.size() == (size_t)numAors);
+      for(int i = 0; i < numAors; i++)
+      {
+         checkBindings(db, i, userAgent);
+      }
+   }
+   {
+      PersistentRegDb db(logPath, 0, CommitIntervalMs);
+      RegistrationPersistenceManager::UriList aors;
+      db.getAors(aors);
+      assert(aors.size() == (size_t)numAors);
+      for(int i = 0; i < numAors; i++)
+      {
+         checkBindings(db, i, userAgent);
+      }
+   }
+}
+
+int
+main(int argc, char** argv)
+{
+   Log::initialize(Log::Cout, Log::Err, argv[0]);
+
+   testRestore();
+   testTornRecord();
+   testCompaction();
+   removeLog();
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,281 @@
+#include <cassert>
+#include <iostream>
+
+#include "rutil/Data.hxx"
+#include "resip/stack/Tuple.hxx"
+#include "resip/dum/ContactInstanceRecord.hxx"
+#include "repro/RegSyncProtocol.hxx"
+
+using namespace repro;
+using namespace resip;
+using namespace std;
+
+// Values either side of the points where a varint needs another byte
+static const UInt64 boundaries[] =
+{
+   0x7fULL, 0x80ULL,
+   0x3fffULL, 0x4000ULL,
+   0xfffffffULL, 0x10000000ULL,
+   0x7fffffffffffffffULL, 0x8000000000000000ULL
+};
+static const unsigned int numBoundaries = sizeof(boundaries) / sizeof(boundaries[0]);
+
+static unsigned int
+varintSize(UInt64 value)
+{
+   unsigned int size = 1;
+   while(value >>= 7)
+   {
+      size++;
+   }
+   return size;
+}
+
+static Data
+makeAorFrame(UInt64 sequence, const Uri& aor, const ContactList& contacts, UInt64 now)
+{
+   Data buffer;
+   Data::size_type frameStart = RegSyncProtocol::startFrame(buffer, now);
+   bool encoded = RegSyncProtocol::encodeAor(buffer, sequence, aor, contacts, now);
+   assert(encoded);
+   RegSyncProtocol::endFrame(buffer, frameStart);
+   assert(RegSyncProtocol::getFrameSize(buffer.data(), buffer.size()) == buffer.size());
+   return buffer;
+}
+
+static ContactInstanceRecord
+makeContact(UInt64 value)
+{
+   ContactInstanceRecord rec;
+   rec.mContact = NameAddr("<sip:alice@192.168.1.10:5060;transport=tcp>");
+   rec.mRegExpires = value;
+   rec.mLastUpdated = value;
+   rec.mReceivedFrom = Tuple("192.168.1.10", 5060, V4, TCP);
+   rec.mSipPath.push_back(NameAddr("<sip:edge.example.com;lr>"));
+   rec.mInstance = "<urn:uuid:f81d4fae-7dec-11d0-a765-00a0c91e6bf6>";
+   rec.mRegId = (UInt32)value;
+   rec.mUserAgent = "testRegSyncProtocol";
+   return rec;
+}
+
+static void
+testAorRoundTrip(UInt64 value)
+{
+   const UInt64 now = 1;
+   Uri aor("sip:alice@example.com");
+   ContactList contacts;
+   contacts.push_back(makeContact(value));
+
+   Data frame = makeAorFrame(value, aor, contacts, now);
+   RegSyncDecoder decoder(frame.data() + RegSyncProtocol::FrameHeaderSize,
+                          (unsigned int)(frame.size() - RegSyncProtocol::FrameHeaderSize));
+   decoder.useServerClock();
+   assert(decoder.getServerTime() == now);
+   assert(decoder.getRecordType() == RegSyncProtocol::AorRecord);
+   assert(decoder.getSequence() == value);
+
+   Uri decodedAor;
+   ContactList decoded;
+   decoder.decodeAor(decodedAor, decoded);
+   assert(decoder.eof());
+   assert(decodedAor == aor);
+   assert(decoded.size() == 1);
+
+   const ContactInstanceRecord& rec = decoded.front();
+   const ContactInstanceRecord& orig = contacts.front();
+   assert(Data::from(rec.mContact) == Data::from(orig.mContact));
+   assert(rec.mRegExpires == orig.mRegExpires);
+   assert(rec.mLastUpdated == orig.mLastUpdated);
+   assert(rec.mReceivedFrom == orig.mReceivedFrom);
+   assert(rec.mSipPath.size() == 1);
+   assert(rec.mSipPath.front().uri() == orig.mSipPath.front().uri());
+   assert(rec.mInstance == orig.mInstance);
+   assert(rec.mRegId == orig.mRegId);
+   assert(rec.mUserAgent == orig.mUserAgent);
+   assert(rec.mSyncContact);
+}
+
+static void
+testVarintSizes(UInt64 value)
+{
+   // type, sequence 0, empty server id, sequence, resumed flag
+   Data buffer;
+   RegSyncProtocol::encodeSyncComplete(buffer, Data::Empty, value, true);
+   assert(buffer.size() == 4 + varintSize(value));
+
+   Data payload;
+   RegSyncProtocol::startFrame(payload, value);
+   payload = payload.substr(RegSyncProtocol::FrameHeaderSize) + buffer;
+   RegSyncDecoder decoder(payload.data(), (unsigned int)payload.size());
+   assert(decoder.getServerTime() == value);
+   assert(decoder.getRecordType() == RegSyncProtocol::SyncCompleteRecord);
+   Data serverId;
+   UInt64 sequence = 0;
+   bool resumed = false;
+   decoder.decodeSyncComplete(serverId, sequence, resumed);
+   assert(decoder.eof());
+   assert(serverId.empty());
+   assert(sequence == value);
+   assert(resumed);
+}
+
+static bool
+decodeThrows(const char* payload, unsigned int size)
+{
+   try
+   {
+      RegSyncDecoder decoder(payload, size);
+      while(!decoder.eof())
+      {
+         switch(decoder.getRecordType())
+         {
+         case RegSyncProtocol::AorRecord:
+            {
+               Uri aor;
+               ContactList contacts;
+               decoder.decodeAor(aor, contacts);
+            }
+            break;
+         case RegSyncProtocol::SyncCompleteRecord:
+            {
+               Data serverId;
+               UInt64 sequence;
+               bool resumed;
+               decoder.decodeSyncComplete(serverId, sequence, resumed);
+            }
+            break;
+         default:
+            assert(false);
+         }
+      }
+   }
+   catch(RegSyncProtocol::Exception&)
+   {
+      return true;
+   }
+   return false;
+}
+
+static void
+testTruncatedFrame()
+{
+   ContactList contacts;
+   contacts.push_back(makeContact(0x8000000000000000ULL));
+   Data frame = makeAorFrame(0x10000000ULL, Uri("sip:alice@example.com"), contacts, 1);
+   unsigned int payloadSize = (unsigned int)(frame.size() - RegSyncProtocol::FrameHeaderSize);
+
+   // A partial frame is not handed to the decoder
+   for(unsigned int i = 1; i < frame.size(); i++)
+   {
+      assert(RegSyncProtocol::getFrameSize(frame.data(), i) == 0);
+   }
+
+   // Cutting the payload anywhere must be detected, not read past.  Each prefix is
+   // copied so that it really does end where the decoder is told it ends.  The one
+   // byte server time on its own is a valid (empty) frame, so it is skipped.
+   assert(!decodeThrows(frame.data() + RegSyncProtocol::FrameHeaderSize, payloadSize));
+   for(unsigned int len = 0; len < payloadSize; len++)
+   {
+      if(len == 1)
+      {
+         continue;
+      }
+      Data prefix(frame.data() + RegSyncProtocol::FrameHeaderSize, len);
+      assert(decodeThrows(prefix.data(), len));
+   }
+}
+
+static void
+testOverlongVarint()
+{
+   // Eleven continuation bytes can never terminate within 64 bits
+   Data payload(11, Data::Preallocate);
+   for(int i = 0; i < 10; i++)
+   {
+      payload += (char)0xff;
+   }
+   payload += (char)0x01;
+   assert(decodeThrows(payload.data(), (unsigned int)payload.size()));
+
+   // Same for a varint inside a record - server time 1, AOR record, bad sequence
+   Data record;
+   record += (char)0x01;
+   record += (char)RegSyncProtocol::AorRecord;
+   for(int i = 0; i < 10; i++)
+   {
+      record += (char)0x80;
+   }
+   record += (char)0x00;
+   assert(decodeThrows(record.data(), (unsigned int)record.size()));
+
+   // And a varint that runs into the end of the frame
+   Data unterminated;
+   unterminated += (char)0x80;
+   unterminated += (char)0x80;
+   assert(decodeThrows(unterminated.data(), (unsigned int)unterminated.size()));
+}
+
+int
+main(int argc, char** argv)
+{
+   for(unsigned int i = 0; i < numBoundaries; i++)
+   {
+      testVarintSizes(boundaries[i]);
+      testAorRoundTrip(boundaries[i]);
+   }
+   testTruncatedFrame();
+   testOverlongVarint();
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
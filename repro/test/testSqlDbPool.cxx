@@ -0,0 +1,279 @@
+#include <cassert>
+#include <iostream>
+#include <set>
+#include <vector>
+
+#include "rutil/Condition.hxx"
+#include "rutil/ConfigParse.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Lock.hxx"
+#include "rutil/Mutex.hxx"
+#include "rutil/ThreadIf.hxx"
+#include "rutil/Time.hxx"
+#include "repro/SqlDb.hxx"
+
+using namespace repro;
+using namespace resip;
+using namespace std;
+
+static const unsigned int PoolSize = 4;
+static const unsigned int WaitTimeoutMs = 5000;
+
+class TestConfig : public ConfigParse
+{
+public:
+   virtual void printHelpText(int argc, char **argv) {}
+};
+
+// A backend without a database: query() records the pool slot it was given and
+// then holds it until the test hands out a permit
+class PoolTestDb : public SqlDb
+{
+public:
+   PoolTestDb(const ConfigParse& config) : SqlDb(config), mRunning(0), mPermits(0) {}
+
+   virtual int query(const Data& queryCommand) const
+   {
+      PooledConnection pooled(*this);
+      Lock lock(mMutex);
+      mSlots.push_back(pooled.index());
+      mRunning++;
+      mCondition.broadcast();
+      while(mPermits == 0)
+      {
+         mCondition.wait(mMutex);
+      }
+      mPermits--;
+      mRunning--;
+      mCondition.broadcast();
+      return 0;
+   }
+
+   void release(unsigned int permits)
+   {
+      Lock lock(mMutex);
+      mPermits += permits;
+      mCondition.broadcast();
+   }
+
+   // Waits until this many queries have been given a slot in total
+   void waitForQueries(size_t started)
+   {
+      Lock lock(mMutex);
+      while(mSlots.size() < started)
+      {
+         bool signalled = mCondition.wait(mMutex, WaitTimeoutMs);
+         assert(signalled);
+      }
+   }
+
+   unsigned int running() const
+   {
+      Lock lock(mMutex);
+      return mRunning;
+   }
+
+   vector<unsigned int> slots() const
+   {
+      Lock lock(mMutex);
+      return mSlots;
+   }
+
+   void waitForPoolWaits(UInt64 waits) const
+   {
+      for(unsigned int ms = 0; getPoolWaitCount() < waits; ms += 10)
+      {
+         assert(ms < WaitTimeoutMs);
+         sleepMs(10);
+      }
+   }
+
+   void beginTransaction() { setInTransaction(true); }
+   void endTransaction() { setInTransaction(false); }
+
+   virtual int singleResultQuery(const Data& queryCommand, vector<Data>& fields) const { return query(queryCommand); }
+
+private:
+   virtual bool dbWriteRecord(const Table table, const Data& key, const Data& data) { return false; }
+   virtual bool dbReadRecord(const Table table, const Data& key, Data& data) const { return false; }
+   virtual Data dbNextKey(const Table table, bool first=false) { return Data::Empty; }
+   virtual bool dbNextRecord(const Table table, const Data& key, Data& data, bool forUpdate, bool first=false) { return false; }
+   virtual bool dbBeginTransaction(const Table table) { setInTransaction(true); return true; }
+   virtual Data& escapeString(const Data& str, Data& escapedStr) const { return escapedStr = str; }
+   virtual void userWhereClauseToDataStream(const Key& key, DataStream& ds) const {}
+   virtual void tlsPeerIdentityWhereClauseToDataStream(const Key& key, DataStream& ds) const {}
+
+   mutable Mutex mMutex;
+   mutable Condition mCondition;
+   mutable vector<unsigned int> mSlots;
+   mutable unsigned int mRunning;
+   mutable unsigned int mPermits;
+};
+
+class QueryThread : public ThreadIf
+{
+public:
+   QueryThread(PoolTestDb& db) : mDb(db) {}
+   virtual ~QueryThread() { join(); }
+   virtual void thread() { mDb.query("SELECT 1"); }
+private:
+   PoolTestDb& mDb;
+};
+
+static void
+startQueries(PoolTestDb& db, vector<QueryThread*>& threads, unsigned int count)
+{
+   for(unsigned int i = 0; i < count; i++)
+   {
+      threads.push_back(new QueryThread(db));
+      threads.back()->run();
+   }
+}
+
+static void
+joinQueries(vector<QueryThread*>& threads)
+{
+   for(vector<QueryThread*>::iterator it = threads.begin(); it != threads.end(); it++)
+   {
+      delete *it;
+   }
+   threads.clear();
+}
+
+static void
+testDistinctSlots(const ConfigParse& config)
+{
+   PoolTestDb db(config);
+   assert(db.getPoolSize() == PoolSize);
+   vector<QueryThread*> threads;
+
+   // One query per slot - each gets its own connection without waiting
+   startQueries(db, threads, PoolSize);
+   db.waitForQueries(PoolSize);
+   vector<unsigned int> slots = db.slots();
+   set<unsigned int> distinct(slots.begin(), slots.end());
+   assert(distinct.size() == PoolSize);
+   assert(*distinct.rbegin() == PoolSize - 1);
+   assert(db.getConnectionsInUse() == PoolSize);
+   assert(db.getPoolWaitCount() == 0);
+
+   // One more has to wait for a slot to be released
+   startQueries(db, threads, 1);
+   db.waitForPoolWaits(1);
+   assert(db.running() == PoolSize);
+   assert(db.slots().size() == PoolSize);
+
+   db.release(1);
+   db.waitForQueries(PoolSize + 1);
+   assert(db.getConnectionsInUse() == PoolSize);
+   assert(db.getPoolWaitCount() == 1);
+
+   db.release(PoolSize);
+   joinQueries(threads);
+   assert(db.getConnectionsInUse() == 0);
+   assert(db.getMaxConnectionsInUse() == PoolSize);
+   assert(db.getQueryCount() == PoolSize + 1);
+}
+
+static void
+testTransactionUsesSlotZero(const ConfigParse& config)
+{
+   PoolTestDb db(config);
+   vector<QueryThread*> threads;
+
+   // While a transaction is open every query runs on slot 0, one at a time
+   db.beginTransaction();
+   startQueries(db, threads, PoolSize);
+   db.waitForQueries(1);
+   db.waitForPoolWaits(PoolSize - 1);
+   assert(db.running() == 1);
+   assert(db.getConnectionsInUse() == 1);
+   for(unsigned int i = 1; i <= PoolSize; i++)
+   {
+      db.release(1);
+      if(i < PoolSize)
+      {
+         db.waitForQueries(i + 1);
+      }
+   }
+   joinQueries(threads);
+   vector<unsigned int> slots = db.slots();
+   assert(slots.size() == PoolSize);
+   for(unsigned int i = 0; i < slots.size(); i++)
+   {
+      assert(slots[i] == 0);
+   }
+   assert(db.getMaxConnectionsInUse() == 1);
+
+   // Once it ends the pool is shared out again
+   db.endTransaction();
+   startQueries(db, threads, PoolSize);
+   db.waitForQueries(2 * PoolSize);
+   assert(db.getConnectionsInUse() == PoolSize);
+   db.release(PoolSize);
+   joinQueries(threads);
+   assert(db.getMaxConnectionsInUse() == PoolSize);
+}
+
+int
+main(int argc, char** argv)
+{
+   TestConfig config;
+   config.insertConfigValue("ConnectionPoolSize", Data(PoolSize));
+
+   testDistinctSlots(config);
+   testTransactionUsesSlotZero(config);
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
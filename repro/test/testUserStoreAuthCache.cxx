@@ -0,0 +1,334 @@
+#include <cassert>
+#include <iostream>
+#include <map>
+
+#include "rutil/Data.hxx"
+#include "rutil/DataStream.hxx"
+#include "rutil/Time.hxx"
+#include "repro/AbstractDb.hxx"
+#include "repro/UserStore.hxx"
+
+using namespace repro;
+using namespace resip;
+using namespace std;
+
+// An in-memory backend that counts user table reads, so that the tests can
+// tell whether getUserAuthInfo was answered from the cache
+class MemoryDb : public AbstractDb
+{
+public:
+   MemoryDb() : mUserReads(0), mInvalidateOnRead(0) {}
+
+   virtual bool isSane() { return true; }
+
+   // When set, the next user table read invalidates this user in the store
+   // before it returns - as if another thread changed the user while the
+   // read was in progress
+   void invalidateOnNextRead(UserStore& store, const Data& user, const Data& realm)
+   {
+      mInvalidateOnRead = &store;
+      mInvalidateUser = user;
+      mInvalidateRealm = realm;
+   }
+
+   mutable unsigned int mUserReads;
+
+private:
+   virtual bool dbWriteRecord(const Table table, const Data& key, const Data& data)
+   {
+      mTables[table][key] = data;
+      return true;
+   }
+   virtual bool dbReadRecord(const Table table, const Data& key, Data& data) const
+   {
+      if(table == UserTable)
+      {
+         mUserReads++;
+         if(mInvalidateOnRead)
+         {
+            UserStore* store = mInvalidateOnRead;
+            mInvalidateOnRead = 0;
+            store->invalidateAuthCache(mInvalidateUser, mInvalidateRealm);
+         }
+      }
+      map<Data, Data>::const_iterator it = mTables[table].find(key);
+      if(it == mTables[table].end())
+      {
+         return false;
+      }
+      data = it->second;
+      return true;
+   }
+   virtual void dbEraseRecord(const Table table, const Data& key, bool isSecondaryKey=false)
+   {
+      mTables[table].erase(key);
+   }
+   virtual Data dbNextKey(const Table table, bool first=false) { return Data::Empty; }
+   virtual bool dbNextRecord(const Table table, const Data& key, Data& data, bool forUpdate, bool first=false) { return false; }
+   virtual bool dbBeginTransaction(const Table table) { return true; }
+   virtual bool dbCommitTransaction(const Table table) { return true; }
+   virtual bool dbRollbackTransaction(const Table table) { return true; }
+
+   mutable map<Data, Data> mTables[MaxTable];
+   mutable UserStore* mInvalidateOnRead;
+   Data mInvalidateUser;
+   Data mInvalidateRealm;
+};
+
+static Data
+addUser(UserStore& store, const Data& user, const Data& password)
+{
+   store.addUser(user, "example.com", "example.com", password, true, Data::Empty, Data::Empty);
+   return store.getUserInfo(UserStore::buildKey(user, "example.com")).passwordHash;
+}
+
+static void
+testHitAndMiss()
+{
+   MemoryDb db;
+   UserStore store(db);
+   store.setAuthCacheParameters(10, 60, 60);
+   Data a1 = addUser(store, "alice", "secret");
+   assert(!a1.empty());
+
+   Data cached;
+   assert(!store.getCachedUserAuthInfo("alice", "example.com", cached));
+
+   db.mUserReads = 0;
+   assert(store.getUserAuthInfo("alice", "example.com") == a1);
+   assert(db.mUserReads == 1);
+   assert(store.getUserAuthInfo("alice", "example.com") == a1);
+   assert(db.mUserReads == 1);
+   assert(store.getCachedUserAuthInfo("alice", "example.com", cached));
+   assert(cached == a1);
+
+   // Unknown users are cached with an empty A1
+   assert(store.getUserAuthInfo("bob", "example.com").empty());
+   assert(db.mUserReads == 2);
+   assert(store.getUserAuthInfo("bob", "example.com").empty());
+   assert(db.mUserReads == 2);
+   cached = "x";
+   assert(store.getCachedUserAuthInfo("bob", "example.com", cached));
+   assert(cached.empty());
+
+   // The realm is part of the key
+   assert(store.getUserAuthInfo("alice", "example.org").empty());
+   assert(db.mUserReads == 3);
+
+   Data stats;
+   {
+      DataStream ds(stats);
+      store.encodeAuthCacheStats(ds);
+   }
+   assert(stats.find("Hits: 2") != Data::npos);
+   assert(stats.find("Negative hits: 2") != Data::npos);
+   assert(stats.find("Misses: 3") != Data::npos);
+
+   store.clearAuthCache();
+   assert(!store.getCachedUserAuthInfo("alice", "example.com", cached));
+   assert(!store.getCachedUserAuthInfo("bob", "example.com", cached));
+
+   // maxEntries 0 disables the cache
+   store.setAuthCacheParameters(0, 60, 60);
+   db.mUserReads = 0;
+   assert(store.getUserAuthInfo("alice", "example.com") == a1);
+   assert(store.getUserAuthInfo("alice", "example.com") == a1);
+   assert(db.mUserReads == 2);
+   assert(!store.getCachedUserAuthInfo("alice", "example.com", cached));
+}
+
+static void
+testExpiry()
+{
+   MemoryDb db;
+   UserStore store(db);
+   store.setAuthCacheParameters(10, 2, 1);
+   Data a1 = addUser(store, "alice", "secret");
+
+   Data cached;
+   assert(store.getUserAuthInfo("alice", "example.com") == a1);
+   assert(store.getUserAuthInfo("bob", "example.com").empty());
+   assert(store.getCachedUserAuthInfo("alice", "example.com", cached));
+   assert(store.getCachedUserAuthInfo("bob", "example.com", cached));
+
+   // The negative entry goes first...
+   sleepMs(1200);
+   assert(store.getCachedUserAuthInfo("alice", "example.com", cached));
+   assert(cached == a1);
+   assert(!store.getCachedUserAuthInfo("bob", "example.com", cached));
+
+   // ...then the positive one, and the next lookup reads the database again
+   sleepMs(1000);
+   assert(!store.getCachedUserAuthInfo("alice", "example.com", cached));
+   db.mUserReads = 0;
+   assert(store.getUserAuthInfo("alice", "example.com") == a1);
+   assert(db.mUserReads == 1);
+
+   // A negative TTL of 0 means unknown users are not cached at all
+   store.setAuthCacheParameters(10, 60, 0);
+   assert(store.getUserAuthInfo("bob", "example.com").empty());
+   assert(!store.getCachedUserAuthInfo("bob", "example.com", cached));
+}
+
+static void
+testLruEviction()
+{
+   MemoryDb db;
+   UserStore store(db);
+   store.setAuthCacheParameters(3, 60, 60);
+   Data a1 = addUser(store, "u1", "p1");
+   addUser(store, "u2", "p2");
+   addUser(store, "u3", "p3");
+   addUser(store, "u4", "p4");
+
+   Data cached;
+   store.getUserAuthInfo("u1", "example.com");
+   store.getUserAuthInfo("u2", "example.com");
+   store.getUserAuthInfo("u3", "example.com");
+
+   // Using u1 makes u2 the least recently used entry
+   assert(store.getCachedUserAuthInfo("u1", "example.com", cached));
+   store.getUserAuthInfo("u4", "example.com");
+   assert(store.getCachedUserAuthInfo("u1", "example.com", cached));
+   assert(cached == a1);
+   assert(!store.getCachedUserAuthInfo("u2", "example.com", cached));
+   assert(store.getCachedUserAuthInfo("u3", "example.com", cached));
+   assert(store.getCachedUserAuthInfo("u4", "example.com", cached));
+
+   // Now u1 is the oldest
+   store.getUserAuthInfo("u2", "example.com");
+   assert(!store.getCachedUserAuthInfo("u1", "example.com", cached));
+   assert(store.getCachedUserAuthInfo("u2", "example.com", cached));
+
+   Data stats;
+   {
+      DataStream ds(stats);
+      store.encodeAuthCacheStats(ds);
+   }
+   assert(stats.find("Entries: 3") != Data::npos);
+   assert(stats.find("Evictions: 2") != Data::npos);
+}
+
+static void
+testInvalidation()
+{
+   MemoryDb db;
+   UserStore store(db);
+   store.setAuthCacheParameters(10, 60, 60);
+
+   // A cached unknown user is found once it is added
+   Data cached;
+   assert(store.getUserAuthInfo("alice", "example.com").empty());
+   Data a1 = addUser(store, "alice", "secret");
+   assert(!store.getCachedUserAuthInfo("alice", "example.com", cached));
+   assert(store.getUserAuthInfo("alice", "example.com") == a1);
+
+   // A password change is seen at once
+   Data a1b = addUser(store, "alice", "changed");
+   assert(a1b != a1);
+   assert(!store.getCachedUserAuthInfo("alice", "example.com", cached));
+   assert(store.getUserAuthInfo("alice", "example.com") == a1b);
+
+   // Erasing drops the entry, including one for the user's realm when that
+   // differs from its domain
+   store.addUser("carol", "example.com", "realm.example.com", "pw", true, Data::Empty, Data::Empty);
+   store.getUserAuthInfo("carol", "realm.example.com");
+   assert(store.getCachedUserAuthInfo("carol", "realm.example.com", cached));
+
+   store.eraseUser(UserStore::buildKey("alice", "example.com"));
+   store.eraseUser(UserStore::buildKey("carol", "example.com"));
+   assert(!store.getCachedUserAuthInfo("alice", "example.com", cached));
+   assert(!store.getCachedUserAuthInfo("carol", "realm.example.com", cached));
+   assert(store.getUserAuthInfo("alice", "example.com").empty());
+}
+
+static void
+testStaleFill()
+{
+   MemoryDb db;
+   UserStore store(db);
+   store.setAuthCacheParameters(10, 60, 60);
+   Data a1 = addUser(store, "alice", "secret");
+
+   // The user is invalidated while its database read is in progress - the
+   // result that was read is returned, but not cached
+   db.invalidateOnNextRead(store, "alice", "example.com");
+   db.mUserReads = 0;
+   assert(store.getUserAuthInfo("alice", "example.com") == a1);
+   assert(db.mUserReads == 1);
+   Data cached;
+   assert(!store.getCachedUserAuthInfo("alice", "example.com", cached));
+
+   // The next lookup reads and caches as usual
+   assert(store.getUserAuthInfo("alice", "example.com") == a1);
+   assert(db.mUserReads == 2);
+   assert(store.getCachedUserAuthInfo("alice", "example.com", cached));
+
+   // Any invalidation or clear counts, not just one for the same user
+   store.clearAuthCache();
+   db.invalidateOnNextRead(store, "someone", "else.com");
+   assert(store.getUserAuthInfo("alice", "example.com") == a1);
+   assert(!store.getCachedUserAuthInfo("alice", "example.com", cached));
+}
+
+int
+main(int argc, char** argv)
+{
+   testHitAndMiss();
+   testExpiry();
+   testLruEviction();
+   testInvalidation();
+   testStaleFill();
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -47,6 +47,7 @@ DialogId::DialogId(const SipMessage& msg) :
          }
       }
    }
+   computeHash();
    DebugLog ( << "DialogId::DialogId: " << *this);   
 }
 
@@ -54,25 +55,36 @@ DialogId::DialogId(const Data& callId, const Data& localTag, const Data& remoteT
    mDialogSetId(callId, localTag),
    mRemoteTag(remoteTag)
 {
+   computeHash();
 }
 
 DialogId::DialogId(const DialogSetId& id, const Data& remoteTag) :
    mDialogSetId(id),
    mRemoteTag(remoteTag)
 {
+   computeHash();
    DebugLog ( << "DialogId::DialogId: " << *this);   
 }
 
+void
+DialogId::computeHash()
+{
+   // the local and remote tags are combined asymmetrically so that both ends
+   // of a dialog handled by the same DUM don't collide
+   mHash = mDialogSetId.hash();
+   mHash ^= mRemoteTag.hash() + 0x9e3779b9 + (mHash << 6) + (mHash >> 2);
+}
+
 bool
 DialogId::operator==(const DialogId& rhs) const
 {
-   return mDialogSetId == rhs.mDialogSetId && mRemoteTag == rhs.mRemoteTag;
+   return mHash == rhs.mHash && mDialogSetId == rhs.mDialogSetId && mRemoteTag == rhs.mRemoteTag;
 }
 
 bool
 DialogId::operator!=(const DialogId& rhs) const
 {
-   return mDialogSetId != rhs.mDialogSetId || mRemoteTag != rhs.mRemoteTag;
+   return !(*this == rhs);
 }
 
 bool
@@ -123,7 +135,7 @@ resip::operator<<(EncodeStream& os, const DialogId& id)
 
 size_t DialogId::hash() const 
 {
-   return mDialogSetId.hash() ^ mRemoteTag.hash();
+   return mHash;
 }
 
 HashValueImp(resip::DialogId, data.hash());
@@ -28,8 +28,11 @@ class DialogId
 
    private:
       friend EncodeStream& operator<<(EncodeStream&, const DialogId& id);
+      void computeHash();
+
       DialogSetId mDialogSetId;
       Data mRemoteTag;
+      size_t mHash;
 };
 }
 
@@ -9,6 +9,7 @@
 #include "resip/dum/MergedRequestKey.hxx"
 #include "resip/dum/Handles.hxx"
 #include "resip/stack/SipMessage.hxx"
+#include "rutil/HashMap.hxx"
 #include "rutil/SharedPtr.hxx"
 
 namespace resip
@@ -106,7 +107,7 @@ class DialogSet
 
       MergedRequestKey mMergeKey;
       Data mCancelKey;
-      typedef std::map<DialogId,Dialog*> DialogMap;
+      typedef HashMap<DialogId,Dialog*> DialogMap;
       DialogMap mDialogs;
       BaseCreator* mCreator;
       DialogSetId mId;
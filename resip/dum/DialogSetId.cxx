@@ -49,30 +49,40 @@ DialogSetId::DialogSetId(const SipMessage& msg) :
          mTag = msg.header(h_To).param(p_tag);
       }
    }
+   computeHash();
 }
 
 DialogSetId::DialogSetId(const Data& callId, const Data& tag)
    : mCallId(callId),
      mTag(tag)
 {
+   computeHash();
 }
 
 DialogSetId::DialogSetId() 
    : mCallId(),
      mTag()
 {
+   computeHash();
+}
+
+void
+DialogSetId::computeHash()
+{
+   mHash = mCallId.hash();
+   mHash ^= mTag.hash() + 0x9e3779b9 + (mHash << 6) + (mHash >> 2);
 }
 
 bool
 DialogSetId::operator==(const DialogSetId& rhs) const
 {
-   return mCallId == rhs.mCallId && mTag == rhs.mTag;
+   return mHash == rhs.mHash && mCallId == rhs.mCallId && mTag == rhs.mTag;
 }
 
 bool
 DialogSetId::operator!=(const DialogSetId& rhs) const
 {
-   return mCallId != rhs.mCallId || mTag != rhs.mTag;
+   return !(*this == rhs);
 }
 
 bool
@@ -105,7 +115,7 @@ DialogSetId::operator>(const DialogSetId& rhs) const
 
 size_t DialogSetId::hash() const
 {
-    return mCallId.hash() ^ mTag.hash();
+    return mHash;
 }
 
 
@@ -28,9 +28,13 @@ class DialogSetId
       const Data& getLocalTag() const { return mTag; }
    private:
       DialogSetId();
+      void computeHash();
       
       Data mCallId;
       Data mTag;
+      // computed once, since DialogSetIds are looked up far more often than
+      // they are created; also used to short-circuit operator==
+      size_t mHash;
 };
 
     EncodeStream& operator<<(EncodeStream&, const DialogSetId&);
@@ -4,6 +4,7 @@
 #endif
 
 #include "resip/stack/SecurityAttributes.hxx"
+#include "resip/stack/SharedContents.hxx"
 #include "resip/stack/ShutdownMessage.hxx"
 #include "resip/stack/SipFrag.hxx"
 #include "resip/stack/SipMessage.hxx"
@@ -12,6 +13,7 @@
 #include "resip/stack/TransactionUserMessage.hxx"
 #include "resip/stack/ConnectionTerminated.hxx"
 #include "resip/stack/KeepAlivePong.hxx"
+#include "resip/stack/ParseStatistics.hxx"
 #include "resip/dum/AppDialog.hxx"
 #include "resip/dum/AppDialogSet.hxx"
 #include "resip/dum/AppDialogSetFactory.hxx"
@@ -1355,6 +1357,8 @@ DialogUsageManager::internalProcess(std::auto_ptr<Message> msg)
 
    threadCheck();
 
+   ParseStatistics::Scope parseScope("DialogUsageManager");
+
    // After a Stack ShutdownMessage has been received, don't do anything else in dum
    if (mShutdownState == Shutdown)
    {
@@ -2360,7 +2364,7 @@ DialogUsageManager::removeDialogSet(const DialogSetId& dsId)
 ClientSubscriptionHandler*
 DialogUsageManager::getClientSubscriptionHandler(const Data& eventType)
 {
-   map<Data, ClientSubscriptionHandler*>::iterator res = mClientSubscriptionHandlers.find(eventType);
+   ClientSubscriptionHandlers::iterator res = mClientSubscriptionHandlers.find(eventType);
    if (res != mClientSubscriptionHandlers.end())
    {
       return res->second;
@@ -2374,7 +2378,7 @@ DialogUsageManager::getClientSubscriptionHandler(const Data& eventType)
 ServerSubscriptionHandler*
 DialogUsageManager::getServerSubscriptionHandler(const Data& eventType)
 {
-   map<Data, ServerSubscriptionHandler*>::iterator res = mServerSubscriptionHandlers.find(eventType);
+   ServerSubscriptionHandlers::iterator res = mServerSubscriptionHandlers.find(eventType);
    if (res != mServerSubscriptionHandlers.end())
    {
       return res->second;
@@ -2388,7 +2392,7 @@ DialogUsageManager::getServerSubscriptionHandler(const Data& eventType)
 ClientPublicationHandler*
 DialogUsageManager::getClientPublicationHandler(const Data& eventType)
 {
-   map<Data, ClientPublicationHandler*>::iterator res = mClientPublicationHandlers.find(eventType);
+   ClientPublicationHandlers::iterator res = mClientPublicationHandlers.find(eventType);
    if (res != mClientPublicationHandlers.end())
    {
       return res->second;
@@ -2402,7 +2406,7 @@ DialogUsageManager::getClientPublicationHandler(const Data& eventType)
 ServerPublicationHandler*
 DialogUsageManager::getServerPublicationHandler(const Data& eventType)
 {
-   map<Data, ServerPublicationHandler*>::iterator res = mServerPublicationHandlers.find(eventType);
+   ServerPublicationHandlers::iterator res = mServerPublicationHandlers.find(eventType);
    if (res != mServerPublicationHandlers.end())
    {
       return res->second;
@@ -2463,6 +2467,47 @@ DialogUsageManager::applyToAllServerSubscriptions(ServerSubscriptionFunctor* fun
    }
 }
 
+unsigned int
+DialogUsageManager::notifyServerSubscriptions(const Data& aor, 
+                                              const Data& eventType, 
+                                              const Contents& document,
+                                              ServerSubscriptionNotifyFunctor* functor)
+{
+   // Collect the handles first - sending can end a subscription, which
+   // removes it from mServerSubscriptions
+   std::vector<ServerSubscriptionHandle> subs;
+   Data key = eventType + aor;
+   std::pair<ServerSubscriptions::iterator,ServerSubscriptions::iterator> 
+      range = mServerSubscriptions.equal_range(key);
+   for (ServerSubscriptions::iterator i=range.first; i!=range.second; ++i)
+   {
+      subs.push_back(i->second->getHandle());
+   }
+   if (subs.empty())
+   {
+      return 0;
+   }
+
+   SharedContents shared(document);
+   unsigned int sent = 0;
+   for (std::vector<ServerSubscriptionHandle>::iterator it = subs.begin(); it != subs.end(); ++it)
+   {
+      if (!it->isValid())
+      {
+         continue;
+      }
+      SharedPtr<SipMessage> notify = (*it)->update(&shared);
+      if (functor)
+      {
+         functor->apply(*it, *notify);
+      }
+      (*it)->send(notify);
+      sent++;
+   }
+   DebugLog(<< "Sent " << sent << " " << eventType << " NOTIFYs for " << aor << " with a shared " << shared.getEncoded().size() << " byte body");
+   return sent;
+}
+
 void
 DialogUsageManager::applyToAllClientSubscriptions(ClientSubscriptionFunctor* functor)
 {
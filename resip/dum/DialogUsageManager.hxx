@@ -348,6 +348,17 @@ class DialogUsageManager : public HandleManager, public TransactionUser
       void applyToAllClientSubscriptions(ClientSubscriptionFunctor*);
       void applyToAllServerSubscriptions(ServerSubscriptionFunctor*);
 
+      // Sends a NOTIFY carrying document to every ServerSubscription for aor
+      // and eventType, in one pass.  document is encoded once and all of the
+      // NOTIFYs share the encoded body (see SharedContents), rather than each
+      // carrying and encoding its own copy.  If functor is supplied it is
+      // applied to each NOTIFY before it is sent.  Returns the number of
+      // NOTIFYs sent.
+      unsigned int notifyServerSubscriptions(const Data& aor, 
+                                             const Data& eventType, 
+                                             const Contents& document,
+                                             ServerSubscriptionNotifyFunctor* functor = 0);
+
       void endAllServerSubscriptions(TerminateReason reason = Deactivated);
       void endAllServerPublications();
 
@@ -496,7 +507,7 @@ class DialogUsageManager : public HandleManager, public TransactionUser
       typedef std::set<MergedRequestKey> MergedRequests;
       MergedRequests mMergedRequests;
             
-      typedef std::map<Data, DialogSet*> CancelMap;
+      typedef HashMap<Data, DialogSet*> CancelMap;
       CancelMap mCancelMap;
       
       typedef HashMap<DialogSetId, DialogSet*> DialogSetMap;
@@ -520,10 +531,15 @@ class DialogUsageManager : public HandleManager, public TransactionUser
 
       OutOfDialogHandler* getOutOfDialogHandler(const MethodTypes type);
 
-      std::map<Data, ClientSubscriptionHandler*> mClientSubscriptionHandlers;
-      std::map<Data, ServerSubscriptionHandler*> mServerSubscriptionHandlers;
-      std::map<Data, ClientPublicationHandler*> mClientPublicationHandlers;
-      std::map<Data, ServerPublicationHandler*> mServerPublicationHandlers;
+      // event type -> handler
+      typedef HashMap<Data, ClientSubscriptionHandler*> ClientSubscriptionHandlers;
+      typedef HashMap<Data, ServerSubscriptionHandler*> ServerSubscriptionHandlers;
+      typedef HashMap<Data, ClientPublicationHandler*> ClientPublicationHandlers;
+      typedef HashMap<Data, ServerPublicationHandler*> ServerPublicationHandlers;
+      ClientSubscriptionHandlers mClientSubscriptionHandlers;
+      ServerSubscriptionHandlers mServerSubscriptionHandlers;
+      ClientPublicationHandlers mClientPublicationHandlers;
+      ServerPublicationHandlers mServerPublicationHandlers;
       std::map<MethodTypes, OutOfDialogHandler*> mOutOfDialogHandlers;
       std::auto_ptr<KeepAliveManager> mKeepAliveManager;
       bool mIsDefaultServerReferHandler;
@@ -551,13 +567,13 @@ class DialogUsageManager : public HandleManager, public TransactionUser
       ShutdownState mShutdownState;
 
       // from ETag -> ServerPublication
-      typedef std::map<Data, ServerPublication*> ServerPublications;
+      typedef HashMap<Data, ServerPublication*> ServerPublications;
       ServerPublications mServerPublications;
-      typedef std::map<Data, SipMessage*> RequiresCerts;
+      typedef HashMap<Data, SipMessage*> RequiresCerts;
       RequiresCerts mRequiresCerts;      
       // from Event-Type+document-aor -> ServerSubscription
       // Managed by ServerSubscription
-      typedef std::multimap<Data, ServerSubscription*> ServerSubscriptions;
+      typedef HashMultiMap<Data, ServerSubscription*> ServerSubscriptions;
       ServerSubscriptions mServerSubscriptions;
 
       IncomingTarget* mIncomingTarget;
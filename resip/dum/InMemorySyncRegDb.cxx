@@ -54,6 +54,7 @@ contactsRemoveIfRequired(ContactList& contacts, UInt64& now,
 }
 
 InMemorySyncRegDb::InMemorySyncRegDb(unsigned int removeLingerSecs) : 
+   mEmptySnapshot(new ContactList),
    mRemoveLingerSecs(removeLingerSecs)
 {
 }
@@ -157,6 +158,7 @@ InMemorySyncRegDb::addAor(const Uri& aor,
    {
        mDatabase[aor] = new ContactList(contacts);
    }
+   updateSnapshot(aor, &contacts);
    invokeOnAorModified(true /* sync? */, aor, contacts);
 }
 
@@ -172,6 +174,7 @@ InMemorySyncRegDb::removeAor(const Uri& aor)
   {
      if (i->second)
      {
+        updateSnapshot(aor, 0);
         if(mRemoveLingerSecs > 0)
         {
            ContactList& contacts = *(i->second);
@@ -337,6 +340,10 @@ InMemorySyncRegDb::updateContact(const resip::Uri& aor,
             status = CONTACT_CREATED;
          }
          *j=rec;
+         {
+            Lock g(mDatabaseMutex);
+            updateSnapshot(aor, contactList);
+         }
          // Only pass sync as true if this update didn't just come from an inbound sync operation
          invokeOnAorModified(!rec.mSyncContact /* sync? */, aor, *contactList);
          return status;
@@ -345,6 +352,10 @@ InMemorySyncRegDb::updateContact(const resip::Uri& aor,
 
    // This is a new contact, so we add it to the list.
    contactList->push_back(rec);
+   {
+      Lock g(mDatabaseMutex);
+      updateSnapshot(aor, contactList);
+   }
    // Only pass sync as true if this update didn't just come from an inbound sync operation
    invokeOnAorModified(!rec.mSyncContact /* sync? */, aor, *contactList);
    return CONTACT_CREATED;
@@ -379,12 +390,20 @@ InMemorySyncRegDb::removeContact(const Uri& aor,
          {
             j->mRegExpires = 0;
             j->mLastUpdated = Timer::getTimeSecs();
+            {
+               Lock g(mDatabaseMutex);
+               updateSnapshot(aor, contactList);
+            }
             // Only pass sync as true if this update didn't just come from an inbound sync operation
             invokeOnAorModified(!rec.mSyncContact /* sync? */, aor, *contactList);
          }
          else
          {
             contactList->erase(j);
+            {
+               Lock g(mDatabaseMutex);
+               updateSnapshot(aor, contactList);
+            }
             if (contactList->empty())
             {
                removeAor(aor);
@@ -449,6 +468,59 @@ InMemorySyncRegDb::getContactsFull(const Uri& aor, ContactList& container)
    container = contacts;
 }
 
+RegistrationPersistenceManager::ContactListSnapshot
+InMemorySyncRegDb::getContactsSnapshot(const Uri& aor)
+{
+   Lock g(mDatabaseMutex);
+   snapshot_map_t::const_iterator i = mSnapshots.find(aor);
+   if (i == mSnapshots.end())
+   {
+      return mEmptySnapshot;
+   }
+   return i->second;
+}
+
+// mDatabaseMutex must be held. The caller must also hold the record lock
+// (or the database mutex across the change), so contacts can't be
+// modified while we copy it.
+void
+InMemorySyncRegDb::updateSnapshot(const Uri& aor, const ContactList* contacts)
+{
+   ContactList* snapshot = 0;
+   if (contacts)
+   {
+      if (mRemoveLingerSecs > 0)
+      {
+         // Same filter as getContacts(), minus the lingering removals
+         UInt64 now = Timer::getTimeSecs();
+         for(ContactList::const_iterator it = contacts->begin(); it != contacts->end(); it++)
+         {
+            if(it->mRegExpires > now)
+            {
+               if (!snapshot)
+               {
+                  snapshot = new ContactList;
+               }
+               snapshot->push_back(*it);
+            }
+         }
+      }
+      else if (!contacts->empty())
+      {
+         snapshot = new ContactList(*contacts);
+      }
+   }
+   if (snapshot)
+   {
+      // Readers holding the old snapshot keep it until they let go
+      mSnapshots[aor] = ContactListSnapshot(snapshot);
+   }
+   else
+   {
+      mSnapshots.erase(aor);
+   }
+}
+
 
 /* ====================================================================
  * The Vovida Software License, Version 1.0 
@@ -48,6 +48,10 @@ protected:
   transport registration bindings to a remote peer for replication.
   See the RegSyncClient and RegSyncServer implementations in the repro
   project.
+
+  Every update also replaces the AOR's snapshot (see getContactsSnapshot),
+  so readers such as repro's LocationServer share one immutable copy of
+  the bindings instead of copying them on each request.
 */
 class InMemorySyncRegDb : public RegistrationPersistenceManager
 {
@@ -76,6 +80,7 @@ class InMemorySyncRegDb : public RegistrationPersistenceManager
       
       virtual void getContacts(const Uri& aor, ContactList& container);
       virtual void getContactsFull(const Uri& aor, ContactList& container);
+      virtual ContactListSnapshot getContactsSnapshot(const Uri& aor);
    
       /// return all the AOR in the DB 
       virtual void getAors(UriList& container);
@@ -85,6 +90,12 @@ class InMemorySyncRegDb : public RegistrationPersistenceManager
       database_map_t mDatabase;
       Mutex mDatabaseMutex;
 
+      // Guarded by mDatabaseMutex; AORs without bindings have no entry
+      typedef std::map<Uri,ContactListSnapshot> snapshot_map_t;
+      snapshot_map_t mSnapshots;
+      const ContactListSnapshot mEmptySnapshot;
+      void updateSnapshot(const Uri& aor, const ContactList* contacts);
+
       std::set<Uri> mLockedRecords;
       Mutex mLockedRecordsMutex;
       Condition mRecordUnlocked;
@@ -5,6 +5,7 @@
 #include "resip/dum/DialogUsageManager.hxx"
 #include "resip/stack/Helper.hxx"
 #include "rutil/Logger.hxx"
+#include "rutil/Timer.hxx"
 #include "rutil/TransportType.hxx"
 #include "resip/stack/SipStack.hxx"
 
@@ -15,6 +16,15 @@ using namespace std;
 
 int KeepAliveManager::mKeepAlivePongTimeoutMs = 10000;  // Defaults to 10000ms (10s) as specified in RFC5626 section 4.4.1
 
+KeepAliveManager::KeepAliveManager() : 
+   mDum(0),
+   mCurrentId(0),
+   mBucketResolutionMs(1000),
+   mMaxKeepAlivesPerBucket(0)
+{
+   resetStats();
+}
+
 void 
 KeepAliveManager::add(const Tuple& target, int keepAliveInterval, bool targetSupportsOutbound)
 {
@@ -32,17 +42,7 @@ KeepAliveManager::add(const Tuple& target, int keepAliveInterval, bool targetSup
       info.supportsOutbound = targetSupportsOutbound;
       info.pongReceivedForLastPing = false;
       mNetworkAssociations.insert(NetworkAssociationMap::value_type(target, info));
-      KeepAliveTimeout t(target, mCurrentId);
-      SipStack &stack = mDum->getSipStack();
-      if(targetSupportsOutbound)
-      {
-         // Used randomized timeout between 80% and 100% of keepalivetime
-         stack.post(t, Helper::jitterValue(keepAliveInterval, 80, 100), mDum);
-      }
-      else
-      {
-         stack.post(t, keepAliveInterval, mDum);
-      }
+      scheduleKeepAlive(target, info, Timer::getTimeMs());
       ++mCurrentId;
    }
    else
@@ -70,6 +70,8 @@ KeepAliveManager::add(const Tuple& target, int keepAliveInterval, bool targetSup
 void 
 KeepAliveManager::remove(const Tuple& target)
 {
+   // Note:  anything already scheduled for the association is left in its 
+   // bucket and discarded when the bucket expires (the id will not match)
    NetworkAssociationMap::iterator it = mNetworkAssociations.find(target);
    if (it != mNetworkAssociations.end())
    {
@@ -89,44 +91,15 @@ void
 KeepAliveManager::process(KeepAliveTimeout& timeout)
 {
    resip_assert(mDum);
-   static KeepAliveMessage msg;
-   NetworkAssociationMap::iterator it = mNetworkAssociations.find(timeout.target());
-   if (it != mNetworkAssociations.end() && timeout.id() == it->second.id)
+   if (timeout.bucketTime() == 0)
    {
-      SipStack &stack = mDum->getSipStack();
-      DebugLog(<< "Refreshing keepalive for id=" << it->second.id << ": " << it->first
-               << ", interval=" << it->second.keepAliveInterval << "s, supportsOutbound=" 
-               << (it->second.supportsOutbound ? "true" : "false") 
-               << ", refCount=" << it->second.refCount);
-
-      if(InteropHelper::getOutboundVersion()>=8 && it->second.supportsOutbound && mKeepAlivePongTimeoutMs > 0)
-      {
-         // Assert if keep alive interval is too short in order to properly detect
-         // missing pong responses - ie. interval must be greater than 10s
-         resip_assert((it->second.keepAliveInterval*1000) > mKeepAlivePongTimeoutMs);
-
-         // Start pong timeout if transport is TCP based (note: pong processing of Stun messaging is currently not implemented)
-         if(isReliable(it->first.getType()))
-         {
-            DebugLog( << "Starting pong timeout for keepalive id " << it->second.id);
-            KeepAlivePongTimeout t(it->first, it->second.id);
-            stack.postMS(t, mKeepAlivePongTimeoutMs, mDum);
-         }
-      }
-      it->second.pongReceivedForLastPing = false;  // reset flag
-
-      stack.sendTo(msg, timeout.target(), mDum);
-      KeepAliveTimeout t(it->first, it->second.id);
-      if(it->second.supportsOutbound)
-      {
-         // Used randomized timeout between 80% and 100% of keepalivetime
-         stack.post(t, Helper::jitterValue(it->second.keepAliveInterval, 80, 100), mDum);
-      }
-      else
-      {
-         stack.post(t, it->second.keepAliveInterval, mDum);
-      }
+      // Per association timers are no longer used
+      return;
    }
+   UInt64 now = Timer::getTimeMs();
+   // Make sure the bucket this timer was for is run, even if the timer fired 
+   // a little early
+   processBuckets(resipMax(now, timeout.bucketTime()), now);
 }
 
 void 
@@ -140,6 +113,7 @@ KeepAliveManager::process(KeepAlivePongTimeout& timeout)
       {
          // Timeout expecting pong response
          InfoLog(<< "Timed out expecting pong response for keep alive id=" << it->second.id << ": " << it->first);
+         ++mPongTimeouts;
          mDum->getSipStack().terminateFlow(it->first);
       }
    }
@@ -153,6 +127,153 @@ KeepAliveManager::receivedPong(const Tuple& flow)
    {
       DebugLog(<< "Received pong response for keep alive id=" << it->second.id << ": " << it->first);
       it->second.pongReceivedForLastPing = true;
+      ++mPongsReceived;
+   }
+}
+
+void
+KeepAliveManager::encodeStats(EncodeStream& strm) const
+{
+   UInt64 elapsedMs = Timer::getTimeMs() - mStatsStartMs;
+   strm << "Network associations: " << mNetworkAssociations.size() << std::endl;
+   strm << "Pending buckets: " << mBuckets.size() << std::endl;
+   strm << "Bucket timers posted: " << mBucketTimersPosted << std::endl;
+   strm << "Keepalives sent: " << mKeepAlivesSent << std::endl;
+   strm << "Keepalives deferred: " << mKeepAlivesDeferred << std::endl;
+   strm << "Pongs received: " << mPongsReceived << std::endl;
+   strm << "Pong timeouts: " << mPongTimeouts << std::endl;
+   strm << "Keepalives sent per second: " << (elapsedMs ? (double)mKeepAlivesSent * 1000 / elapsedMs : 0) << std::endl;
+   strm << "Pong timeouts per second: " << (elapsedMs ? (double)mPongTimeouts * 1000 / elapsedMs : 0) << std::endl;
+}
+
+void
+KeepAliveManager::resetStats()
+{
+   mStatsStartMs = Timer::getTimeMs();
+   mKeepAlivesSent = 0;
+   mKeepAlivesDeferred = 0;
+   mPongsReceived = 0;
+   mPongTimeouts = 0;
+   mBucketTimersPosted = 0;
+}
+
+void
+KeepAliveManager::scheduleKeepAlive(const Tuple& target, const NetworkAssociationInfo& info, UInt64 now)
+{
+   UInt64 intervalMs = (UInt64)info.keepAliveInterval * 1000;
+   if(info.supportsOutbound)
+   {
+      // Used randomized timeout between 80% and 100% of keepalivetime
+      intervalMs = Helper::jitterValue((int)intervalMs, 80, 100);
+   }
+   schedule(target, info.id, false /* pongCheck */, now + intervalMs, now);
+}
+
+void
+KeepAliveManager::schedule(const Tuple& target, int id, bool pongCheck, UInt64 due, UInt64 now)
+{
+   ScheduledCheck check;
+   check.target = target;
+   check.id = id;
+   check.pongCheck = pongCheck;
+   bucketFor(due, now).push_back(check);
+}
+
+KeepAliveManager::Bucket&
+KeepAliveManager::bucketFor(UInt64 due, UInt64 now)
+{
+   // Round up, so nothing is run before it is due
+   UInt64 bucketTime = ((due + mBucketResolutionMs - 1) / mBucketResolutionMs) * mBucketResolutionMs;
+   BucketMap::iterator it = mBuckets.find(bucketTime);
+   if (it == mBuckets.end())
+   {
+      // First entry in this bucket - start its timer
+      it = mBuckets.insert(BucketMap::value_type(bucketTime, Bucket())).first;
+      KeepAliveTimeout t(bucketTime);
+      mDum->getSipStack().postMS(t, (unsigned int)(bucketTime > now ? bucketTime - now : 0), mDum);
+      ++mBucketTimersPosted;
+   }
+   return it->second;
+}
+
+void
+KeepAliveManager::processBuckets(UInt64 upTo, UInt64 now)
+{
+   static KeepAliveMessage msg;
+   SipStack &stack = mDum->getSipStack();
+   std::vector<Tuple> targets;
+   Bucket deferred;
+
+   // Anything scheduled from here on is due after now, so it can not land in 
+   // a bucket that is being run
+   while (!mBuckets.empty() && mBuckets.begin()->first <= upTo)
+   {
+      Bucket due;
+      due.swap(mBuckets.begin()->second);
+      mBuckets.erase(mBuckets.begin());
+
+      for (Bucket::iterator check = due.begin(); check != due.end(); ++check)
+      {
+         NetworkAssociationMap::iterator it = mNetworkAssociations.find(check->target);
+         if (it == mNetworkAssociations.end() || check->id != it->second.id)
+         {
+            continue;  // association was removed
+         }
+
+         if (check->pongCheck)
+         {
+            if(!it->second.pongReceivedForLastPing)
+            {
+               // Timeout expecting pong response
+               InfoLog(<< "Timed out expecting pong response for keep alive id=" << it->second.id << ": " << it->first);
+               ++mPongTimeouts;
+               stack.terminateFlow(it->first);
+            }
+            continue;
+         }
+
+         if (mMaxKeepAlivesPerBucket && targets.size() >= mMaxKeepAlivesPerBucket)
+         {
+            deferred.push_back(*check);
+            continue;
+         }
+
+         DebugLog(<< "Refreshing keepalive for id=" << it->second.id << ": " << it->first
+                  << ", interval=" << it->second.keepAliveInterval << "s, supportsOutbound=" 
+                  << (it->second.supportsOutbound ? "true" : "false") 
+                  << ", refCount=" << it->second.refCount);
+
+         if(InteropHelper::getOutboundVersion()>=8 && it->second.supportsOutbound && mKeepAlivePongTimeoutMs > 0)
+         {
+            // Assert if keep alive interval is too short in order to properly detect
+            // missing pong responses - ie. interval must be greater than 10s
+            resip_assert((it->second.keepAliveInterval*1000) > mKeepAlivePongTimeoutMs);
+
+            // Start pong timeout if transport is TCP based (note: pong processing of Stun messaging is currently not implemented)
+            if(isReliable(it->first.getType()))
+            {
+               DebugLog( << "Starting pong timeout for keepalive id " << it->second.id);
+               schedule(it->first, it->second.id, true /* pongCheck */, now + mKeepAlivePongTimeoutMs, now);
+            }
+         }
+         it->second.pongReceivedForLastPing = false;  // reset flag
+
+         targets.push_back(it->first);
+         scheduleKeepAlive(it->first, it->second, now);
+      }
+   }
+
+   if (!targets.empty())
+   {
+      stack.sendTo(msg, targets, mDum);
+      mKeepAlivesSent += targets.size();
+   }
+   if (!deferred.empty())
+   {
+      DebugLog(<< "Deferring " << deferred.size() << " keepalives to the next bucket");
+      mKeepAlivesDeferred += deferred.size();
+      Bucket& next = bucketFor(now + mBucketResolutionMs, now);
+      next.insert(next.end(), deferred.begin(), deferred.end());
    }
 }
 
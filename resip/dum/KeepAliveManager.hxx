@@ -2,7 +2,9 @@
 #define RESIP_KEEPALIVE_MANAGER_HXX
 
 #include <map>
+#include <vector>
 #include "resip/stack/Tuple.hxx"
+#include "rutil/HashMap.hxx"
 
 namespace resip 
 {
@@ -11,6 +13,16 @@ class KeepAliveTimeout;
 class KeepAlivePongTimeout;
 class DialogUsageManager;
 
+/**
+   Sends keepalives (CRLFCRLF or STUN) on every network association (flow) 
+   that has usages requiring them, and detects missing pongs for RFC5626 
+   outbound flows.
+
+   Rather than running a DUM timer per association, associations due within
+   the same time bucket (see setBucketResolutionMs) share one timer, and the 
+   keepalives for a bucket are handed to the stack in a single batch.  This
+   keeps the DUM timer queue small when there are tens of thousands of flows.
+*/
 class KeepAliveManager
 {
    public:
@@ -33,9 +45,29 @@ class KeepAliveManager
       //        For UDP, this is not currently the case, when the transport is bound to any interface
       //        (ie. 0.0.0.0), as the flow key will be same regardless of the source interface used to
       //        send the UDP message - fixing this for UDP remains an outstanding item.
+      class FlowKeyHasher
+      {
+         public:
+            size_t operator()(const Tuple& flow) const
+            {
+               return flow.hash() + 31*flow.getFlowKey();
+            }
+      };
+      class FlowKeyEqual
+      {
+         public:
+            bool operator()(const Tuple& lhs, const Tuple& rhs) const
+            {
+               return lhs == rhs && lhs.getFlowKey() == rhs.getFlowKey();
+            }
+      };
+#if defined(HASH_MAP_NAMESPACE)
+      typedef HashMap<Tuple, NetworkAssociationInfo, FlowKeyHasher, FlowKeyEqual> NetworkAssociationMap;
+#else
       typedef std::map<Tuple, NetworkAssociationInfo, Tuple::FlowKeyCompare> NetworkAssociationMap;
+#endif
 
-      KeepAliveManager() : mCurrentId(0) {}
+      KeepAliveManager();
       virtual ~KeepAliveManager() {}
       void setDialogUsageManager(DialogUsageManager* dum) { mDum = dum; }
       virtual void add(const Tuple& target, int keepAliveInterval, bool targetSupportsOutbound);
@@ -44,10 +76,54 @@ class KeepAliveManager
       virtual void process(KeepAlivePongTimeout& timeout);
       virtual void receivedPong(const Tuple& flow);
 
+      // Keepalives and pong checks are run in buckets of this many ms, so a 
+      // keepalive may go out up to this much later than its interval 
+      // (default 1000ms).  Takes effect for keepalives scheduled afterwards.
+      void setBucketResolutionMs(unsigned int ms) { mBucketResolutionMs = ms ? ms : 1; }
+      // Caps the number of keepalives sent when a bucket expires - any more 
+      // are carried over to the next bucket.  0 (the default) means no cap.
+      void setMaxKeepAlivesPerBucket(unsigned int max) { mMaxKeepAlivesPerBucket = max; }
+
+      size_t getNumNetworkAssociations() const { return mNetworkAssociations.size(); }
+      size_t getNumBuckets() const { return mBuckets.size(); }
+      UInt64 getKeepAlivesSent() const { return mKeepAlivesSent; }
+      UInt64 getKeepAlivesDeferred() const { return mKeepAlivesDeferred; }
+      UInt64 getPongsReceived() const { return mPongsReceived; }
+      UInt64 getPongTimeouts() const { return mPongTimeouts; }
+      UInt64 getBucketTimersPosted() const { return mBucketTimersPosted; }
+      // Counters, and keepalive send / pong timeout rates since the last reset
+      void encodeStats(EncodeStream& strm) const;
+      void resetStats();
+
    protected:
+      struct ScheduledCheck
+      {
+            Tuple target;
+            int id;
+            bool pongCheck;  // else send a keepalive
+      };
+      typedef std::vector<ScheduledCheck> Bucket;
+      typedef std::map<UInt64, Bucket> BucketMap;  // keyed by bucket expiry time (ms)
+
+      void scheduleKeepAlive(const Tuple& target, const NetworkAssociationInfo& info, UInt64 now);
+      void schedule(const Tuple& target, int id, bool pongCheck, UInt64 due, UInt64 now);
+      Bucket& bucketFor(UInt64 due, UInt64 now);
+      void processBuckets(UInt64 upTo, UInt64 now);
+
       DialogUsageManager* mDum;
       NetworkAssociationMap mNetworkAssociations;
       unsigned int mCurrentId;
+
+      BucketMap mBuckets;
+      unsigned int mBucketResolutionMs;
+      unsigned int mMaxKeepAlivesPerBucket;
+
+      UInt64 mStatsStartMs;
+      UInt64 mKeepAlivesSent;
+      UInt64 mKeepAlivesDeferred;
+      UInt64 mPongsReceived;
+      UInt64 mPongTimeouts;
+      UInt64 mBucketTimersPosted;
 };
 
 }
@@ -9,12 +9,19 @@ using namespace resip;
 
 KeepAliveTimeout::KeepAliveTimeout(const Tuple& target,int id)
    : mTarget(target),
-     mId(id)
+     mId(id),
+     mBucketTime(0)
+{}
+
+KeepAliveTimeout::KeepAliveTimeout(UInt64 bucketTime)
+   : mId(-1),
+     mBucketTime(bucketTime)
 {}
 
 KeepAliveTimeout::KeepAliveTimeout(const KeepAliveTimeout& timeout)
    : mTarget(timeout.mTarget),
-     mId(timeout.mId)
+     mId(timeout.mId),
+     mBucketTime(timeout.mBucketTime)
 {
 }
 
@@ -36,6 +43,10 @@ KeepAliveTimeout::encodeBrief(EncodeStream& strm) const
 EncodeStream& 
 KeepAliveTimeout::encode(EncodeStream& strm) const
 {
+   if (mBucketTime)
+   {
+      return strm << "KeepAliveTimeout bucket=" << mBucketTime;
+   }
    return strm << "KeepAliveTimeout" << mTarget << "(" << mId << ")";
 }
 
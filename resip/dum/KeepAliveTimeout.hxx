@@ -13,11 +13,15 @@ class KeepAliveTimeout : public ApplicationMessage
 {
    public:      
       KeepAliveTimeout(const Tuple& target, int id);
+      // Timer for a KeepAliveManager time bucket - covers every network 
+      // association due at bucketTime (ms), rather than a single target
+      explicit KeepAliveTimeout(UInt64 bucketTime);
       KeepAliveTimeout(const KeepAliveTimeout&);      
       virtual ~KeepAliveTimeout();
       
       const Tuple& target() const { return mTarget; }
       int id() const { return mId; }
+      UInt64 bucketTime() const { return mBucketTime; }
       virtual Message* clone() const;
       virtual EncodeStream& encode(EncodeStream& strm) const;
       virtual EncodeStream& encodeBrief(EncodeStream& strm) const;
@@ -25,6 +29,7 @@ class KeepAliveTimeout : public ApplicationMessage
    private:
       Tuple mTarget;
       int mId;
+      UInt64 mBucketTime;
 };
 
 class KeepAlivePongTimeout : public ApplicationMessage
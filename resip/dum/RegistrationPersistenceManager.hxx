@@ -4,6 +4,7 @@
 #include <list>
 #include "resip/stack/Uri.hxx"
 #include "resip/dum/ContactInstanceRecord.hxx"
+#include "rutil/SharedPtr.hxx"
 
 namespace resip
 {
@@ -15,6 +16,8 @@ class RegistrationPersistenceManager
 {
   public:
     typedef std::list<Uri> UriList;
+    /// Immutable bindings of one AOR, shared by all readers
+    typedef SharedPtr<const ContactList> ContactListSnapshot;
 
     typedef enum
     {
@@ -42,6 +45,21 @@ class RegistrationPersistenceManager
 
     virtual void getContacts(const Uri& aor, ContactList& container) = 0;  
 
+    /** Returns the same bindings as getContacts(), as a snapshot that never
+        changes; updates replace the AOR's snapshot rather than modify it.
+        Never returns a null pointer. Bindings may expire while the snapshot
+        is held, so callers must still check mRegExpires.
+        The default implementation makes a copy on every call; implementations
+        that keep snapshots (InMemorySyncRegDb) avoid the copy and the need to
+        lock the record just to read it.
+    */
+    virtual ContactListSnapshot getContactsSnapshot(const Uri& aor)
+    {
+       ContactList* contacts = new ContactList;
+       getContacts(aor, *contacts);
+       return ContactListSnapshot(contacts);
+    }
+
 };
 }
 
@@ -6,6 +6,7 @@
 
 namespace resip 
 {
+class SipMessage;
 
 class ServerSubscriptionFunctor
 {
@@ -17,6 +18,18 @@ class ServerSubscriptionFunctor
       virtual void apply(ServerSubscriptionHandle) = 0;
 };
 
+// Used with DialogUsageManager::notifyServerSubscriptions to adjust each
+// NOTIFY (eg. its Subscription-State) before it is sent
+class ServerSubscriptionNotifyFunctor
+{
+   public:
+      virtual ~ServerSubscriptionNotifyFunctor()
+      {
+      }
+      
+      virtual void apply(ServerSubscriptionHandle, SipMessage& notify) = 0;
+};
+
 }
 
 #endif
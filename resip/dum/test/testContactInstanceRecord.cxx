@@ -2,6 +2,7 @@
 #include <sstream>
 
 #include "resip/dum/ContactInstanceRecord.hxx"
+#include "resip/dum/InMemorySyncRegDb.hxx"
 #include "resip/stack/NameAddr.hxx"
 #include "rutil/Timer.hxx"
 #include "rutil/XMLCursor.hxx"
@@ -95,6 +96,46 @@ int main(int argc, const char* argv[])
 
     ASSERT_CIR_VALUES(rec3, now);
 
+    // Test contact snapshots, with and without lingering removals
+    for (unsigned int linger = 0; linger <= 60; linger += 60)
+    {
+       InMemorySyncRegDb db(linger);
+       Uri aor("sip:foo@example.com");
+       RegistrationPersistenceManager::ContactListSnapshot empty = db.getContactsSnapshot(aor);
+       assert(empty.get() && empty->empty());
+
+       db.lockRecord(aor);
+       assert(db.updateContact(aor, rec) == RegistrationPersistenceManager::CONTACT_CREATED);
+       db.unlockRecord(aor);
+       RegistrationPersistenceManager::ContactListSnapshot snap1 = db.getContactsSnapshot(aor);
+       assert(snap1->size() == 1);
+       ASSERT_CIR_VALUES(snap1->front(), now);
+       // Readers share the snapshot until the next update
+       assert(db.getContactsSnapshot(aor).get() == snap1.get());
+
+       ContactInstanceRecord other(rec);
+       other.mContact = NameAddr("sip:bar@example.com:1234");
+       other.mRegId = 6666;  // a different outbound flow
+       db.lockRecord(aor);
+       db.updateContact(aor, other);
+       db.unlockRecord(aor);
+       RegistrationPersistenceManager::ContactListSnapshot snap2 = db.getContactsSnapshot(aor);
+       assert(snap2->size() == 2);
+       assert(snap1->size() == 1);  // old snapshot is never modified
+
+       db.lockRecord(aor);
+       db.removeContact(aor, rec);
+       db.unlockRecord(aor);
+       assert(db.getContactsSnapshot(aor)->size() == 1);
+       assert(db.getContactsSnapshot(aor)->front().mContact == other.mContact);
+       assert(snap2->size() == 2);
+
+       db.lockRecord(aor);
+       db.removeAor(aor);
+       db.unlockRecord(aor);
+       assert(db.getContactsSnapshot(aor)->empty());
+    }
+
     cout << "testContactInstanceRecord succeeded" << endl;
     return(0);
 }
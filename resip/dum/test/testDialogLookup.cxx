@@ -0,0 +1,301 @@
+// Micro-benchmark for in-dialog request dispatch in DUM.  A configurable
+// number of INVITE dialogs (default 50000) are established by feeding
+// synthetic INVITE/ACK pairs straight into DialogUsageManager::internalProcess,
+// then a mix of in-dialog INFO and MESSAGE requests, plus a share of requests
+// for unknown dialogs, is pushed through the same path and timed.  Nothing
+// ever reaches the wire - an outgoing DumFeature swallows every message DUM
+// sends.  Responses DUM hands straight to the stack (eg. 481s) and DUM timers
+// are drained between batches, outside of the timed section.
+//
+// usage: testDialogLookup [numDialogs] [numRequests]
+
+#include "resip/stack/SdpContents.hxx"
+#include "resip/stack/SipMessage.hxx"
+#include "resip/stack/SipStack.hxx"
+#include "resip/dum/DialogUsageManager.hxx"
+#include "resip/dum/DumFeature.hxx"
+#include "resip/dum/InviteSessionHandler.hxx"
+#include "resip/dum/MasterProfile.hxx"
+#include "resip/dum/ServerInviteSession.hxx"
+#include "rutil/Log.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Timer.hxx"
+
+#include "TestDumHandlers.hxx"
+
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+using namespace resip;
+using namespace std;
+
+#define BATCH_SIZE 10000
+#define UNKNOWN_DIALOG_PERCENT 10
+
+// Discards everything DUM sends
+class DiscardFeature : public DumFeature
+{
+   public:
+      DiscardFeature(DialogUsageManager& dum) : DumFeature(dum, dum.dumOutgoingTarget()) {}
+      virtual ProcessingResult process(Message* msg)
+      {
+         return DumFeature::ChainDoneAndEventDone;
+      }
+};
+
+class BenchInviteSessionHandler : public TestInviteSessionHandler
+{
+   public:
+      BenchInviteSessionHandler() : 
+         mConnected(0),
+         mTerminated(0),
+         mNitAccepted(0)
+      {
+         Data txt("v=0\r\n"
+                  "o=- 1 1 IN IP4 127.0.0.1\r\n"
+                  "s=-\r\n"
+                  "c=IN IP4 127.0.0.1\r\n"
+                  "t=0 0\r\n"
+                  "m=audio 9000 RTP/AVP 0\r\n"
+                  "a=rtpmap:0 PCMU/8000\r\n");
+         HeaderFieldValue hfv(txt.data(), txt.size());
+         Mime type("application", "sdp");
+         mAnswer = SdpContents(hfv, type);
+         mAnswer.checkParsed();
+      }
+
+      virtual void onNewSession(ServerInviteSessionHandle is, InviteSession::OfferAnswerType oat, const SipMessage& msg)
+      {
+         mLocalTag = is->getDialogId().getLocalTag();
+      }
+
+      virtual void onOffer(InviteSessionHandle is, const SipMessage& msg, const SdpContents& sdp)
+      {
+         is->provideAnswer(mAnswer);
+         ServerInviteSession* sis = dynamic_cast<ServerInviteSession*>(is.get());
+         if (sis)
+         {
+            sis->accept();
+         }
+      }
+
+      virtual void onConnected(InviteSessionHandle, const SipMessage& msg)
+      {
+         mConnected++;
+      }
+
+      virtual void onTerminated(InviteSessionHandle, InviteSessionHandler::TerminatedReason reason, const SipMessage* msg)
+      {
+         mTerminated++;
+      }
+
+      virtual void onInfo(InviteSessionHandle is, const SipMessage& msg)
+      {
+         is->acceptNIT();
+         mNitAccepted++;
+      }
+
+      virtual void onMessage(InviteSessionHandle is, const SipMessage& msg)
+      {
+         is->acceptNIT();
+         mNitAccepted++;
+      }
+
+      virtual void onReferNoSub(InviteSessionHandle, const SipMessage& msg)
+      {
+      }
+
+      SdpContents mAnswer;
+      Data mLocalTag;
+      unsigned int mConnected;
+      unsigned int mTerminated;
+      unsigned int mNitAccepted;
+};
+
+static unsigned long branch = 0;
+
+static SipMessage*
+makeRequest(const char* method, unsigned int dialog, const Data& toTag, unsigned int cseq, const Data& body = Data::Empty)
+{
+   Data raw;
+   {
+      DataStream ds(raw);
+      ds << method << " sip:bench@127.0.0.1:5060 SIP/2.0\r\n"
+         << "Via: SIP/2.0/UDP 127.0.0.1:5070;branch=z9hG4bK-bench-" << ++branch << ";rport\r\n"
+         << "Max-Forwards: 70\r\n"
+         << "From: <sip:caller" << dialog << "@127.0.0.1>;tag=from-" << dialog << "\r\n"
+         << "To: <sip:bench@127.0.0.1>";
+      if (!toTag.empty())
+      {
+         ds << ";tag=" << toTag;
+      }
+      ds << "\r\n"
+         << "Call-ID: call-" << dialog << "@bench.invalid\r\n"
+         << "CSeq: " << cseq << " " << method << "\r\n"
+         << "Contact: <sip:caller" << dialog << "@127.0.0.1:5070>\r\n";
+      if (!body.empty())
+      {
+         ds << "Content-Type: application/sdp\r\n";
+      }
+      ds << "Content-Length: " << body.size() << "\r\n\r\n" << body;
+   }
+   SipMessage* msg = SipMessage::make(raw, true /* isExternal */);
+   resip_assert(msg);
+   Tuple source("127.0.0.1", 5070, V4, UDP);
+   msg->setSource(source);
+   return msg;
+}
+
+int
+main(int argc, char* argv[])
+{
+   unsigned int numDialogs = argc > 1 ? atoi(argv[1]) : 50000;
+   unsigned int numRequests = argc > 2 ? atoi(argv[2]) : 500000;
+
+   Log::initialize(Log::Cout, Log::Warning, argv[0]);
+
+   SipStack stack;
+   DialogUsageManager dum(stack);
+   SharedPtr<MasterProfile> profile(new MasterProfile);
+   profile->addSupportedMethod(INFO);
+   profile->addSupportedMethod(MESSAGE);
+   dum.setMasterProfile(profile);
+   BenchInviteSessionHandler handler;
+   dum.setInviteSessionHandler(&handler);
+   dum.addOutgoingFeature(SharedPtr<DumFeature>(new DiscardFeature(dum)));
+
+   Data offer("v=0\r\n"
+              "o=- 1 1 IN IP4 127.0.0.1\r\n"
+              "s=-\r\n"
+              "c=IN IP4 127.0.0.1\r\n"
+              "t=0 0\r\n"
+              "m=audio 8000 RTP/AVP 0\r\n"
+              "a=rtpmap:0 PCMU/8000\r\n");
+
+   vector<Data> toTags(numDialogs);
+   vector<unsigned int> cseqs(numDialogs, 1);
+
+   UInt64 start = Timer::getTimeMs();
+   for (unsigned int i = 0; i < numDialogs; i++)
+   {
+      dum.internalProcess(std::auto_ptr<Message>(makeRequest("INVITE", i, Data::Empty, 1, offer)));
+      toTags[i] = handler.mLocalTag;
+      dum.internalProcess(std::auto_ptr<Message>(makeRequest("ACK", i, toTags[i], 1)));
+   }
+   UInt64 elapsed = Timer::getTimeMs() - start;
+   cerr << "Established " << handler.mConnected << " dialogs in " << elapsed << "ms" << endl;
+   if (handler.mConnected != numDialogs)
+   {
+      cerr << "FAILED: expected " << numDialogs << " connected dialogs" << endl;
+      return -1;
+   }
+
+   // Walk the dialogs in a scattered order, so lookups don't benefit from 
+   // recently touched tree nodes or buckets
+   UInt64 processTime = 0;
+   unsigned int processed = 0;
+   unsigned int unknown = 0;
+   UInt32 rnd = 12345;
+   vector<SipMessage*> batch;
+   batch.reserve(BATCH_SIZE);
+   while (processed < numRequests)
+   {
+      for (unsigned int j = 0; j < BATCH_SIZE && processed + batch.size() < numRequests; j++)
+      {
+         rnd = rnd * 1103515245 + 12345;
+         unsigned int dialog = (rnd >> 8) % numDialogs;
+         const char* method = (rnd & 1) ? "INFO" : "MESSAGE";
+         if ((rnd >> 1) % 100 < UNKNOWN_DIALOG_PERCENT)
+         {
+            // in-dialog request for a dialog DUM doesn't know about (481)
+            batch.push_back(makeRequest(method, dialog, "unknown-tag", 2));
+            unknown++;
+         }
+         else
+         {
+            batch.push_back(makeRequest(method, dialog, toTags[dialog], ++cseqs[dialog]));
+         }
+      }
+
+      start = Timer::getTimeMicroSec();
+      for (vector<SipMessage*>::iterator it = batch.begin(); it != batch.end(); ++it)
+      {
+         dum.internalProcess(std::auto_ptr<Message>(*it));
+      }
+      processTime += Timer::getTimeMicroSec() - start;
+      processed += batch.size();
+      batch.clear();
+
+      // there are no transports, so this just discards what DUM sent
+      do
+      {
+         stack.process(0);
+      }
+      while (stack.getTimeTillNextProcessMS() == 0);
+      while (dum.process());
+   }
+
+   cerr << "Processed " << processed << " in-dialog requests (" << unknown << " for unknown dialogs) across " 
+        << numDialogs << " dialogs in " << processTime / 1000 << "ms = "
+        << (UInt64)processed * 1000000 / (processTime ? processTime : 1) << " requests/s" << endl;
+
+   if (handler.mNitAccepted != processed - unknown || handler.mTerminated != 0)
+   {
+      cerr << "FAILED: " << handler.mNitAccepted << " requests accepted, " << handler.mTerminated << " sessions terminated" << endl;
+      return -1;
+   }
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,368 @@
+#include <cassert>
+#include <iostream>
+#include <map>
+
+#include "resip/stack/EventStackThread.hxx"
+#include "resip/stack/SipStack.hxx"
+#include "resip/dum/DialogUsageManager.hxx"
+#include "resip/dum/KeepAliveManager.hxx"
+#include "resip/dum/KeepAliveTimeout.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/DataStream.hxx"
+#include "rutil/Log.hxx"
+#include "rutil/ParseBuffer.hxx"
+#include "rutil/Socket.hxx"
+#include "rutil/Timer.hxx"
+
+#ifndef WIN32
+#include <poll.h>
+#endif
+
+using namespace resip;
+using namespace std;
+
+static const int Interval = 30;  // s
+static const unsigned int Resolution = 1000;  // ms
+
+// Exposes the time buckets, so that the test can run them at chosen times
+// instead of waiting for the bucket timers
+class TestKeepAliveManager : public KeepAliveManager
+{
+public:
+   void runBuckets(UInt64 now) { processBuckets(now, now); }
+
+   // Number of keepalives (or pong checks) scheduled for target
+   unsigned int scheduled(const Tuple& target, bool pongCheck) const
+   {
+      unsigned int count = 0;
+      for(BucketMap::const_iterator b = mBuckets.begin(); b != mBuckets.end(); ++b)
+      {
+         for(Bucket::const_iterator c = b->second.begin(); c != b->second.end(); ++c)
+         {
+            if(c->target == target && c->pongCheck == pongCheck)
+            {
+               count++;
+            }
+         }
+      }
+      return count;
+   }
+
+   int id(const Tuple& target) const
+   {
+      NetworkAssociationMap::const_iterator it = mNetworkAssociations.find(target);
+      assert(it != mNetworkAssociations.end());
+      return it->second.id;
+   }
+};
+
+// A UDP socket standing in for a keepalive target
+class Peer
+{
+public:
+   Peer()
+   {
+      mFd = ::socket(AF_INET, SOCK_DGRAM, 0);
+      assert(mFd != INVALID_SOCKET);
+      sockaddr_in addr;
+      memset(&addr, 0, sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      assert(::bind(mFd, (sockaddr*)&addr, sizeof(addr)) == 0);
+      socklen_t len = sizeof(addr);
+      assert(::getsockname(mFd, (sockaddr*)&addr, &len) == 0);
+      mTarget = Tuple("127.0.0.1", ntohs(addr.sin_port), V4, UDP);
+   }
+   ~Peer() { closeSocket(mFd); }
+
+   // Number of keepalives that arrive within waitMs
+   unsigned int received(int waitMs)
+   {
+      unsigned int count = 0;
+      pollfd pfd;
+      pfd.fd = mFd;
+      pfd.events = POLLIN;
+      while(::poll(&pfd, 1, waitMs) == 1)
+      {
+         char buf[64];
+         int len = ::recv(mFd, buf, sizeof(buf), 0);
+         assert(len == 4 && memcmp(buf, "\r\n\r\n", 4) == 0);
+         count++;
+         waitMs = 100;
+      }
+      return count;
+   }
+
+   Tuple mTarget;
+
+private:
+   Socket mFd;
+};
+
+static UInt64
+statsValue(const KeepAliveManager& manager, const char* name)
+{
+   Data stats;
+   {
+      DataStream ds(stats);
+      manager.encodeStats(ds);
+   }
+   Data prefix(Data(name) + ": ");
+   Data::size_type pos = stats.find(prefix);
+   assert(pos != Data::npos);
+   Data value(stats.substr(pos + prefix.size()));
+   ParseBuffer pb(value);
+   return pb.uInt64();
+}
+
+static void
+testKeepAlives(DialogUsageManager& dum)
+{
+   TestKeepAliveManager manager;
+   manager.setDialogUsageManager(&dum);
+   manager.setBucketResolutionMs(Resolution);
+   Peer a;
+   Peer b;
+   Peer c;
+
+   UInt64 start = Timer::getTimeMs();
+   manager.add(a.mTarget, Interval, false);
+   manager.add(b.mTarget, Interval, false);
+   manager.add(c.mTarget, Interval, false);
+   // A second usage of a flow shares its keepalives
+   manager.add(a.mTarget, Interval, false);
+   assert(manager.getNumNetworkAssociations() == 3);
+   assert(manager.scheduled(a.mTarget, false) == 1);
+   assert(manager.scheduled(b.mTarget, false) == 1);
+   // Flows added together share one bucket and one timer
+   assert(manager.getNumBuckets() <= 2);
+   assert(manager.getBucketTimersPosted() == manager.getNumBuckets());
+
+   // Nothing before the interval is up
+   manager.runBuckets(start + Interval * 1000 - Resolution);
+   assert(manager.getKeepAlivesSent() == 0);
+   assert(a.received(200) == 0);
+
+   // One keepalive per flow once it is, and each flow is due again an
+   // interval later
+   UInt64 now = start + Interval * 1000 + Resolution;
+   manager.runBuckets(now);
+   assert(manager.getKeepAlivesSent() == 3);
+   assert(a.received(2000) == 1);
+   assert(b.received(2000) == 1);
+   assert(c.received(2000) == 1);
+   assert(manager.scheduled(a.mTarget, false) == 1);
+   assert(manager.scheduled(b.mTarget, false) == 1);
+   assert(manager.scheduled(c.mTarget, false) == 1);
+   manager.runBuckets(now + Interval * 1000 - Resolution);
+   assert(manager.getKeepAlivesSent() == 3);
+
+   // A removed flow gets nothing more; a flow that still has a usage does
+   manager.remove(b.mTarget);
+   manager.remove(a.mTarget);
+   assert(manager.getNumNetworkAssociations() == 2);
+   now += Interval * 1000 + Resolution;
+   manager.runBuckets(now);
+   assert(manager.getKeepAlivesSent() == 5);
+   assert(a.received(2000) == 1);
+   assert(c.received(2000) == 1);
+   assert(b.received(200) == 0);
+   assert(manager.scheduled(b.mTarget, false) == 0);
+
+   // Once all of its usages are gone, nothing is sent to it either
+   manager.remove(a.mTarget);
+   manager.remove(c.mTarget);
+   now += Interval * 1000 + Resolution;
+   manager.runBuckets(now);
+   assert(manager.getKeepAlivesSent() == 5);
+   assert(a.received(200) == 0);
+   assert(c.received(0) == 0);
+   assert(manager.getNumBuckets() == 0);
+
+   assert(statsValue(manager, "Keepalives sent") == 5);
+   assert(statsValue(manager, "Pong timeouts") == 0);
+   assert(statsValue(manager, "Network associations") == 0);
+}
+
+static void
+testCappedBuckets(DialogUsageManager& dum)
+{
+   TestKeepAliveManager manager;
+   manager.setDialogUsageManager(&dum);
+   manager.setBucketResolutionMs(Resolution);
+   manager.setMaxKeepAlivesPerBucket(2);
+   Peer peers[3];
+
+   UInt64 start = Timer::getTimeMs();
+   for(int i = 0; i < 3; i++)
+   {
+      manager.add(peers[i].mTarget, Interval, false);
+   }
+
+   // Over the cap, the rest wait for the next bucket
+   UInt64 now = start + Interval * 1000 + Resolution;
+   manager.runBuckets(now);
+   assert(manager.getKeepAlivesSent() == 2);
+   assert(manager.getKeepAlivesDeferred() == 1);
+   manager.runBuckets(now + 2 * Resolution);
+   assert(manager.getKeepAlivesSent() == 3);
+   for(int i = 0; i < 3; i++)
+   {
+      assert(peers[i].received(2000) == 1);
+      assert(manager.scheduled(peers[i].mTarget, false) == 1);
+   }
+   assert(statsValue(manager, "Keepalives sent") == 3);
+   assert(statsValue(manager, "Keepalives deferred") == 1);
+}
+
+static void
+testPongTimeouts(DialogUsageManager& dum)
+{
+   // Pongs are only checked on outbound (RFC5626) flows over reliable
+   // transports; no connection exists for these, so the keepalives and flow
+   // terminations go nowhere
+   TestKeepAliveManager manager;
+   manager.setDialogUsageManager(&dum);
+   manager.setBucketResolutionMs(Resolution);
+   const int outboundInterval = 60;
+   Tuple answered("127.0.0.1", 5060, V4, TCP);
+   answered.mFlowKey = 1001;
+   Tuple silent("127.0.0.1", 5061, V4, TCP);
+   silent.mFlowKey = 1002;
+
+   UInt64 start = Timer::getTimeMs();
+   manager.add(answered, outboundInterval, true);
+   manager.add(silent, outboundInterval, true);
+
+   // Outbound keepalives are jittered down to 80% of the interval
+   UInt64 now = start + outboundInterval * 1000 + Resolution;
+   manager.runBuckets(now);
+   assert(manager.getKeepAlivesSent() == 2);
+   assert(manager.scheduled(answered, true) == 1);
+   assert(manager.scheduled(silent, true) == 1);
+
+   manager.receivedPong(answered);
+   assert(manager.getPongsReceived() == 1);
+
+   // Not yet timed out
+   manager.runBuckets(now + KeepAliveManager::mKeepAlivePongTimeoutMs - Resolution);
+   assert(manager.getPongTimeouts() == 0);
+
+   // Only the flow that did not answer times out
+   manager.runBuckets(now + KeepAliveManager::mKeepAlivePongTimeoutMs + Resolution);
+   assert(manager.getPongTimeouts() == 1);
+   assert(manager.scheduled(answered, true) == 0);
+   assert(manager.scheduled(silent, true) == 0);
+   assert(manager.getKeepAlivesSent() == 2);
+
+   // The per association pong timer path does the same
+   KeepAlivePongTimeout silentTimeout(silent, manager.id(silent));
+   manager.process(silentTimeout);
+   assert(manager.getPongTimeouts() == 2);
+   KeepAlivePongTimeout answeredTimeout(answered, manager.id(answered));
+   manager.process(answeredTimeout);
+   assert(manager.getPongTimeouts() == 2);
+   // ...and ignores timers for an earlier association on the same flow
+   KeepAlivePongTimeout staleTimeout(silent, manager.id(silent) - 100);
+   manager.process(staleTimeout);
+   assert(manager.getPongTimeouts() == 2);
+
+   // A pong for the next keepalive is needed again
+   now += outboundInterval * 1000 + Resolution;
+   manager.runBuckets(now);
+   assert(manager.getKeepAlivesSent() == 4);
+   manager.runBuckets(now + KeepAliveManager::mKeepAlivePongTimeoutMs + Resolution);
+   assert(manager.getPongTimeouts() == 4);
+
+   // Removed flows are not checked
+   now += outboundInterval * 1000 + Resolution;
+   manager.runBuckets(now);
+   assert(manager.getKeepAlivesSent() == 6);
+   manager.remove(answered);
+   manager.remove(silent);
+   manager.runBuckets(now + KeepAliveManager::mKeepAlivePongTimeoutMs + Resolution);
+   assert(manager.getPongTimeouts() == 4);
+
+   assert(statsValue(manager, "Keepalives sent") == 6);
+   assert(statsValue(manager, "Pongs received") == 1);
+   assert(statsValue(manager, "Pong timeouts") == 4);
+
+   manager.resetStats();
+   assert(statsValue(manager, "Keepalives sent") == 0);
+   assert(statsValue(manager, "Pong timeouts") == 0);
+}
+
+int
+main(int argc, char** argv)
+{
+   Log::initialize(Log::Cout, Log::Err, argv[0]);
+   initNetwork();
+
+   EventStackSimpleMgr stackMgr("");
+   SipStackOptions options;
+   SipStack& stack = stackMgr.createStack(options);
+   stack.addTransport(UDP, 0, V4, StunDisabled, Data("127.0.0.1"));
+   DialogUsageManager dum(stack);
+   stack.run();
+   stackMgr.getThread().run();
+
+   testKeepAlives(dum);
+   testCappedBuckets(dum);
+   testPongTimeouts(dum);
+
+   stackMgr.getThread().shutdown();
+   stackMgr.getThread().join();
+   stack.shutdownAndJoinThreads();
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -37,6 +37,7 @@ Connection::Connection(Transport* transport,const Tuple& who, Socket socket,
    : ConnectionBase(transport,who,compression),
      mFirstWriteAfterConnectedPending(false),
      mInWritable(false),
+     mPreparedSends(0),
      mFlowTimerEnabled(false),
      mPollItemHandle(0),
      mIsServer(isServer)
@@ -79,8 +80,11 @@ Connection::requestWrite(SendData* sendData)
 void 
 Connection::removeFrontOutstandingSend()
 {
-   delete mOutstandingSends.front();
-   mOutstandingSends.pop_front();
+   delete mOutstandingSends.pop_front();
+   if (mPreparedSends > 0)
+   {
+      --mPreparedSends;
+   }
 
    if (mOutstandingSends.empty())
    {
@@ -90,61 +94,12 @@ Connection::removeFrontOutstandingSend()
    }
 }
 
-int
-Connection::performWrite()
+void
+Connection::prepareSend(SendData& sendData)
 {
-   if(transportWrite())
-   {
-      // If we get here it means:
-      // a. on a previous invocation, SSL_do_handshake wanted to write
-      //         (SSL_ERROR_WANT_WRITE)
-      // b. now the handshake is complete or it wants to read
-      if(mInWritable)
-      {
-         getConnectionManager().removeFromWritable(this);
-         mInWritable = false;
-      }
-      else
-      {
-         WarningLog(<<"performWrite invoked while not in write set");
-      }
-      return 0; // Q. What does this transportWrite() mean?
-                // A. It makes the TLS handshake move along after it
-                //    was waiting in the write set.
-   }
-
-   // If the TLS handshake returned SSL_ERROR_WANT_WRITE again
-   // then we could get here without really having something to write
-   // so just return, remaining in the write set.
-   if(mOutstandingSends.empty())
-   {
-      // FIXME: this needs to be more elaborate with respect
-      // to TLS handshaking but it doesn't appear we can do that
-      // without ABI breakage.
-      return 0;
-   }
-
-   switch(mOutstandingSends.front()->command)
-   {
-   case SendData::CloseConnection:
-      // .bwc. Close this connection.
-      return -1;
-      break;
-   case SendData::EnableFlowTimer:
-      enableFlowTimer();
-      removeFrontOutstandingSend();
-      return 0;
-      break;
-   default:
-      // do nothing
-      break;
-   }
-
-   const Data& sigcompId = mOutstandingSends.front()->sigcompId;
-
    if(mSendingTransmissionFormat == Unknown)
    {
-      if (sigcompId.size() > 0 && mCompression.isEnabled())
+      if (sendData.sigcompId.size() > 0 && mCompression.isEnabled())
       {
          mSendingTransmissionFormat = Compressed;
       }
@@ -155,12 +110,12 @@ Connection::performWrite()
    }
    else if(mSendingTransmissionFormat == WebSocketHandshake)
    {
+      // this is the handshake response itself, it is not framed
       mSendingTransmissionFormat = WebSocketData;
    }
    else if(mSendingTransmissionFormat == WebSocketData)
    {
-      SendData *dataWs, *oldSd;
-      const Data& dataRaw = mOutstandingSends.front()->data;
+      const Data& dataRaw = sendData.data;
       UInt64 dataSize = 1 + 1 + dataRaw.size();
       UInt64 lSize = (UInt64)dataRaw.size();
       UInt8* uBuffer;
@@ -174,14 +129,9 @@ Connection::performWrite()
          dataSize += 8;
       }
 
-      oldSd = mOutstandingSends.front();
-      dataWs = new SendData(oldSd->destination,
-            Data(Data::Take, new char[(int)dataSize], (Data::size_type)dataSize),
-            oldSd->transactionId,
-            oldSd->sigcompId,
-            false);
-      resip_assert(dataWs && dataWs->data.data());
-      uBuffer = (UInt8*)dataWs->data.data();
+      Data dataWs(Data::Take, new char[(int)dataSize], (Data::size_type)dataSize);
+      resip_assert(dataWs.data());
+      uBuffer = (UInt8*)dataWs.data();
 
       uBuffer[0] = 0x82;
       if(lSize <= 0x7D)
@@ -211,37 +161,80 @@ Connection::performWrite()
       }
 
       memcpy(uBuffer, dataRaw.data(), dataRaw.size());
-      mOutstandingSends.front() = dataWs;
-      dataWs = 0;
-      delete oldSd;
+      // the frame replaces the message in place
+      sendData.data.takeBuf(dataWs);
    }
 
 #ifdef USE_SIGCOMP
    // Perform compression here, if appropriate
    if (mSendingTransmissionFormat == Compressed
-       && !(mOutstandingSends.front()->isAlreadyCompressed))
+       && !(sendData.isAlreadyCompressed))
    {
-      const Data& uncompressed = mOutstandingSends.front()->data;
+      const Data& uncompressed = sendData.data;
       osc::SigcompMessage *sm = 
         mSigcompStack->compressMessage(uncompressed.data(), uncompressed.size(),
-                                       sigcompId.data(), sigcompId.size(),
+                                       sendData.sigcompId.data(), sendData.sigcompId.size(),
                                        true);
       DebugLog (<< "Compressed message from "
                 << uncompressed.size() << " bytes to " 
                 << sm->getStreamLength() << " bytes");
 
-      SendData *oldSd = mOutstandingSends.front();
-      SendData *newSd = new SendData(oldSd->destination,
-                                     Data(sm->getStreamMessage(),
-                                          sm->getStreamLength()),
-                                     oldSd->transactionId,
-                                     oldSd->sigcompId,
-                                     true);
-      mOutstandingSends.front() = newSd;
-      delete oldSd;
+      sendData.data = Data(sm->getStreamMessage(), sm->getStreamLength());
+      sendData.isAlreadyCompressed = true;
       delete sm;
    }
 #endif
+}
+
+int
+Connection::performWrite()
+{
+   if(transportWrite())
+   {
+      // If we get here it means:
+      // a. on a previous invocation, SSL_do_handshake wanted to write
+      //         (SSL_ERROR_WANT_WRITE)
+      // b. now the handshake is complete or it wants to read
+      if(mInWritable)
+      {
+         getConnectionManager().removeFromWritable(this);
+         mInWritable = false;
+      }
+      else
+      {
+         WarningLog(<<"performWrite invoked while not in write set");
+      }
+      return 0; // Q. What does this transportWrite() mean?
+                // A. It makes the TLS handshake move along after it
+                //    was waiting in the write set.
+   }
+
+   // If the TLS handshake returned SSL_ERROR_WANT_WRITE again
+   // then we could get here without really having something to write
+   // so just return, remaining in the write set.
+   if(mOutstandingSends.empty())
+   {
+      // FIXME: this needs to be more elaborate with respect
+      // to TLS handshaking but it doesn't appear we can do that
+      // without ABI breakage.
+      return 0;
+   }
+
+   switch(mOutstandingSends.front()->command)
+   {
+   case SendData::CloseConnection:
+      // .bwc. Close this connection.
+      return -1;
+      break;
+   case SendData::EnableFlowTimer:
+      enableFlowTimer();
+      removeFrontOutstandingSend();
+      return 0;
+      break;
+   default:
+      // do nothing
+      break;
+   }
 
    // Note:  The first time the socket is available for write, is when the TCP connect call is completed
    if (mFirstWriteAfterConnectedPending)
@@ -249,9 +242,9 @@ Connection::performWrite()
       mFirstWriteAfterConnectedPending = false;  // reset
 
       // Notify all outstanding sends that we are now connected - stops the TCP Connection timer for all transactions
-      for (std::list<SendData*>::iterator it = mOutstandingSends.begin(); it != mOutstandingSends.end(); it++)
+      for (SendData* sd = mOutstandingSends.front(); sd; sd = SendDataQueue::next(sd))
       {
-         mTransport->setTcpConnectState((*it)->transactionId, TcpConnectState::Connected);
+         mTransport->setTcpConnectState(sd->transactionId, TcpConnectState::Connected);
       }
       if (mEnablePostConnectSocketFuncCall)
       {
@@ -259,10 +252,33 @@ Connection::performWrite()
       }
    }
 
-   const Data& data = mOutstandingSends.front()->data;
-   int nBytes = write(data.data() + mSendPos,int(data.size() - mSendPos));
+   // Gather the queued messages, up to the next command, so that they go out
+   // in one write.  Each message is framed/compressed once, the first time it
+   // gets here; the front one may have been partially written already.
+   WriteBuffer buffers[MaxWriteBuffers];
+   int count = 0;
+   int total = 0;
+   size_t index = 0;
+   for (SendData* sd = mOutstandingSends.front(); 
+        sd && sd->command == SendData::NoCommand && count < MaxWriteBuffers && total < MaxWriteSize;
+        sd = SendDataQueue::next(sd), ++index)
+   {
+      if (index == mPreparedSends)
+      {
+         prepareSend(*sd);
+         ++mPreparedSends;
+      }
+      Data::size_type offset = (count == 0 ? mSendPos : 0);
+      buffers[count].data = sd->data.data() + offset;
+      buffers[count].length = int(sd->data.size() - offset);
+      total += buffers[count].length;
+      ++count;
+   }
+   resip_assert(count > 0);
+
+   int nBytes = writeBuffers(buffers, count);
 
-   //DebugLog (<< "Tried to send " << data.size() - mSendPos << " bytes, sent " << nBytes << " bytes");
+   //DebugLog (<< "Tried to send " << total << " bytes in " << count << " messages, sent " << nBytes << " bytes");
 
    if (nBytes < 0)
    {
@@ -280,16 +296,44 @@ Connection::performWrite()
    {
       // Safe because of the conditional above ( < 0 ).
       Data::size_type bytesWritten = static_cast<Data::size_type>(nBytes);
-      mSendPos += bytesWritten;
-      if (mSendPos == data.size())
+      unsigned int messagesWritten = 0;
+      while (bytesWritten > 0)
       {
+         const Data& data = mOutstandingSends.front()->data;
+         Data::size_type remaining = data.size() - mSendPos;
+         if (bytesWritten < remaining)
+         {
+            mSendPos += bytesWritten;
+            break;
+         }
+         bytesWritten -= remaining;
          mSendPos = 0;
+         ++messagesWritten;
          removeFrontOutstandingSend();
       }
-      return bytesWritten;
+      getConnectionManager().onWrite(messagesWritten, (unsigned int)count);
+      return nBytes;
    }
 }
 
+int
+Connection::writeBuffers(const WriteBuffer* buffers, int count)
+{
+   resip_assert(count > 0);
+   if (count == 1)
+   {
+      return write(buffers[0].data, buffers[0].length);
+   }
+
+   // Everything is copied into one buffer, which is kept, since if nothing can
+   // be written a TLS connection needs to be retried with the same data
+   mCoalesceBuffer.truncate2(0);
+   for (int i = 0; i < count; ++i)
+   {
+      mCoalesceBuffer.append(buffers[i].data, buffers[i].length);
+   }
+   return write(mCoalesceBuffer.data(), int(mCoalesceBuffer.size()));
+}
 
 bool 
 Connection::performWrites(unsigned int max)
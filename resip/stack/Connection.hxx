@@ -66,7 +66,8 @@ class Connection : public ConnectionBase,
       /// queue data to write and add this to writable list
       void requestWrite(SendData* sendData);
 
-      /// send some or all of a queued data; remove from writable if completely written
+      /** send some or all of the queued data, gathering as many queued messages
+          as possible into one write; remove from writable if completely written */
       int performWrite();
 
       /** Call performWrite() repeatedly, until either the send queue is 
@@ -105,10 +106,24 @@ class Connection : public ConnectionBase,
       static void setEnablePostConnectSocketFuncCall(bool enabled = true) { mEnablePostConnectSocketFuncCall = enabled; }
       bool isServer()const;
    protected:
+      enum { MaxWriteBuffers = 64, // most messages gathered into one write
+             MaxWriteSize = 65536 }; // stop gathering once this many bytes are gathered
+
+      struct WriteBuffer
+      {
+         const char* data;
+         int length;
+      };
+
       /// pure virtual, but need concrete Connection for book-ends of lists
       virtual int read(char* /* buffer */, const int /* count */) { return 0; }
       /// pure virtual, but need concrete Connection for book-ends of lists
       virtual int write(const char* /* buffer */, const int /* count */) { return 0; }
+      /** Writes count buffers (at most MaxWriteBuffers) at once, returns the
+          number of bytes written like write().  The default copies them into one
+          buffer and calls write() once, which for TLS means one SSL_write;
+          TcpConnection overrides it with writev(). */
+      virtual int writeBuffers(const WriteBuffer* buffers, int count);
       virtual void onDoubleCRLF();
       virtual void onSingleCRLF();
 
@@ -120,7 +135,13 @@ class Connection : public ConnectionBase,
    private:
       ConnectionManager& getConnectionManager() const;
       void removeFrontOutstandingSend();
+      void prepareSend(SendData& sendData);
       bool mInWritable;
+      // the number of sends at the front of mOutstandingSends that
+      // prepareSend() has been called for
+      size_t mPreparedSends;
+      // used by writeBuffers()
+      Data mCoalesceBuffer;
       bool mFlowTimerEnabled;
       FdPollItemHandle mPollItemHandle;
       
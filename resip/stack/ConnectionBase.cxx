@@ -64,6 +64,8 @@ ConnectionBase::ConnectionBase(Transport* transport, const Tuple& who, Compressi
      mBuffer(0),
      mBufferPos(0),
      mBufferSize(0),
+     mRxStart(0),
+     mRxHeadersLength(0),
      mWsFrameExtractor(messageSizeMax),
      mLastUsed(Timer::getTimeMs()),
      mConnState(NewMessage)
@@ -99,12 +101,11 @@ ConnectionBase::~ConnectionBase()
 
    while (!mOutstandingSends.empty())
    {
-      SendData* sendData = mOutstandingSends.front();
+      SendData* sendData = mOutstandingSends.pop_front();
       mTransport->fail(sendData->transactionId,
          mFailureReason ? mFailureReason : TransportFailure::ConnectionUnknown,
          mFailureSubCode);
       delete sendData;
-      mOutstandingSends.pop_front();
    }
    delete [] mBuffer;
    delete mMessage;
@@ -179,6 +180,8 @@ ConnectionBase::preparseNewBytes(int bytesRead)
 
          resip_assert(mTransport);
          mMessage = new SipMessage(&mTransport->getTuple());
+         mRxStart = mBuffer;
+         mRxHeadersLength = 0;
          
          DebugLog(<< "ConnectionBase::process setting source " << mWho);
          mMessage->setSource(mWho);
@@ -265,6 +268,10 @@ ConnectionBase::preparseNewBytes(int bytesRead)
             }
             memcpy(newBuffer, unprocessedCharPtr, numUnprocessedChars);
             delete [] mBuffer;
+            if (mRxStart)
+            {
+               mRxStart = newBuffer;
+            }
             mBuffer = newBuffer;
             mBufferPos = numUnprocessedChars;
             mBufferSize = size;
@@ -272,11 +279,13 @@ ConnectionBase::preparseNewBytes(int bytesRead)
             return true;
          }
 
-         mMessage->addBuffer(mBuffer);
+         mMessage->addBuffer(mBuffer, mBufferSize);
          mBuffer=0;
 
          if (scanChunkResult == MsgHeaderScanner::scrNextChunk)
          {
+            // The headers are split across buffers
+            mRxStart = 0;
             // Message header is incomplete...
             if (numUnprocessedChars == 0)
             {
@@ -323,6 +332,10 @@ ConnectionBase::preparseNewBytes(int bytesRead)
          else
          {
             size_t contentLength = 0;
+            if (mRxStart)
+            {
+               mRxHeadersLength = unprocessedCharPtr - mRxStart;
+            }
             
             try
             {
@@ -434,10 +447,12 @@ ConnectionBase::preparseNewBytes(int bytesRead)
                }
                else
                {
+                  Data received;
+                  getReceivedBytes(received, unprocessedCharPtr, contentLength);
                   Transport::stampReceived(mMessage);
                   DebugLog(<< "##Connection: " << *this << " received: " << *mMessage);
                   resip_assert( mTransport );
-                  mTransport->pushRxMsgUp(mMessage);
+                  mTransport->pushRxMsgUp(mMessage, received);
                   mMessage = 0;
                }
 
@@ -475,8 +490,9 @@ ConnectionBase::preparseNewBytes(int bytesRead)
          {
             int overHang = mBufferPos - (int)contentLength;
             char *overHangStart = mBuffer + contentLength;
+            const char *body = mBuffer;
 
-            mMessage->addBuffer(mBuffer);
+            mMessage->addBuffer(mBuffer, mBufferSize);
             mMessage->setBody(mBuffer, (UInt32)contentLength);
             mConnState = NewMessage;
             mBuffer = 0;
@@ -535,9 +551,11 @@ ConnectionBase::preparseNewBytes(int bytesRead)
             {
                DebugLog(<< "##ConnectionBase: " << *this << " received: " << *mMessage);
 
+               Data received;
+               getReceivedBytes(received, body, contentLength);
                Transport::stampReceived(mMessage);
                resip_assert( mTransport );
-               mTransport->pushRxMsgUp(mMessage);
+               mTransport->pushRxMsgUp(mMessage, received);
                mMessage = 0;
             }
             
@@ -733,6 +751,39 @@ ConnectionBase::wsProcessHandshake(int bytesRead, bool &dropConnection)
    return true;
 }
 
+// Sets received to mMessage as it came off the wire, for the
+// SipMessageLoggingHandler.  Left empty when no handler is installed or the
+// headers were split across buffers, in which case the handler is given the
+// parsed message instead.
+void
+ConnectionBase::getReceivedBytes(Data& received, const char* body, size_t bodyLength) const
+{
+   if (!mRxStart || !mTransport->getSipMessageLoggingHandler())
+   {
+      return;
+   }
+
+   // Skip any CRLFs the scanner ignored ahead of the start line
+   const char* start = mRxStart;
+   const char* headersEnd = mRxStart + mRxHeadersLength;
+   while (start < headersEnd && (*start == '\r' || *start == '\n'))
+   {
+      ++start;
+   }
+
+   if (bodyLength == 0 || body == headersEnd)
+   {
+      received.setBuf(Data::Share, start, (Data::size_type)(headersEnd - start + bodyLength));
+   }
+   else
+   {
+      // The body was read into a buffer of its own
+      received.reserve((Data::size_type)(headersEnd - start + bodyLength));
+      received.append(start, (Data::size_type)(headersEnd - start));
+      received.append(body, (Data::size_type)bodyLength);
+   }
+}
+
 bool
 ConnectionBase::scanMsgHeader(int bytesRead)
 {
@@ -850,7 +901,7 @@ ConnectionBase::wsProcessData(int bytesRead)
       Data::size_type msg_len = msg->size();
       // cast permitted, as it is borrowed:
       char *sipBuffer = (char *)msg->data();
-      mMessage->addBuffer(sipBuffer);
+      mMessage->addBuffer(sipBuffer, msg_len);
       mMsgHeaderScanner.prepareForMessage(mMessage);
       char *unprocessedCharPtr;
       if (mMsgHeaderScanner.scanChunk(sipBuffer,
@@ -880,7 +931,7 @@ ConnectionBase::wsProcessData(int bytesRead)
       {
          Transport::stampReceived(mMessage);
          resip_assert( mTransport );
-         mTransport->pushRxMsgUp(mMessage);
+         mTransport->pushRxMsgUp(mMessage, Data(Data::Share, sipBuffer, msg_len));
          mMessage = 0;
       }
       else
@@ -936,7 +987,7 @@ ConnectionBase::decompressNewBytes(int bytesRead)
 
     char *sipBuffer = new char[bytesUncompressed];
     memmove(sipBuffer, uncompressed, bytesUncompressed);
-    mMessage->addBuffer(sipBuffer);
+    mMessage->addBuffer(sipBuffer, bytesUncompressed);
     mMsgHeaderScanner.prepareForMessage(mMessage);
     char *unprocessedCharPtr;
     if (mMsgHeaderScanner.scanChunk(sipBuffer,
@@ -1002,7 +1053,7 @@ ConnectionBase::decompressNewBytes(int bytesRead)
         }
       }
       resip_assert( mTransport );
-      mTransport->pushRxMsgUp(mMessage);
+      mTransport->pushRxMsgUp(mMessage, Data(Data::Share, sipBuffer, bytesUncompressed));
       mMessage = 0;
       sc = 0;
     }
@@ -89,7 +89,7 @@ class ConnectionBase
       void setBuffer(char* bytes, int count);
 
       Data::size_type mSendPos;
-      std::list<SendData*> mOutstandingSends; // !jacob! intrusive queue?
+      SendDataQueue mOutstandingSends;
 
       void setFailureReason(TransportFailure::FailureReason failReason, int subCode);
 
@@ -100,6 +100,7 @@ class ConnectionBase
       ConnectionBase(const Connection&);
       ConnectionBase& operator=(const Connection&);
       bool scanMsgHeader(int bytesRead);
+      void getReceivedBytes(Data& received, const char* body, size_t bodyLength) const;
       std::auto_ptr<Data> makeWsHandshakeResponse();
       bool isUsingSecWebSocketKey();
       bool isUsingDeprecatedSecWebSocketKeys();
@@ -121,6 +122,10 @@ class ConnectionBase
       char* mBuffer;
       size_t mBufferPos;
       size_t mBufferSize;
+      // Start line and headers of mMessage as received, if they arrived in a
+      // single buffer (mRxStart is 0 otherwise)
+      const char* mRxStart;
+      size_t mRxHeadersLength;
       WsFrameExtractor mWsFrameExtractor;
 
       static char connectionStates[MAX][32];
@@ -29,7 +29,10 @@ ConnectionManager::ConnectionManager() :
    mReadHead(ConnectionReadList::makeList(&mHead)),
    mLRUHead(ConnectionLruList::makeList(&mHead)),
    mFlowTimerLRUHead(FlowTimerLruList::makeList(&mHead)),
-   mPollGrp(0)
+   mPollGrp(0),
+   mWrites(0),
+   mMessagesWritten(0),
+   mMaxMessagesPerWrite(0)
 {
    DebugLog(<<"ConnectionManager::ConnectionManager() called ");
 }
@@ -179,6 +182,17 @@ ConnectionManager::removeFromWritable(Connection* conn)
    }
 }
 
+void
+ConnectionManager::onWrite(unsigned int messagesWritten, unsigned int messagesGathered)
+{
+   ++mWrites;
+   mMessagesWritten += messagesWritten;
+   if (messagesGathered > mMaxMessagesPerWrite)
+   {
+      mMaxMessagesPerWrite = messagesGathered;
+   }
+}
+
 void
 ConnectionManager::addConnection(Connection* connection)
 {
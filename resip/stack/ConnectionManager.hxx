@@ -49,7 +49,15 @@ class ConnectionManager
 
       virtual void invokeAfterSocketCreationFunc() const;
 
+      /// write statistics for the connections of this transport; the average
+      /// number of messages per write is getMessagesWritten()/getWrites()
+      UInt64 getWrites() const { return mWrites; }
+      UInt64 getMessagesWritten() const { return mMessagesWritten; }
+      /// the most messages gathered into one write
+      unsigned int getMaxMessagesPerWrite() const { return mMaxMessagesPerWrite; }
+
    private:
+      void onWrite(unsigned int messagesWritten, unsigned int messagesGathered);
       void addToWritable(Connection* conn); // add the specified conn to end
       void removeFromWritable(Connection* conn); // remove the current mWriteMark
 
@@ -86,6 +94,10 @@ class ConnectionManager
 
       /// collection for epoll
       FdPollGrp* mPollGrp;
+
+      UInt64 mWrites;
+      UInt64 mMessagesWritten;
+      unsigned int mMaxMessagesPerWrite;
       //<<---------------------------------
 
       friend class TcpBaseTransport;
@@ -5,6 +5,7 @@
 #endif
 
 #include "resip/stack/Contents.hxx"
+#include "resip/stack/ParseStatistics.hxx"
 #include "rutil/ParseBuffer.hxx"
 #include "rutil/Logger.hxx"
 #include "resip/stack/OctetContents.hxx"
@@ -67,6 +68,12 @@ Contents::errorContext() const
    return errorContextData;
 }
 
+int
+Contents::statisticsType() const
+{
+   return ParseStatistics::Contents;
+}
+
 Contents& 
 Contents::operator=(const Contents& rhs) 
 {
@@ -337,6 +337,7 @@ class Contents : public LazyParser
       }
       /** @internal */
       virtual const Data& errorContext() const;
+      virtual int statisticsType() const;
 
       /** @internal */
       Mime mType;
@@ -5,6 +5,7 @@
 #include <stdexcept>
 
 #include "resip/stack/HEPSipMessageLoggingHandler.hxx"
+#include "resip/stack/SendData.hxx"
 #include "rutil/hep/ResipHep.hxx"
 #include "rutil/DataStream.hxx"
 #include "rutil/Logger.hxx"
@@ -34,10 +35,19 @@ HEPSipMessageLoggingHandler::outboundMessage(const Tuple &source, const Tuple &d
    sendToHOMER(source, destination, msg);
 }
 
+void
+HEPSipMessageLoggingHandler::outboundEncodedMessage(const Tuple &source, const Tuple &destination, const SipMessage &msg, const Data& encoded)
+{
+   sendToHOMER(source, destination, encoded,
+      msg.exists(h_CallId) ? msg.header(h_CallId).value() : Data::Empty);
+}
+
 void
 HEPSipMessageLoggingHandler::outboundRetransmit(const Tuple &source, const Tuple &destination, const SendData &data)
 {
-   // FIXME - implement for SendData
+   // Retransmissions are only available encoded; HOMER correlates them by
+   // the Call-ID in the payload
+   sendToHOMER(source, destination, data.data, Data::Empty);
 }
 
 void
@@ -46,15 +56,31 @@ HEPSipMessageLoggingHandler::inboundMessage(const Tuple& source, const Tuple& de
    sendToHOMER(source, destination, msg);
 }
 
+void
+HEPSipMessageLoggingHandler::inboundEncodedMessage(const Tuple& source, const Tuple& destination, const SipMessage &msg, const Data& received)
+{
+   // The bytes as received, without the Via received/rport the stack added
+   sendToHOMER(source, destination, received,
+      msg.exists(h_CallId) ? msg.header(h_CallId).value() : Data::Empty);
+}
+
 void
 HEPSipMessageLoggingHandler::sendToHOMER(const Tuple& source, const Tuple& destination, const SipMessage &msg)
 {
-   mHepAgent->sendToHOMER<SipMessage>(source.getType(),
-      source.toGenericIPAddress(), destination.toGenericIPAddress(),
-      HepAgent::SIP, msg,
+   Data encoded;
+   msg.encodeToBuffer(encoded);
+   sendToHOMER(source, destination, encoded,
       msg.exists(h_CallId) ? msg.header(h_CallId).value() : Data::Empty);
 }
 
+void
+HEPSipMessageLoggingHandler::sendToHOMER(const Tuple& source, const Tuple& destination, const Data& encoded, const Data& correlationId)
+{
+   mHepAgent->sendToHOMER(source.getType(),
+      source.toGenericIPAddress(), destination.toGenericIPAddress(),
+      HepAgent::SIP, encoded.data(), encoded.size(), correlationId);
+}
+
 /* ====================================================================
  *
  * Copyright 2016 Daniel Pocock http://danielpocock.com  All rights reserved.
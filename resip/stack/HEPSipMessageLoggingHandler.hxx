@@ -17,10 +17,14 @@ class HEPSipMessageLoggingHandler : public Transport::SipMessageLoggingHandler
       HEPSipMessageLoggingHandler(SharedPtr<HepAgent> agent);
       virtual ~HEPSipMessageLoggingHandler();
       virtual void outboundMessage(const Tuple &source, const Tuple &destination, const SipMessage &msg);
+      virtual void outboundEncodedMessage(const Tuple &source, const Tuple &destination, const SipMessage &msg, const Data& encoded);
       virtual void outboundRetransmit(const Tuple &source, const Tuple &destination, const SendData &data);
       virtual void inboundMessage(const Tuple& source, const Tuple& destination, const SipMessage &msg);
+      virtual void inboundEncodedMessage(const Tuple& source, const Tuple& destination, const SipMessage &msg, const Data& received);
    protected:
       virtual void sendToHOMER(const Tuple& source, const Tuple& destination, const SipMessage &msg);
+      // Queues already encoded bytes; correlationId is normally the Call-ID
+      virtual void sendToHOMER(const Tuple& source, const Tuple& destination, const Data& encoded, const Data& correlationId);
    private:
       SharedPtr<HepAgent> mHepAgent;
 };
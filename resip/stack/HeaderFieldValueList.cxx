@@ -9,6 +9,8 @@
 #include "resip/stack/HeaderFieldValueList.hxx"
 #include "resip/stack/ParserContainerBase.hxx"
 #include "resip/stack/Embedded.hxx"
+#include "resip/stack/MessageBuffers.hxx"
+#include "resip/stack/SipMessageEncoder.hxx"
 #include "rutil/WinLeakCheck.hxx"
 
 using namespace resip;
@@ -50,6 +52,33 @@ HeaderFieldValueList::HeaderFieldValueList(const HeaderFieldValueList& rhs, Pool
    }
 }
 
+HeaderFieldValueList::HeaderFieldValueList(const HeaderFieldValueList& rhs, PoolBase& pool, const MessageBuffers& sharedBuffers)
+   : mHeaders(StlPoolAllocator<HeaderFieldValue, PoolBase>(&pool)),
+     mPool(&pool),
+     mParserContainer(0)
+{
+   if (rhs.mParserContainer)
+   {
+      mParserContainer = rhs.mParserContainer->clone(sharedBuffers);
+   }
+   else if(rhs.mHeaders.size())
+   {
+      mHeaders.reserve(rhs.mHeaders.size());
+      for (ListImpl::const_iterator i = rhs.mHeaders.begin(); i != rhs.mHeaders.end(); ++i)
+      {
+         if (sharedBuffers.contains(i->getBuffer(), i->getLength()))
+         {
+            mHeaders.push_back(HeaderFieldValue::Empty);
+            mHeaders.back().init(i->getBuffer(), i->getLength(), false);
+         }
+         else
+         {
+            mHeaders.push_back(*i);
+         }
+      }
+   }
+}
+
 HeaderFieldValueList&
 HeaderFieldValueList::operator=(const HeaderFieldValueList& rhs)
 {
@@ -136,6 +165,74 @@ HeaderFieldValueList::encode(const Data& headerName, EncodeStream& str) const
    return str;
 }
 
+void
+HeaderFieldValueList::encode(int headerEnum, SipMessageEncoder& encoder) const
+{
+   const Data& headerName = Headers::getHeaderName(static_cast<Headers::Type>(headerEnum));
+
+   if (getParserContainer() != 0)
+   {
+      getParserContainer()->encode(headerName, encoder);
+   }
+   else
+   {
+      bool commaEncoding = Headers::isCommaEncoding(static_cast<Headers::Type>(headerEnum));
+      for (HeaderFieldValueList::const_iterator j = begin();
+           j != end(); j++)
+      {
+         if (j == begin() || !commaEncoding)
+         {
+            if (j != begin())
+            {
+               encoder.add(Symbols::CRLF, 2);
+            }
+            if (!headerName.empty())
+            {
+               encoder.add(headerName);
+               encoder.add(Symbols::COLON, 1);
+               encoder.add(Symbols::SPACE, 1);
+            }
+         }
+         else
+         {
+            encoder.add(Symbols::COMMA, 1);
+            encoder.add(Symbols::SPACE, 1);
+         }
+         encoder.add(j->getBuffer(), j->getLength());
+      }
+      encoder.add(Symbols::CRLF, 2);
+   }
+}
+
+void
+HeaderFieldValueList::encode(const Data& headerName, SipMessageEncoder& encoder) const
+{
+   if (getParserContainer() != 0)
+   {
+      getParserContainer()->encode(headerName, encoder);
+   }
+   else
+   {
+      if (!headerName.empty())
+      {
+         encoder.add(headerName);
+         encoder.add(Symbols::COLON, 1);
+         encoder.add(Symbols::SPACE, 1);
+      }
+      for (HeaderFieldValueList::const_iterator j = begin();
+           j != end(); j++)
+      {
+         if (j != begin())
+         {
+            encoder.add(Symbols::COMMA, 1);
+            encoder.add(Symbols::SPACE, 1);
+         }
+         encoder.add(j->getBuffer(), j->getLength());
+      }
+      encoder.add(Symbols::CRLF, 2);
+   }
+}
+
 EncodeStream&
 HeaderFieldValueList::encodeEmbedded(const Data& headerName, EncodeStream& str) const
 {
@@ -13,6 +13,8 @@ namespace resip
 class Data;
 class ParserContainerBase;
 class HeaderFieldValue;
+class SipMessageEncoder;
+class MessageBuffers;
 
 /**
    @internal
@@ -37,6 +39,13 @@ class HeaderFieldValueList
       ~HeaderFieldValueList();
       HeaderFieldValueList(const HeaderFieldValueList& rhs);
       HeaderFieldValueList(const HeaderFieldValueList& rhs, PoolBase& pool);
+      /**
+         @brief Copies rhs; unparsed values that lie in sharedBuffers are
+            referred to in place instead of being copied.
+         @note The copy must hold a reference to sharedBuffers for as long as
+            it lives (see SipMessage).
+      */
+      HeaderFieldValueList(const HeaderFieldValueList& rhs, PoolBase& pool, const MessageBuffers& sharedBuffers);
       HeaderFieldValueList& operator=(const HeaderFieldValueList& rhs);
       
       inline void setParserContainer(ParserContainerBase* parser) {mParserContainer = parser;}
@@ -45,6 +54,8 @@ class HeaderFieldValueList
       EncodeStream& encode(int headerEnum, EncodeStream& str) const;
       EncodeStream& encode(const Data& headerName, EncodeStream& str) const;
       EncodeStream& encodeEmbedded(const Data& headerName, EncodeStream& str) const;
+      void encode(int headerEnum, SipMessageEncoder& encoder) const;
+      void encode(const Data& headerName, SipMessageEncoder& encoder) const;
 
       bool empty() const {return mHeaders.empty();}
       size_t size() const {return mHeaders.size();}
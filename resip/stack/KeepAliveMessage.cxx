@@ -1,4 +1,5 @@
 #include "resip/stack/KeepAliveMessage.hxx"
+#include "resip/stack/SipMessageEncoder.hxx"
 #include "rutil/WinLeakCheck.hxx"
 
 using namespace resip;
@@ -46,6 +47,12 @@ KeepAliveMessage::encode(EncodeStream& str) const
    return str;
 }
 
+void
+KeepAliveMessage::encode(SipMessageEncoder& encoder) const
+{
+   encoder.add(Symbols::CRLFCRLF, 4);
+}
+
 /* ====================================================================
  * The Vovida Software License, Version 1.0 
  * 
@@ -15,6 +15,7 @@ class KeepAliveMessage : public SipMessage
       KeepAliveMessage& operator=(const KeepAliveMessage& rhs);      
       virtual ~KeepAliveMessage();
       virtual EncodeStream& encode(EncodeStream& str) const;
+      virtual void encode(SipMessageEncoder& encoder) const;
 };
 }
 
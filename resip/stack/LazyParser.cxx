@@ -8,6 +8,8 @@
 #include "resip/stack/Headers.hxx"
 #include "resip/stack/HeaderFieldValue.hxx"
 #include "resip/stack/LazyParser.hxx"
+#include "resip/stack/ParseStatistics.hxx"
+#include "resip/stack/SipMessageEncoder.hxx"
 #include "rutil/ParseBuffer.hxx"
 #include "rutil/WinLeakCheck.hxx"
 
@@ -72,6 +74,11 @@ LazyParser::operator=(const LazyParser& rhs)
 void
 LazyParser::doParse() const
 {
+   if (ParseStatistics::isEnabled())
+   {
+      ParseStatistics::record(ParseStatistics::Parse, statisticsType());
+   }
+
    LazyParser* ncThis = const_cast<LazyParser*>(this);
    // .bwc. We assume the worst, and if the parse succeeds, we update.
    ncThis->mState = MALFORMED;
@@ -95,6 +102,12 @@ LazyParser::isWellFormed() const
    return (mState!=MALFORMED);
 }
 
+int
+LazyParser::statisticsType() const
+{
+   return ParseStatistics::UnknownHeader;
+}
+
 void
 LazyParser::clear()
 {
@@ -115,6 +128,24 @@ LazyParser::encode(EncodeStream& str) const
    }
 }
 
+void
+LazyParser::encode(SipMessageEncoder& encoder) const
+{
+   if (mState == DIRTY)
+   {
+      // counted on the pass that writes, not the one that sizes
+      if (ParseStatistics::isEnabled() && !encoder.sizing())
+      {
+         ParseStatistics::record(ParseStatistics::Reencode, statisticsType());
+      }
+      encoder.addEncoded(*this);
+   }
+   else
+   {
+      encoder.add(mHeaderField.getBuffer(), mHeaderField.getLength());
+   }
+}
+
 #ifndef  RESIP_USE_STL_STREAMS
 EncodeStream&
 resip::operator<<(EncodeStream&s, const LazyParser& lp)
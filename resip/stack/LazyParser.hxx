@@ -14,6 +14,7 @@ namespace resip
 
 class ParseBuffer;
 class Data;
+class SipMessageEncoder;
 
 /**
    @brief The base-class for all lazily-parsed SIP grammar elements.
@@ -84,6 +85,13 @@ class LazyParser
       */
       EncodeStream& encode(EncodeStream& str) const;
 
+      /**
+         @internal
+         @brief Adds this element to a SipMessageEncoder - the original text
+            is referenced unless the element has been modified.
+      */
+      virtual void encode(SipMessageEncoder& encoder) const;
+
       /**
          @brief Returns true iff a parse has been attempted.
          @note This means that this will return true if a parse failed earlier.
@@ -134,6 +142,9 @@ class LazyParser
 
       // context for error messages
       virtual const Data& errorContext() const = 0;
+
+      // what this is, as far as ParseStatistics is concerned
+      virtual int statisticsType() const;
       
    private:
       // !dlb! bit of a hack until the dust settles
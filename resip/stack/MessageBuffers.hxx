@@ -0,0 +1,119 @@
+#if !defined(RESIP_MESSAGEBUFFERS_HXX)
+#define RESIP_MESSAGEBUFFERS_HXX
+
+#include <vector>
+
+#include "rutil/SharedPtr.hxx"
+
+namespace resip
+{
+
+/**
+   @internal
+   @brief The raw buffers a SipMessage was received (parsed) in.
+
+   Unparsed header field values and the raw body of a received message point
+   straight into these buffers.  The buffers are never modified once the
+   message has been scanned, so copies of a message share them (reference
+   counted) and refer to the unmodified header values and body in place,
+   instead of copying each of them.  A buffer is freed (delete[]) when the
+   last message holding it goes away.
+*/
+class MessageBuffers
+{
+   public:
+      MessageBuffers();
+      ~MessageBuffers();
+
+      /**
+         @brief Takes ownership of buffer, allocated with new[].
+         @param length the size of the allocation; if 0 the size is not known
+            and nothing in this buffer will be shared with copies.
+      */
+      void add(char* buffer, size_t length=0);
+
+      /// Adds a reference to each of the buffers held by rhs.
+      void share(const MessageBuffers& rhs);
+
+      /// Releases this message's reference to each buffer.
+      void clear();
+
+      bool empty() const { return mBuffers.empty(); }
+
+      /// Returns true if [start, start+length) lies inside a buffer of known size.
+      bool contains(const char* start, size_t length) const;
+
+   private:
+      class Buffer
+      {
+         public:
+            Buffer(char* buffer, size_t length) : mBuffer(buffer), mLength(length) {}
+            ~Buffer() { delete [] mBuffer; }
+
+            char* mBuffer;
+            size_t mLength;
+
+         private:
+            Buffer(const Buffer&);
+            Buffer& operator=(const Buffer&);
+      };
+
+      std::vector<SharedPtr<Buffer> > mBuffers;
+
+      // not implemented; see share()
+      MessageBuffers(const MessageBuffers&);
+      MessageBuffers& operator=(const MessageBuffers&);
+};
+
+}
+
+#endif
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,365 @@
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <cstring>
+#include <list>
+#include <vector>
+
+#include "resip/stack/ParseStatistics.hxx"
+#include "rutil/Lock.hxx"
+#include "rutil/Mutex.hxx"
+#include "rutil/ResipAssert.h"
+#include "rutil/ThreadIf.hxx"
+#include "rutil/WinLeakCheck.hxx"
+
+using namespace resip;
+
+const char* const ParseStatistics::UnscopedPath = "unscoped";
+volatile bool ParseStatistics::sEnabled = false;
+
+namespace
+{
+
+Mutex sMutex;
+
+class PathCounters
+{
+   public:
+      explicit PathCounters(const Data& name) : mName(name)
+      {
+         clear();
+      }
+
+      void clear()
+      {
+         memset(mCounts, 0, sizeof(mCounts));
+      }
+
+      void add(const PathCounters& rhs)
+      {
+         for (int e = 0; e < ParseStatistics::MaxEvent; ++e)
+         {
+            for (int t = 0; t < ParseStatistics::MaxType; ++t)
+            {
+               mCounts[e][t] += rhs.mCounts[e][t];
+            }
+         }
+      }
+
+      const Data mName;
+      UInt64 mCounts[ParseStatistics::MaxEvent][ParseStatistics::MaxType];
+};
+
+class ThreadCounters
+{
+   public:
+      ThreadCounters() : mCurrent(0)
+      {
+         mPaths.push_back(new PathCounters(ParseStatistics::UnscopedPath));
+      }
+
+      ~ThreadCounters()
+      {
+         for (std::vector<PathCounters*>::iterator i = mPaths.begin(); i != mPaths.end(); ++i)
+         {
+            delete *i;
+         }
+      }
+
+      // index of path, added if this thread has not seen it before.  Only
+      // the owning thread calls this, but getCount() and encode() walk mPaths
+      // from other threads under sMutex, so a new path (once per scope per
+      // thread) is appended under it too.
+      size_t index(const char* path)
+      {
+         for (size_t i = 0; i < mPaths.size(); ++i)
+         {
+            if (mPaths[i]->mName == path)
+            {
+               return i;
+            }
+         }
+         PathCounters* counters = new PathCounters(path);
+         Lock lock(sMutex);
+         mPaths.push_back(counters);
+         return mPaths.size() - 1;
+      }
+
+      PathCounters* find(const Data& path) const
+      {
+         for (std::vector<PathCounters*>::const_iterator i = mPaths.begin(); i != mPaths.end(); ++i)
+         {
+            if ((*i)->mName == path)
+            {
+               return *i;
+            }
+         }
+         return 0;
+      }
+
+      // only for totals that no other thread can see, or with sMutex held
+      void add(const ThreadCounters& rhs)
+      {
+         for (std::vector<PathCounters*>::const_iterator i = rhs.mPaths.begin(); i != rhs.mPaths.end(); ++i)
+         {
+            PathCounters* p = find((*i)->mName);
+            if (!p)
+            {
+               p = new PathCounters((*i)->mName);
+               mPaths.push_back(p);
+            }
+            p->add(**i);
+         }
+      }
+
+      void clear()
+      {
+         for (std::vector<PathCounters*>::iterator i = mPaths.begin(); i != mPaths.end(); ++i)
+         {
+            (*i)->clear();
+         }
+      }
+
+      size_t mCurrent;
+      std::vector<PathCounters*> mPaths;
+
+   private:
+      ThreadCounters(const ThreadCounters&);
+      ThreadCounters& operator=(const ThreadCounters&);
+};
+
+bool sKeyCreated = false;
+ThreadIf::TlsKey sKey;
+std::list<ThreadCounters*> sThreads;
+// counters of threads that have exited
+ThreadCounters* sRetired = 0;
+
+ThreadCounters*
+getThreadCounters()
+{
+   ThreadCounters* counters = static_cast<ThreadCounters*>(ThreadIf::tlsGetValue(sKey));
+   if (!counters)
+   {
+      counters = new ThreadCounters;
+      ThreadIf::tlsSetValue(sKey, counters);
+      Lock lock(sMutex);
+      sThreads.push_back(counters);
+   }
+   return counters;
+}
+
+}
+
+extern "C"
+{
+   static void freeParseStatistics(void* data)
+   {
+      ThreadCounters* counters = static_cast<ThreadCounters*>(data);
+      Lock lock(sMutex);
+      sThreads.remove(counters);
+      if (!sRetired)
+      {
+         sRetired = new ThreadCounters;
+      }
+      sRetired->add(*counters);
+      delete counters;
+   }
+}
+
+ParseStatistics::Scope::Scope(const char* path)
+   : mCounters(0),
+     mPrevious(0)
+{
+   if (sEnabled)
+   {
+      ThreadCounters* counters = getThreadCounters();
+      mPrevious = counters->mCurrent;
+      counters->mCurrent = counters->index(path);
+      mCounters = counters;
+   }
+}
+
+ParseStatistics::Scope::~Scope()
+{
+   if (mCounters)
+   {
+      static_cast<ThreadCounters*>(mCounters)->mCurrent = mPrevious;
+   }
+}
+
+void
+ParseStatistics::setEnabled(bool enabled)
+{
+   if (enabled)
+   {
+      Lock lock(sMutex);
+      if (!sKeyCreated)
+      {
+         ThreadIf::tlsKeyCreate(sKey, freeParseStatistics);
+         sKeyCreated = true;
+      }
+   }
+   sEnabled = enabled;
+}
+
+void
+ParseStatistics::record(Event event, int type)
+{
+   resip_assert(event >= 0 && event < MaxEvent);
+   if (type < 0 || type >= MaxType)
+   {
+      type = UnknownHeader;
+   }
+
+   ThreadCounters* counters = getThreadCounters();
+   ++counters->mPaths[counters->mCurrent]->mCounts[event][type];
+}
+
+UInt64
+ParseStatistics::getCount(const Data& path, Event event, int type)
+{
+   resip_assert(event >= 0 && event < MaxEvent);
+   resip_assert(type >= 0 && type < MaxType);
+
+   UInt64 count = 0;
+   Lock lock(sMutex);
+   for (std::list<ThreadCounters*>::const_iterator i = sThreads.begin(); i != sThreads.end(); ++i)
+   {
+      const PathCounters* p = (*i)->find(path);
+      if (p)
+      {
+         count += p->mCounts[event][type];
+      }
+   }
+   if (sRetired)
+   {
+      const PathCounters* p = sRetired->find(path);
+      if (p)
+      {
+         count += p->mCounts[event][type];
+      }
+   }
+   return count;
+}
+
+void
+ParseStatistics::reset()
+{
+   Lock lock(sMutex);
+   for (std::list<ThreadCounters*>::iterator i = sThreads.begin(); i != sThreads.end(); ++i)
+   {
+      (*i)->clear();
+   }
+   if (sRetired)
+   {
+      sRetired->clear();
+   }
+}
+
+const Data&
+ParseStatistics::getTypeName(int type)
+{
+   static const Data requestLine("Request-Line");
+   static const Data statusLine("Status-Line");
+   static const Data unknownHeader("(extension header)");
+   static const Data contents("(body)");
+
+   switch (type)
+   {
+      case RequestLine:
+         return requestLine;
+      case StatusLine:
+         return statusLine;
+      case Contents:
+         return contents;
+      default:
+         if (type >= 0 && type < Headers::MAX_HEADERS)
+         {
+            return Headers::getHeaderName(type);
+         }
+         return unknownHeader;
+   }
+}
+
+EncodeStream&
+ParseStatistics::encode(EncodeStream& str)
+{
+   ThreadCounters total;
+   {
+      Lock lock(sMutex);
+      for (std::list<ThreadCounters*>::const_iterator i = sThreads.begin(); i != sThreads.end(); ++i)
+      {
+         total.add(**i);
+      }
+      if (sRetired)
+      {
+         total.add(*sRetired);
+      }
+   }
+
+   str << "Parse statistics (path header: parsed reencoded)";
+   for (std::vector<PathCounters*>::const_iterator i = total.mPaths.begin(); i != total.mPaths.end(); ++i)
+   {
+      const PathCounters& p = **i;
+      for (int t = 0; t < MaxType; ++t)
+      {
+         if (p.mCounts[Parse][t] || p.mCounts[Reencode][t])
+         {
+            str << std::endl << "   " << p.mName << " " << getTypeName(t) << ": "
+                << p.mCounts[Parse][t] << " " << p.mCounts[Reencode][t];
+         }
+      }
+   }
+   return str;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
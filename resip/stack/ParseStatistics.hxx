@@ -0,0 +1,154 @@
+#if !defined(RESIP_PARSESTATISTICS_HXX)
+#define RESIP_PARSESTATISTICS_HXX 
+
+#include "resip/stack/HeaderTypes.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/compat.hxx"
+#include "rutil/resipfaststreams.hxx"
+
+namespace resip
+{
+
+/**
+   @brief Counts how often LazyParser elements are tokenised, and how often
+      they have to be re-encoded from their parsed form instead of being sent
+      as the original text, per header type and per code path.
+
+   Collection is off by default; when off, the only cost is a check of a
+   static flag in LazyParser::doParse() and on the encode path. Code paths are
+   labelled by placing a ParseStatistics::Scope on the stack; the innermost
+   Scope on the current thread gets the credit. Anything outside a Scope is
+   counted against the "unscoped" path.
+
+   Counters are kept per thread, so recording never takes a lock. Reading the
+   counters (getCount(), encode()) or calling reset() from another thread while
+   messages are being processed gives approximate figures, which is all this
+   is for.
+*/
+class ParseStatistics
+{
+   public:
+      /**
+         Things that are counted that are not header types; these follow the
+         Headers::Type values.
+      */
+      enum
+      {
+         RequestLine = Headers::MAX_HEADERS,
+         StatusLine,
+         UnknownHeader,
+         Contents,
+         MaxType
+      };
+
+      typedef enum
+      {
+         Parse,     // element was tokenised
+         Reencode,  // element was encoded onto the wire from its parsed form,
+                    // rather than as the original text (it was synthesized,
+                    // modified, or accessed non-const)
+         MaxEvent
+      } Event;
+
+      static const char* const UnscopedPath;
+
+      /**
+         Labels the parse work done on this thread while this object is in
+         scope. path must remain valid for the life of the Scope.
+      */
+      class Scope
+      {
+         public:
+            explicit Scope(const char* path);
+            ~Scope();
+
+         private:
+            Scope(const Scope&);
+            Scope& operator=(const Scope&);
+
+            void* mCounters;
+            size_t mPrevious;
+      };
+
+      static void setEnabled(bool enabled);
+      static bool isEnabled() { return sEnabled; }
+
+      /**
+         @internal
+         Callers are expected to check isEnabled() first.
+      */
+      static void record(Event event, int type);
+
+      /**
+         Sum of the counters for path over all threads (including threads that
+         have exited).
+      */
+      static UInt64 getCount(const Data& path, Event event, int type);
+
+      static void reset();
+
+      static const Data& getTypeName(int type);
+
+      /**
+         Writes one line per path and type with a non-zero count.
+      */
+      static EncodeStream& encode(EncodeStream& str);
+
+   private:
+      friend class Scope;
+      static volatile bool sEnabled;
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -4,6 +4,7 @@
 
 #include "resip/stack/HeaderFieldValue.hxx"
 #include "resip/stack/ParserCategory.hxx"
+#include "resip/stack/ParseStatistics.hxx"
 #include "rutil/ParseBuffer.hxx"
 #include "resip/stack/SipMessage.hxx"
 #include "rutil/DataStream.hxx"
@@ -456,6 +457,18 @@ ParserCategory::errorContext() const
    return Headers::getHeaderName(mHeaderType);
 }
 
+int
+ParserCategory::statisticsType() const
+{
+   // extension headers are all RESIP_DO_NOT_USE
+   if (mHeaderType >= 0 && mHeaderType < Headers::MAX_HEADERS &&
+       mHeaderType != Headers::RESIP_DO_NOT_USE)
+   {
+      return mHeaderType;
+   }
+   return ParseStatistics::UnknownHeader;
+}
+
 /* ====================================================================
  * The Vovida Software License, Version 1.0 
  * 
@@ -288,6 +288,7 @@ class ParserCategory : public LazyParser
       }
 
       virtual const Data& errorContext() const;
+      virtual int statisticsType() const;
 
       typedef std::vector<Parameter*, StlPoolAllocator<Parameter*, PoolBase> > ParameterList; 
       ParameterList mParameters;
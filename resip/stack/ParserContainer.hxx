@@ -90,6 +90,14 @@ class ParserContainer : public ParserContainerBase
          : ParserContainerBase(other, pool)
       {}
 
+      /**
+         @brief Copy c'tor; unparsed header field values that lie in
+            sharedBuffers are referred to in place instead of being copied.
+      */
+      ParserContainer(const ParserContainer& other, const MessageBuffers& sharedBuffers)
+         : ParserContainerBase(other, sharedBuffers)
+      {}
+
       /**
          @brief Assignment operator.
       */
@@ -307,6 +315,11 @@ class ParserContainer : public ParserContainerBase
          return new ParserContainer(*this);
       }
 
+      virtual ParserContainerBase* clone(const MessageBuffers& sharedBuffers) const
+      {
+         return new ParserContainer(*this, sharedBuffers);
+      }
+
    private:
       friend class ParserContainer<T>::iterator;
       friend class ParserContainer<T>::const_iterator;
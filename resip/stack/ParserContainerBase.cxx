@@ -2,6 +2,9 @@
 
 #include "resip/stack/ParserContainerBase.hxx"
 #include "resip/stack/Embedded.hxx"
+#include "resip/stack/MessageBuffers.hxx"
+#include "resip/stack/SipMessageEncoder.hxx"
+#include "resip/stack/Symbols.hxx"
 
 using namespace resip;
 using namespace std;;
@@ -37,6 +40,15 @@ ParserContainerBase::ParserContainerBase(const ParserContainerBase& rhs,
    copyParsers(rhs.mParsers);
 }
 
+ParserContainerBase::ParserContainerBase(const ParserContainerBase& rhs,
+                                          const MessageBuffers& sharedBuffers)
+   : mType(rhs.mType),
+     mParsers(),
+     mPool(0)
+{
+   copyParsers(rhs.mParsers, &sharedBuffers);
+}
+
 ParserContainerBase::~ParserContainerBase()
 {
    freeParsers();
@@ -114,6 +126,54 @@ ParserContainerBase::encode(const Data& headerName,
    return str;
 }
 
+void
+ParserContainerBase::encode(const Data& headerName, 
+                            SipMessageEncoder& encoder) const
+{
+   if (!mParsers.empty())
+   {
+      for (Parsers::const_iterator i = mParsers.begin(); 
+           i != mParsers.end(); ++i)
+      {
+         if (i == mParsers.begin() || !Headers::isCommaEncoding(mType))
+         {
+            if (i != mParsers.begin())
+            {
+               encoder.add(Symbols::CRLF, 2);
+            }
+            if (!headerName.empty())
+            {
+               encoder.add(headerName);
+               encoder.add(Symbols::COLON, 1);
+               encoder.add(Symbols::SPACE, 1);
+            }
+         }
+         else
+         {
+            encoder.add(Symbols::COMMA, 1);
+            encoder.add(Symbols::SPACE, 1);
+         }
+
+         i->encode(encoder);
+      }
+
+      encoder.add(Symbols::CRLF, 2);
+   }
+}
+
+void
+ParserContainerBase::HeaderKit::encode(SipMessageEncoder& encoder) const
+{
+   if(pc)
+   {
+      pc->encode(encoder);
+   }
+   else
+   {
+      encoder.add(hfv.getBuffer(), hfv.getLength());
+   }
+}
+
 EncodeStream&
 ParserContainerBase::encodeEmbedded(const Data& headerName, 
                                     EncodeStream& str) const
@@ -149,7 +209,7 @@ ParserContainerBase::encodeEmbedded(const Data& headerName,
 }
 
 void 
-ParserContainerBase::copyParsers(const Parsers& parsers)
+ParserContainerBase::copyParsers(const Parsers& parsers, const MessageBuffers* sharedBuffers)
 {
    mParsers.reserve(mParsers.size() + parsers.size());
    for(Parsers::const_iterator p=parsers.begin(); p!=parsers.end(); ++p)
@@ -163,6 +223,10 @@ ParserContainerBase::copyParsers(const Parsers& parsers)
       {
          kit.pc = makeParser(*(p->pc));
       } 
+      else if(sharedBuffers && sharedBuffers->contains(p->hfv.getBuffer(), p->hfv.getLength()))
+      {
+         kit.hfv.init(p->hfv.getBuffer(), p->hfv.getLength(), false);
+      }
       else 
       {
          kit.hfv = p->hfv;
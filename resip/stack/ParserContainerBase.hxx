@@ -14,6 +14,8 @@ namespace resip
 
 class HeaderFieldValueList;
 class PoolBase;
+class SipMessageEncoder;
+class MessageBuffers;
 
 /**
   @class ParserContainerBase
@@ -44,6 +46,13 @@ class ParserContainerBase
       ParserContainerBase(const ParserContainerBase& rhs,
                            PoolBase& pool);
 
+      /**
+        @brief copy constructor; unparsed header field values that lie in
+         sharedBuffers are referred to in place instead of being copied
+        */
+      ParserContainerBase(const ParserContainerBase& rhs,
+                           const MessageBuffers& sharedBuffers);
+
       /**
         @brief assignment operator copies the mParsers from the rhs
         @note this is a shallow copy
@@ -66,6 +75,12 @@ class ParserContainerBase
         */
       virtual ParserContainerBase* clone() const = 0;
 
+      /**
+        @brief as clone(), but unparsed header field values that lie in
+         sharedBuffers are referred to in place instead of being copied
+        */
+      virtual ParserContainerBase* clone(const MessageBuffers& sharedBuffers) const = 0;
+
       /**
         @brief return the size of the mParsers vector
         */
@@ -86,6 +101,12 @@ class ParserContainerBase
         */
       EncodeStream& encode(const Data& headerName, EncodeStream& str) const;
 
+      /**
+        @internal
+        @brief same as encode(headerName, str), but adds to a SipMessageEncoder
+        */
+      void encode(const Data& headerName, SipMessageEncoder& encoder) const;
+
       /**
         @internal
         @brief the actual mechanics of parsing
@@ -171,6 +192,8 @@ class ParserContainerBase
                }
                return str;
             }
+
+            void encode(SipMessageEncoder& encoder) const;
             
             ParserCategory* pc;
             HeaderFieldValue hfv;
@@ -186,7 +209,7 @@ class ParserContainerBase
       /**
         @brief copy header kits
         */
-      void copyParsers(const Parsers& parsers);
+      void copyParsers(const Parsers& parsers, const MessageBuffers* sharedBuffers=0);
 
       /**
         @brief free parser containers
@@ -3,6 +3,7 @@
 #endif
 
 #include "resip/stack/RequestLine.hxx"
+#include "resip/stack/ParseStatistics.hxx"
 #include "resip/stack/UnknownParameter.hxx"
 #include "rutil/Data.hxx"
 #include "rutil/DnsUtil.hxx"
@@ -171,6 +172,12 @@ RequestLine::errorContext() const
    return reqLine;
 }
 
+int
+RequestLine::statisticsType() const
+{
+   return ParseStatistics::RequestLine;
+}
+
 /* ====================================================================
  * The Vovida Software License, Version 1.0 
  * 
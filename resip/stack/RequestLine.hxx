@@ -42,6 +42,7 @@ class RequestLine : public StartLine
       virtual StartLine* clone(void* location) const;
       virtual EncodeStream& encodeParsed(EncodeStream& str) const;
       virtual const Data& errorContext() const;
+      virtual int statisticsType() const;
 
    private:
       Uri mUri;
@@ -20,7 +20,7 @@ class SendData
          EnableFlowTimer
       };
 
-      SendData() : isAlreadyCompressed(false), command(NoCommand)
+      SendData() : isAlreadyCompressed(false), command(NoCommand), mNextSend(0)
       {}
 
       SendData(const Tuple& dest,
@@ -33,7 +33,8 @@ class SendData
          transactionId(tid),
          sigcompId(scid),
          isAlreadyCompressed(isCompressed),
-         command(NoCommand)
+         command(NoCommand),
+         mNextSend(0)
       {
       }
 
@@ -44,13 +45,16 @@ class SendData
          transactionId(Data::Empty),
          sigcompId(Data::Empty),
          isAlreadyCompressed(false),
-         command(NoCommand)
+         command(NoCommand),
+         mNextSend(0)
       {
       }
 
       SendData* clone() const
       {
-         return new SendData(*this);
+         SendData* copy = new SendData(*this);
+         copy->mNextSend = 0;
+         return copy;
       }
 
       void clear()
@@ -71,6 +75,70 @@ class SendData
 
       // .bwc. Used for special commands: ie. to close connections, and enable flow timers
       SendDataCommand command;
+
+   private:
+      friend class SendDataQueue;
+      SendData* mNextSend;
+};
+
+/**
+   @internal
+   @brief FIFO of SendData, linked through the SendData themselves so that
+   queueing does not allocate.  Does not own the SendData.
+*/
+class SendDataQueue
+{
+   public:
+      SendDataQueue() : mFront(0), mBack(0), mSize(0)
+      {}
+
+      bool empty() const { return mFront == 0; }
+      size_t size() const { return mSize; }
+
+      SendData* front() const { return mFront; }
+
+      /// the SendData after sendData in the queue, or 0
+      static SendData* next(const SendData* sendData) { return sendData->mNextSend; }
+
+      void push_back(SendData* sendData)
+      {
+         sendData->mNextSend = 0;
+         if (mBack)
+         {
+            mBack->mNextSend = sendData;
+         }
+         else
+         {
+            mFront = sendData;
+         }
+         mBack = sendData;
+         ++mSize;
+      }
+
+      SendData* pop_front()
+      {
+         SendData* sendData = mFront;
+         if (sendData)
+         {
+            mFront = sendData->mNextSend;
+            if (mFront == 0)
+            {
+               mBack = 0;
+            }
+            sendData->mNextSend = 0;
+            --mSize;
+         }
+         return sendData;
+      }
+
+   private:
+      SendData* mFront;
+      SendData* mBack;
+      size_t mSize;
+
+      // no value semantics
+      SendDataQueue(const SendDataQueue&);
+      SendDataQueue& operator=(const SendDataQueue&);
 };
 
 }
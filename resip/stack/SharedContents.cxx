@@ -0,0 +1,118 @@
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include "resip/stack/SharedContents.hxx"
+#include "resip/stack/SipMessageEncoder.hxx"
+#include "rutil/ParseBuffer.hxx"
+#include "rutil/WinLeakCheck.hxx"
+
+using namespace resip;
+
+SharedContents::SharedContents(const Contents& contents)
+   : Contents(contents.getType()),
+     mBody(new Data(Data::from(contents)))
+{
+   // MIME headers (Content-Disposition etc.) are kept so that the message
+   // the body is attached to gets them too
+   init(contents);
+}
+
+SharedContents::SharedContents(const Data& body, const Mime& contentsType)
+   : Contents(contentsType),
+     mBody(new Data(body))
+{
+}
+
+SharedContents::SharedContents(const SharedContents& rhs)
+   : Contents(rhs),
+     mBody(rhs.mBody)
+{
+}
+
+SharedContents::~SharedContents()
+{
+}
+
+Contents* 
+SharedContents::clone() const
+{
+   return new SharedContents(*this);
+}
+
+EncodeStream& 
+SharedContents::encodeParsed(EncodeStream& str) const
+{
+   str.write(mBody->data(), mBody->size());
+   return str;
+}
+
+void
+SharedContents::encode(SipMessageEncoder& encoder) const
+{
+   encoder.add(mBody->data(), mBody->size());
+}
+
+void 
+SharedContents::parse(ParseBuffer& pb)
+{
+   // Not reached - SharedContents is always constructed parsed
+   const char* anchor = pb.position();
+   pb.skipToEnd();
+   mBody.reset(new Data(anchor, (Data::size_type)(pb.position() - anchor)));
+}
+
+Data
+SharedContents::getBodyData() const
+{
+   return *mBody;
+}
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
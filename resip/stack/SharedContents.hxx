@@ -0,0 +1,106 @@
+#if !defined(RESIP_SHAREDCONTENTS_HXX)
+#define RESIP_SHAREDCONTENTS_HXX 
+
+#include "resip/stack/Contents.hxx"
+#include "rutil/SharedPtr.hxx"
+
+namespace resip
+{
+
+/**
+   @ingroup sip_payload
+   @brief Immutable, already encoded body that can be attached to many
+   outgoing messages.
+
+   The body of another Contents (and its MIME headers) is encoded once on
+   construction.  Copies, including the clone made by 
+   SipMessage::setContents, share the encoded bytes rather than copying them,
+   and encoding a message writes them out as they are.  This is meant for
+   fan-out, eg. the same presence document in the NOTIFYs to every watcher
+   of a presentity.
+
+   SharedContents is only used for sending - there is no factory for it, so
+   the parser never creates one.
+*/
+class SharedContents : public Contents
+{
+   public:
+      explicit SharedContents(const Contents& contents);
+      SharedContents(const Data& body, const Mime& contentsType);
+      SharedContents(const SharedContents& rhs);
+      virtual ~SharedContents();
+
+      /** @brief duplicate a SharedContents object - the encoded body is 
+          shared with the copy, not copied
+          @return pointer to a new SharedContents object  
+        **/
+      virtual Contents* clone() const;
+
+      virtual EncodeStream& encodeParsed(EncodeStream& str) const;
+      using Contents::encode;
+      /// adds the shared bytes as they are, rather than encoding them into
+      /// the encoder's scratch buffer first
+      virtual void encode(SipMessageEncoder& encoder) const;
+      virtual void parse(ParseBuffer& pb);
+      virtual Data getBodyData() const;
+
+      const Data& getEncoded() const { return *mBody; }
+
+   private:
+      SharedContents& operator=(const SharedContents& rhs);
+
+      SharedPtr<const Data> mBody;
+};
+
+}
+
+#endif
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
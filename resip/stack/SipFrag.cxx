@@ -177,45 +177,29 @@ SipFrag::parse(ParseBuffer& pb)
    mMessage = new SipMessage();
 
    pb.assertNotEof();
-   const char *constBuffer = pb.position();
-   char *buffer = const_cast<char *>(constBuffer);
-
    size_t size = pb.end() - pb.position();
 
    // !ah! removed size check .. process() cannot process more
    // than size bytes of the message.
 
+   // The scanner needs a sentinel after the fragment, so scan a copy; the
+   // buffer being parsed may be shared with copies of the enclosing message
+   // and must not be written to.  The fragment keeps the copy, since its
+   // header values refer to it.
+   enum { sentinelLength = 4 };  // Two carriage return / line feed pairs.
+   char *buffer = MsgHeaderScanner::allocateBuffer((int)(size + sentinelLength));
+   mMessage->addBuffer(buffer, size + sentinelLength + MsgHeaderScanner::MaxNumCharsChunkOverflow);
+   memcpy(buffer, pb.position(), size);
+   memcpy(buffer + size, "\r\n\r\n", sentinelLength);
 
    MsgHeaderScanner msgHeaderScanner;
    msgHeaderScanner.prepareForFrag(mMessage, hasStartLine(buffer, (int)size));
-   enum { sentinelLength = 4 };  // Two carriage return / line feed pairs.
-   //char saveTermCharArray[sentinelLength];
-   static const char* sentinel="\r\n\r\n";
-   char *termCharArray = buffer + size;
-   memcpy(scratchpad,termCharArray,4);
-   
-   /*saveTermCharArray[0] = termCharArray[0];
-   saveTermCharArray[1] = termCharArray[1];
-   saveTermCharArray[2] = termCharArray[2];
-   saveTermCharArray[3] = termCharArray[3];*/
-   
-   memcpy(termCharArray,sentinel,4);
-   /*termCharArray[0] = '\r';
-   termCharArray[1] = '\n';
-   termCharArray[2] = '\r';
-   termCharArray[3] = '\n';*/
    char *scanTermCharPtr;
    MsgHeaderScanner::ScanChunkResult scanChunkResult =
        msgHeaderScanner.scanChunk(buffer,
                                   (unsigned int)(size + sentinelLength),
                                   &scanTermCharPtr);
    
-   memcpy(termCharArray,scratchpad,4);
-   /*termCharArray[0] = saveTermCharArray[0];
-   termCharArray[1] = saveTermCharArray[1];
-   termCharArray[2] = saveTermCharArray[2];
-   termCharArray[3] = saveTermCharArray[3];*/
-   
    // !dlb! not at all clear what to do here
    // see: "// tests end of message problem (MsgHeaderScanner?)"
    //      in test/testSipFrag.cxx
@@ -241,7 +225,7 @@ SipFrag::parse(ParseBuffer& pb)
          // !dlb! 
          if (mMessage->exists(h_ContentLength))
          {
-            pb.reset(buffer + used);
+            pb.reset(pb.position() + used);
             pb.skipChars(Symbols::CRLF);
             mMessage->setBody(pb.position(),int(pb.end()-pb.position()) );
          }
@@ -46,7 +46,6 @@ class SipFrag : public Contents
    private:
       bool hasStartLine(char* buffer, int size);      
       SipMessage* mMessage;
-      char scratchpad[4];
 };
 
 static bool invokeSipFragInit = SipFrag::init();
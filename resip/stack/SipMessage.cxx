@@ -7,6 +7,7 @@
 #include "resip/stack/OctetContents.hxx"
 #include "resip/stack/HeaderFieldValueList.hxx"
 #include "resip/stack/SipMessage.hxx"
+#include "resip/stack/SipMessageEncoder.hxx"
 #include "resip/stack/ExtensionHeader.hxx"
 #include "rutil/Coders.hxx"
 #include "rutil/CountStream.hxx"
@@ -148,6 +149,10 @@ SipMessage::init(const SipMessage& rhs)
 
    memcpy(&mHeaderIndices,&rhs.mHeaderIndices,sizeof(mHeaderIndices));
 
+   // Header values and the body that have not been modified still lie in the
+   // receive buffers of rhs; share these buffers and refer to them in place.
+   mBufferList.share(rhs.mBufferList);
+
    // .bwc. Clear out the pesky invalid 0 index.
    clearHeaders();
    mHeaders.reserve(rhs.mHeaders.size());
@@ -172,6 +177,10 @@ SipMessage::init(const SipMessage& rhs)
    {
       mContents = rhs.mContents->clone();
    }
+   else if (mBufferList.contains(rhs.mContentsHfv.getBuffer(), rhs.mContentsHfv.getLength()))
+   {
+      mContentsHfv.init(rhs.mContentsHfv.getBuffer(), rhs.mContentsHfv.getLength(), false);
+   }
    else if (rhs.mContentsHfv.getBuffer() != 0)
    {
       mContentsHfv.copyWithPadding(rhs.mContentsHfv);
@@ -231,12 +240,7 @@ SipMessage::freeMem(bool leaveResponseStuff)
    if(!leaveResponseStuff)
    {
       clearHeaders();
-
-      for (vector<char*>::iterator i = mBufferList.begin();
-           i != mBufferList.end(); i++)
-      {
-         delete [] *i;
-      }
+      mBufferList.clear();
    }
 
    if(mStartLine)
@@ -276,7 +280,7 @@ SipMessage::make(const Data& data, bool isExternal)
    size_t len = data.size();
    char *buffer = new char[len + 5];
 
-   msg->addBuffer(buffer);
+   msg->addBuffer(buffer, len + 5);
    memcpy(buffer,data.data(), len);
    MsgHeaderScanner msgHeaderScanner;
    msgHeaderScanner.prepareForMessage(msg);
@@ -776,6 +780,86 @@ SipMessage::encode(EncodeStream& str, bool isSipFrag) const
    return str;
 }
 
+void
+SipMessage::encode(SipMessageEncoder& encoder) const
+{
+   if (mStartLine != 0)
+   {
+      mStartLine->encode(encoder);
+      encoder.add(Symbols::CRLF, 2);
+   }
+
+   for (UInt8 i = 0; i < Headers::MAX_HEADERS; i++)
+   {
+      if (i != Headers::ContentLength) // !dlb! hack...
+      {
+         if (mHeaderIndices[i] > 0)
+         {
+            mHeaders[mHeaderIndices[i]]->encode(i, encoder);
+         }
+      }
+   }
+
+   for (UnknownHeaders::const_iterator i = mUnknownHeaders.begin(); 
+        i != mUnknownHeaders.end(); i++)
+   {
+      i->second->encode(i->first, encoder);
+   }
+
+   // The size of the body is only known after the first pass has added it
+   if (encoder.sizing())
+   {
+      size_t headersSize = encoder.size();
+      encodeBody(encoder);
+      encoder.setContentLength(encoder.size() - headersSize);
+      encodeContentLength(encoder.getContentLength(), encoder);
+   }
+   else
+   {
+      encodeContentLength(encoder.getContentLength(), encoder);
+      encodeBody(encoder);
+   }
+}
+
+void
+SipMessage::encodeBody(SipMessageEncoder& encoder) const
+{
+   if (mContents != 0)
+   {
+      mContents->encode(encoder);
+   }
+   else if (mContentsHfv.getBuffer() != 0)
+   {
+      encoder.add(mContentsHfv.getBuffer(), mContentsHfv.getLength());
+   }
+}
+
+void
+SipMessage::encodeContentLength(size_t length, SipMessageEncoder& encoder)
+{
+   Data value((UInt64)length);
+   encoder.add("Content-Length: ", 16);
+   encoder.add(value);
+   encoder.add(Symbols::CRLFCRLF, 4);
+}
+
+void
+SipMessage::encodeToBuffer(Data& buffer) const
+{
+   SipMessageEncoder encoder;
+   encodeToBuffer(buffer, encoder);
+}
+
+void
+SipMessage::encodeToBuffer(Data& buffer, SipMessageEncoder& encoder) const
+{
+   encoder.reset();
+   encode(encoder);
+   encoder.startWriting(buffer);
+   encode(encoder);
+   encoder.finish();
+}
+
 EncodeStream&
 SipMessage::encodeSingleHeader(Headers::Type type, EncodeStream& str) const
 {
@@ -862,7 +946,13 @@ SipMessage::encodeEmbedded(EncodeStream& str) const
 void
 SipMessage::addBuffer(char* buf)
 {
-   mBufferList.push_back(buf);
+   mBufferList.add(buf);
+}
+
+void
+SipMessage::addBuffer(char* buf, size_t length)
+{
+   mBufferList.add(buf, length);
 }
 
 void 
@@ -18,6 +18,7 @@
 #include "resip/stack/Uri.hxx"
 #include "resip/stack/MessageDecorator.hxx"
 #include "resip/stack/Cookie.hxx"
+#include "resip/stack/MessageBuffers.hxx"
 #include "resip/stack/WsCookieContext.hxx"
 #include "rutil/BaseException.hxx"
 #include "rutil/Data.hxx"
@@ -33,6 +34,7 @@ namespace resip
 class Contents;
 class ExtensionHeader;
 class SecurityAttributes;
+class SipMessageEncoder;
 
 /**
    @ingroup resip_crit
@@ -264,6 +266,21 @@ class SipMessage : public TransactionMessage
       @return string representation of a SIP message.
       */
       virtual EncodeStream& encode(EncodeStream& str) const;      
+
+      /** @brief Encodes the message for the wire without going through a stream.
+
+      Headers and body that have not been modified are copied verbatim from
+      the buffer the message was received in, and the exact size of the
+      message is computed before anything is written, see SipMessageEncoder.
+      Called once per pass.  Classes that override encode(EncodeStream&) must
+      override this as well.
+      */
+      virtual void encode(SipMessageEncoder& encoder) const;
+      /// Appends the wire encoding of the message to buffer, using encode(SipMessageEncoder&)
+      void encodeToBuffer(Data& buffer) const;
+      /// As above, reusing encoder (which saves allocations when encoding many messages)
+      void encodeToBuffer(Data& buffer, SipMessageEncoder& encoder) const;
+
       //sipfrags will not output Content Length if there is no body--introduce
       //friendship to hide this?
       virtual EncodeStream& encodeSipFrag(EncodeStream& str) const;
@@ -535,6 +552,10 @@ class SipMessage : public TransactionMessage
       Tuple& getDestination() { return mDestination; }
 
       void addBuffer(char* buf);
+      /// Takes ownership of buf (length bytes, allocated with new[]). Copies
+      /// of this message share the buffer rather than copying the header
+      /// values and body that lie in it.
+      void addBuffer(char* buf, size_t length);
 
       UInt64 getCreatedTimeMicroSec() {return mCreatedTime;}
 
@@ -595,6 +616,8 @@ class SipMessage : public TransactionMessage
 
       EncodeStream& 
       encode(EncodeStream& str, bool isSipFrag) const;      
+      void encodeBody(SipMessageEncoder& encoder) const;
+      static void encodeContentLength(size_t length, SipMessageEncoder& encoder);
 
       void copyFrom(const SipMessage& message);
 
@@ -631,7 +654,7 @@ class SipMessage : public TransactionMessage
       inline HeaderFieldValueList* getCopyHfvl(const HeaderFieldValueList& hfvl)
       {
          void* ptr(mPool.allocate(sizeof(HeaderFieldValueList)));
-         return new (ptr) HeaderFieldValueList(hfvl, mPool);
+         return new (ptr) HeaderFieldValueList(hfvl, mPool, mBufferList);
       }
 
       inline void freeHfvl(HeaderFieldValueList* hfvl)
@@ -692,8 +715,9 @@ class SipMessage : public TransactionMessage
       // Used by the TU to specify where a message is to go
       Tuple mDestination;
       
-      // Raw buffers coming from the Transport. message manages the memory
-      std::vector<char*> mBufferList;
+      // Raw buffers coming from the Transport. message manages the memory,
+      // together with any copies of the message (see MessageBuffers)
+      MessageBuffers mBufferList;
 
       // special case for the first line of message
       StartLine* mStartLine;
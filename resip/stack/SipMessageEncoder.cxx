@@ -0,0 +1,153 @@
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include "resip/stack/SipMessageEncoder.hxx"
+#include "resip/stack/LazyParser.hxx"
+#include "rutil/DataStream.hxx"
+#include "rutil/ResipAssert.h"
+#include "rutil/WinLeakCheck.hxx"
+
+using namespace resip;
+
+static const size_t MaxScratchSize = 64*1024;
+
+SipMessageEncoder::SipMessageEncoder() :
+   mBuffer(0),
+   mSize(0),
+   mTotalSize(0),
+   mContentLength(0),
+   mNextEncoded(0),
+   mScratchStart(0),
+   mScratchPosition(0)
+{
+}
+
+SipMessageEncoder::~SipMessageEncoder()
+{
+}
+
+void
+SipMessageEncoder::addEncoded(const LazyParser& parser)
+{
+   if (mBuffer == 0)
+   {
+      if (mScratchStream.get() == 0)
+      {
+         mScratch.reserve(512);
+         mScratchStream.reset(new DataStream(mScratch));
+         mEncodedSizes.reserve(16);
+      }
+      size_t start = mScratch.size();
+      parser.encodeParsed(*mScratchStream);
+      mScratchStream->flush();
+      size_t length = mScratch.size() - start;
+      mEncodedSizes.push_back(length);
+      mSize += length;
+   }
+   else
+   {
+      resip_assert(mNextEncoded < mEncodedSizes.size());
+      size_t length = mEncodedSizes[mNextEncoded++];
+      add(mScratch.data() + mScratchPosition, length);
+      mScratchPosition += length;
+   }
+}
+
+void
+SipMessageEncoder::startWriting(Data& buffer)
+{
+   resip_assert(mBuffer == 0);
+   if (mScratchStream.get())
+   {
+      mScratchStream->flush();
+   }
+   mTotalSize = mSize;
+   mSize = 0;
+   mScratchPosition = mScratchStart;
+   mBuffer = &buffer;
+   mBuffer->reserve(mBuffer->size() + mTotalSize + 1);  // + 1 since append null terminates
+}
+
+void
+SipMessageEncoder::finish()
+{
+   resip_assert(mBuffer != 0);
+   // both passes must have added the same pieces
+   resip_assert(mSize == mTotalSize);
+   resip_assert(mNextEncoded == mEncodedSizes.size());
+}
+
+void
+SipMessageEncoder::reset()
+{
+   mBuffer = 0;
+   mSize = 0;
+   mTotalSize = 0;
+   mContentLength = 0;
+   mEncodedSizes.clear();
+   mNextEncoded = 0;
+   if (mScratchStream.get())
+   {
+      // The stream keeps appending after what earlier messages left in the
+      // scratch buffer; it is only started over once that gets large
+      mScratchStream->flush();
+      if (mScratch.size() > MaxScratchSize)
+      {
+         mScratchStream.reset();
+         mScratch.clear();
+      }
+   }
+   mScratchStart = mScratch.size();
+   mScratchPosition = mScratchStart;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,143 @@
+#if !defined(RESIP_SIPMESSAGEENCODER_HXX)
+#define RESIP_SIPMESSAGEENCODER_HXX
+
+#include <memory>
+#include <vector>
+
+#include "rutil/Data.hxx"
+
+namespace resip
+{
+
+class DataStream;
+class LazyParser;
+
+/**
+   @internal
+   @brief Encodes a SipMessage straight into a single, exactly sized buffer.
+
+   The message is walked twice.  The first pass only adds up the size of each
+   piece; elements that have been modified (dirty) are encoded into a scratch
+   buffer here, using their usual stream encoders, since that is the only way
+   to know their size.  The destination is then grown once, and the second
+   pass appends each piece to it: unmodified header values are copied
+   verbatim from where they are (normally the receive buffer of the message)
+   and dirty elements are copied from the scratch buffer.
+
+   Both passes must add exactly the same pieces, in the same order.  An
+   encoder can be reused for further messages after reset(); the scratch
+   buffer is kept, so encoding modified messages does not allocate.
+*/
+class SipMessageEncoder
+{
+   public:
+      SipMessageEncoder();
+      ~SipMessageEncoder();
+
+      /// Adds length bytes at data
+      void add(const char* data, size_t length)
+      {
+         if (mBuffer)
+         {
+            mBuffer->append(data, length);
+         }
+         mSize += length;
+      }
+      void add(const Data& data) { add(data.data(), data.size()); }
+
+      /// Adds the encoding of a modified element
+      void addEncoded(const LazyParser& parser);
+
+      /// true during the first pass
+      bool sizing() const { return mBuffer == 0; }
+
+      /// The size of everything added so far in this pass
+      size_t size() const { return mSize; }
+
+      /// Lets the first pass pass the size of the body on to the second,
+      /// where it is needed before the body is added
+      void setContentLength(size_t length) { mContentLength = length; }
+      size_t getContentLength() const { return mContentLength; }
+
+      /// Ends the first pass, grows buffer to fit the message and starts the
+      /// second pass, which appends to buffer
+      void startWriting(Data& buffer);
+
+      /// Ends the second pass
+      void finish();
+
+      /// Prepares for the first pass of another message
+      void reset();
+
+   private:
+      Data* mBuffer;
+      size_t mSize;
+      size_t mTotalSize;
+      size_t mContentLength;
+
+      // dirty elements, encoded during the first pass
+      Data mScratch;
+      std::auto_ptr<DataStream> mScratchStream;
+      std::vector<size_t> mEncodedSizes;
+      size_t mNextEncoded;
+      size_t mScratchStart;
+      size_t mScratchPosition;
+
+      // no value semantics
+      SipMessageEncoder(const SipMessageEncoder&);
+      SipMessageEncoder& operator=(const SipMessageEncoder&);
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
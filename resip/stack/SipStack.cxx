@@ -900,6 +900,26 @@ SipStack::sendTo(const SipMessage& msg, const Tuple& destination, TransactionUse
    mTransactionController->send(toSend);
 }
 
+void
+SipStack::sendTo(const SipMessage& msg, const std::vector<Tuple>& destinations, TransactionUser* tu)
+{
+   resip_assert(!mShuttingDown);
+
+   Fifo<TransactionMessage>::Messages toSend;
+   for(std::vector<Tuple>::const_iterator it = destinations.begin(); it != destinations.end(); ++it)
+   {
+      SipMessage* copy = static_cast<SipMessage*>(msg.clone());
+      if (tu) copy->setTransactionUser(tu);
+      copy->setDestination(*it);
+      copy->setFromTU();
+      toSend.push_back(copy);
+   }
+   if(!toSend.empty())
+   {
+      mTransactionController->sendMultiple(toSend);
+   }
+}
+
 void
 SipStack::checkAsyncProcessHandler()
 {
@@ -496,6 +496,23 @@ class SipStack : public FdSetIOObserver
       void sendTo(const SipMessage& msg, const Tuple& tuple,
                   TransactionUser* tu=0);
 
+      /**
+          @brief send a copy of a message to each of a number of destinations
+          @details Same as sendTo(msg, tuple, tu) for each of destinations, 
+          except that all of the copies are handed to the stack in one go, 
+          rather than taking the fifo lock and waking the stack once per
+          copy.  Meant for messages such as keepalives that go out to many
+          flows at once.
+
+          @param msg          SipMessage to send.
+
+          @param destinations Destinations to send to.
+
+          @param tu           TransactionUser to send from.
+      */
+      void sendTo(const SipMessage& msg, const std::vector<Tuple>& destinations,
+                  TransactionUser* tu=0);
+
       /**
           @brief force the a message out over an existing connection
 
@@ -970,6 +987,33 @@ class SipStack : public FdSetIOObserver
          return mTransactionController->transportSelector().getUdpOnlyOnNumeric();
       }
 
+      /**
+         Specify whether header-field-values that nobody has parsed should be
+         passed through untouched when a message is sent. Normally the stack
+         parses the Contact, Record-Route and Referred-By of outgoing messages
+         to fill in any host and port the TU left blank. That only applies to
+         values the TU synthesized; for a proxy, values received from the wire
+         that no processor has looked at are then tokenised for nothing. With
+         this enabled they are skipped, and go out as the original text.
+
+         @param passThrough Denotes whether unparsed header-field-values should
+            be skipped by the outgoing fix-ups.
+         @note This is disabled by default. A TU that builds messages from
+            text (rather than through the parser classes) and relies on the
+            stack to fill in its Contact should leave it disabled.
+         @see ParseStatistics for measuring which headers get parsed where.
+         @ingroup resip_config
+      */
+      void setPassThroughUntouchedHeaders(bool passThrough)
+      {
+         mTransactionController->transportSelector().setPassThroughUntouchedHeaders(passThrough);
+      }
+
+      bool getPassThroughUntouchedHeaders() const
+      {
+         return mTransactionController->transportSelector().getPassThroughUntouchedHeaders();
+      }
+
       /**
          @todo should this be fixed to work with other applicable transports? []
          @brief Used to enable/disable content-length checking on datagram-based 
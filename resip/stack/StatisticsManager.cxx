@@ -2,7 +2,9 @@
 #include "config.h"
 #endif
 
+#include "rutil/DataStream.hxx"
 #include "rutil/Logger.hxx"
+#include "resip/stack/ParseStatistics.hxx"
 #include "resip/stack/StatisticsManager.hxx"
 #include "resip/stack/SipMessage.hxx"
 #include "resip/stack/TransactionController.hxx"
@@ -78,6 +80,16 @@ StatisticsManager::poll()
    {
       mStack.mCongestionManager->logCurrentState();
    }
+
+   if(ParseStatistics::isEnabled())
+   {
+      Data buffer;
+      {
+         DataStream strm(buffer);
+         ParseStatistics::encode(strm);
+      }
+      WarningLog(<< buffer);
+   }
 }
 
 void 
@@ -138,7 +150,7 @@ StatisticsManager::retransmitted(MethodTypes met,
 bool
 StatisticsManager::received(SipMessage* msg)
 {
-   MethodTypes met = msg->header(h_CSeq).method();
+   MethodTypes met = msg->const_header(h_CSeq).method();
 
    if (msg->isRequest())
    {
@@ -3,6 +3,7 @@
 #endif
 
 #include "resip/stack/StatusLine.hxx"
+#include "resip/stack/ParseStatistics.hxx"
 #include "rutil/Data.hxx"
 #include "rutil/DnsUtil.hxx"
 #include "rutil/Logger.hxx"
@@ -149,6 +150,12 @@ StatusLine::errorContext() const
    return statLine;
 }
 
+int
+StatusLine::statisticsType() const
+{
+   return ParseStatistics::StatusLine;
+}
+
 /* ====================================================================
  * The Vovida Software License, Version 1.0 
  * 
@@ -34,6 +34,7 @@ class StatusLine : public StartLine
       virtual StartLine* clone(void* location) const;
       virtual EncodeStream& encodeParsed(EncodeStream& str) const;
       virtual const Data& errorContext() const;
+      virtual int statisticsType() const;
 
    private:
       int mResponseCode;
@@ -7,6 +7,10 @@
 #include "resip/stack/TcpConnection.hxx"
 #include "resip/stack/Tuple.hxx"
 
+#if !defined(WIN32)
+#include <sys/uio.h>
+#endif
+
 using namespace resip;
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::TRANSPORT
@@ -91,6 +95,36 @@ TcpConnection::write( const char* buf, const int count )
    int bytesWritten = ::write(getSocket(), buf, count);
 #endif
 
+   return checkWrite(bytesWritten);
+}
+
+int
+TcpConnection::writeBuffers( const WriteBuffer* buffers, int count )
+{
+#if defined(WIN32)
+   return Connection::writeBuffers(buffers, count);
+#else
+   resip_assert(count > 0 && count <= MaxWriteBuffers);
+   if (count == 1)
+   {
+      return write(buffers[0].data, buffers[0].length);
+   }
+
+   struct iovec iov[MaxWriteBuffers];
+   for (int i = 0; i < count; ++i)
+   {
+      iov[i].iov_base = const_cast<char*>(buffers[i].data);
+      iov[i].iov_len = buffers[i].length;
+   }
+   int bytesWritten = (int)::writev(getSocket(), iov, count);
+
+   return checkWrite(bytesWritten);
+#endif
+}
+
+int
+TcpConnection::checkWrite( int bytesWritten )
+{
    if (bytesWritten == INVALID_SOCKET)
    {
       int e = getErrno();
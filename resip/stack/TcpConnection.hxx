@@ -15,12 +15,15 @@ class TcpConnection : public Connection
       
       int read( char* buf, const int count );
       int write( const char* buf, const int count );
+      int writeBuffers( const WriteBuffer* buffers, int count );
       virtual bool hasDataToRead(); // has data that can be read 
       virtual bool isGood(); // has valid connection
       virtual bool isWritable();
       Data peerName();      
       
    private:
+      int checkWrite( int bytesWritten );
+
       /// No default c'tor
       TcpConnection();
 };
@@ -11,6 +11,7 @@
 #include "resip/stack/TerminateFlow.hxx"
 #include "resip/stack/EnableFlowTimer.hxx"
 #include "resip/stack/InvokeAfterSocketCreationFunc.hxx"
+#include "resip/stack/ParseStatistics.hxx"
 #include "resip/stack/ZeroOutStatistics.hxx"
 #include "resip/stack/PollStatistics.hxx"
 #include "resip/stack/ShutdownMessage.hxx"
@@ -95,6 +96,8 @@ TransactionController::shutdown()
 void
 TransactionController::process(int timeout)
 {
+   ParseStatistics::Scope parseScope("TransactionController");
+
    if (mShuttingDown && 
        //mTimers.empty() && 
        !mStateMacFifoOutBuffer.messageAvailable() && // !dcm! -- see below 
@@ -191,6 +194,22 @@ TransactionController::send(SipMessage* msg)
    mStateMacFifo.add(msg);
 }
 
+void
+TransactionController::sendMultiple(Fifo<TransactionMessage>::Messages& msgs)
+{
+   if(getRejectionBehavior()!=CongestionManager::NORMAL)
+   {
+      // Requests may need to be 503'd - let send() decide for each one
+      while(!msgs.empty())
+      {
+         send(static_cast<SipMessage*>(msgs.front()));
+         msgs.pop_front();
+      }
+      return;
+   }
+   mStateMacFifo.addMultiple(msgs);
+}
+
 
 unsigned int 
 TransactionController::getTuFifoSize() const
@@ -42,6 +42,8 @@ class TransactionController
       bool isTUOverloaded() const;
       
       void send(SipMessage* msg);
+      // Queues all of msgs for the state machine in one go - msgs is left empty
+      void sendMultiple(Fifo<TransactionMessage>::Messages& msgs);
 
       unsigned int getTuFifoSize() const;
       unsigned int sumTransportFifoSizes() const;
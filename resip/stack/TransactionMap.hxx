@@ -43,7 +43,11 @@ class TransactionMap
 
             inline size_t operator()(const Data& branch) const
             {
+#ifdef RESIP_DATA_LEGACY_HASH
                return branch.caseInsensitiveTokenHash();
+#else
+               return branch.fastCaseInsensitiveTokenHash();
+#endif
             }
 
             inline bool operator()(const Data& branch1, const Data& branch2) const
@@ -60,7 +64,11 @@ class TransactionMap
          public:
             inline size_t operator()(const Data& branch) const
             {
+#ifdef RESIP_DATA_LEGACY_HASH
                return branch.caseInsensitiveTokenHash();
+#else
+               return branch.fastCaseInsensitiveTokenHash();
+#endif
             }
       };
 
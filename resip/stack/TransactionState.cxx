@@ -998,7 +998,11 @@ TransactionState::processStateless(TransactionMessage* message)
 void 
 TransactionState::saveOriginalContactAndVia(const SipMessage& sip)
 {
+   // An untouched Contact in pass-through mode won't be filled in by the
+   // TransportSelector, so there is nothing to restore; don't parse it.
    if(sip.exists(h_Contacts) && sip.const_header(h_Contacts).size() == 1 &&
+      !(mController.transportSelector().getPassThroughUntouchedHeaders() &&
+        !sip.const_header(h_Contacts).front().isParsed()) &&
       sip.const_header(h_Contacts).front().isWellFormed())
    {
       mOriginalContact = std::auto_ptr<NameAddr>(new NameAddr(sip.header(h_Contacts).front()));
@@ -2513,6 +2517,7 @@ TransactionState::processReliability(TransportType type)
    {
       case UDP:
       case DCCP:
+      case DTLS:
          if (mIsReliable)
          {
             mIsReliable = false;
@@ -102,6 +102,9 @@ void
 TransactionUser::addDomain(const Data& domain)
 {
    mDomainMatcher->addDomain(domain);
+   // Our domains turn up in most messages we handle - parsed copies of them
+   // can then share one immutable buffer (see Data::intern)
+   Data::intern(domain);
 }
 
 void 
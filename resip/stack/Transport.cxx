@@ -15,6 +15,7 @@
 
 #include "resip/stack/ConnectionTerminated.hxx"
 #include "resip/stack/KeepAlivePong.hxx"
+#include "resip/stack/ParseStatistics.hxx"
 #include "resip/stack/Transport.hxx"
 #include "resip/stack/SipMessage.hxx"
 #include "resip/stack/TransportFailure.hxx"
@@ -374,6 +375,8 @@ Transport::setRemoteSigcompId(SipMessage& msg, Data& remoteSigcompId)
 void
 Transport::stampReceived(SipMessage* message)
 {
+   ParseStatistics::Scope parseScope("Transport");
+
    // set the received= and rport= parameters in the message if necessary !jf!
    if (message->isRequest() && message->exists(h_Vias) && !message->const_header(h_Vias).empty())
    {
@@ -440,12 +443,19 @@ Transport::callSocketFunc(Socket sock)
 }
 
 void
-Transport::pushRxMsgUp(SipMessage* message)
+Transport::pushRxMsgUp(SipMessage* message, const Data& received)
 {
    SipMessageLoggingHandler* handler = getSipMessageLoggingHandler();
    if(handler)
    {
-       handler->inboundMessage(message->getSource(), message->getReceivedTransportTuple(), *message);
+      if(received.empty())
+      {
+         handler->inboundMessage(message->getSource(), message->getReceivedTransportTuple(), *message);
+      }
+      else
+      {
+         handler->inboundEncodedMessage(message->getSource(), message->getReceivedTransportTuple(), *message, received);
+      }
    }
 
    mStateMachineFifo.add(message);
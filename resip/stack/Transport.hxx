@@ -79,11 +79,26 @@ class Transport : public FdSetIOObserver
       public:
           virtual ~SipMessageLoggingHandler(){}
           virtual void outboundMessage(const Tuple &source, const Tuple &destination, const SipMessage &msg) = 0;
+          // Called once msg has been encoded for sending, with the encoded bytes (before any
+          // compression or WebSocket framing).  The default calls outboundMessage; handlers that
+          // need the wire format can override this instead of re-encoding msg.
+          virtual void outboundEncodedMessage(const Tuple &source, const Tuple &destination, const SipMessage &msg, const Data& encoded)
+          {
+             outboundMessage(source, destination, msg);
+          }
           // Note:  retranmissions store already encoded messages, so callback doesn't send SipMessage it sends
           //        the encoded version of the SipMessage instead.  If you need a SipMessage you will need to
           //        re-parse back into a SipMessage in the callback handler.
           virtual void outboundRetransmit(const Tuple &source, const Tuple &destination, const SendData &data) {}
           virtual void inboundMessage(const Tuple& source, const Tuple& destination, const SipMessage &msg) = 0;
+          // Called instead of inboundMessage when the bytes msg was parsed from are available, as they
+          // were received (after any decompression or WebSocket deframing).  Unlike an encoding of msg
+          // they do not carry the received/rport Via parameters stamped by the stack.  The default
+          // calls inboundMessage.
+          virtual void inboundEncodedMessage(const Tuple& source, const Tuple& destination, const SipMessage &msg, const Data& received)
+          {
+             inboundMessage(source, destination, msg);
+          }
       };
 
       void setSipMessageLoggingHandler(SharedPtr<SipMessageLoggingHandler> handler) { mSipMessageLoggingHandler = handler; }
@@ -371,8 +386,9 @@ class Transport : public FdSetIOObserver
          return (UInt32)mStateMachineFifo.getFifo().expectedWaitTimeMilliSec()/1000;
       }
 
-      // called by Connection to deliver a received message
-      virtual void pushRxMsgUp(SipMessage* msg);
+      // called by Connection to deliver a received message; received is the
+      // message as it was read off the wire, or empty if it is not available
+      virtual void pushRxMsgUp(SipMessage* msg, const Data& received = Data::Empty);
 
       // set the receive buffer length (SO_RCVBUF)
       virtual void setRcvBufLen(int buflen) { };	// make pure?
@@ -23,6 +23,7 @@
 #include "resip/stack/TransportFailure.hxx"
 #include "resip/stack/TransportSelector.hxx"
 #include "resip/stack/InternalTransport.hxx"
+#include "resip/stack/ParseStatistics.hxx"
 #include "resip/stack/TcpBaseTransport.hxx"
 #include "resip/stack/TcpTransport.hxx"
 #include "resip/stack/UdpTransport.hxx"
@@ -73,8 +74,8 @@ TransportSelector::TransportSelector(Fifo<TransactionMessage>& fifo, Security* s
    mCompression(compression),
    mSigcompStack (0),
    mPollGrp(0),
-   mAvgBufferSize(1024),
-   mInterruptorHandle(0)
+   mInterruptorHandle(0),
+   mPassThroughUntouchedHeaders(false)
 {
    memset(&mUnspecified.v4Address, 0, sizeof(sockaddr_in));
    mUnspecified.v4Address.sin_family = AF_UNSPEC;
@@ -927,6 +928,7 @@ TransportSelector::TransmitState
 TransportSelector::transmit(SipMessage* msg, Tuple& target, SendData* sendData)
 {
    resip_assert(msg);
+   ParseStatistics::Scope parseScope("TransportSelector");
 
    if(msg->mIsDecorated)
    {
@@ -1173,12 +1175,21 @@ TransportSelector::transmit(SipMessage* msg, Tuple& target, SendData* sendData)
          // we should allow this code to be turned off through configuration.
          // There are plenty of cases where this stuff is not at all necessary.)
          // There is a contact header and it contains exactly one entry
+         //
+         // In pass-through mode, header-field-values that nobody has parsed
+         // are taken to be ones that came off the wire as they are; the
+         // filling-in below is only meant for values the TU synthesized, so
+         // those are left alone, and are sent as the original text.
          if (msg->exists(h_Contacts) && msg->header(h_Contacts).size()==1)
          {
             for (NameAddrs::iterator i=msg->header(h_Contacts).begin(); i != msg->header(h_Contacts).end(); i++)
             {
                const NameAddr& c_contact = *i;
                NameAddr& contact = *i;
+               if (isUntouched(c_contact))
+               {
+                  continue;
+               }
                // No host specified, so use the ip address and port of the
                // transport used. Otherwise, leave it as is.
                if (c_contact.uri().host().empty())
@@ -1227,6 +1238,7 @@ TransportSelector::transmit(SipMessage* msg, Tuple& target, SendData* sendData)
          // Fix the Referred-By header if no host specified.
          // If malformed, leave it alone.
          if (msg->exists(h_ReferredBy)
+               && !isUntouched(msg->const_header(h_ReferredBy))
                && msg->const_header(h_ReferredBy).isWellFormed())
          {
             if (msg->const_header(h_ReferredBy).uri().host().empty())
@@ -1245,6 +1257,7 @@ TransportSelector::transmit(SipMessage* msg, Tuple& target, SendData* sendData)
          // header-field-values.
          if (msg->exists(h_RecordRoutes)
                && !msg->const_header(h_RecordRoutes).empty() 
+               && !isUntouched(msg->const_header(h_RecordRoutes).front())
                && msg->const_header(h_RecordRoutes).front().isWellFormed())
          {
             const NameAddr& c_rr = msg->const_header(h_RecordRoutes).front();
@@ -1305,27 +1318,20 @@ TransportSelector::transmit(SipMessage* msg, Tuple& target, SendData* sendData)
          // Call back anyone who wants to perform outbound decoration
          msg->callOutboundDecorators(source, target,remoteSigcompId);
 
-         Transport::SipMessageLoggingHandler* handler = transport->getSipMessageLoggingHandler();
-         if(handler)
-         {
-            handler->outboundMessage(source, target, *msg);
-         }
-
          std::auto_ptr<SendData> send(new SendData(target,
                                                    resip::Data::Empty,
                                                    msg->getTransactionId(),
                                                    remoteSigcompId));
 
-         send->data.reserve(mAvgBufferSize + mAvgBufferSize/4);
-
-         DataStream str(send->data);
-         msg->encode(str);
-         str.flush();
+         // Computes the exact size first, so the buffer is allocated once;
+         // unmodified headers are copied verbatim from the received message
+         msg->encodeToBuffer(send->data, mEncoder);
 
-         // !bwc! Moving average of message size. (Used to intelligently
-         // predict how much space to reserve in the buffer, to minimize
-         // dynamic resizing.)
-         mAvgBufferSize = (255*mAvgBufferSize + send->data.size()+128)/256;
+         Transport::SipMessageLoggingHandler* handler = transport->getSipMessageLoggingHandler();
+         if(handler)
+         {
+            handler->outboundEncodedMessage(source, target, *msg, send->data);
+         }
 
          resip_assert(!send->data.empty());
          DebugLog (<< "Transmitting to " << target
@@ -1357,6 +1363,12 @@ TransportSelector::transmit(SipMessage* msg, Tuple& target, SendData* sendData)
    }
 }
 
+bool
+TransportSelector::isUntouched(const LazyParser& value) const
+{
+   return mPassThroughUntouchedHeaders && !value.isParsed();
+}
+
 void
 TransportSelector::retransmit(const SendData& data)
 {
@@ -18,6 +18,7 @@
 
 
 #include "resip/stack/SecurityTypes.hxx"
+#include "resip/stack/SipMessageEncoder.hxx"
 class TestTransportSelector;
 
 namespace osc
@@ -32,6 +33,7 @@ class DnsHandler;
 class Message;
 class TransactionMessage;
 class SipMessage;
+class LazyParser;
 class TransactionController;
 class Security;
 class Compression;
@@ -144,6 +146,17 @@ class TransportSelector
          return mDns.getUdpOnlyOnNumeric();
       }
 
+      /// @see SipStack::setPassThroughUntouchedHeaders()
+      void setPassThroughUntouchedHeaders(bool passThrough)
+      {
+         mPassThroughUntouchedHeaders = passThrough;
+      }
+
+      bool getPassThroughUntouchedHeaders() const
+      {
+         return mPassThroughUntouchedHeaders;
+      }
+
       void setCongestionManager(CongestionManager* manager)
       {
          for(TransportKeyMap::iterator i=mTransports.begin();
@@ -203,6 +216,7 @@ class TransportSelector
       Transport* findTlsTransport(const Data& domain,TransportType type,IpVersion ipv) const;
       Tuple determineSourceInterface(SipMessage* msg, const Tuple& dest) const;
       void rebuildAnyPortTransportMaps(void);
+      bool isUntouched(const LazyParser& value) const;
 
       DnsInterface mDns;
       Fifo<TransactionMessage>& mStateMacFifo;
@@ -252,11 +266,15 @@ class TransportSelector
       // epoll support, for sharedprocess transports
       FdPollGrp* mPollGrp;
 
-      int mAvgBufferSize;
+      // reused for every message transmitted
+      SipMessageEncoder mEncoder;
+
       Fifo<Transport> mTransportsToAddRemove;
       std::auto_ptr<SelectInterruptor> mSelectInterruptor;
       FdPollItemHandle mInterruptorHandle;
 
+      bool mPassThroughUntouchedHeaders;
+
       friend class TestTransportSelector;
       friend class SipStack; // for debug only
 };
@@ -27,6 +27,9 @@
 using namespace std;
 using namespace resip;
 
+// Receive buffers kept in the kernel when the poll group receives for us
+static const unsigned GroupIOBuffers = 32;
+
 UdpTransport::UdpTransport(Fifo<TransactionMessage>& fifo,
                            int portNum,
                            IpVersion version,
@@ -39,7 +42,8 @@ UdpTransport::UdpTransport(Fifo<TransactionMessage>& fifo,
      mSigcompStack(0),
      mRxBuffer(0),
      mExternalUnknownDatagramHandler(0),
-     mInWritable(false)
+     mInWritable(false),
+     mGroupIO(false)
 {
    mPollEventCnt = 0;
    mTxTryCnt = mTxMsgCnt = mTxFailCnt = 0;
@@ -101,11 +105,23 @@ UdpTransport::setPollGrp(FdPollGrp *grp)
    {
       mPollGrp->delPollItem(mPollItemHandle);
       mPollItemHandle=0;
+      mGroupIO = false;
    }
 
    if(mFd!=INVALID_SOCKET && grp)
    {
-      mPollItemHandle = grp->addPollItem(mFd, FPEM_Read, this);
+      // Only "uring" can receive and send for us; the others tell us
+      // when the socket is readable or writable.
+      if (allowGroupIO())
+      {
+         mPollItemHandle = grp->addDatagramItem(mFd, this, MaxBufferSize,
+                                                GroupIOBuffers);
+         mGroupIO = (mPollItemHandle != 0);
+      }
+      if (!mGroupIO)
+      {
+         mPollItemHandle = grp->addPollItem(mFd, FPEM_Read, this);
+      }
       // above released by InternalTransport destructor
       // ?bwc? Is this really a good idea? If the InternalTransport d'tor is
       // freeing this, shouldn't InternalTransport::setPollGrp() handle 
@@ -115,6 +131,13 @@ UdpTransport::setPollGrp(FdPollGrp *grp)
    InternalTransport::setPollGrp(grp);
 }
 
+bool
+UdpTransport::allowGroupIO() const
+{
+   // A compressed message is sent from a temporary buffer
+   return mSigcompStack == 0;
+}
+
 
 /**
  * Called after a message is added. Could try writing it now.
@@ -122,15 +145,17 @@ UdpTransport::setPollGrp(FdPollGrp *grp)
 void
 UdpTransport::process() 
 {
-   if ( (mTransportFlags & RESIP_TRANSPORT_FLAG_TXNOW)!= 0 )
+   if ( mGroupIO || (mTransportFlags & RESIP_TRANSPORT_FLAG_TXNOW)!= 0 )
    {
+       // With mGroupIO this only queues the sends in the poll group,
+       // which submits them all together on its next wait.
        processTxAll();
        // FALLTHRU to code below in case queue not-empty
        // shouldn't ever happen (with current code)
        // but in future we may throttle transmits
    }
 
-   if ( mPollGrp )
+   if ( mPollGrp && !mGroupIO )
    {
        updateEvents();
    }
@@ -176,6 +201,48 @@ UdpTransport::processPollEvent(FdPollEventMask mask)
    mStateMachineFifo.flush();
 }
 
+char*
+UdpTransport::allocateDatagramBuffer(unsigned size)
+{
+   return MsgHeaderScanner::allocateBuffer(size);
+}
+
+bool
+UdpTransport::processDatagram(char* buffer, int len,
+                              const sockaddr& from, socklen_t fromLen)
+{
+   // same limit as processRxRecv()
+   if (len+1 >= MaxBufferSize)
+   {
+      InfoLog(<<"Datagram exceeded max length "<<MaxBufferSize);
+      return false;
+   }
+   Tuple sender(mTuple);
+   memcpy(&sender.getMutableSockaddr(), &from, fromLen);
+   ++mRxMsgCnt;
+   bool consumed = processRxParse(buffer, len, sender);
+   mStateMachineFifo.flush();
+   return consumed;
+}
+
+void
+UdpTransport::processDatagramSent(void* cookie, int res)
+{
+   std::auto_ptr<SendData> sendData((SendData*)cookie);
+   if ( res < 0 )
+   {
+      error(-res);
+      InfoLog (<< "Failed (" << -res << ") sending to " << sendData->destination);
+      fail(sendData->transactionId);
+      ++mTxFailCnt;
+   }
+   else if ( res != (int)sendData->data.size() )
+   {
+      ErrLog (<< "UDPTransport - send buffer full" );
+      fail(sendData->transactionId);
+   }
+}
+
 /**
    If we return true, the TransactionController will set the timeout
    to zero so that process() is called immediately. We don't want this;
@@ -230,7 +297,7 @@ UdpTransport::processTxAll()
    {
       processTxOne(msg);
       // With UDP we don't need to worry about write blocking (I hope)
-      if ( (mTransportFlags & RESIP_TRANSPORT_FLAG_TXALL)==0 )
+      if ( (mTransportFlags & RESIP_TRANSPORT_FLAG_TXALL)==0 && !mGroupIO )
       {
          break;
       }
@@ -253,6 +320,17 @@ UdpTransport::processTxOne(SendData *data)
    resip_assert( sendData->destination.getPort() != 0 );
 
    const sockaddr& addr = sendData->destination.getSockaddr();
+
+   if ( mGroupIO )
+   {
+      // sent from sendData, which comes back to processDatagramSent()
+      SendData* queued = sendData.release();
+      mPollGrp->sendDatagram(mPollItemHandle,
+                             queued->data.data(), (unsigned)queued->data.size(),
+                             addr, queued->destination.length(), queued);
+      return;
+   }
+
    int expected;
    int count;
 
@@ -583,7 +661,7 @@ UdpTransport::processRxParse(char *buffer, int len, Tuple& sender)
 
    // Tell the SipMessage about this datagram buffer.
    // WATCHOUT: below here buffer is consumed by message
-   message->addBuffer(buffer);
+   message->addBuffer(buffer, len);
 
    mMsgHeaderScanner.prepareForMessage(message);
 
@@ -701,7 +779,8 @@ UdpTransport::processRxParse(char *buffer, int len, Tuple& sender)
    }
 #endif
 
-   pushRxMsgUp(message);
+   // buffer is still the datagram as received; only the parsed Via was stamped
+   pushRxMsgUp(message, Data(Data::Share, buffer, len));
    ++mRxTransactionCnt;
    return origBufferConsumed;
 }
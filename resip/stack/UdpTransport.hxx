@@ -37,7 +37,8 @@ public:
    internal), DtlsTransport as a base class and in
    SipStack::addTransport(...).  Not expected to be used in an API.
 */
-class UdpTransport : public InternalTransport, public FdPollItemIf
+class UdpTransport : public InternalTransport, public FdPollItemIf,
+                     public FdPollDatagramIf
 {
 public:
    RESIP_HeapCount(UdpTransport);
@@ -80,6 +81,12 @@ public:
    // virtual Socket getPollSocket() const;
    virtual void processPollEvent(FdPollEventMask mask);
 
+   // FdPollDatagramIf
+   virtual char* allocateDatagramBuffer(unsigned size);
+   virtual bool processDatagram(char* buffer, int len,
+                                const sockaddr& from, socklen_t fromLen);
+   virtual void processDatagramSent(void* cookie, int res);
+
    static const int MaxBufferSize = 8192;
 
    // STUN client functionality
@@ -97,6 +104,9 @@ protected:
    void processTxAll();
    void processTxOne(SendData *data);
    void updateEvents();
+   /// Whether the poll group may receive and send for us (see
+   /// FdPollGrp::addDatagramItem()).
+   virtual bool allowGroupIO() const;
 
    osc::Stack *mSigcompStack;
 
@@ -118,6 +128,7 @@ private:
    ExternalUnknownDatagramHandler* mExternalUnknownDatagramHandler;
    bool mInWritable;
    bool mInActiveWrite;
+   bool mGroupIO;       // mPollGrp receives and sends for us
 };
 
 }
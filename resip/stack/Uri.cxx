@@ -1119,6 +1119,9 @@ Uri::parse(ParseBuffer& pb)
    {
       pb.skipToOneOf(hostDelimiter);
       pb.data(mHost, start);
+      // Our own domains etc. may be interned, so copies of this Uri can 
+      // share the host rather than allocating
+      mHost.useInterned();
    }
 
    if (!pb.eof() && *pb.position() == ':')
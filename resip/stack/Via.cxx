@@ -209,6 +209,7 @@ Via::parse(ParseBuffer& pb)
       static std::bitset<256> delimiter=Data::toBitset(";: \t\r\n");
       pb.skipToOneOf(delimiter);
       pb.data(mSentHost, startMark);
+      mSentHost.useInterned();
    }
 
    pb.skipToOneOf(";:");
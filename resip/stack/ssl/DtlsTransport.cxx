@@ -28,6 +28,10 @@
 #include "rutil/Logger.hxx"
 #endif
 
+#ifndef RESIP_TIMER_HXX
+#include "rutil/Timer.hxx"
+#endif
+
 #ifndef RESIP_SIPMESSAGE_HXX
 #include "resip/stack/SipMessage.hxx"
 #endif
@@ -40,10 +44,6 @@
 #include "resip/stack/ssl/Security.hxx"
 #endif
 
-#ifndef RESIP_DTLSMESSAGE_HXX
-#include "resip/stack/DtlsMessage.hxx"
-#endif
-
 #ifndef RESIP_DTLSTRANSPORT_HXX
 #include "resip/stack/ssl/DtlsTransport.hxx"
 #endif
@@ -70,23 +70,6 @@
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::TRANSPORT
 
-#if (OPENSSL_VERSION_NUMBER < 0x10100000L) || defined(LIBRESSL_VERSION_NUMBER)
-
-static void SSL_set0_rbio(SSL *s, BIO *rbio)
-{
-    BIO_free_all(s->rbio);
-    s->rbio = rbio;
-}
-
-#if !defined(LIBRESSL_VERSION_NUMBER)
-static void BIO_up_ref(BIO *a)
-{
-    CRYPTO_add(&a->references, 1, CRYPTO_LOCK_BIO);
-}
-#endif
-
-#endif
-
 using namespace std;
 using namespace resip;
 
@@ -105,9 +88,12 @@ DtlsTransport::DtlsTransport(Fifo<TransactionMessage>& fifo,
                              const Data& privateKeyFilename,
                              const Data& privateKeyPassPhrase)
  : UdpTransport( fifo, portNum, version, StunDisabled, interfaceObj, socketFunc, compression ),
-   mTimer( mHandshakePending ),
    mSecurity( &security ),
-   mDomain(sipDomain)
+   mDomain(sipDomain),
+   mIdleTimeoutMs( DtlsIdleTimeoutMs ),
+   mNextTimerCheck( 0 ),
+   mNextIdleCheck( 0 ),
+   mWriteEnabled( false )
 {
    // Note on AfterSocketCreateFuncPtr:  because this class uses UdpTransport the bind operation 
    //   is called in the UdpTransport constructor and the transport type passed to AfterSocketCreationFuncPtr
@@ -123,16 +109,18 @@ DtlsTransport::DtlsTransport(Fifo<TransactionMessage>& fifo,
 
    mTuple.setType( DTLS );
 
+#if (OPENSSL_VERSION_NUMBER >= 0x10002000L)
+   // Negotiate the highest version both sides support - recent OpenSSL
+   // refuses DTLS 1.0 at its default security level
+   mClientCtx = mSecurity->createDomainCtx(DTLS_client_method(), Data::Empty, certificateFilename, privateKeyFilename, privateKeyPassPhrase) ;
+   mServerCtx = mSecurity->createDomainCtx(DTLS_server_method(), sipDomain, certificateFilename, privateKeyFilename, privateKeyPassPhrase) ;
+#else
    mClientCtx = mSecurity->createDomainCtx(DTLSv1_client_method(), Data::Empty, certificateFilename, privateKeyFilename, privateKeyPassPhrase) ;
    mServerCtx = mSecurity->createDomainCtx(DTLSv1_server_method(), sipDomain, certificateFilename, privateKeyFilename, privateKeyPassPhrase) ;
+#endif
    resip_assert( mClientCtx ) ;
    resip_assert( mServerCtx ) ;
 
-   mDummyBio = BIO_new( BIO_s_mem() ) ;
-   resip_assert( mDummyBio ) ;
-
-   mSendData = NULL ;
-
    /* DTLS: partial reads end up discarding unread UDP bytes :-(
     * Setting read ahead solves this problem.
     * Source of this comment is: apps/s_client.c from OpenSSL source
@@ -140,372 +128,298 @@ DtlsTransport::DtlsTransport(Fifo<TransactionMessage>& fifo,
    SSL_CTX_set_read_ahead(mClientCtx, 1);
    SSL_CTX_set_read_ahead(mServerCtx, 1);
 
-   /* trying to read from this BIO always returns retry */
-   BIO_set_mem_eof_return( mDummyBio, -1 ) ;
+   mDatagram = new char[ UdpTransport::MaxBufferSize ] ;
+   mPlaintext = MsgHeaderScanner::allocateBuffer( UdpTransport::MaxBufferSize ) ;
 }
 
 DtlsTransport::~DtlsTransport()
 {
-   DebugLog (<< "Shutting down " << mTuple);
+   DebugLog (<< "Shutting down " << mTuple << " with " << mDtlsConnections.size() << " DTLS sessions");
 
-   while(mDtlsConnections.begin() != mDtlsConnections.end())
+   for(DtlsConnectionMap::iterator it = mDtlsConnections.begin(); it != mDtlsConnections.end(); it++)
    {
-       _cleanupConnectionState(mDtlsConnections.begin()->second, mDtlsConnections.begin()->first);
+      DtlsConnection* conn = it->second;
+      for(std::deque<SendData*>::iterator sit = conn->mPendingSends.begin(); sit != conn->mPendingSends.end(); sit++)
+      {
+         delete *sit;
+      }
+      SSL_free(conn->mSsl);
+      delete conn;
    }
+   mDtlsConnections.clear();
    SSL_CTX_free(mClientCtx);mClientCtx=0;
    SSL_CTX_free(mServerCtx);mServerCtx=0;
 
-   BIO_free( mDummyBio) ;
+   delete [] mDatagram;
+   delete [] mPlaintext;
 }
 
-void
-DtlsTransport::_read( FdSet& fdset )
+DtlsTransport::DtlsConnection*
+DtlsTransport::createConnection( const Tuple& peer, bool server )
 {
-   //should this buffer be allocated on the stack and then copied out, as it
-   //needs to be deleted every time EWOULDBLOCK is encountered
-   // .dlb. can we determine the size of the buffer before we allocate?
-   // something about MSG_PEEK|MSG_TRUNC in Stevens..
-   // .dlb. RFC3261 18.1.1 MUST accept 65K datagrams. would have to attempt to
-   // adjust the UDP buffer as well...
-   unsigned int bufferLen = UdpTransport::MaxBufferSize + 5 ;
-   char* buffer = new char[ bufferLen ] ;
-   unsigned char *pt = new unsigned char[ bufferLen ] ;
-
-   SSL *ssl ;
-   BIO *rbio ;
-   BIO *wbio ;
-
-   // !jf! how do we tell if it discarded bytes
-   // !ah! we use the len-1 trick :-(
-   Tuple tuple(mTuple) ;
-   socklen_t slen = tuple.length() ;
-   int len = recvfrom( mFd,
-                       buffer,
-                       UdpTransport::MaxBufferSize,
-                       0 /*flags */,
-                       &tuple.getMutableSockaddr(),
-                       &slen ) ;
-   if ( len == SOCKET_ERROR )
-   {
-      int err = getErrno() ;
-      if ( err != EAGAIN && err != EWOULDBLOCK ) // Treat EGAIN and EWOULDBLOCK as the same: http://stackoverflow.com/questions/7003234/which-systems-define-eagain-and-ewouldblock-as-different-values
-      {
-         error( err ) ;
-      }
-   }
+   SSL* ssl = SSL_new( server ? mServerCtx : mClientCtx ) ;
+   resip_assert( ssl ) ;
 
-   if (len == 0 || len == SOCKET_ERROR)
+   if ( server )
    {
-      delete [] buffer ;
-      delete [] pt;
-      return ;
+      // clear SSL_VERIFY_PEER|SSL_VERIFY_CLIENT_ONCE set in SSL_CTX if we are a server
+      SSL_set_verify(ssl, 0, 0);
+      SSL_set_accept_state( ssl ) ;
    }
-
-   if ( len + 1 >= UdpTransport::MaxBufferSize )
+   else
    {
-      InfoLog (<<"Datagram exceeded max length "<<UdpTransport::MaxBufferSize ) ;
-      delete [] buffer ; 
-      delete [] pt;
-      return ;
+      SSL_set_connect_state( ssl ) ;
    }
 
-   //DebugLog ( << "UDP Rcv : " << len << " b" );
-   //DebugLog ( << Data(buffer, len).escaped().c_str());
+   /* Received datagrams are fed to the session one at a time through a
+    * memory BIO, records are sent straight to the peer on our socket.
+    * Reading an empty memory BIO must ask for a retry, not report EOF.
+    */
+   BIO* rbio = BIO_new( BIO_s_mem() ) ;
+   resip_assert( rbio ) ;
+   BIO_set_mem_eof_return( rbio, -1 ) ;
 
-   /* begin SSL stuff */
-   struct sockaddr peer = tuple.getMutableSockaddr() ;
+   BIO* wbio = BIO_new_dgram( (int)mFd, BIO_NOCLOSE ) ;
+   resip_assert( wbio ) ;
+   BIO_dgram_set_peer( wbio, const_cast<sockaddr*>(&peer.getSockaddr()) ) ;
 
-   ssl = mDtlsConnections[ *((struct sockaddr_in *)&peer) ] ;
+   SSL_set_bio( ssl, rbio, wbio ) ;
 
-   /*
-    * If we don't have a binding for this peer,
-    * then we're a server.
-    */
-   if ( ssl == NULL )
-   {
-      ssl = SSL_new( mServerCtx ) ;
-      resip_assert( ssl ) ;
+   InfoLog( << "DTLS handshake starting (" << (server ? "server" : "client") << " mode) with " << peer );
 
-      // clear SSL_VERIFY_PEER|SSL_VERIFY_CLIENT_ONCE set in SSL_CTX if we are a server
-      SSL_set_verify(ssl, 0, 0);
-
-      InfoLog( << "DTLS handshake starting (Server mode)" );
+   DtlsConnection* conn = new DtlsConnection( ssl, Timer::getTimeMs() ) ;
+   mDtlsConnections[ peer ] = conn ;
+   mHandshakes.insert( peer ) ;
+   return conn ;
+}
 
-      SSL_set_accept_state( ssl ) ;
+void
+DtlsTransport::cleanupConnection( DtlsConnectionMap::iterator it )
+{
+   const Tuple peer( it->first ) ;
+   DtlsConnection* conn = it->second ;
+   mDtlsConnections.erase( it ) ;
+   mHandshakes.erase( peer ) ;
+   mBlockedPeers.erase( peer ) ;
 
-      wbio = BIO_new_dgram( (int)mFd, BIO_NOCLOSE ) ;
-      resip_assert( wbio ) ;
+   while ( !conn->mPendingSends.empty() )
+   {
+      SendData* sendData = conn->mPendingSends.front() ;
+      conn->mPendingSends.pop_front() ;
+      fail( sendData->transactionId ) ;
+      delete sendData ;
+   }
 
-      BIO_dgram_set_peer( wbio, &peer ) ;
+   if ( SSL_is_init_finished( conn->mSsl ) )
+   {
+      SSL_shutdown( conn->mSsl ) ;  // sends close_notify
+   }
+   SSL_free( conn->mSsl ) ;  // also frees both BIOs
+   delete conn ;
+   ERR_clear_error() ;
+}
 
-      SSL_set_bio( ssl, NULL, wbio ) ;
+void
+DtlsTransport::logSslError( const char* operation, int err, const Tuple& peer )
+{
+   char errorString[1024];
+   ERR_error_string_n(ERR_get_error(), errorString, sizeof(errorString));
+   DebugLog( << "Got DTLS " << operation << " condition " << err << " on " << peer
+             << " error = " << errorString );
+   ERR_clear_error();
+}
 
-      /* remember this connection */
-      mDtlsConnections[ *((struct sockaddr_in *)&peer) ] = ssl ;
+void
+DtlsTransport::processRxAll()
+{
+   ++mRxTryCnt;
+   for (;;)
+   {
+      // !jf! how do we tell if it discarded bytes
+      // !ah! we use the len-1 trick :-(
+      Tuple sender(mTuple) ;
+      socklen_t slen = sender.length() ;
+      int len = recvfrom( mFd,
+                          mDatagram,
+                          UdpTransport::MaxBufferSize,
+                          0 /*flags */,
+                          &sender.getMutableSockaddr(),
+                          &slen ) ;
+      if ( len == SOCKET_ERROR )
+      {
+         int err = getErrno() ;
+         if ( err != EAGAIN && err != EWOULDBLOCK ) // Treat EGAIN and EWOULDBLOCK as the same: http://stackoverflow.com/questions/7003234/which-systems-define-eagain-and-ewouldblock-as-different-values
+         {
+            error( err ) ;
+         }
+         break ;
+      }
+      if ( len + 1 >= UdpTransport::MaxBufferSize )
+      {
+         InfoLog (<<"Datagram exceeded max length "<<UdpTransport::MaxBufferSize ) ;
+         continue ;
+      }
+      if ( len > 0 )
+      {
+         processRxOne( sender, len ) ;
+      }
+      if ( (mTransportFlags & RESIP_TRANSPORT_FLAG_RXALL) == 0 )
+      {
+         break ;
+      }
    }
+}
 
-   rbio = BIO_new_mem_buf( buffer, len ) ;
-   BIO_set_mem_eof_return( rbio, -1 ) ;
+void
+DtlsTransport::processRxOne( const Tuple& sender, int len )
+{
+   DtlsConnectionMap::iterator it = mDtlsConnections.find( sender ) ;
+
+   /*
+    * If we don't have a binding for this peer,
+    * then we're a server.
+    */
+   DtlsConnection* conn = ( it == mDtlsConnections.end() ? createConnection( sender, true ) : it->second ) ;
+   SSL* ssl = conn->mSsl ;
+   conn->mLastActivity = Timer::getTimeMs() ;
 
-   SSL_set0_rbio( ssl, rbio );
+   BIO* rbio = SSL_get_rbio( ssl ) ;
+   BIO_write( rbio, mDatagram, len ) ;
 
-   len = SSL_read( ssl, pt, UdpTransport::MaxBufferSize ) ;
+   ERR_clear_error() ;
+   len = SSL_read( ssl, mPlaintext, UdpTransport::MaxBufferSize ) ;
    int err = SSL_get_error( ssl, len ) ;
 
-   /* done with the rbio */
-   SSL_set0_rbio( ssl, mDummyBio );
-   delete [] buffer ;
-   buffer = 0 ;
+   // Whatever the session did not consume belonged to this datagram only
+   (void)BIO_reset( rbio ) ;
 
-   if ( len <= 0 )
+   if ( SSL_is_init_finished( ssl ) && mHandshakes.erase( sender ) )
    {
-      char errorString[1024];
+      InfoLog( << "DTLS handshake completed with " << sender << ", sending "
+               << conn->mPendingSends.size() << " queued messages" );
+      flushPendingSends( sender, *conn ) ;
+   }
 
+   if ( len <= 0 )
+   {
       switch( err )
       {
          case SSL_ERROR_NONE:
-            break ;
-         case SSL_ERROR_SSL:
-            {
-               ERR_error_string_n(ERR_get_error(), errorString, sizeof(errorString));
-               DebugLog( << "Got DTLS read condition SSL_ERROR_SSL on"
-                         << " addr = " << inet_ntoa(((struct sockaddr_in *)&peer)->sin_addr)
-                         << " port = " << ntohs(((struct sockaddr_in *)&peer)->sin_port)
-                         << " error = " << errorString );
-            }
-            break ;
          case SSL_ERROR_WANT_READ:
-            break ;
          case SSL_ERROR_WANT_WRITE:
             break ;
-         case SSL_ERROR_SYSCALL:
-            {
-               ERR_error_string_n(ERR_get_error(), errorString, sizeof(errorString));
-               DebugLog( << "Got DTLS read condition SSL_ERROR_SYSCALL on"
-                         << " addr = " << inet_ntoa(((struct sockaddr_in *)&peer)->sin_addr)
-                         << " port = " << ntohs(((struct sockaddr_in *)&peer)->sin_port)
-                         << " error = " << errorString );
-            }
-            break ;
-            /* connection closed */
-         case SSL_ERROR_ZERO_RETURN:
-            {
-               ERR_error_string_n(ERR_get_error(), errorString, sizeof(errorString));
-               DebugLog( << "Got DTLS read condition SSL_ERROR_ZERO_RETURN on"
-                         << " addr = " << inet_ntoa(((struct sockaddr_in *)&peer)->sin_addr)
-                         << " port = " << ntohs(((struct sockaddr_in *)&peer)->sin_port)
-                         << " error = " << errorString );
-
-               _cleanupConnectionState( ssl, *((struct sockaddr_in *)&peer) ) ;
-            }
-            break ;
-         case SSL_ERROR_WANT_CONNECT:
-            break ;
-         case SSL_ERROR_WANT_ACCEPT:
+         case SSL_ERROR_ZERO_RETURN:  /* connection closed */
+         case SSL_ERROR_SSL:          /* handshake or record failure - the peer can start over */
+            logSslError( "read", err, sender ) ;
+            cleanupConnection( mDtlsConnections.find( sender ) ) ;
             break ;
          default:
+            logSslError( "read", err, sender ) ;
             break ;
       }
+      return ;
    }
 
-   if ( len <= 0 )
-   {
-       return ;
-   }
-
-   if ( SSL_in_init( ssl ) )
+   ++mRxMsgCnt;
+   Tuple source( sender ) ;
+   if ( processRxParse( mPlaintext, len, source ) )
    {
-      mTimer.add( ssl, DtlsReceiveTimeout ) ;
+      // The SipMessage owns the buffer now
+      mPlaintext = MsgHeaderScanner::allocateBuffer( UdpTransport::MaxBufferSize ) ;
    }
+}
 
-#ifdef USE_SIGCOMP
-   osc::StateChanges *sc = 0;
-#endif
+void
+DtlsTransport::processTxAll()
+{
+   ++mTxTryCnt;
 
-   if ((pt[0] & 0xf8) == 0xf8)
+   // Sends held back by a full socket buffer go out first, in order
+   for ( TupleSet::iterator it = mBlockedPeers.begin(); it != mBlockedPeers.end(); )
    {
-      if(!mCompression.isEnabled())
+      const Tuple peer( *it++ ) ;  // flushPendingSends erases the current entry
+      DtlsConnectionMap::iterator cit = mDtlsConnections.find( peer ) ;
+      resip_assert( cit != mDtlsConnections.end() ) ;
+      if ( !flushPendingSends( peer, *cit->second ) )
       {
-        InfoLog(<< "Discarding unexpected SigComp message");
-        delete [] pt;
-        return;
+         return ;
       }
-#ifdef USE_SIGCOMP
-      unsigned char *newPt = new unsigned char[ bufferLen ] ;
-      size_t uncompressedLength =
-        mSigcompStack->uncompressMessage(pt, len,
-                                         newPt, UdpTransport::MaxBufferSize,
-                                         sc);
-
-      DebugLog (<< "Unompressed message from "
-                << len << " bytes to "
-                << uncompressedLength << " bytes");
-
-      osc::SigcompMessage *nack = mSigcompStack->getNack();
-
-      if (nack)
-      {
-        mTxFifo.add(new SendData(tuple,
-                                 Data(nack->getDatagramMessage(),
-                                      nack->getDatagramLength()),
-                                 Data::Empty,
-                                 Data::Empty,
-                                 true)
-                   );
-        delete nack;
-      }
-
-      delete[] buffer;
-      buffer = newBuffer;
-      len = uncompressedLength;
-#endif
    }
 
-   SipMessage* message = new SipMessage(&mTuple);
-
-   // set the received from information into the received= parameter in the
-   // via
-
-   // It is presumed that UDP Datagrams are arriving atomically and that
-   // each one is a unique SIP message
-
-   // Save all the info where this message came from
-   message->setSource( tuple ) ;
-   //DebugLog (<< "Received from: " << tuple);
-
-   // Tell the SipMessage about this datagram buffer.
-   message->addBuffer( (char *)pt ) ;
-
-   mMsgHeaderScanner.prepareForMessage( message ) ;
+   SendData *sendData ;
+   while ( mBlockedPeers.empty() &&
+           (sendData = mTxFifoOutBuffer.getNext(RESIP_FIFO_NOWAIT)) != NULL )
+   {
+      processTxOne( sendData ) ;
+   }
+}
 
-   char *unprocessedCharPtr ;
-   if (mMsgHeaderScanner.scanChunk( (char *)pt,
-                                    len,
-                                    &unprocessedCharPtr ) !=
-       MsgHeaderScanner::scrEnd)
+void
+DtlsTransport::processTxOne( SendData* sendData )
+{
+   resip_assert( sendData ) ;
+   if ( sendData->command != SendData::NoCommand )
    {
-      DebugLog( << "Scanner rejecting datagram as unparsable / fragmented from "
-                << tuple ) ;
-      DebugLog( << Data( pt, len ) ) ;
-      delete message ;
-      message = 0 ;
+      // We don't handle any special SendData commands in the DTLS transport yet.
+      delete sendData ;
       return ;
    }
+   ++mTxMsgCnt;
+   resip_assert( sendData->destination.getPort() != 0 );
 
-   // no pp error
-   int used = int(unprocessedCharPtr - (char *)pt);
+   const Tuple& peer = sendData->destination ;
+   DtlsConnectionMap::iterator it = mDtlsConnections.find( peer ) ;
+   DtlsConnection* conn ;
 
-   if ( used < len )
+   /* If we don't have a binding, then we're a client */
+   if ( it == mDtlsConnections.end() )
    {
-      // body is present .. add it up.
-      // NB. The Sip Message uses an overlay (again)
-      // for the body. It ALSO expects that the body
-      // will be contiguous (of course).
-      // it doesn't need a new buffer in UDP b/c there
-      // will only be one datagram per buffer. (1:1 strict)
-
-      message->setBody( (char *)pt + used, len - used ) ;
-      //DebugLog(<<"added " << len-used << " byte body");
+      conn = createConnection( peer, false ) ;
+      // Sends the ClientHello; the rest of the handshake is driven by processRxOne
+      ERR_clear_error() ;
+      SSL_do_handshake( conn->mSsl ) ;
    }
-
-   if ( ! basicCheck( *message ) )
+   else
    {
-      delete message ; // cannot use it, so, punt on it...
-      // basicCheck queued any response required
-      message = 0 ;
-      return ;
+      conn = it->second ;
    }
 
-   stampReceived( message) ;
-
-#ifdef USE_SIGCOMP
-      if (mCompression.isEnabled() && sc)
+   /*
+    * Until the handshake completes, and behind anything already waiting,
+    * messages queue on the peer so other peers are not held up.
+    */
+   if ( !conn->mPendingSends.empty() || mHandshakes.count( peer ) )
+   {
+      if ( conn->mPendingSends.size() >= MaxPendingSends )
       {
-        const Via &via = message->header(h_Vias).front();
-        if (message->isRequest())
-        {
-          // For requests, the compartment ID is read out of the
-          // top via header field; if not present, we use the
-          // TCP connection for identification purposes.
-          if (via.exists(p_sigcompId))
-          {
-            Data compId = via.param(p_sigcompId);
-            mSigcompStack->provideCompartmentId(
-                             sc, compId.data(), compId.size());
-          }
-          else
-          {
-            mSigcompStack->provideCompartmentId(sc, this, sizeof(this));
-          }
-        }
-        else
-        {
-          // For responses, the compartment ID is supposed to be
-          // the same as the compartment ID of the request. We
-          // *could* dig down into the transaction layer to try to
-          // figure this out, but that's a royal pain, and a rather
-          // severe layer violation. In practice, we're going to ferret
-          // the ID out of the the Via header field, which is where we
-          // squirreled it away when we sent this request in the first place.
-          Data compId = via.param(p_branch).getSigcompCompartment();
-          mSigcompStack->provideCompartmentId(sc, compId.data(), compId.size());
-        }
-
+         InfoLog( << "Too many messages waiting for DTLS handshake with " << peer ) ;
+         fail( sendData->transactionId ) ;
+         ++mTxFailCnt;
+         delete sendData ;
+         return ;
       }
-#endif
-
-   pushRxMsgUp(message);
-}
-
-void DtlsTransport::_write( FdSet& fdset )
-{
-   SSL *ssl ;
-   BIO *wBio ;
-   int retry = 0 ;
-
-   SendData *sendData ;
-   if ( mSendData != NULL )
-       sendData = mSendData ;
-   else
-       sendData = mTxFifo.getNext() ;
-
-   //DebugLog (<< "Sent: " <<  sendData->data);
-   //DebugLog (<< "Sending message on udp.");
-
-   resip_assert( &(*sendData) );
-   resip_assert( sendData->destination.getPort() != 0 );
-
-   sockaddr peer = sendData->destination.getSockaddr();
-
-   ssl = mDtlsConnections[ *((struct sockaddr_in *)&peer) ] ;
+      conn->mPendingSends.push_back( sendData ) ;
+      return ;
+   }
 
-   /* If we don't have a binding, then we're a client */
-   if ( ssl == NULL )
+   if ( !writeOne( *conn, sendData ) )
    {
-      ssl = SSL_new( mClientCtx ) ;
-      resip_assert( ssl ) ;
-
-
-      InfoLog( << "DTLS handshake starting (client mode)" );
-
-      SSL_set_connect_state( ssl ) ;
-
-      wBio = BIO_new_dgram( (int)mFd, BIO_NOCLOSE ) ;
-      resip_assert( wBio ) ;
-
-      BIO_dgram_set_peer( wBio, &peer) ;
-
-      /* the real rbio will be set by _read */
-      SSL_set_bio( ssl, mDummyBio, wBio ) ;
-
-      /* we should be ready to take this out if the
-       * connection fails later */
-      mDtlsConnections [ *((struct sockaddr_in *)&peer) ] = ssl ;
+      conn->mPendingSends.push_front( sendData ) ;
+      mBlockedPeers.insert( peer ) ;
    }
+}
 
+/*
+ * Returns false, keeping sendData, if the socket buffer is full and the
+ * write must be repeated once the socket is writable.
+ */
+bool
+DtlsTransport::writeOne( DtlsConnection& conn, SendData* sendData )
+{
    int expected;
    int count;
 
+   ERR_clear_error() ;
 #ifdef USE_SIGCOMP
    // If message needs to be compressed, compress it here.
    if (mSigcompStack &&
@@ -523,7 +437,7 @@ void DtlsTransport::_write( FdSet& fdset )
 
        expected = sm->getDatagramLength();
 
-       count = SSL_Write(ssl,
+       count = SSL_write(conn.mSsl,
                          sm->getDatagramMessage(),
                          sm->getDatagramLength());
        delete sm;
@@ -533,146 +447,166 @@ void DtlsTransport::_write( FdSet& fdset )
    {
       expected = (int)sendData->data.size();
 
-      count = SSL_write(ssl, sendData->data.data(),
+      count = SSL_write(conn.mSsl, sendData->data.data(),
                         (int)sendData->data.size());
    }
 
-   /*
-    * all reads go through _read, so the most likely result during a handshake
-    * will be SSL_ERROR_WANT_READ
-    */
+   if ( count == expected )
+   {
+      conn.mLastActivity = Timer::getTimeMs() ;
+      delete sendData ;
+      return true ;
+   }
 
-   if ( count <= 0 )
+   int err = SSL_get_error( conn.mSsl, count ) ;
+   if ( err == SSL_ERROR_WANT_WRITE )
    {
-      /* cache unqueued data */
-      mSendData = sendData ;
+      return false ;
+   }
 
-      int err = SSL_get_error( ssl, count ) ;
+   if ( err == SSL_ERROR_SYSCALL )
+   {
+      error( getErrno() ) ;
+   }
+   logSslError( "write", err, sendData->destination ) ;
 
-      char errorString[1024];
+   // DTLS is unreliable, so the transaction layer retransmits anyway
+   fail( sendData->transactionId ) ;
+   ++mTxFailCnt;
+   delete sendData ;
+   return true ;
+}
 
-      switch( err )
+bool
+DtlsTransport::flushPendingSends( const Tuple& peer, DtlsConnection& conn )
+{
+   while ( !conn.mPendingSends.empty() )
+   {
+      SendData* sendData = conn.mPendingSends.front() ;
+      conn.mPendingSends.pop_front() ;
+      if ( !writeOne( conn, sendData ) )
       {
-         case SSL_ERROR_NONE:
-            break;
-         case SSL_ERROR_SSL:
-            {
-               ERR_error_string_n(ERR_get_error(), errorString, sizeof(errorString));
-               DebugLog( << "Got DTLS write condition SSL_ERROR_SSL on "
-                         << sendData->destination
-                         << " error = " << errorString );
-            }
-            break;
-         case SSL_ERROR_WANT_READ:
-            retry = 1 ;
-            break;
-         case SSL_ERROR_WANT_WRITE:
-             retry = 1 ;
-             fdset.setWrite(mFd);
-            break;
-         case SSL_ERROR_SYSCALL:
-            {
-               int e = getErrno();
-               error(e);
-
-               ERR_error_string_n(ERR_get_error(), errorString, sizeof(errorString));
-               DebugLog( << "Got DTLS write condition SSL_ERROR_SYSCALL "
-                         << "Failed (" << e << ") sending to "
-                         << sendData->destination
-                         << " error = " << errorString );
-
-               fail(sendData->transactionId);
-            }
-            break;
-         case SSL_ERROR_ZERO_RETURN:
-            {
-               ERR_error_string_n(ERR_get_error(), errorString, sizeof(errorString));
-               DebugLog( << "Got DTLS write condition SSL_ERROR_ZERO_RETURN on "
-                         << sendData->destination
-                         << " error = " << errorString );
-
-               _cleanupConnectionState( ssl, *((struct sockaddr_in *)&peer) ) ;
-            }
-            break ;
-         case SSL_ERROR_WANT_CONNECT:
-            break;
-         case SSL_ERROR_WANT_ACCEPT:
-            break;
-         default:
-            break ;
+         conn.mPendingSends.push_front( sendData ) ;
+         mBlockedPeers.insert( peer ) ;
+         return false ;
       }
    }
-   else
+   mBlockedPeers.erase( peer ) ;
+   return true ;
+}
+
+void
+DtlsTransport::processTimers()
+{
+   UInt64 now = Timer::getTimeMs() ;
+   if ( now < mNextTimerCheck )
    {
-      mSendData = NULL ;
+      return ;
    }
+   mNextTimerCheck = now + DtlsTimerIntervalMs ;
 
-   /*
-    * ngm: is sendData deleted by a higher layer?  Seems to be the case after
-    * checking with UdpTransport
-    */
+   // Retransmit handshake flights whose timer expired, and drop handshakes
+   // that are not going to complete
+   for ( TupleSet::iterator it = mHandshakes.begin(); it != mHandshakes.end(); )
+   {
+      const Tuple peer( *it++ ) ;  // cleanupConnection erases the current entry
+      DtlsConnectionMap::iterator cit = mDtlsConnections.find( peer ) ;
+      resip_assert( cit != mDtlsConnections.end() ) ;
+      if ( now - cit->second->mCreated > DtlsHandshakeTimeoutMs )
+      {
+         InfoLog( << "DTLS handshake with " << peer << " timed out" ) ;
+         cleanupConnection( cit ) ;
+      }
+      else if ( DTLSv1_handle_timeout( cit->second->mSsl ) < 0 )
+      {
+         logSslError( "handshake timeout", SSL_get_error( cit->second->mSsl, -1 ), peer ) ;
+         cleanupConnection( cit ) ;
+      }
+   }
 
-   if ( ! retry && count != int(sendData->data.size()) )
+   if ( now < mNextIdleCheck )
+   {
+      return ;
+   }
+   mNextIdleCheck = now + 1000 ;
+   for ( DtlsConnectionMap::iterator it = mDtlsConnections.begin(); it != mDtlsConnections.end(); )
    {
-      ErrLog (<< "UDPTransport - send buffer full" );
-      fail(sendData->transactionId);
+      DtlsConnectionMap::iterator cur = it++ ;
+      if ( now - cur->second->mLastActivity > mIdleTimeoutMs &&
+           cur->second->mPendingSends.empty() &&
+           !mHandshakes.count( cur->first ) )
+      {
+         DebugLog( << "Closing idle DTLS session with " << cur->first ) ;
+         cleanupConnection( cur ) ;
+      }
    }
 }
 
-void
-DtlsTransport::_doHandshake( void )
+bool
+DtlsTransport::wantWrite() const
 {
-   DtlsMessage *msg = mHandshakePending.getNext() ;
-   SSL *ssl = msg->getSsl() ;
-
-   delete msg ;
-
-   ERR_clear_error();
+   return !mBlockedPeers.empty() || mTxFifoOutBuffer.messageAvailable() ;
+}
 
-   int ret = SSL_do_handshake( ssl ) ;
+void
+DtlsTransport::updateEvents()
+{
+   bool want = wantWrite() ;
+   if ( want != mWriteEnabled )
+   {
+      mPollGrp->modPollItem( mPollItemHandle, want ? FPEM_Read|FPEM_Write : FPEM_Read ) ;
+      mWriteEnabled = want ;
+   }
+}
 
-   if (ret <= 0) {
-      int err = SSL_get_error(ssl, ret);
+void
+DtlsTransport::setPollGrp( FdPollGrp *grp )
+{
+   // UdpTransport registers us for read events only
+   mWriteEnabled = false ;
+   UdpTransport::setPollGrp( grp ) ;
+}
 
-      char errorString[1024];
+void
+DtlsTransport::processPollEvent( FdPollEventMask mask )
+{
+   ++mPollEventCnt;
+   if ( mask & FPEM_Error )
+   {
+      // e.g. ICMP unreachable from a peer - recvfrom reports and clears it
+      DebugLog( << "Error event on " << mTuple ) ;
+      mask |= FPEM_Read ;
+   }
+   if ( mask & FPEM_Write )
+   {
+      processTxAll() ;
+   }
+   if ( mask & FPEM_Read )
+   {
+      processRxAll() ;
+   }
+   processTimers() ;
+   updateEvents() ;
+   mStateMachineFifo.flush();
+}
 
-      switch (err)
-      {
-         case SSL_ERROR_NONE:
-            break;
-         case SSL_ERROR_SSL:
-            {
-               ERR_error_string_n(ERR_get_error(), errorString, sizeof(errorString));
-               DebugLog( << "Got DTLS handshake code SSL_ERROR_SSL"
-                         << " error = " << errorString );
-            }
-            break;
-         case SSL_ERROR_WANT_READ:
-            break;
-         case SSL_ERROR_WANT_WRITE:
-            break;
-         case SSL_ERROR_SYSCALL:
-            {
-               ERR_error_string_n(ERR_get_error(), errorString, sizeof(errorString));
-               DebugLog( << "Got DTLS handshake code SSL_ERROR_SYSCALL"
-                         << " error = " << errorString );
-            }
-            break;
-         case SSL_ERROR_ZERO_RETURN:
-            {
-               ERR_error_string_n(ERR_get_error(), errorString, sizeof(errorString));
-               DebugLog( << "Got DTLS handshake code SSL_ERROR_ZERO_RETURN"
-                         << " error = " << errorString );
-            }
-            break;
-         case SSL_ERROR_WANT_CONNECT:
-            break;
-         case SSL_ERROR_WANT_ACCEPT:
-            break;
-         default:
-            break ;
-      }
+/**
+ * Called after a message is added, and on every pass of the stack's
+ * process loop when using a FdPollGrp.
+ */
+void
+DtlsTransport::process()
+{
+   if ( (mTransportFlags & RESIP_TRANSPORT_FLAG_TXNOW) != 0 )
+   {
+      processTxAll() ;
    }
+   processTimers() ;
+   if ( mPollGrp )
+   {
+      updateEvents() ;
+   }
+   mStateMachineFifo.flush();
 }
 
 void
@@ -682,59 +616,32 @@ DtlsTransport::process(FdSet& fdset)
    // receive datagrams from fd
    // preparse and stuff into RxFifo
 
-   mTimer.process() ;
+   processTimers() ;
 
-   while ( mHandshakePending.messageAvailable() )
-      _doHandshake() ;
-
-   if ( ( mSendData != NULL || mTxFifo.messageAvailable() )
-       && fdset.readyToWrite( mFd ) )
-      _write( fdset ) ;
+   if ( fdset.readyToWrite( mFd ) )
+   {
+      processTxAll() ;
+   }
 
    // !jf! this may have to change - when we read a message that is too big
-   if ( fdset.readyToRead(mFd) )
-      _read( fdset ) ;
+   if ( fdset.readyToRead( mFd ) )
+   {
+      processRxAll() ;
+   }
+   mStateMachineFifo.flush();
 }
 
-
 void
 DtlsTransport::buildFdSet( FdSet& fdset )
 {
    fdset.setRead(mFd);
 
-   if ( mSendData != NULL || mTxFifo.messageAvailable() )
+   if ( wantWrite() )
    {
      fdset.setWrite(mFd);
    }
 }
 
-void
-DtlsTransport::_cleanupConnectionState( SSL *ssl, struct sockaddr_in peer )
-{
-   /*
-    * SSL_free decrements the ref-count for mDummyBio by 1, so
-    * add 1 to the ref-count to make sure it does not get free'd
-    */
-   BIO_up_ref(mDummyBio);
-   SSL_shutdown(ssl);
-   SSL_free(ssl) ;
-   mDtlsConnections.erase(peer) ;
-}
-
-void
-DtlsTransport::_mapDebug( const char *where, const char *action, SSL *ssl )
-{
-   fprintf( stderr, "%s: %s\t%p\n", where, action, ssl ) ;
-   fprintf( stderr, "map sizet = %d\n", (unsigned int)mDtlsConnections.size() ) ;
-}
-
-void
-DtlsTransport::_printSock( const struct sockaddr_in *sock )
-{
-   fprintf( stderr, "addr = %s\t port = %d\n", inet_ntoa( sock->sin_addr ),
-            ntohs( sock->sin_port ) ) ;
-}
-
 #endif /* USE_DTLS */
 #endif /* USE_SSL */
 
@@ -12,10 +12,6 @@
 #include "resip/stack/UdpTransport.hxx"
 #endif
 
-#ifndef RESIP_TIMERQUEUE_HXX
-#include "resip/stack/TimerQueue.hxx"
-#endif
-
 #ifndef RESIP_SENDDATA_HXX
 #include "resip/stack/SendData.hxx"
 #endif
@@ -28,7 +24,9 @@
 #include "rutil/HashMap.hxx"
 #endif
 
+#include <deque>
 #include <map>
+#include <set>
 #include <openssl/ssl.h>
 
 #include "resip/stack/Compression.hxx"
@@ -37,81 +35,22 @@ namespace resip
 {
 
 class Security;
-class TransactionMessage;
-class UdpTransport;
-class DtlsMessage;
 
+/**
+   DTLS over a single UDP socket.  Each peer (address, port and IP version)
+   gets its own SSL session, created in client mode when we send first and
+   in server mode when the peer does.
+
+   Messages for a peer whose handshake has not completed are queued on that
+   peer, so a slow or lost handshake only delays traffic to that peer.
+   Handshake retransmissions, handshakes that never complete, and sessions
+   that have been idle for getIdleTimeout() are handled from process() and
+   the poll callbacks.
+
+   Works both with the FdSet based process loop and with a FdPollGrp.
+*/
 class DtlsTransport : public UdpTransport
 {
-#if  defined(__INTEL_COMPILER ) || (defined(WIN32) && defined(_MSC_VER) && (_MSC_VER >= 1310) && (_MSC_VER < 1900))  // !slg! not sure if this works on __INTEL_COMPILER 
-   struct sockaddr_in_hash_compare
-   {
-      enum { bucket_size = 4, min_buckets = 8 };
-
-      size_t operator()(const struct sockaddr_in& sock) const 
-      { 
-          return sock.sin_addr.s_addr; 
-      }
-      bool operator()(const struct sockaddr_in& s1, 
-                      const struct sockaddr_in& s2) const
-      {
-         if ( (s1.sin_addr.s_addr < s2.sin_addr.s_addr) ||
-              ( (s1.sin_addr.s_addr == s2.sin_addr.s_addr ) &&
-                ( s1.sin_port < s2.sin_port) ) )
-         {
-             return 1;
-         }
-         else
-         {
-            return 0;
-         }
-      }
-   };
-#elif defined(HASH_MAP_NAMESPACE)
-   struct addr_hash
-   {
-      size_t operator()( const struct sockaddr_in sock ) const
-      {
-         return sock.sin_addr.s_addr ;
-      }            
-   };
-     
-   struct addr_cmp
-   { 
-      bool operator()(const struct sockaddr_in& s1, 
-                      const struct sockaddr_in& s2) const
-      {
-         if ( ( s1.sin_addr.s_addr == s2.sin_addr.s_addr ) &&
-              ( s1.sin_port == s2.sin_port) )
-         {
-            return 1;
-         }
-         else
-         {
-            return 0;
-         }
-      }
-   };
-#else
-   struct addr_less
-   { 
-      bool operator()(const struct sockaddr_in& s1, 
-                      const struct sockaddr_in& s2) const
-      {
-         if ( (s1.sin_addr.s_addr < s2.sin_addr.s_addr) ||
-              ( (s1.sin_addr.s_addr == s2.sin_addr.s_addr ) &&
-                ( s1.sin_port < s2.sin_port) ) )
-         {
-             return 1;
-         }
-         else
-         {
-            return 0;
-         }
-      }
-   };
-#endif
-
    public:
       RESIP_HeapCount(DtlsTransport);
       // Specify which udp port to use for send and receive
@@ -130,54 +69,83 @@ class DtlsTransport : public UdpTransport
                     const Data& privateKeyPassPhrase = "");
       virtual  ~DtlsTransport();
 
-      void process(FdSet& fdset);
-      bool isReliable() const { return false; }
-      bool isDatagram() const { return true; }
+      virtual void process(FdSet& fdset);
+      virtual void process();
+      virtual bool isReliable() const { return false; }
+      virtual bool isDatagram() const { return true; }
       virtual void buildFdSet( FdSet& fdset);
+      virtual void setPollGrp(FdPollGrp *grp);
 
-      static const unsigned long DtlsReceiveTimeout = 250000 ;
+      // FdPollItemIf
+      virtual void processPollEvent(FdPollEventMask mask);
 
-   private:
+      /// Sessions without traffic for this long are closed (default DtlsIdleTimeoutMs)
+      void setIdleTimeout(unsigned long ms) { mIdleTimeoutMs = ms; }
+      unsigned long getIdleTimeout() const { return mIdleTimeoutMs; }
+
+      /// Number of peers with a session, including handshakes in progress
+      size_t getConnectionCount() const { return mDtlsConnections.size(); }
+
+      static const unsigned long DtlsIdleTimeoutMs = 600000;
+      static const unsigned long DtlsHandshakeTimeoutMs = 32000;
+      static const unsigned long DtlsTimerIntervalMs = 250;
+      /// Messages held for one peer while its handshake completes
+      static const unsigned int MaxPendingSends = 64;
 
-#if  defined(__INTEL_COMPILER ) || (defined(WIN32) && defined(_MSC_VER) && (_MSC_VER >= 1310) && (_MSC_VER < 1900))
-      typedef HashMap<struct sockaddr_in, 
-                      SSL*, 
-                      DtlsTransport::sockaddr_in_hash_compare> DtlsConnectionMap;
-#elif defined(HASH_MAP_NAMESPACE)
-      typedef HashMap<struct sockaddr_in, 
-                      SSL*, 
-                      DtlsTransport::addr_hash, 
-                      DtlsTransport::addr_cmp> DtlsConnectionMap ;
+   protected:
+      // SSL has to do the reads and writes itself
+      virtual bool allowGroupIO() const { return false; }
+
+   private:
+      class DtlsConnection
+      {
+         public:
+            DtlsConnection(SSL* ssl, UInt64 now) :
+               mSsl(ssl),
+               mCreated(now),
+               mLastActivity(now)
+            {}
+
+            SSL* mSsl;
+            std::deque<SendData*> mPendingSends;
+            UInt64 mCreated;
+            UInt64 mLastActivity;
+      };
+
+#if defined(HASH_MAP_NAMESPACE)
+      typedef HashMap<Tuple, DtlsConnection*> DtlsConnectionMap;
 #else
-      typedef std::map<struct sockaddr_in, 
-                      SSL*, 
-                      DtlsTransport::addr_less> DtlsConnectionMap ;
+      typedef std::map<Tuple, DtlsConnection*> DtlsConnectionMap;
 #endif
+      typedef std::set<Tuple> TupleSet;
 
       SSL_CTX             *mClientCtx ;
       SSL_CTX             *mServerCtx ;
-      MsgHeaderScanner    mMsgHeaderScanner;
-      static const int    MaxBufferSize;
-      Fifo<DtlsMessage>   mHandshakePending ;
-      DtlsTimerQueue      mTimer ;
       Security*           mSecurity ;
-      DtlsConnectionMap   mDtlsConnections ;  /* IP addr/port -> transport */
-      unsigned char       mDummyBuf[ 4 ] ;
-      BIO*                mDummyBio ;
+      DtlsConnectionMap   mDtlsConnections ;  /* peer -> session */
+      TupleSet            mHandshakes ;       /* peers with a handshake in progress */
+      TupleSet            mBlockedPeers ;     /* peers with sends held back by a full socket */
       const Data          mDomain;
-
-      SendData            *mSendData ;/* Data that was unqueued from mTxFifo, 
-                                       * but unable to send because a handshake
-                                       * was in progress 
-                                       */
-      
-      void _read( FdSet& fdset ) ;
-      void _write( FdSet& fdset ) ;
-      void _doHandshake() ;
-      void _cleanupConnectionState( SSL *ssl, struct sockaddr_in peer ) ;
-
-      void _mapDebug( const char *where, const char *action, SSL *ssl ) ;
-      void _printSock( const struct sockaddr_in *sock ) ;
+      unsigned long       mIdleTimeoutMs;
+      UInt64              mNextTimerCheck;
+      UInt64              mNextIdleCheck;
+      bool                mWriteEnabled;
+      char*               mDatagram;          /* ciphertext receive buffer */
+      char*               mPlaintext;         /* decrypted message, handed to the SipMessage */
+
+      void processRxAll();
+      void processRxOne( const Tuple& sender, int len );
+      void processTxAll();
+      void processTxOne( SendData* sendData );
+      bool writeOne( DtlsConnection& conn, SendData* sendData );
+      bool flushPendingSends( const Tuple& peer, DtlsConnection& conn );
+      void processTimers();
+      void updateEvents();
+      bool wantWrite() const;
+
+      DtlsConnection* createConnection( const Tuple& peer, bool server );
+      void cleanupConnection( DtlsConnectionMap::iterator it );
+      void logSslError( const char* operation, int err, const Tuple& peer );
 };
 
 }
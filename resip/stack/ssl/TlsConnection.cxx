@@ -100,6 +100,12 @@ TlsConnection::TlsConnection( Transport* transport, const Tuple& tuple,
    mSsl = SSL_new(ctx);
    resip_assert(mSsl);
 
+   // Queued messages are coalesced into one buffer per write (see
+   // Connection::writeBuffers), which may have been reallocated, and grown by
+   // newly queued messages, by the time a write that wanted to be retried is
+   // retried
+   SSL_set_mode(mSsl, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
    resip_assert( mSecurity );
 
    if(mServer)
@@ -3,6 +3,7 @@
 #include <sys/types.h>
 #include "rutil/Data.hxx"
 #include "resip/stack/SipMessage.hxx"
+#include "resip/stack/SipMessageEncoder.hxx"
 
 namespace resip {
 
@@ -32,6 +33,11 @@ class SipRawMessage : public SipMessage
          return str;
       }
 
+      virtual void encode(SipMessageEncoder& encoder) const
+      {
+         encoder.add(mRawMessage);
+      }
+
    private:
       mutable Data mRawMessage;
 };
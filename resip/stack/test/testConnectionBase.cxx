@@ -124,6 +124,85 @@ class TestConnection : public ConnectionBase
       // Fifo<TransactionMessage>& mRxFifo;
 };
 
+class CaptureHandler : public Transport::SipMessageLoggingHandler
+{
+   public:
+      CaptureHandler() : mParsed(0) {}
+      virtual void outboundMessage(const Tuple &source, const Tuple &destination, const SipMessage &msg) { assert(0); }
+      virtual void inboundMessage(const Tuple& source, const Tuple& destination, const SipMessage &msg)
+      {
+         ++mParsed;
+      }
+      virtual void inboundEncodedMessage(const Tuple& source, const Tuple& destination, const SipMessage &msg, const Data& received)
+      {
+         mReceived.push_back(received);
+      }
+
+      unsigned int mParsed;
+      std::vector<Data> mReceived;
+};
+
+static const Data firstMessage("INVITE sip:192.168.2.92:5100;q=1 SIP/2.0\r\n"
+         "To: <sip:yiwen_AT_meet2talk.com@whistler.gloo.net>\r\n"
+         "From: Jason Fischl<sip:jason_AT_meet2talk.com@whistler.gloo.net>;tag=ba1aee2d\r\n"
+         "Via: SIP/2.0/TCP 192.168.2.15:5100;branch=z9hG4bK-c87542-579667358-1--c87542-;rport\r\n"
+         "Call-ID: 6c64b42fce01b007\r\n"
+         "CSeq: 2 INVITE\r\n"
+         "Contact: <sip:192.168.2.15:5100>\r\n"
+         "Content-Length: 0\r\n"
+         "\r\n");
+
+static const Data secondMessage("INVITE sip:192.168.2.92:5100;q=1 SIP/2.0\r\n"
+         "To: <sip:yiwen_AT_meet2talk.com@whistler.gloo.net>\r\n"
+         "From: Jason Fischl<sip:jason_AT_meet2talk.com@whistler.gloo.net>;tag=ba1aee2d\r\n"
+         "Via: SIP/2.0/TCP 192.168.2.15:5100;branch=z9hG4bK-c87542-579667358-2--c87542-;rport\r\n"
+         "Call-ID: 6c64b42fce01b007\r\n"
+         "CSeq: 3 INVITE\r\n"
+         "Contact: <sip:192.168.2.15:5100>\r\n"
+         "Content-Type: application/sdp\r\n"
+         "Content-Length: 91\r\n"
+         "\r\n"
+         "v=0\r\n"
+         "o=M2TUA 1589993278 1032390928 IN IP4 192.168.2.15\r\n"
+         "s=-\r\n"
+         "c=IN IP4 192.168.2.15\r\n"
+         "t=0 0\r\n");
+
+// The logging handler must be given the messages exactly as they were read,
+// whichever way they were split into reads, and not the Via the stack stamped
+// received/rport into
+bool
+testReceivedBytes(unsigned int minChunk, unsigned int maxChunk, bool headersSplit = true)
+{
+   Data bytes(firstMessage + "\r\n\r\n" + secondMessage);
+
+   Fifo<TransactionMessage> testRxFifo;
+   FakeTCPTransport fake(testRxFifo, 5060, V4, Data::Empty);
+   SharedPtr<CaptureHandler> handler(new CaptureHandler);
+   fake.setSipMessageLoggingHandler(handler);
+   Tuple who("192.168.2.16", 5100, V4, TCP);
+
+   {
+      TestConnection cBase(&fake, who, bytes);
+      while(cBase.read(minChunk, maxChunk));
+   }
+
+   if(handler->mParsed + handler->mReceived.size() != 2)
+   {
+      return false;
+   }
+   for(std::vector<Data>::const_iterator it = handler->mReceived.begin(); it != handler->mReceived.end(); ++it)
+   {
+      if(*it != firstMessage && *it != secondMessage)
+      {
+         cerr << "Unexpected received bytes: " << *it << endl;
+         return false;
+      }
+   }
+   // Only messages with headers split across reads fall back to the parsed message
+   return headersSplit || handler->mParsed == 0;
+}
+
 bool
 testTCPConnection()
 {
@@ -192,6 +271,20 @@ main(int argc, char** argv)
    assert(testTCPConnection());
    cerr << "testTCPConnection OK" << endl; 
 
+   // With the end of the second body read on its own, in one read, and in
+   // random chunks
+   assert(testReceivedBytes(firstMessage.size() + 4 + secondMessage.size() - 20,
+                            firstMessage.size() + 4 + secondMessage.size() - 20, false));
+   assert(testReceivedBytes(10000, 10000, false));
+   for (unsigned int i=0; i < 100; i++)
+   {
+      unsigned int minChunk = (Random::getRandom() % 700)+1;
+      unsigned int maxChunk = (Random::getRandom() % 700)+1;
+      if (maxChunk < minChunk) swap(maxChunk, minChunk);
+      assert(testReceivedBytes(minChunk, maxChunk));
+   }
+   cerr << "testReceivedBytes OK" << endl;
+
    cerr << "ALL OK" << endl;
    return 0;
 }
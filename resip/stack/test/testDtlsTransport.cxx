@@ -5,10 +5,14 @@
 #include <sys/types.h>
 #include <iostream>
 #include <memory>
+#include <vector>
 
 #include "rutil/DnsUtil.hxx"
+#include "rutil/FdPoll.hxx"
 #include "rutil/Inserter.hxx"
 #include "rutil/Logger.hxx"
+#include "rutil/Timer.hxx"
+#include "resip/stack/EventStackThread.hxx"
 #include "resip/stack/Helper.hxx"
 #include "resip/stack/SipMessage.hxx"
 #include "resip/stack/SipStack.hxx"
@@ -16,70 +20,194 @@
 #ifdef USE_SSL
 #include "resip/stack/ssl/Security.hxx"
 #endif
+#ifdef USE_DTLS
+#include "resip/stack/ssl/DtlsTransport.hxx"
+#endif
 
 using namespace resip;
 using namespace std;
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::SIP
 
+// Loopback DTLS throughput test: a number of client stacks, each one a
+// separate DTLS peer, send MESSAGE requests to a server stack which answers
+// them with 200.  All stacks share one FdPollGrp (or, with pollImpl "select",
+// the FdSet process loop) and run in this thread.
+//
+// usage: testDtlsTransport [certPath [messages [peers [v4|v6 [pollImpl]]]]]
+//
+// certPath must contain domain_cert_localhost.pem, domain_key_localhost.pem
+// and a root_cert_*.pem that the domain cert verifies against (the domain
+// cert itself if it is self-signed).
+
+#ifdef USE_DTLS
+static void
+processStacks(SipStack& server, std::vector<SipStack*>& clients, bool useSelect)
+{
+   if(useSelect)
+   {
+      FdSet fdset;
+      server.buildFdSet(fdset);
+      for(size_t i = 0; i < clients.size(); i++)
+      {
+         clients[i]->buildFdSet(fdset);
+      }
+      fdset.selectMilliSeconds(10);
+      server.process(fdset);
+      for(size_t i = 0; i < clients.size(); i++)
+      {
+         clients[i]->process(fdset);
+      }
+   }
+   else
+   {
+      server.process(10);
+      for(size_t i = 0; i < clients.size(); i++)
+      {
+         clients[i]->processTimers();
+      }
+   }
+}
+#endif
 
 int
 main(int argc, char* argv[])
 {
-   Log::initialize(Log::Cout, Log::Info ,"testDtlsTransport");   
+   Log::initialize(Log::Cout, Log::Warning, "testDtlsTransport");
 
 #ifdef USE_DTLS
-   Security* serverSecurity = new Security();
-   SipStack serverStack(serverSecurity);
-
-   serverStack.addTransport(DTLS, 15060, V4, StunDisabled, Data::Empty, "127.0.0.1");
-   SipStack clientStack(serverSecurity);
-   clientStack.addTransport(DTLS, 25060, V4);
-   
-   NameAddr target("sip:bob@127.0.0.1:15060;transport=dtls");
-   NameAddr from("sip:alice@127.0.0.1");
-   NameAddr contact;
-   contact.uri().user() = "alice";
-   
-   SipMessage * msg = Helper::makeRequest(target, from, contact, INVITE);
-   clientStack.send(*msg);
-   delete msg;
-   
-   while(true)
+   Data certPath(argc > 1 ? argv[1] : "");
+   int numMessages = argc > 2 ? atoi(argv[2]) : 10000;
+   int numPeers = argc > 3 ? atoi(argv[3]) : 4;
+   IpVersion version = (argc > 4 && Data(argv[4]) == "v6") ? V6 : V4;
+   const char* pollImpl = argc > 5 ? argv[5] : "event";
+   // Outstanding requests per peer - kept small enough in total not to
+   // overflow the server's socket buffer
+   const int window = resipMax(1, 64 / numPeers);
+   const Data loopback(version == V4 ? "127.0.0.1" : "::1");
+   const int serverPort = 15060;
+
+   const bool useSelect = (Data(pollImpl) == "select");
+   FdPollGrp* pollGrp = useSelect ? 0 : FdPollGrp::create(pollImpl);
+   EventThreadInterruptor* interruptor = useSelect ? 0 : new EventThreadInterruptor(*pollGrp);
+   int completed = 0;
+   int failed = 0;
    {
+      SipStackOptions options;
+      options.mPollGrp = pollGrp;
+      options.mAsyncProcessHandler = interruptor;
+
+      options.mSecurity = certPath.empty() ? new Security() : new Security(certPath);
+      SipStack serverStack(options);
+      DtlsTransport* serverTransport = dynamic_cast<DtlsTransport*>(
+         serverStack.addTransport(DTLS, serverPort, version, StunDisabled, loopback, "localhost"));
+      resip_assert(serverTransport);
+
+      std::vector<SipStack*> clients;
+      for(int i = 0; i < numPeers; i++)
+      {
+         options.mSecurity = certPath.empty() ? new Security() : new Security(certPath);
+         SipStack* client = new SipStack(options);
+         client->addTransport(DTLS, serverPort + 1 + i, version, StunDisabled, loopback);
+         clients.push_back(client);
+      }
+
+      NameAddr target(Data("sip:bob@") + (version == V4 ? loopback : "[" + loopback + "]") + ":" + Data(serverPort) + ";transport=dtls");
+      NameAddr from("sip:alice@localhost");
+      NameAddr contact;
+      contact.uri().user() = "alice";
+
+      std::vector<int> sent(numPeers, 0);
+      std::vector<int> outstanding(numPeers, 0);
+      UInt64 startTime = Timer::getTimeMs();
+      UInt64 lastProgress = startTime;
+
+      while(completed + failed < numMessages)
       {
-         FdSet fdset; 
-         serverStack.buildFdSet(fdset);
-         fdset.selectMilliSeconds(50);
-         serverStack.process(fdset);
+         for(int i = 0; i < numPeers; i++)
+         {
+            while(outstanding[i] < window && completed + failed + outstanding[i] < numMessages &&
+                  sent[i] < numMessages / numPeers + 1)
+            {
+               std::auto_ptr<SipMessage> msg(Helper::makeRequest(target, from, contact, MESSAGE));
+               clients[i]->send(*msg);
+               sent[i]++;
+               outstanding[i]++;
+            }
+         }
+
+         processStacks(serverStack, clients, useSelect);
+
+         SipMessage* msg;
+         while((msg = serverStack.receive()) != 0)
+         {
+            if(msg->isRequest() && msg->method() != ACK)
+            {
+               std::auto_ptr<SipMessage> resp(Helper::makeResponse(*msg, 200));
+               serverStack.send(*resp);
+            }
+            delete msg;
+         }
+         for(int i = 0; i < numPeers; i++)
+         {
+            while((msg = clients[i]->receive()) != 0)
+            {
+               if(msg->isResponse() && msg->header(h_StatusLine).statusCode() >= 200)
+               {
+                  outstanding[i]--;
+                  if(msg->header(h_StatusLine).statusCode() == 200)
+                  {
+                     completed++;
+                     lastProgress = Timer::getTimeMs();
+                  }
+                  else
+                  {
+                     failed++;
+                  }
+               }
+               delete msg;
+            }
+         }
+
+         if(Timer::getTimeMs() - lastProgress > 40000)
+         {
+            ErrLog(<< "No progress for 40s, giving up after " << completed << " messages");
+            break;
+         }
       }
-      
-      SipMessage* msg = serverStack.receive();
-      if (msg && msg->isRequest())
+
+      UInt64 elapsed = Timer::getTimeMs() - startTime;
+      cout << "DTLS " << (version == V4 ? "v4" : "v6") << " " << pollImpl << ": "
+           << completed << " messages (" << failed << " failed) from "
+           << numPeers << " peers in " << elapsed << " ms, "
+           << (elapsed ? completed * 1000 / elapsed : 0) << " messages/s" << endl;
+
+      // Every peer has a session now; with no idle time allowed they are all closed
+      resip_assert(serverTransport->getConnectionCount() == (size_t)numPeers);
+      serverTransport->setIdleTimeout(0);
+      UInt64 reapStart = Timer::getTimeMs();
+      while(serverTransport->getConnectionCount() > 0 && Timer::getTimeMs() - reapStart < 5000)
       {
-         SipMessage* resp = Helper::makeResponse(*msg, 400);
-         serverStack.send(*resp);
-         InfoLog( << "Generated 400 to: " << msg->brief());
-         delete resp;
+         processStacks(serverStack, clients, useSelect);
       }
-      delete msg;
-      
+      cout << "Idle DTLS sessions left after reaping: " << serverTransport->getConnectionCount() << endl;
+      if(serverTransport->getConnectionCount() != 0)
       {
-         FdSet fdset; 
-         clientStack.buildFdSet(fdset);
-         fdset.selectMilliSeconds(50);
-         clientStack.process(fdset);
+         completed = 0;
       }
 
-      msg = clientStack.receive();
-      if (msg)
+      for(int i = 0; i < numPeers; i++)
       {
-         InfoLog( << "Got from server: " << msg->brief());
-         break;         
+         delete clients[i];
       }
    }
-#endif
+   // The stacks used the poll group, so it goes last
+   delete interruptor;
+   delete pollGrp;
+   return (completed == numMessages) ? 0 : 1;
+#else
    return 0;
+#endif
 }
 /* ====================================================================
  * The Vovida Software License, Version 1.0 
@@ -1,4 +1,6 @@
 #include "resip/stack/GenericPidfContents.hxx"
+#include "resip/stack/SharedContents.hxx"
+#include "resip/stack/SipMessage.hxx"
 #include <iostream>
 #include "rutil/Logger.hxx"
 #include "rutil/HashMap.hxx"
@@ -802,6 +804,41 @@ main(int argc, char** argv)
       }
    }
 
+   // SharedContents - one encoding shared by every NOTIFY in a fan-out
+   {
+      GenericPidfContents pidf;
+      pidf.setEntity(Uri("sip:entity@domain"));
+      pidf.setSimplePresenceTupleNode("1234", true, "2005-05-30T22:00:29Z");
+      Data encoded = Data::from(pidf);
+
+      SharedContents shared(pidf);
+      assert(shared.getType() == pidf.getType());
+      assert(shared.getEncoded() == encoded);
+      assert(shared.getBodyData() == encoded);
+
+      SipMessage notify1;
+      SipMessage notify2;
+      notify1.setContents(&shared);
+      notify2.setContents(&shared);
+      SharedContents* body1 = dynamic_cast<SharedContents*>(notify1.getContents());
+      SharedContents* body2 = dynamic_cast<SharedContents*>(notify2.getContents());
+      assert(body1 && body2 && body1 != body2);
+      // Clones share the encoded body rather than copying it
+      assert(body1->getEncoded().data() == shared.getEncoded().data());
+      assert(body2->getEncoded().data() == shared.getEncoded().data());
+      assert(Data::from(*body1) == encoded);
+      assert(notify1.header(h_ContentType) == pidf.getType());
+
+      // The wire encoder adds the shared bytes directly; the result must
+      // match the stream encoding
+      Data wire;
+      notify1.encodeToBuffer(wire);
+      assert(wire == Data::from(notify1));
+      assert(wire.size() > encoded.size());
+      assert(wire.substr(wire.size() - encoded.size()) == encoded);
+      assert(wire.find("Content-Length: " + Data((UInt64)encoded.size()) + "\r\n") != Data::npos);
+   }
+
    cerr << "All OK" << endl;
    return 0;
 }
@@ -0,0 +1,305 @@
+#include "resip/stack/ExtensionHeader.hxx"
+#include "resip/stack/ParseStatistics.hxx"
+#include "resip/stack/SipMessage.hxx"
+#include "resip/stack/SipStack.hxx"
+#include "resip/stack/test/TestSupport.hxx"
+#include "resip/stack/test/testPortOffset.hxx"
+#include "rutil/DataStream.hxx"
+#include "rutil/Socket.hxx"
+#include "rutil/ThreadIf.hxx"
+#include "rutil/Timer.hxx"
+
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <string.h>
+
+using namespace resip;
+using namespace std;
+
+static const char* invite =
+   "INVITE sip:bob@biloxi.com SIP/2.0\r\n"
+   "Via: SIP/2.0/UDP pc33.atlanta.com;branch=z9hG4bKnashds8\r\n"
+   "Max-Forwards: 70\r\n"
+   "To: Bob <sip:bob@biloxi.com>\r\n"
+   "From: Alice <sip:alice@atlanta.com>;tag=1928301774\r\n"
+   "Call-ID: a84b4c76e66710\r\n"
+   "CSeq: 314159 INVITE\r\n"
+   "Contact: <sip:alice@pc33.atlanta.com>\r\n"
+   "X-Custom: whatever\r\n"
+   "Content-Length: 0\r\n"
+   "\r\n";
+
+static UInt64
+parsed(const char* path, int type)
+{
+   return ParseStatistics::getCount(path, ParseStatistics::Parse, type);
+}
+
+static UInt64
+reencoded(const char* path, int type)
+{
+   return ParseStatistics::getCount(path, ParseStatistics::Reencode, type);
+}
+
+static const int stackPort = resipTestPort(5080);
+static const int peerPort = resipTestPort(5081);
+
+static Data
+forwardable(const Data& callId)
+{
+   return "MESSAGE sip:bob@127.0.0.1:" + Data(peerPort) + " SIP/2.0\r\n"
+      "Via: SIP/2.0/UDP 127.0.0.1:" + Data(peerPort) + ";branch=z9hG4bK" + callId + "\r\n"
+      "Max-Forwards: 70\r\n"
+      "To: <sip:bob@127.0.0.1>\r\n"
+      "From: <sip:alice@127.0.0.1>;tag=12\r\n"
+      "Call-ID: " + callId + "\r\n"
+      "CSeq: 1 MESSAGE\r\n"
+      "Contact: \"Alice\"   <sip:alice@10.0.0.1:5060;ob>\r\n"
+      "Record-Route: <sip:p1.example.com;lr>  \r\n"
+      "Content-Length: 0\r\n"
+      "\r\n";
+}
+
+// sends msg through stack and returns what arrives on peer
+static Data
+sendAndCapture(SipStack& stack, Socket peer, const SipMessage& msg)
+{
+   stack.send(msg);
+   char buf[4096];
+   UInt64 end = Timer::getTimeMs() + 2000;
+   while (Timer::getTimeMs() < end)
+   {
+      stack.process(10);
+      int len = recv(peer, buf, sizeof(buf), 0);
+      if (len > 0)
+      {
+         return Data(buf, len);
+      }
+   }
+   assert(0);
+   return Data::Empty;
+}
+
+static UInt64
+parsedByStack(int type)
+{
+   return parsed(ParseStatistics::UnscopedPath, type) +
+      parsed("Transport", type) +
+      parsed("TransactionController", type) +
+      parsed("TransportSelector", type);
+}
+
+class ParsingThread : public ThreadIf
+{
+   public:
+      virtual void thread()
+      {
+         ParseStatistics::Scope scope("ParsingThread");
+         auto_ptr<SipMessage> msg(TestSupport::makeMessage(invite));
+         assert(msg->const_header(h_CallId).value() == "a84b4c76e66710");
+      }
+};
+
+// enters many new scopes, so its path table grows while main() totals it
+class ScopingThread : public ThreadIf
+{
+   public:
+      static const int NumScopes = 500;
+
+      virtual void thread()
+      {
+         for (int i = 0; i < NumScopes; ++i)
+         {
+            ParseStatistics::Scope scope(("Scope" + Data(i)).c_str());
+            ParseStatistics::record(ParseStatistics::Parse, Headers::CSeq);
+         }
+      }
+};
+
+int
+main()
+{
+   // nothing is counted while disabled
+   {
+      auto_ptr<SipMessage> msg(TestSupport::makeMessage(invite));
+      ParseStatistics::Scope scope("Disabled");
+      assert(msg->const_header(h_CSeq).sequence() == 314159);
+      assert(parsed("Disabled", Headers::CSeq) == 0);
+   }
+
+   ParseStatistics::setEnabled(true);
+
+   // parses are counted once, against the innermost scope
+   {
+      auto_ptr<SipMessage> msg(TestSupport::makeMessage(invite));
+      {
+         ParseStatistics::Scope outer("Outer");
+         assert(msg->const_header(h_CSeq).sequence() == 314159);
+         assert(msg->const_header(h_CSeq).method() == INVITE);
+         {
+            ParseStatistics::Scope inner("Inner");
+            assert(msg->const_header(h_To).uri().user() == "bob");
+         }
+         assert(msg->const_header(h_RequestLine).method() == INVITE);
+      }
+      assert(msg->const_header(h_From).exists(p_tag));
+      ExtensionHeader h_XCustom("X-Custom");
+      const SipMessage& cmsg(*msg);
+      assert(cmsg.header(h_XCustom).front().value() == "whatever");
+
+      assert(parsed("Outer", Headers::CSeq) == 1);
+      assert(parsed("Outer", Headers::To) == 0);
+      assert(parsed("Inner", Headers::To) == 1);
+      assert(parsed("Outer", ParseStatistics::RequestLine) == 1);
+      assert(parsed(ParseStatistics::UnscopedPath, Headers::From) == 1);
+      assert(parsed(ParseStatistics::UnscopedPath, ParseStatistics::UnknownHeader) == 1);
+      assert(parsed(ParseStatistics::UnscopedPath, Headers::Via) == 0);
+      assert(parsed(ParseStatistics::UnscopedPath, Headers::Contact) == 0);
+
+      // only what was touched non-const (or synthesized) is re-encoded
+      {
+         ParseStatistics::Scope scope("Encode");
+         msg->header(h_MaxForwards).value()--;
+         Data buffer;
+         msg->encodeToBuffer(buffer);
+         assert(buffer.find("Max-Forwards: 69\r\n") != Data::npos);
+         assert(buffer.find("Contact: <sip:alice@pc33.atlanta.com>\r\n") != Data::npos);
+      }
+      assert(parsed("Encode", Headers::MaxForwards) == 1);
+      assert(reencoded("Encode", Headers::MaxForwards) == 1);
+      assert(reencoded("Encode", Headers::CSeq) == 0);
+      assert(reencoded("Encode", Headers::To) == 0);
+   }
+
+   // counts from threads that have gone away are kept
+   {
+      ParsingThread t;
+      t.run();
+      t.join();
+      assert(parsed("ParsingThread", Headers::CallID) == 1);
+   }
+
+   // totalling while another thread adds paths
+   {
+      ScopingThread t;
+      t.run();
+      for (int i = 0; i < 200; ++i)
+      {
+         Data buffer;
+         DataStream strm(buffer);
+         ParseStatistics::encode(strm);
+         parsed("Scope499", Headers::CSeq);
+      }
+      t.join();
+      for (int i = 0; i < ScopingThread::NumScopes; ++i)
+      {
+         assert(parsed(("Scope" + Data(i)).c_str(), Headers::CSeq) == 1);
+      }
+   }
+
+   {
+      Data buffer;
+      {
+         DataStream strm(buffer);
+         ParseStatistics::encode(strm);
+      }
+      cerr << buffer << endl;
+      assert(buffer.find("Inner To: 1 0") != Data::npos);
+      assert(buffer.find("Encode Max-Forwards: 1 1") != Data::npos);
+   }
+
+   ParseStatistics::reset();
+   assert(parsed("Outer", Headers::CSeq) == 0);
+   assert(parsed("ParsingThread", Headers::CallID) == 0);
+
+   // pass-through: values nobody has read go out as they came in, but
+   // TU-synthesized ones are still filled in
+   {
+      initNetwork();
+      Socket peer = ::socket(AF_INET, SOCK_DGRAM, 0);
+      assert(peer != INVALID_SOCKET);
+      sockaddr_in addr;
+      memset(&addr, 0, sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons(peerPort);
+      addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      assert(::bind(peer, (sockaddr*)&addr, sizeof(addr)) == 0);
+      makeSocketNonBlocking(peer);
+
+      SipStack stack;
+      stack.addTransport(UDP, stackPort, V4, StunDisabled, "127.0.0.1");
+      stack.setPassThroughUntouchedHeaders(true);
+
+      auto_ptr<SipMessage> msg(TestSupport::makeMessage(forwardable("passthrough1")));
+      Data wire = sendAndCapture(stack, peer, *msg);
+      assert(wire.find("Contact: \"Alice\"   <sip:alice@10.0.0.1:5060;ob>\r\n") != Data::npos);
+      assert(wire.find("Record-Route: <sip:p1.example.com;lr>  \r\n") != Data::npos);
+      assert(parsedByStack(Headers::Contact) == 0);
+      assert(parsedByStack(Headers::RecordRoute) == 0);
+
+      msg.reset(TestSupport::makeMessage(forwardable("passthrough2")));
+      msg->header(h_Contacts).clear();
+      NameAddr contact;
+      contact.uri().user() = "carol";
+      msg->header(h_Contacts).push_back(contact);
+      wire = sendAndCapture(stack, peer, *msg);
+      assert(wire.find("Contact: <sip:carol@127.0.0.1:" + Data(stackPort) + ">\r\n") != Data::npos);
+      assert(wire.find("Record-Route: <sip:p1.example.com;lr>  \r\n") != Data::npos);
+
+      closeSocket(peer);
+   }
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
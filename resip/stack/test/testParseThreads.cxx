@@ -0,0 +1,156 @@
+// Benchmark for parsing on several threads at once, as repro's worker
+// threads and the transport threads do.  Each thread parses the host of
+// every Uri and Via in a REGISTER, which is where the parser looks up
+// interned values (Data::useInterned), first with nothing interned and then
+// with the message's domain interned, as TransactionUser::addDomain does.
+// Both runs should scale the same way with the number of threads; the
+// interned lookups take no lock.
+//
+// usage: testParseThreads [maxThreads] [messagesPerThread]
+
+#include "resip/stack/SipMessage.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/ThreadIf.hxx"
+#include "rutil/Timer.hxx"
+
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace resip;
+using namespace std;
+
+static const Data registerMessage(
+   "REGISTER sip:registrar.voice.example.com SIP/2.0\r\n"
+   "Via: SIP/2.0/UDP edge-proxy-01.voice.example.com:5060;branch=z9hG4bKnashds7\r\n"
+   "Via: SIP/2.0/UDP handset-4417.clients.example.net:5060;branch=z9hG4bKnashds8;rport\r\n"
+   "Max-Forwards: 69\r\n"
+   "To: Bob <sip:bob@registrar.voice.example.com>\r\n"
+   "From: Bob <sip:bob@registrar.voice.example.com>;tag=456248\r\n"
+   "Call-ID: 843817637684230@998sdasdh09\r\n"
+   "CSeq: 1826 REGISTER\r\n"
+   "Route: <sip:edge-proxy-01.voice.example.com;lr>\r\n"
+   "Contact: <sip:bob@handset-4417.clients.example.net:5060>\r\n"
+   "Expires: 7200\r\n"
+   "Content-Length: 0\r\n"
+   "\r\n");
+
+class ParseThread : public ThreadIf
+{
+   public:
+      ParseThread(unsigned int messages) : mMessages(messages) {}
+
+      virtual void thread()
+      {
+         for (unsigned int i = 0; i < mMessages; ++i)
+         {
+            SipMessage* msg = SipMessage::make(registerMessage);
+            assert(msg);
+            size_t hosts = msg->header(h_RequestLine).uri().host().size();
+            for (Vias::iterator v = msg->header(h_Vias).begin(); v != msg->header(h_Vias).end(); ++v)
+            {
+               hosts += v->sentHost().size();
+            }
+            hosts += msg->header(h_To).uri().host().size();
+            hosts += msg->header(h_From).uri().host().size();
+            hosts += msg->header(h_Routes).front().uri().host().size();
+            hosts += msg->header(h_Contacts).front().uri().host().size();
+            assert(hosts > 0);
+            delete msg;
+         }
+      }
+
+   private:
+      unsigned int mMessages;
+};
+
+static void
+run(const char* label, unsigned int maxThreads, unsigned int messagesPerThread)
+{
+   for (unsigned int numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+   {
+      vector<ParseThread*> threads;
+      UInt64 start = Timer::getTimeMs();
+      for (unsigned int i = 0; i < numThreads; ++i)
+      {
+         threads.push_back(new ParseThread(messagesPerThread));
+         threads.back()->run();
+      }
+      for (unsigned int i = 0; i < numThreads; ++i)
+      {
+         threads[i]->join();
+         delete threads[i];
+      }
+      UInt64 elapsed = Timer::getTimeMs() - start;
+      UInt64 total = (UInt64)numThreads * messagesPerThread;
+      cout << label << " threads=" << numThreads << ": " << total << " messages in "
+           << elapsed << "ms (" << (elapsed ? total * 1000 / elapsed : 0) << " messages/s)" << endl;
+   }
+}
+
+int
+main(int argc, char** argv)
+{
+   unsigned int maxThreads = argc > 1 ? atoi(argv[1]) : 4;
+   unsigned int messagesPerThread = argc > 2 ? atoi(argv[2]) : 50000;
+
+   assert(Data::getInternedCount() == 0);
+   run("nothing interned", maxThreads, messagesPerThread);
+
+   Data::intern("registrar.voice.example.com");
+   Data::intern("edge-proxy-01.voice.example.com");
+   run("hosts interned  ", maxThreads, messagesPerThread);
+
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
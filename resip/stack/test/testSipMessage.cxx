@@ -3,6 +3,8 @@
 
 #include "rutil/DataStream.hxx"
 #include "resip/stack/SipMessage.hxx"
+#include "resip/stack/SipMessageEncoder.hxx"
+#include "resip/stack/ExtensionHeader.hxx"
 #include "resip/stack/Helper.hxx"
 #include "resip/stack/Uri.hxx"
 #include "resip/stack/Helper.hxx"
@@ -64,6 +66,111 @@ main(int argc, char** argv)
       //InfoLog(<< response);
    }
 
+   {
+      // encodeToBuffer must produce exactly what encode(EncodeStream&) does,
+      // whether headers are re-emitted verbatim or re-encoded
+      Data txt("INVITE sip:bob@biloxi.com SIP/2.0\r\n"
+         "Via: SIP/2.0/UDP pc33.atlanta.com;branch=z9hG4bK776asdhds, SIP/2.0/UDP 10.0.0.1;branch=z9hG4bK77ef4c2312983.1\r\n"
+         "Max-Forwards: 70\r\n"
+         "To: Bob <sip:bob@biloxi.com>\r\n"
+         "From: Alice <sip:alice@atlanta.com>;tag=1928301774\r\n"
+         "Call-ID: a84b4c76e66710@pc33.atlanta.com\r\n"
+         "CSeq: 314159 INVITE\r\n"
+         "Contact: <sip:alice@pc33.atlanta.com>\r\n"
+         "Supported: replaces, timer\r\n"
+         "X-Unknown: first\r\n"
+         "X-Unknown: second\r\n"
+         "Content-Type: application/sdp\r\n"
+         "Content-Length: 31\r\n"
+         "\r\n"
+         "v=0\r\n"
+         "o=alice 2890844526 2890844526\r\n");
+
+      auto_ptr<SipMessage> msg(SipMessage::make(txt, true /* isExternal */));
+      SipMessageEncoder encoder;
+
+      Data buffer;
+      msg->encodeToBuffer(buffer, encoder);
+      assert(buffer == Data::from(*msg));
+
+      msg->header(h_MaxForwards).value()--;
+      msg->header(h_Vias).push_front(Via());
+      msg->header(h_Vias).front().sentHost() = "proxy.atlanta.com";
+      msg->header(h_RecordRoutes).push_back(NameAddr("<sip:proxy.atlanta.com;lr>"));
+      msg->header(ExtensionHeader("X-Unknown")).push_back(StringCategory("third"));
+      msg->header(h_Supporteds).front().value() = "100rel";
+      buffer.clear();
+      msg->encodeToBuffer(buffer, encoder);
+      assert(buffer == Data::from(*msg));
+
+      // dirty body, and appending to a buffer that already has something in it
+      msg->setContents(auto_ptr<Contents>(new PlainContents("hello world")));
+      buffer = "prefix";
+      msg->encodeToBuffer(buffer, encoder);
+      assert(buffer == "prefix" + Data::from(*msg));
+
+      SipMessage response;
+      Helper::makeResponse(response, *msg, 180);
+      Data responseBuffer;
+      response.encodeToBuffer(responseBuffer);
+      assert(responseBuffer == Data::from(response));
+   }
+
+   {
+      // Copies share the receive buffer of the original; unmodified header
+      // values and the body are not copied, and stay valid when the original
+      // goes away
+      Data txt("INVITE sip:bob@biloxi.com SIP/2.0\r\n"
+         "Via: SIP/2.0/UDP pc33.atlanta.com;branch=z9hG4bK776asdhds\r\n"
+         "Max-Forwards: 70\r\n"
+         "To: Bob <sip:bob@biloxi.com>\r\n"
+         "From: Alice <sip:alice@atlanta.com>;tag=1928301774\r\n"
+         "Call-ID: a84b4c76e66710@pc33.atlanta.com\r\n"
+         "CSeq: 314159 INVITE\r\n"
+         "Contact: <sip:alice@pc33.atlanta.com>\r\n"
+         "X-Unknown: first\r\n"
+         "Content-Type: text/plain\r\n"
+         "Content-Length: 36\r\n"
+         "\r\n"
+         "v=0\r\n"
+         "o=alice 2890844526 2890844526\r\n");
+
+      auto_ptr<SipMessage> msg(SipMessage::make(txt, true /* isExternal */));
+      // parsed header values are copied, unparsed ones are shared
+      assert(msg->header(h_To).uri().user() == "bob");
+      const Data encoded(Data::from(*msg));
+
+      auto_ptr<SipMessage> branch1(static_cast<SipMessage*>(msg->clone()));
+      SipMessage branch2(*msg);
+      assert(Data::from(*branch1) == encoded);
+      assert(Data::from(branch2) == encoded);
+      assert(branch1->getRawHeader(Headers::CallID)->front()->getBuffer() ==
+             msg->getRawHeader(Headers::CallID)->front()->getBuffer());
+      assert(branch1->getRawHeader(Headers::To)->getParserContainer() != 0);
+      assert(branch1->getRawBody().getBuffer() == msg->getRawBody().getBuffer());
+
+      branch1->header(h_RequestLine).uri() = Uri("sip:bob@192.0.2.1");
+      branch1->header(h_Vias).push_front(Via());
+      branch1->header(h_Vias).front().sentHost() = "proxy.atlanta.com";
+      branch1->header(h_MaxForwards).value()--;
+      branch2.header(h_RequestLine).uri() = Uri("sip:bob@192.0.2.2");
+      assert(Data::from(*msg) == encoded);
+
+      msg.reset();
+      SipMessage branch3(*branch1);
+      branch1.reset();
+      assert(branch3.header(h_RequestLine).uri().host() == "192.0.2.1");
+      assert(branch3.header(h_Vias).size() == 2);
+      assert(branch3.header(h_Vias).back().sentHost() == "pc33.atlanta.com");
+      assert(branch3.header(h_CallId).value() == "a84b4c76e66710@pc33.atlanta.com");
+      assert(branch3.header(ExtensionHeader("X-Unknown")).front().value() == "first");
+      assert(branch3.getContents()->getBodyData() == "v=0\r\no=alice 2890844526 2890844526\r\n");
+      assert(branch2.header(h_To).uri().user() == "bob");
+
+      branch2 = branch3;
+      assert(Data::from(branch2) == Data::from(branch3));
+   }
+
    static ExtensionParameter p_tag_ext("tag");
    {
       Data txt(
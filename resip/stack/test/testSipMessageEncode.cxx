@@ -4,6 +4,7 @@
 
 
 #include "resip/stack/SipMessage.hxx"
+#include "resip/stack/SipMessageEncoder.hxx"
 #include <fstream>
 #include <string>
 
@@ -14,14 +15,79 @@ class Args
 {
 public:
 
-	Args(void):runs(100000),runFs(false),runDs(true)
+	Args(void):runs(100000),runFs(false),runDs(true),runBuf(true)
 	{}
 
 	int runs;
 	bool runFs;
 	bool runDs;
+	bool runBuf;
 };
 
+// Encodes the way TransportSelector::transmit used to: through a DataStream into a
+// buffer reserved using a moving average of the message size
+static double
+timeStreamEncode(const SipMessage& msg, int runs, Data& result)
+{
+	int avgBufferSize = 1024;
+	UInt64 startTime = Timer::getTimeMs();
+	for(int i=0; i<runs; i++)
+	{
+		Data data;
+		data.reserve(avgBufferSize + avgBufferSize/4);
+		{
+			DataStream str(data);
+			msg.encode(str);
+		}
+		avgBufferSize = (255*avgBufferSize + (int)data.size()+128)/256;
+		if(i == 0)
+		{
+			result = data;
+		}
+	}
+	return (double)(Timer::getTimeMs() - startTime) / 1000.0;
+}
+
+// Encodes the way TransportSelector::transmit does now
+static double
+timeBufferEncode(const SipMessage& msg, int runs, Data& result)
+{
+	SipMessageEncoder encoder;
+	UInt64 startTime = Timer::getTimeMs();
+	for(int i=0; i<runs; i++)
+	{
+		Data data;
+		msg.encodeToBuffer(data, encoder);
+		if(i == 0)
+		{
+			result = data;
+		}
+	}
+	return (double)(Timer::getTimeMs() - startTime) / 1000.0;
+}
+
+static void
+compareEncoders(const char* description, const SipMessage& msg, int runs)
+{
+	Data streamResult;
+	Data bufferResult;
+	double streamSecs = timeStreamEncode(msg, runs, streamResult);
+	double bufferSecs = timeBufferEncode(msg, runs, bufferResult);
+	cout << "\r\n" << description << ", runs = " << runs << "\r\n"
+	     << "   DataStream encode:  " << streamSecs << " seconds\r\n"
+	     << "   encodeToBuffer:     " << bufferSecs << " seconds";
+	if(bufferSecs > 0)
+	{
+		cout << " (" << streamSecs / bufferSecs << "x)";
+	}
+	cout << "\r\n";
+	if(streamResult != bufferResult)
+	{
+		cout << "Error: encodings differ\r\n" << streamResult << "\r\n" << bufferResult << "\r\n";
+		exit(-1);
+	}
+}
+
 void processArgs(int argc, char* argv[],Args &args);
 
 int
@@ -31,7 +97,7 @@ main(int argc, char* argv[])
 
 	cout << "\r\n------------------------------------------------------\r\n";
 	cout << "Resiprocate resip::SipMessage encoder speed test rev 1.0\r\n";
-	cout << "Args: [-r <number of runs>] [-runfs=(yes|no)] [-runds=(yes|no)]\r\n";
+	cout << "Args: [-r <number of runs>] [-runfs=(yes|no)] [-runds=(yes|no)] [-runbuf=(yes|no)]\r\n";
 	cout << "Example: -r 100000 -runfs=yes -runds=no\r\n";
 	cout << "------------------------------------------------------------\r\n";
 
@@ -127,6 +193,38 @@ main(int argc, char* argv[])
 		cout << "\r\nOutput to resip::DataStream completed, elapsed time= " << secs << " seconds.\r\n";
 	}
 
+	if( args.runBuf )
+	{
+		// Relayed unchanged - every header is re-emitted verbatim
+		compareEncoders("Received message", *msg, args.runs);
+
+		// Modified the way a proxy modifies a request it forwards
+		SipMessage forwarded(*msg);
+		forwarded.header(h_RequestLine).uri().host() = "192.168.2.93";
+		forwarded.header(h_MaxForwards).value()--;
+		Via via;
+		via.sentHost() = "192.168.2.1";
+		via.sentPort() = 5060;
+		via.param(p_branch).reset("z9hG4bK-524287-1---6f9e9a1c7c9f1d6a");
+		forwarded.header(h_Vias).push_front(via);
+		NameAddr rr("<sip:192.168.2.1:5060;lr>");
+		forwarded.header(h_RecordRoutes).push_front(rr);
+		compareEncoders("Forwarded (modified) message", forwarded, args.runs);
+
+		// Every header parsed and accessed non-const - everything is re-encoded
+		SipMessage created(*msg);
+		created.header(h_RequestLine).uri();
+		created.header(h_To).uri();
+		created.header(h_From).uri();
+		created.header(h_CallId).value();
+		created.header(h_CSeq).sequence();
+		created.header(h_Contacts).front().uri();
+		created.header(h_Vias).front().sentHost();
+		created.header(h_MaxForwards).value();
+		created.header(h_ContentType).type();
+		compareEncoders("Parsed and accessed (dirty) message", created, args.runs);
+	}
+
 	cout << "Test complete.\r\n";
 
 	return 0;
@@ -170,6 +268,10 @@ void processArgs(int argc, char* argv[],Args &args)
 				args.runFs = false;
 			}
 		}
+		else if( arg.substr(0,8) == "-runbuf=" )
+		{
+			args.runBuf = (arg.substr(8) == "yes");
+		}
 		else if( arg.substr(0,7) == "-runds=" )
 		{
 			if( arg.substr(7) == "yes" )
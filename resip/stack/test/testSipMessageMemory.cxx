@@ -4,13 +4,107 @@
 
 #include <iostream>
 #include <memory>
+#include <new>
+#include <stdlib.h>
 
 using namespace resip;
 using namespace std;
 
+// Count heap allocations, to measure what parsing and copying a message costs
+static unsigned long allocations = 0;
+
+#if __cplusplus >= 201103L
+#define NEW_THROWS
+#define DELETE_THROWS noexcept
+#else
+#define NEW_THROWS throw(std::bad_alloc)
+#define DELETE_THROWS throw()
+#endif
+
+void* operator new(size_t size) NEW_THROWS
+{
+   ++allocations;
+   void* p = malloc(size ? size : 1);
+   if (!p) throw std::bad_alloc();
+   return p;
+}
+void* operator new[](size_t size) NEW_THROWS
+{
+   ++allocations;
+   void* p = malloc(size ? size : 1);
+   if (!p) throw std::bad_alloc();
+   return p;
+}
+void operator delete(void* p) DELETE_THROWS { free(p); }
+void operator delete[](void* p) DELETE_THROWS { free(p); }
+
+struct AllocationCounts
+{
+   unsigned long parse;
+   unsigned long copy;
+};
+
+static AllocationCounts
+countAllocations(const Data& txt)
+{
+   AllocationCounts counts;
+   unsigned long start = allocations;
+   auto_ptr<SipMessage> message(TestSupport::makeMessage(txt));
+   message->header(h_RequestLine).uri().host();
+   message->header(h_Vias).front().sentHost();
+   message->header(h_To).uri().host();
+   message->header(h_From).param(p_tag);
+   message->header(h_CallId).value();
+   message->header(h_CSeq).sequence();
+   message->header(h_Contacts).front().uri().host();
+   message->header(h_RecordRoutes).front().uri().host();
+   counts.parse = allocations - start;
+
+   start = allocations;
+   {
+      SipMessage copy(*message);
+   }
+   counts.copy = allocations - start;
+   return counts;
+}
+
 int
 main()
 {
+   {
+      resipCerr << "Counting allocations (Data local size " << RESIP_DATA_LOCAL_SIZE << ")" << endl;
+
+      const Data txt("INVITE sip:bob@biloxi.voice.example.com SIP/2.0\r\n"
+                     "Via: SIP/2.0/UDP proxy.atlanta.voice.example.com;branch=z9hG4bK-524287-1---776asdhds\r\n"
+                     "Via: SIP/2.0/UDP pc33.atlanta.voice.example.com;branch=z9hG4bK-524287-1---4b43c2ff8\r\n"
+                     "Max-Forwards: 70\r\n"
+                     "To: Bob <sip:bob@biloxi.voice.example.com>\r\n"
+                     "From: Alice <sip:alice@atlanta.voice.example.com>;tag=1928301774\r\n"
+                     "Call-ID: a84b4c76e66710@pc33.atlanta.voice.example.com\r\n"
+                     "CSeq: 314159 INVITE\r\n"
+                     "Contact: <sip:alice@pc33.atlanta.voice.example.com;transport=udp>\r\n"
+                     "Record-Route: <sip:proxy.atlanta.voice.example.com;lr>\r\n"
+                     "Content-Length: 0\r\n\r\n");
+
+      countAllocations(txt);  // warm up function statics
+      AllocationCounts before = countAllocations(txt);
+      resipCerr << "  parse: " << before.parse << " allocations, copy: " << before.copy << " allocations" << endl;
+
+      // Intern our own domains, as a proxy would
+      Data::intern("biloxi.voice.example.com");
+      Data::intern("atlanta.voice.example.com");
+      Data::intern("proxy.atlanta.voice.example.com");
+      AllocationCounts interned = countAllocations(txt);
+      resipCerr << "  with interned domains - parse: " << interned.parse << " allocations, copy: " << interned.copy << " allocations" << endl;
+
+      assert(interned.parse <= before.parse);
+      if (RESIP_DATA_LOCAL_SIZE < 24)
+      {
+         // The interned host names spill out of the local buffer
+         assert(interned.copy < before.copy);
+      }
+   }
+
    {
       const char *txt1 = "REGISTER sip:registrar.biloxi.com SIP/2.0\r\nVia: SIP/2.0/UDP bobspc.biloxi.com:5060;branch=z9hG4bKnashds7\r\nMax-Forwards: 70\r\nTo: Bob <sip:bob@biloxi.com>\r\nFrom: Bob <sip:bob@biloxi.com>;tag=456248\r\nCall-ID: 843817637684230@998sdasdh09\r\nCSeq: 1826 REGISTER\r\nContact: <sip:bob@192.0.2.4>\r\nExpires: 7200\r\nContent-Length: 0\r\n\r\n";
 
@@ -166,6 +166,14 @@ class SipStackAndThread
       SipStack&         operator*() const { assert(mStack); return *mStack; }
       SipStack*         operator->() const { return mStack; }
 
+      /// wakeup syscalls made by our interruptor (0 if none)
+      unsigned long getWakeupCount() const
+      {
+         if ( mEventIntr ) return mEventIntr->getWakeupCount();
+         if ( mSelIntr ) return mSelIntr->getWakeupCount();
+         return 0;
+      }
+
       void setCongestionManager(CongestionManager* cm)
       {
          mStack->setCongestionManager(cm);
@@ -221,6 +229,7 @@ SipStackAndThread::SipStackAndThread(const char *tType,
    }
    else if ( strcmp(tType,"event")==0
           || strcmp(tType,"epoll")==0
+          || strcmp(tType,"uring")==0
           || strcmp(tType,"fdset")==0
           || strcmp(tType,"poll")==0 )
    {
@@ -792,6 +801,14 @@ main(int argc, char* argv[])
       bindIfAddr, numPorts, senderPort, registrarPort, proto,
       sendSleepMs, pair);
 
+   cout << "Interruptor wakeups: sender=" << sender.getWakeupCount()
+        << " receiver=" << receiver.getWakeupCount();
+   if ( commonIntr )
+   {
+      cout << " common=" << commonIntr->getWakeupCount();
+   }
+   cout << endl;
+
    sender.shutdown();
    receiver.shutdown();
 
@@ -236,6 +236,13 @@ main(int argc, char* argv[])
    cout << runs << " calls peformed in " << elapsed << " ms, a rate of " 
         << runs / ((float) elapsed / 1000.0) << " calls per second.]" << endl;
 
+   // queued messages are gathered into as few writes as possible
+   const ConnectionManager& connectionManager = sender->getConnectionManager();
+   assert(connectionManager.getMessagesWritten() == (UInt64)runs);
+   assert(connectionManager.getWrites() > 0);
+   cout << connectionManager.getMessagesWritten() << " messages sent in " << connectionManager.getWrites() 
+        << " writes, at most " << connectionManager.getMaxMessagesPerWrite() << " messages per write" << endl;
+
    SipMessage::checkContentLength=false;
    {
       UInt64 startTime = Timer::getTimeMs();
@@ -16,6 +16,8 @@
 #include "rutil/ParseBuffer.hxx"
 #include "rutil/vmd5.hxx"
 #include "rutil/Coders.hxx"
+#include "rutil/Lock.hxx"
+#include "rutil/Mutex.hxx"
 #include "rutil/WinLeakCheck.hxx"
 
 #ifdef WIN32
@@ -269,6 +271,137 @@ Data::Data(const char* str, size_type length, bool)
    resip_assert(str);
 }
 
+// Intern pool - values are appended to a fixed arena and never removed, so 
+// checking whether a buffer is interned is just a range check, with no 
+// locking.  The index is an open addressed table of pointers into the arena
+// that is only ever added to: intern() writes the value and its size before
+// publishing the pointer to a slot (under internMutex, which only serializes
+// writers), so useInterned() - on the parser's hot path, in every thread -
+// can probe it without taking a lock.
+static char internArena[RESIP_DATA_INTERN_POOL_SIZE];
+static size_t internArenaUsed = 0;
+static Mutex internMutex;
+static volatile size_t internCount = 0;
+
+struct InternSlot
+{
+   const char* volatile mBuf;
+   Data::size_type mSize;
+};
+// Every pooled value takes more than RESIP_DATA_LOCAL_SIZE bytes of arena,
+// so the table is never more than half full and a probe always ends
+static const size_t InternSlots = 2 * (RESIP_DATA_INTERN_POOL_SIZE / (RESIP_DATA_LOCAL_SIZE + 1)) + 1;
+static InternSlot internIndex[InternSlots];
+
+static inline const char*
+loadInternSlot(const InternSlot& slot)
+{
+#if defined(__GNUC__)
+   return __atomic_load_n(&slot.mBuf, __ATOMIC_ACQUIRE);
+#else
+   return slot.mBuf;  // volatile reads have acquire semantics with MSVC
+#endif
+}
+
+static inline void
+publishInternSlot(InternSlot& slot, const char* buf, Data::size_type size)
+{
+   slot.mSize = size;
+#if defined(__GNUC__)
+   __atomic_store_n(&slot.mBuf, buf, __ATOMIC_RELEASE);
+#else
+   slot.mBuf = buf;  // volatile writes have release semantics with MSVC
+#endif
+}
+
+// Returns the slot holding a value equal to buf, or the empty slot it would go in
+static InternSlot&
+findInternSlot(const char* buf, Data::size_type size, size_t hash)
+{
+   for (size_t i = hash % InternSlots; ; i = (i + 1) % InternSlots)
+   {
+      const char* pooled = loadInternSlot(internIndex[i]);
+      if (!pooled || (internIndex[i].mSize == size && memcmp(pooled, buf, size) == 0))
+      {
+         return internIndex[i];
+      }
+   }
+}
+
+static inline bool
+isInternedBuffer(const char* buf)
+{
+   return buf >= internArena && buf < internArena + sizeof(internArena);
+}
+
+Data
+Data::intern(const Data& data)
+{
+   if (data.mSize < LocalAlloc)
+   {
+      return data;
+   }
+   if (isInternedBuffer(data.mBuf))
+   {
+      return Data(Share, data.mBuf, data.mSize);
+   }
+
+   Lock lock(internMutex);
+   InternSlot& slot = findInternSlot(data.mBuf, data.mSize, data.fastHash());
+   if (slot.mBuf)
+   {
+      return Data(Share, slot.mBuf, slot.mSize);
+   }
+   if (data.mSize + 1 > sizeof(internArena) - internArenaUsed)
+   {
+      return data;  // pool is full
+   }
+   char* buf = internArena + internArenaUsed;
+   memcpy(buf, data.mBuf, data.mSize);
+   buf[data.mSize] = 0;
+   internArenaUsed += data.mSize + 1;
+   publishInternSlot(slot, buf, data.mSize);
+   internCount = internCount + 1;
+   return Data(Share, buf, data.mSize);
+}
+
+bool
+Data::useInterned()
+{
+   if (internCount == 0 || mSize < LocalAlloc || isInternedBuffer(mBuf))
+   {
+      return false;
+   }
+
+   const InternSlot& slot = findInternSlot(mBuf, mSize, fastHash());
+   const char* pooled = loadInternSlot(slot);
+   if (!pooled)
+   {
+      return false;
+   }
+   if (mShareEnum == Take)
+   {
+      delete[] mBuf;
+   }
+   mBuf = const_cast<char*>(pooled);
+   mCapacity = mSize;
+   mShareEnum = Share;
+   return true;
+}
+
+size_t
+Data::getInternedCount()
+{
+   return internCount;
+}
+
+size_t
+Data::getInternedBytes()
+{
+   Lock lock(internMutex);
+   return internArenaUsed;
+}
+
 void
 Data::initFromString(const char* str, size_type len)
 {
@@ -285,6 +418,14 @@ Data::initFromString(const char* str, size_type len)
    }
    if(bytes > LocalAlloc)
    {
+      if(isInternedBuffer(str))
+      {
+         // Immutable, lives forever - share it
+         mBuf = const_cast<char*>(str);
+         mCapacity = mSize;
+         mShareEnum = Share;
+         return;
+      }
       mBuf = new char[bytes];
       mCapacity = mSize;
       mShareEnum = Take;
@@ -690,6 +831,20 @@ Data::duplicate(const Data& other)
 Data&
 Data::copy(const char *buf, size_type length)
 {
+   if (length >= LocalAlloc && isInternedBuffer(buf) &&
+       (mShareEnum != Data::Borrow || mBuf == mPreBuffer))
+   {
+      // Immutable, lives forever - share it instead of copying
+      if (mShareEnum == Data::Take)
+      {
+         delete[] mBuf;
+      }
+      mBuf = const_cast<char*>(buf);
+      mSize = length;
+      mCapacity = length;
+      mShareEnum = Share;
+      return *this;
+   }
    if (mShareEnum == Data::Share || mCapacity < length+1)
    {
       // will alloc length+1, so the term NULL below is safe
@@ -1042,6 +1197,11 @@ Data::operator+(char c) const
 const char* 
 Data::c_str() const
 {
+   if (mShareEnum == Data::Share && isInternedBuffer(mBuf) && mBuf[mSize] == 0)
+   {
+      // Interned values are stored null terminated
+      return mBuf;
+   }
    if (mShareEnum == Data::Share || mSize == mCapacity)
    {
       const_cast<Data*>(this)->resize(mSize+1,true);
@@ -2140,12 +2300,115 @@ bits(size_t v)
    return ret;
 }
 
+// Word-at-a-time hash in the style of wyhash: 16 bytes per step, each step 
+// a single 64x64->128 bit multiply.  The tail is read with (possibly 
+// overlapping) 8 or 4 byte loads, so there is no per-byte loop at all.
+// Loads go through memcpy, which compiles to a plain (unaligned) load.
+static const UInt64 fastHashP0 = 0xa0761d6478bd642fULL;
+static const UInt64 fastHashP1 = 0xe7037ed1a0b428dbULL;
+static const UInt64 fastHashP2 = 0x8ebc6af09c88c6e3ULL;
+static const UInt64 caseMask64 = 0x2020202020202020ULL;
+
+static inline UInt64
+fastHashMix(UInt64 a, UInt64 b)
+{
+#if defined(__SIZEOF_INT128__)
+   unsigned __int128 r = (unsigned __int128)a * b;
+   return (UInt64)r ^ (UInt64)(r >> 64);
+#else
+   // 64x64->128 multiply from 32 bit halves
+   UInt64 ha = a >> 32, hb = b >> 32, la = (UInt32)a, lb = (UInt32)b;
+   UInt64 rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+   UInt64 t = rl + (rm0 << 32);
+   UInt64 c = t < rl;
+   UInt64 lo = t + (rm1 << 32);
+   c += lo < t;
+   UInt64 hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+   return lo ^ hi;
+#endif
+}
+
+static inline UInt64
+fastHashLoad64(const unsigned char* p)
+{
+   UInt64 v;
+   memcpy(&v, p, sizeof(v));
+   return v;
+}
+
+static inline UInt64
+fastHashLoad32(const unsigned char* p)
+{
+   UInt32 v;
+   memcpy(&v, p, sizeof(v));
+   return v;
+}
+
+// fold is ORed into every byte - 0 for an exact hash, 0x20 to fold case
+static inline size_t
+fastHashImpl(const unsigned char* p, size_t len, UInt64 fold)
+{
+   UInt64 seed = fastHashP0 ^ len;
+   size_t rem = len;
+   while (rem > 16)
+   {
+      seed = fastHashMix((fastHashLoad64(p) | fold) ^ fastHashP1, 
+                         (fastHashLoad64(p + 8) | fold) ^ seed);
+      p += 16;
+      rem -= 16;
+   }
+
+   UInt64 a = 0, b = 0;
+   if (rem >= 8)
+   {
+      a = fastHashLoad64(p) | fold;
+      b = fastHashLoad64(p + rem - 8) | fold;
+   }
+   else if (rem >= 4)
+   {
+      a = fastHashLoad32(p) | (UInt32)fold;
+      b = fastHashLoad32(p + rem - 4) | (UInt32)fold;
+   }
+   else if (rem > 0)
+   {
+      UInt64 foldByte = fold & 0xff;
+      a = ((UInt64)(p[0] | foldByte) << 16) | 
+          ((UInt64)(p[rem >> 1] | foldByte) << 8) | 
+          (p[rem - 1] | foldByte);
+   }
+   return (size_t)fastHashMix(fastHashP2 ^ len, fastHashMix(a ^ fastHashP1, b ^ seed));
+}
+
+size_t
+Data::rawFastHash(const unsigned char* c, size_t size)
+{
+   return fastHashImpl(c, size, 0);
+}
+
+size_t
+Data::rawFastCaseInsensitiveTokenHash(const unsigned char* c, size_t size)
+{
+   return fastHashImpl(c, size, caseMask64);
+}
+
 size_t
 Data::hash() const
 {
    return rawHash((const unsigned char*)(this->data()), this->size());
 }
 
+size_t
+Data::fastHash() const
+{
+   return rawFastHash((const unsigned char*)(this->data()), this->size());
+}
+
+size_t
+Data::fastCaseInsensitiveTokenHash() const
+{
+   return rawFastCaseInsensitiveTokenHash((const unsigned char*)(this->data()), this->size());
+}
+
 size_t
 Data::caseInsensitivehash() const
 {
@@ -2158,95 +2421,44 @@ Data::caseInsensitiveTokenHash() const
    return rawCaseInsensitiveTokenHash((const unsigned char*)(this->data()), this->size());
 }
 
-#define compUnalignedRemainder(d1, d2, size) \
-switch(size) \
-{\
-   case 3:                                         \
-      if( (*d1 ^ *d2) & 0xDF)                      \
-      {                                            \
-         return false;                             \
-      }                                            \
-      d1++;                                        \
-      d2++;                                        \
-      /* fallthrough */                            \
-   case 2:                                         \
-      if((get16bits(d1) ^ get16bits(d2)) & 0xDFDF) \
-      {                                            \
-         return false;                             \
-      }                                            \
-      d1+=2;                                       \
-      d2+=2;                                       \
-      break;                                       \
-   case 1:                                         \
-      if( (*d1 ^ *d2) & 0xDF)                      \
-      {                                            \
-         return false;                             \
-      }                                            \
-      d1++;                                        \
-      d2++;                                        \
-      /* fallthrough */                            \
-   default:                                        \
-      ;                                            \
-}\
-
 bool 
 Data::sizeEqualCaseInsensitiveTokenCompare(const Data& rhs) const
 {
    resip_assert(mSize==rhs.mSize);
-   const char* d1(mBuf);
-   const char* d2(rhs.mBuf);
-
-   if(mSize < 4)
-   {
-      // No point in trying 32-bit ops.
-      compUnalignedRemainder(d1, d2, mSize);
-      return true;
-   }
-
-   int unalignedPrefix(4-((ptrdiff_t)d1 & 3));
-
-   compUnalignedRemainder(d1, d2, unalignedPrefix);
-
-   // We are now on a 32-bit boundary with d1.
-   UInt32* wd1((UInt32*)(d1));
-   size_t wordLen=(mSize-unalignedPrefix)>>2;
-   int rem=(mSize-unalignedPrefix)&3;
-
-   if((ptrdiff_t)(d2)%4==0)
-   {
-      // d2 is aligned too. Happy day!
-      UInt32* wd2((UInt32*)(d2));
-      for (;wordLen > 0; wordLen--)
+   const unsigned char* d1((const unsigned char*)mBuf);
+   const unsigned char* d2((const unsigned char*)rhs.mBuf);
+   size_t len(mSize);
+
+   // bitwise xor is zero iff equal, but we only really care about bits 
+   // other than bit 6, so we mask out bit 6 after the xor.  Compare 8 bytes
+   // at a time; the tail is compared with one (overlapping) load from the 
+   // end, rather than byte by byte.
+   if(len >= 8)
+   {
+      const UInt64 mask = ~caseMask64;
+      size_t i = 0;
+      for(; i + 8 <= len; i += 8)
       {
-         // bitwise xor is zero iff equal, but we only really care about bits 
-         // other than bit 6, so we mask out bit 6 after the xor.
-         if( (*wd1 ^ *wd2) & 0xDFDFDFDF)
+         if((fastHashLoad64(d1 + i) ^ fastHashLoad64(d2 + i)) & mask)
          {
             return false;
          }
-         wd1++;
-         wd2++;
       }
-      d2=(const char*)wd2;
+      return i == len || 
+             !((fastHashLoad64(d1 + len - 8) ^ fastHashLoad64(d2 + len - 8)) & mask);
    }
-   else
+   if(len >= 4)
    {
-      for (;wordLen > 0; wordLen--)
+      return !((fastHashLoad32(d1) ^ fastHashLoad32(d2)) & 0xDFDFDFDF) &&
+             !((fastHashLoad32(d1 + len - 4) ^ fastHashLoad32(d2 + len - 4)) & 0xDFDFDFDF);
+   }
+   for(; len > 0; --len)
+   {
+      if((*d1++ ^ *d2++) & 0xDF)
       {
-         // bitwise xor is zero iff equal, but we only really care about bits 
-         // other than bit 6, so we mask out bit 6 after the xor.
-         UInt32 test=get32bits(d2);
-         if( (*wd1 ^ test) & 0xDFDFDFDF)
-         {
-            return false;
-         }
-         wd1++;
-         d2+=4;
+         return false;
       }
    }
-   d1=(const char*)wd1;
-
-   compUnalignedRemainder(d1, d2, rem);
    return true;
 }
 
@@ -2363,7 +2575,11 @@ Data::fromFile(const Data& filename)
    return target;
 }
 
+#ifdef RESIP_DATA_LEGACY_HASH
 HashValueImp(resip::Data, data.hash());
+#else
+HashValueImp(resip::Data, data.fastHash());
+#endif
 
 static signed char base64Lookup[128] = 
 {
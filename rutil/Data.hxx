@@ -15,10 +15,24 @@
 #include "rutil/HeapInstanceCounter.hxx"
 #include "rutil/HashMap.hxx"
 
+// Bytes of inline storage in each Data - anything longer is allocated on the
+// heap.  Can be set with configure --with-data-local-size=N; 32 keeps most 
+// branch ids, tags and host names inline, at the cost of larger objects.
 #ifndef RESIP_DATA_LOCAL_SIZE
 #define RESIP_DATA_LOCAL_SIZE 16
 #endif
 
+// Bytes of process-wide storage for interned Data (see Data::intern)
+#ifndef RESIP_DATA_INTERN_POOL_SIZE
+#define RESIP_DATA_INTERN_POOL_SIZE 65536
+#endif
+
+// In-memory hash containers keyed on Data (HashMap<Data, ...>, the stack's
+// TransactionMap) use Data::fastHash and Data::fastCaseInsensitiveTokenHash.
+// Define RESIP_DATA_LEGACY_HASH (when building librutil and everything that
+// uses it) to have them use Data::hash and Data::caseInsensitiveTokenHash, 
+// as before.  Data::hash and friends return the same values either way.
+
 class TestData;
 namespace resip
 {
@@ -839,6 +853,39 @@ class Data
       */
       static bool init(DataLocalSize<RESIP_DATA_LOCAL_SIZE> arg);
 
+      /**
+        Adds a frequently repeated value (a domain, our own Via/Record-Route
+        host, etc.) to the process-wide intern pool, and returns a Data that
+        refers to the pooled copy.  
+
+        Interned storage is immutable and lives for the life of the process,
+        so a Data that refers to it is copied by sharing the storage rather 
+        than allocating, and c_str() does not need to copy it either.  
+        Modifying such a Data copies it first, as for any Share mode Data.
+
+        Values that fit in the inline buffer (RESIP_DATA_LOCAL_SIZE) are not
+        pooled, since copying them does not allocate anyway; neither are 
+        values that do not fit in what is left of the pool 
+        (RESIP_DATA_INTERN_POOL_SIZE).  In both cases a plain copy is 
+        returned.
+      */
+      static Data intern(const Data& data);
+
+      /**
+        If a value equal to this Data has been interned, makes this Data refer
+        to the pooled copy (releasing its own buffer) and returns true.  Never
+        adds to the pool, so it is safe to call on values received from the 
+        network; the parser uses it for host names.  Takes no lock, so 
+        parsing threads do not contend on it.
+      */
+      bool useInterned();
+
+      /**
+        Number of values, and bytes, in the intern pool.
+      */
+      static size_t getInternedCount();
+      static size_t getInternedBytes();
+
       /**
         Performs RFC 3548 Base 64 decoding of the contents of this data.
 
@@ -901,6 +948,39 @@ class Data
       */
       size_t caseInsensitiveTokenHash() const;
 
+      /**
+        Creates a hash based on the contents of the indicated buffer.  This
+        is a word-at-a-time hash (in the style of wyhash), and is much faster
+        than rawHash for anything but the shortest buffers.  
+        
+        @param c Pointer to the buffer to hash
+        @param size Number of bytes to be hashed
+        @note The value is not the same as rawHash, and may differ between
+            platforms and versions - use it for in-memory lookups, do not 
+            store it.
+      */
+      static size_t rawFastHash(const unsigned char* c, size_t size);
+
+      /**
+        Case-insensitive variant of rawFastHash, with the same RFC 3261 token
+        caveat as rawCaseInsensitiveTokenHash.
+
+        @param c Pointer to the buffer to hash
+        @param size Number of bytes to be hashed
+      */
+      static size_t rawFastCaseInsensitiveTokenHash(const unsigned char* c, size_t size);
+
+      /**
+        Creates a hash based on the contents of this Data, using rawFastHash.
+      */
+      size_t fastHash() const;
+
+      /**
+        Creates a case-insensitive hash based on the contents of this Data,
+        using rawFastCaseInsensitiveTokenHash.
+      */
+      size_t fastCaseInsensitiveTokenHash() const;
+
       inline bool caseInsensitiveTokenCompare(const Data& rhs) const
       {
          if(mSize==rhs.mSize)
@@ -11,6 +11,20 @@
 #ifdef RESIP_POLL_IMPL_EPOLL
 #  include <sys/epoll.h>
 #endif
+#ifdef RESIP_POLL_IMPL_URING
+#  include <linux/io_uring.h>
+#  ifdef IORING_RECV_MULTISHOT
+#    define RESIP_URING_DATAGRAM   // 6.0 headers, see FdPollImplUring
+#  endif
+#  include <sys/mman.h>
+#  include <sys/socket.h>
+#  include <sys/syscall.h>
+#  include <netinet/in.h>
+#  include <errno.h>
+#  include <poll.h>
+#  include <stdint.h>
+#  include <unistd.h>
+#endif
 
 using namespace resip;
 #define RESIPROCATE_SUBSYSTEM Subsystem::SIP
@@ -25,6 +39,10 @@ FdPollItemIf::~FdPollItemIf()
 {
 }
 
+FdPollDatagramIf::~FdPollDatagramIf()
+{
+}
+
 FdPollItemBase::FdPollItemBase(FdPollGrp *grp, Socket fd, FdPollEventMask mask) :
   mPollGrp(grp), mPollSocket(fd), mPollHandle(0)
 {
@@ -89,6 +107,21 @@ FdPollGrp::getEPollFd() const
    return -1;
 }
 
+FdPollItemHandle
+FdPollGrp::addDatagramItem(Socket fd, FdPollDatagramIf *item,
+                           unsigned maxLen, unsigned numBuffers)
+{
+   return 0;
+}
+
+void
+FdPollGrp::sendDatagram(FdPollItemHandle handle, const char* data,
+                        unsigned len, const sockaddr& to, socklen_t toLen,
+                        void* cookie)
+{
+   resip_assert(0);     // no impl without addDatagramItem() has items for this
+}
+
 /*****************************************************************
  *
  * FdPollImplFdSet
@@ -1219,6 +1252,1011 @@ FdPollImplEpoll::epollWait(int waitMs)
 
 #endif // RESIP_POLL_IMPL_EPOLL
 
+#ifdef RESIP_POLL_IMPL_URING
+/*****************************************************************
+ *
+ * FdPollImplUring
+ *
+ *****************************************************************/
+
+/**
+  This is an implementation built around io_uring. Readiness is
+  driven with IORING_OP_POLL_ADD requests: items with FPEM_Edge get
+  one multishot poll that stays armed across events, all other items
+  get a oneshot poll that is re-armed after their event has been
+  processed (which gives the same level-triggered behavior as epoll).
+
+  New, changed and re-armed polls are only queued in the submission
+  ring; they are handed to the kernel by the same io_uring_enter()
+  that waits for completions. So an iteration costs one syscall no
+  matter how many items changed their mask (with epoll, each
+  modPollItem() is an epoll_ctl()), and no syscall at all when
+  ms=0 and completions are already waiting in the ring.
+
+  The fd and a per-fd generation counter are stored in the user_data
+  of every poll. Modifying or deleting an item bumps the generation,
+  so completions of a cancelled poll (or for a recycled fd) are
+  recognized as stale and dropped. This is the "serial number"
+  alternative described for FdPollImplEpoll::killCache().
+
+  Datagram items (addDatagramItem(), used by UdpTransport) get no
+  readiness events at all. A multishot IORING_OP_RECVMSG receives into
+  a ring of buffers provided by the item (IORING_REGISTER_PBUF_RING,
+  buffer group id = fd); each completion hands one datagram to the
+  item, and the buffer (or a fresh one, if the item kept it) goes back
+  into the ring. sendDatagram() queues an IORING_OP_SENDMSG, so all
+  the sends of an iteration go to the kernel with the wait as well.
+
+  The user_data of every request says what it is (see makeUserData());
+  sends carry a pointer to their UringSendOp instead of fd/generation.
+
+  The rings are set up with the raw syscalls, so liburing is not
+  needed. init() fails (and create() falls back to epoll) if the
+  kernel lacks io_uring or the features used here (5.13 or later).
+  Datagram items also need multishot receives and
+  IORING_REGISTER_SYNC_CANCEL (6.0 or later); without them
+  addDatagramItem() returns 0 and the transports poll for readiness.
+**/
+
+namespace resip
+{
+
+class FdPollImplUring : public FdPollGrp
+{
+   public:
+      FdPollImplUring();
+      ~FdPollImplUring();
+
+      /// Set up the rings. Returns false if the kernel can't support us.
+      bool init(unsigned entries);
+
+      virtual const char*       getImplName() const { return "uring"; }
+      virtual ImplType getImplType() const { return URingImpl; }
+
+      virtual FdPollItemHandle  addPollItem(Socket fd,
+                                  FdPollEventMask newMask, FdPollItemIf *item);
+      virtual void              modPollItem(FdPollItemHandle handle,
+                                  FdPollEventMask newMask);
+      virtual void              delPollItem(FdPollItemHandle handle);
+      virtual FdPollItemHandle  addDatagramItem(Socket fd,
+                                  FdPollDatagramIf *item,
+                                  unsigned maxLen, unsigned numBuffers);
+      virtual void              sendDatagram(FdPollItemHandle handle,
+                                  const char* data, unsigned len,
+                                  const sockaddr& to, socklen_t toLen,
+                                  void* cookie);
+      virtual void registerFdSetIOObserver(FdSetIOObserver& observer);
+      virtual void unregisterFdSetIOObserver(FdSetIOObserver& observer);
+
+      virtual bool              waitAndProcess(int ms=0);
+
+      virtual void buildFdSet(FdSet& fdSet);
+      virtual bool processFdSet(FdSet& fdset);
+
+   protected:
+      /// A queued IORING_OP_SENDMSG; the kernel reads all of it.
+      class UringSendOp
+      {
+         public:
+            struct msghdr mMsg;
+            struct iovec mIov;
+            struct sockaddr_storage mTo;
+            void* mCookie;
+            int mFd;             // -1 once the item has been deleted
+            UringSendOp* mPrev;
+            UringSendOp* mNext;
+      };
+
+      /// State of an item added with addDatagramItem()
+      class DatagramInfo
+      {
+         public:
+            FdPollDatagramIf* mItem;
+            unsigned mBufferSize; // incl. the recvmsg header and name
+            std::vector<char*> mBuffers; // by buffer id; 0 while lent out
+            struct io_uring_buf* mBufRing; // shared with the kernel
+            size_t mBufRingSize;
+            unsigned short mBufMask;
+            unsigned short mBufTail;
+            struct msghdr mMsg;   // read by every multishot recvmsg
+            UringSendOp* mSends;  // not completed yet
+      };
+
+      class ItemInfo
+      {
+         public:
+            ItemInfo() : mItem(0), mDatagram(0), mMask(0), mGeneration(0), mArmed(false) {}
+
+            FdPollItemIf* mItem;
+            DatagramInfo* mDatagram; // instead of mItem for datagram items
+            FdPollEventMask mMask;
+            UInt32 mGeneration;  // bumped each time a poll is cancelled
+            bool mArmed;         // a poll or recvmsg is (or will be) in the kernel
+      };
+
+      /// What a completion is for: the low 2 bits of its user_data
+      typedef enum { UringPoll = 0, UringRecv, UringSend, UringIgnore } UringOp;
+
+      static UInt64 makeUserData(UringOp op, int fd, UInt32 generation)
+      {
+         return (((UInt64)generation) << 32) | (((UInt32)fd) << 2) | op;
+      }
+
+      void growItems(int fd);
+      void armItem(int fd);
+      void disarmItem(int fd);
+      void armRecv(int fd);
+      void provideBuffer(DatagramInfo& dg, unsigned short bid);
+      void delDatagramItem(int fd);
+      void processRecv(int fd, const struct io_uring_cqe& cqe);
+      void processSent(UringSendOp* op, int res);
+      struct io_uring_sqe* getSqe();
+      void enter(unsigned minComplete, int waitMs);
+      bool uringWait(int waitMs);
+
+      std::vector<ItemInfo>     mItems; // indexed by fd
+      std::vector<FdSetIOObserver*> mFdSetObservers;
+      int                       mRingFd;  // from io_uring_setup()
+      bool                      mDatagramIO; // kernel can do datagram items
+
+      // Shared with the kernel via mmap()
+      void*                     mRingPtr;
+      size_t                    mRingSize;
+      struct io_uring_sqe*      mSqes;
+      size_t                    mSqesSize;
+      unsigned*                 mSqHead;
+      unsigned*                 mSqTail;
+      unsigned*                 mSqFlags;
+      unsigned*                 mSqArray;
+      unsigned                  mSqMask;
+      unsigned                  mSqEntries;
+      unsigned*                 mCqHead;
+      unsigned*                 mCqTail;
+      unsigned                  mCqMask;
+      struct io_uring_cqe*      mCqes;
+
+      // SQEs queued since the last io_uring_enter() are not published
+      // to the kernel until then.
+      unsigned                  mSqLocalTail;
+
+      /*
+       * Completions are copied out of the ring before being processed,
+       * so that handlers can add/mod/del items (which may have to
+       * submit) while we walk them.
+       */
+      std::vector<struct io_uring_cqe> mCqeCache;
+};
+
+};      // namespace
+
+// NOTE: shift by one so that fd=0 doesn't have NULL handle
+#define IMPL_URING_FdToHandle(fd) ((FdPollItemHandle)( ((char*)0) + ((fd)+1) ))
+#define IMPL_URING_HandleToFd(handle) ( ((char*)(handle)) - ((char*)0) - 1)
+
+// user_data for IORING_OP_POLL_REMOVE; its completion is ignored
+static const UInt64 UringRemoveUserData = ~((UInt64)0);
+
+static inline int
+uringRegister(int ringFd, unsigned opcode, void* arg, unsigned nrArgs)
+{
+   return (int)syscall(__NR_io_uring_register, ringFd, opcode, arg, nrArgs);
+}
+
+FdPollImplUring::FdPollImplUring() :
+  mRingFd(-1),
+  mDatagramIO(false),
+  mRingPtr(MAP_FAILED),
+  mRingSize(0),
+  mSqes((struct io_uring_sqe*)MAP_FAILED),
+  mSqesSize(0),
+  mSqHead(0),
+  mSqTail(0),
+  mSqFlags(0),
+  mSqArray(0),
+  mSqMask(0),
+  mSqEntries(0),
+  mCqHead(0),
+  mCqTail(0),
+  mCqMask(0),
+  mCqes(0),
+  mSqLocalTail(0)
+{
+}
+
+FdPollImplUring::~FdPollImplUring()
+{
+   unsigned itemIdx;
+   for (itemIdx=0; itemIdx < mItems.size(); itemIdx++)
+   {
+      if (mItems[itemIdx].mItem || mItems[itemIdx].mDatagram)
+      {
+         CritLog(<<"FdPollItem idx="<<itemIdx
+               <<" not deleted prior to destruction");
+      }
+   }
+   if (mSqes != MAP_FAILED)
+   {
+      munmap(mSqes, mSqesSize);
+   }
+   if (mRingPtr != MAP_FAILED)
+   {
+      munmap(mRingPtr, mRingSize);
+   }
+   if (mRingFd != -1)
+   {
+      close(mRingFd);
+   }
+}
+
+bool
+FdPollImplUring::init(unsigned entries)
+{
+   struct io_uring_params params;
+   memset(&params, 0, sizeof(params));
+   // Multishot polls can post many completions per submission
+   params.flags = IORING_SETUP_CQSIZE;
+   params.cq_entries = entries*4;
+   if ( (mRingFd = (int)syscall(__NR_io_uring_setup, entries, &params)) < 0 )
+   {
+      InfoLog(<<"io_uring_setup() failed: "<<strerror(errno));
+      mRingFd = -1;
+      return false;
+   }
+
+   // IORING_FEAT_RSRC_TAGS isn't used, but it came with 5.13, which is
+   // also when multishot polls (IORING_POLL_ADD_MULTI) were added.
+   const unsigned required = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP |
+                             IORING_FEAT_EXT_ARG | IORING_FEAT_RSRC_TAGS;
+   if ((params.features & required) != required)
+   {
+      InfoLog(<<"io_uring lacks required features (have 0x"<<std::hex
+              <<params.features<<std::dec<<")");
+      return false;
+   }
+
+   size_t sqSize = params.sq_off.array + params.sq_entries*sizeof(unsigned);
+   size_t cqSize = params.cq_off.cqes + params.cq_entries*sizeof(struct io_uring_cqe);
+   mRingSize = resipMax(sqSize, cqSize);
+   mRingPtr = mmap(0, mRingSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+                   mRingFd, IORING_OFF_SQ_RING);
+   if (mRingPtr == MAP_FAILED)
+   {
+      ErrLog(<<"io_uring ring mmap() failed: "<<strerror(errno));
+      return false;
+   }
+   mSqesSize = params.sq_entries*sizeof(struct io_uring_sqe);
+   mSqes = (struct io_uring_sqe*)mmap(0, mSqesSize, PROT_READ|PROT_WRITE,
+                                      MAP_SHARED|MAP_POPULATE, mRingFd,
+                                      IORING_OFF_SQES);
+   if (mSqes == MAP_FAILED)
+   {
+      ErrLog(<<"io_uring sqe mmap() failed: "<<strerror(errno));
+      return false;
+   }
+
+   char* ring = (char*)mRingPtr;
+   mSqHead = (unsigned*)(ring + params.sq_off.head);
+   mSqTail = (unsigned*)(ring + params.sq_off.tail);
+   mSqFlags = (unsigned*)(ring + params.sq_off.flags);
+   mSqArray = (unsigned*)(ring + params.sq_off.array);
+   mSqMask = *(unsigned*)(ring + params.sq_off.ring_mask);
+   mSqEntries = params.sq_entries;
+   mCqHead = (unsigned*)(ring + params.cq_off.head);
+   mCqTail = (unsigned*)(ring + params.cq_off.tail);
+   mCqMask = *(unsigned*)(ring + params.cq_off.ring_mask);
+   mCqes = (struct io_uring_cqe*)(ring + params.cq_off.cqes);
+   mSqLocalTail = *mSqTail;
+
+   mCqeCache.resize(params.cq_entries);
+
+#ifdef RESIP_URING_DATAGRAM
+   // Multishot recvmsg and IORING_REGISTER_SYNC_CANCEL both came with
+   // 6.0. An older kernel rejects the unknown register opcode with
+   // EINVAL; a newer one just finds nothing to cancel.
+   struct io_uring_sync_cancel_reg cancel;
+   memset(&cancel, 0, sizeof(cancel));
+   cancel.addr = UringRemoveUserData;
+   cancel.fd = -1;
+   mDatagramIO = uringRegister(mRingFd, IORING_REGISTER_SYNC_CANCEL,
+                               &cancel, 1) < 0 && errno == ENOENT;
+   if (!mDatagramIO)
+   {
+      InfoLog(<<"io_uring can't receive datagrams, transports will poll");
+   }
+#endif
+   return true;
+}
+
+static inline unsigned short
+CvtUringToUsrMask(int res)
+{
+   unsigned usrMask = 0;
+   if(res < 0) return FPEM_Error|FPEM_Read|FPEM_Write;
+   if(res & (POLLIN|POLLHUP)) usrMask |= FPEM_Read;
+   if(res & POLLOUT) usrMask |= FPEM_Write;
+   if(res & POLLERR) usrMask |= FPEM_Error|FPEM_Read|FPEM_Write;
+   // NOTE: above, fake read and write if error to encourage
+   // apps to actually do something about it
+   return usrMask;
+}
+
+static inline unsigned
+CvtUsrToUringMask(unsigned short usrMask)
+{
+   unsigned sysMask = 0;
+   if(usrMask & FPEM_Read)  sysMask |= POLLIN;
+   if(usrMask & FPEM_Write) sysMask |= POLLOUT;
+   return sysMask;
+}
+
+struct io_uring_sqe*
+FdPollImplUring::getSqe()
+{
+   if (mSqLocalTail - __atomic_load_n(mSqHead, __ATOMIC_ACQUIRE) >= mSqEntries)
+   {
+      enter(0, 0);      // ring is full, hand it to the kernel
+   }
+   unsigned idx = mSqLocalTail & mSqMask;
+   struct io_uring_sqe* sqe = &mSqes[idx];
+   memset(sqe, 0, sizeof(*sqe));
+   mSqArray[idx] = idx;
+   ++mSqLocalTail;
+   return sqe;
+}
+
+void
+FdPollImplUring::armItem(int fd)
+{
+   ItemInfo& info = mItems[fd];
+   resip_assert(!info.mArmed);
+   unsigned events = CvtUsrToUringMask(info.mMask);
+   if (events == 0)
+   {
+      return;
+   }
+   struct io_uring_sqe* sqe = getSqe();
+   sqe->opcode = IORING_OP_POLL_ADD;
+   sqe->fd = fd;
+   sqe->poll32_events = events;
+   if (info.mMask & FPEM_Edge)
+   {
+      sqe->len = IORING_POLL_ADD_MULTI;
+   }
+   sqe->user_data = makeUserData(UringPoll, fd, info.mGeneration);
+   info.mArmed = true;
+}
+
+void
+FdPollImplUring::disarmItem(int fd)
+{
+   ItemInfo& info = mItems[fd];
+   if (!info.mArmed)
+   {
+      return;
+   }
+   struct io_uring_sqe* sqe = getSqe();
+   sqe->opcode = IORING_OP_POLL_REMOVE;
+   sqe->fd = -1;
+   sqe->addr = makeUserData(UringPoll, fd, info.mGeneration);
+   sqe->user_data = UringRemoveUserData;
+   ++info.mGeneration;
+   info.mArmed = false;
+}
+
+void
+FdPollImplUring::growItems(int fd)
+{
+   if (mItems.size() <= (unsigned)fd)
+   {
+      unsigned newsz = fd+1;
+      newsz += newsz/3; // plus 30% margin
+      mItems.resize(newsz);
+   }
+}
+
+FdPollItemHandle
+FdPollImplUring::addPollItem(Socket fd, FdPollEventMask newMask, FdPollItemIf *item)
+{
+   resip_assert(fd>=0);
+   growItems(fd);
+   ItemInfo& info = mItems[fd];
+   resip_assert(info.mItem == NULL && info.mDatagram == NULL);
+   info.mItem = item;
+   info.mMask = newMask;
+   armItem(fd);
+   return IMPL_URING_FdToHandle(fd);
+}
+
+void
+FdPollImplUring::modPollItem(const FdPollItemHandle handle, FdPollEventMask newMask)
+{
+   int fd = IMPL_URING_HandleToFd(handle);
+   resip_assert(fd>=0 && ((unsigned)fd) < mItems.size());
+   resip_assert(mItems[fd].mItem != NULL);
+
+   if (mItems[fd].mArmed && mItems[fd].mMask == newMask)
+   {
+      return;
+   }
+   disarmItem(fd);
+   mItems[fd].mMask = newMask;
+   armItem(fd);
+}
+
+void
+FdPollImplUring::delPollItem(FdPollItemHandle handle)
+{
+   int fd = IMPL_URING_HandleToFd(handle);
+   resip_assert(fd>=0 && ((unsigned)fd) < mItems.size());
+   if (mItems[fd].mDatagram)
+   {
+      delDatagramItem(fd);
+      return;
+   }
+   resip_assert(mItems[fd].mItem != NULL);
+   bool wasArmed = mItems[fd].mArmed;
+   disarmItem(fd);
+   mItems[fd].mItem = NULL;
+   mItems[fd].mMask = 0;
+   if (wasArmed)
+   {
+      // A pending poll holds a reference to the socket, so submit the
+      // remove now; otherwise the caller's close() wouldn't take effect
+      // (e.g. no FIN for TCP) until our next wait.
+      enter(0, 0);
+   }
+}
+
+void
+FdPollImplUring::sendDatagram(FdPollItemHandle handle, const char* data,
+                              unsigned len, const sockaddr& to,
+                              socklen_t toLen, void* cookie)
+{
+   int fd = IMPL_URING_HandleToFd(handle);
+   resip_assert(fd>=0 && ((unsigned)fd) < mItems.size());
+   DatagramInfo* dg = mItems[fd].mDatagram;
+   resip_assert(dg != NULL && toLen <= sizeof(struct sockaddr_storage));
+
+   UringSendOp* op = new UringSendOp;
+   memset(op, 0, sizeof(*op));
+   memcpy(&op->mTo, &to, toLen);
+   op->mIov.iov_base = const_cast<char*>(data);
+   op->mIov.iov_len = len;
+   op->mMsg.msg_name = &op->mTo;
+   op->mMsg.msg_namelen = toLen;
+   op->mMsg.msg_iov = &op->mIov;
+   op->mMsg.msg_iovlen = 1;
+   op->mCookie = cookie;
+   op->mFd = fd;
+   op->mNext = dg->mSends;
+   if (dg->mSends)
+   {
+      dg->mSends->mPrev = op;
+   }
+   dg->mSends = op;
+
+   struct io_uring_sqe* sqe = getSqe();
+   sqe->opcode = IORING_OP_SENDMSG;
+   sqe->fd = fd;
+   sqe->addr = (UInt64)(uintptr_t)&op->mMsg;
+   sqe->user_data = ((UInt64)(uintptr_t)op) | UringSend;
+}
+
+void
+FdPollImplUring::processSent(UringSendOp* op, int res)
+{
+   if (op->mFd < 0)
+   {
+      delete op;       // item was deleted, and has been told already
+      return;
+   }
+   DatagramInfo* dg = mItems[op->mFd].mDatagram;
+   if (op->mPrev)
+   {
+      op->mPrev->mNext = op->mNext;
+   }
+   else
+   {
+      dg->mSends = op->mNext;
+   }
+   if (op->mNext)
+   {
+      op->mNext->mPrev = op->mPrev;
+   }
+   void* cookie = op->mCookie;
+   delete op;
+   try
+   {
+      dg->mItem->processDatagramSent(cookie, res);
+   }
+   catch(BaseException& e)
+   {
+      ErrLog(<<"Exception thrown for FdPollItem: " << e);
+   }
+}
+
+#ifdef RESIP_URING_DATAGRAM
+FdPollItemHandle
+FdPollImplUring::addDatagramItem(Socket fd, FdPollDatagramIf *item,
+                                 unsigned maxLen, unsigned numBuffers)
+{
+   resip_assert(fd>=0);
+   resip_assert(numBuffers > 0 && numBuffers <= 0x8000 &&
+                (numBuffers & (numBuffers-1)) == 0);
+   if (!mDatagramIO || fd > 0xffff)   // fd is the buffer group id
+   {
+      return 0;
+   }
+   growItems(fd);
+   resip_assert(mItems[fd].mItem == NULL && mItems[fd].mDatagram == NULL);
+
+   DatagramInfo* dg = new DatagramInfo;
+   dg->mItem = item;
+   // recvmsg puts a header and the sender's address ahead of the payload
+   dg->mBufferSize = sizeof(struct io_uring_recvmsg_out) +
+                     sizeof(struct sockaddr_in6) + maxLen;
+   dg->mBufRingSize = numBuffers*sizeof(struct io_uring_buf);
+   dg->mBufMask = (unsigned short)(numBuffers-1);
+   dg->mBufTail = 0;
+   memset(&dg->mMsg, 0, sizeof(dg->mMsg));
+   dg->mMsg.msg_namelen = sizeof(struct sockaddr_in6);
+   dg->mSends = 0;
+
+   // The kernel wants the ring page aligned
+   void* ring = mmap(0, dg->mBufRingSize, PROT_READ|PROT_WRITE,
+                     MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+   struct io_uring_buf_reg reg;
+   memset(&reg, 0, sizeof(reg));
+   reg.ring_addr = (UInt64)(uintptr_t)ring;
+   reg.ring_entries = numBuffers;
+   reg.bgid = (unsigned short)fd;
+   if (ring == MAP_FAILED ||
+       uringRegister(mRingFd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+   {
+      InfoLog(<<"io_uring buffer ring for fd="<<fd<<" failed: "<<strerror(errno));
+      if (ring != MAP_FAILED)
+      {
+         munmap(ring, dg->mBufRingSize);
+      }
+      delete dg;
+      return 0;
+   }
+   dg->mBufRing = (struct io_uring_buf*)ring;
+   dg->mBuffers.resize(numBuffers);
+   for (unsigned bid=0; bid < numBuffers; bid++)
+   {
+      dg->mBuffers[bid] = item->allocateDatagramBuffer(dg->mBufferSize);
+      provideBuffer(*dg, (unsigned short)bid);
+   }
+
+   mItems[fd].mDatagram = dg;
+   armRecv(fd);
+   return IMPL_URING_FdToHandle(fd);
+}
+
+void
+FdPollImplUring::armRecv(int fd)
+{
+   ItemInfo& info = mItems[fd];
+   resip_assert(!info.mArmed);
+   struct io_uring_sqe* sqe = getSqe();
+   sqe->opcode = IORING_OP_RECVMSG;
+   sqe->fd = fd;
+   sqe->addr = (UInt64)(uintptr_t)&info.mDatagram->mMsg;
+   sqe->ioprio = IORING_RECV_MULTISHOT;
+   sqe->flags = IOSQE_BUFFER_SELECT;
+   sqe->buf_group = (unsigned short)fd;
+   sqe->user_data = makeUserData(UringRecv, fd, info.mGeneration);
+   info.mArmed = true;
+}
+
+/**
+   Puts buffer {bid} back into the ring. NOTE: struct io_uring_buf_ring
+   isn't used because in C++ the empty struct that its flexible bufs[]
+   array is declared with has a size, which moves bufs[] 8 bytes off
+   where the kernel has it. The tail is the resv of the first entry.
+**/
+void
+FdPollImplUring::provideBuffer(DatagramInfo& dg, unsigned short bid)
+{
+   struct io_uring_buf* buf = &dg.mBufRing[dg.mBufTail & dg.mBufMask];
+   buf->addr = (UInt64)(uintptr_t)dg.mBuffers[bid];
+   buf->len = dg.mBufferSize;
+   buf->bid = bid;
+   ++dg.mBufTail;
+   __atomic_store_n(&dg.mBufRing[0].resv, dg.mBufTail, __ATOMIC_RELEASE);
+}
+
+void
+FdPollImplUring::delDatagramItem(int fd)
+{
+   DatagramInfo* dg = mItems[fd].mDatagram;
+
+   // The recvmsg and the sends must be out of the kernel before their
+   // buffers go away. What is queued has to be submitted before it can
+   // be cancelled, and IORING_REGISTER_SYNC_CANCEL only returns once
+   // the cancel is done.
+   enter(0, 0);
+   struct io_uring_sync_cancel_reg cancel;
+   memset(&cancel, 0, sizeof(cancel));
+   cancel.fd = fd;
+   cancel.flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+   cancel.timeout.tv_sec = -1;
+   cancel.timeout.tv_nsec = -1;
+   if (uringRegister(mRingFd, IORING_REGISTER_SYNC_CANCEL, &cancel, 1) < 0 &&
+       errno != ENOENT)
+   {
+      ErrLog(<<"io_uring cancel for fd="<<fd<<" failed: "<<strerror(errno));
+   }
+   struct io_uring_buf_reg reg;
+   memset(&reg, 0, sizeof(reg));
+   reg.bgid = (unsigned short)fd;
+   uringRegister(mRingFd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+   munmap(dg->mBufRing, dg->mBufRingSize);
+   for (unsigned bid=0; bid < dg->mBuffers.size(); bid++)
+   {
+      delete [] dg->mBuffers[bid];
+   }
+
+   ++mItems[fd].mGeneration;
+   mItems[fd].mArmed = false;
+   mItems[fd].mDatagram = NULL;
+
+   // The completions of the sends are still to come (processSent()
+   // drops them), but the item hears about the sends now, while it is
+   // still around.
+   while (dg->mSends)
+   {
+      UringSendOp* op = dg->mSends;
+      dg->mSends = op->mNext;
+      op->mFd = -1;
+      try
+      {
+         dg->mItem->processDatagramSent(op->mCookie, -ECANCELED);
+      }
+      catch(BaseException& e)
+      {
+         ErrLog(<<"Exception thrown for FdPollItem: " << e);
+      }
+   }
+   delete dg;
+}
+
+void
+FdPollImplUring::processRecv(int fd, const struct io_uring_cqe& cqe)
+{
+   DatagramInfo* dg = mItems[fd].mDatagram;
+   UInt32 generation = mItems[fd].mGeneration;
+   if (!(cqe.flags & IORING_CQE_F_MORE))
+   {
+      mItems[fd].mArmed = false;   // out of buffers (ENOBUFS), or failed
+   }
+   if (cqe.res < 0 || !(cqe.flags & IORING_CQE_F_BUFFER))
+   {
+      // a failed receive puts its buffer back into the ring itself
+      if (cqe.res != -ENOBUFS)
+      {
+         DebugLog(<<"io_uring recvmsg fd="<<fd<<" failed: "<<strerror(-cqe.res));
+      }
+   }
+   else
+   {
+      unsigned short bid = (unsigned short)(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+      char* buffer = dg->mBuffers[bid];
+      dg->mBuffers[bid] = 0;   // the item may keep it, or delete itself
+      bool consumed = false;
+
+      const struct io_uring_recvmsg_out* out =
+         (const struct io_uring_recvmsg_out*)buffer;
+      int hdrLen = (int)(sizeof(*out) + dg->mMsg.msg_namelen);
+      if (cqe.res < hdrLen)
+      {
+         ErrLog(<<"io_uring recvmsg fd="<<fd<<" returned a short header");
+      }
+      else if (out->flags & MSG_TRUNC)
+      {
+         InfoLog(<<"Datagram exceeded max length "<<(dg->mBufferSize - hdrLen));
+      }
+      else
+      {
+         struct sockaddr_storage from;
+         socklen_t fromLen = resipMin(out->namelen, (UInt32)dg->mMsg.msg_namelen);
+         memcpy(&from, buffer + sizeof(*out), fromLen);
+         int len = cqe.res - hdrLen;
+         memmove(buffer, buffer + hdrLen, len);
+         try
+         {
+            consumed = dg->mItem->processDatagram(buffer, len,
+                                                  (const sockaddr&)from, fromLen);
+         }
+         catch(BaseException& e)
+         {
+            ErrLog(<<"Exception thrown for FdPollItem: " << e);
+         }
+      }
+
+      // WATCHOUT: handler may have deleted the item, and mItems may
+      // have been re-allocated
+      if (mItems[fd].mDatagram == dg && mItems[fd].mGeneration == generation)
+      {
+         if (consumed)
+         {
+            buffer = dg->mItem->allocateDatagramBuffer(dg->mBufferSize);
+         }
+         dg->mBuffers[bid] = buffer;
+         provideBuffer(*dg, bid);
+      }
+      else if (!consumed)
+      {
+         delete [] buffer;
+      }
+   }
+
+   if (mItems[fd].mDatagram != NULL && mItems[fd].mGeneration == generation &&
+       !mItems[fd].mArmed)
+   {
+      armRecv(fd);
+   }
+}
+
+#else // RESIP_URING_DATAGRAM
+
+// Without the 6.0 headers mDatagramIO is never set, so there are no
+// datagram items.
+FdPollItemHandle
+FdPollImplUring::addDatagramItem(Socket fd, FdPollDatagramIf *item,
+                                 unsigned maxLen, unsigned numBuffers)
+{
+   return 0;
+}
+
+void
+FdPollImplUring::delDatagramItem(int fd)
+{
+   resip_assert(0);
+}
+
+void
+FdPollImplUring::processRecv(int fd, const struct io_uring_cqe& cqe)
+{
+   resip_assert(0);
+}
+
+#endif // RESIP_URING_DATAGRAM
+
+void
+FdPollImplUring::registerFdSetIOObserver(FdSetIOObserver& observer)
+{
+   mFdSetObservers.push_back(&observer);
+}
+
+void
+FdPollImplUring::unregisterFdSetIOObserver(FdSetIOObserver& observer)
+{
+   for(std::vector<FdSetIOObserver*>::iterator o=mFdSetObservers.begin();
+         o!=mFdSetObservers.end();++o)
+   {
+      if(*o==&observer)
+      {
+         mFdSetObservers.erase(o);
+         return;
+      }
+   }
+}
+
+/**
+   Submits all queued SQEs, and if minComplete is non-zero waits up to
+   waitMs (forever if negative) for completions.
+**/
+void
+FdPollImplUring::enter(unsigned minComplete, int waitMs)
+{
+   __atomic_store_n(mSqTail, mSqLocalTail, __ATOMIC_RELEASE);
+   unsigned toSubmit = mSqLocalTail - __atomic_load_n(mSqHead, __ATOMIC_ACQUIRE);
+   unsigned flags = 0;
+   struct io_uring_getevents_arg arg;
+   struct __kernel_timespec ts;
+   void* argp = 0;
+   size_t argSize = 0;
+   if (minComplete > 0 || (__atomic_load_n(mSqFlags, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW))
+   {
+      flags |= IORING_ENTER_GETEVENTS;
+   }
+   if (minComplete > 0 && waitMs >= 0)
+   {
+      memset(&arg, 0, sizeof(arg));
+      ts.tv_sec = waitMs/1000;
+      ts.tv_nsec = (waitMs%1000)*1000000L;
+      arg.ts = (UInt64)(uintptr_t)&ts;
+      flags |= IORING_ENTER_EXT_ARG;
+      argp = &arg;
+      argSize = sizeof(arg);
+   }
+   if (toSubmit == 0 && flags == 0)
+   {
+      return;
+   }
+   if (syscall(__NR_io_uring_enter, mRingFd, toSubmit, minComplete, flags,
+               argp, argSize) < 0)
+   {
+      int err = errno;
+      // EINTR: signal handler (like alarm) broke the wait. generally ok
+      // ETIME: waitMs expired without completions
+      // EAGAIN/EBUSY: out of resources or completions backed up; the
+      //   unsubmitted SQEs stay in the ring until the next call
+      if (err != EINTR && err != ETIME && err != EAGAIN && err != EBUSY)
+      {
+         CritLog(<<"io_uring_enter() failed: " << strerror(err));
+         abort();   // TBD: just throw instead?
+      }
+   }
+}
+
+bool
+FdPollImplUring::waitAndProcess(int ms)
+{
+   bool didSomething = false;
+   int waitMs = ms;
+
+   if(!mFdSetObservers.empty())
+   {
+      if(ms < 0)
+      {
+         ms=INT_MAX;
+         waitMs=INT_MAX;
+      }
+
+      // Same approach (and caveats) as FdPollImplEpoll::waitAndProcess():
+      // select() on the ring fd together with the observers' fds.
+      FdSet fdset;
+      buildFdSet(fdset); // add our ring fd, and fds from mFdSetObservers
+
+      for(std::vector<FdSetIOObserver*>::iterator o=mFdSetObservers.begin();
+            o!=mFdSetObservers.end();++o)
+      {
+         ms = resipMin((unsigned int)ms, (*o)->getTimeTillNextProcessMS());
+      }
+
+      waitMs -= ms;
+
+      int numReady = fdset.selectMilliSeconds(ms);
+
+      if ( numReady < 0 )
+      {
+         int err = getErrno();
+         if ( err!=EINTR )
+         {
+            CritLog(<<"select() failed: "<<strerror(err));
+            resip_assert(0);     // .kw. not sure correct behavior...
+         }
+         return false;
+      }
+      if ( numReady==0 )
+         return false;     // timer expired
+
+      didSomething |= processFdSet(fdset);
+   }
+
+   didSomething |= uringWait(waitMs);
+   return didSomething;
+}
+
+void
+FdPollImplUring::buildFdSet(FdSet& fdset)
+{
+   // The ring fd is readable when completions are waiting, but polls
+   // queued since the last wait must reach the kernel first.
+   enter(0, 0);
+   if (mRingFd != -1)
+   {
+      fdset.setRead(mRingFd);
+   }
+   for(std::vector<FdSetIOObserver*>::iterator o=mFdSetObservers.begin();
+         o!=mFdSetObservers.end();++o)
+   {
+      (*o)->buildFdSet(fdset);
+   }
+}
+
+bool
+FdPollImplUring::processFdSet(FdSet& fdset)
+{
+   bool didsomething=false;
+   for(std::vector<FdSetIOObserver*>::iterator o=mFdSetObservers.begin();
+         o!=mFdSetObservers.end();++o)
+   {
+      didsomething=true;
+      (*o)->process(fdset);
+   }
+
+   if (mRingFd != -1 && fdset.readyToRead(mRingFd))
+   {
+      uringWait(0);
+   }
+   return didsomething;
+}
+
+bool
+FdPollImplUring::uringWait(int waitMs)
+{
+   bool maybeMore;
+   bool didsomething=false;
+   do
+   {
+      unsigned head = *mCqHead;
+      bool ready = head != __atomic_load_n(mCqTail, __ATOMIC_ACQUIRE);
+      // Only wait if nothing is ready yet; always submit what is queued.
+      enter(ready ? 0 : (waitMs != 0 ? 1 : 0), waitMs);
+      waitMs = 0;             // don't wait anymore
+
+      unsigned tail = __atomic_load_n(mCqTail, __ATOMIC_ACQUIRE);
+      unsigned ncqes = 0;
+      while (head != tail && ncqes < mCqeCache.size())
+      {
+         mCqeCache[ncqes++] = mCqes[head & mCqMask];
+         ++head;
+      }
+      __atomic_store_n(mCqHead, head, __ATOMIC_RELEASE);
+      maybeMore = (ncqes == mCqeCache.size());
+
+      unsigned nc;
+      for (nc=0; nc < ncqes; nc++)
+      {
+         const struct io_uring_cqe& cqe = mCqeCache[nc];
+         UringOp op = (UringOp)(cqe.user_data & 3);
+         if (op == UringIgnore)
+         {
+            continue;
+         }
+         if (op == UringSend)
+         {
+            processSent((UringSendOp*)(uintptr_t)(cqe.user_data & ~(UInt64)3),
+                        cqe.res);
+            didsomething = true;
+            continue;
+         }
+         int fd = (int)((cqe.user_data & 0xffffffff) >> 2);
+         UInt32 generation = (UInt32)(cqe.user_data >> 32);
+         if (((unsigned)fd) >= mItems.size() ||
+             (op == UringPoll ? mItems[fd].mItem == NULL
+                              : mItems[fd].mDatagram == NULL) ||
+             mItems[fd].mGeneration != generation)
+         {
+            /* poll was cancelled by mod/del after the event was
+             * generated in kernel, or fd was re-used */
+            continue;
+         }
+         if (op == UringRecv)
+         {
+            processRecv(fd, cqe);
+            didsomething = true;
+            continue;
+         }
+         if (!(cqe.flags & IORING_CQE_F_MORE))
+         {
+            mItems[fd].mArmed = false;   // oneshot, or multishot ended
+         }
+         if (cqe.res < 0)
+         {
+            DebugLog(<<"io_uring poll fd="<<fd<<" failed: "<<strerror(-cqe.res));
+         }
+         processItem(mItems[fd].mItem, CvtUringToUsrMask(cqe.res));
+         // WATCHOUT: handler may have deleted or modified the item,
+         // and mItems may have been re-allocated
+         if (((unsigned)fd) < mItems.size() &&
+             mItems[fd].mItem != NULL &&
+             !mItems[fd].mArmed)
+         {
+            armItem(fd);
+         }
+         didsomething = true;
+      }
+   } while (maybeMore);
+   return didsomething;
+}
+
+#endif // RESIP_POLL_IMPL_URING
+
 /*****************************************************************
  *
  * Factory
@@ -1230,6 +2268,19 @@ FdPollGrp::create(const char *implName)
 {
    if ( implName==0 || implName[0]==0 || strcmp(implName,"event")==0 )
       implName = 0;     // pick the first (best) one supported
+#ifdef RESIP_POLL_IMPL_URING
+   if ( implName!=0 && strcmp(implName,"uring")==0 )
+   {
+      FdPollImplUring* grp = new FdPollImplUring();
+      if ( grp->init(256) )
+      {
+         return grp;
+      }
+      delete grp;
+      WarningLog(<<"io_uring not supported by this kernel, using epoll");
+      implName = "epoll";
+   }
+#endif
 #ifdef RESIP_POLL_IMPL_EPOLL
    if ( implName==0 || strcmp(implName,"epoll")==0 )
    {
@@ -1255,7 +2306,13 @@ FdPollGrp::getImplList()
 {
    // .kw. this isn't really scalable approach if we get a lot of impls
    // but it works for now
-#ifdef RESIP_POLL_IMPL_EPOLL
+#ifdef RESIP_POLL_IMPL_URING
+ #ifdef RESIP_POLL_IMPL_POLL
+   return "event|epoll|uring|fdset|poll";
+ #else
+   return "event|epoll|uring|fdset";
+ #endif
+#elif defined(RESIP_POLL_IMPL_EPOLL)
  #ifdef RESIP_POLL_IMPL_POLL
    return "event|epoll|fdset|poll";
  #else
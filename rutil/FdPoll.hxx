@@ -5,6 +5,8 @@
 
 /* The Makefile system may define the following:
  * HAVE_EPOLL: system call epoll() is available
+ * HAVE_IO_URING: <linux/io_uring.h> has the features needed by
+ *   the "uring" impl (the running kernel is checked at create() time)
  *
  * An implementation based upon FdSet (and select()) is always available.
  *
@@ -17,6 +19,10 @@
 #define RESIP_POLL_IMPL_EPOLL
 #endif
 
+#if defined(HAVE_IO_URING) && defined(RESIP_POLL_IMPL_EPOLL)
+#define RESIP_POLL_IMPL_URING
+#endif
+
 #if defined(HAVE_POLL) || (_WIN32_WINNT >= 0x0600)
 #define RESIP_POLL_IMPL_POLL
 #endif
@@ -67,6 +73,38 @@ class FdPollItemBase : public FdPollItemIf
       FdPollItemHandle  mPollHandle;
 };
 
+/**
+ * A datagram socket whose receives and sends are done by the FdPollGrp
+ * itself (see FdPollGrp::addDatagramItem()), rather than by the item
+ * after it has been told the socket is readable or writable.
+ */
+class FdPollDatagramIf
+{
+   public:
+      FdPollDatagramIf() { };
+      virtual ~FdPollDatagramIf();
+
+      /**
+        Allocate a receive buffer of {size} bytes. The group frees the
+        ones it still holds with delete[].
+      **/
+      virtual char* allocateDatagramBuffer(unsigned size) = 0;
+
+      /**
+        A datagram of {len} bytes from {from} is at the start of
+        {buffer}. Return true iff the item took ownership of {buffer}.
+      **/
+      virtual bool processDatagram(char* buffer, int len,
+                                   const sockaddr& from, socklen_t fromLen) = 0;
+
+      /**
+        A send queued with FdPollGrp::sendDatagram() is done. {res} is
+        the number of bytes sent or -errno (-ECANCELED if the item was
+        deleted first).
+      **/
+      virtual void processDatagramSent(void* cookie, int res) = 0;
+};
+
 class FdSetIOObserver;
 
 class FdPollGrp
@@ -75,9 +113,10 @@ class FdPollGrp
       FdPollGrp();
       virtual ~FdPollGrp();
 
-      typedef enum {FdSetImpl = 0, PollImpl, EPollImpl } ImplType;
+      typedef enum {FdSetImpl = 0, PollImpl, EPollImpl, URingImpl } ImplType;
 
       /// factory
+      /// "uring" falls back to "epoll" if the kernel doesn't support it
       static FdPollGrp* create(const char *implName=NULL);
       /// Return candidate impl names with vertical bar (|) between them
       /// Intended for help messages
@@ -90,6 +129,21 @@ class FdPollGrp
       virtual void modPollItem(FdPollItemHandle handle, FdPollEventMask newMask) = 0;
       virtual void delPollItem(FdPollItemHandle handle) = 0;
 
+      /// Let the group receive and send for a datagram socket: it keeps
+      /// {numBuffers} (a power of 2) buffers for datagrams of up to
+      /// {maxLen} bytes in the kernel, and the item gets no poll events.
+      /// Returns 0 if this impl can't (only "uring" can), in which case
+      /// use addPollItem() and do the I/O yourself. Delete the item with
+      /// delPollItem().
+      virtual FdPollItemHandle addDatagramItem(Socket sock, FdPollDatagramIf *item,
+                                               unsigned maxLen, unsigned numBuffers);
+      /// Queue a send of {len} bytes to {to} on a datagram item. The sends
+      /// queued between two waits go to the kernel together. {data} must
+      /// stay valid until processDatagramSent({cookie}) is called.
+      virtual void sendDatagram(FdPollItemHandle handle, const char* data,
+                                unsigned len, const sockaddr& to,
+                                socklen_t toLen, void* cookie);
+
       virtual void registerFdSetIOObserver(FdSetIOObserver& observer) = 0;
       virtual void unregisterFdSetIOObserver(FdSetIOObserver& observer) = 0;
 
@@ -6,12 +6,21 @@
 #ifndef WIN32
 #include <unistd.h>
 #endif
+#ifdef HAVE_EVENTFD
+#include <sys/eventfd.h>
+#endif
+
+// Coalescing wakeups needs an atomic exchange; without one (or on
+// Windows, which checks FIONREAD instead) every interrupt() signals.
+#if !defined(WIN32) && defined(__GNUC__)
+#define RESIP_INTERRUPTOR_COALESCE
+#endif
 
 using namespace resip;
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::TRANSPORT
 
-SelectInterruptor::SelectInterruptor()
+SelectInterruptor::SelectInterruptor() : mWakeupCount(0)
 {
 #ifdef WIN32
    initNetwork();  // Required for windows
@@ -32,6 +41,11 @@ SelectInterruptor::SelectInterruptor()
    error= connect(mSocket, &mWakeupAddr, sizeof(mWakeupAddr));
    resip_assert(error == 0);
    mReadThing = mSocket;
+#else
+   mWakeupPending = 0;
+#ifdef HAVE_EVENTFD
+   mPipe[0] = mPipe[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+   resip_assert( mPipe[0] != -1 );
 #else
    int x = pipe(mPipe);
    (void)x;
@@ -41,6 +55,7 @@ SelectInterruptor::SelectInterruptor()
    // make read-side non-blocking so safe to read out entire pipe
    // all in one go (also just safer)
    makeSocketNonBlocking(mPipe[0]);
+#endif
    mReadThing = mPipe[0];
 #endif
 }
@@ -51,7 +66,10 @@ SelectInterruptor::~SelectInterruptor()
    closesocket(mSocket);
 #else
    close(mPipe[0]);
-   close(mPipe[1]);
+   if (mPipe[1] != mPipe[0])
+   {
+      close(mPipe[1]);
+   }
 #endif
 }
 
@@ -77,6 +95,11 @@ SelectInterruptor::processCleanup()
 #ifdef WIN32
   char rdBuf[16];
   recv(mSocket, rdBuf, sizeof(rdBuf), 0);
+#else
+#ifdef HAVE_EVENTFD
+  // One read resets the counter, however many writes there were
+  eventfd_t value;
+  eventfd_read(mPipe[0], &value);
 #else
   char rdBuf[16];
   int x;
@@ -86,6 +109,14 @@ SelectInterruptor::processCleanup()
   // number of bytes is exactly size of rdBuf
   // XXX: should check for certain errors (like fd closed) and die?
 #endif
+#ifdef RESIP_INTERRUPTOR_COALESCE
+  // Only clear the flag after draining. An interrupt() that found it
+  // set (and skipped its write) posted its message before our exchange,
+  // so the caller, which processes its fifos after cleaning up, will
+  // see it. Clearing before draining could swallow a wakeup for good.
+  __atomic_exchange_n(&mWakeupPending, 0, __ATOMIC_ACQ_REL);
+#endif
+#endif
 }
 
 void
@@ -117,11 +148,27 @@ SelectInterruptor::interrupt()
    // Only bother signalling socket if there is no data on it already
    if(readSize == 0)  
    {
+      ++mWakeupCount;
       int count = send(mSocket, wakeUp, sizeof(wakeUp), 0);
       resip_assert(count == sizeof(wakeUp));
    }
+#else
+#ifdef RESIP_INTERRUPTOR_COALESCE
+   if (__atomic_exchange_n(&mWakeupPending, 1, __ATOMIC_ACQ_REL) != 0)
+   {
+      return;  // earlier wakeup not consumed yet; thread will wake anyway
+   }
+#endif
+   ++mWakeupCount;  // statistics only, so not atomic
+#ifdef HAVE_EVENTFD
+   (void)wakeUp;
+   eventfd_t one = 1;
+   ssize_t res = write(mPipe[1], &one, sizeof(one));
+   const ssize_t expected = sizeof(one);
 #else
    ssize_t res = write(mPipe[1], wakeUp, sizeof(wakeUp));
+   const ssize_t expected = sizeof(wakeUp);
+#endif
 
    if ( res == -1 && (errno == EAGAIN || errno == EWOULDBLOCK) )   // Treat EGAIN and EWOULDBLOCK as the same: http://stackoverflow.com/questions/7003234/which-systems-define-eagain-and-ewouldblock-as-different-values
    {
@@ -132,7 +179,7 @@ SelectInterruptor::interrupt()
    } 
    else 
    {
-      resip_assert(res == sizeof(wakeUp));
+      resip_assert(res == expected);
    }
 #endif
 }
@@ -10,6 +10,13 @@ namespace resip
 
 /**
     Used to 'artificially' interrupt a select call
+
+    On Linux (HAVE_EVENTFD) this is an eventfd, otherwise a pipe (or a
+    loopback UDP socket on Windows). Wakeups are coalesced: interrupt()
+    only writes if no earlier wakeup is still pending, i.e. not yet
+    consumed by processCleanup(). A burst of messages posted to a
+    sleeping thread thus costs one write and one read syscall, rather
+    than one of each per message.
 */
 class SelectInterruptor : public AsyncProcessHandler, public FdPollItemIf
 {
@@ -42,6 +49,10 @@ class SelectInterruptor : public AsyncProcessHandler, public FdPollItemIf
 
       virtual void processPollEvent(FdPollEventMask mask);
 
+      /// Number of times interrupt() actually signalled the fd (each is
+      /// a syscall); interrupts that found a wakeup pending aren't counted
+      unsigned long getWakeupCount() const { return mWakeupCount; }
+
       /* Get fd of read-side, for use within PollInterruptor,
        * Declared as Socket for easier cross-platform even though pipe fd
        * under linux.
@@ -58,13 +69,15 @@ class SelectInterruptor : public AsyncProcessHandler, public FdPollItemIf
       void processCleanup();
    private:
 #ifndef WIN32
-      int mPipe[2];
+      int mPipe[2];  // with eventfd, both are the same fd
+      int mWakeupPending;  // accessed atomically
 #else
       Socket mSocket;
       sockaddr mWakeupAddr;
 #endif
       // either mPipe[0] or mSocket
       Socket mReadThing;
+      volatile unsigned long mWakeupCount;
 };
 
 }
@@ -4,9 +4,17 @@
 
 #include <stdexcept>
 
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <sys/uio.h>
+// sendmmsg is Linux specific
+#define RESIP_HEP_HAVE_SENDMMSG
+#endif
+
 #include "rutil/hep/ResipHep.hxx"
 #include "rutil/hep/HepAgent.hxx"
 #include "rutil/DataStream.hxx"
+#include "rutil/Lock.hxx"
 #include "rutil/Logger.hxx"
 
 using namespace resip;
@@ -14,8 +22,29 @@ using namespace std;
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::TRANSPORT
 
-HepAgent::HepAgent(const Data &captureHost, int capturePort, int captureAgentID)
-   : mCaptureHost(captureHost), mCapturePort(capturePort), mCaptureAgentID(captureAgentID)
+static void
+swapBuffers(Data& a, Data& b)
+{
+   Data tmp;
+   tmp.takeBuf(a);
+   a.takeBuf(b);
+   b.takeBuf(tmp);
+}
+
+HepAgent::HepAgent(const Data &captureHost, int capturePort, int captureAgentID, unsigned int queueSize)
+   : mCaptureHost(captureHost), mCapturePort(capturePort), mCaptureAgentID(captureAgentID),
+     mQueue(queueSize > 0 ? queueSize : 1),
+     mHead(0),
+     mCount(0),
+     mQueued(0),
+     mDropped(0),
+     mSent(0),
+     mSendErrors(0),
+     mBatches(0),
+     mBatch(MaxBatchSize),
+     mPackets(MaxBatchSize),
+     mReportedDropped(0),
+     mThread(*this)
 {
 #ifdef USE_IPV6
    struct sockaddr_in6 myaddr;
@@ -49,14 +78,8 @@ HepAgent::HepAgent(const Data &captureHost, int capturePort, int captureAgentID)
       throw std::runtime_error("Failed to create socket");
    }
 
-   // make it non-blocking
-   // FIXME - HEP messages are lost if the transmit buffer fills up
-   // Messages should be queued and sent as part of the main loop
-   if(!makeSocketNonBlocking(mSocket))
-   {
-      ErrLog(<<"Failed to set O_NONBLOCK");
-      throw std::runtime_error("Failed to set O_NONBLOCK");
-   }
+   // The socket is left blocking: only the capture thread writes to it, and
+   // packets queue up in mQueue (or are dropped there) while it is busy
 
    if(::bind(mSocket, ( struct sockaddr *) &myaddr, sizeof(myaddr)) < 0) {
       ErrLog(<<"bind failed");
@@ -93,11 +116,399 @@ HepAgent::HepAgent(const Data &captureHost, int capturePort, int captureAgentID)
          throw std::runtime_error("unsupported address family");
    }
    freeaddrinfo(rset);
-   InfoLog(<<"HEP capture agent ready to send to " << mDestination);
+   InfoLog(<<"HEP capture agent ready to send to " << mDestination << ", queue size " << mQueue.size());
+
+   mThread.run();
 }
 
 HepAgent::~HepAgent()
 {
+   mThread.shutdown();
+   {
+      Lock lock(mMutex);
+      mCondition.signal();
+   }
+   mThread.join();
+   closeSocket(mSocket);
+}
+
+HepAgent::CaptureEntry::CaptureEntry()
+   : mType(UNKNOWN_TRANSPORT),
+     mEventType(SIP),
+     mTimestamp(0)
+{
+}
+
+void
+HepAgent::sendToHOMER(const TransportType type, const GenericIPAddress& source, const GenericIPAddress& destination, const HEPEventType eventType,
+                      const char* payload, size_t length, const Data& correlationId)
+{
+   UInt64 now = hepUnixTimestamp();
+
+   Lock lock(mMutex);
+   if(mCount == mQueue.size())
+   {
+      ++mDropped;
+      return;
+   }
+
+   CaptureEntry& entry = mQueue[(mHead + mCount) % mQueue.size()];
+   entry.mType = type;
+   entry.mSource = source;
+   entry.mDestination = destination;
+   entry.mEventType = eventType;
+   entry.mTimestamp = now;
+   entry.mCorrelationId.truncate2(0);
+   entry.mCorrelationId.append(correlationId.data(), correlationId.size());
+   entry.mPayload.truncate2(0);
+   entry.mPayload.append(payload, length);
+
+   if(mCount++ == 0)
+   {
+      mCondition.signal();
+   }
+   ++mQueued;
+}
+
+UInt64
+HepAgent::getQueuedCount() const
+{
+   Lock lock(mMutex);
+   return mQueued;
+}
+
+UInt64
+HepAgent::getDroppedCount() const
+{
+   Lock lock(mMutex);
+   return mDropped;
+}
+
+UInt64
+HepAgent::getSentCount() const
+{
+   Lock lock(mMutex);
+   return mSent;
+}
+
+UInt64
+HepAgent::getSendErrorCount() const
+{
+   Lock lock(mMutex);
+   return mSendErrors;
+}
+
+UInt64
+HepAgent::getBatchCount() const
+{
+   Lock lock(mMutex);
+   return mBatches;
+}
+
+void
+HepAgent::CaptureThread::thread()
+{
+   while(!isShutdown())
+   {
+      mAgent.process(true);
+   }
+   // Send whatever was captured before shutdown
+   mAgent.process(false);
+}
+
+void
+HepAgent::process(bool wait)
+{
+   unsigned int count = 0;
+   UInt64 dropped = 0;
+   {
+      Lock lock(mMutex);
+      if(mCount == 0 && wait)
+      {
+         mCondition.wait(mMutex, 1000);
+      }
+      count = resipMin(mCount, (unsigned int)MaxBatchSize);
+      for(unsigned int i = 0; i < count; ++i)
+      {
+         // Swap, rather than copy, so both sides keep reusing their buffers
+         CaptureEntry& entry = mQueue[mHead];
+         CaptureEntry& batched = mBatch[i];
+         batched.mType = entry.mType;
+         batched.mSource = entry.mSource;
+         batched.mDestination = entry.mDestination;
+         batched.mEventType = entry.mEventType;
+         batched.mTimestamp = entry.mTimestamp;
+         swapBuffers(batched.mCorrelationId, entry.mCorrelationId);
+         swapBuffers(batched.mPayload, entry.mPayload);
+         mHead = (mHead + 1) % mQueue.size();
+      }
+      mCount -= count;
+      dropped = mDropped;
+   }
+
+   if(dropped != mReportedDropped)
+   {
+      WarningLog(<< "HEP capture queue full, " << (dropped - mReportedDropped) << " packets dropped (" << dropped << " in total)");
+      mReportedDropped = dropped;
+   }
+
+   unsigned int encoded = 0;
+   for(unsigned int i = 0; i < count; ++i)
+   {
+      if(encode(mBatch[i], mPackets[encoded]))
+      {
+         ++encoded;
+      }
+   }
+   if(encoded > 0)
+   {
+      send(encoded);
+   }
+}
+
+bool
+HepAgent::encode(const CaptureEntry& entry, Data& packet) const
+{
+   struct hep_generic hg;
+   memset(&hg, 0, sizeof(hg));
+
+   /* header set */
+   memcpy(hg.header.id, "\x48\x45\x50\x33", 4);
+
+   /* IP proto */
+   hg.ip_family.chunk.vendor_id = htons(0x0000);
+   hg.ip_family.chunk.type_id   = htons(0x0001);
+   hg.ip_family.chunk.length = htons(sizeof(hg.ip_family));
+
+   hep_chunk_ip4_t src_ip4, dst_ip4;
+#ifdef USE_IPV6
+   hep_chunk_ip6_t src_ip6, dst_ip6;
+#endif
+   const char* sourceChunk = 0;
+   const char* destinationChunk = 0;
+   size_t addressChunkLength = 0;
+   unsigned int sourcePort = 0;
+   unsigned int destinationPort = 0;
+   switch(entry.mSource.address.sa_family)
+   {
+      case AF_INET:
+      {
+         hg.ip_family.data = AF_INET;
+         src_ip4.chunk.vendor_id = htons(0x0000);
+         src_ip4.chunk.type_id   = htons(0x0003);
+         const struct sockaddr_in& src_sa = entry.mSource.v4Address;
+         memcpy(&src_ip4.data, &src_sa.sin_addr.s_addr, sizeof(src_sa.sin_addr.s_addr));
+         src_ip4.chunk.length = htons(sizeof(src_ip4));
+         sourcePort = ntohs(src_sa.sin_port);
+
+         dst_ip4.chunk.vendor_id = htons(0x0000);
+         dst_ip4.chunk.type_id   = htons(0x0004);
+         const struct sockaddr_in& dst_sa = entry.mDestination.v4Address;
+         memcpy(&dst_ip4.data, &dst_sa.sin_addr.s_addr, sizeof(dst_sa.sin_addr.s_addr));
+         dst_ip4.chunk.length = htons(sizeof(dst_ip4));
+         destinationPort = ntohs(dst_sa.sin_port);
+
+         sourceChunk = (const char*)&src_ip4;
+         destinationChunk = (const char*)&dst_ip4;
+         addressChunkLength = sizeof(hep_chunk_ip4_t);
+         break;
+      }
+#ifdef USE_IPV6
+      case AF_INET6:
+      {
+         hg.ip_family.data = AF_INET6;
+         src_ip6.chunk.vendor_id = htons(0x0000);
+         src_ip6.chunk.type_id   = htons(0x0005);
+         const struct sockaddr_in6& src_sa6 = entry.mSource.v6Address;
+         memcpy(&src_ip6.data, &src_sa6.sin6_addr, sizeof(src_sa6.sin6_addr));
+         src_ip6.chunk.length = htons(sizeof(src_ip6));
+         sourcePort = ntohs(src_sa6.sin6_port);
+
+         dst_ip6.chunk.vendor_id = htons(0x0000);
+         dst_ip6.chunk.type_id   = htons(0x0006);
+         const struct sockaddr_in6& dst_sa6 = entry.mDestination.v6Address;
+         memcpy(&dst_ip6.data, &dst_sa6.sin6_addr, sizeof(dst_sa6.sin6_addr));
+         dst_ip6.chunk.length = htons(sizeof(dst_ip6));
+         destinationPort = ntohs(dst_sa6.sin6_port);
+
+         sourceChunk = (const char*)&src_ip6;
+         destinationChunk = (const char*)&dst_ip6;
+         addressChunkLength = sizeof(hep_chunk_ip6_t);
+         break;
+      }
+#endif
+      default:
+         ErrLog(<<"unhandled address family");
+         return false;
+   }
+
+   /* PROTOCOL */
+   switch(entry.mType)
+   {
+      case TLS:
+         hg.ip_proto.data = IPPROTO_IDP; // FIXME
+         break;
+      case TCP:
+         hg.ip_proto.data = IPPROTO_TCP;
+         break;
+      case UDP:
+         hg.ip_proto.data = IPPROTO_UDP;
+         break;
+#if !defined(WIN32) || (defined(WIN32) && (_WIN32_WINNT >= 0x0600))
+      case SCTP:
+         hg.ip_proto.data = IPPROTO_SCTP;
+         break;
+#endif
+      case WS:
+      case WSS:
+         hg.ip_proto.data = IPPROTO_TCP; // FIXME
+         break;
+      default:
+         ErrLog(<<"unhandled TransportType");
+         return false;
+   }
+   /* Proto ID */
+   hg.ip_proto.chunk.vendor_id = htons(0x0000);
+   hg.ip_proto.chunk.type_id   = htons(0x0002);
+   hg.ip_proto.chunk.length = htons(sizeof(hg.ip_proto));
+
+   /* SRC PORT */
+   hg.src_port.chunk.vendor_id = htons(0x0000);
+   hg.src_port.chunk.type_id   = htons(0x0007);
+   hg.src_port.data = htons(sourcePort);
+   hg.src_port.chunk.length = htons(sizeof(hg.src_port));
+
+   /* DST PORT */
+   hg.dst_port.chunk.vendor_id = htons(0x0000);
+   hg.dst_port.chunk.type_id   = htons(0x0008);
+   hg.dst_port.data = htons(destinationPort);
+   hg.dst_port.chunk.length = htons(sizeof(hg.dst_port));
+
+   /* TIMESTAMP SEC */
+   hg.time_sec.chunk.vendor_id = htons(0x0000);
+   hg.time_sec.chunk.type_id   = htons(0x0009);
+   hg.time_sec.chunk.length = htons(sizeof(hg.time_sec));
+   hg.time_sec.data = htonl(entry.mTimestamp / 1000000LL);
+
+   /* TIMESTAMP USEC */
+   hg.time_usec.chunk.vendor_id = htons(0x0000);
+   hg.time_usec.chunk.type_id   = htons(0x000a);
+   hg.time_usec.data = htonl(entry.mTimestamp % 1000000LL);
+   hg.time_usec.chunk.length = htons(sizeof(hg.time_usec));
+
+   /* Protocol TYPE */
+   hg.proto_t.chunk.vendor_id = htons(0x0000);
+   hg.proto_t.chunk.type_id   = htons(0x000b);
+   hg.proto_t.data = entry.mEventType;
+   hg.proto_t.chunk.length = htons(sizeof(hg.proto_t));
+
+   /* Capture ID */
+   hg.capt_id.chunk.vendor_id = htons(0x0000);
+   hg.capt_id.chunk.type_id   = htons(0x000c);
+   hg.capt_id.data = htons(mCaptureAgentID);
+   hg.capt_id.chunk.length = htons(sizeof(hg.capt_id));
+
+   /* Correlation ID */
+   hep_chunk_t correlation_chunk;
+   correlation_chunk.vendor_id = htons(0x0000);
+   correlation_chunk.type_id   = htons(0x0011);
+   correlation_chunk.length    = htons(sizeof(correlation_chunk) + entry.mCorrelationId.size());
+
+   /* Payload */
+   hep_chunk_t payload_chunk;
+   payload_chunk.vendor_id = htons(0x0000);
+   payload_chunk.type_id   = htons(0x000f);
+   payload_chunk.length    = htons(sizeof(payload_chunk) + entry.mPayload.size());
+
+   size_t size = sizeof(hg) + 2*addressChunkLength + sizeof(payload_chunk) + entry.mPayload.size();
+   if(!entry.mCorrelationId.empty())
+   {
+      size += sizeof(correlation_chunk) + entry.mCorrelationId.size();
+   }
+   if(size > 0xffff)
+   {
+      ErrLog(<<"HEP packet too large (" << size << " bytes), not sent");
+      return false;
+   }
+   hg.header.length = htons(size);
+
+   packet.truncate2(0);
+   packet.reserve(size + 1);
+   packet.append((const char*)&hg, sizeof(hg));
+   packet.append(sourceChunk, addressChunkLength);
+   packet.append(destinationChunk, addressChunkLength);
+   if(!entry.mCorrelationId.empty())
+   {
+      StackLog(<<"adding correlation ID: " << entry.mCorrelationId);
+      packet.append((const char*)&correlation_chunk, sizeof(correlation_chunk));
+      packet.append(entry.mCorrelationId.data(), entry.mCorrelationId.size());
+   }
+   packet.append((const char*)&payload_chunk, sizeof(payload_chunk));
+   packet.append(entry.mPayload.data(), entry.mPayload.size());
+   return true;
+}
+
+void
+HepAgent::send(unsigned int count)
+{
+   unsigned int sent = 0;
+   unsigned int failed = 0;
+   unsigned int batches = 0;
+#ifdef RESIP_HEP_HAVE_SENDMMSG
+   struct mmsghdr msgs[MaxBatchSize];
+   struct iovec iovecs[MaxBatchSize];
+   memset(msgs, 0, sizeof(msgs));
+   for(unsigned int i = 0; i < count; ++i)
+   {
+      iovecs[i].iov_base = const_cast<char*>(mPackets[i].data());
+      iovecs[i].iov_len = mPackets[i].size();
+      msgs[i].msg_hdr.msg_iov = &iovecs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+      msgs[i].msg_hdr.msg_name = const_cast<sockaddr*>(&mDestination.address);
+      msgs[i].msg_hdr.msg_namelen = mDestination.length();
+   }
+   while(sent + failed < count)
+   {
+      ++batches;
+      int result = sendmmsg(mSocket, &msgs[sent + failed], count - sent - failed, 0);
+      if(result < 0)
+      {
+         // The first packet of the remainder failed; skip it and carry on
+         int e = getErrno();
+         ErrLog(<< "sending to HOMER " << mDestination << " failed (" << e << "): " << strerror(e));
+         ++failed;
+      }
+      else
+      {
+         sent += result;
+      }
+   }
+#else
+   for(unsigned int i = 0; i < count; ++i)
+   {
+      ++batches;
+      if(sendto(mSocket, mPackets[i].data(), (int)mPackets[i].size(), 0, &mDestination.address, (int)mDestination.length()) < 0)
+      {
+         int e = getErrno();
+#if defined(WIN32)
+         ErrLog(<< "sending to HOMER " << mDestination << " failed (" << e << ")");
+#else
+         ErrLog(<< "sending to HOMER " << mDestination << " failed (" << e << "): " << strerror(e));
+#endif
+         ++failed;
+      }
+      else
+      {
+         ++sent;
+      }
+   }
+#endif
+   DebugLog(<< sent << " packets sent to HOMER " << mDestination);
+
+   Lock lock(mMutex);
+   mSent += sent;
+   mSendErrors += failed;
+   mBatches += batches;
 }
 
 /* ====================================================================
@@ -1490,6 +1490,89 @@ class TestData
             assert(u4.caseInsensitiveTokenCompare(u3));
             assert(u4.caseInsensitiveTokenCompare(u4));
          }
+
+         // fastHash / fastCaseInsensitiveTokenHash and the word-at-a-time 
+         // token compare, for every length and alignment of the tail
+         {
+            const char* lower = "z9hg4bk-524287-1---5d7a9b7c02034b5b-abcdefghij";
+            const char* upper = "Z9HG4BK-524287-1---5D7A9B7C02034B5B-ABCDEFGHIJ";
+            char buf[64];
+            for(size_t len=0; len<=strlen(lower); ++len)
+            {
+               for(int offset=0; offset<4; ++offset)
+               {
+                  memcpy(buf+offset, lower, len);
+                  Data d(Data::Share, lower, len);
+                  Data moved(Data::Share, buf+offset, len);
+                  Data u(Data::Share, upper, len);
+                  assert(d.fastHash()==moved.fastHash());
+                  assert(d.fastCaseInsensitiveTokenHash()==moved.fastCaseInsensitiveTokenHash());
+                  assert(d.fastCaseInsensitiveTokenHash()==u.fastCaseInsensitiveTokenHash());
+                  assert(len==0 || d.fastHash()!=u.fastHash());
+                  assert(d.caseInsensitiveTokenCompare(u));
+                  assert(u.caseInsensitiveTokenCompare(moved));
+
+                  // A difference in any one position is caught
+                  for(size_t i=0; i<len; ++i)
+                  {
+                     memcpy(buf+offset, lower, len);
+                     buf[offset+i] = '.';
+                     if(lower[i] == '.')
+                     {
+                        continue;
+                     }
+                     Data changed(Data::Share, buf+offset, len);
+                     assert(!d.caseInsensitiveTokenCompare(changed));
+                     assert(!changed.caseInsensitiveTokenCompare(u));
+                     assert(d.fastHash()!=changed.fastHash());
+                     assert(d.fastCaseInsensitiveTokenHash()!=changed.fastCaseInsensitiveTokenHash());
+                  }
+               }
+            }
+            assert(Data("a").fastHash()!=Data("b").fastHash());
+            assert(Data("ab").fastHash()!=Data("ba").fastHash());
+            assert(Data::Empty.fastHash()!=Data("a").fastHash());
+         }
+
+         // Interning
+         {
+            Data domain("interned.voice.example.com");
+            Data pooled = Data::intern(domain);
+            assert(pooled == domain);
+            assert(pooled.data() != domain.data());
+            assert(Data::intern(domain).data() == pooled.data());
+            assert(Data::intern(pooled).data() == pooled.data());
+            size_t count = Data::getInternedCount();
+            assert(count >= 1);
+
+            // Copies share the pooled buffer, and c_str() does not copy it
+            Data copy(pooled);
+            assert(copy.data() == pooled.data());
+            Data assigned;
+            assigned = pooled;
+            assert(assigned.data() == pooled.data());
+            assert(copy.c_str() == pooled.data());
+            assert(strcmp(copy.c_str(), "interned.voice.example.com") == 0);
+
+            // Modifying a copy leaves the pool alone
+            copy += ".net";
+            assert(copy == "interned.voice.example.com.net");
+            assert(pooled == "interned.voice.example.com");
+            assert(Data::intern(domain) == "interned.voice.example.com");
+
+            // useInterned only switches to values already in the pool
+            Data parsed("interned.voice.example.com");
+            assert(parsed.useInterned());
+            assert(parsed.data() == pooled.data());
+            Data other("not-interned.voice.example.com");
+            assert(!other.useInterned());
+            assert(Data::getInternedCount() == count);
+
+            // Short values are not pooled - they do not allocate anyway
+            Data shortValue("udp");
+            assert(Data::intern(shortValue).data() != shortValue.data());
+            assert(Data::getInternedCount() == count);
+         }
          std::cerr << "All OK" << endl;
          return 0;
       }
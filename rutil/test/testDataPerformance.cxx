@@ -1,11 +1,73 @@
+#include <iostream>
+#include <vector>
 #include "rutil/DataStream.hxx"
 #include "rutil/Random.hxx"
+#include "rutil/Timer.hxx"
 
 using namespace resip;
 
+static const int HashIterations = 200000;
+
+// Typical hash keys: tags, branch ids, Call-IDs and host names
+static void
+makeKeys(std::vector<Data>& keys, std::vector<Data>& upperKeys)
+{
+   const char* fixed[] = { "example.com", "sip.proxy.example.net", "z9hG4bK-524287-1---" };
+   for (unsigned int i = 0; i < sizeof(fixed)/sizeof(*fixed); i++)
+   {
+      keys.push_back(fixed[i]);
+   }
+   keys.push_back(Random::getRandomHex(4));                               // tag
+   keys.push_back("z9hG4bK-524287-1---" + Random::getRandomHex(8));        // branch
+   keys.push_back(Random::getRandomHex(16) + "@10.1.2.3");                 // Call-ID
+   for (std::vector<Data>::iterator it = keys.begin(); it != keys.end(); ++it)
+   {
+      Data upper(*it);
+      upper.uppercase();
+      upperKeys.push_back(upper);
+   }
+}
+
+template<class Op>
+static void
+timeKeys(const char* name, const std::vector<Data>& keys, const std::vector<Data>& upperKeys, Op op)
+{
+   size_t sink = 0;
+   UInt64 start = Timer::getTimeMicroSec();
+   for (int i = 0; i < HashIterations; i++)
+   {
+      for (size_t k = 0; k < keys.size(); k++)
+      {
+         sink += op(keys[k], upperKeys[k]);
+      }
+   }
+   UInt64 elapsed = Timer::getTimeMicroSec() - start;
+   std::cout << name << ": " << (elapsed * 1000) / ((UInt64)HashIterations * keys.size()) 
+             << " ns/op (" << sink % 2 << ")" << std::endl;
+}
+
+struct Hash { size_t operator()(const Data& d, const Data&) const { return d.hash(); } };
+struct FastHash { size_t operator()(const Data& d, const Data&) const { return d.fastHash(); } };
+struct TokenHash { size_t operator()(const Data& d, const Data&) const { return d.caseInsensitiveTokenHash(); } };
+struct FastTokenHash { size_t operator()(const Data& d, const Data&) const { return d.fastCaseInsensitiveTokenHash(); } };
+struct TokenCompare { size_t operator()(const Data& d, const Data& u) const { return d.caseInsensitiveTokenCompare(u); } };
+struct NoCaseCompare { size_t operator()(const Data& d, const Data& u) const { return isEqualNoCase(d, u); } };
+
 int 
 main()
 {
+   {
+      std::vector<Data> keys;
+      std::vector<Data> upperKeys;
+      makeKeys(keys, upperKeys);
+      timeKeys("hash", keys, upperKeys, Hash());
+      timeKeys("fastHash", keys, upperKeys, FastHash());
+      timeKeys("caseInsensitiveTokenHash", keys, upperKeys, TokenHash());
+      timeKeys("fastCaseInsensitiveTokenHash", keys, upperKeys, FastTokenHash());
+      timeKeys("caseInsensitiveTokenCompare", keys, upperKeys, TokenCompare());
+      timeKeys("isEqualNoCase", keys, upperKeys, NoCaseCompare());
+   }
+
    Data data = Random::getRandomHex(8);
    for (int j=0; j<100; j++)
    {
@@ -0,0 +1,256 @@
+#include <iostream>
+#include <cassert>
+#include <string.h>
+#include <vector>
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#include "rutil/Data.hxx"
+#include "rutil/FdPoll.hxx"
+#include "rutil/Log.hxx"
+#include "rutil/Socket.hxx"
+
+using namespace resip;
+using namespace std;
+
+// Keeps every other buffer it is given, like a transport whose messages
+// sometimes take the buffer with them.
+class DatagramItem : public FdPollDatagramIf
+{
+   public:
+      DatagramItem() : mAllocated(0), mKeep(false), mFromPort(0) {}
+
+      virtual char* allocateDatagramBuffer(unsigned size)
+      {
+         ++mAllocated;
+         return new char[size];
+      }
+
+      virtual bool processDatagram(char* buffer, int len,
+                                   const sockaddr& from, socklen_t fromLen)
+      {
+         assert(fromLen == sizeof(sockaddr_in));
+         mFromPort = ntohs(((const sockaddr_in&)from).sin_port);
+         mReceived.push_back(Data(buffer, len));
+         mKeep = !mKeep;
+         if (mKeep)
+         {
+            delete [] buffer;
+            return true;
+         }
+         return false;
+      }
+
+      virtual void processDatagramSent(void* cookie, int res)
+      {
+         mSentCookies.push_back(cookie);
+         mSentResults.push_back(res);
+      }
+
+      int mAllocated;
+      bool mKeep;
+      int mFromPort;
+      vector<Data> mReceived;
+      vector<void*> mSentCookies;
+      vector<int> mSentResults;
+};
+
+static Socket
+makeSocket(sockaddr_in& addr)
+{
+   Socket fd = ::socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+   assert(fd != INVALID_SOCKET);
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   assert(::bind(fd, (sockaddr*)&addr, sizeof(addr)) == 0);
+   socklen_t len = sizeof(addr);
+   assert(::getsockname(fd, (sockaddr*)&addr, &len) == 0);
+   assert(makeSocketNonBlocking(fd));
+   return fd;
+}
+
+static void
+waitFor(FdPollGrp& grp, const vector<Data>& v, size_t n)
+{
+   for (int i = 0; i < 50 && v.size() < n; ++i)
+   {
+      grp.waitAndProcess(100);
+   }
+}
+
+static void
+waitFor(FdPollGrp& grp, const vector<int>& v, size_t n)
+{
+   for (int i = 0; i < 50 && v.size() < n; ++i)
+   {
+      grp.waitAndProcess(100);
+   }
+}
+
+int
+main(int argc, char** argv)
+{
+   Log::initialize(Log::Cout, argc > 1 ? Log::toLevel(argv[1]) : Log::Warning, argv[0]);
+   initNetwork();
+
+   sockaddr_in itemAddr;
+   sockaddr_in peerAddr;
+   Socket itemFd = makeSocket(itemAddr);
+   Socket peer = makeSocket(peerAddr);
+
+   {
+      // Impls that can't do the I/O say so, and the caller polls instead
+      FdPollGrp* grp = FdPollGrp::create("fdset");
+      DatagramItem item;
+      assert(grp->addDatagramItem(itemFd, &item, 64, 4) == 0);
+      assert(item.mAllocated == 0);
+      delete grp;
+   }
+
+   FdPollGrp* grp = FdPollGrp::create("uring");
+   DatagramItem item;
+   FdPollItemHandle handle = 0;
+   if (grp->getImplType() == FdPollGrp::URingImpl)
+   {
+      handle = grp->addDatagramItem(itemFd, &item, 64, 4);
+   }
+   if (handle == 0)
+   {
+      cerr << "io_uring can't receive datagrams here, skipping" << endl;
+      delete grp;
+      closeSocket(itemFd);
+      closeSocket(peer);
+      cerr << "All OK" << endl;
+      return 0;
+   }
+   assert(item.mAllocated == 4);
+
+   {
+      // More datagrams than buffers: the ones the item kept are replaced,
+      // and the receive is re-armed when the kernel runs out
+      const int count = 10;
+      for (int i = 0; i < count; ++i)
+      {
+         Data msg("datagram-" + Data(i));
+         assert(::sendto(peer, msg.data(), msg.size(), 0,
+                         (sockaddr*)&itemAddr, sizeof(itemAddr)) == (int)msg.size());
+      }
+      waitFor(*grp, item.mReceived, count);
+      assert(item.mReceived.size() == (size_t)count);
+      for (int i = 0; i < count; ++i)
+      {
+         assert(item.mReceived[i] == "datagram-" + Data(i));
+      }
+      assert(item.mFromPort == ntohs(peerAddr.sin_port));
+      assert(item.mAllocated == 4 + count/2);
+   }
+
+   {
+      // Too big for a buffer: dropped, the next one still arrives
+      char big[100];
+      memset(big, 'x', sizeof(big));
+      assert(::sendto(peer, big, sizeof(big), 0,
+                      (sockaddr*)&itemAddr, sizeof(itemAddr)) == (int)sizeof(big));
+      Data msg("after-big");
+      assert(::sendto(peer, msg.data(), msg.size(), 0,
+                      (sockaddr*)&itemAddr, sizeof(itemAddr)) == (int)msg.size());
+      size_t before = item.mReceived.size();
+      waitFor(*grp, item.mReceived, before+1);
+      assert(item.mReceived.size() == before+1);
+      assert(item.mReceived.back() == msg);
+   }
+
+   {
+      // Sends are only queued until the next wait, then go out together
+      const char* msgs[] = { "one", "two", "three" };
+      for (int i = 0; i < 3; ++i)
+      {
+         grp->sendDatagram(handle, msgs[i], (unsigned)strlen(msgs[i]),
+                           (const sockaddr&)peerAddr, sizeof(peerAddr),
+                           (void*)msgs[i]);
+      }
+      char buffer[64];
+      assert(::recv(peer, buffer, sizeof(buffer), 0) == -1);
+      waitFor(*grp, item.mSentResults, 3);
+      assert(item.mSentResults.size() == 3);
+      for (int i = 0; i < 3; ++i)
+      {
+         assert(item.mSentCookies[i] == (void*)msgs[i]);
+         assert(item.mSentResults[i] == (int)strlen(msgs[i]));
+         int len = ::recv(peer, buffer, sizeof(buffer), 0);
+         assert(Data(buffer, len) == msgs[i]);
+      }
+   }
+
+   {
+      // Deleting the item reports its unfinished sends right away, and
+      // their completions don't reach it afterwards
+      static const char msg[] = "never mind";
+      grp->sendDatagram(handle, msg, sizeof(msg)-1,
+                        (const sockaddr&)peerAddr, sizeof(peerAddr), (void*)msg);
+      size_t before = item.mSentResults.size();
+      grp->delPollItem(handle);
+      assert(item.mSentResults.size() == before+1);
+      assert(item.mSentCookies.back() == (void*)msg);
+      assert(item.mSentResults.back() == -ECANCELED);
+      grp->waitAndProcess(100);
+      assert(item.mSentResults.size() == before+1);
+   }
+
+   delete grp;
+   closeSocket(itemFd);
+   closeSocket(peer);
+   cerr << "All OK" << endl;
+   return 0;
+}
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
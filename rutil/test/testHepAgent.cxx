@@ -0,0 +1,200 @@
+#include <iostream>
+#include <string.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#include "rutil/Data.hxx"
+#include "rutil/Log.hxx"
+#include "rutil/Socket.hxx"
+#include "rutil/hep/HepAgent.hxx"
+#include "rutil/hep/ResipHep.hxx"
+
+using namespace resip;
+using namespace std;
+
+static void
+sleepMS(unsigned int ms)
+{
+#ifdef WIN32
+   Sleep(ms);
+#else
+   usleep(ms*1000);
+#endif
+}
+
+static GenericIPAddress
+makeAddress(const char* ip, unsigned short port)
+{
+   sockaddr_in addr;
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_port = htons(port);
+   inet_pton(AF_INET, ip, &addr.sin_addr);
+   return GenericIPAddress(addr);
+}
+
+// Waits for the agent to send (or fail to send) everything it queued
+static void
+waitForSent(const HepAgent& agent)
+{
+   for(int i = 0; i < 500 && agent.getSentCount() + agent.getSendErrorCount() < agent.getQueuedCount(); ++i)
+   {
+      sleepMS(10);
+   }
+   assert(agent.getSentCount() + agent.getSendErrorCount() == agent.getQueuedCount());
+}
+
+int
+main(int argc, char** argv)
+{
+   Log::initialize(Log::Cout, argc > 1 ? Log::toLevel(argv[1]) : Log::Warning, argv[0]);
+   initNetwork();
+
+   // Stand in for the HOMER server
+   Socket server = ::socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+   assert(server != INVALID_SOCKET);
+   sockaddr_in serverAddr = makeAddress("127.0.0.1", 0).v4Address;
+   assert(::bind(server, (sockaddr*)&serverAddr, sizeof(serverAddr)) == 0);
+   socklen_t serverAddrLen = sizeof(serverAddr);
+   assert(::getsockname(server, (sockaddr*)&serverAddr, &serverAddrLen) == 0);
+   int serverPort = ntohs(serverAddr.sin_port);
+
+#ifdef USE_IPV6
+   // the agent's socket is IPv6
+   const Data captureHost("::ffff:127.0.0.1");
+#else
+   const Data captureHost("127.0.0.1");
+#endif
+
+   const GenericIPAddress source(makeAddress("192.0.2.1", 5060));
+   const GenericIPAddress destination(makeAddress("192.0.2.2", 5080));
+
+   {
+      // Packets are built and sent by the capture thread
+      HepAgent agent(captureHost, serverPort, 2001, 16);
+      const int count = 10;
+      for(int i = 0; i < count; ++i)
+      {
+         Data payload("INVITE sip:bob@example.com SIP/2.0\r\nCall-ID: call-" + Data(i) + "\r\n\r\n");
+         agent.sendToHOMER(UDP, source, destination, HepAgent::SIP, payload.data(), payload.size(), "call-" + Data(i));
+      }
+      waitForSent(agent);
+      assert(agent.getSentCount() == (UInt64)count);
+      assert(agent.getDroppedCount() == 0);
+      assert(agent.getBatchCount() <= (UInt64)count);
+
+      for(int i = 0; i < count; ++i)
+      {
+         char buffer[2048];
+         int len = ::recv(server, buffer, sizeof(buffer), 0);
+         assert(len > (int)sizeof(hep_generic));
+         const hep_generic* hg = (const hep_generic*)buffer;
+         assert(memcmp(hg->header.id, "HEP3", 4) == 0);
+         assert(ntohs(hg->header.length) == len);
+         assert(ntohs(hg->src_port.data) == 5060);
+         assert(ntohs(hg->dst_port.data) == 5080);
+         assert(ntohs(hg->capt_id.data) == 2001);
+         assert(hg->proto_t.data == HepAgent::SIP);
+         assert(hg->ip_proto.data == IPPROTO_UDP);
+         const hep_chunk_ip4_t* srcChunk = (const hep_chunk_ip4_t*)(buffer + sizeof(hep_generic));
+         const hep_chunk_ip4_t* dstChunk = srcChunk + 1;
+         assert(ntohs(srcChunk->chunk.type_id) == 0x0003);
+         assert(memcmp(&srcChunk->data, &source.v4Address.sin_addr, 4) == 0);
+         assert(ntohs(dstChunk->chunk.type_id) == 0x0004);
+         assert(memcmp(&dstChunk->data, &destination.v4Address.sin_addr, 4) == 0);
+
+         // payload is the last chunk, correlation id the one before it
+         Data payload("INVITE sip:bob@example.com SIP/2.0\r\nCall-ID: call-" + Data(i) + "\r\n\r\n");
+         Data packet(buffer, len);
+         assert(packet.postfix(payload));
+         const hep_chunk_t* payloadChunk = (const hep_chunk_t*)(buffer + len - payload.size() - sizeof(hep_chunk_t));
+         assert(ntohs(payloadChunk->type_id) == 0x000f);
+         assert(ntohs(payloadChunk->length) == sizeof(hep_chunk_t) + payload.size());
+         assert(packet.find("call-" + Data(i)) < packet.size() - payload.size());
+      }
+
+      // The templated version streams the message
+      agent.sendToHOMER<Data>(TCP, source, destination, HepAgent::RTCP_JSON, Data("{}"), Data::Empty);
+      waitForSent(agent);
+      char buffer[2048];
+      int len = ::recv(server, buffer, sizeof(buffer), 0);
+      assert(len == (int)(sizeof(hep_generic) + sizeof(hep_chunk_ip4_t)*2 + sizeof(hep_chunk_t) + 2));
+      assert(Data(buffer, len).postfix("{}"));
+      assert(((const hep_generic*)buffer)->ip_proto.data == IPPROTO_TCP);
+   }
+
+   {
+      // A full queue drops packets instead of blocking the caller
+      HepAgent agent(captureHost, serverPort, 2001, 1);
+      const int count = 1000;
+      Data payload(Data::Empty);
+      payload.reserve(1000);
+      for(int i = 0; i < 1000; ++i)
+      {
+         payload += 'x';
+      }
+      for(int i = 0; i < count; ++i)
+      {
+         agent.sendToHOMER(UDP, source, destination, HepAgent::SIP, payload.data(), payload.size(), Data::Empty);
+      }
+      assert(agent.getQueuedCount() + agent.getDroppedCount() == (UInt64)count);
+      assert(agent.getQueuedCount() >= 1);
+      waitForSent(agent);
+      cerr << "queue size 1: " << agent.getQueuedCount() << " queued, " << agent.getDroppedCount() << " dropped, "
+           << agent.getSentCount() << " sent in " << agent.getBatchCount() << " batches" << endl;
+   }
+
+   closeSocket(server);
+   cerr << "All OK" << endl;
+   return 0;
+}
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
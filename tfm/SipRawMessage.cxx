@@ -1,5 +1,6 @@
 #include <iostream>
 #include "tfm/SipRawMessage.hxx"
+#include "resip/stack/SipMessageEncoder.hxx"
 
 using namespace resip;
 
@@ -22,6 +23,12 @@ SipRawMessage::encode(std::ostream& str) const
    str << mRawMessage;
    return str;
 }
+
+void
+SipRawMessage::encode(SipMessageEncoder& encoder) const
+{
+   encoder.add(mRawMessage);
+}
 /*
   Copyright (c) 2005, PurpleComm, Inc. 
   All rights reserved.